@@ -22,6 +22,7 @@
 #include "fsearch_config.h"
 #include "fsearch_database.h"
 #include "fsearch_database_exclude_manager.h"
+#include "fsearch_database_file.h"
 #include "fsearch_database_include_manager.h"
 #include "fsearch_database_index_properties.h"
 #include "fsearch_database_info.h"
@@ -456,6 +457,9 @@ fsearch_application_startup(GApplication *app) {
     g_autofree char *db_file_path = g_build_filename(g_get_user_data_dir(), "fsearch", "fsearch.db", NULL);
     g_autoptr(GFile) db_file = g_file_new_for_path(db_file_path);
     self->db = fsearch_database_new(g_steal_pointer(&db_file), self->config->includes, self->config->excludes);
+    fsearch_database_set_compression(self->db,
+                                     fsearch_database_file_get_compression_from_string(
+                                         self->config->database_compression));
     self->db_state = FSEARCH_DATABASE_STATE_IDLE;
 
     g_signal_connect_object(self->db, "load-started", G_CALLBACK(on_database_load_started), self, G_CONNECT_AFTER);
@@ -749,6 +753,8 @@ database_scan_in_local_instance() {
     g_autofree char *db_file_path = g_build_filename(g_get_user_data_dir(), "fsearch", "fsearch.db", NULL);
     g_autoptr(GFile) db_file = g_file_new_for_path(db_file_path);
     g_autoptr(FsearchDatabase) db = fsearch_database_new(g_steal_pointer(&db_file), config->includes, config->excludes);
+    fsearch_database_set_compression(db,
+                                     fsearch_database_file_get_compression_from_string(config->database_compression));
     FsearchResult result = fsearch_database_rescan_blocking(db);
 
     g_timer_stop(timer);
@@ -0,0 +1,722 @@
+#define G_LOG_DOMAIN "fsearch-arena"
+
+#include "fsearch_arena.h"
+
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Enough address space for every id, halved until the system grants it (e.g. on 32-bit systems)
+#define ARENA_MAX_SIZE ((size_t)MIN((guint64)G_MAXSIZE / 2 + 1, ((guint64)G_MAXUINT32 + 1) * FSEARCH_ARENA_ALIGNMENT))
+#define ARENA_MIN_SIZE ((size_t)64 << 20)
+// Every thread hands out items from a private chunk of this size, so most allocations don't need the lock
+#define ARENA_CHUNK_SIZE ((size_t)1 << 20)
+// Freed items up to this size are kept in a free list per size, larger ones as regions in a bin per power of two
+#define ARENA_MAX_SMALL_SIZE 1024
+#define ARENA_NUM_SIZE_CLASSES (ARENA_MAX_SMALL_SIZE / FSEARCH_ARENA_ALIGNMENT + 1)
+#define ARENA_NUM_LARGE_BINS (sizeof(size_t) * 8)
+// Every thread collects the items it frees and hands them back to the arena with a single lock
+#define ARENA_FREE_BATCH_SIZE 256
+
+// None of the chunk's bytes are in use, but its memory wasn't returned to the system yet
+#define ARENA_CHUNK_EMPTY (1 << 0)
+// The chunk is in `empty_chunks`
+#define ARENA_CHUNK_QUEUED (1 << 1)
+
+typedef struct {
+    uint8_t *pos;
+    uint8_t *end;
+} ArenaRegion;
+
+// A freed region larger than ARENA_MAX_SMALL_SIZE
+typedef struct ArenaFreeRegion ArenaFreeRegion;
+struct ArenaFreeRegion {
+    uint8_t *pos;
+    uint8_t *end;
+    // The other regions in the same bin
+    ArenaFreeRegion *prev;
+    ArenaFreeRegion *next;
+    uint32_t bin;
+};
+
+typedef struct {
+    uint8_t *item;
+    size_t size;
+} ArenaFreedItem;
+
+typedef struct {
+    // Items are handed out from here without taking the lock
+    ArenaRegion chunk;
+    // Items which were freed by the thread, but not handed back to the arena yet
+    ArenaFreedItem freed[ARENA_FREE_BATCH_SIZE];
+    uint32_t num_freed;
+} ArenaThread;
+
+typedef struct {
+    // Bytes which are handed out or owned by a thread, i.e. neither in a free list nor in a free region
+    uint32_t num_used;
+    uint8_t flags;
+} ArenaChunk;
+
+typedef struct {
+    uint8_t *start;
+    uint8_t *end;
+    uint32_t num_items;
+} ArenaMapping;
+
+uint8_t *fsearch_arena_base = NULL;
+
+static struct {
+    GMutex mutex;
+
+    size_t size;
+    // Everything below `num_used` was handed out, everything below `num_committed` is readable and writable
+    size_t num_used;
+    size_t num_committed;
+
+    // Id of the first free item of every size, each free item stores the id of the next one
+    uint32_t free_lists[ARENA_NUM_SIZE_CLASSES];
+    // Lets threads check for free items without taking the lock
+    volatile gint num_free[ARENA_NUM_SIZE_CLASSES];
+
+    // Unused rest of the chunks of exited threads
+    GSList *free_chunks;
+    // Freed items larger than ARENA_MAX_SMALL_SIZE, by their start and end, so they can be merged with the regions
+    // next to them, and in bins by the power of two of their size
+    GHashTable *free_large_starts;
+    GHashTable *free_large_ends;
+    ArenaFreeRegion *free_large_bins[ARENA_NUM_LARGE_BINS];
+    // Regions which are mapped from files, sorted by their start. Their freed items aren't reused, the whole region
+    // is once all of them were freed.
+    GPtrArray *mappings;
+
+    // Every ARENA_CHUNK_SIZE bytes of the reserved range
+    ArenaChunk *chunks;
+    // Chunks which became empty since their memory was last returned to the system
+    GArray *empty_chunks;
+    uint32_t num_empty_chunks;
+    // Bytes in the free lists
+    size_t num_free_small;
+} arena;
+
+static void
+arena_thread_free(ArenaThread *thread);
+
+static GPrivate arena_thread = G_PRIVATE_INIT((GDestroyNotify)arena_thread_free);
+
+static void
+arena_init(void) {
+    static gsize initialized = 0;
+    if (!g_once_init_enter(&initialized)) {
+        return;
+    }
+
+    // Only reserve the address space, memory gets committed when the arena grows
+    for (size_t size = ARENA_MAX_SIZE; size >= ARENA_MIN_SIZE; size /= 2) {
+        void *base = mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (base != MAP_FAILED) {
+            arena.size = size;
+            // Nothing starts at offset 0, that's FSEARCH_ARENA_ID_NONE
+            arena.num_used = FSEARCH_ARENA_ALIGNMENT;
+            arena.chunks = g_new0(ArenaChunk, size / ARENA_CHUNK_SIZE);
+            arena.chunks[0].num_used = FSEARCH_ARENA_ALIGNMENT;
+            arena.empty_chunks = g_array_new(FALSE, FALSE, sizeof(uint32_t));
+            arena.free_large_starts = g_hash_table_new(NULL, NULL);
+            arena.free_large_ends = g_hash_table_new(NULL, NULL);
+            arena.mappings = g_ptr_array_new();
+            fsearch_arena_base = base;
+            break;
+        }
+    }
+    if (!fsearch_arena_base) {
+        // Every allocation fails
+        g_warning("[arena] failed to reserve address space");
+    }
+    g_once_init_leave(&initialized, 1);
+}
+
+static inline size_t
+arena_round_up(size_t size) {
+    return (MAX(size, FSEARCH_ARENA_ALIGNMENT) + FSEARCH_ARENA_ALIGNMENT - 1) & ~(size_t)(FSEARCH_ARENA_ALIGNMENT - 1);
+}
+
+static void
+arena_mark_used_locked(const uint8_t *item, size_t size) {
+    size_t offset = item - fsearch_arena_base;
+    const size_t end = offset + size;
+    while (offset < end) {
+        const size_t idx = offset / ARENA_CHUNK_SIZE;
+        const size_t num_bytes = MIN(end, (idx + 1) * ARENA_CHUNK_SIZE) - offset;
+        ArenaChunk *chunk = &arena.chunks[idx];
+        if (chunk->flags & ARENA_CHUNK_EMPTY) {
+            chunk->flags &= ~ARENA_CHUNK_EMPTY;
+            arena.num_empty_chunks--;
+        }
+        chunk->num_used += num_bytes;
+        offset += num_bytes;
+    }
+}
+
+static void
+arena_mark_free_locked(const uint8_t *item, size_t size) {
+    size_t offset = item - fsearch_arena_base;
+    const size_t end = offset + size;
+    while (offset < end) {
+        const uint32_t idx = offset / ARENA_CHUNK_SIZE;
+        const size_t num_bytes = MIN(end, ((size_t)idx + 1) * ARENA_CHUNK_SIZE) - offset;
+        ArenaChunk *chunk = &arena.chunks[idx];
+        chunk->num_used -= num_bytes;
+        if (chunk->num_used == 0) {
+            chunk->flags |= ARENA_CHUNK_EMPTY;
+            arena.num_empty_chunks++;
+            if (!(chunk->flags & ARENA_CHUNK_QUEUED)) {
+                chunk->flags |= ARENA_CHUNK_QUEUED;
+                g_array_append_val(arena.empty_chunks, idx);
+            }
+        }
+        offset += num_bytes;
+    }
+}
+
+// Hands out `size` bytes after everything which was handed out so far. Returns NULL once the reserved range or the
+// memory of the system is exhausted.
+static uint8_t *
+arena_carve_locked(size_t size) {
+    if (G_UNLIKELY(size > arena.size - arena.num_used)) {
+        g_debug("[arena] out of address space");
+        return NULL;
+    }
+    if (arena.num_used + size > arena.num_committed) {
+        const size_t num_committed = MIN((arena.num_used + size + ARENA_CHUNK_SIZE - 1) & ~(ARENA_CHUNK_SIZE - 1),
+                                         arena.size);
+        if (mprotect(fsearch_arena_base + arena.num_committed,
+                     num_committed - arena.num_committed,
+                     PROT_READ | PROT_WRITE)
+            != 0) {
+            g_debug("[arena] failed to commit memory");
+            return NULL;
+        }
+        arena.num_committed = num_committed;
+    }
+    uint8_t *item = fsearch_arena_base + arena.num_used;
+    arena.num_used += size;
+    arena_mark_used_locked(item, size);
+    return item;
+}
+
+static void
+arena_free_small_locked(uint8_t *item, size_t size) {
+    const size_t size_class = size / FSEARCH_ARENA_ALIGNMENT;
+    memcpy(item, &arena.free_lists[size_class], sizeof(uint32_t));
+    arena.free_lists[size_class] = fsearch_arena_get_id(item);
+    g_atomic_int_inc(&arena.num_free[size_class]);
+    arena.num_free_small += size;
+    arena_mark_free_locked(item, size);
+}
+
+static inline uint32_t
+arena_get_large_bin(size_t size) {
+    return g_bit_storage(size) - 1;
+}
+
+static void
+arena_insert_free_region_locked(uint8_t *pos, uint8_t *end) {
+    ArenaFreeRegion *region = g_new0(ArenaFreeRegion, 1);
+    region->pos = pos;
+    region->end = end;
+    region->bin = arena_get_large_bin(end - pos);
+    region->next = arena.free_large_bins[region->bin];
+    if (region->next) {
+        region->next->prev = region;
+    }
+    arena.free_large_bins[region->bin] = region;
+    g_hash_table_insert(arena.free_large_starts, pos, region);
+    g_hash_table_insert(arena.free_large_ends, end, region);
+}
+
+static void
+arena_remove_free_region_locked(ArenaFreeRegion *region) {
+    if (region->prev) {
+        region->prev->next = region->next;
+    }
+    else {
+        arena.free_large_bins[region->bin] = region->next;
+    }
+    if (region->next) {
+        region->next->prev = region->prev;
+    }
+    g_hash_table_remove(arena.free_large_starts, region->pos);
+    g_hash_table_remove(arena.free_large_ends, region->end);
+    g_free(region);
+}
+
+// Adds a free region, merged with the regions right before and after it
+static void
+arena_add_free_region_locked(uint8_t *pos, uint8_t *end) {
+    ArenaFreeRegion *before = g_hash_table_lookup(arena.free_large_ends, pos);
+    if (before) {
+        pos = before->pos;
+        arena_remove_free_region_locked(before);
+    }
+    ArenaFreeRegion *after = g_hash_table_lookup(arena.free_large_starts, end);
+    if (after) {
+        end = after->end;
+        arena_remove_free_region_locked(after);
+    }
+    arena_insert_free_region_locked(pos, end);
+}
+
+static void
+arena_free_locked(uint8_t *item, size_t size) {
+    if (size <= ARENA_MAX_SMALL_SIZE) {
+        arena_free_small_locked(item, size);
+        return;
+    }
+    arena_mark_free_locked(item, size);
+    arena_add_free_region_locked(item, item + size);
+
+    // Return the whole pages of the region to the system right away, the rest follows once its chunk is empty
+    const size_t page_size = sysconf(_SC_PAGESIZE);
+    uint8_t *first_page = fsearch_arena_base + ((item - fsearch_arena_base + page_size - 1) & ~(page_size - 1));
+    uint8_t *last_page = fsearch_arena_base + ((item + size - fsearch_arena_base) & ~(page_size - 1));
+    if (first_page < last_page) {
+        madvise(first_page, last_page - first_page, MADV_DONTNEED);
+    }
+}
+
+static inline gboolean
+arena_chunk_is_releasing_locked(size_t idx) {
+    return arena.chunks[idx].flags & ARENA_CHUNK_EMPTY;
+}
+
+static inline gboolean
+arena_item_is_releasing_locked(const uint8_t *item, size_t size) {
+    const size_t offset = item - fsearch_arena_base;
+    return arena_chunk_is_releasing_locked(offset / ARENA_CHUNK_SIZE)
+        || arena_chunk_is_releasing_locked((offset + size - 1) / ARENA_CHUNK_SIZE);
+}
+
+// Appends the parts of the region from `pos` to `end` which aren't in a chunk that gets released to `kept`. Returns
+// whether anything was cut off.
+static gboolean
+arena_cut_releasing_chunks_locked(uint8_t *pos, uint8_t *end, GArray *kept) {
+    gboolean cut = FALSE;
+    uint8_t *piece = NULL;
+    while (pos < end) {
+        const size_t idx = (pos - fsearch_arena_base) / ARENA_CHUNK_SIZE;
+        uint8_t *next = MIN(fsearch_arena_base + (idx + 1) * ARENA_CHUNK_SIZE, end);
+        if (!arena_chunk_is_releasing_locked(idx)) {
+            piece = piece ? piece : pos;
+        }
+        else {
+            cut = TRUE;
+            if (piece) {
+                const ArenaRegion kept_region = {.pos = piece, .end = pos};
+                g_array_append_val(kept, kept_region);
+                piece = NULL;
+            }
+        }
+        pos = next;
+    }
+    if (piece) {
+        const ArenaRegion kept_region = {.pos = piece, .end = end};
+        g_array_append_val(kept, kept_region);
+    }
+    return cut;
+}
+
+static void
+arena_cut_releasing_free_regions_locked(void) {
+    g_autoptr(GPtrArray) regions = g_ptr_array_sized_new(g_hash_table_size(arena.free_large_starts));
+    GHashTableIter iter;
+    gpointer region = NULL;
+    g_hash_table_iter_init(&iter, arena.free_large_starts);
+    while (g_hash_table_iter_next(&iter, NULL, &region)) {
+        g_ptr_array_add(regions, region);
+    }
+    g_autoptr(GArray) kept = g_array_new(FALSE, FALSE, sizeof(ArenaRegion));
+    for (guint i = 0; i < regions->len; i++) {
+        ArenaFreeRegion *free_region = g_ptr_array_index(regions, i);
+        g_array_set_size(kept, 0);
+        if (!arena_cut_releasing_chunks_locked(free_region->pos, free_region->end, kept)) {
+            continue;
+        }
+        arena_remove_free_region_locked(free_region);
+        for (guint j = 0; j < kept->len; j++) {
+            const ArenaRegion *piece = &g_array_index(kept, ArenaRegion, j);
+            arena_insert_free_region_locked(piece->pos, piece->end);
+        }
+    }
+}
+
+static void
+arena_cut_releasing_free_chunks_locked(void) {
+    g_autoptr(GArray) kept = g_array_new(FALSE, FALSE, sizeof(ArenaRegion));
+    for (GSList *l = arena.free_chunks; l; l = l->next) {
+        ArenaRegion *chunk = l->data;
+        arena_cut_releasing_chunks_locked(chunk->pos, chunk->end, kept);
+    }
+    g_slist_free_full(g_steal_pointer(&arena.free_chunks), g_free);
+    for (guint i = kept->len; i > 0; i--) {
+        ArenaRegion *chunk = g_new0(ArenaRegion, 1);
+        *chunk = g_array_index(kept, ArenaRegion, i - 1);
+        arena.free_chunks = g_slist_prepend(arena.free_chunks, chunk);
+    }
+}
+
+static int
+arena_cmp_chunk_idx(gconstpointer a, gconstpointer b) {
+    const uint32_t idx_a = *(const uint32_t *)a;
+    const uint32_t idx_b = *(const uint32_t *)b;
+    return idx_a < idx_b ? -1 : idx_a > idx_b;
+}
+
+// Returns the memory of all empty chunks to the system. Their freed items and regions are dropped and each run of
+// empty chunks becomes a single free region, which is reused for items of any size.
+static void
+arena_release_empty_chunks_locked(void) {
+    for (size_t size_class = 1; size_class < ARENA_NUM_SIZE_CLASSES; size_class++) {
+        const size_t size = size_class * FSEARCH_ARENA_ALIGNMENT;
+        uint32_t *next = &arena.free_lists[size_class];
+        while (*next != FSEARCH_ARENA_ID_NONE) {
+            uint8_t *item = fsearch_arena_get_item(*next);
+            if (arena_item_is_releasing_locked(item, size)) {
+                // Bytes of the item in a chunk which stays are lost until that chunk becomes empty as well
+                memcpy(next, item, sizeof(uint32_t));
+                g_atomic_int_add(&arena.num_free[size_class], -1);
+                arena.num_free_small -= size;
+            }
+            else {
+                next = (uint32_t *)item;
+            }
+        }
+    }
+    arena_cut_releasing_free_regions_locked();
+    arena_cut_releasing_free_chunks_locked();
+
+    g_array_sort(arena.empty_chunks, arena_cmp_chunk_idx);
+    g_autoptr(GArray) empty_chunks = g_steal_pointer(&arena.empty_chunks);
+    arena.empty_chunks = g_array_new(FALSE, FALSE, sizeof(uint32_t));
+    for (uint32_t i = 0; i < empty_chunks->len;) {
+        const uint32_t first = g_array_index(empty_chunks, uint32_t, i++);
+        arena.chunks[first].flags &= ~ARENA_CHUNK_QUEUED;
+        if (!arena_chunk_is_releasing_locked(first)) {
+            continue;
+        }
+        uint32_t last = first;
+        while (i < empty_chunks->len && g_array_index(empty_chunks, uint32_t, i) == last + 1
+               && arena_chunk_is_releasing_locked(last + 1)) {
+            last = g_array_index(empty_chunks, uint32_t, i++);
+        }
+        for (uint32_t idx = first; idx <= last; idx++) {
+            arena.chunks[idx].flags &= ~(ARENA_CHUNK_EMPTY | ARENA_CHUNK_QUEUED);
+            arena.num_empty_chunks--;
+        }
+        uint8_t *pos = fsearch_arena_base + (size_t)first * ARENA_CHUNK_SIZE;
+        uint8_t *end = fsearch_arena_base + ((size_t)last + 1) * ARENA_CHUNK_SIZE;
+        madvise(pos, end - pos, MADV_DONTNEED);
+        if (end - fsearch_arena_base >= arena.num_used) {
+            // Nothing after the chunks was handed out yet, so they're simply handed out again
+            arena.num_used = pos - fsearch_arena_base;
+        }
+        else {
+            arena_add_free_region_locked(pos, end);
+        }
+    }
+}
+
+// Releasing walks all free lists, so it waits until the empty chunks make up half of the freed small items. The
+// items in the empty chunks are dropped from the lists, so the walks take linear time in the number of freed items
+// overall. It's checked once per batch of frees.
+static void
+arena_release_empty_chunks_if_needed_locked(void) {
+    if (arena.num_empty_chunks > 0 && (size_t)arena.num_empty_chunks * ARENA_CHUNK_SIZE >= arena.num_free_small / 2) {
+        arena_release_empty_chunks_locked();
+    }
+}
+
+// Returns `size` bytes of a freed region, or NULL. Every region in a larger bin than the one of `size` fits, the
+// smallest of those bins is used. Only if they're all empty, the regions in the bin of `size` are searched.
+static uint8_t *
+arena_take_large_locked(size_t size) {
+    const uint32_t bin = arena_get_large_bin(size);
+    ArenaFreeRegion *region = NULL;
+    for (uint32_t i = bin + 1; i < ARENA_NUM_LARGE_BINS && !region; i++) {
+        region = arena.free_large_bins[i];
+    }
+    for (ArenaFreeRegion *r = arena.free_large_bins[bin]; r && !region; r = r->next) {
+        if ((size_t)(r->end - r->pos) >= size) {
+            region = r;
+        }
+    }
+    if (!region) {
+        return NULL;
+    }
+
+    uint8_t *item = region->pos;
+    uint8_t *end = region->end;
+    arena_remove_free_region_locked(region);
+    if (item + size < end) {
+        arena_insert_free_region_locked(item + size, end);
+    }
+    arena_mark_used_locked(item, size);
+    return item;
+}
+
+// Returns the index of the mapping which contains `item`, or -1
+static gint
+arena_find_mapping_locked(const uint8_t *item) {
+    guint lo = 0;
+    guint hi = arena.mappings->len;
+    while (lo < hi) {
+        const guint mid = lo + (hi - lo) / 2;
+        ArenaMapping *mapping = g_ptr_array_index(arena.mappings, mid);
+        if (item < mapping->start) {
+            hi = mid;
+        }
+        else if (item >= mapping->end) {
+            lo = mid + 1;
+        }
+        else {
+            return (gint)mid;
+        }
+    }
+    return -1;
+}
+
+static void
+arena_release_mapping_locked(guint idx);
+
+static void
+arena_free_item_locked(uint8_t *item, size_t size) {
+    const gint mapping_idx = arena.mappings->len > 0 ? arena_find_mapping_locked(item) : -1;
+    if (mapping_idx >= 0) {
+        ArenaMapping *mapping = g_ptr_array_index(arena.mappings, mapping_idx);
+        if (--mapping->num_items == 0) {
+            arena_release_mapping_locked(mapping_idx);
+        }
+    }
+    else {
+        arena_free_locked(item, size);
+    }
+}
+
+// Hands the items the thread freed back to the arena
+static void
+arena_thread_flush_locked(ArenaThread *thread) {
+    if (thread->num_freed == 0) {
+        return;
+    }
+    for (uint32_t i = 0; i < thread->num_freed; i++) {
+        arena_free_item_locked(thread->freed[i].item, thread->freed[i].size);
+    }
+    thread->num_freed = 0;
+    arena_release_empty_chunks_if_needed_locked();
+}
+
+static ArenaThread *
+arena_thread_get(void) {
+    ArenaThread *thread = g_private_get(&arena_thread);
+    if (G_UNLIKELY(!thread)) {
+        thread = g_new0(ArenaThread, 1);
+        g_private_set(&arena_thread, thread);
+    }
+    return thread;
+}
+
+static void
+arena_thread_free(ArenaThread *thread) {
+    g_mutex_lock(&arena.mutex);
+    arena_thread_flush_locked(thread);
+    if (thread->chunk.pos != thread->chunk.end) {
+        arena_mark_free_locked(thread->chunk.pos, thread->chunk.end - thread->chunk.pos);
+        ArenaRegion *chunk = g_new0(ArenaRegion, 1);
+        *chunk = thread->chunk;
+        arena.free_chunks = g_slist_prepend(arena.free_chunks, chunk);
+    }
+    g_mutex_unlock(&arena.mutex);
+    g_free(thread);
+}
+
+static void *
+arena_alloc_small(size_t size) {
+    const size_t size_class = size / FSEARCH_ARENA_ALIGNMENT;
+    ArenaThread *thread = arena_thread_get();
+    // The items the thread freed itself are reused first
+    if (thread->num_freed > 0 || g_atomic_int_get(&arena.num_free[size_class]) > 0) {
+        uint8_t *item = NULL;
+        g_mutex_lock(&arena.mutex);
+        arena_thread_flush_locked(thread);
+        const uint32_t id = arena.free_lists[size_class];
+        if (id != FSEARCH_ARENA_ID_NONE) {
+            item = fsearch_arena_get_item(id);
+            memcpy(&arena.free_lists[size_class], item, sizeof(uint32_t));
+            g_atomic_int_add(&arena.num_free[size_class], -1);
+            arena.num_free_small -= size;
+            arena_mark_used_locked(item, size);
+        }
+        g_mutex_unlock(&arena.mutex);
+        if (item) {
+            return memset(item, 0, size);
+        }
+    }
+
+    ArenaRegion *chunk = &thread->chunk;
+    if (G_UNLIKELY((size_t)(chunk->end - chunk->pos) < size)) {
+        g_mutex_lock(&arena.mutex);
+        // Take the rest of an exited thread's chunk, or a new one from the arena
+        do {
+            // The rest of the chunk is smaller than `size`, so it fits into a free list
+            if (chunk->pos != chunk->end) {
+                arena_free_small_locked(chunk->pos, chunk->end - chunk->pos);
+            }
+            if (arena.free_chunks) {
+                ArenaRegion *free_chunk = arena.free_chunks->data;
+                arena.free_chunks = g_slist_delete_link(arena.free_chunks, arena.free_chunks);
+                *chunk = *free_chunk;
+                g_free(free_chunk);
+                arena_mark_used_locked(chunk->pos, chunk->end - chunk->pos);
+            }
+            else {
+                chunk->pos = arena_take_large_locked(ARENA_CHUNK_SIZE);
+                if (!chunk->pos) {
+                    chunk->pos = arena_carve_locked(ARENA_CHUNK_SIZE);
+                }
+                if (G_UNLIKELY(!chunk->pos)) {
+                    chunk->end = NULL;
+                    g_mutex_unlock(&arena.mutex);
+                    return NULL;
+                }
+                chunk->end = chunk->pos + ARENA_CHUNK_SIZE;
+            }
+        } while ((size_t)(chunk->end - chunk->pos) < size);
+        g_mutex_unlock(&arena.mutex);
+    }
+    uint8_t *item = chunk->pos;
+    chunk->pos += size;
+    return memset(item, 0, size);
+}
+
+static void *
+arena_alloc_large(size_t size) {
+    ArenaThread *thread = arena_thread_get();
+    g_mutex_lock(&arena.mutex);
+    arena_thread_flush_locked(thread);
+    uint8_t *item = arena_take_large_locked(size);
+    if (!item) {
+        item = arena_carve_locked(size);
+    }
+    g_mutex_unlock(&arena.mutex);
+    return item ? memset(item, 0, size) : NULL;
+}
+
+void *
+fsearch_arena_alloc(size_t size) {
+    arena_init();
+
+    size = arena_round_up(size);
+    return size <= ARENA_MAX_SMALL_SIZE ? arena_alloc_small(size) : arena_alloc_large(size);
+}
+
+// Replaces the file mapping with fresh memory, which can be reused like any freed region
+static void
+arena_release_mapping_locked(guint idx) {
+    ArenaMapping *mapping = g_ptr_array_steal_index(arena.mappings, idx);
+    const size_t size = mapping->end - mapping->start;
+    if (mmap(mapping->start,
+             size,
+             PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED,
+             -1,
+             0)
+        == MAP_FAILED) {
+        g_error("[arena] failed to release file mapping");
+    }
+    arena_free_locked(mapping->start, size);
+    g_free(mapping);
+}
+
+void
+fsearch_arena_free(void *item, size_t size) {
+    if (!item) {
+        return;
+    }
+    ArenaThread *thread = arena_thread_get();
+    thread->freed[thread->num_freed].item = item;
+    thread->freed[thread->num_freed].size = arena_round_up(size);
+    if (++thread->num_freed == ARENA_FREE_BATCH_SIZE) {
+        g_mutex_lock(&arena.mutex);
+        arena_thread_flush_locked(thread);
+        g_mutex_unlock(&arena.mutex);
+    }
+}
+
+void *
+fsearch_arena_map_file(int fd, off_t offset, size_t size, uint32_t num_items) {
+    g_return_val_if_fail(fd >= 0, NULL);
+    g_return_val_if_fail(num_items > 0, NULL);
+
+    arena_init();
+
+    const long page_size = sysconf(_SC_PAGESIZE);
+    if (page_size <= 0 || offset % page_size != 0 || size == 0) {
+        return NULL;
+    }
+    const size_t map_size = (size + page_size - 1) & ~((size_t)page_size - 1);
+
+    g_mutex_lock(&arena.mutex);
+    // The mapping has to start at a page boundary, the space which is skipped for that is freed right away
+    const size_t gap = (page_size - arena.num_used % page_size) % page_size;
+    uint8_t *gap_start = gap > 0 ? arena_carve_locked(gap) : NULL;
+    if (gap_start) {
+        arena_free_locked(gap_start, gap);
+    }
+    uint8_t *start = (gap == 0 || gap_start) ? arena_carve_locked(map_size) : NULL;
+    if (!start) {
+        g_mutex_unlock(&arena.mutex);
+        return NULL;
+    }
+    if (mmap(start, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, offset) == MAP_FAILED) {
+        g_debug("[arena] failed to map file");
+        // A failed fixed mapping might have replaced the memory anyway
+        if (mmap(start,
+                 map_size,
+                 PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED,
+                 -1,
+                 0)
+            == MAP_FAILED) {
+            g_error("[arena] failed to restore memory");
+        }
+        arena_free_locked(start, map_size);
+        g_mutex_unlock(&arena.mutex);
+        return NULL;
+    }
+
+    ArenaMapping *mapping = g_new0(ArenaMapping, 1);
+    mapping->start = start;
+    mapping->end = start + map_size;
+    mapping->num_items = num_items;
+    guint idx = arena.mappings->len;
+    while (idx > 0 && ((ArenaMapping *)g_ptr_array_index(arena.mappings, idx - 1))->start > start) {
+        idx--;
+    }
+    g_ptr_array_insert(arena.mappings, (gint)idx, mapping);
+    g_mutex_unlock(&arena.mutex);
+    return start;
+}
+
+void
+fsearch_arena_unmap(void *mapping) {
+    g_return_if_fail(mapping);
+
+    ArenaThread *thread = arena_thread_get();
+    g_mutex_lock(&arena.mutex);
+    arena_thread_flush_locked(thread);
+    const gint idx = arena_find_mapping_locked(mapping);
+    if (idx >= 0 && ((ArenaMapping *)g_ptr_array_index(arena.mappings, idx))->start == (uint8_t *)mapping) {
+        arena_release_mapping_locked(idx);
+        arena_release_empty_chunks_if_needed_locked();
+    }
+    g_mutex_unlock(&arena.mutex);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <glib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+// A process wide allocator for small items which have to be referenced by a 32-bit id instead of a pointer, e.g.
+// database entries in sort indices. All items live in one reserved range of address space, so the id of an item is
+// simply its offset in units of FSEARCH_ARENA_ALIGNMENT and turning an id back into a pointer needs no lookup table.
+
+#define FSEARCH_ARENA_ALIGNMENT 8
+// No item ever has this id, it stands for NULL
+#define FSEARCH_ARENA_ID_NONE 0
+
+// Start of the reserved range, set by the first call to fsearch_arena_alloc()
+extern uint8_t *fsearch_arena_base;
+
+// Returns `size` bytes of zeroed memory, aligned to FSEARCH_ARENA_ALIGNMENT, or NULL once the arena is out of space
+void *
+fsearch_arena_alloc(size_t size);
+
+// Frees an item which was allocated with the same `size`. Every thread collects the items it frees and hands them
+// back to the arena in batches, its next allocation reuses them right away though. Once nothing in a chunk of the
+// arena is used anymore, its memory is returned to the system and its space can be reused for items of any size.
+void
+fsearch_arena_free(void *item, size_t size);
+
+// Maps `size` bytes of the file `fd` from `offset` on, which must be a multiple of the page size, into the arena. The
+// mapping is private, so its items can be changed, which copies the pages they're on, and get freed like any other
+// item. The whole mapping is released once all `num_items` items in it were freed. Returns NULL on failure, e.g. when
+// the arena is out of space.
+void *
+fsearch_arena_map_file(int fd, off_t offset, size_t size, uint32_t num_items);
+
+// Releases a mapping of fsearch_arena_map_file(), no matter how many of its items weren't freed yet. None of its items
+// may be freed afterwards, and frees of them on other threads might not have been handed back yet.
+void
+fsearch_arena_unmap(void *mapping);
+
+static inline uint32_t
+fsearch_arena_get_id(const void *item) {
+    if (G_UNLIKELY(!item)) {
+        return FSEARCH_ARENA_ID_NONE;
+    }
+    return (uint32_t)(((const uint8_t *)item - fsearch_arena_base) / FSEARCH_ARENA_ALIGNMENT);
+}
+
+static inline void *
+fsearch_arena_get_item(uint32_t id) {
+    if (G_UNLIKELY(id == FSEARCH_ARENA_ID_NONE)) {
+        return NULL;
+    }
+    return fsearch_arena_base + (size_t)id * FSEARCH_ARENA_ALIGNMENT;
+}
@@ -19,6 +19,7 @@
 #define G_LOG_DOMAIN "fsearch-dynamic-array"
 
 #include "fsearch_array.h"
+#include "fsearch_arena.h"
 #include <glib.h>
 #include <math.h>
 #include <stdlib.h>
@@ -89,13 +90,31 @@ darray_unref(DynamicArray *array) {
 }
 
 typedef struct {
-    DynamicArray *m1;
-    DynamicArray *m2;
+    // Sorts the range [start_idx, end_idx) of `dest`, `src` has to hold the same items in that range
+    DynamicArray *src;
     DynamicArray *dest;
-    gpointer user_data;
+    uint32_t start_idx;
+    uint32_t end_idx;
+    GCancellable *cancellable;
     DynamicArrayCompareDataFunc comp_func;
+    gpointer comp_data;
 } DynamicArraySortContext;
 
+typedef struct {
+    // Writes the items [out_start, out_end) of the merged sorted runs [start_idx, center_idx) and
+    // [center_idx, end_idx) of `src` to `dest`, starting at `dest[start_idx + out_start]`
+    DynamicArray *src;
+    DynamicArray *dest;
+    uint32_t start_idx;
+    uint32_t center_idx;
+    uint32_t end_idx;
+    uint32_t out_start;
+    uint32_t out_end;
+    GCancellable *cancellable;
+    DynamicArrayCompareDataFunc comp_func;
+    gpointer comp_data;
+} DynamicArrayMergeContext;
+
 static void
 insertion_sort_range(DynamicArray *array,
                      uint32_t start_idx,
@@ -191,46 +210,73 @@ merge_sort(DynamicArray *to_sort, GCancellable *cancellable, DynamicArrayCompare
 static void
 sort_thread(gpointer data, gpointer user_data) {
     DynamicArraySortContext *ctx = data;
-    GCancellable *cancellable = user_data;
-    merge_sort(ctx->dest, cancellable, (DynamicArrayCompareDataFunc)ctx->comp_func, ctx->user_data);
+    split_merge(ctx->src, ctx->dest, ctx->start_idx, ctx->end_idx, ctx->cancellable, ctx->comp_func, ctx->comp_data);
 }
 
-static inline void
-add_remaining_items(DynamicArray *dest, DynamicArray *source, uint32_t start_idx) {
-    const uint32_t remaining_items = source->num_items - start_idx;
-    if (remaining_items > 0) {
-        darray_add_items(dest, &source->data[start_idx], remaining_items);
+// Returns how many of the first `k` items of the merged output come from the left run [start_idx, center_idx), when
+// it's merged with the right run [center_idx, end_idx). Like in merge(), ties are taken from the left run first.
+static uint32_t
+merge_path_split(DynamicArray *src,
+                 uint32_t start_idx,
+                 uint32_t center_idx,
+                 uint32_t end_idx,
+                 uint32_t k,
+                 DynamicArrayCompareDataFunc comp_func,
+                 gpointer comp_data) {
+    const uint32_t left_len = center_idx - start_idx;
+    const uint32_t right_len = end_idx - center_idx;
+
+    uint32_t lo = k > right_len ? k - right_len : 0;
+    uint32_t hi = MIN(k, left_len);
+    while (lo < hi) {
+        const uint32_t mid = lo + (hi - lo) / 2;
+        if (comp_func(&src->data[start_idx + mid], &src->data[center_idx + k - mid - 1], comp_data) < 1) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
     }
+    return lo;
 }
 
 static void
 merge_thread(gpointer data, gpointer user_data) {
-    DynamicArraySortContext *ctx = data;
-    uint32_t left_idx = 0;
-    uint32_t right_idx = 0;
-    const uint32_t left_size = ctx->m1->num_items;
-    const uint32_t right_size = ctx->m2->num_items;
-
-    // Merge arrays while both have elements
-    while (left_idx < left_size && right_idx < right_size) {
-        void *left_item = darray_get_item(ctx->m1, left_idx);
-        void *right_item = darray_get_item(ctx->m2, right_idx);
-
-        const int comparison = ctx->comp_func(&left_item, &right_item, ctx->user_data);
+    DynamicArrayMergeContext *ctx = data;
+    if (g_cancellable_is_cancelled(ctx->cancellable)) {
+        return;
+    }
 
-        if (comparison <= 0) {
-            darray_add_item(ctx->dest, left_item);
-            left_idx++;
+    const uint32_t left_start = merge_path_split(ctx->src,
+                                                 ctx->start_idx,
+                                                 ctx->center_idx,
+                                                 ctx->end_idx,
+                                                 ctx->out_start,
+                                                 ctx->comp_func,
+                                                 ctx->comp_data);
+    const uint32_t left_end = merge_path_split(ctx->src,
+                                               ctx->start_idx,
+                                               ctx->center_idx,
+                                               ctx->end_idx,
+                                               ctx->out_end,
+                                               ctx->comp_func,
+                                               ctx->comp_data);
+
+    void **src = ctx->src->data;
+    void **dest = ctx->dest->data;
+    uint32_t i = ctx->start_idx + left_start;
+    uint32_t j = ctx->center_idx + (ctx->out_start - left_start);
+    const uint32_t i_end = ctx->start_idx + left_end;
+    const uint32_t j_end = ctx->center_idx + (ctx->out_end - left_end);
+
+    for (uint32_t k = ctx->start_idx + ctx->out_start; k < ctx->start_idx + ctx->out_end; k++) {
+        if (i < i_end && (j >= j_end || ctx->comp_func(&src[i], &src[j], ctx->comp_data) < 1)) {
+            dest[k] = src[i++];
         }
         else {
-            darray_add_item(ctx->dest, right_item);
-            right_idx++;
+            dest[k] = src[j++];
         }
     }
-
-    // Add remaining elements from either array
-    add_remaining_items(ctx->dest, ctx->m1, left_idx);
-    add_remaining_items(ctx->dest, ctx->m2, right_idx);
 }
 
 DynamicArray *
@@ -358,6 +404,24 @@ darray_steal_items(DynamicArray *array, DynamicArrayStealFunc func, void *data)
     return g_steal_pointer(&stolen_entries);
 }
 
+uint32_t
+darray_drop_items(DynamicArray *array, DynamicArrayStealFunc func, void *data) {
+    g_assert(array);
+    g_assert(array->data);
+
+    uint32_t num_kept = 0;
+    for (uint32_t i = 0; i < array->num_items; ++i) {
+        void *item = array->data[i];
+        if (!func(item, data)) {
+            array->data[num_kept++] = item;
+        }
+    }
+    const uint32_t num_dropped = array->num_items - num_kept;
+    array->num_items = num_kept;
+
+    return num_dropped;
+}
+
 static uint32_t
 darray_steal_or_drop(DynamicArray *array, uint32_t index, uint32_t n_elements, DynamicArray *dest) {
     g_assert(array);
@@ -565,54 +629,9 @@ new_array_from_data(void **data, uint32_t num_items) {
     return array;
 }
 
-static GArray *
-merge_sorted(GArray *merge_me, DynamicArrayCompareDataFunc comp_func, gpointer comp_data, GCancellable *cancellable) {
-    if (merge_me->len == 1) {
-        return merge_me;
-    }
-    if (g_cancellable_is_cancelled(cancellable)) {
-        return merge_me;
-    }
-    const uint32_t num_threads = merge_me->len / 2;
-
-    g_autoptr(GArray) merged_data = g_array_sized_new(TRUE, TRUE, sizeof(DynamicArraySortContext), num_threads);
-    GThreadPool *merge_pool = g_thread_pool_new(merge_thread, NULL, (gint)num_threads, FALSE, NULL);
-
-    for (int i = 0; i < num_threads; ++i) {
-        DynamicArraySortContext *c1 = &g_array_index(merge_me, DynamicArraySortContext, 2 * i);
-        DynamicArraySortContext *c2 = &g_array_index(merge_me, DynamicArraySortContext, 2 * i + 1);
-        DynamicArray *i1 = c1->dest;
-        DynamicArray *i2 = c2->dest;
-
-        DynamicArraySortContext merge_ctx = {};
-        merge_ctx.m1 = i1;
-        merge_ctx.m2 = i2;
-        merge_ctx.comp_func = comp_func;
-        merge_ctx.user_data = comp_data;
-        merge_ctx.dest = darray_new(i1->num_items + i2->num_items);
-
-        g_array_insert_val(merged_data, i, merge_ctx);
-
-        g_thread_pool_push(merge_pool, &g_array_index(merged_data, DynamicArraySortContext, i), NULL);
-    }
-
-    g_thread_pool_free(g_steal_pointer(&merge_pool), FALSE, TRUE);
-
-    for (int i = 0; i < merge_me->len; i++) {
-        DynamicArraySortContext *c = &g_array_index(merge_me, DynamicArraySortContext, i);
-        if (c && c->dest) {
-            g_clear_pointer(&c->dest, darray_unref);
-        }
-    }
-    g_clear_pointer(&merge_me, g_array_unref);
-
-    return merge_sorted(g_steal_pointer(&merged_data), comp_func, comp_data, cancellable);
-}
-
 static int
-get_ideal_thread_count() {
-    // int num_processors = 1;
-    const int num_processors = (int)g_get_num_processors();
+get_ideal_thread_count(int max_threads) {
+    const int num_processors = MAX(MIN((int)g_get_num_processors(), max_threads), 1);
 
     const int e = floor(log2(num_processors));
     const int num_threads = (int)pow(2, e);
@@ -624,50 +643,91 @@ darray_sort_multi_threaded(DynamicArray *array,
                            DynamicArrayCompareDataFunc comp_func,
                            GCancellable *cancellable,
                            void *data) {
-    const int num_threads = get_ideal_thread_count();
+    darray_sort_with_max_threads(array, comp_func, MAX_SORT_THREADS, cancellable, data);
+}
+
+void
+darray_sort_with_max_threads(DynamicArray *array,
+                             DynamicArrayCompareDataFunc comp_func,
+                             int max_threads,
+                             GCancellable *cancellable,
+                             void *data) {
+    const int num_threads = get_ideal_thread_count(max_threads);
     if (num_threads < 2 || num_threads > array->num_items) {
         return darray_sort(array, comp_func, cancellable, data);
     }
 
     g_debug("[sort] sorting with %d threads", num_threads);
 
-    const int num_items_per_thread = (int)(array->num_items / num_threads);
-    GThreadPool *sort_pool = g_thread_pool_new(sort_thread, cancellable, num_threads, FALSE, NULL);
+    // Sort `num_threads` slices of the array in parallel and then merge pairs of sorted runs until only one is left.
+    // Every merge is split into parts of the same size with merge path partitioning, so each round keeps all threads
+    // busy instead of halving the number of threads, which would leave the final merge to a single thread.
+    // The work happens on copies, so the array stays untouched if sorting gets cancelled.
+    g_autoptr(DynamicArray) runs = darray_copy_borrowed(array);
+    g_autoptr(DynamicArray) scratch = darray_copy_borrowed(array);
 
-    g_autoptr(GArray) sort_ctx_array = g_array_sized_new(TRUE, TRUE, sizeof(DynamicArraySortContext), num_threads);
+    g_autofree uint32_t *run_bounds = g_new0(uint32_t, num_threads + 1);
+    const uint32_t num_items_per_thread = array->num_items / num_threads;
+    for (int i = 0; i < num_threads; ++i) {
+        run_bounds[i] = i * num_items_per_thread;
+    }
+    run_bounds[num_threads] = array->num_items;
 
-    int start = 0;
+    g_autofree DynamicArraySortContext *sort_ctx = g_new0(DynamicArraySortContext, num_threads);
+    GThreadPool *sort_pool = g_thread_pool_new(sort_thread, NULL, num_threads, FALSE, NULL);
     for (int i = 0; i < num_threads; ++i) {
-        DynamicArraySortContext sort_ctx;
-        sort_ctx.dest = new_array_from_data(array->data + start,
-                                            i == num_threads - 1 ? array->num_items - start : num_items_per_thread);
-        sort_ctx.comp_func = comp_func;
-        sort_ctx.user_data = data;
-        start += num_items_per_thread;
-        g_array_insert_val(sort_ctx_array, i, sort_ctx);
-        g_thread_pool_push(sort_pool, &g_array_index(sort_ctx_array, DynamicArraySortContext, i), NULL);
+        sort_ctx[i].src = scratch;
+        sort_ctx[i].dest = runs;
+        sort_ctx[i].start_idx = run_bounds[i];
+        sort_ctx[i].end_idx = run_bounds[i + 1];
+        sort_ctx[i].cancellable = cancellable;
+        sort_ctx[i].comp_func = comp_func;
+        sort_ctx[i].comp_data = data;
+        g_thread_pool_push(sort_pool, &sort_ctx[i], NULL);
     }
     g_thread_pool_free(g_steal_pointer(&sort_pool), FALSE, TRUE);
 
-    g_autoptr(GArray) result = merge_sorted(g_steal_pointer(&sort_ctx_array), comp_func, data, cancellable);
-
-    if (result) {
-        // Apply results if sorting wasn't canceled
-        if (!g_cancellable_is_cancelled(cancellable)) {
-            DynamicArraySortContext *c = &g_array_index(result, DynamicArraySortContext, 0);
-            g_clear_pointer(&array->data, free);
-            array->data = g_steal_pointer(&c->dest->data);
-            array->num_items = c->dest->num_items;
-            array->max_items = c->dest->max_items;
+    g_autofree DynamicArrayMergeContext *merge_ctx = g_new0(DynamicArrayMergeContext, num_threads);
+    for (uint32_t num_runs = num_threads; num_runs > 1 && !g_cancellable_is_cancelled(cancellable); num_runs /= 2) {
+        const uint32_t num_merges = num_runs / 2;
+        const uint32_t num_parts_per_merge = num_threads / num_merges;
+
+        GThreadPool *merge_pool = g_thread_pool_new(merge_thread, NULL, num_threads, FALSE, NULL);
+        for (uint32_t m = 0; m < num_merges; ++m) {
+            const uint32_t start_idx = run_bounds[2 * m];
+            const uint32_t center_idx = run_bounds[2 * m + 1];
+            const uint32_t end_idx = run_bounds[2 * m + 2];
+            const uint64_t len = end_idx - start_idx;
+
+            for (uint32_t p = 0; p < num_parts_per_merge; ++p) {
+                DynamicArrayMergeContext *ctx = &merge_ctx[m * num_parts_per_merge + p];
+                ctx->src = runs;
+                ctx->dest = scratch;
+                ctx->start_idx = start_idx;
+                ctx->center_idx = center_idx;
+                ctx->end_idx = end_idx;
+                ctx->out_start = (uint32_t)(len * p / num_parts_per_merge);
+                ctx->out_end = (uint32_t)(len * (p + 1) / num_parts_per_merge);
+                ctx->cancellable = cancellable;
+                ctx->comp_func = comp_func;
+                ctx->comp_data = data;
+                g_thread_pool_push(merge_pool, ctx, NULL);
+            }
         }
+        g_thread_pool_free(g_steal_pointer(&merge_pool), FALSE, TRUE);
 
-        // Make sure to clean up result array entries; in case of cancellation, there can be more than one entry
-        for (guint i = 0; i < result->len; i++) {
-            DynamicArraySortContext *ctx = &g_array_index(result, DynamicArraySortContext, i);
-            if (ctx && ctx->dest) {
-                g_clear_pointer(&ctx->dest, darray_unref);
-            }
+        for (uint32_t m = 0; m < num_merges; ++m) {
+            run_bounds[m] = run_bounds[2 * m];
         }
+        run_bounds[num_merges] = array->num_items;
+
+        DynamicArray *tmp = runs;
+        runs = scratch;
+        scratch = tmp;
+    }
+
+    if (!g_cancellable_is_cancelled(cancellable)) {
+        memcpy(array->data, runs->data, array->num_items * sizeof(void *));
     }
 }
 
@@ -687,6 +747,188 @@ darray_sort(DynamicArray *array, DynamicArrayCompareDataFunc comp_func, GCancell
     }
 }
 
+// darray_sort_by_key() sorts 8 bits of the keys per pass
+#define RADIX_SORT_BITS 8
+#define RADIX_SORT_NUM_BUCKETS (1 << RADIX_SORT_BITS)
+#define RADIX_SORT_NUM_PASSES (64 / RADIX_SORT_BITS)
+// Runs of equal keys with at least this many items are sorted with several threads
+#define RADIX_SORT_PARALLEL_RUN_THRESHOLD 65536
+
+typedef struct {
+    uint64_t key;
+    void *item;
+} DynamicArrayKeyedItem;
+
+static void
+sort_runs_of_equal_keys(DynamicArray *array,
+                        const DynamicArrayKeyedItem *sorted,
+                        DynamicArrayCompareDataFunc comp_func,
+                        GCancellable *cancellable,
+                        void *data) {
+    const uint32_t num_items = array->num_items;
+    uint32_t run_start = 0;
+    for (uint32_t i = 1; i <= num_items; ++i) {
+        if (i < num_items && sorted[i].key == sorted[run_start].key) {
+            continue;
+        }
+        const uint32_t run_len = i - run_start;
+        if (run_len <= MERGE_SORT_THRESHOLD * 4) {
+            insertion_sort_range(array, run_start, i, comp_func, data);
+        }
+        else {
+            g_autoptr(DynamicArray) run = new_array_from_data(array->data + run_start, run_len);
+            if (run_len >= RADIX_SORT_PARALLEL_RUN_THRESHOLD) {
+                // Common prefixes like "IMG_" or "libgtk-3" can leave most of the array in a single run
+                darray_sort_multi_threaded(run, comp_func, cancellable, data);
+            }
+            else {
+                merge_sort(run, cancellable, comp_func, data);
+            }
+            memcpy(array->data + run_start, run->data, run_len * sizeof(void *));
+        }
+        run_start = i;
+    }
+}
+
+static void
+radix_sort(DynamicArray *array,
+           DynamicArrayKeyFunc key_func,
+           DynamicArrayCompareDataFunc comp_func,
+           GCancellable *cancellable,
+           void *data) {
+    g_assert(array);
+    g_assert(array->data);
+    g_assert(key_func);
+
+    const uint32_t num_items = array->num_items;
+    if (num_items < 2) {
+        return;
+    }
+
+    // Extract every key only once and count the digits for all passes while doing so
+    g_autofree DynamicArrayKeyedItem *src = g_new(DynamicArrayKeyedItem, num_items);
+    g_autofree DynamicArrayKeyedItem *dst = g_new(DynamicArrayKeyedItem, num_items);
+    g_autofree uint32_t *counts = g_new0(uint32_t, RADIX_SORT_NUM_PASSES * RADIX_SORT_NUM_BUCKETS);
+    for (uint32_t i = 0; i < num_items; ++i) {
+        const uint64_t key = key_func(array->data[i], data);
+        src[i].key = key;
+        src[i].item = array->data[i];
+        for (uint32_t pass = 0; pass < RADIX_SORT_NUM_PASSES; ++pass) {
+            const uint32_t digit = (key >> (pass * RADIX_SORT_BITS)) & (RADIX_SORT_NUM_BUCKETS - 1);
+            counts[pass * RADIX_SORT_NUM_BUCKETS + digit]++;
+        }
+    }
+
+    for (uint32_t pass = 0; pass < RADIX_SORT_NUM_PASSES; ++pass) {
+        if (g_cancellable_is_cancelled(cancellable)) {
+            // Leave the array as it was
+            return;
+        }
+        const uint32_t shift = pass * RADIX_SORT_BITS;
+        uint32_t *bucket_offsets = counts + pass * RADIX_SORT_NUM_BUCKETS;
+        if (bucket_offsets[(src[0].key >> shift) & (RADIX_SORT_NUM_BUCKETS - 1)] == num_items) {
+            // All keys have the same digit, e.g. the high bytes of file sizes, so this pass wouldn't change anything
+            continue;
+        }
+
+        uint32_t offset = 0;
+        for (uint32_t i = 0; i < RADIX_SORT_NUM_BUCKETS; ++i) {
+            const uint32_t count = bucket_offsets[i];
+            bucket_offsets[i] = offset;
+            offset += count;
+        }
+        for (uint32_t i = 0; i < num_items; ++i) {
+            const uint32_t digit = (src[i].key >> shift) & (RADIX_SORT_NUM_BUCKETS - 1);
+            dst[bucket_offsets[digit]++] = src[i];
+        }
+
+        DynamicArrayKeyedItem *tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+
+    for (uint32_t i = 0; i < num_items; ++i) {
+        array->data[i] = src[i].item;
+    }
+
+    if (comp_func) {
+        sort_runs_of_equal_keys(array, src, comp_func, cancellable, data);
+    }
+}
+
+void
+darray_sort_by_key(DynamicArray *array, DynamicArrayKeyFunc key_func, GCancellable *cancellable, void *data) {
+    radix_sort(array, key_func, NULL, cancellable, data);
+}
+
+void
+darray_sort_by_key_with_ties(DynamicArray *array,
+                             DynamicArrayKeyFunc key_func,
+                             DynamicArrayCompareDataFunc comp_func,
+                             GCancellable *cancellable,
+                             void *data) {
+    g_assert(comp_func);
+    radix_sort(array, key_func, comp_func, cancellable, data);
+}
+
+// Restores the max-heap property of `heap` for the item at `idx`, whose children are heaps already
+static void
+heap_sift_down(void **heap, uint32_t num_items, uint32_t idx, DynamicArrayCompareDataFunc comp_func, void *data) {
+    while (true) {
+        const uint32_t left = 2 * idx + 1;
+        if (left >= num_items) {
+            return;
+        }
+        const uint32_t right = left + 1;
+        uint32_t largest = left;
+        if (right < num_items && comp_func(&heap[right], &heap[left], data) > 0) {
+            largest = right;
+        }
+        if (comp_func(&heap[largest], &heap[idx], data) <= 0) {
+            return;
+        }
+        void *tmp = heap[idx];
+        heap[idx] = heap[largest];
+        heap[largest] = tmp;
+        idx = largest;
+    }
+}
+
+DynamicArray *
+darray_get_first_sorted(DynamicArray *array,
+                        uint32_t num_items,
+                        DynamicArrayCompareDataFunc comp_func,
+                        GCancellable *cancellable,
+                        void *data) {
+    g_assert(array);
+    g_assert(comp_func);
+
+    num_items = MIN(num_items, array->num_items);
+    DynamicArray *first = darray_new(MAX(num_items, 1));
+    if (num_items == 0) {
+        return first;
+    }
+
+    // Keep the `num_items` smallest items seen so far in a max-heap, so every further item only has to be compared
+    // with the largest of them
+    darray_add_items(first, array->data, num_items);
+    for (int64_t i = num_items / 2 - 1; i >= 0; --i) {
+        heap_sift_down(first->data, num_items, (uint32_t)i, comp_func, data);
+    }
+    for (uint32_t i = num_items; i < array->num_items; ++i) {
+        if ((i & 0xffff) == 0 && g_cancellable_is_cancelled(cancellable)) {
+            break;
+        }
+        if (comp_func(&array->data[i], &first->data[0], data) < 0) {
+            first->data[0] = array->data[i];
+            heap_sift_down(first->data, num_items, 0, comp_func, data);
+        }
+    }
+
+    darray_sort(first, comp_func, cancellable, data);
+    return first;
+}
+
 bool
 darray_binary_search_with_data(DynamicArray *array,
                                void *item,
@@ -812,3 +1054,318 @@ darray_set_free_func(DynamicArray *array, GDestroyNotify free_func) {
     g_assert(array);
     array->item_free_func = free_func;
 }
+
+struct DynamicIdArray {
+    // number of items in array
+    uint32_t num_items;
+    // total size of array
+    uint32_t max_items;
+    // arena ids of the items
+    uint32_t *data;
+
+    GDestroyNotify item_free_func;
+
+    volatile int ref_count;
+};
+
+static void
+idarray_free_items(DynamicIdArray *array, uint32_t start_idx, uint32_t num_items) {
+    if (array->item_free_func && start_idx < array->num_items) {
+        const uint32_t end = start_idx + MIN(num_items, array->num_items - start_idx);
+        for (uint32_t i = start_idx; i < end; ++i) {
+            array->item_free_func(fsearch_arena_get_item(array->data[i]));
+        }
+    }
+}
+
+static void
+idarray_free(DynamicIdArray *array) {
+    if (array == NULL) {
+        return;
+    }
+    idarray_free_items(array, 0, array->num_items);
+
+    g_clear_pointer(&array->data, free);
+    g_clear_pointer(&array, free);
+}
+
+DynamicIdArray *
+idarray_new(size_t num_items) {
+    DynamicIdArray *new = calloc(1, sizeof(DynamicIdArray));
+    g_assert(new);
+
+    // Allocate at least one item, so `data` is never NULL
+    new->max_items = MAX(num_items, 1);
+    new->num_items = 0;
+
+    new->data = calloc(new->max_items, sizeof(uint32_t));
+    g_assert(new->data);
+
+    new->ref_count = 1;
+
+    return new;
+}
+
+DynamicIdArray *
+idarray_new_full(size_t num_items, GDestroyNotify item_free_func) {
+    DynamicIdArray *new = idarray_new(num_items);
+    new->item_free_func = item_free_func;
+    return new;
+}
+
+DynamicIdArray *
+idarray_ref(DynamicIdArray *array) {
+    if (!array || g_atomic_int_get(&array->ref_count) <= 0) {
+        return NULL;
+    }
+    g_atomic_int_inc(&array->ref_count);
+    return array;
+}
+
+void
+idarray_unref(DynamicIdArray *array) {
+    if (!array || g_atomic_int_get(&array->ref_count) <= 0) {
+        return;
+    }
+    if (g_atomic_int_dec_and_test(&array->ref_count)) {
+        g_clear_pointer(&array, idarray_free);
+    }
+}
+
+void
+idarray_set_free_func(DynamicIdArray *array, GDestroyNotify free_func) {
+    g_assert(array);
+    array->item_free_func = free_func;
+}
+
+uint32_t
+idarray_get_num_items(DynamicIdArray *array) {
+    g_assert(array);
+
+    return array->num_items;
+}
+
+void *
+idarray_get_item(DynamicIdArray *array, uint32_t idx) {
+    g_assert(array);
+
+    if (idx >= array->num_items) {
+        return NULL;
+    }
+    return fsearch_arena_get_item(array->data[idx]);
+}
+
+DynamicIdArray *
+idarray_get_range(DynamicIdArray *array, uint32_t start_idx, uint32_t num_items) {
+    g_assert(array);
+    g_assert(start_idx < array->num_items);
+
+    num_items = MIN(array->num_items - start_idx, num_items);
+
+    DynamicIdArray *range = idarray_new(num_items);
+    memcpy(range->data, array->data + start_idx, num_items * sizeof(uint32_t));
+    range->num_items = num_items;
+
+    return range;
+}
+
+static void
+idarray_expand(DynamicIdArray *array, size_t min) {
+    const size_t old_max_items = array->max_items;
+    const size_t expand_rate = MAX(array->max_items / 2, min - old_max_items);
+    array->max_items += expand_rate;
+
+    uint32_t *new_data = realloc(array->data, array->max_items * sizeof(uint32_t));
+    g_assert(new_data);
+    array->data = new_data;
+}
+
+void
+idarray_add_item(DynamicIdArray *array, void *item) {
+    g_assert(array);
+
+    if (array->num_items >= array->max_items) {
+        idarray_expand(array, array->num_items + 1);
+    }
+    array->data[array->num_items++] = fsearch_arena_get_id(item);
+}
+
+void
+idarray_add_darray_range(DynamicIdArray *dest, DynamicArray *source, uint32_t start_idx, uint32_t num_items) {
+    g_assert(dest);
+    g_assert(source);
+
+    if (start_idx >= source->num_items) {
+        return;
+    }
+    num_items = MIN(source->num_items - start_idx, num_items);
+    if (dest->num_items + num_items > dest->max_items) {
+        idarray_expand(dest, dest->num_items + num_items);
+    }
+
+    uint32_t *ids = dest->data + dest->num_items;
+    void **items = source->data + start_idx;
+    for (uint32_t i = 0; i < num_items; ++i) {
+        ids[i] = fsearch_arena_get_id(items[i]);
+    }
+    dest->num_items += num_items;
+}
+
+void
+idarray_add_darray(DynamicIdArray *dest, DynamicArray *source) {
+    idarray_add_darray_range(dest, source, 0, UINT32_MAX);
+}
+
+static void
+darray_add_ids(DynamicArray *dest, const uint32_t *ids, uint32_t num_ids) {
+    if (dest->num_items + num_ids > dest->max_items) {
+        darray_expand(dest, dest->num_items + num_ids);
+    }
+    void **items = dest->data + dest->num_items;
+    for (uint32_t i = 0; i < num_ids; ++i) {
+        items[i] = fsearch_arena_get_item(ids[i]);
+    }
+    dest->num_items += num_ids;
+}
+
+void
+darray_add_idarray(DynamicArray *dest, DynamicIdArray *source) {
+    g_assert(dest);
+    g_assert(dest->data);
+    g_assert(source);
+
+    darray_add_ids(dest, source->data, source->num_items);
+}
+
+void
+idarray_insert_item(DynamicIdArray *array, void *item, uint32_t index) {
+    g_assert(array);
+    if (index > array->num_items) {
+        index = array->num_items;
+    }
+
+    if (array->num_items >= array->max_items) {
+        idarray_expand(array, array->num_items + 1);
+    }
+
+    memmove(array->data + index + 1, array->data + index, (array->num_items - index) * sizeof(uint32_t));
+    array->data[index] = fsearch_arena_get_id(item);
+    array->num_items++;
+}
+
+uint32_t
+idarray_insert_item_sorted(DynamicIdArray *array, void *item, DynamicArrayCompareDataFunc compare_func, void *data) {
+    g_assert(array);
+
+    uint32_t insert_at = 0;
+    idarray_binary_search_with_data(array, item, compare_func, data, &insert_at);
+
+    idarray_insert_item(array, item, insert_at);
+    return insert_at;
+}
+
+bool
+idarray_binary_search_with_data(DynamicIdArray *array,
+                                void *item,
+                                DynamicArrayCompareDataFunc comp_func,
+                                void *data,
+                                uint32_t *matched_index) {
+    g_assert(array);
+    g_assert(comp_func);
+
+    int32_t left = 0;
+    int32_t right = (int32_t)array->num_items - 1;
+
+    while (left <= right) {
+        const int32_t middle = left + (right - left) / 2;
+
+        void *middle_item = fsearch_arena_get_item(array->data[middle]);
+        const int32_t match = comp_func(&middle_item, &item, data);
+        if (match == 0) {
+            if (matched_index) {
+                *matched_index = middle;
+            }
+            return true;
+        }
+        if (match < 0) {
+            left = middle + 1;
+        }
+        else {
+            right = middle - 1;
+        }
+    }
+
+    // set matched_index to the first index which is greater than our item
+    if (matched_index != NULL) {
+        *matched_index = left;
+    }
+    return false;
+}
+
+static uint32_t
+idarray_steal_or_drop(DynamicIdArray *array, uint32_t index, uint32_t n_elements, DynamicArray *dest) {
+    g_assert(array);
+
+    if (n_elements == 0 || index >= array->num_items) {
+        return 0;
+    }
+    n_elements = MIN(n_elements, array->num_items - index);
+    if (dest) {
+        darray_add_ids(dest, array->data + index, n_elements);
+    }
+    memmove(array->data + index,
+            array->data + index + n_elements,
+            (array->num_items - index - n_elements) * sizeof(uint32_t));
+    array->num_items -= n_elements;
+
+    return n_elements;
+}
+
+void *
+idarray_steal_item(DynamicIdArray *array, uint32_t idx) {
+    g_assert(array);
+
+    if (idx >= array->num_items) {
+        return NULL;
+    }
+    void *item = fsearch_arena_get_item(array->data[idx]);
+    idarray_steal_or_drop(array, idx, 1, NULL);
+    return item;
+}
+
+uint32_t
+idarray_remove(DynamicIdArray *array, uint32_t index, uint32_t n_elements) {
+    g_assert(array);
+
+    idarray_free_items(array, index, n_elements);
+    return idarray_steal_or_drop(array, index, n_elements, NULL);
+}
+
+uint32_t
+idarray_drop(DynamicIdArray *array, uint32_t index, uint32_t n_elements) {
+    return idarray_steal_or_drop(array, index, n_elements, NULL);
+}
+
+uint32_t
+idarray_steal(DynamicIdArray *array, uint32_t index, uint32_t n_elements, DynamicArray *destination) {
+    g_assert(destination);
+
+    return idarray_steal_or_drop(array, index, n_elements, destination);
+}
+
+uint32_t
+idarray_drop_items(DynamicIdArray *array, DynamicArrayStealFunc func, void *data) {
+    g_assert(array);
+
+    uint32_t num_kept = 0;
+    for (uint32_t i = 0; i < array->num_items; ++i) {
+        const uint32_t id = array->data[i];
+        if (!func(fsearch_arena_get_item(id), data)) {
+            array->data[num_kept++] = id;
+        }
+    }
+    const uint32_t num_dropped = array->num_items - num_kept;
+    array->num_items = num_kept;
+
+    return num_dropped;
+}
@@ -29,6 +29,7 @@ typedef bool (*DynamicArrayStealFunc)(void *a, void *data);
 typedef int32_t (*DynamicArrayCompareFunc)(void *a, void *b);
 typedef int32_t (*DynamicArrayCompareDataFunc)(void *a, void *b, void *data);
 typedef bool (*DynamicArrayForEachFunc)(void *, void *data);
+typedef uint64_t (*DynamicArrayKeyFunc)(void *item, void *data);
 
 void
 darray_for_each(DynamicArray *array, DynamicArrayForEachFunc func, void *data);
@@ -46,9 +47,45 @@ darray_sort_multi_threaded(DynamicArray *array,
                            GCancellable *cancellable,
                            void *data);
 
+// Like darray_sort_multi_threaded(), but uses at most `max_threads` threads. Useful when several arrays are sorted
+// concurrently and they have to share the available processors.
+void
+darray_sort_with_max_threads(DynamicArray *array,
+                             DynamicArrayCompareDataFunc comp_func,
+                             int max_threads,
+                             GCancellable *cancellable,
+                             void *data);
+
 void
 darray_sort(DynamicArray *array, DynamicArrayCompareDataFunc comp_func, GCancellable *cancellable, void *data);
 
+// Stable radix sort by the unsigned 64-bit key `key_func` returns for each item. Every key is only computed once,
+// and items with equal keys keep their previous order, so sorting an array which is already ordered by some
+// comparator yields the order of (key, comparator) without ever calling that comparator.
+void
+darray_sort_by_key(DynamicArray *array, DynamicArrayKeyFunc key_func, GCancellable *cancellable, void *data);
+
+// Like darray_sort_by_key(), but for keys which only order the items partially, e.g. a prefix of a string.
+// `key_func` must be consistent with `comp_func`: if the key of a is smaller than the key of b, `comp_func` has to
+// return a negative value for them. Runs of items with equal keys are then ordered with `comp_func`.
+void
+darray_sort_by_key_with_ties(DynamicArray *array,
+                             DynamicArrayKeyFunc key_func,
+                             DynamicArrayCompareDataFunc comp_func,
+                             GCancellable *cancellable,
+                             void *data);
+
+// Returns a new array with the `num_items` smallest items of `array` according to `comp_func`, sorted in ascending
+// order. Only a heap of `num_items` items is kept while `array` is scanned, so this is much cheaper than sorting all
+// of `array` when just the beginning of the sorted order is needed. The order of items which compare equal is
+// undefined.
+DynamicArray *
+darray_get_first_sorted(DynamicArray *array,
+                        uint32_t num_items,
+                        DynamicArrayCompareDataFunc comp_func,
+                        GCancellable *cancellable,
+                        void *data);
+
 uint32_t
 darray_get_size(DynamicArray *array);
 
@@ -104,6 +141,11 @@ darray_remove_items_sorted(DynamicArray *array, DynamicArray *items, DynamicArra
 DynamicArray *
 darray_steal_items(DynamicArray *array, DynamicArrayStealFunc func, void *data);
 
+// Drops every item for which `func` returns true with a single pass over the array, without calling the free func,
+// and returns how many there were. `func` gets the items themselves, so it can tell them apart by address only.
+uint32_t
+darray_drop_items(DynamicArray *array, DynamicArrayStealFunc func, void *data);
+
 DynamicArray *
 darray_new(size_t num_items);
 
@@ -128,4 +170,78 @@ darray_copy(DynamicArray *array);
 void
 darray_set_free_func(DynamicArray *array, GDestroyNotify free_func);
 
-G_DEFINE_AUTOPTR_CLEANUP_FUNC(DynamicArray, darray_unref)
\ No newline at end of file
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(DynamicArray, darray_unref)
+
+// Like DynamicArray, but only for items allocated with fsearch_arena_alloc(). It holds their 32-bit ids instead of
+// pointers, which halves its size. The API still takes and returns pointers to the items, and compare functions get
+// pointers to item pointers, just like with DynamicArray.
+typedef struct DynamicIdArray DynamicIdArray;
+
+DynamicIdArray *
+idarray_new(size_t num_items);
+
+DynamicIdArray *
+idarray_new_full(size_t num_items, GDestroyNotify item_free_func);
+
+void
+idarray_unref(DynamicIdArray *array);
+
+DynamicIdArray *
+idarray_ref(DynamicIdArray *array);
+
+void
+idarray_set_free_func(DynamicIdArray *array, GDestroyNotify free_func);
+
+uint32_t
+idarray_get_num_items(DynamicIdArray *array);
+
+void *
+idarray_get_item(DynamicIdArray *array, uint32_t idx);
+
+DynamicIdArray *
+idarray_get_range(DynamicIdArray *array, uint32_t start_idx, uint32_t num_items);
+
+void
+idarray_add_item(DynamicIdArray *array, void *item);
+
+// Appends `num_items` items of `source`, starting at `start_idx`
+void
+idarray_add_darray_range(DynamicIdArray *dest, DynamicArray *source, uint32_t start_idx, uint32_t num_items);
+
+void
+idarray_add_darray(DynamicIdArray *dest, DynamicArray *source);
+
+void
+darray_add_idarray(DynamicArray *dest, DynamicIdArray *source);
+
+void
+idarray_insert_item(DynamicIdArray *array, void *item, uint32_t index);
+
+uint32_t
+idarray_insert_item_sorted(DynamicIdArray *array, void *item, DynamicArrayCompareDataFunc compare_func, void *data);
+
+bool
+idarray_binary_search_with_data(DynamicIdArray *array,
+                                void *item,
+                                DynamicArrayCompareDataFunc comp_func,
+                                void *data,
+                                uint32_t *matched_index);
+
+void *
+idarray_steal_item(DynamicIdArray *array, uint32_t idx);
+
+uint32_t
+idarray_remove(DynamicIdArray *array, uint32_t index, uint32_t n_elements);
+
+uint32_t
+idarray_drop(DynamicIdArray *array, uint32_t index, uint32_t n_elements);
+
+// Like idarray_drop(), but appends the dropped items to `destination`
+uint32_t
+idarray_steal(DynamicIdArray *array, uint32_t index, uint32_t n_elements, DynamicArray *destination);
+
+// See darray_drop_items()
+uint32_t
+idarray_drop_items(DynamicIdArray *array, DynamicArrayStealFunc func, void *data);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(DynamicIdArray, idarray_unref)
\ No newline at end of file
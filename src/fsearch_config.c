@@ -93,6 +93,10 @@ static const FsearchKeyData SEARCH_SECTION[] = {
     CONF_BOOL(search_as_you_type, true),
 };
 
+static const FsearchKeyData DATABASE_SECTION[] = {
+    CONF_STR(database_compression, NULL),
+};
+
 static const FsearchKeyData WINDOW_SECTION[] = {
     CONF_BOOL(restore_window_size, true),
     CONF_INT(window_width, 850),
@@ -655,6 +659,9 @@ config_load(FsearchConfig *config) {
             config->excludes = config_load_excludes(key_file);
         }
 
+        // Database
+        CONFIG_LOAD_SECTION(key_file, "Database", DATABASE_SECTION, config);
+
         // Filters
         config->filters = config_load_filters(key_file);
 
@@ -681,6 +688,7 @@ config_load_default(FsearchConfig *config) {
     CONFIG_DEFAULT_SECTION(DIALOG_SECTION, config);
     CONFIG_DEFAULT_SECTION(APPLICATIONS_SECTION, config);
     CONFIG_DEFAULT_SECTION(SEARCH_SECTION, config);
+    CONFIG_DEFAULT_SECTION(DATABASE_SECTION, config);
 
     config->filters = fsearch_filter_manager_new_with_defaults();
     config->includes = fsearch_database_include_manager_new_with_defaults();
@@ -800,6 +808,9 @@ config_save(FsearchConfig *config) {
     // Excludes
     config_save_excludes(key_file, config->excludes);
 
+    // Database
+    CONFIG_SAVE_SECTION(key_file, "Database", DATABASE_SECTION, config);
+
     gchar config_path[PATH_MAX] = "";
     config_build_path(config_path, sizeof(config_path));
 
@@ -862,6 +873,9 @@ config_copy(FsearchConfig *config) {
     if (config->sort_by) {
         copy->sort_by = g_strdup(config->sort_by);
     }
+    if (config->database_compression) {
+        copy->database_compression = g_strdup(config->database_compression);
+    }
     if (config->includes) {
         copy->includes = fsearch_database_include_manager_copy(config->includes);
     }
@@ -880,6 +894,7 @@ config_free(FsearchConfig *config) {
 
     g_clear_pointer(&config->folder_open_cmd, g_free);
     g_clear_pointer(&config->sort_by, g_free);
+    g_clear_pointer(&config->database_compression, g_free);
     g_clear_pointer(&config->filters, fsearch_filter_manager_unref);
     g_clear_object(&config->includes);
     g_clear_object(&config->excludes);
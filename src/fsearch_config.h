@@ -115,6 +115,9 @@ struct _FsearchConfig {
 
     FsearchDatabaseIncludeManager *includes;
     FsearchDatabaseExcludeManager *excludes;
+
+    // "none", "lz4" or "zstd", NULL for the compression selected at build time
+    char *database_compression;
 };
 
 bool
@@ -11,7 +11,9 @@
 #include "fsearch_database_index_properties.h"
 #include "fsearch_database_index_store.h"
 #include "fsearch_database_info.h"
+#include "fsearch_database_journal.h"
 #include "fsearch_database_rescan_manager.h"
+#include "fsearch_database_scan_checkpoint.h"
 #include "fsearch_database_search_info.h"
 #include "fsearch_database_work.h"
 #include "fsearch_query.h"
@@ -27,12 +29,20 @@
 #include <glib-object.h>
 #include <glib.h>
 #include <glib/gi18n.h>
+#include <glib/gstdio.h>
 #include <gtk/gtkenums.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdlib.h>
 
+// Number of rows which are shown ahead of large manual sorts, enough to fill the visible part of the result list
+#define DATABASE_SORT_PREVIEW_NUM_ROWS 200
+// The database file gets rewritten once the journal grows beyond this fraction of its size...
+#define DATABASE_JOURNAL_COMPACTION_RATIO 0.25
+// ...and this many bytes, so small databases aren't rewritten all the time
+#define DATABASE_JOURNAL_MIN_COMPACTION_SIZE (1 << 20)
+
 struct _FsearchDatabase {
     GObject parent_instance;
 
@@ -57,6 +67,23 @@ struct _FsearchDatabase {
     FsearchDatabaseIndexStore *pending_store;
     FsearchDatabaseRescanManager *rescan_manager;
 
+    // Writes snapshots of the store to the database file, so the store isn't locked while that happens
+    GThreadPool *save_pool;
+    // FsearchDatabaseFileCompression of the database file, changed with fsearch_database_set_compression()
+    gint compression;
+    // Longest time the store was locked to take a snapshot for saving
+    double max_save_lock_time;
+
+    // Paths changed by file system events since the database file was saved. Only set while the file matches
+    // `journal_store` apart from those changes, i.e. not between a scan and the next save.
+    FsearchDatabaseJournal *journal;
+    // The current store, changes of other stores aren't journaled
+    FsearchDatabaseIndexStore *journal_store;
+    uint32_t journal_id;
+    uint64_t journal_snapshot_size;
+    bool journal_compaction_queued;
+    GMutex journal_mutex;
+
     GMutex mutex;
 
     bool disposed;
@@ -79,6 +106,7 @@ typedef enum FsearchDatabaseSignalType {
     SIGNAL_SEARCH_STARTED,
     SIGNAL_SEARCH_FINISHED,
     SIGNAL_SORT_STARTED,
+    SIGNAL_SORT_PREVIEW,
     SIGNAL_SORT_FINISHED,
     SIGNAL_SELECTION_CHANGED,
     SIGNAL_DATABASE_CHANGED,
@@ -90,6 +118,117 @@ typedef enum FsearchDatabaseSignalType {
 
 static guint signals[NUM_DATABASE_SIGNALS];
 
+// region Journal
+static char *
+database_get_journal_path(FsearchDatabase *self) {
+    g_autofree char *file_path = g_file_get_path(self->file);
+    return fsearch_database_journal_get_path(file_path);
+}
+
+// The journal which collects the changes made while a snapshot is written. It replaces the main journal once the
+// database file was written.
+static char *
+database_get_next_journal_path(FsearchDatabase *self) {
+    g_autofree char *journal_path = database_get_journal_path(self);
+    return g_strconcat(journal_path, ".next", NULL);
+}
+
+// Starts journaling the changes of `store` at `journal_path`, unless `store` was replaced in the meantime. Unless
+// `truncate` is set, the records which are already in the journal are kept. Returns the id of the new journal or 0.
+static uint32_t
+database_journal_open(FsearchDatabase *self,
+                      FsearchDatabaseIndexStore *store,
+                      const char *journal_path,
+                      bool truncate) {
+    g_autofree char *file_path = g_file_get_path(self->file);
+
+    const uint64_t snapshot_size = fsearch_database_file_shards_get_size(file_path);
+
+    g_autoptr(GMutexLocker) locker = g_mutex_locker_new(&self->journal_mutex);
+    if (store != self->journal_store) {
+        return 0;
+    }
+    g_clear_pointer(&self->journal, fsearch_database_journal_free);
+    self->journal = fsearch_database_journal_open(journal_path, truncate);
+    self->journal_snapshot_size = snapshot_size;
+    self->journal_compaction_queued = false;
+    return self->journal ? ++self->journal_id : 0;
+}
+
+// Stops journaling until the database file was saved again, because it no longer contains everything which isn't
+// journaled
+static void
+database_journal_close(FsearchDatabase *self) {
+    g_autoptr(GMutexLocker) locker = g_mutex_locker_new(&self->journal_mutex);
+    g_clear_pointer(&self->journal, fsearch_database_journal_free);
+}
+
+// Makes the journal `journal_id`, which was opened when the snapshot was taken, the main journal of the database
+// file which was just written from that snapshot
+static void
+database_journal_rotate(FsearchDatabase *self, uint32_t journal_id, bool saved) {
+    g_autofree char *file_path = g_file_get_path(self->file);
+    g_autofree char *journal_path = database_get_journal_path(self);
+
+    g_autoptr(GMutexLocker) locker = g_mutex_locker_new(&self->journal_mutex);
+    if (!self->journal || self->journal_id != journal_id) {
+        // The store was replaced while the file was written
+        return;
+    }
+    if (!saved || !fsearch_database_journal_replace(self->journal, journal_path)) {
+        // The old file and journal don't contain the changes of this journal, so they need a full save
+        g_clear_pointer(&self->journal, fsearch_database_journal_free);
+        return;
+    }
+    self->journal_snapshot_size = fsearch_database_file_shards_get_size(file_path);
+}
+
+static void
+database_journal_append(FsearchDatabase *self, FsearchDatabaseIndexStore *store, const char *path) {
+    g_autoptr(GMutexLocker) locker = g_mutex_locker_new(&self->journal_mutex);
+    if (self->journal && self->journal_store == store) {
+        fsearch_database_journal_append(self->journal, path);
+    }
+}
+
+// Writes the journaled changes of the last batch of events to disk and queues a rewrite of the database file once the
+// journal got too large, or the batch couldn't be written
+static void
+database_journal_flush(FsearchDatabase *self) {
+    g_autoptr(GMutexLocker) locker = g_mutex_locker_new(&self->journal_mutex);
+    if (!self->journal) {
+        return;
+    }
+    if (!fsearch_database_journal_flush(self->journal)) {
+        // The batch is lost, so the journal no longer contains every change since the last save and the database
+        // file needs to be rewritten. Until then a save on shutdown can't rely on the journal either.
+        g_clear_pointer(&self->journal, fsearch_database_journal_free);
+        if (!self->journal_compaction_queued && !g_cancellable_is_cancelled(self->cancellable)) {
+            g_debug("[db] failed to write the journal, rewriting the database file");
+            self->journal_compaction_queued = true;
+            g_autoptr(FsearchDatabaseWork) work = fsearch_database_work_new_save();
+            fsearch_database_queue_work(self, work);
+        }
+        return;
+    }
+
+    const uint64_t journal_size = fsearch_database_journal_get_size(self->journal);
+    if (self->journal_compaction_queued || journal_size < DATABASE_JOURNAL_MIN_COMPACTION_SIZE
+        || (double)journal_size < (double)self->journal_snapshot_size * DATABASE_JOURNAL_COMPACTION_RATIO) {
+        return;
+    }
+    if (g_cancellable_is_cancelled(self->cancellable)) {
+        return;
+    }
+
+    g_debug("[db] journal has %" G_GUINT64_FORMAT " bytes, rewriting the database file", journal_size);
+    self->journal_compaction_queued = true;
+    g_autoptr(FsearchDatabaseWork) work = fsearch_database_work_new_save();
+    fsearch_database_queue_work(self, work);
+}
+
+// endregion
+
 static void
 index_store_event_cb(FsearchDatabaseIndexStore *store,
                      FsearchDatabaseIndexStoreEventKind kind,
@@ -175,6 +314,8 @@ signal_type_to_name(FsearchDatabaseSignalType type) {
         return "SIGNAL_SEARCH_FINISHED";
     case SIGNAL_SORT_STARTED:
         return "SIGNAL_SORT_STARTED";
+    case SIGNAL_SORT_PREVIEW:
+        return "SIGNAL_SORT_PREVIEW";
     case SIGNAL_SORT_FINISHED:
         return "SIGNAL_SORT_FINISHED";
     case SIGNAL_SELECTION_CHANGED:
@@ -301,6 +442,17 @@ signal_emit_search_finished(FsearchDatabase *self, guint id, FsearchDatabaseSear
                 (GDestroyNotify)fsearch_database_search_info_unref);
 }
 
+static void
+signal_emit_sort_preview(FsearchDatabase *self, guint id, FsearchDatabaseSearchInfo *info) {
+    signal_emit(self,
+                SIGNAL_SORT_PREVIEW,
+                GUINT_TO_POINTER(id),
+                info,
+                2,
+                NULL,
+                (GDestroyNotify)fsearch_database_search_info_unref);
+}
+
 static void
 signal_emit_sort_finished(FsearchDatabase *self, guint id, FsearchDatabaseSearchInfo *info) {
     signal_emit(self,
@@ -428,6 +580,23 @@ database_sort(FsearchDatabase *self, FsearchDatabaseWork *work) {
     g_autoptr(GMutexLocker) locker = fsearch_database_index_store_get_locker(self->store);
     g_assert_nonnull(locker);
 
+    // Large manual sorts take a while, so show the first rows of the new order as soon as they're known. Any other
+    // rows are requested with work items, which only get processed once the full sort below is done.
+    FsearchDatabaseSearchInfo *preview_info = NULL;
+    g_autoptr(GPtrArray) preview = fsearch_database_index_store_get_sort_preview(self->store,
+                                                                                 id,
+                                                                                 sort_order,
+                                                                                 sort_type,
+                                                                                 DATABASE_SORT_PREVIEW_NUM_ROWS,
+                                                                                 &preview_info,
+                                                                                 cancellable);
+    if (preview) {
+        signal_emit_sort_preview(self, id, preview_info);
+        for (guint i = 0; i < preview->len; ++i) {
+            signal_emit_item_info_ready(self, id, i, fsearch_database_entry_info_ref(g_ptr_array_index(preview, i)));
+        }
+    }
+
     fsearch_database_index_store_sort_results(self->store, id, sort_order, sort_type, cancellable);
 
     signal_emit_sort_finished(self, id, fsearch_database_index_store_get_search_info(self->store, id));
@@ -480,8 +649,12 @@ index_store_event_cb(FsearchDatabaseIndexStore *store,
         signal_emit_apply_started(self);
         break;
     case FSEARCH_DATABASE_INDEX_STORE_EVENT_APPLY_FINISHED:
+        database_journal_flush(self);
         signal_emit_apply_finished(self);
         break;
+    case FSEARCH_DATABASE_INDEX_STORE_EVENT_PATH_CHANGED:
+        database_journal_append(self, store, (const char *)data);
+        break;
     default:
         g_assert_not_reached();
     }
@@ -511,28 +684,106 @@ database_modify_selection(FsearchDatabase *self, FsearchDatabaseWork *work) {
     signal_emit_selection_changed(self, info);
 }
 
+// Writes `store` to the database file. Runs on the save thread, or the worker thread on shutdown.
 static void
-database_save(FsearchDatabase *self, gboolean notify) {
-    // DB must be locked
+database_save_store(FsearchDatabase *self, FsearchDatabaseIndexStore *store, bool notify) {
     g_return_if_fail(self);
-    g_return_if_fail(self->file);
-    g_return_if_fail(self->store);
+    g_return_if_fail(store);
 
     if (notify) {
         signal_emit0(self, SIGNAL_SAVE_STARTED);
     }
 
     g_autofree char *file_path = g_file_get_path(self->file);
+    g_autofree char *next_journal_path = database_get_next_journal_path(self);
 
-    g_autoptr(GMutexLocker) locker = fsearch_database_index_store_get_locker(self->store);
-    g_assert_nonnull(locker);
-    fsearch_database_file_save(self->store, file_path);
+    g_autoptr(GTimer) timer = g_timer_new();
+    g_autoptr(FsearchDatabaseFileShardsSnapshot) snapshot = NULL;
+    uint32_t journal_id = 0;
+    {
+        g_autoptr(GMutexLocker) locker = fsearch_database_index_store_get_locker(store);
+        g_assert_nonnull(locker);
+        // The snapshot locks the indices
+        fsearch_database_index_store_wait_for_entry_readers(store);
+        snapshot = fsearch_database_file_shards_snapshot_new(store, file_path);
+        if (snapshot) {
+            // Changes made from now on aren't part of the snapshot, so they go to a new journal
+            journal_id = database_journal_open(self, store, next_journal_path, true);
+        }
+    }
+    const double lock_time = g_timer_elapsed(timer, NULL);
+    self->max_save_lock_time = MAX(self->max_save_lock_time, lock_time);
+
+    if (snapshot) {
+        g_timer_start(timer);
+        const bool saved = fsearch_database_file_shards_snapshot_save(snapshot,
+                                                                      file_path,
+                                                                      g_atomic_int_get(&self->compression));
+        if (journal_id > 0) {
+            database_journal_rotate(self, journal_id, saved);
+        }
+        g_debug("[db_save] store locked for %.2f ms (max. %.2f ms), file %s in %.2f ms",
+                lock_time * 1000,
+                self->max_save_lock_time * 1000,
+                saved ? "written" : "failed",
+                g_timer_elapsed(timer, NULL) * 1000);
+    }
 
     if (notify) {
         signal_emit0(self, SIGNAL_SAVE_FINISHED);
     }
 }
 
+static void
+save_thread_cb(gpointer data, gpointer user_data) {
+    g_autoptr(FsearchDatabaseIndexStore) store = data;
+    FsearchDatabase *self = user_data;
+    g_return_if_fail(store);
+    g_return_if_fail(self);
+
+    database_save_store(self, store, true);
+}
+
+static void
+database_save(FsearchDatabase *self) {
+    // DB must be locked
+    g_return_if_fail(self);
+    g_return_if_fail(self->file);
+    g_return_if_fail(self->store);
+
+    if (!self->save_pool) {
+        database_save_store(self, self->store, true);
+        return;
+    }
+    g_thread_pool_push(self->save_pool, fsearch_database_index_store_ref(self->store), NULL);
+}
+
+static void
+database_save_on_quit(FsearchDatabase *self) {
+    // DB must be locked
+    g_return_if_fail(self);
+
+    // Finish the saves which are still queued
+    if (self->save_pool) {
+        g_thread_pool_free(g_steal_pointer(&self->save_pool), FALSE, TRUE);
+    }
+
+    {
+        // If every change since the last save is journaled, the database file doesn't need to be rewritten
+        g_autoptr(GMutexLocker) locker = g_mutex_locker_new(&self->journal_mutex);
+        if (self->journal && self->journal_store == self->store) {
+            if (fsearch_database_journal_flush(self->journal)) {
+                g_clear_pointer(&self->journal, fsearch_database_journal_free);
+                return;
+            }
+        }
+    }
+
+    if (self->store) {
+        database_save_store(self, self->store, false);
+    }
+}
+
 static void
 on_index_scan_requested(const char *path, gpointer user_data) {
     FsearchDatabase *self = FSEARCH_DATABASE(user_data);
@@ -592,10 +843,41 @@ io_thread_cb(gpointer data, gpointer user_data) {
     }
 }
 
+static char *
+database_get_checkpoint_dir(FsearchDatabase *self) {
+    g_autofree char *file_path = g_file_get_path(self->file);
+    return fsearch_database_scan_checkpoint_get_dir(file_path);
+}
+
+// Creates a store whose scans can be resumed
+static FsearchDatabaseIndexStore *
+database_index_store_new(FsearchDatabase *self,
+                         FsearchDatabaseIncludeManager *include_manager,
+                         FsearchDatabaseExcludeManager *exclude_manager,
+                         FsearchDatabaseIndexPropertyFlags flags) {
+    FsearchDatabaseIndexStore *store = fsearch_database_index_store_new(include_manager,
+                                                                        exclude_manager,
+                                                                        flags,
+                                                                        index_store_event_cb,
+                                                                        self);
+    g_return_val_if_fail(store, NULL);
+
+    g_autofree char *checkpoint_dir = database_get_checkpoint_dir(self);
+    fsearch_database_index_store_set_checkpoint_dir(store, checkpoint_dir);
+    return store;
+}
+
 static void
 database_set_store(FsearchDatabase *self, FsearchDatabaseIndexStore *store) {
     g_return_if_fail(self);
 
+    {
+        // The database file doesn't contain `store` until it was saved
+        g_autoptr(GMutexLocker) locker = g_mutex_locker_new(&self->journal_mutex);
+        g_clear_pointer(&self->journal, fsearch_database_journal_free);
+        self->journal_store = store;
+    }
+
     g_clear_pointer(&self->store, fsearch_database_index_store_unref);
     self->store = store ? fsearch_database_index_store_ref(store) : NULL;
 
@@ -625,6 +907,11 @@ database_remove_items(FsearchDatabase *self, FsearchDatabaseWork *work) {
     g_assert_nonnull(locker);
 
     fsearch_database_index_store_remove_paths(self->store, item_paths, self->rescan_manager);
+
+    for (uint32_t i = 0; i < darray_get_num_items(item_paths); ++i) {
+        database_journal_append(self, self->store, darray_get_item(item_paths, i));
+    }
+    database_journal_flush(self);
 }
 
 // Clears self->scan_cancellable, unless a newer scan has already replaced it.
@@ -659,9 +946,20 @@ database_scan_finished(FsearchDatabase *self, FsearchDatabaseWork *work) {
 
         fsearch_database_index_store_start_monitoring(self->store);
 
+        // The scans are done and in use now, later ones start over
+        g_autoptr(GPtrArray) indices = fsearch_database_index_store_get_indices(self->store);
+        for (guint i = 0; i < indices->len; ++i) {
+            fsearch_database_index_remove_checkpoint(g_ptr_array_index(indices, i));
+        }
+
 #ifdef HAVE_MALLOC_TRIM
         malloc_trim(0);
 #endif
+
+        // Write the new index right away, so the following changes can be journaled and don't require a full save
+        // on shutdown
+        g_autoptr(FsearchDatabaseWork) save_work = fsearch_database_work_new_save();
+        fsearch_database_queue_work(self, save_work);
     }
 
     database_clear_scan_cancellable_if_current(self, work);
@@ -681,11 +979,7 @@ database_rescan_sync(FsearchDatabase *db,
                      FsearchDatabaseExcludeManager *exclude_manager,
                      FsearchDatabaseIndexPropertyFlags flags) {
     // DB must be locked
-    g_autoptr(FsearchDatabaseIndexStore) store = fsearch_database_index_store_new(include_manager,
-                                                                                  exclude_manager,
-                                                                                  flags,
-                                                                                  index_store_event_cb,
-                                                                                  db);
+    g_autoptr(FsearchDatabaseIndexStore) store = database_index_store_new(db, include_manager, exclude_manager, flags);
     g_return_if_fail(store);
 
     database_set_store(db, store);
@@ -723,11 +1017,10 @@ database_rescan(FsearchDatabase *self, FsearchDatabaseWork *work) {
     exclude_manager = fsearch_database_index_store_get_exclude_manager(source_store);
     const FsearchDatabaseIndexPropertyFlags flags = fsearch_database_index_store_get_flags(source_store);
 
-    g_autoptr(FsearchDatabaseIndexStore) store = fsearch_database_index_store_new(include_manager,
-                                                                                  exclude_manager,
-                                                                                  flags,
-                                                                                  index_store_event_cb,
-                                                                                  self);
+    g_autoptr(FsearchDatabaseIndexStore) store = database_index_store_new(self,
+                                                                          include_manager,
+                                                                          exclude_manager,
+                                                                          flags);
     g_return_if_fail(store);
 
     g_clear_pointer(&self->pending_store, fsearch_database_index_store_unref);
@@ -798,9 +1091,13 @@ database_rescan_index_finished(FsearchDatabase *self, FsearchDatabaseWork *work)
         signal_emit_apply_finished(self);
 
         if (replaced) {
+            fsearch_database_index_remove_checkpoint(new_index);
 #ifdef HAVE_MALLOC_TRIM
             malloc_trim(0);
 #endif
+            database_journal_close(self);
+            g_autoptr(FsearchDatabaseWork) save_work = fsearch_database_work_new_save();
+            fsearch_database_queue_work(self, save_work);
 
             if (self->rescan_manager) {
                 fsearch_database_rescan_manager_notify_index_finished(self->rescan_manager,
@@ -854,11 +1151,10 @@ database_scan(FsearchDatabase *self, FsearchDatabaseWork *work) {
 
     g_autoptr(GCancellable) cancellable = fsearch_database_work_get_cancellable(work);
 
-    g_autoptr(FsearchDatabaseIndexStore) store = fsearch_database_index_store_new(include_manager,
-                                                                                  exclude_manager,
-                                                                                  flags,
-                                                                                  index_store_event_cb,
-                                                                                  self);
+    g_autoptr(FsearchDatabaseIndexStore) store = database_index_store_new(self,
+                                                                          include_manager,
+                                                                          exclude_manager,
+                                                                          flags);
     g_return_if_fail(store);
 
     g_clear_pointer(&self->pending_store, fsearch_database_index_store_unref);
@@ -874,6 +1170,28 @@ database_scan(FsearchDatabase *self, FsearchDatabaseWork *work) {
     g_thread_pool_push(self->io_pool, g_steal_pointer(&new_work), NULL);
 }
 
+// Scans the indices which couldn't be loaded from the database file, e.g. because their include was added to the
+// config since it was saved
+static void
+database_request_unscanned_indices(FsearchDatabase *self) {
+    g_autoptr(GPtrArray) unscanned_paths = g_ptr_array_new_with_free_func(g_free);
+    {
+        g_autoptr(GMutexLocker) locker = fsearch_database_index_store_get_locker(self->store);
+        g_assert_nonnull(locker);
+        g_autoptr(GPtrArray) indices = fsearch_database_index_store_get_indices(self->store);
+        for (guint i = 0; i < indices->len; ++i) {
+            FsearchDatabaseIndex *index = g_ptr_array_index(indices, i);
+            if (fsearch_database_index_is_unscanned(index) && !fsearch_database_index_wants_root_reappear_poll(index)) {
+                g_ptr_array_add(unscanned_paths, g_strdup(fsearch_database_index_get_path(index)));
+            }
+        }
+    }
+    for (guint i = 0; i < unscanned_paths->len; ++i) {
+        g_debug("[db] %s wasn't loaded from the database file, scan it", (char *)g_ptr_array_index(unscanned_paths, i));
+        fsearch_database_rescan_manager_request_index_scan(self->rescan_manager, g_ptr_array_index(unscanned_paths, i));
+    }
+}
+
 static void
 database_load(FsearchDatabase *self) {
     // DB must be locked
@@ -893,31 +1211,67 @@ database_load(FsearchDatabase *self) {
         exclude_manager = fsearch_database_exclude_manager_new_with_defaults();
     }
 
-    const bool res = fsearch_database_file_load(file_path,
-                                                NULL,
-                                                &store,
-                                                include_manager,
-                                                exclude_manager,
-                                                index_store_event_cb,
-                                                self);
+    const bool res = fsearch_database_file_shards_load(file_path,
+                                                       NULL,
+                                                       &store,
+                                                       include_manager,
+                                                       exclude_manager,
+                                                       index_store_event_cb,
+                                                       self);
 
     if (!res) {
         // On a failed load we use the default flags
-        store = fsearch_database_index_store_new(include_manager,
-                                                 exclude_manager,
-                                                 DATABASE_INDEX_PROPERTY_FLAG_DEFAULT,
-                                                 index_store_event_cb,
-                                                 self);
+        store = database_index_store_new(self, include_manager, exclude_manager, DATABASE_INDEX_PROPERTY_FLAG_DEFAULT);
+    }
+    else {
+        g_autofree char *checkpoint_dir = database_get_checkpoint_dir(self);
+        fsearch_database_index_store_set_checkpoint_dir(store, checkpoint_dir);
     }
 
     database_set_store(self, store);
     g_clear_pointer(&self->pending_store, fsearch_database_index_store_unref);
 
+    if (res) {
+        // Apply the changes which were journaled after the file was saved. If the application exited while a
+        // snapshot was written, some of them are in the journal of that snapshot.
+        g_autofree char *journal_path = database_get_journal_path(self);
+        g_autofree char *next_journal_path = database_get_next_journal_path(self);
+        g_autoptr(GPtrArray) journaled_paths = fsearch_database_journal_load(journal_path);
+        g_autoptr(GPtrArray) next_journaled_paths = fsearch_database_journal_load(next_journal_path);
+        if (!journaled_paths) {
+            journaled_paths = g_ptr_array_new_with_free_func(g_free);
+        }
+        for (guint i = 0; next_journaled_paths && i < next_journaled_paths->len; ++i) {
+            g_ptr_array_add(journaled_paths, g_strdup(g_ptr_array_index(next_journaled_paths, i)));
+        }
+        if (journaled_paths->len > 0) {
+            g_debug("[db] replaying %u journaled changes", journaled_paths->len);
+            g_autoptr(GMutexLocker) locker = fsearch_database_index_store_get_locker(self->store);
+            g_assert_nonnull(locker);
+            fsearch_database_index_store_refresh_paths(self->store, journaled_paths, self->rescan_manager);
+        }
+        database_journal_open(self, self->store, journal_path, false);
+
+        if (next_journaled_paths) {
+            // Keep the changes of the interrupted snapshot in the main journal, they're not in the database file
+            g_autoptr(GMutexLocker) locker = g_mutex_locker_new(&self->journal_mutex);
+            if (self->journal) {
+                for (guint i = 0; i < next_journaled_paths->len; ++i) {
+                    fsearch_database_journal_append(self->journal, g_ptr_array_index(next_journaled_paths, i));
+                }
+                if (fsearch_database_journal_flush(self->journal)) {
+                    g_remove(next_journal_path);
+                }
+            }
+        }
+    }
+
     if (self->rescan_manager) {
         if (!res) {
             fsearch_database_rescan_manager_request_full_scan(self->rescan_manager);
         }
         else {
+            database_request_unscanned_indices(self);
             fsearch_database_rescan_manager_trigger_startup_scans(self->rescan_manager);
         }
     }
@@ -968,11 +1322,11 @@ handle_work_in_worker_thread_cb(gpointer user_data) {
 
     switch (fsearch_database_work_get_kind(work)) {
     case FSEARCH_DATABASE_WORK_QUIT:
-        database_save(self, FALSE);
+        database_save_on_quit(self);
         quit = true;
         break;
     case FSEARCH_DATABASE_WORK_SAVE_TO_FILE:
-        database_save(self, TRUE);
+        database_save(self);
         break;
     case FSEARCH_DATABASE_WORK_LOAD_FROM_FILE:
         database_load(self);
@@ -1050,6 +1404,9 @@ fsearch_database_constructed(GObject *object) {
     if (self->file == NULL) {
         self->file = database_get_file_default();
     }
+
+    g_autofree char *checkpoint_dir = database_get_checkpoint_dir(self);
+    fsearch_database_rescan_manager_set_checkpoint_dir(self->rescan_manager, checkpoint_dir);
 }
 
 static void
@@ -1082,6 +1439,10 @@ fsearch_database_dispose(GObject *object) {
     if (self->io_pool) {
         g_thread_pool_free(g_steal_pointer(&self->io_pool), TRUE, TRUE);
     }
+    // The worker thread normally finishes the pending saves when it quits
+    if (self->save_pool) {
+        g_thread_pool_free(g_steal_pointer(&self->save_pool), FALSE, TRUE);
+    }
 
     // Clean up the worker loop and context
     g_clear_pointer(&self->worker_loop, g_main_loop_unref);
@@ -1096,6 +1457,8 @@ fsearch_database_dispose(GObject *object) {
         self->pending_store = NULL;
     }
 
+    database_journal_close(self);
+
     G_OBJECT_CLASS(fsearch_database_parent_class)->dispose(object);
 }
 
@@ -1112,6 +1475,7 @@ fsearch_database_finalize(GObject *object) {
 
     g_mutex_clear(&self->mutex);
     g_mutex_clear(&self->scan_mutex);
+    g_mutex_clear(&self->journal_mutex);
 
     G_OBJECT_CLASS(fsearch_database_parent_class)->finalize(object);
 }
@@ -1246,6 +1610,17 @@ fsearch_database_class_init(FsearchDatabaseClass *klass) {
                                                 G_TYPE_NONE,
                                                 1,
                                                 G_TYPE_UINT);
+    signals[SIGNAL_SORT_PREVIEW] = g_signal_new("sort-preview",
+                                                G_TYPE_FROM_CLASS(klass),
+                                                G_SIGNAL_RUN_LAST,
+                                                0,
+                                                NULL,
+                                                NULL,
+                                                NULL,
+                                                G_TYPE_NONE,
+                                                2,
+                                                G_TYPE_UINT,
+                                                FSEARCH_TYPE_DATABASE_SEARCH_INFO);
     signals[SIGNAL_SORT_FINISHED] = g_signal_new("sort-finished",
                                                  G_TYPE_FROM_CLASS(klass),
                                                  G_SIGNAL_RUN_LAST,
@@ -1324,12 +1699,15 @@ static void
 fsearch_database_init(FsearchDatabase *self) {
     g_mutex_init(&self->mutex);
     g_mutex_init(&self->scan_mutex);
+    g_mutex_init(&self->journal_mutex);
+    self->compression = DATABASE_FILE_DEFAULT_COMPRESSION;
     self->cancellable = g_cancellable_new();
 #if GLIB_CHECK_VERSION(2, 70, 0)
     self->io_pool = g_thread_pool_new_full(io_thread_cb, self, (GDestroyNotify)fsearch_database_work_unref, 1, TRUE, NULL);
 #else
     self->io_pool = g_thread_pool_new(io_thread_cb, self, 1, TRUE, NULL);
 #endif
+    self->save_pool = g_thread_pool_new(save_thread_cb, self, 1, TRUE, NULL);
     self->worker_ctx = g_main_context_new();
     self->worker_loop = g_main_loop_new(self->worker_ctx, FALSE);
     self->worker_thread = g_thread_new("FsearchDatabaseWorker", database_worker_thread, self);
@@ -1392,6 +1770,17 @@ fsearch_database_cancel_scan(FsearchDatabase *self) {
     }
 }
 
+void
+fsearch_database_set_compression(FsearchDatabase *self, FsearchDatabaseFileCompression compression) {
+    g_return_if_fail(self);
+
+    if (!fsearch_database_file_compression_is_supported(compression)) {
+        g_warning("[db] database compression isn't supported by this build: %d", compression);
+        return;
+    }
+    g_atomic_int_set(&self->compression, compression);
+}
+
 FsearchResult
 fsearch_database_try_get_search_info(FsearchDatabase *self, uint32_t view_id, FsearchDatabaseSearchInfo **info_out) {
     g_return_val_if_fail(self, FSEARCH_RESULT_FAILED);
@@ -3,6 +3,7 @@
 #include <gio/gio.h>
 
 #include "fsearch_database_entry_info.h"
+#include "fsearch_database_file.h"
 #include "fsearch_database_info.h"
 #include "fsearch_database_search_info.h"
 #include "fsearch_database_work.h"
@@ -24,6 +25,11 @@ fsearch_database_queue_work(FsearchDatabase *self, FsearchDatabaseWork *work);
 void
 fsearch_database_cancel_scan(FsearchDatabase *self);
 
+// Compression of the database files written from now on. Shards which don't change keep the compression they were
+// written with, every file is loaded with its own. Unsupported compressions are ignored.
+void
+fsearch_database_set_compression(FsearchDatabase *self, FsearchDatabaseFileCompression compression);
+
 FsearchResult
 fsearch_database_try_get_search_info(FsearchDatabase *self, uint32_t view_id, FsearchDatabaseSearchInfo **info_out);
 
@@ -4,16 +4,19 @@
 #include "fsearch_array.h"
 #include "fsearch_database_entry.h"
 #include "fsearch_database_index_properties.h"
+#include "fsearch_file_utils.h"
 
 #include <gio/giotypes.h>
 #include <glib.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
 #include <math.h>
 
 struct _FsearchDatabaseChunkedArray {
+    // The entries in order, split into DynamicIdArray chunks
     DynamicArray *chunks;
 
     uint32_t num_entries;
@@ -40,12 +43,12 @@ G_DEFINE_BOXED_TYPE(FsearchDatabaseChunkedArray,
 #define MIN_ENTRIES_FOR_BULK_INSERT 8192
 
 static int32_t
-chunk_compare_func(DynamicArray **chunk_ptr, FsearchDatabaseEntry **entry_ptr, FsearchDatabaseChunkedArray *self) {
-    DynamicArray *chunk = *chunk_ptr;
-    g_assert(darray_get_num_items(chunk) > 0);
+chunk_compare_func(DynamicIdArray **chunk_ptr, FsearchDatabaseEntry **entry_ptr, FsearchDatabaseChunkedArray *self) {
+    DynamicIdArray *chunk = *chunk_ptr;
+    g_assert(idarray_get_num_items(chunk) > 0);
 
-    FsearchDatabaseEntry *first_chunk_entry = darray_get_item(chunk, 0);
-    FsearchDatabaseEntry *last_chunk_entry = darray_get_item(chunk, darray_get_num_items(chunk) - 1);
+    FsearchDatabaseEntry *first_chunk_entry = idarray_get_item(chunk, 0);
+    FsearchDatabaseEntry *last_chunk_entry = idarray_get_item(chunk, idarray_get_num_items(chunk) - 1);
 
     const int32_t res_a = self->entry_comp_func((void *)&first_chunk_entry, (void *)entry_ptr, self->compare_context);
     const int32_t res_b = self->entry_comp_func((void *)&last_chunk_entry, (void *)entry_ptr, self->compare_context);
@@ -55,7 +58,7 @@ chunk_compare_func(DynamicArray **chunk_ptr, FsearchDatabaseEntry **entry_ptr, F
     return res_a;
 }
 
-static DynamicArray *
+static DynamicIdArray *
 get_chunk_for_entry(FsearchDatabaseChunkedArray *self, FsearchDatabaseEntry *entry, uint32_t *chunk_idx_out) {
     g_return_val_if_fail(self, NULL);
     g_return_val_if_fail(entry, NULL);
@@ -63,7 +66,7 @@ get_chunk_for_entry(FsearchDatabaseChunkedArray *self, FsearchDatabaseEntry *ent
     uint32_t chunk_idx = 0;
     if (darray_get_num_items(self->chunks) == 0) {
         // There's no chunk -> add one
-        darray_insert_item(self->chunks, darray_new_full(self->target_chunk_size, self->entry_free_func), 0);
+        darray_insert_item(self->chunks, idarray_new_full(self->target_chunk_size, self->entry_free_func), 0);
         chunk_idx = 0;
     }
     else if (darray_get_num_items(self->chunks) == 1) {
@@ -79,7 +82,7 @@ get_chunk_for_entry(FsearchDatabaseChunkedArray *self, FsearchDatabaseEntry *ent
         chunk_idx = MIN(chunk_idx, darray_get_num_items(self->chunks) - 1);
     }
 
-    DynamicArray *chunk = darray_get_item(self->chunks, chunk_idx);
+    DynamicIdArray *chunk = darray_get_item(self->chunks, chunk_idx);
     g_assert_nonnull(chunk);
     if (chunk_idx_out) {
         *chunk_idx_out = chunk_idx;
@@ -91,33 +94,56 @@ static uint32_t
 count_num_entries(DynamicArray *chunks) {
     uint32_t num_entries = 0;
     for (uint32_t i = 0; i < darray_get_num_items(chunks); ++i) {
-        num_entries += darray_get_num_items(darray_get_item(chunks, i));
+        num_entries += idarray_get_num_items(darray_get_item(chunks, i));
     }
     return num_entries;
 }
 
+// Splits the entries of `array` into id chunks of about `target_chunk_size` entries
 static DynamicArray *
-split_chunk(DynamicArray *chunk, uint32_t target_chunk_size, GDestroyNotify entry_free_func) {
-    g_assert(chunk);
+split_array(DynamicArray *array, uint32_t target_chunk_size, GDestroyNotify entry_free_func) {
+    g_assert(array);
 
-    const uint32_t num_items_in_chunk = darray_get_num_items(chunk);
+    const uint32_t num_items_in_chunk = darray_get_num_items(array);
     if (num_items_in_chunk <= target_chunk_size) {
-        DynamicArray *chunks = darray_new_full(1, (GDestroyNotify)darray_unref);
-        DynamicArray *chunk_copy = darray_copy(chunk);
-        darray_set_free_func(chunk_copy, entry_free_func);
-        darray_add_item(chunks, chunk_copy);
+        DynamicArray *chunks = darray_new_full(1, (GDestroyNotify)idarray_unref);
+        DynamicIdArray *chunk = idarray_new_full(num_items_in_chunk, entry_free_func);
+        idarray_add_darray(chunk, array);
+        darray_add_item(chunks, chunk);
         return chunks;
     }
 
     const uint32_t num_chunks = ceil(num_items_in_chunk / (double)target_chunk_size);
     const uint32_t num_items_per_chunk = floor(num_items_in_chunk / (double)num_chunks);
 
-    DynamicArray *chunks = darray_new_full(num_chunks, (GDestroyNotify)darray_unref);
+    DynamicArray *chunks = darray_new_full(num_chunks, (GDestroyNotify)idarray_unref);
     for (uint32_t n = 0; n < num_chunks; ++n) {
-        DynamicArray *chunk_slice = darray_get_range(chunk,
-                                                     n * num_items_per_chunk,
-                                                     n + 1 == num_chunks ? UINT32_MAX : num_items_per_chunk);
-        darray_set_free_func(chunk_slice, entry_free_func);
+        const uint32_t num_items = n + 1 == num_chunks ? num_items_in_chunk - n * num_items_per_chunk
+                                                       : num_items_per_chunk;
+        DynamicIdArray *chunk_slice = idarray_new_full(num_items, entry_free_func);
+        idarray_add_darray_range(chunk_slice, array, n * num_items_per_chunk, num_items);
+        darray_add_item(chunks, chunk_slice);
+    }
+
+    g_assert(num_items_in_chunk == count_num_entries(chunks));
+
+    return chunks;
+}
+
+static DynamicArray *
+split_chunk(DynamicIdArray *chunk, uint32_t target_chunk_size, GDestroyNotify entry_free_func) {
+    g_assert(chunk);
+
+    const uint32_t num_items_in_chunk = idarray_get_num_items(chunk);
+    const uint32_t num_chunks = ceil(num_items_in_chunk / (double)target_chunk_size);
+    const uint32_t num_items_per_chunk = floor(num_items_in_chunk / (double)num_chunks);
+
+    DynamicArray *chunks = darray_new_full(num_chunks, (GDestroyNotify)idarray_unref);
+    for (uint32_t n = 0; n < num_chunks; ++n) {
+        DynamicIdArray *chunk_slice = idarray_get_range(chunk,
+                                                        n * num_items_per_chunk,
+                                                        n + 1 == num_chunks ? UINT32_MAX : num_items_per_chunk);
+        idarray_set_free_func(chunk_slice, entry_free_func);
         darray_add_item(chunks, chunk_slice);
     }
 
@@ -127,37 +153,37 @@ split_chunk(DynamicArray *chunk, uint32_t target_chunk_size, GDestroyNotify entr
 }
 
 static void
-balance_chunk(FsearchDatabaseChunkedArray *self, DynamicArray *chunk, uint32_t chunk_idx) {
-    if (darray_get_num_items(chunk) == 0) {
+balance_chunk(FsearchDatabaseChunkedArray *self, DynamicIdArray *chunk, uint32_t chunk_idx) {
+    if (idarray_get_num_items(chunk) == 0) {
         if (darray_get_num_items(self->chunks) == 1) {
             // Don't remove the last chunk
             return;
         }
-        darray_set_free_func(chunk, NULL);
+        idarray_set_free_func(chunk, NULL);
         darray_remove(self->chunks, chunk_idx, 1);
         chunk = NULL;
         return;
     }
 
-    if (darray_get_num_items(chunk) < 2 * self->target_chunk_size) {
+    if (idarray_get_num_items(chunk) < 2 * self->target_chunk_size) {
         return;
     }
 
     g_autoptr(DynamicArray) splitted = split_chunk(chunk, self->target_chunk_size, self->entry_free_func);
 
-    darray_set_free_func(chunk, NULL);
+    idarray_set_free_func(chunk, NULL);
     darray_remove(self->chunks, chunk_idx, 1);
     chunk = NULL;
 
     for (uint32_t i = 0; i < darray_get_num_items(splitted); ++i) {
-        DynamicArray *c = darray_get_item(splitted, i);
-        darray_insert_item(self->chunks, darray_ref(c), chunk_idx++);
+        DynamicIdArray *c = darray_get_item(splitted, i);
+        darray_insert_item(self->chunks, idarray_ref(c), chunk_idx++);
     }
 }
 
 static uint32_t
-advance_past_chunk(FsearchDatabaseChunkedArray *self, DynamicArray *chunk, uint32_t chunk_idx) {
-    if (darray_get_num_items(chunk) > 0 || darray_get_num_items(self->chunks) == 1) {
+advance_past_chunk(FsearchDatabaseChunkedArray *self, DynamicIdArray *chunk, uint32_t chunk_idx) {
+    if (idarray_get_num_items(chunk) > 0 || darray_get_num_items(self->chunks) == 1) {
         return chunk_idx + 1;
     }
     darray_remove(self->chunks, chunk_idx, 1);
@@ -189,7 +215,7 @@ fsearch_database_chunked_array_new(DynamicArray *array,
     self->num_entries = darray_get_num_items(array);
 
     self->entry_free_func = entry_free_func;
-    self->chunks = split_chunk(array, self->target_chunk_size, self->entry_free_func);
+    self->chunks = split_array(array, self->target_chunk_size, self->entry_free_func);
 
     self->ref_count = 1;
 
@@ -224,19 +250,19 @@ fsearch_database_chunked_array_insert(FsearchDatabaseChunkedArray *self, Fsearch
     g_return_if_fail(db_entry_get_type(entry) == self->entry_type);
 
     uint32_t chunk_idx = 0;
-    DynamicArray *chunk = get_chunk_for_entry(self, entry, &chunk_idx);
+    DynamicIdArray *chunk = get_chunk_for_entry(self, entry, &chunk_idx);
 
-    darray_insert_item_sorted(chunk, entry, self->entry_comp_func, self->compare_context);
+    idarray_insert_item_sorted(chunk, entry, self->entry_comp_func, self->compare_context);
     self->num_entries++;
 
     balance_chunk(self, chunk, chunk_idx);
 }
 
-static DynamicArray *
+static DynamicIdArray *
 get_next_nonempty_chunk(DynamicArray *chunks, uint32_t start_chunk_idx, uint32_t *out_chunk_idx) {
     while (start_chunk_idx < darray_get_num_items(chunks)) {
-        DynamicArray *chunk = darray_get_item(chunks, start_chunk_idx);
-        if (darray_get_num_items(chunk) > 0) {
+        DynamicIdArray *chunk = darray_get_item(chunks, start_chunk_idx);
+        if (idarray_get_num_items(chunk) > 0) {
             *out_chunk_idx = start_chunk_idx;
             return chunk;
         }
@@ -277,10 +303,10 @@ fsearch_database_chunked_array_insert_array(FsearchDatabaseChunkedArray *self, D
     const uint32_t num_chunks_target = ceil(total_entries / (double)self->target_chunk_size);
     const uint32_t num_items_per_chunk = floor(total_entries / (double)num_chunks_target);
 
-    g_autoptr(DynamicArray) new_chunks = darray_new_full(num_chunks_target, (GDestroyNotify)darray_unref);
+    g_autoptr(DynamicArray) new_chunks = darray_new_full(num_chunks_target, (GDestroyNotify)idarray_unref);
 
     // Allocate slightly extra space in case the final chunk absorbs the remainder
-    g_autoptr(DynamicArray) current_chunk = darray_new_full(num_items_per_chunk + 2, self->entry_free_func);
+    g_autoptr(DynamicIdArray) current_chunk = idarray_new_full(num_items_per_chunk + 2, self->entry_free_func);
     uint32_t chunks_created = 0;
 
     uint32_t old_chunk_idx = 0;
@@ -288,7 +314,7 @@ fsearch_database_chunked_array_insert_array(FsearchDatabaseChunkedArray *self, D
     uint32_t new_entry_idx = 0;
 
     // Find the first chunk which actually contains entries
-    DynamicArray *current_old_chunk = get_next_nonempty_chunk(self->chunks, old_chunk_idx, &old_chunk_idx);
+    DynamicIdArray *current_old_chunk = get_next_nonempty_chunk(self->chunks, old_chunk_idx, &old_chunk_idx);
 
     // Merge directly into evenly-sized chunks
     while (current_old_chunk != NULL || new_entry_idx < num_new_entries) {
@@ -296,7 +322,7 @@ fsearch_database_chunked_array_insert_array(FsearchDatabaseChunkedArray *self, D
 
         if (current_old_chunk != NULL && new_entry_idx < num_new_entries) {
             // Find entry to insert
-            void *entry_old = darray_get_item(current_old_chunk, old_entry_idx);
+            void *entry_old = idarray_get_item(current_old_chunk, old_entry_idx);
             void *entry_new = darray_get_item(sorted_new_entries, new_entry_idx);
 
             if (self->entry_comp_func(&entry_old, &entry_new, self->compare_context) <= 0) {
@@ -309,7 +335,7 @@ fsearch_database_chunked_array_insert_array(FsearchDatabaseChunkedArray *self, D
             }
         }
         else if (current_old_chunk != NULL) {
-            entry_to_add = darray_get_item(current_old_chunk, old_entry_idx);
+            entry_to_add = idarray_get_item(current_old_chunk, old_entry_idx);
             old_entry_idx++;
         }
         else {
@@ -318,33 +344,33 @@ fsearch_database_chunked_array_insert_array(FsearchDatabaseChunkedArray *self, D
         }
 
         // Advance to the next old chunk if we've exhausted the current one
-        if (current_old_chunk != NULL && old_entry_idx >= darray_get_num_items(current_old_chunk)) {
+        if (current_old_chunk != NULL && old_entry_idx >= idarray_get_num_items(current_old_chunk)) {
             old_chunk_idx++;
             current_old_chunk = get_next_nonempty_chunk(self->chunks, old_chunk_idx, &old_chunk_idx);
             old_entry_idx = 0;
         }
 
         // Add the "smaller" entry to our new chunk
-        darray_add_item(current_chunk, entry_to_add);
+        idarray_add_item(current_chunk, entry_to_add);
 
         // Add the chunk if it hits the calculated even size
         // Ensure the very last chunk is allowed to absorb a few more entries
-        if (darray_get_num_items(current_chunk) == num_items_per_chunk && chunks_created < num_chunks_target - 1) {
+        if (idarray_get_num_items(current_chunk) == num_items_per_chunk && chunks_created < num_chunks_target - 1) {
             darray_add_item(new_chunks, g_steal_pointer(&current_chunk));
             chunks_created++;
-            current_chunk = darray_new_full(num_items_per_chunk + 2, self->entry_free_func);
+            current_chunk = idarray_new_full(num_items_per_chunk + 2, self->entry_free_func);
         }
     }
 
     // Add the final remainder chunk
-    if (darray_get_num_items(current_chunk) > 0) {
+    if (idarray_get_num_items(current_chunk) > 0) {
         darray_add_item(new_chunks, g_steal_pointer(&current_chunk));
     }
 
     // Clean up old chunks (preventing entries from being freed)
     for (uint32_t c = 0; c < darray_get_num_items(self->chunks); ++c) {
-        DynamicArray *chunk = darray_get_item(self->chunks, c);
-        darray_set_free_func(chunk, NULL);
+        DynamicIdArray *chunk = darray_get_item(self->chunks, c);
+        idarray_set_free_func(chunk, NULL);
     }
     g_clear_pointer(&self->chunks, darray_unref);
 
@@ -362,11 +388,11 @@ fsearch_database_chunked_array_find(FsearchDatabaseChunkedArray *self, FsearchDa
         g_debug("[chunks] empty");
         return NULL;
     }
-    DynamicArray *chunk = get_chunk_for_entry(self, entry, NULL);
+    DynamicIdArray *chunk = get_chunk_for_entry(self, entry, NULL);
 
     uint32_t entry_idx = 0;
-    if (darray_binary_search_with_data(chunk, entry, self->entry_comp_func, self->compare_context, &entry_idx)) {
-        return darray_get_item(chunk, entry_idx);
+    if (idarray_binary_search_with_data(chunk, entry, self->entry_comp_func, self->compare_context, &entry_idx)) {
+        return idarray_get_item(chunk, entry_idx);
     }
     return NULL;
 }
@@ -374,9 +400,9 @@ fsearch_database_chunked_array_find(FsearchDatabaseChunkedArray *self, FsearchDa
 FsearchDatabaseEntry *
 fsearch_database_chunked_array_find_slow(FsearchDatabaseChunkedArray *self, FsearchDatabaseEntry *entry) {
     for (uint32_t i = 0; i < darray_get_num_items(self->chunks); ++i) {
-        DynamicArray *chunk = darray_get_item(self->chunks, i);
-        for (uint32_t j = 0; j < darray_get_num_items(chunk); ++j) {
-            FsearchDatabaseEntry *e = darray_get_item(chunk, j);
+        DynamicIdArray *chunk = darray_get_item(self->chunks, i);
+        for (uint32_t j = 0; j < idarray_get_num_items(chunk); ++j) {
+            FsearchDatabaseEntry *e = idarray_get_item(chunk, j);
             const int32_t res = self->entry_comp_func((void *)&e, (void *)&entry, self->compare_context);
             if (res == 0) {
                 return e;
@@ -396,11 +422,11 @@ fsearch_database_chunked_array_steal(FsearchDatabaseChunkedArray *self, FsearchD
         return NULL;
     }
     uint32_t chunk_idx = 0;
-    DynamicArray *chunk = get_chunk_for_entry(self, entry, &chunk_idx);
+    DynamicIdArray *chunk = get_chunk_for_entry(self, entry, &chunk_idx);
 
     uint32_t idx = 0;
-    if (darray_binary_search_with_data(chunk, entry, self->entry_comp_func, self->compare_context, &idx)) {
-        FsearchDatabaseEntry *e = darray_steal_item(chunk, idx);
+    if (idarray_binary_search_with_data(chunk, entry, self->entry_comp_func, self->compare_context, &idx)) {
+        FsearchDatabaseEntry *e = idarray_steal_item(chunk, idx);
         self->num_entries--;
 
         balance_chunk(self, chunk, chunk_idx);
@@ -440,20 +466,20 @@ remove_marked_entries(FsearchDatabaseChunkedArray *self, DynamicArray *destinati
             g_assert(num_expected == removed_entries);
             break;
         }
-        DynamicArray *chunk = darray_get_item(self->chunks, chunk_idx);
+        DynamicIdArray *chunk = darray_get_item(self->chunks, chunk_idx);
         uint32_t entry_idx = entry_start_idx;
-        while (entry_idx < darray_get_num_items(chunk)) {
+        while (entry_idx < idarray_get_num_items(chunk)) {
             if (num_entries_known && removed_entries >= num_expected) {
                 g_assert(num_expected == removed_entries);
                 break;
             }
-            FsearchDatabaseEntry *maybe_marked = darray_get_item(chunk, entry_idx);
+            FsearchDatabaseEntry *maybe_marked = idarray_get_item(chunk, entry_idx);
             if (is_marked(maybe_marked, self->entry_type)) {
                 uint32_t n_elements = 1;
 
                 // Peek ahead to find the full contiguous block of marked entries
-                while (entry_idx + n_elements < darray_get_num_items(chunk)) {
-                    FsearchDatabaseEntry *next_entry = darray_get_item(chunk, entry_idx + n_elements);
+                while (entry_idx + n_elements < idarray_get_num_items(chunk)) {
+                    FsearchDatabaseEntry *next_entry = idarray_get_item(chunk, entry_idx + n_elements);
                     if (!is_marked(next_entry, self->entry_type)) {
                         break; // End of contiguous block
                     }
@@ -461,8 +487,8 @@ remove_marked_entries(FsearchDatabaseChunkedArray *self, DynamicArray *destinati
                 }
 
                 // Steal or drop the entire contiguous block at once to minimize memmoves
-                removed_entries += destination ? darray_steal(chunk, entry_idx, n_elements, destination)
-                                               : darray_remove(chunk, entry_idx, n_elements);
+                removed_entries += destination ? idarray_steal(chunk, entry_idx, n_elements, destination)
+                                               : idarray_remove(chunk, entry_idx, n_elements);
 
                 // Note: Do NOT increment entry_idx here.
                 // Removing the elements shifts the rest of the array left,
@@ -496,6 +522,23 @@ fsearch_database_chunked_array_remove_marked_folders(FsearchDatabaseChunkedArray
     return remove_marked_entries(self, NULL, num_expected_entries);
 }
 
+uint32_t
+fsearch_database_chunked_array_drop_func(FsearchDatabaseChunkedArray *self, DynamicArrayStealFunc func, gpointer data) {
+    g_return_val_if_fail(self, 0);
+    g_return_val_if_fail(func, 0);
+
+    uint32_t removed_entries = 0;
+    uint32_t chunk_idx = 0;
+    while (chunk_idx < darray_get_num_items(self->chunks)) {
+        DynamicIdArray *chunk = darray_get_item(self->chunks, chunk_idx);
+        removed_entries += idarray_drop_items(chunk, func, data);
+        chunk_idx = advance_past_chunk(self, chunk, chunk_idx);
+    }
+
+    self->num_entries -= removed_entries;
+    return removed_entries;
+}
+
 DynamicArray *
 fsearch_database_chunked_array_steal_descendants(FsearchDatabaseChunkedArray *self,
                                                  FsearchDatabaseEntry *folder,
@@ -505,17 +548,26 @@ fsearch_database_chunked_array_steal_descendants(FsearchDatabaseChunkedArray *se
 
     // We can only steal in large chunks when descendants are sorted one after another
     // That's only guaranteed when sorted by path or path_full
-    const bool path_sorted = self->chain.length > 0
-                          && (self->chain.properties[0] == DATABASE_INDEX_PROPERTY_PATH
-                              || self->chain.properties[0] == DATABASE_INDEX_PROPERTY_PATH_FULL);
+    bool path_sorted = self->chain.length > 0
+                    && (self->chain.properties[0] == DATABASE_INDEX_PROPERTY_PATH
+                        || self->chain.properties[0] == DATABASE_INDEX_PROPERTY_PATH_FULL);
 
     uint32_t chunk_idx = 0;
     uint32_t entry_start_idx = 0;
-    if (path_sorted) {
-        // A dummy named "" sorts after `folder` and before every descendant
-        FsearchDatabaseEntry *probe = db_entry_get_dummy_for_name_and_parent(folder, "", self->entry_type);
-        DynamicArray *start_chunk = get_chunk_for_entry(self, probe, &chunk_idx);
-        darray_binary_search_with_data(start_chunk, probe, self->entry_comp_func, self->compare_context, &entry_start_idx);
+    // A dummy named "" sorts after `folder` and before every descendant
+    FsearchDatabaseEntry *probe = path_sorted ? db_entry_get_dummy_for_name_and_parent(folder, "", self->entry_type)
+                                              : NULL;
+    if (path_sorted && !probe) {
+        // The arena is out of space, so the descendants have to be searched like in any other sort order
+        path_sorted = false;
+    }
+    if (probe) {
+        DynamicIdArray *start_chunk = get_chunk_for_entry(self, probe, &chunk_idx);
+        idarray_binary_search_with_data(start_chunk,
+                                        probe,
+                                        self->entry_comp_func,
+                                        self->compare_context,
+                                        &entry_start_idx);
         g_clear_pointer(&probe, db_entry_free_no_unparent);
     }
 
@@ -529,7 +581,7 @@ fsearch_database_chunked_array_steal_descendants(FsearchDatabaseChunkedArray *se
             // We've found all known descendants and are done here.
             break;
         }
-        DynamicArray *chunk = darray_get_item(self->chunks, chunk_idx);
+        DynamicIdArray *chunk = darray_get_item(self->chunks, chunk_idx);
         uint32_t entry_idx = entry_start_idx;
 
         if (num_known_descendants >= 0 && path_sorted) {
@@ -538,18 +590,18 @@ fsearch_database_chunked_array_steal_descendants(FsearchDatabaseChunkedArray *se
             // path where we steal them in large chunks, instead of one by one.
             // It's also safe to not clamp n_elements since darray_steal will only steal the available number of
             // elements and report the actual amount stolen
-            num_known_descendants_stolen += darray_steal(chunk,
-                                                         entry_start_idx,
-                                                         num_known_descendants - num_known_descendants_stolen,
-                                                         descendants);
+            num_known_descendants_stolen += idarray_steal(chunk,
+                                                          entry_start_idx,
+                                                          num_known_descendants - num_known_descendants_stolen,
+                                                          descendants);
         }
         else {
             // Steal/remove descendants one by one.
-            while (entry_idx < darray_get_num_items(chunk)) {
-                FsearchDatabaseEntry *maybe_descendant = darray_get_item(chunk, entry_idx);
+            while (entry_idx < idarray_get_num_items(chunk)) {
+                FsearchDatabaseEntry *maybe_descendant = idarray_get_item(chunk, entry_idx);
                 if (db_entry_is_descendant(maybe_descendant, folder)) {
                     darray_add_item(descendants, maybe_descendant);
-                    darray_drop(chunk, entry_idx, 1);
+                    idarray_drop(chunk, entry_idx, 1);
                     continue;
                 }
                 if (path_sorted) {
@@ -589,16 +641,167 @@ fsearch_database_chunked_array_steal_descendants(FsearchDatabaseChunkedArray *se
     return descendants;
 }
 
+// Negative for entries sorted before the range, zero for entries within and positive for entries after it
+static inline int32_t
+name_range_cmp(FsearchDatabaseEntry *entry, const char *prefix, size_t prefix_len, gboolean exact) {
+    const char *name = db_entry_get_name_raw(entry);
+    if (!name) {
+        name = "";
+    }
+    if (!exact && strncmp(name, prefix, prefix_len) == 0) {
+        return 0;
+    }
+    return fsearch_file_utils_cmp_paths(name, prefix);
+}
+
+// Finds the first entry which isn't sorted before the range of `prefix`
+static void
+name_range_lower_bound(FsearchDatabaseChunkedArray *self,
+                       const char *prefix,
+                       size_t prefix_len,
+                       gboolean exact,
+                       uint32_t *chunk_idx_out,
+                       uint32_t *idx_out) {
+    // Find the first chunk whose last entry isn't sorted before the range
+    uint32_t lo = 0;
+    uint32_t hi = darray_get_num_items(self->chunks);
+    while (lo < hi) {
+        const uint32_t mid = lo + (hi - lo) / 2;
+        DynamicIdArray *chunk = darray_get_item(self->chunks, mid);
+        const uint32_t num_items = idarray_get_num_items(chunk);
+        if (num_items == 0 || name_range_cmp(idarray_get_item(chunk, num_items - 1), prefix, prefix_len, exact) < 0) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+
+    // Lower bound within that chunk
+    uint32_t start = 0;
+    if (lo < darray_get_num_items(self->chunks)) {
+        DynamicIdArray *chunk = darray_get_item(self->chunks, lo);
+        uint32_t end = idarray_get_num_items(chunk);
+        while (start < end) {
+            const uint32_t mid = start + (end - start) / 2;
+            if (name_range_cmp(idarray_get_item(chunk, mid), prefix, prefix_len, exact) < 0) {
+                start = mid + 1;
+            }
+            else {
+                end = mid;
+            }
+        }
+    }
+    *chunk_idx_out = lo;
+    *idx_out = start;
+}
+
+static uint32_t
+name_range_get(FsearchDatabaseChunkedArray *self,
+               const char *prefix,
+               size_t prefix_len,
+               gboolean exact,
+               DynamicArray *dest) {
+    uint32_t chunk_idx = 0;
+    uint32_t start = 0;
+    name_range_lower_bound(self, prefix, prefix_len, exact, &chunk_idx, &start);
+
+    uint32_t num_added = 0;
+    for (; chunk_idx < darray_get_num_items(self->chunks); ++chunk_idx, start = 0) {
+        DynamicIdArray *chunk = darray_get_item(self->chunks, chunk_idx);
+        const uint32_t num_items = idarray_get_num_items(chunk);
+        for (uint32_t i = start; i < num_items; ++i) {
+            FsearchDatabaseEntry *entry = idarray_get_item(chunk, i);
+            if (name_range_cmp(entry, prefix, prefix_len, exact) != 0) {
+                return num_added;
+            }
+            darray_add_item(dest, entry);
+            num_added++;
+        }
+    }
+    return num_added;
+}
+
+static bool
+name_range_is_empty(FsearchDatabaseChunkedArray *self, const char *prefix, size_t prefix_len) {
+    uint32_t chunk_idx = 0;
+    uint32_t start = 0;
+    name_range_lower_bound(self, prefix, prefix_len, FALSE, &chunk_idx, &start);
+
+    // The lower bound might be the end of its chunk
+    for (; chunk_idx < darray_get_num_items(self->chunks); ++chunk_idx, start = 0) {
+        DynamicIdArray *chunk = darray_get_item(self->chunks, chunk_idx);
+        if (start < idarray_get_num_items(chunk)) {
+            return name_range_cmp(idarray_get_item(chunk, start), prefix, prefix_len, FALSE) != 0;
+        }
+    }
+    return true;
+}
+
+// Looks up all spellings of the lower case `key` which only differ in the case of their ASCII letters. `spelling`
+// holds the first characters of the spelling which is currently looked at. Spellings whose beginning doesn't occur in
+// the array are skipped right away, so the number of lookups depends on the names in the array, not on the number of
+// letters in the key.
+static uint32_t
+name_range_get_icase(FsearchDatabaseChunkedArray *self,
+                     const char *key,
+                     size_t pos,
+                     GString *spelling,
+                     gboolean exact,
+                     DynamicArray *dest) {
+    while (key[pos] != '\0' && !g_ascii_isalpha(key[pos])) {
+        g_string_append_c(spelling, key[pos++]);
+    }
+    if (key[pos] == '\0') {
+        return name_range_get(self, spelling->str, spelling->len, exact, dest);
+    }
+    if (spelling->len > 0 && name_range_is_empty(self, spelling->str, spelling->len)) {
+        return 0;
+    }
+
+    // Upper case letters are sorted first, so the ranges get appended in array order
+    const char letters[] = {g_ascii_toupper(key[pos]), g_ascii_tolower(key[pos])};
+    const size_t spelling_len = spelling->len;
+    uint32_t num_added = 0;
+    for (uint32_t i = 0; i < G_N_ELEMENTS(letters); ++i) {
+        g_string_append_c(spelling, letters[i]);
+        num_added += name_range_get_icase(self, key, pos + 1, spelling, exact, dest);
+        g_string_truncate(spelling, spelling_len);
+    }
+    return num_added;
+}
+
+uint32_t
+fsearch_database_chunked_array_get_name_range(FsearchDatabaseChunkedArray *self,
+                                              const char *prefix,
+                                              gboolean exact,
+                                              gboolean ignore_case,
+                                              DynamicArray *dest) {
+    g_return_val_if_fail(self, 0);
+    g_return_val_if_fail(prefix, 0);
+    g_return_val_if_fail(dest, 0);
+
+    if (self->chain.length == 0 || self->chain.properties[0] != DATABASE_INDEX_PROPERTY_NAME) {
+        return 0;
+    }
+    if (ignore_case) {
+        g_autofree char *key = g_ascii_strdown(prefix, -1);
+        g_autoptr(GString) spelling = g_string_sized_new(strlen(key));
+        return name_range_get_icase(self, key, 0, spelling, exact, dest);
+    }
+    return name_range_get(self, prefix, strlen(prefix), exact, dest);
+}
+
 FsearchDatabaseEntry *
 fsearch_database_chunked_array_get_entry(FsearchDatabaseChunkedArray *self, uint32_t idx) {
     g_return_val_if_fail(self, NULL);
     g_return_val_if_fail(idx < self->num_entries, NULL);
 
     for (uint32_t i = 0; i < darray_get_num_items(self->chunks); ++i) {
-        DynamicArray *chunk = darray_get_item(self->chunks, i);
-        const uint32_t num_items = darray_get_num_items(chunk);
+        DynamicIdArray *chunk = darray_get_item(self->chunks, i);
+        const uint32_t num_items = idarray_get_num_items(chunk);
         if (idx < num_items) {
-            return darray_get_item(chunk, idx);
+            return idarray_get_item(chunk, idx);
         }
         idx -= num_items;
     }
@@ -624,8 +827,8 @@ fsearch_database_chunked_array_get_joined(FsearchDatabaseChunkedArray *self) {
 
     DynamicArray *joined = darray_new(self->num_entries);
     for (uint32_t i = 0; i < darray_get_num_items(self->chunks); ++i) {
-        DynamicArray *chunk = darray_get_item(self->chunks, i);
-        darray_add_array(joined, chunk);
+        DynamicIdArray *chunk = darray_get_item(self->chunks, i);
+        darray_add_idarray(joined, chunk);
     }
     return joined;
 }
\ No newline at end of file
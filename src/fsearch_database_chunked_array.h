@@ -55,15 +55,32 @@ fsearch_database_chunked_array_steal_descendants(FsearchDatabaseChunkedArray *se
 uint32_t
 fsearch_database_chunked_array_remove_marked_folders(FsearchDatabaseChunkedArray *self, int32_t num_expected_entries);
 
+// Removes every entry for which `func` returns true with a single pass over all chunks, without freeing them, and
+// returns how many there were. The entries aren't compared with each other, so they may be freed already when only
+// their address is used by `func`.
+uint32_t
+fsearch_database_chunked_array_drop_func(FsearchDatabaseChunkedArray *self, DynamicArrayStealFunc func, gpointer data);
+
 FsearchDatabaseEntry *
 fsearch_database_chunked_array_find(FsearchDatabaseChunkedArray *self, FsearchDatabaseEntry *entry);
 
+// Appends every entry whose name starts with `prefix` (or is equal to it, if `exact` is set) to `dest`, in array
+// order, and returns the number of appended entries. With `ignore_case` the case of ASCII letters is ignored. Uses
+// binary search, so the array must be sorted by name first. Returns 0 without touching `dest` if it isn't.
+uint32_t
+fsearch_database_chunked_array_get_name_range(FsearchDatabaseChunkedArray *self,
+                                              const char *prefix,
+                                              gboolean exact,
+                                              gboolean ignore_case,
+                                              DynamicArray *dest);
+
 FsearchDatabaseEntry *
 fsearch_database_chunked_array_get_entry(FsearchDatabaseChunkedArray *self, uint32_t idx);
 
 uint32_t
 fsearch_database_chunked_array_get_num_entries(FsearchDatabaseChunkedArray *self);
 
+// Returns the chunks in order, each one is a DynamicIdArray of entries
 DynamicArray *
 fsearch_database_chunked_array_get_chunks(FsearchDatabaseChunkedArray *self);
 
@@ -1,6 +1,8 @@
 #include "fsearch_database_entry.h"
+#include "fsearch_arena.h"
 #include "fsearch_array.h"
 #include "fsearch_database_entry_flags.h"
+#include "fsearch_database_file_type.h"
 #include "fsearch_database_index_properties.h"
 #include "fsearch_file_utils.h"
 #include "fsearch_string_utils.h"
@@ -21,17 +23,40 @@
     (DATABASE_INDEX_PROPERTY_FLAG_NUM_FOLDERS | DATABASE_INDEX_PROPERTY_FLAG_NUM_FILES)
 
 typedef struct FsearchDatabaseEntry {
-    FsearchDatabaseEntry *parent;
+    // Distance from the entry to its parent in bytes, 0 if it has none. Unlike a pointer this stays valid when the
+    // entries are stored in a database file and mapped to another address, see db_entry_copy_image().
+    int64_t parent_offset;
 
     uint32_t attribute_flags;
     uint16_t flags;
+    // Set when the entry is created, see db_entry_get_file_type_id(). Fits into the padding before `attributes`.
+    uint16_t file_type_id;
     // Make sure the attributes member is aligned to its largest data type
     alignas(int64_t) uint8_t attributes[];
 } FsearchDatabaseEntry;
 
+static inline FsearchDatabaseEntry *
+entry_get_parent(const FsearchDatabaseEntry *entry) {
+    if (!entry->parent_offset) {
+        return NULL;
+    }
+    return (FsearchDatabaseEntry *)((uintptr_t)entry + (uintptr_t)entry->parent_offset);
+}
+
+static inline void
+entry_set_parent(FsearchDatabaseEntry *entry, FsearchDatabaseEntry *parent) {
+    entry->parent_offset = parent ? (int64_t)((uintptr_t)parent - (uintptr_t)entry) : 0;
+}
+
 static size_t
 entry_get_size_for_flags(FsearchDatabaseIndexPropertyFlags attribute_flags, const char *name, size_t name_len);
 
+static size_t
+entry_get_size(FsearchDatabaseEntry *entry) {
+    const char *name = db_entry_get_name_raw(entry);
+    return entry_get_size_for_flags(entry->attribute_flags, name, name ? strlen(name) : 0);
+}
+
 static void
 build_path_recursively(FsearchDatabaseEntry *folder, GString *str, size_t name_offset) {
     if (G_UNLIKELY(!folder)) {
@@ -40,8 +65,9 @@ build_path_recursively(FsearchDatabaseEntry *folder, GString *str, size_t name_o
     g_assert(folder->flags & FSEARCH_DATABASE_ENTRY_FLAG_TYPE_FOLDER);
     g_assert(folder->attributes != NULL);
 
-    if (G_LIKELY(folder->parent)) {
-        build_path_recursively(folder->parent, str, name_offset);
+    FsearchDatabaseEntry *parent = entry_get_parent(folder);
+    if (G_LIKELY(parent)) {
+        build_path_recursively(parent, str, name_offset);
     }
     const char *name = db_entry_get_attribute_name_for_offset(folder, name_offset);
     if (G_LIKELY(name[0] != '\0' && strcmp(name, G_DIR_SEPARATOR_S) != 0)) {
@@ -54,8 +80,6 @@ void
 db_entry_compare_context_free(FsearchDatabaseEntryCompareContext *ctx) {
     g_return_if_fail(ctx);
 
-    g_clear_pointer(&ctx->file_type_table, g_hash_table_unref);
-    g_clear_pointer(&ctx->entry_to_file_type_table, g_hash_table_unref);
     g_clear_pointer(&ctx, free);
 }
 
@@ -64,8 +88,6 @@ db_entry_compare_context_new(FsearchDatabaseSortOrderChain chain) {
     FsearchDatabaseEntryCompareContext *ctx = calloc(1, sizeof(FsearchDatabaseEntryCompareContext));
     g_assert(ctx);
 
-    ctx->file_type_table = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
-    ctx->entry_to_file_type_table = g_hash_table_new(NULL, NULL);
     ctx->chain = chain;
     return ctx;
 }
@@ -82,7 +104,8 @@ db_entry_is_file(FsearchDatabaseEntry *entry) {
 
 bool
 db_entry_is_sibling(FsearchDatabaseEntry *entry, FsearchDatabaseEntry *maybe_sibling) {
-    if (entry->parent && entry->parent == maybe_sibling->parent) {
+    FsearchDatabaseEntry *parent = entry_get_parent(entry);
+    if (parent && parent == entry_get_parent(maybe_sibling)) {
         return true;
     }
     return false;
@@ -91,10 +114,10 @@ db_entry_is_sibling(FsearchDatabaseEntry *entry, FsearchDatabaseEntry *maybe_sib
 bool
 db_entry_is_descendant(FsearchDatabaseEntry *entry, FsearchDatabaseEntry *maybe_ancestor) {
     while (entry) {
-        if (entry->parent == maybe_ancestor) {
+        if (entry_get_parent(entry) == maybe_ancestor) {
             return true;
         }
-        entry = entry->parent;
+        entry = entry_get_parent(entry);
     }
     return false;
 }
@@ -127,8 +150,8 @@ db_entry_get_root_path(FsearchDatabaseEntry *entry) {
         return NULL;
     }
 
-    while (entry->parent) {
-        entry = entry->parent;
+    while (entry_get_parent(entry)) {
+        entry = entry_get_parent(entry);
     }
     return db_entry_get_name_raw(entry);
 }
@@ -149,10 +172,11 @@ db_entry_get_path_full(FsearchDatabaseEntry *entry) {
 
 void
 db_entry_append_path(FsearchDatabaseEntry *entry, GString *str) {
-    if (entry->parent) {
+    FsearchDatabaseEntry *parent = entry_get_parent(entry);
+    if (parent) {
         size_t name_offset = 0;
-        db_entry_get_attribute_offset(entry->parent->attribute_flags, DATABASE_INDEX_PROPERTY_NAME, &name_offset);
-        build_path_recursively(entry->parent, str, name_offset);
+        db_entry_get_attribute_offset(parent->attribute_flags, DATABASE_INDEX_PROPERTY_NAME, &name_offset);
+        build_path_recursively(parent, str, name_offset);
     }
     if (str->len > 1) {
         g_string_set_size(str, str->len - 1);
@@ -161,10 +185,11 @@ db_entry_append_path(FsearchDatabaseEntry *entry, GString *str) {
 
 void
 db_entry_append_full_path(FsearchDatabaseEntry *entry, GString *str) {
-    if (entry->parent) {
+    FsearchDatabaseEntry *parent = entry_get_parent(entry);
+    if (parent) {
         size_t name_offset = 0;
-        db_entry_get_attribute_offset(entry->parent->attribute_flags, DATABASE_INDEX_PROPERTY_NAME, &name_offset);
-        build_path_recursively(entry->parent, str, name_offset);
+        db_entry_get_attribute_offset(parent->attribute_flags, DATABASE_INDEX_PROPERTY_NAME, &name_offset);
+        build_path_recursively(parent, str, name_offset);
     }
 
     const char *name = db_entry_get_name_raw(entry);
@@ -226,7 +251,7 @@ db_entry_get_name_raw(FsearchDatabaseEntry *entry) {
 
 FsearchDatabaseEntry *
 db_entry_get_parent(FsearchDatabaseEntry *entry) {
-    return entry ? entry->parent : NULL;
+    return entry ? entry_get_parent(entry) : NULL;
 }
 
 FsearchDatabaseEntryType
@@ -245,20 +270,20 @@ db_entry_get_type(FsearchDatabaseEntry *entry) {
 void
 db_entry_free_no_unparent(FsearchDatabaseEntry *entry) {
     g_return_if_fail(entry);
-    g_clear_pointer(&entry, free);
+    fsearch_arena_free(entry, entry_get_size(entry));
 }
 
 void
 db_entry_free(FsearchDatabaseEntry *entry) {
     g_return_if_fail(entry);
     db_entry_set_parent(entry, NULL);
-    g_clear_pointer(&entry, free);
+    fsearch_arena_free(entry, entry_get_size(entry));
 }
 
 void
 db_entry_free_full(FsearchDatabaseEntry *entry) {
     while (entry) {
-        FsearchDatabaseEntry *parent = entry->parent;
+        FsearchDatabaseEntry *parent = entry_get_parent(entry);
         g_clear_pointer(&entry, db_entry_free);
         entry = parent;
     }
@@ -266,16 +291,116 @@ db_entry_free_full(FsearchDatabaseEntry *entry) {
 
 FsearchDatabaseEntry *
 db_entry_get_deep_copy(FsearchDatabaseEntry *entry) {
+    const size_t entry_size = entry_get_size(entry);
+    FsearchDatabaseEntry *copy = fsearch_arena_alloc(entry_size);
+    if (G_UNLIKELY(!copy)) {
+        return NULL;
+    }
+    memcpy(copy, entry, entry_size);
+
+    FsearchDatabaseEntry *parent = entry_get_parent(entry);
+    FsearchDatabaseEntry *parent_copy = parent ? db_entry_get_deep_copy(parent) : NULL;
+    if (G_UNLIKELY(parent && !parent_copy)) {
+        fsearch_arena_free(copy, entry_size);
+        return NULL;
+    }
+    entry_set_parent(copy, parent_copy);
+    return copy;
+}
+
+static FsearchDatabaseIndexPropertyFlags
+entry_get_image_flags(FsearchDatabaseEntry *entry, FsearchDatabaseIndexPropertyFlags attribute_flags) {
+    return db_entry_is_folder(entry) ? attribute_flags | DATABASE_INDEX_PROPERTY_FLAG_FOLDER_DEFAULTS : attribute_flags;
+}
+
+static inline size_t
+entry_round_up_image_size(size_t size) {
+    return (size + FSEARCH_ARENA_ALIGNMENT - 1) & ~(size_t)(FSEARCH_ARENA_ALIGNMENT - 1);
+}
+
+size_t
+db_entry_get_image_size(FsearchDatabaseEntry *entry, FsearchDatabaseIndexPropertyFlags attribute_flags) {
+    g_return_val_if_fail(entry, 0);
     const char *name = db_entry_get_name_raw(entry);
-    const size_t entry_size = entry_get_size_for_flags(entry->attribute_flags, name, strlen(name));
+    return entry_round_up_image_size(
+        entry_get_size_for_flags(entry_get_image_flags(entry, attribute_flags), name, name ? strlen(name) : 0));
+}
 
-    FsearchDatabaseEntry *copy = calloc(1, entry_size);
-    g_assert_nonnull(copy);
+void
+db_entry_copy_image(FsearchDatabaseEntry *entry,
+                    FsearchDatabaseIndexPropertyFlags attribute_flags,
+                    void *dest,
+                    int64_t parent_offset) {
+    g_return_if_fail(entry);
+    g_return_if_fail(dest);
 
-    memcpy(copy, entry, entry_size);
+    const FsearchDatabaseIndexPropertyFlags image_flags = entry_get_image_flags(entry, attribute_flags);
+    // The padding is stored as well, so it must not be random
+    memset(dest, 0, db_entry_get_image_size(entry, attribute_flags));
+    FsearchDatabaseEntry *image = dest;
+    if (entry->attribute_flags == image_flags) {
+        memcpy(image, entry, entry_get_size(entry));
+    }
+    else {
+        // Entries which were created with other attributes, e.g. by the scanner, get the ones of the index, like they
+        // would if they were created for it
+        memcpy(image, entry, sizeof(FsearchDatabaseEntry));
+        image->attribute_flags = image_flags;
+        const FsearchDatabaseIndexProperty properties[] = {
+            DATABASE_INDEX_PROPERTY_SIZE,
+            DATABASE_INDEX_PROPERTY_MODIFICATION_TIME,
+            DATABASE_INDEX_PROPERTY_ACCESS_TIME,
+            DATABASE_INDEX_PROPERTY_STATUS_CHANGE_TIME,
+            DATABASE_INDEX_PROPERTY_NUM_FILES,
+            DATABASE_INDEX_PROPERTY_NUM_FOLDERS,
+        };
+        for (uint32_t i = 0; i < G_N_ELEMENTS(properties); i++) {
+            size_t offset = 0;
+            if (db_entry_get_attribute_offset(image_flags, properties[i], &offset)) {
+                const bool is_count = properties[i] == DATABASE_INDEX_PROPERTY_NUM_FILES
+                                   || properties[i] == DATABASE_INDEX_PROPERTY_NUM_FOLDERS;
+                db_entry_get_attribute(entry,
+                                       properties[i],
+                                       image->attributes + offset,
+                                       is_count ? sizeof(int32_t) : sizeof(int64_t));
+            }
+        }
+        const char *name = db_entry_get_name_raw(entry);
+        size_t name_offset = 0;
+        if (name && db_entry_get_attribute_offset(image_flags, DATABASE_INDEX_PROPERTY_NAME, &name_offset)) {
+            strcpy((char *)image->attributes + name_offset, name);
+        }
+    }
+    image->parent_offset = parent_offset;
+    // Marks and the monitoring state only apply to the running instance
+    image->flags &= FSEARCH_DATABASE_ENTRY_FLAG_TYPE_FOLDER | FSEARCH_DATABASE_ENTRY_FLAG_TYPE_FILE;
+}
 
-    copy->parent = entry->parent ? db_entry_get_deep_copy(entry->parent) : NULL;
-    return copy;
+size_t
+db_entry_check_image(const void *image, size_t max_size, FsearchDatabaseIndexPropertyFlags attribute_flags) {
+    g_return_val_if_fail(image, 0);
+
+    const FsearchDatabaseEntry *entry = image;
+    if (max_size < sizeof(FsearchDatabaseEntry)
+        || (entry->flags != FSEARCH_DATABASE_ENTRY_FLAG_TYPE_FOLDER
+            && entry->flags != FSEARCH_DATABASE_ENTRY_FLAG_TYPE_FILE)
+        || entry->attribute_flags != entry_get_image_flags((FsearchDatabaseEntry *)entry, attribute_flags)) {
+        return 0;
+    }
+    size_t name_offset = 0;
+    db_entry_get_attribute_offset(entry->attribute_flags, DATABASE_INDEX_PROPERTY_NAME, &name_offset);
+    name_offset += sizeof(FsearchDatabaseEntry);
+    if (name_offset >= max_size) {
+        return 0;
+    }
+    const char *name = (const char *)image + name_offset;
+    const size_t name_len = strnlen(name, max_size - name_offset);
+    if (name_len == max_size - name_offset) {
+        return 0;
+    }
+    const size_t image_size = entry_round_up_image_size(
+        entry_get_size_for_flags(entry->attribute_flags, name, name_len));
+    return image_size <= max_size ? image_size : 0;
 }
 
 void
@@ -320,8 +445,8 @@ db_entry_get_attribute_flags(FsearchDatabaseEntry *entry) {
 uint32_t
 db_entry_get_depth(FsearchDatabaseEntry *entry) {
     uint32_t depth = 0;
-    while (entry && entry->parent) {
-        entry = entry->parent;
+    while (entry && entry_get_parent(entry)) {
+        entry = entry_get_parent(entry);
         depth++;
     }
     return depth;
@@ -330,7 +455,7 @@ db_entry_get_depth(FsearchDatabaseEntry *entry) {
 static FsearchDatabaseEntry *
 db_entry_get_parent_nth(FsearchDatabaseEntry *entry, uint32_t nth) {
     while (entry && nth > 0) {
-        entry = entry->parent;
+        entry = entry_get_parent(entry);
         nth--;
     }
     return entry;
@@ -341,8 +466,8 @@ sort_entry_by_path_recursive(FsearchDatabaseEntry *entry_1, FsearchDatabaseEntry
     if (G_UNLIKELY(!entry_1 || !entry_2)) {
         return;
     }
-    if (entry_1->parent) {
-        sort_entry_by_path_recursive(entry_1->parent, entry_2->parent, name_offset, res);
+    if (entry_get_parent(entry_1)) {
+        sort_entry_by_path_recursive(entry_get_parent(entry_1), entry_get_parent(entry_2), name_offset, res);
     }
     if (*res != 0) {
         return;
@@ -365,33 +490,27 @@ db_entry_compare_entries_by_size(FsearchDatabaseEntry **a, FsearchDatabaseEntry
     return 0;
 }
 
-static const char *
-get_file_type(FsearchDatabaseEntry *entry, GHashTable *file_type_table, GHashTable *entry_table) {
-    char *cached_type = g_hash_table_lookup(entry_table, entry);
-    if (cached_type) {
-        return cached_type;
-    }
+uint16_t
+db_entry_get_file_type_id(FsearchDatabaseEntry *entry) {
+    g_return_val_if_fail(entry, FSEARCH_DATABASE_FILE_TYPE_ID_NONE);
+    return entry->file_type_id;
+}
 
-    const char *name = db_entry_get_name_raw_for_display(entry);
-    g_autofree char *type = fsearch_file_utils_get_file_type_non_localized(name,
-                                                                           db_entry_is_folder(entry) ? TRUE : FALSE);
-    cached_type = g_hash_table_lookup(file_type_table, type);
-    if (!cached_type) {
-        g_hash_table_add(file_type_table, type);
-        cached_type = g_steal_pointer(&type);
-    }
-    g_hash_table_insert(entry_table, entry, cached_type);
-    return cached_type;
+void
+db_entry_set_file_type_id(FsearchDatabaseEntry *entry, uint16_t file_type_id) {
+    g_return_if_fail(entry);
+    entry->file_type_id = file_type_id;
 }
 
 int
 db_entry_compare_entries_by_type(FsearchDatabaseEntry **a, FsearchDatabaseEntry **b, gpointer data) {
-    FsearchDatabaseEntryCompareContext *comp_ctx = data;
-
-    const char *file_type_a = get_file_type(*a, comp_ctx->file_type_table, comp_ctx->entry_to_file_type_table);
-    const char *file_type_b = get_file_type(*b, comp_ctx->file_type_table, comp_ctx->entry_to_file_type_table);
-
-    return strcmp(file_type_a, file_type_b);
+    const uint16_t type_a = db_entry_get_file_type_id(*a);
+    const uint16_t type_b = db_entry_get_file_type_id(*b);
+    if (type_a == type_b) {
+        return 0;
+    }
+    return strcmp(fsearch_database_file_type_get_description(type_a),
+                  fsearch_database_file_type_get_description(type_b));
 }
 
 static int
@@ -465,12 +584,12 @@ db_entry_compare_entries_by_full_path(FsearchDatabaseEntry **a, FsearchDatabaseE
     FsearchDatabaseEntry *tmp = (FsearchDatabaseEntry *)entry_a;
     for (uint32_t i = 0; i < a_n_path_elements; i++) {
         a_path[a_n_path_elements - i - 1] = db_entry_get_name_raw(tmp);
-        tmp = tmp->parent;
+        tmp = entry_get_parent(tmp);
     }
     tmp = (FsearchDatabaseEntry *)entry_b;
     for (uint32_t i = 0; i < b_n_path_elements; i++) {
         b_path[b_n_path_elements - i - 1] = db_entry_get_name_raw(tmp);
-        tmp = tmp->parent;
+        tmp = entry_get_parent(tmp);
     }
 
     const uint32_t limit = MIN(a_n_path_elements, b_n_path_elements);
@@ -501,15 +620,15 @@ db_entry_compare_entries_by_path(FsearchDatabaseEntry **a, FsearchDatabaseEntry
 #if (0)
     const char *a_path[a_depth];
     const char *b_path[b_depth];
-    FsearchDatabaseEntry *tmp = (FsearchDatabaseEntry *)entry_a->parent;
+    FsearchDatabaseEntry *tmp = entry_get_parent(entry_a);
     for (uint32_t i = 0; i < a_depth; i++) {
         a_path[a_depth - i - 1] = tmp->name;
-        tmp = (FsearchDatabaseEntry *)tmp->parent;
+        tmp = entry_get_parent(tmp);
     }
-    tmp = (FsearchDatabaseEntry *)entry_b->parent;
+    tmp = entry_get_parent(entry_b);
     for (uint32_t i = 0; i < b_depth; i++) {
         b_path[b_depth - i - 1] = tmp->name;
-        tmp = (FsearchDatabaseEntry *)tmp->parent;
+        tmp = entry_get_parent(tmp);
     }
 
     const uint32_t limit = MIN(a_depth, b_depth);
@@ -531,7 +650,10 @@ db_entry_compare_entries_by_path(FsearchDatabaseEntry **a, FsearchDatabaseEntry
 #endif
 
     size_t name_offset = 0;
-    FsearchDatabaseEntry *folder_ref = entry_a->parent ? entry_a->parent : entry_b->parent;
+    FsearchDatabaseEntry *folder_ref = entry_get_parent(entry_a);
+    if (!folder_ref) {
+        folder_ref = entry_get_parent(entry_b);
+    }
     const uint32_t folder_flags = folder_ref ? folder_ref->attribute_flags
                                              : (entry_a->attribute_flags | DATABASE_INDEX_PROPERTY_FLAG_FOLDER_DEFAULTS);
     if (!db_entry_get_attribute_offset(folder_flags, DATABASE_INDEX_PROPERTY_NAME, &name_offset)) {
@@ -540,19 +662,19 @@ db_entry_compare_entries_by_path(FsearchDatabaseEntry **a, FsearchDatabaseEntry
 
     int res = 0;
     if (a_depth == b_depth) {
-        sort_entry_by_path_recursive(entry_a->parent, entry_b->parent, name_offset, &res);
+        sort_entry_by_path_recursive(entry_get_parent(entry_a), entry_get_parent(entry_b), name_offset, &res);
         return res;
     }
     else if (a_depth > b_depth) {
         const uint32_t diff = a_depth - b_depth;
-        FsearchDatabaseEntry *parent_a = db_entry_get_parent_nth(entry_a->parent, diff);
-        sort_entry_by_path_recursive(parent_a, entry_b->parent, name_offset, &res);
+        FsearchDatabaseEntry *parent_a = db_entry_get_parent_nth(entry_get_parent(entry_a), diff);
+        sort_entry_by_path_recursive(parent_a, entry_get_parent(entry_b), name_offset, &res);
         return res == 0 ? 1 : res;
     }
     else {
         const uint32_t diff = b_depth - a_depth;
-        FsearchDatabaseEntry *parent_b = db_entry_get_parent_nth(entry_b->parent, diff);
-        sort_entry_by_path_recursive(entry_a->parent, parent_b, name_offset, &res);
+        FsearchDatabaseEntry *parent_b = db_entry_get_parent_nth(entry_get_parent(entry_b), diff);
+        sort_entry_by_path_recursive(entry_get_parent(entry_a), parent_b, name_offset, &res);
         return res == 0 ? -1 : res;
     }
 }
@@ -577,7 +699,7 @@ db_entry_update_folder_size(FsearchDatabaseEntry *folder, off_t size) {
             old_size += size;
         }
         db_entry_set_attribute_for_offset(folder, offset, &old_size, sizeof(old_size));
-        db_entry_update_folder_size(folder->parent, size);
+        db_entry_update_folder_size(entry_get_parent(folder), size);
     }
 }
 
@@ -611,7 +733,7 @@ db_entry_set_size(FsearchDatabaseEntry *entry, off_t size) {
         db_entry_get_attribute_for_offset(entry, offset, &old_size, sizeof(old_size));
         if (old_size != size) {
             db_entry_set_attribute_for_offset(entry, offset, &size, sizeof(size));
-            db_entry_update_folder_size(entry->parent, size - old_size);
+            db_entry_update_folder_size(entry_get_parent(entry), size - old_size);
         }
     }
 }
@@ -674,7 +796,7 @@ increment_num_folders(FsearchDatabaseEntry *entry) {
 void
 db_entry_set_parent_no_update(FsearchDatabaseEntry *entry, FsearchDatabaseEntry *parent) {
     g_return_if_fail(entry != NULL);
-    entry->parent = parent;
+    entry_set_parent(entry, parent);
 }
 
 void
@@ -694,10 +816,10 @@ db_entry_increment_childcount(FsearchDatabaseEntry *entry, FsearchDatabaseEntryT
 void
 db_entry_set_parent_update_childcount(FsearchDatabaseEntry *entry, FsearchDatabaseEntry *parent) {
     g_return_if_fail(entry != NULL);
-    if (entry->parent) {
+    if (entry_get_parent(entry)) {
         // The entry already has a parent. First un-parent it and update its current parents state:
         // * Decrement file/folder count
-        FsearchDatabaseEntry *p = entry->parent;
+        FsearchDatabaseEntry *p = entry_get_parent(entry);
         if (db_entry_is_folder(entry)) {
             decrement_num_folders(p);
         }
@@ -716,16 +838,16 @@ db_entry_set_parent_update_childcount(FsearchDatabaseEntry *entry, FsearchDataba
             increment_num_files(parent);
         }
     }
-    entry->parent = parent;
+    entry_set_parent(entry, parent);
 }
 
 void
 db_entry_set_parent(FsearchDatabaseEntry *entry, FsearchDatabaseEntry *parent) {
     g_return_if_fail(entry != NULL);
-    if (entry->parent) {
+    if (entry_get_parent(entry)) {
         // The entry already has a parent. First un-parent it and update its current parents state:
         // * Decrement file/folder count
-        FsearchDatabaseEntry *p = entry->parent;
+        FsearchDatabaseEntry *p = entry_get_parent(entry);
         if (db_entry_is_folder(entry)) {
             decrement_num_folders(p);
         }
@@ -751,7 +873,7 @@ db_entry_set_parent(FsearchDatabaseEntry *entry, FsearchDatabaseEntry *parent) {
         db_entry_get_attribute(entry, DATABASE_INDEX_PROPERTY_SIZE, &size, sizeof(size));
         db_entry_update_folder_size(parent, size);
     }
-    entry->parent = parent;
+    entry_set_parent(entry, parent);
 }
 
 bool
@@ -854,13 +976,28 @@ db_entry_new(FsearchDatabaseIndexPropertyFlags attribute_flags,
              const char *name,
              FsearchDatabaseEntry *parent,
              FsearchDatabaseEntryType type) {
+    return db_entry_new_with_file_type_id(attribute_flags,
+                                          name,
+                                          parent,
+                                          type,
+                                          fsearch_database_file_type_get_id(name, type == DATABASE_ENTRY_TYPE_FOLDER));
+}
+
+FsearchDatabaseEntry *
+db_entry_new_with_file_type_id(FsearchDatabaseIndexPropertyFlags attribute_flags,
+                               const char *name,
+                               FsearchDatabaseEntry *parent,
+                               FsearchDatabaseEntryType type,
+                               uint16_t file_type_id) {
     if (type == DATABASE_ENTRY_TYPE_FOLDER) {
         attribute_flags = attribute_flags | DATABASE_INDEX_PROPERTY_FLAG_FOLDER_DEFAULTS;
     }
     const size_t name_len = name ? strlen(name) : 0;
     const size_t entry_size = entry_get_size_for_flags(attribute_flags, name, name_len);
-    FsearchDatabaseEntry *entry = calloc(1, entry_size);
-    g_assert_nonnull(entry);
+    FsearchDatabaseEntry *entry = fsearch_arena_alloc(entry_size);
+    if (G_UNLIKELY(!entry)) {
+        return NULL;
+    }
 
     if (type == DATABASE_ENTRY_TYPE_FOLDER) {
         entry->flags |= FSEARCH_DATABASE_ENTRY_FLAG_TYPE_FOLDER;
@@ -873,6 +1010,7 @@ db_entry_new(FsearchDatabaseIndexPropertyFlags attribute_flags,
     }
 
     entry->attribute_flags = attribute_flags;
+    entry->file_type_id = file_type_id;
 
     size_t name_offset = 0;
     if (db_entry_get_attribute_offset(attribute_flags, DATABASE_INDEX_PROPERTY_NAME, &name_offset)) {
@@ -890,7 +1028,15 @@ FsearchDatabaseEntry *
 db_entry_get_dummy_for_name_and_parent(FsearchDatabaseEntry *parent, const char *name, FsearchDatabaseEntryType type) {
     g_return_val_if_fail(name, NULL);
 
-    FsearchDatabaseEntry *entry = db_entry_new(DATABASE_INDEX_PROPERTY_FLAG_NONE, name, NULL, type);
+    // Dummies are only used to look up entries by name, so their type doesn't matter
+    FsearchDatabaseEntry *entry = db_entry_new_with_file_type_id(DATABASE_INDEX_PROPERTY_FLAG_NONE,
+                                                                 name,
+                                                                 NULL,
+                                                                 type,
+                                                                 FSEARCH_DATABASE_FILE_TYPE_ID_NONE);
+    if (G_UNLIKELY(!entry)) {
+        return NULL;
+    }
 
     // Don't update parent state (we don't want the parent to change its size or child counts)
     db_entry_set_parent_no_update(entry, parent);
@@ -908,6 +1054,10 @@ db_entry_new_with_attributes(FsearchDatabaseIndexPropertyFlags attribute_flags,
 
     // Set Parent to NULL. We will set the parent anyway after setting all the attributes
     FsearchDatabaseEntry *entry = db_entry_new(attribute_flags, name, NULL, type);
+    if (G_UNLIKELY(!entry)) {
+        va_end(args);
+        return NULL;
+    }
 
     FsearchDatabaseIndexProperty attribute = va_arg(args, int);
     while (attribute != DATABASE_INDEX_PROPERTY_NONE) {
@@ -1036,7 +1186,7 @@ bool
 db_entry_is_monitored_failed(FsearchDatabaseEntry *entry) {
     g_return_val_if_fail(entry, false);
     if (db_entry_is_file(entry)) {
-        entry = entry->parent;
+        entry = entry_get_parent(entry);
     }
     return entry ? (entry->flags & FSEARCH_DATABASE_ENTRY_FLAG_MONITORED_FAILED) != 0 : false;
 }
@@ -1045,7 +1195,7 @@ bool
 db_entry_is_monitored_fanotify(FsearchDatabaseEntry *entry) {
     g_return_val_if_fail(entry, false);
     if (db_entry_is_file(entry)) {
-        entry = entry->parent;
+        entry = entry_get_parent(entry);
     }
     return entry ? (entry->flags & FSEARCH_DATABASE_ENTRY_FLAG_MONITORED_FANOTIFY) != 0 : false;
 }
@@ -1068,7 +1218,7 @@ bool
 db_entry_is_monitored_inotify(FsearchDatabaseEntry *entry) {
     g_return_val_if_fail(entry, false);
     if (db_entry_is_file(entry)) {
-        entry = entry->parent;
+        entry = entry_get_parent(entry);
     }
     return entry ? (entry->flags & FSEARCH_DATABASE_ENTRY_FLAG_MONITORED_INOTIFY) != 0 : false;
 }
\ No newline at end of file
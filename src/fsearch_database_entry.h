@@ -18,8 +18,6 @@ typedef enum {
 typedef struct FsearchDatabaseEntry FsearchDatabaseEntry;
 
 typedef struct FsearchDatabaseEntryCompareContext {
-    GHashTable *file_type_table;
-    GHashTable *entry_to_file_type_table;
     FsearchDatabaseSortOrderChain chain;
 } FsearchDatabaseEntryCompareContext;
 
@@ -112,6 +110,14 @@ db_entry_get_size(FsearchDatabaseEntry *entry);
 const char *
 db_entry_get_extension(FsearchDatabaseEntry *entry);
 
+// Returns the id of the entry's type in the fsearch_database_file_type registry, which is set when the entry is
+// created
+uint16_t
+db_entry_get_file_type_id(FsearchDatabaseEntry *entry);
+
+void
+db_entry_set_file_type_id(FsearchDatabaseEntry *entry, uint16_t file_type_id);
+
 GString *
 db_entry_get_name_for_display(FsearchDatabaseEntry *entry);
 
@@ -139,6 +145,24 @@ db_entry_free_full(FsearchDatabaseEntry *entry);
 FsearchDatabaseEntry *
 db_entry_get_deep_copy(FsearchDatabaseEntry *entry);
 
+// Entries are stored in database files as images, i.e. as they are in memory, so loading a file only has to map it.
+// Images have the attributes `attribute_flags`, and the ones every folder has.
+// The size of the image of `entry`, which is a multiple of 8 bytes.
+size_t
+db_entry_get_image_size(FsearchDatabaseEntry *entry, FsearchDatabaseIndexPropertyFlags attribute_flags);
+
+// Copies the image of `entry` to `dest`, with its parent `parent_offset` bytes away from `dest`, or 0 if it has none
+void
+db_entry_copy_image(FsearchDatabaseEntry *entry,
+                    FsearchDatabaseIndexPropertyFlags attribute_flags,
+                    void *dest,
+                    int64_t parent_offset);
+
+// Returns the size of the image at `image`, which is aligned to 8 bytes, or 0 if it isn't valid, doesn't have the
+// attributes `attribute_flags` or doesn't fit into `max_size` bytes. The parent isn't checked.
+size_t
+db_entry_check_image(const void *image, size_t max_size, FsearchDatabaseIndexPropertyFlags attribute_flags);
+
 FsearchDatabaseEntry *
 db_entry_get_dummy_for_name_and_parent(FsearchDatabaseEntry *parent, const char *name, FsearchDatabaseEntryType type);
 
@@ -174,12 +198,21 @@ db_entry_compare_entries_by_name(FsearchDatabaseEntry **a, FsearchDatabaseEntry
 int
 db_entry_compare_entries_by_chain(FsearchDatabaseEntry **a, FsearchDatabaseEntry **b, gpointer data);
 
+// The constructors and db_entry_get_deep_copy() return NULL once the arena the entries live in is out of space
 FsearchDatabaseEntry *
 db_entry_new(FsearchDatabaseIndexPropertyFlags attribute_flags,
              const char *name,
              FsearchDatabaseEntry *parent,
              FsearchDatabaseEntryType type);
 
+// Like db_entry_new(), but with a known type instead of guessing it from `name`
+FsearchDatabaseEntry *
+db_entry_new_with_file_type_id(FsearchDatabaseIndexPropertyFlags attribute_flags,
+                               const char *name,
+                               FsearchDatabaseEntry *parent,
+                               FsearchDatabaseEntryType type,
+                               uint16_t file_type_id);
+
 FsearchDatabaseEntry *
 db_entry_new_with_attributes(FsearchDatabaseIndexPropertyFlags attribute_flags,
                              const char *name,
@@ -2,17 +2,28 @@
 
 #include "fsearch_database_file.h"
 
+#include "fsearch_arena.h"
 #include "fsearch_array.h"
 #include "fsearch_database_chunked_array.h"
 #include "fsearch_database_entry.h"
 #include "fsearch_database_exclude.h"
 #include "fsearch_database_exclude_manager.h"
+#include "fsearch_database_file_type.h"
 #include "fsearch_database_include.h"
 #include "fsearch_database_include_manager.h"
 #include "fsearch_database_index.h"
 #include "fsearch_database_index_properties.h"
 #include "fsearch_database_index_store.h"
-
+#include "fsearch_database_sort.h"
+#include "fsearch_hash.h"
+
+#include <config.h>
+#ifdef HAVE_LZ4
+#include <lz4.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
 #include <glib.h>
 #include <glib/gi18n.h>
 #include <inttypes.h>
@@ -23,74 +34,137 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #include <time.h>
 #include <unistd.h>
 
-#define DATABASE_MAJOR_VERSION 6
+// Major version 8 replaced the MD5 checksum of the header with 64-bit hashes of the header and every section, major
+// version 9 added the file type to the records of files, major version 10 replaced the records with entry images,
+// major version 11 stores every entry after its parent
+#define DATABASE_MAJOR_VERSION 11
 #define DATABASE_MINOR_VERSION 0
 #define DATABASE_MAGIC_NUMBER "FSDB"
-#define DATABASE_CHECKSUM_SIZE 16
+#define DATABASE_CHECKSUM_SEED 0
+// The file types and the sorted arrays start at file offsets which are a multiple of this, so they can be used in
+// place once the file is mapped into memory
+#define DATABASE_BLOCK_ALIGNMENT 8
+// The entry block starts at a file offset which is a multiple of this, so it can be mapped on systems with pages of
+// up to this size
+#define DATABASE_ENTRY_BLOCK_ALIGNMENT (1 << 16)
+// Compressed sections are split into frames of this (uncompressed) size, which get (de)compressed in parallel
+#define DATABASE_COMPRESSION_FRAME_SIZE (1 << 20)
+#define DATABASE_COMPRESSION_ZSTD_LEVEL 3
+// The manifest of a database which is stored as one shard per index, see fsearch_database_file_shards_load()
+#define DATABASE_MANIFEST_MAGIC_NUMBER "FSDM"
+#define DATABASE_MANIFEST_MAJOR_VERSION 1
+#define DATABASE_MANIFEST_MINOR_VERSION 0
+#define DATABASE_SHARD_SUFFIX ".shard"
 
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(FILE, fclose)
 
+// The sections which follow the header, in the order they're stored
+typedef enum {
+    DATABASE_FILE_SECTION_ENTRIES,
+    DATABASE_FILE_SECTION_FILE_TYPES,
+    DATABASE_FILE_SECTION_SORTED_ARRAYS,
+    NUM_DATABASE_FILE_SECTIONS,
+} DatabaseFileSection;
+
+static const char *database_file_section_names[NUM_DATABASE_FILE_SECTIONS] = {
+    "entry block",
+    "file types",
+    "sorted arrays",
+};
+
+// Stored in the header for every section, so each one can be verified on its own
+typedef struct {
+    // Number of bytes the section takes up in the file, including compression headers and padding
+    uint64_t size;
+    uint64_t checksum;
+} DatabaseFileSectionInfo;
+
 typedef struct {
     DynamicArray *files[NUM_DATABASE_INDEX_PROPERTIES];
     DynamicArray *folders[NUM_DATABASE_INDEX_PROPERTIES];
     FsearchDatabaseIndexPropertyFlags flags;
 } LoadSaveContext;
 
-// Entries have no permanent `index` field, so during save we borrow `parent` (via the raw,
-// bookkeeping-free db_entry_set_parent_no_update()) to stash each entry's own canonical index.
-// Safe only because the store's lock is held for the whole save, so nothing else can observe it.
-static inline uint32_t
-db_entry_get_encoded_index(FsearchDatabaseEntry *entry) {
-    return (uint32_t)(uintptr_t)db_entry_get_parent(entry);
-}
-
+// The folders or files of a snapshot, which are stored in the order of their arena ids. So the position of an entry
+// among them is the number of entries with a lower id, which can be looked up without writing to the entries. Writing
+// to them would copy the ones which are mapped from a database file.
 typedef struct {
-    DynamicArray *entries;
-    FsearchDatabaseEntry **real_parents;
-} EncodedEntryIndices;
+    uint32_t first_id;
+    uint32_t num_words;
+    uint64_t *bits;
+    // The number of entries before every word of `bits`
+    uint32_t *ranks;
+    // The position of every entry among the entries of the set in the entry block, by rank. NULL if it's the rank.
+    uint32_t *positions;
+} DatabaseFileEntrySet;
+
+static void
+database_file_entry_set_init(DatabaseFileEntrySet *set, DynamicArray *entries, uint32_t first_id, uint32_t last_id) {
+    set->first_id = first_id;
+    set->num_words = (last_id - first_id) / 64 + 1;
+    set->bits = g_new0(uint64_t, set->num_words);
+    set->ranks = g_new(uint32_t, set->num_words);
 
-static EncodedEntryIndices
-database_file_encode_indices(DynamicArray *entries) {
     const uint32_t num_entries = darray_get_num_items(entries);
-    FsearchDatabaseEntry **real_parents = g_new(FsearchDatabaseEntry *, num_entries);
     for (uint32_t i = 0; i < num_entries; i++) {
-        real_parents[i] = db_entry_get_parent(darray_get_item(entries, i));
+        const uint32_t bit = fsearch_arena_get_id(darray_get_item(entries, i)) - first_id;
+        set->bits[bit / 64] |= (uint64_t)1 << (bit % 64);
     }
-    for (uint32_t i = 0; i < num_entries; i++) {
-        db_entry_set_parent_no_update(darray_get_item(entries, i), (FsearchDatabaseEntry *)(uintptr_t)i);
+    uint32_t rank = 0;
+    for (uint32_t i = 0; i < set->num_words; i++) {
+        set->ranks[i] = rank;
+        rank += __builtin_popcountll(set->bits[i]);
     }
-    return (EncodedEntryIndices){.entries = entries, .real_parents = real_parents};
 }
 
 static void
-encoded_entry_indices_clear(EncodedEntryIndices *encoded) {
-    if (!encoded->real_parents) {
-        return; // zero-initialized, never encoded
-    }
-    const uint32_t num_entries = darray_get_num_items(encoded->entries);
-    for (uint32_t i = 0; i < num_entries; i++) {
-        db_entry_set_parent_no_update(darray_get_item(encoded->entries, i), encoded->real_parents[i]);
-    }
-    g_clear_pointer(&encoded->real_parents, g_free);
+database_file_entry_set_clear(DatabaseFileEntrySet *set) {
+    g_clear_pointer(&set->bits, g_free);
+    g_clear_pointer(&set->ranks, g_free);
+    g_clear_pointer(&set->positions, g_free);
 }
 
-G_DEFINE_AUTO_CLEANUP_CLEAR_FUNC(EncodedEntryIndices, encoded_entry_indices_clear)
+G_DEFINE_AUTO_CLEANUP_CLEAR_FUNC(DatabaseFileEntrySet, database_file_entry_set_clear)
+
+static inline bool
+database_file_entry_set_contains_bit(const DatabaseFileEntrySet *set, uint64_t bit) {
+    return (set->bits[bit / 64] & ((uint64_t)1 << (bit % 64))) != 0;
+}
 
-static uint16_t
-get_name_offset(const char *old, const char *new) {
-    if (!old || !new) {
-        return 0;
+// Returns the position of `entry` in `set` in `rank_out`, or false if it isn't part of it
+static inline bool
+database_file_entry_set_get_rank(const DatabaseFileEntrySet *set, FsearchDatabaseEntry *entry, uint32_t *rank_out) {
+    const uint32_t id = fsearch_arena_get_id(entry);
+    if (id < set->first_id || id - set->first_id >= (uint64_t)set->num_words * 64) {
+        return false;
+    }
+    const uint32_t bit = id - set->first_id;
+    if (!database_file_entry_set_contains_bit(set, bit)) {
+        return false;
     }
+    const uint64_t lower_bits = set->bits[bit / 64] & (((uint64_t)1 << (bit % 64)) - 1);
+    *rank_out = set->ranks[bit / 64] + __builtin_popcountll(lower_bits);
+    return true;
+}
 
-    uint16_t offset = 0;
-    while (offset < UINT16_MAX && old[offset] && old[offset] == new[offset]) {
-        offset++;
+// Returns the position of `entry` among the entries of `set` in the entry block in `position_out`, or false if it isn't
+// part of it
+static inline bool
+database_file_entry_set_get_position(const DatabaseFileEntrySet *set,
+                                     FsearchDatabaseEntry *entry,
+                                     uint32_t *position_out) {
+    uint32_t rank = 0;
+    if (!database_file_entry_set_get_rank(set, entry, &rank)) {
+        return false;
     }
-    return offset;
+    *position_out = set->positions ? set->positions[rank] : rank;
+    return true;
 }
 
 static FILE *
@@ -112,6 +186,8 @@ file_open_locked(const char *file_path, const char *mode) {
 }
 
 typedef struct {
+    // Start of the file or section, which is aligned to DATABASE_BLOCK_ALIGNMENT
+    const uint8_t *base;
     const uint8_t *ptr;
     const uint8_t *end;
     bool error;
@@ -119,7 +195,9 @@ typedef struct {
 
 typedef struct {
     FILE *fp;
-    GChecksum *checksum;
+    // If set, the data is appended to `buffer` instead of being written to `fp`
+    GByteArray *buffer;
+    FsearchHash *checksum;
     size_t bytes_written;
     bool error;
 } DatabaseFileWriteCursor;
@@ -129,12 +207,19 @@ cursor_write(DatabaseFileWriteCursor *cursor, const void *src, size_t size) {
     if (cursor->error) {
         return;
     }
-    if (fwrite(src, size, 1, cursor->fp) != 1) {
+    if (cursor->buffer) {
+        if (size > G_MAXUINT - cursor->buffer->len) {
+            cursor->error = true;
+            return;
+        }
+        g_byte_array_append(cursor->buffer, src, (guint)size);
+    }
+    else if (fwrite(src, size, 1, cursor->fp) != 1) {
         cursor->error = true;
         return;
     }
     if (cursor->checksum) {
-        g_checksum_update(cursor->checksum, src, (gssize)size);
+        fsearch_hash_update(cursor->checksum, src, size);
     }
     cursor->bytes_written += size;
 }
@@ -147,6 +232,36 @@ cursor_write_string(DatabaseFileWriteCursor *cursor, const char *str, uint32_t l
     }
 }
 
+static inline void
+cursor_write_padding_to(DatabaseFileWriteCursor *cursor, size_t alignment) {
+    static const uint8_t zeros[DATABASE_ENTRY_BLOCK_ALIGNMENT] = {0};
+    const size_t padding = (alignment - cursor->bytes_written % alignment) % alignment;
+    if (padding > 0) {
+        cursor_write(cursor, zeros, padding);
+    }
+}
+
+static inline void
+cursor_write_padding(DatabaseFileWriteCursor *cursor) {
+    cursor_write_padding_to(cursor, DATABASE_BLOCK_ALIGNMENT);
+}
+
+static inline void
+cursor_skip_padding_to(DatabaseFileReadCursor *cursor, size_t alignment) {
+    const size_t offset = cursor->ptr - cursor->base;
+    const size_t padding = (alignment - offset % alignment) % alignment;
+    if (cursor->error || padding > (size_t)(cursor->end - cursor->ptr)) {
+        cursor->error = true;
+        return;
+    }
+    cursor->ptr += padding;
+}
+
+static inline void
+cursor_skip_padding(DatabaseFileReadCursor *cursor) {
+    cursor_skip_padding_to(cursor, DATABASE_BLOCK_ALIGNMENT);
+}
+
 static inline void
 cursor_read(DatabaseFileReadCursor *cursor, void *dest, size_t size) {
     // If we already failed a previous read, or if this read goes out of bounds, abort.
@@ -158,76 +273,410 @@ cursor_read(DatabaseFileReadCursor *cursor, void *dest, size_t size) {
     cursor->ptr += size;
 }
 
-// region Database-File-Read
+// region Database-File-Compression
+
+// With compression enabled, the entry block, the file types and the sorted arrays are each stored as a section:
+//
+//   uint64_t size, uint32_t num_frames, uint32_t compressed_frame_sizes[num_frames], frames..., padding
+//
+// `size` is the uncompressed size of the section. All frames but the last one hold DATABASE_COMPRESSION_FRAME_SIZE
+// bytes of it. Without compression the sections are stored as they are.
+
+typedef struct {
+    FsearchDatabaseFileCompression compression;
+    const uint8_t *src;
+    size_t src_size;
+    uint8_t *dest;
+    size_t dest_capacity;
+    size_t dest_size;
+    bool error;
+} DatabaseFileFrameContext;
+
+bool
+fsearch_database_file_compression_is_supported(FsearchDatabaseFileCompression compression) {
+    switch (compression) {
+    case DATABASE_FILE_COMPRESSION_NONE:
+        return true;
+    case DATABASE_FILE_COMPRESSION_LZ4:
+#ifdef HAVE_LZ4
+        return true;
+#else
+        return false;
+#endif
+    case DATABASE_FILE_COMPRESSION_ZSTD:
+#ifdef HAVE_ZSTD
+        return true;
+#else
+        return false;
+#endif
+    default:
+        return false;
+    }
+}
+
+FsearchDatabaseFileCompression
+fsearch_database_file_get_compression_from_string(const char *str) {
+    if (!str) {
+        return DATABASE_FILE_DEFAULT_COMPRESSION;
+    }
+    for (FsearchDatabaseFileCompression c = DATABASE_FILE_COMPRESSION_NONE; c < NUM_DATABASE_FILE_COMPRESSIONS; c++) {
+        if (g_strcmp0(str, fsearch_database_file_compression_to_string(c)) == 0) {
+            return c;
+        }
+    }
+    g_warning("Invalid database compression: %s", str);
+    return DATABASE_FILE_DEFAULT_COMPRESSION;
+}
+
+const char *
+fsearch_database_file_compression_to_string(FsearchDatabaseFileCompression compression) {
+    switch (compression) {
+    case DATABASE_FILE_COMPRESSION_NONE:
+        return "none";
+    case DATABASE_FILE_COMPRESSION_LZ4:
+        return "lz4";
+    case DATABASE_FILE_COMPRESSION_ZSTD:
+        return "zstd";
+    default:
+        g_assert_not_reached();
+    }
+}
+
+static size_t
+database_file_get_compress_bound(FsearchDatabaseFileCompression compression, size_t size) {
+    switch (compression) {
+#ifdef HAVE_LZ4
+    case DATABASE_FILE_COMPRESSION_LZ4:
+        return LZ4_compressBound((int)size);
+#endif
+#ifdef HAVE_ZSTD
+    case DATABASE_FILE_COMPRESSION_ZSTD:
+        return ZSTD_compressBound(size);
+#endif
+    default:
+        return size;
+    }
+}
+
+static void
+database_file_compress_frame_thread(gpointer data, gpointer user_data) {
+    DatabaseFileFrameContext *ctx = data;
+    ctx->error = true;
+
+    switch (ctx->compression) {
+#ifdef HAVE_LZ4
+    case DATABASE_FILE_COMPRESSION_LZ4: {
+        const int res = LZ4_compress_default((const char *)ctx->src,
+                                             (char *)ctx->dest,
+                                             (int)ctx->src_size,
+                                             (int)ctx->dest_capacity);
+        if (res > 0) {
+            ctx->dest_size = res;
+            ctx->error = false;
+        }
+        break;
+    }
+#endif
+#ifdef HAVE_ZSTD
+    case DATABASE_FILE_COMPRESSION_ZSTD: {
+        const size_t res = ZSTD_compress(ctx->dest,
+                                         ctx->dest_capacity,
+                                         ctx->src,
+                                         ctx->src_size,
+                                         DATABASE_COMPRESSION_ZSTD_LEVEL);
+        if (!ZSTD_isError(res)) {
+            ctx->dest_size = res;
+            ctx->error = false;
+        }
+        break;
+    }
+#endif
+    default:
+        break;
+    }
+}
 
 static void
-database_file_load_entry(DatabaseFileReadCursor *cursor,
-                         FsearchDatabaseIndexPropertyFlags index_flags,
-                         GString *previous_entry_name,
-                         FsearchDatabaseEntry **entry_out,
-                         FsearchDatabaseEntryType type) {
-    // name_offset: character position after which previous_entry_name and entry_name differ
-    uint16_t name_offset = 0;
-    cursor_read(cursor, &name_offset, sizeof(name_offset));
-
-    // name_len: length of the new name characters
-    uint16_t name_len = 0;
-    cursor_read(cursor, &name_len, sizeof(name_len));
+database_file_decompress_frame_thread(gpointer data, gpointer user_data) {
+    DatabaseFileFrameContext *ctx = data;
+    ctx->error = true;
+
+    switch (ctx->compression) {
+#ifdef HAVE_LZ4
+    case DATABASE_FILE_COMPRESSION_LZ4: {
+        const int res = LZ4_decompress_safe((const char *)ctx->src,
+                                            (char *)ctx->dest,
+                                            (int)ctx->src_size,
+                                            (int)ctx->dest_capacity);
+        ctx->error = res < 0 || (size_t)res != ctx->dest_capacity;
+        break;
+    }
+#endif
+#ifdef HAVE_ZSTD
+    case DATABASE_FILE_COMPRESSION_ZSTD: {
+        const size_t res = ZSTD_decompress(ctx->dest, ctx->dest_capacity, ctx->src, ctx->src_size);
+        ctx->error = ZSTD_isError(res) || res != ctx->dest_capacity;
+        break;
+    }
+#endif
+    default:
+        break;
+    }
+}
 
-    if (cursor->error) {
+static bool
+database_file_run_frame_jobs(DatabaseFileFrameContext *frames, uint32_t num_frames, GFunc func) {
+    if (num_frames > 1) {
+        GThreadPool *frame_pool = g_thread_pool_new(func,
+                                                    NULL,
+                                                    (gint)MIN(num_frames, g_get_num_processors()),
+                                                    FALSE,
+                                                    NULL);
+        for (uint32_t i = 0; i < num_frames; i++) {
+            g_thread_pool_push(frame_pool, &frames[i], NULL);
+        }
+        g_thread_pool_free(g_steal_pointer(&frame_pool), FALSE, TRUE);
+    }
+    else if (num_frames == 1) {
+        func(&frames[0], NULL);
+    }
+
+    for (uint32_t i = 0; i < num_frames; i++) {
+        if (frames[i].error) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void
+database_file_write_section_data(DatabaseFileWriteCursor *file_cursor,
+                                 GByteArray *data,
+                                 FsearchDatabaseFileCompression compression) {
+    const uint64_t size = data->len;
+    if (compression == DATABASE_FILE_COMPRESSION_NONE) {
+        if (size > 0) {
+            cursor_write(file_cursor, data->data, size);
+        }
         return;
     }
 
-    // Manually add sanity check since were using g_string_append_len later instead of cursor_read
-    if (cursor->ptr + name_len > cursor->end) {
-        cursor->error = true;
+    const uint32_t num_frames = (uint32_t)((size + DATABASE_COMPRESSION_FRAME_SIZE - 1) / DATABASE_COMPRESSION_FRAME_SIZE);
+    const size_t frame_capacity = database_file_get_compress_bound(compression, DATABASE_COMPRESSION_FRAME_SIZE);
+    g_autofree uint8_t *compressed = g_malloc(MAX((size_t)num_frames * frame_capacity, 1));
+    g_autofree DatabaseFileFrameContext *frames = g_new0(DatabaseFileFrameContext, MAX(num_frames, 1));
+    for (uint32_t i = 0; i < num_frames; i++) {
+        const size_t offset = (size_t)i * DATABASE_COMPRESSION_FRAME_SIZE;
+        frames[i].compression = compression;
+        frames[i].src = data->data + offset;
+        frames[i].src_size = MIN(DATABASE_COMPRESSION_FRAME_SIZE, size - offset);
+        frames[i].dest = compressed + (size_t)i * frame_capacity;
+        frames[i].dest_capacity = frame_capacity;
+    }
+    if (!database_file_run_frame_jobs(frames, num_frames, database_file_compress_frame_thread)) {
+        g_debug("[db_save] failed to compress section");
+        file_cursor->error = true;
         return;
     }
 
-    // erase the previous name starting at name_offset
-    g_string_erase(previous_entry_name, name_offset, -1);
+    cursor_write(file_cursor, &size, sizeof(size));
+    cursor_write(file_cursor, &num_frames, sizeof(num_frames));
+    for (uint32_t i = 0; i < num_frames; i++) {
+        const uint32_t frame_size = (uint32_t)frames[i].dest_size;
+        cursor_write(file_cursor, &frame_size, sizeof(frame_size));
+    }
+    for (uint32_t i = 0; i < num_frames; i++) {
+        cursor_write(file_cursor, frames[i].dest, frames[i].dest_size);
+    }
+    cursor_write_padding(file_cursor);
+}
+
+// Writes `data` as a section of the file, compressed with `compression`, and returns its uncompressed size. The
+// size and checksum of what ends up in the file are stored in `info_out`.
+static uint64_t
+database_file_write_section(DatabaseFileWriteCursor *file_cursor,
+                            GByteArray *data,
+                            FsearchDatabaseFileCompression compression,
+                            DatabaseFileSectionInfo *info_out) {
+    FsearchHash checksum;
+    fsearch_hash_init(&checksum, DATABASE_CHECKSUM_SEED);
+    FsearchHash *prev_checksum = file_cursor->checksum;
+    file_cursor->checksum = &checksum;
+    const size_t start = file_cursor->bytes_written;
+
+    database_file_write_section_data(file_cursor, data, compression);
+
+    file_cursor->checksum = prev_checksum;
+    info_out->size = file_cursor->bytes_written - start;
+    info_out->checksum = fsearch_hash_digest(&checksum);
+    return data->len;
+}
+
+typedef struct {
+    const uint8_t *data;
+    uint64_t size;
+    uint64_t checksum;
+    bool error;
+} DatabaseFileVerifyContext;
+
+static void
+database_file_verify_section_thread(gpointer data, gpointer user_data) {
+    DatabaseFileVerifyContext *ctx = data;
+    ctx->error = fsearch_hash_compute(ctx->data, ctx->size, DATABASE_CHECKSUM_SEED) != ctx->checksum;
+}
 
-    // name: new characters to be appended to previous_entry_name
-    if (name_len > 0) {
-        g_string_append_len(previous_entry_name, (const char *)cursor->ptr, name_len);
-        cursor->ptr += name_len;
+// Checks the sections which start at `offset` of the mapped file against the checksums of the header. The sections
+// are hashed in parallel and every corrupted one gets reported.
+static bool
+database_file_verify_sections(const uint8_t *map,
+                              size_t map_size,
+                              size_t offset,
+                              const DatabaseFileSectionInfo *sections) {
+    DatabaseFileVerifyContext verify_ctx[NUM_DATABASE_FILE_SECTIONS] = {0};
+    for (uint32_t i = 0; i < NUM_DATABASE_FILE_SECTIONS; i++) {
+        if (sections[i].size > map_size - offset) {
+            g_warning("[db_load] Database %s is truncated!", database_file_section_names[i]);
+            return false;
+        }
+        verify_ctx[i].data = map + offset;
+        verify_ctx[i].size = sections[i].size;
+        verify_ctx[i].checksum = sections[i].checksum;
+        offset += sections[i].size;
+    }
+
+    GThreadPool *verify_pool = g_thread_pool_new(database_file_verify_section_thread,
+                                                 NULL,
+                                                 (gint)MIN(NUM_DATABASE_FILE_SECTIONS, g_get_num_processors()),
+                                                 FALSE,
+                                                 NULL);
+    for (uint32_t i = 0; i < NUM_DATABASE_FILE_SECTIONS; i++) {
+        g_thread_pool_push(verify_pool, &verify_ctx[i], NULL);
+    }
+    g_thread_pool_free(g_steal_pointer(&verify_pool), FALSE, TRUE);
+
+    bool res = true;
+    for (uint32_t i = 0; i < NUM_DATABASE_FILE_SECTIONS; i++) {
+        if (verify_ctx[i].error) {
+            g_warning("[db_load] Database %s corrupted! Checksum mismatch.", database_file_section_names[i]);
+            res = false;
+        }
     }
+    return res;
+}
+
+typedef struct {
+    uint8_t *data;
+    DatabaseFileReadCursor cursor;
+} DatabaseFileSectionReader;
 
-    *entry_out = db_entry_new(index_flags, previous_entry_name->str, NULL, type);
-    if ((index_flags & DATABASE_INDEX_PROPERTY_FLAG_SIZE) != 0) {
-        // size: size of file/folder
-        int64_t size = 0;
-        cursor_read(cursor, &size, sizeof(size));
+static void
+database_file_section_reader_clear(DatabaseFileSectionReader *section) {
+    g_clear_pointer(&section->data, g_free);
+}
 
-        db_entry_set_size(*entry_out, (off_t)size);
+G_DEFINE_AUTO_CLEANUP_CLEAR_FUNC(DatabaseFileSectionReader, database_file_section_reader_clear)
+
+// Returns the cursor the next section has to be read from: `file_cursor` itself if `compression` is
+// DATABASE_FILE_COMPRESSION_NONE, a cursor over the decompressed section otherwise. Returns NULL on failure.
+static DatabaseFileReadCursor *
+database_file_section_open(DatabaseFileSectionReader *section,
+                           DatabaseFileReadCursor *file_cursor,
+                           FsearchDatabaseFileCompression compression) {
+    if (compression == DATABASE_FILE_COMPRESSION_NONE) {
+        return file_cursor;
+    }
+
+    uint64_t size = 0;
+    cursor_read(file_cursor, &size, sizeof(size));
+    uint32_t num_frames = 0;
+    cursor_read(file_cursor, &num_frames, sizeof(num_frames));
+    if (file_cursor->error
+        || num_frames != (size + DATABASE_COMPRESSION_FRAME_SIZE - 1) / DATABASE_COMPRESSION_FRAME_SIZE
+        || (uint64_t)num_frames * sizeof(uint32_t) > (uint64_t)(file_cursor->end - file_cursor->ptr)) {
+        g_debug("[db_load] invalid compressed section header");
+        return NULL;
     }
+    const uint8_t *frame_sizes = file_cursor->ptr;
+    file_cursor->ptr += (size_t)num_frames * sizeof(uint32_t);
 
-    if ((index_flags & DATABASE_INDEX_PROPERTY_FLAG_MODIFICATION_TIME) != 0) {
-        // mtime: modification time file/folder
-        int64_t mtime = 0;
-        cursor_read(cursor, &mtime, sizeof(mtime));
+    section->data = g_try_malloc(MAX(size, 1));
+    if (!section->data) {
+        g_debug("[db_load] failed to allocate %" PRIu64 " bytes for section", size);
+        return NULL;
+    }
 
-        db_entry_set_mtime(*entry_out, (time_t)mtime);
+    g_autofree DatabaseFileFrameContext *frames = g_new0(DatabaseFileFrameContext, MAX(num_frames, 1));
+    for (uint32_t i = 0; i < num_frames; i++) {
+        uint32_t frame_size = 0;
+        memcpy(&frame_size, frame_sizes + (size_t)i * sizeof(uint32_t), sizeof(frame_size));
+        if (frame_size > (uint64_t)(file_cursor->end - file_cursor->ptr)) {
+            g_debug("[db_load] compressed frame exceeds the database file");
+            return NULL;
+        }
+        const uint64_t offset = (uint64_t)i * DATABASE_COMPRESSION_FRAME_SIZE;
+        frames[i].compression = compression;
+        frames[i].src = file_cursor->ptr;
+        frames[i].src_size = frame_size;
+        frames[i].dest = section->data + offset;
+        frames[i].dest_capacity = MIN(DATABASE_COMPRESSION_FRAME_SIZE, size - offset);
+        file_cursor->ptr += frame_size;
+    }
+    // The next section starts aligned again
+    cursor_skip_padding(file_cursor);
+
+    if (!database_file_run_frame_jobs(frames, num_frames, database_file_decompress_frame_thread)) {
+        g_debug("[db_load] failed to decompress section");
+        return NULL;
     }
+
+    section->cursor = (DatabaseFileReadCursor){
+        .base = section->data,
+        .ptr = section->data,
+        .end = section->data + size,
+        .error = false,
+    };
+    return &section->cursor;
 }
 
+// endregion
+
+// The entry block holds the images of all folders, followed by the ones of all files, see db_entry_copy_image(). Both
+// are stored in the order of their arena ids, except that a folder never comes before its parent. Their parents are
+// stored as the distance to them within the block, so the block can be mapped into the arena and used right away,
+// without copying or changing a single entry. Entries are only copied, a page at a time, once they're changed.
+//
+// The ids of the file types of the entries are the ones of the fsearch_database_file_type registry of the process
+// which saved the file. The file types section holds their descriptions, in the order of the ids:
+//
+//   uint32_t num_file_types, NUL-terminated descriptions of the ids 1 to num_file_types
+//
+// They're registered in that order when the file is loaded, which gives them the same ids in a fresh process.
+
+// region Database-File-Read
+
 static bool
-database_file_read_element(void *restrict ptr, size_t size, FILE *restrict stream, GChecksum *checksum) {
+database_file_read_element(void *restrict ptr, size_t size, FILE *restrict stream, FsearchHash *checksum) {
     const bool res = fread(ptr, size, 1, stream) == 1 ? true : false;
     if (res && checksum) {
-        g_checksum_update(checksum, ptr, (gssize)size);
+        fsearch_hash_update(checksum, ptr, size);
     }
     return res;
 }
 
+// Reads the header of a database file, or of a manifest, which start with `magic_number` and their versions
 static bool
-database_file_load_header(FILE *fp, GChecksum *checksum) {
+database_file_load_header(FILE *fp,
+                          FsearchHash *checksum,
+                          const char *magic_number,
+                          uint8_t major_version,
+                          uint8_t minor_version,
+                          uint8_t *minor_version_out) {
     char magic[5] = "";
-    if (!database_file_read_element(magic, strlen(DATABASE_MAGIC_NUMBER), fp, checksum)) {
+    if (!database_file_read_element(magic, strlen(magic_number), fp, checksum)) {
         return false;
     }
     magic[4] = '\0';
-    if (strcmp(magic, DATABASE_MAGIC_NUMBER) != 0) {
+    if (strcmp(magic, magic_number) != 0) {
         g_debug("[db_load] invalid magic number: %s", magic);
         return false;
     }
@@ -236,9 +685,9 @@ database_file_load_header(FILE *fp, GChecksum *checksum) {
     if (!database_file_read_element(&majorver, 1, fp, checksum)) {
         return false;
     }
-    if (majorver != DATABASE_MAJOR_VERSION) {
+    if (majorver != major_version) {
         g_debug("[db_load] invalid major version: %d", majorver);
-        g_debug("[db_load] expected major version: %d", DATABASE_MAJOR_VERSION);
+        g_debug("[db_load] expected major version: %d", major_version);
         return false;
     }
 
@@ -246,11 +695,12 @@ database_file_load_header(FILE *fp, GChecksum *checksum) {
     if (!database_file_read_element(&minorver, 1, fp, checksum)) {
         return false;
     }
-    if (minorver > DATABASE_MINOR_VERSION) {
+    if (minorver > minor_version) {
         g_debug("[db_load] invalid minor version: %d", minorver);
-        g_debug("[db_load] expected minor version: <= %d", DATABASE_MINOR_VERSION);
+        g_debug("[db_load] expected minor version: <= %d", minor_version);
         return false;
     }
+    *minor_version_out = minorver;
 
     uint8_t is_little_endian = 0;
     if (!database_file_read_element(&is_little_endian, 1, fp, checksum)) {
@@ -264,214 +714,358 @@ database_file_load_header(FILE *fp, GChecksum *checksum) {
     return true;
 }
 
-static void
-database_file_load_add_to_index_array(GHashTable *index_table, FsearchDatabaseEntry *entry) {
-    const char *root_path = db_entry_get_root_path(entry);
-    DynamicArray *index_array = g_hash_table_lookup(index_table, root_path);
+static bool
+database_file_load_compression(FILE *fp,
+                               FsearchHash *checksum,
+                               FsearchDatabaseFileCompression *compression_out) {
+    uint8_t compression = DATABASE_FILE_COMPRESSION_NONE;
+    if (!database_file_read_element(&compression, sizeof(compression), fp, checksum)) {
+        return false;
+    }
+    if (!fsearch_database_file_compression_is_supported(compression)) {
+        g_debug("[db_load] compression isn't supported by this build: %d", compression);
+        return false;
+    }
+    *compression_out = compression;
+    return true;
+}
 
-    if (!index_array) {
-        index_array = darray_new(1024);
-        g_hash_table_insert(index_table, (gpointer)root_path, index_array);
+// Adds `entries` to the array of the root folder they belong to in `index_table`. Siblings share their root, so it's
+// only looked up once per parent when `entries` are sorted by path.
+static void
+database_file_load_add_to_index_arrays(GHashTable *index_table, DynamicArray *entries) {
+    FsearchDatabaseEntry *prev_parent = NULL;
+    DynamicArray *index_array = NULL;
+    const uint32_t num_entries = darray_get_num_items(entries);
+    for (uint32_t i = 0; i < num_entries; i++) {
+        FsearchDatabaseEntry *entry = darray_get_item(entries, i);
+        FsearchDatabaseEntry *parent = db_entry_get_parent(entry);
+        if (!index_array || !parent || parent != prev_parent) {
+            const char *root_path = db_entry_get_root_path(entry);
+            index_array = g_hash_table_lookup(index_table, root_path);
+            if (!index_array) {
+                index_array = darray_new(1024);
+                g_hash_table_insert(index_table, (gpointer)root_path, index_array);
+            }
+            prev_parent = parent;
+        }
+        darray_add_item(index_array, entry);
     }
-    darray_add_item(index_array, entry);
 }
 
+// Reads the file types section and registers its types. `ids_out` maps the ids of the file to the ones of this
+// process.
 static bool
-database_file_load_folders(FILE *fp,
-                           FsearchDatabaseIndexPropertyFlags index_flags,
-                           DynamicArray *folders,
-                           uint32_t num_folders,
-                           uint64_t folder_block_size) {
-    g_autoptr(GString) previous_entry_name = g_string_sized_new(1024);
-
-    g_autofree uint8_t *folder_block = calloc(folder_block_size + 1, sizeof(uint8_t));
-    g_return_val_if_fail(folder_block, false);
-
-    if (fread(folder_block, sizeof(uint8_t), folder_block_size, fp) != folder_block_size) {
-        g_debug("[db_load] failed to read file block");
+database_file_load_file_types(DatabaseFileReadCursor *cursor, uint16_t **ids_out, uint32_t *num_file_types_out) {
+    uint32_t num_file_types = 0;
+    cursor_read(cursor, &num_file_types, sizeof(num_file_types));
+    if (cursor->error || num_file_types > FSEARCH_DATABASE_FILE_TYPE_ID_MAX) {
+        g_debug("[db_load] invalid number of file types");
         return false;
     }
 
-    // Initialize the cursor with the allocated block
-    DatabaseFileReadCursor cursor = {folder_block, folder_block + folder_block_size, false};
-    // load folders
-    uint32_t idx = 0;
-    for (idx = 0; idx < num_folders; idx++) {
-        g_autoptr(FsearchDatabaseEntry) folder = NULL;
+    g_autofree uint16_t *ids = g_new0(uint16_t, num_file_types + 1);
+    for (uint32_t id = 1; id <= num_file_types; id++) {
+        const char *description = (const char *)cursor->ptr;
+        const size_t max_len = cursor->end - cursor->ptr;
+        const size_t len = strnlen(description, max_len);
+        if (len == max_len) {
+            g_debug("[db_load] file type description isn't terminated");
+            return false;
+        }
+        ids[id] = fsearch_database_file_type_get_id_for_description(description);
+        cursor->ptr += len + 1;
+    }
+    cursor_skip_padding(cursor);
 
-        database_file_load_entry(&cursor, index_flags, previous_entry_name, &folder, DATABASE_ENTRY_TYPE_FOLDER);
-        // parent_idx: index of parent folder
-        uint32_t parent_idx = 0;
-        cursor_read(&cursor, &parent_idx, sizeof(parent_idx));
+    *ids_out = g_steal_pointer(&ids);
+    *num_file_types_out = num_file_types;
+    return true;
+}
 
-        if (cursor.error) {
-            g_debug("[db_load] out of bounds read detected at folder idx: %d", idx);
+// Checks the `block_size` bytes of entry images at `block` and adds the folders and files to `folders` and `files`,
+// in the order they're stored in. The block must hold `num_folders` folders and `num_files` files with the attributes
+// `index_flags`, whose parents are folders stored before them in the block, so following the parents always ends at a
+// root. The file type of every entry gets changed to its id in `file_type_ids`, which is only necessary if other types
+// were registered before the file was loaded.
+static bool
+database_file_load_entry_block(uint8_t *block,
+                               uint64_t block_size,
+                               FsearchDatabaseIndexPropertyFlags index_flags,
+                               uint32_t num_folders,
+                               uint32_t num_files,
+                               const uint16_t *file_type_ids,
+                               uint32_t num_file_types,
+                               DynamicArray *folders,
+                               DynamicArray *files) {
+    // The positions of the folders in units of FSEARCH_ARENA_ALIGNMENT
+    g_autofree uint64_t *is_folder = g_new0(uint64_t, block_size / FSEARCH_ARENA_ALIGNMENT / 64 + 1);
+    uint64_t pos = 0;
+    while (pos < block_size) {
+        const size_t image_size = db_entry_check_image(block + pos, block_size - pos, index_flags);
+        if (image_size == 0) {
+            g_debug("[db_load] invalid entry at offset %" PRIu64, pos);
             return false;
         }
-
-        if (parent_idx != UINT32_MAX && parent_idx >= num_folders) {
-            g_debug("[db_load] Corrupt parent index: %d", parent_idx);
+        FsearchDatabaseEntry *entry = (FsearchDatabaseEntry *)(block + pos);
+        const uint16_t file_type_id = db_entry_get_file_type_id(entry);
+        if (file_type_id > num_file_types) {
+            g_debug("[db_load] unknown file type: %d", file_type_id);
             return false;
         }
+        if (file_type_ids[file_type_id] != file_type_id) {
+            db_entry_set_file_type_id(entry, file_type_ids[file_type_id]);
+        }
 
-        if (parent_idx != idx) {
-            // Until all folders are ready, we have to reference parents by their index
-            db_entry_set_parent_no_update(folder, GUINT_TO_POINTER(parent_idx));
+        const bool folder = db_entry_is_folder(entry);
+        DynamicArray *entries = folder ? folders : files;
+        if (darray_get_num_items(entries) == (folder ? num_folders : num_files)) {
+            g_debug("[db_load] block has more entries than expected");
+            return false;
         }
-        else {
-            // parent_idx and idx are the same (i.e., folder is a root index), so it has no parent
-            db_entry_set_parent_no_update(folder, GUINT_TO_POINTER(UINT32_MAX));
+        darray_add_item(entries, entry);
+        if (folder) {
+            const uint64_t bit = pos / FSEARCH_ARENA_ALIGNMENT;
+            is_folder[bit / 64] |= (uint64_t)1 << (bit % 64);
         }
-        darray_add_item(folders, g_steal_pointer(&folder));
-    }
-
-    // fail if we didn't read the correct number of folders
-    if (idx != num_folders) {
-        g_debug("[db_load] failed to read folders (read %d of %d)", idx, num_folders);
-        return false;
+        pos += image_size;
     }
-    // Did the parsed data exactly match the declared block size?
-    if (cursor.ptr != cursor.end) {
-        g_debug("[db_load] block size mismatch! Parsed %zd bytes, expected %" PRIu64,
-                (size_t)(cursor.ptr - folder_block),
-                folder_block_size);
+    if (darray_get_num_items(folders) != num_folders || darray_get_num_items(files) != num_files) {
+        g_debug("[db_load] block has fewer entries than expected");
         return false;
     }
 
+    DynamicArray *entries[] = {folders, files};
+    for (uint32_t i = 0; i < G_N_ELEMENTS(entries); i++) {
+        const uint32_t num_entries = darray_get_num_items(entries[i]);
+        for (uint32_t j = 0; j < num_entries; j++) {
+            FsearchDatabaseEntry *entry = darray_get_item(entries[i], j);
+            FsearchDatabaseEntry *parent = db_entry_get_parent(entry);
+            if (!parent) {
+                continue;
+            }
+            const uint64_t entry_pos = (uintptr_t)entry - (uintptr_t)block;
+            const uint64_t parent_pos = (uintptr_t)parent - (uintptr_t)block;
+            const uint64_t bit = parent_pos / FSEARCH_ARENA_ALIGNMENT;
+            // Saving stores every parent before its children, a parent after the entry could be part of a cycle
+            if (parent_pos >= entry_pos || parent_pos % FSEARCH_ARENA_ALIGNMENT != 0
+                || (is_folder[bit / 64] & ((uint64_t)1 << (bit % 64))) == 0) {
+                g_debug("[db_load] corrupt parent at offset %" PRIu64, parent_pos);
+                return false;
+            }
+        }
+    }
     return true;
 }
 
-static bool
-database_file_load_files(FILE *fp,
-                         FsearchDatabaseIndexPropertyFlags index_flags,
-                         DynamicArray *folders,
-                         DynamicArray *files,
-                         uint32_t num_files,
-                         uint64_t file_block_size) {
-    g_autoptr(GString) previous_entry_name = g_string_sized_new(1024);
-    g_autofree uint8_t *file_block = calloc(file_block_size + 1, sizeof(uint8_t));
-    g_return_val_if_fail(file_block, false);
-
-    if (fread(file_block, sizeof(uint8_t), file_block_size, fp) != file_block_size) {
-        g_debug("[db_load] failed to read file block");
-        return false;
-    }
-
-    const uint32_t num_folders = darray_get_num_items(folders);
-
-    // Initialize the cursor with the allocated block
-    DatabaseFileReadCursor cursor = {file_block, file_block + file_block_size, false};
-
-    // load files
-    uint32_t idx = 0;
-    for (idx = 0; idx < num_files; idx++) {
-        g_autoptr(FsearchDatabaseEntry) entry = NULL;
-        database_file_load_entry(&cursor, index_flags, previous_entry_name, &entry, DATABASE_ENTRY_TYPE_FILE);
-
-        // parent_idx: index of parent folder
-        uint32_t parent_idx = 0;
-        cursor_read(&cursor, &parent_idx, sizeof(parent_idx));
-
-        if (cursor.error) {
-            g_debug("[db_load] out of bounds read detected at file idx: %d", idx);
-            return false;
+// Moves the entry block the file `cursor` points to into the arena. Without compression it's mapped from `fd`, so its
+// pages are only read once they're accessed, and `mapped_out` is set. Otherwise, or if mapping fails, it's copied.
+static uint8_t *
+database_file_load_entry_block_data(DatabaseFileReadCursor *cursor,
+                                    int fd,
+                                    FsearchDatabaseFileCompression compression,
+                                    uint64_t section_size,
+                                    uint32_t num_entries,
+                                    uint64_t *block_size_out,
+                                    bool *mapped_out) {
+    *mapped_out = false;
+    *block_size_out = 0;
+    const uint8_t *src = cursor->ptr;
+    uint64_t block_size = section_size;
+    g_auto(DatabaseFileSectionReader) section = {0};
+    if (compression == DATABASE_FILE_COMPRESSION_NONE) {
+        if (section_size > (uint64_t)(cursor->end - cursor->ptr)) {
+            return NULL;
         }
-
-        if (parent_idx != UINT32_MAX && parent_idx >= num_folders) {
-            g_debug("[db_load] Corrupt parent index: %d", parent_idx);
-            return false;
+        cursor->ptr += section_size;
+        if (num_entries > 0) {
+            uint8_t *block = fsearch_arena_map_file(fd, src - cursor->base, section_size, num_entries);
+            if (block) {
+                *mapped_out = true;
+                *block_size_out = block_size;
+                return block;
+            }
         }
-
-        FsearchDatabaseEntry *parent = darray_get_item(folders, parent_idx);
-        db_entry_set_parent_update_childcount(entry, parent);
-
-        darray_add_item(files, g_steal_pointer(&entry));
     }
-    // fail if we didn't read the correct number of files
-    if (idx != num_files) {
-        g_debug("[db_load] failed to read all files (read %d of %d)", idx, num_files);
-        return false;
+    else {
+        DatabaseFileReadCursor *section_cursor = database_file_section_open(&section, cursor, compression);
+        if (!section_cursor) {
+            return NULL;
+        }
+        src = section_cursor->ptr;
+        block_size = section_cursor->end - section_cursor->ptr;
     }
-
-    // Did the parsed data exactly match the declared block size?
-    if (cursor.ptr != cursor.end) {
-        g_debug("[db_load] block size mismatch! Parsed %zd bytes, expected %" PRIu64,
-                (size_t)(cursor.ptr - file_block),
-                file_block_size);
-        return false;
+    if (block_size == 0) {
+        return NULL;
     }
+    uint8_t *block = fsearch_arena_alloc(block_size);
+    if (!block) {
+        return NULL;
+    }
+    memcpy(block, src, block_size);
+    *block_size_out = block_size;
+    return block;
+}
 
-    return true;
+static void
+database_file_release_entry_block(uint8_t *block, uint64_t block_size, bool mapped) {
+    if (!block) {
+        return;
+    }
+    if (mapped) {
+        fsearch_arena_unmap(block);
+    }
+    else {
+        fsearch_arena_free(block, block_size);
+    }
 }
 
-static bool
-database_file_load_sorted_entries(FILE *fp, DynamicArray *src, uint32_t num_src_entries, DynamicArray *dest) {
-    g_autofree uint32_t *indexes = calloc(num_src_entries + 1, sizeof(uint32_t));
-    g_assert(indexes);
+typedef struct {
+    const uint32_t *indexes;
+    DynamicArray *src;
+    DynamicArray *dest;
+    bool error;
+} DatabaseFileSortedArrayContext;
 
-    if (fread(indexes, 4, num_src_entries, fp) != num_src_entries) {
-        return false;
-    }
+static void
+database_file_load_sorted_entries_thread(gpointer data, gpointer user_data) {
+    DatabaseFileSortedArrayContext *ctx = data;
+    const uint32_t num_src_entries = darray_get_num_items(ctx->src);
+    ctx->dest = darray_new(num_src_entries);
 
     for (uint32_t i = 0; i < num_src_entries; i++) {
-        uint32_t idx = indexes[i];
-        void *entry = darray_get_item(src, idx);
+        void *entry = darray_get_item(ctx->src, ctx->indexes[i]);
         if (!entry) {
-            return false;
+            ctx->error = true;
+            return;
         }
-        darray_add_item(dest, entry);
+        darray_add_item(ctx->dest, entry);
     }
+}
 
+static bool
+database_file_load_sorted_entries(DatabaseFileReadCursor *cursor,
+                                  DynamicArray *src,
+                                  DatabaseFileSortedArrayContext *ctx) {
+    const uint32_t num_src_entries = darray_get_num_items(src);
+    const uint64_t size = (uint64_t)num_src_entries * sizeof(uint32_t);
+    if (cursor->error || size > (uint64_t)(cursor->end - cursor->ptr)) {
+        return false;
+    }
+    // The sorted arrays are aligned in the file, so the indexes can be read in place
+    ctx->indexes = (const uint32_t *)cursor->ptr;
+    ctx->src = src;
+    cursor->ptr += size;
     return true;
 }
 
+// Loads the sorted arrays of `eager_sort_orders`, every array is mapped from indexes to entries by its own thread. Of
+// the other ones only the location of their indexes is stored in `deferred_folder_indexes` and `deferred_file_indexes`,
+// so they can be mapped later on, see database_file_content_decode_sorted_array().
 static bool
-database_file_load_sorted_arrays(FILE *fp,
+database_file_load_sorted_arrays(DatabaseFileReadCursor *cursor,
+                                 FsearchDatabaseIndexPropertyFlags eager_sort_orders,
                                  DynamicArray **sorted_folders,
                                  DynamicArray **sorted_files,
+                                 const uint32_t **deferred_folder_indexes,
+                                 const uint32_t **deferred_file_indexes,
                                  DynamicArray *folders,
                                  DynamicArray *files) {
     uint32_t num_sorted_arrays = 0;
-
-    if (!database_file_read_element(&num_sorted_arrays, 4, fp, NULL)) {
+    cursor_read(cursor, &num_sorted_arrays, sizeof(num_sorted_arrays));
+    if (cursor->error) {
         g_debug("[db_load] failed to load number of sorted arrays");
         return false;
     }
+    if (num_sorted_arrays >= NUM_DATABASE_INDEX_PROPERTIES) {
+        g_debug("[db_load] too many sorted arrays: %d", num_sorted_arrays);
+        return false;
+    }
 
-    for (uint32_t i = 0; i < num_sorted_arrays; i++) {
+    uint32_t sorted_array_ids[NUM_DATABASE_INDEX_PROPERTIES] = {0};
+    bool is_loaded[NUM_DATABASE_INDEX_PROPERTIES] = {false};
+    bool is_deferred[NUM_DATABASE_INDEX_PROPERTIES] = {false};
+    // Folders and files of each sorted array
+    DatabaseFileSortedArrayContext sorted_ctx[2 * NUM_DATABASE_INDEX_PROPERTIES] = {0};
+    bool res = true;
+    for (uint32_t i = 0; i < num_sorted_arrays && res; i++) {
         uint32_t sorted_array_id = 0;
-        if (!database_file_read_element(&sorted_array_id, 4, fp, NULL)) {
+        cursor_read(cursor, &sorted_array_id, sizeof(sorted_array_id));
+        if (cursor->error) {
             g_debug("[db_load] failed to load sorted array id");
-            return false;
+            res = false;
+            break;
         }
 
         if (sorted_array_id < 1 || sorted_array_id >= NUM_DATABASE_INDEX_PROPERTIES) {
             g_debug("[db_load] sorted array id is not supported: %d", sorted_array_id);
-            return false;
+            res = false;
+            break;
+        }
+        if (is_loaded[sorted_array_id]) {
+            g_debug("[db_load] sorted array id is duplicated: %d", sorted_array_id);
+            res = false;
+            break;
         }
+        is_loaded[sorted_array_id] = true;
+        sorted_array_ids[i] = sorted_array_id;
 
-        const uint32_t num_folders = darray_get_num_items(folders);
-        g_autoptr(DynamicArray) sorted_folders_array = darray_new(num_folders);
-        if (!database_file_load_sorted_entries(fp, folders, num_folders, sorted_folders_array)) {
+        if (!database_file_load_sorted_entries(cursor, folders, &sorted_ctx[2 * i])) {
             g_debug("[db_load] failed to load sorted folder indexes: %d", sorted_array_id);
-            return false;
+            res = false;
+            break;
         }
-        sorted_folders[sorted_array_id] = g_steal_pointer(&sorted_folders_array);
-
-        const uint32_t num_files = darray_get_num_items(files);
-        g_autoptr(DynamicArray) sorted_files_array = darray_new(num_files);
-        if (!database_file_load_sorted_entries(fp, files, num_files, sorted_files_array)) {
+        if (!database_file_load_sorted_entries(cursor, files, &sorted_ctx[2 * i + 1])) {
             g_debug("[db_load] failed to load sorted file indexes: %d", sorted_array_id);
-            return false;
+            res = false;
+            break;
         }
-        sorted_files[sorted_array_id] = g_steal_pointer(&sorted_files_array);
+        is_deferred[i] = !fsearch_database_index_property_is_set(eager_sort_orders, sorted_array_id);
     }
 
-    return true;
+    uint32_t num_eager_arrays = 0;
+    for (uint32_t i = 0; i < num_sorted_arrays; i++) {
+        num_eager_arrays += is_deferred[i] ? 0 : 1;
+    }
+    if (res && num_eager_arrays > 0) {
+        GThreadPool *sorted_pool = g_thread_pool_new(database_file_load_sorted_entries_thread,
+                                                     NULL,
+                                                     (gint)MIN(2 * num_eager_arrays, g_get_num_processors()),
+                                                     FALSE,
+                                                     NULL);
+        for (uint32_t i = 0; i < num_sorted_arrays; i++) {
+            if (!is_deferred[i]) {
+                g_thread_pool_push(sorted_pool, &sorted_ctx[2 * i], NULL);
+                g_thread_pool_push(sorted_pool, &sorted_ctx[2 * i + 1], NULL);
+            }
+        }
+        g_thread_pool_free(g_steal_pointer(&sorted_pool), FALSE, TRUE);
+
+        for (uint32_t i = 0; i < 2 * num_sorted_arrays; i++) {
+            res &= !sorted_ctx[i].error;
+        }
+    }
+    if (res) {
+        for (uint32_t i = 0; i < num_sorted_arrays; i++) {
+            if (is_deferred[i]) {
+                deferred_folder_indexes[sorted_array_ids[i]] = sorted_ctx[2 * i].indexes;
+                deferred_file_indexes[sorted_array_ids[i]] = sorted_ctx[2 * i + 1].indexes;
+            }
+            else {
+                sorted_folders[sorted_array_ids[i]] = g_steal_pointer(&sorted_ctx[2 * i].dest);
+                sorted_files[sorted_array_ids[i]] = g_steal_pointer(&sorted_ctx[2 * i + 1].dest);
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < G_N_ELEMENTS(sorted_ctx); i++) {
+        g_clear_pointer(&sorted_ctx[i].dest, darray_unref);
+    }
+    return res;
 }
 
 static char *
-database_file_read_string(FILE *fp, size_t max_size, GChecksum *checksum) {
+database_file_read_string(FILE *fp, size_t max_size, FsearchHash *checksum) {
     uint32_t string_len = 0;
     if (!database_file_read_element(&string_len, sizeof(string_len), fp, checksum)) {
         return NULL;
@@ -488,7 +1082,7 @@ database_file_read_string(FILE *fp, size_t max_size, GChecksum *checksum) {
 }
 
 static bool
-database_file_load_includes(FILE *fp, FsearchDatabaseIncludeManager *include_manager, GChecksum *checksum) {
+database_file_load_includes(FILE *fp, FsearchDatabaseIncludeManager *include_manager, FsearchHash *checksum) {
     uint32_t num_includes = 0;
     if (!database_file_read_element(&num_includes, sizeof(num_includes), fp, checksum)) {
         g_debug("[db_load] failed to read number of includes");
@@ -586,7 +1180,7 @@ database_file_load_includes(FILE *fp, FsearchDatabaseIncludeManager *include_man
 }
 
 static bool
-database_file_load_excludes(FILE *fp, FsearchDatabaseExcludeManager *exclude_manager, GChecksum *checksum) {
+database_file_load_excludes(FILE *fp, FsearchDatabaseExcludeManager *exclude_manager, FsearchHash *checksum) {
     uint32_t num_excludes = 0;
     if (!database_file_read_element(&num_excludes, sizeof(num_excludes), fp, checksum)) {
         g_debug("[db_load] failed to read number of excludes");
@@ -650,109 +1244,214 @@ database_file_load_excludes(FILE *fp, FsearchDatabaseExcludeManager *exclude_man
 
 // region Database-File-Write
 
-static void
-database_file_save_entry(DatabaseFileWriteCursor *cursor,
-                         FsearchDatabaseIndexPropertyFlags index_flags,
-                         FsearchDatabaseEntry *entry,
-                         uint32_t parent_idx,
-                         GString *previous_entry_name,
-                         GString *new_entry_name) {
-    // init new_entry_name with the name of the current entry
-    g_string_assign(new_entry_name, db_entry_get_name_raw(entry));
+// Positions of folders which weren't placed in the entry block yet, and of ones which wait for their parent
+#define DATABASE_FILE_POSITION_NONE UINT32_MAX
+#define DATABASE_FILE_POSITION_PENDING (UINT32_MAX - 1)
 
-    // name_offset: character position after which previous_entry_name and new_entry_name differ
-    const uint16_t name_offset = get_name_offset(previous_entry_name->str, new_entry_name->str);
-    cursor_write(cursor, &name_offset, sizeof(name_offset));
+typedef struct {
+    FsearchDatabaseEntry *folder;
+    uint32_t rank;
+} DatabaseFilePendingFolder;
+
+// Places the `num_folders` folders of `folder_set` in the entry block in the order of their arena ids, except that a
+// folder whose parent has a higher id is placed right after the parent. Sets the positions of the set and returns the
+// folders in that order, or NULL if a parent isn't part of the set.
+static FsearchDatabaseEntry **
+database_file_entry_set_place_folders(DatabaseFileEntrySet *folder_set, uint32_t num_folders) {
+    g_autofree FsearchDatabaseEntry **order = g_new(FsearchDatabaseEntry *, MAX(num_folders, 1));
+    g_autofree uint32_t *positions = g_new(uint32_t, MAX(num_folders, 1));
+    for (uint32_t i = 0; i < num_folders; i++) {
+        positions[i] = DATABASE_FILE_POSITION_NONE;
+    }
+    // The folder and those of its ancestors which weren't placed yet, they're placed from the topmost one down
+    g_autoptr(GArray) pending = g_array_new(FALSE, FALSE, sizeof(DatabaseFilePendingFolder));
+    uint32_t rank = 0;
+    uint32_t position = 0;
+    for (uint32_t i = 0; i < folder_set->num_words; i++) {
+        for (uint64_t word = folder_set->bits[i]; word != 0; word &= word - 1, rank++) {
+            if (positions[rank] != DATABASE_FILE_POSITION_NONE) {
+                continue;
+            }
+            const uint64_t bit = (uint64_t)i * 64 + __builtin_ctzll(word);
+            DatabaseFilePendingFolder folder = {fsearch_arena_get_item(folder_set->first_id + bit), rank};
+            while (true) {
+                positions[folder.rank] = DATABASE_FILE_POSITION_PENDING;
+                g_array_append_val(pending, folder);
+                FsearchDatabaseEntry *parent = db_entry_get_parent(folder.folder);
+                uint32_t parent_rank = 0;
+                if (!parent) {
+                    break;
+                }
+                if (!database_file_entry_set_get_rank(folder_set, parent, &parent_rank)
+                    || positions[parent_rank] == DATABASE_FILE_POSITION_PENDING) {
+                    g_debug("[db_save] parent isn't part of the snapshot");
+                    return NULL;
+                }
+                if (positions[parent_rank] != DATABASE_FILE_POSITION_NONE) {
+                    break;
+                }
+                folder.folder = parent;
+                folder.rank = parent_rank;
+            }
+            for (guint j = pending->len; j > 0; j--) {
+                const DatabaseFilePendingFolder *pending_folder = &g_array_index(pending,
+                                                                                 DatabaseFilePendingFolder,
+                                                                                 j - 1);
+                positions[pending_folder->rank] = position;
+                order[position++] = pending_folder->folder;
+            }
+            g_array_set_size(pending, 0);
+        }
+    }
+    folder_set->positions = g_steal_pointer(&positions);
+    return g_steal_pointer(&order);
+}
 
-    // name_len: length of the new name characters
-    const uint16_t name_len = new_entry_name->len - name_offset;
-    cursor_write(cursor, &name_len, sizeof(name_len));
+// Copies the image of `entry` to `pos` of `block` and advances `pos` past it. The parent must be one of the folders of
+// `folder_set`, which start at `folder_offsets` in the block.
+static bool
+database_file_save_entry_image(FsearchDatabaseEntry *entry,
+                               const DatabaseFileEntrySet *folder_set,
+                               const uint64_t *folder_offsets,
+                               FsearchDatabaseIndexPropertyFlags index_flags,
+                               uint8_t *block,
+                               uint64_t *pos) {
+    FsearchDatabaseEntry *parent = db_entry_get_parent(entry);
+    int64_t parent_offset = 0;
+    if (parent) {
+        uint32_t parent_position = 0;
+        if (!database_file_entry_set_get_position(folder_set, parent, &parent_position)) {
+            g_debug("[db_save] parent isn't part of the snapshot");
+            return false;
+        }
+        parent_offset = (int64_t)folder_offsets[parent_position] - (int64_t)*pos;
+    }
+    db_entry_copy_image(entry, index_flags, block + *pos, parent_offset);
+    *pos += db_entry_get_image_size(entry, index_flags);
+    return true;
+}
 
-    // append new unique characters to previous_entry_name starting at name_offset
-    g_string_erase(previous_entry_name, name_offset, -1);
-    g_string_append(previous_entry_name, new_entry_name->str + name_offset);
+// Writes the images of the entries of `folder_set` and `file_set`, which share the same range of ids, with the
+// attributes `index_flags` to the buffer of `cursor`. Sets the positions of the folders in the block, see
+// database_file_entry_set_place_folders(). Returns the highest file type id of the entries in `max_file_type_id_out`.
+static void
+database_file_save_entry_block(DatabaseFileWriteCursor *cursor,
+                               DatabaseFileEntrySet *folder_set,
+                               const DatabaseFileEntrySet *file_set,
+                               uint32_t num_folders,
+                               FsearchDatabaseIndexPropertyFlags index_flags,
+                               uint16_t *max_file_type_id_out) {
+    g_autofree FsearchDatabaseEntry **folders = database_file_entry_set_place_folders(folder_set, num_folders);
+    if (!folders) {
+        cursor->error = true;
+        return;
+    }
 
-    if (name_len > 0) {
-        // name: new characters to be written to file
-        const char *name = previous_entry_name->str + name_offset;
-        cursor_write(cursor, name, name_len);
+    // The offset of every folder in the block, by position, so the entries can refer to their parents
+    g_autofree uint64_t *folder_offsets = g_new(uint64_t, MAX(num_folders, 1));
+    uint64_t block_size = 0;
+    uint16_t max_file_type_id = FSEARCH_DATABASE_FILE_TYPE_ID_NONE;
+    for (uint32_t i = 0; i < num_folders; i++) {
+        folder_offsets[i] = block_size;
+        max_file_type_id = MAX(max_file_type_id, db_entry_get_file_type_id(folders[i]));
+        block_size += db_entry_get_image_size(folders[i], index_flags);
+    }
+    for (uint32_t i = 0; i < file_set->num_words; i++) {
+        for (uint64_t word = file_set->bits[i]; word != 0; word &= word - 1) {
+            const uint64_t bit = (uint64_t)i * 64 + __builtin_ctzll(word);
+            FsearchDatabaseEntry *entry = fsearch_arena_get_item(file_set->first_id + bit);
+            max_file_type_id = MAX(max_file_type_id, db_entry_get_file_type_id(entry));
+            block_size += db_entry_get_image_size(entry, index_flags);
+        }
     }
 
-    if ((index_flags & DATABASE_INDEX_PROPERTY_FLAG_SIZE) != 0) {
-        // size: file or folder size (folder size: sum of all children sizes)
-        const uint64_t size = db_entry_get_size(entry);
-        cursor_write(cursor, &size, sizeof(size));
+    GByteArray *buffer = cursor->buffer;
+    if (cursor->error || block_size > G_MAXUINT - buffer->len) {
+        g_debug("[db_save] entry block is too large");
+        cursor->error = true;
+        return;
     }
+    const guint start = buffer->len;
+    g_byte_array_set_size(buffer, start + (guint)block_size);
+    uint8_t *block = buffer->data + start;
 
-    if ((index_flags & DATABASE_INDEX_PROPERTY_FLAG_MODIFICATION_TIME) != 0) {
-        // mtime: modification time of file/folder
-        const uint64_t mtime = db_entry_get_mtime(entry);
-        cursor_write(cursor, &mtime, sizeof(mtime));
+    uint64_t pos = 0;
+    for (uint32_t i = 0; i < num_folders; i++) {
+        if (!database_file_save_entry_image(folders[i], folder_set, folder_offsets, index_flags, block, &pos)) {
+            cursor->error = true;
+            return;
+        }
+    }
+    for (uint32_t i = 0; i < file_set->num_words; i++) {
+        for (uint64_t word = file_set->bits[i]; word != 0; word &= word - 1) {
+            const uint64_t bit = (uint64_t)i * 64 + __builtin_ctzll(word);
+            FsearchDatabaseEntry *entry = fsearch_arena_get_item(file_set->first_id + bit);
+            if (!database_file_save_entry_image(entry, folder_set, folder_offsets, index_flags, block, &pos)) {
+                cursor->error = true;
+                return;
+            }
+        }
     }
+    cursor->bytes_written += block_size;
+    *max_file_type_id_out = max_file_type_id;
+}
 
-    // parent_idx: index of parent folder
-    cursor_write(cursor, &parent_idx, sizeof(parent_idx));
+static void
+database_file_save_file_types(DatabaseFileWriteCursor *cursor, uint16_t max_file_type_id) {
+    const uint32_t num_file_types = max_file_type_id;
+    cursor_write(cursor, &num_file_types, sizeof(num_file_types));
+    for (uint32_t id = 1; id <= num_file_types; id++) {
+        const char *description = fsearch_database_file_type_get_description(id);
+        cursor_write(cursor, description, strlen(description) + 1);
+    }
+    cursor_write_padding(cursor);
 }
 
 static void
-database_file_save_header(DatabaseFileWriteCursor *cursor) {
-    const char magic[] = DATABASE_MAGIC_NUMBER;
-    cursor_write(cursor, magic, strlen(magic));
+database_file_save_header(DatabaseFileWriteCursor *cursor,
+                          const char *magic_number,
+                          uint8_t major_version,
+                          uint8_t minor_version) {
+    cursor_write(cursor, magic_number, strlen(magic_number));
 
-    const uint8_t majorver = DATABASE_MAJOR_VERSION;
+    const uint8_t majorver = major_version;
     cursor_write(cursor, &majorver, sizeof(majorver));
 
-    const uint8_t minorver = DATABASE_MINOR_VERSION;
+    const uint8_t minorver = minor_version;
     cursor_write(cursor, &minorver, sizeof(minorver));
 
     const uint8_t is_little_endian = G_BYTE_ORDER == G_LITTLE_ENDIAN ? 1 : 0;
     cursor_write(cursor, &is_little_endian, sizeof(is_little_endian));
 }
 
-static void
-database_file_save_files(DatabaseFileWriteCursor *cursor,
-                         FsearchDatabaseIndexPropertyFlags index_flags,
-                         DynamicArray *files,
-                         uint32_t num_files,
-                         FsearchDatabaseEntry **real_parents_of_files) {
-    g_autoptr(GString) name_prev = g_string_sized_new(1024);
-    g_autoptr(GString) name_new = g_string_sized_new(1024);
-
-    for (uint32_t i = 0; i < num_files; i++) {
-        FsearchDatabaseEntry *entry = darray_get_item(files, i);
-
-        FsearchDatabaseEntry *real_parent = real_parents_of_files[i];
-        const uint32_t parent_idx = db_entry_get_encoded_index(real_parent);
-        database_file_save_entry(cursor, index_flags, entry, parent_idx, name_prev, name_new);
-        if (cursor->error) {
-            return;
-        }
-    }
-}
-
 static uint32_t *
-build_sorted_entry_index_list(DynamicArray *entries, uint32_t num_entries) {
+build_sorted_entry_index_list(DynamicArray *entries, uint32_t num_entries, const DatabaseFileEntrySet *set) {
     if (num_entries < 1) {
         return NULL;
     }
-    uint32_t *indexes = calloc(num_entries + 1, sizeof(uint32_t));
+    g_autofree uint32_t *indexes = calloc(num_entries + 1, sizeof(uint32_t));
     g_assert(indexes);
 
     for (int i = 0; i < num_entries; i++) {
         FsearchDatabaseEntry *entry = darray_get_item(entries, i);
-        indexes[i] = db_entry_get_encoded_index(entry);
+        if (!database_file_entry_set_get_position(set, entry, &indexes[i])) {
+            return NULL;
+        }
     }
-    return indexes;
+    return g_steal_pointer(&indexes);
 }
 
 static void
-database_file_save_sorted_entries(DatabaseFileWriteCursor *cursor, DynamicArray *entries, uint32_t num_entries) {
+database_file_save_sorted_entries(DatabaseFileWriteCursor *cursor,
+                                  DynamicArray *entries,
+                                  uint32_t num_entries,
+                                  const DatabaseFileEntrySet *set) {
     if (num_entries < 1) {
         // nothing to write, we're done here
         return;
     }
 
-    g_autofree uint32_t *sorted_entry_index_list = build_sorted_entry_index_list(entries, num_entries);
+    g_autofree uint32_t *sorted_entry_index_list = build_sorted_entry_index_list(entries, num_entries, set);
     if (!sorted_entry_index_list) {
         cursor->error = true;
         g_debug("[db_save] failed to create sorted index list");
@@ -762,27 +1461,60 @@ database_file_save_sorted_entries(DatabaseFileWriteCursor *cursor, DynamicArray
     cursor_write(cursor, sorted_entry_index_list, sizeof(uint32_t) * num_entries);
 }
 
+// Fetches the arrays of all fast sort indices of `store`. Properties without one are left NULL.
 static void
-database_file_save_sorted_arrays(DatabaseFileWriteCursor *cursor,
-                                 FsearchDatabaseIndexStore *store,
-                                 uint32_t num_files,
-                                 uint32_t num_folders) {
-    uint32_t num_sorted_arrays = fsearch_database_index_store_get_num_fast_sort_indices(store);
-
-    cursor_write(cursor, &num_sorted_arrays, sizeof(num_sorted_arrays));
-
-    if (num_sorted_arrays < 1 || cursor->error) {
-        return;
-    }
-
+database_file_get_sorted_arrays(FsearchDatabaseIndexStore *store,
+                                DynamicArray **sorted_folders,
+                                DynamicArray **sorted_files) {
     for (uint32_t id = DATABASE_INDEX_PROPERTY_NAME; id < NUM_DATABASE_INDEX_PROPERTIES; id++) {
         g_autoptr(FsearchDatabaseChunkedArray) folder_chunks = fsearch_database_index_store_get_folders(store, id);
         g_autoptr(FsearchDatabaseChunkedArray) file_chunks = fsearch_database_index_store_get_files(store, id);
         if (!folder_chunks || !file_chunks) {
             continue;
         }
-        g_autoptr(DynamicArray) folders = fsearch_database_chunked_array_get_joined(folder_chunks);
-        g_autoptr(DynamicArray) files = fsearch_database_chunked_array_get_joined(file_chunks);
+        sorted_folders[id] = fsearch_database_chunked_array_get_joined(folder_chunks);
+        sorted_files[id] = fsearch_database_chunked_array_get_joined(file_chunks);
+        if (!sorted_folders[id] || !sorted_files[id]) {
+            g_clear_pointer(&sorted_folders[id], darray_unref);
+            g_clear_pointer(&sorted_files[id], darray_unref);
+        }
+    }
+}
+
+static void
+database_file_clear_sorted_arrays(DynamicArray **sorted_folders, DynamicArray **sorted_files) {
+    for (uint32_t i = 0; i < NUM_DATABASE_INDEX_PROPERTIES; i++) {
+        g_clear_pointer(&sorted_folders[i], darray_unref);
+        g_clear_pointer(&sorted_files[i], darray_unref);
+    }
+}
+
+static void
+database_file_save_sorted_arrays(DatabaseFileWriteCursor *cursor,
+                                 DynamicArray **sorted_folders,
+                                 DynamicArray **sorted_files,
+                                 const DatabaseFileEntrySet *folder_set,
+                                 const DatabaseFileEntrySet *file_set,
+                                 uint32_t num_files,
+                                 uint32_t num_folders) {
+    uint32_t num_sorted_arrays = 0;
+    for (uint32_t id = DATABASE_INDEX_PROPERTY_NAME; id < NUM_DATABASE_INDEX_PROPERTIES; id++) {
+        if (sorted_folders[id] && sorted_files[id]) {
+            num_sorted_arrays++;
+        }
+    }
+
+    cursor_write(cursor, &num_sorted_arrays, sizeof(num_sorted_arrays));
+
+    if (num_sorted_arrays < 1 || cursor->error) {
+        return;
+    }
+
+    // In order of their ids, so the name index comes first: loading makes the database searchable once it and the path
+    // index are mapped, the others follow in the background
+    for (uint32_t id = DATABASE_INDEX_PROPERTY_NAME; id < NUM_DATABASE_INDEX_PROPERTIES; id++) {
+        DynamicArray *folders = sorted_folders[id];
+        DynamicArray *files = sorted_files[id];
         if (!files || !folders) {
             continue;
         }
@@ -790,12 +1522,12 @@ database_file_save_sorted_arrays(DatabaseFileWriteCursor *cursor,
         // id: this is the id of the sorted files
         cursor_write(cursor, &id, sizeof(id));
 
-        database_file_save_sorted_entries(cursor, folders, num_folders);
+        database_file_save_sorted_entries(cursor, folders, num_folders, folder_set);
         if (cursor->error) {
             g_debug("[db_save] failed to save sorted folders");
             return;
         }
-        database_file_save_sorted_entries(cursor, files, num_files);
+        database_file_save_sorted_entries(cursor, files, num_files, file_set);
         if (cursor->error) {
             g_debug("[db_save] failed to save sorted files");
             return;
@@ -804,32 +1536,7 @@ database_file_save_sorted_arrays(DatabaseFileWriteCursor *cursor,
 }
 
 static void
-database_file_save_folders(DatabaseFileWriteCursor *cursor,
-                           FsearchDatabaseIndexPropertyFlags index_flags,
-                           DynamicArray *folders,
-                           uint32_t num_folders,
-                           FsearchDatabaseEntry **real_parents_of_folders) {
-    g_autoptr(GString) name_prev = g_string_sized_new(1024);
-    g_autoptr(GString) name_new = g_string_sized_new(1024);
-
-    for (uint32_t i = 0; i < num_folders; i++) {
-        FsearchDatabaseEntry *entry = darray_get_item(folders, i);
-
-        FsearchDatabaseEntry *real_parent = real_parents_of_folders[i];
-        const uint32_t parent_idx = real_parent ? db_entry_get_encoded_index(real_parent) : i;
-        database_file_save_entry(cursor, index_flags, entry, parent_idx, name_prev, name_new);
-        if (cursor->error) {
-            return;
-        }
-    }
-
-    return;
-}
-
-static void
-database_file_save_includes(DatabaseFileWriteCursor *cursor, FsearchDatabaseIndexStore *store) {
-    g_autoptr(FsearchDatabaseIncludeManager) include_manager = fsearch_database_index_store_get_include_manager(store);
-    g_autoptr(GPtrArray) includes = fsearch_database_include_manager_get_includes(include_manager);
+database_file_save_includes(DatabaseFileWriteCursor *cursor, GPtrArray *includes) {
     const uint32_t num_includes = includes->len;
     cursor_write(cursor, &num_includes, sizeof(num_includes));
 
@@ -883,8 +1590,7 @@ database_file_save_includes(DatabaseFileWriteCursor *cursor, FsearchDatabaseInde
 }
 
 static void
-database_file_save_excludes(DatabaseFileWriteCursor *cursor, FsearchDatabaseIndexStore *store) {
-    g_autoptr(FsearchDatabaseExcludeManager) exclude_manager = fsearch_database_index_store_get_exclude_manager(store);
+database_file_save_excludes(DatabaseFileWriteCursor *cursor, FsearchDatabaseExcludeManager *exclude_manager) {
     g_autoptr(GPtrArray) excludes = fsearch_database_exclude_manager_get_excludes(exclude_manager);
     const uint32_t num_excludes = excludes->len;
     cursor_write(cursor, &num_excludes, sizeof(num_excludes));
@@ -922,10 +1628,149 @@ database_file_save_excludes(DatabaseFileWriteCursor *cursor, FsearchDatabaseInde
 
 // endregion
 
+struct FsearchDatabaseFileSnapshot {
+    uint64_t index_flags;
+    uint32_t num_folders;
+    uint32_t num_files;
+
+    // The includes and excludes, followed by the uncompressed content of the entry block, the file types and the
+    // sorted arrays. Everything is encoded already, so it doesn't reference the store's entries.
+    GByteArray *config;
+    GByteArray *entry_block;
+    GByteArray *file_types;
+    GByteArray *sorted_arrays;
+};
+
+// Returns the lowest and highest arena id of the entries of `folders` and `files`
+static void
+database_file_get_id_range(DynamicArray *folders, DynamicArray *files, uint32_t *first_id_out, uint32_t *last_id_out) {
+    uint32_t first_id = UINT32_MAX;
+    uint32_t last_id = 0;
+    DynamicArray *entries[] = {folders, files};
+    for (uint32_t i = 0; i < G_N_ELEMENTS(entries); i++) {
+        const uint32_t num_entries = darray_get_num_items(entries[i]);
+        for (uint32_t j = 0; j < num_entries; j++) {
+            const uint32_t id = fsearch_arena_get_id(darray_get_item(entries[i], j));
+            first_id = MIN(first_id, id);
+            last_id = MAX(last_id, id);
+        }
+    }
+    *first_id_out = MIN(first_id, last_id);
+    *last_id_out = last_id;
+}
+
+// Takes a snapshot of the folders and files in `sorted_folders` and `sorted_files`, which hold the entries sorted by
+// each property with a fast sort index and NULL for the others. The entries must not change meanwhile.
+static FsearchDatabaseFileSnapshot *
+database_file_snapshot_new_from_arrays(GPtrArray *includes,
+                                       FsearchDatabaseExcludeManager *exclude_manager,
+                                       FsearchDatabaseIndexPropertyFlags index_flags,
+                                       DynamicArray **sorted_folders,
+                                       DynamicArray **sorted_files) {
+    DynamicArray *folders = sorted_folders[DATABASE_INDEX_PROPERTY_NAME];
+    DynamicArray *files = sorted_files[DATABASE_INDEX_PROPERTY_NAME];
+    if (!folders || !files) {
+        g_debug("[db_save] failed taking snapshot. DB has no folders.");
+        return NULL;
+    }
+
+    g_autoptr(FsearchDatabaseFileSnapshot) snapshot = g_new0(FsearchDatabaseFileSnapshot, 1);
+    snapshot->index_flags = index_flags;
+    snapshot->num_folders = darray_get_num_items(folders);
+    snapshot->num_files = darray_get_num_items(files);
+
+    DatabaseFileWriteCursor config_cursor = {.buffer = g_byte_array_new()};
+    database_file_save_includes(&config_cursor, includes);
+    database_file_save_excludes(&config_cursor, exclude_manager);
+    snapshot->config = config_cursor.buffer;
+
+    uint32_t first_id = 0;
+    uint32_t last_id = 0;
+    database_file_get_id_range(folders, files, &first_id, &last_id);
+    g_auto(DatabaseFileEntrySet) folder_set = {0};
+    g_auto(DatabaseFileEntrySet) file_set = {0};
+    database_file_entry_set_init(&folder_set, folders, first_id, last_id);
+    database_file_entry_set_init(&file_set, files, first_id, last_id);
+
+    DatabaseFileWriteCursor entry_cursor = {.buffer = g_byte_array_new()};
+    uint16_t max_file_type_id = FSEARCH_DATABASE_FILE_TYPE_ID_NONE;
+    database_file_save_entry_block(&entry_cursor,
+                                   &folder_set,
+                                   &file_set,
+                                   snapshot->num_folders,
+                                   snapshot->index_flags,
+                                   &max_file_type_id);
+    snapshot->entry_block = entry_cursor.buffer;
+
+    DatabaseFileWriteCursor file_types_cursor = {.buffer = g_byte_array_new()};
+    database_file_save_file_types(&file_types_cursor, max_file_type_id);
+    snapshot->file_types = file_types_cursor.buffer;
+
+    DatabaseFileWriteCursor sorted_cursor = {.buffer = g_byte_array_new()};
+    database_file_save_sorted_arrays(&sorted_cursor,
+                                     sorted_folders,
+                                     sorted_files,
+                                     &folder_set,
+                                     &file_set,
+                                     snapshot->num_files,
+                                     snapshot->num_folders);
+    snapshot->sorted_arrays = sorted_cursor.buffer;
+
+    if (config_cursor.error || entry_cursor.error || file_types_cursor.error || sorted_cursor.error) {
+        g_debug("[db_save] failed taking snapshot of entries/file types/sorted arrays");
+        return NULL;
+    }
+
+    return g_steal_pointer(&snapshot);
+}
+
+FsearchDatabaseFileSnapshot *
+fsearch_database_file_snapshot_new(FsearchDatabaseIndexStore *store) {
+    g_return_val_if_fail(store, NULL);
+
+    g_autoptr(GTimer) timer = g_timer_new();
+
+    g_autoptr(FsearchDatabaseIncludeManager) include_manager = fsearch_database_index_store_get_include_manager(store);
+    g_autoptr(GPtrArray) includes = fsearch_database_include_manager_get_includes(include_manager);
+    g_autoptr(FsearchDatabaseExcludeManager) exclude_manager = fsearch_database_index_store_get_exclude_manager(store);
+
+    DynamicArray *sorted_folders[NUM_DATABASE_INDEX_PROPERTIES] = {NULL};
+    DynamicArray *sorted_files[NUM_DATABASE_INDEX_PROPERTIES] = {NULL};
+    database_file_get_sorted_arrays(store, sorted_folders, sorted_files);
+
+    FsearchDatabaseFileSnapshot *snapshot = database_file_snapshot_new_from_arrays(
+        includes,
+        exclude_manager,
+        fsearch_database_index_store_get_flags(store),
+        sorted_folders,
+        sorted_files);
+    database_file_clear_sorted_arrays(sorted_folders, sorted_files);
+
+    if (snapshot) {
+        g_debug("[db_save] snapshot taken in %f ms", g_timer_elapsed(timer, NULL) * 1000);
+    }
+
+    return snapshot;
+}
+
+void
+fsearch_database_file_snapshot_free(FsearchDatabaseFileSnapshot *snapshot) {
+    g_return_if_fail(snapshot);
+
+    g_clear_pointer(&snapshot->config, g_byte_array_unref);
+    g_clear_pointer(&snapshot->entry_block, g_byte_array_unref);
+    g_clear_pointer(&snapshot->file_types, g_byte_array_unref);
+    g_clear_pointer(&snapshot->sorted_arrays, g_byte_array_unref);
+    g_clear_pointer(&snapshot, g_free);
+}
+
 bool
-fsearch_database_file_save(FsearchDatabaseIndexStore *store, const char *file_path) {
+fsearch_database_file_snapshot_save(FsearchDatabaseFileSnapshot *snapshot,
+                                    const char *file_path,
+                                    FsearchDatabaseFileCompression compression) {
     g_return_val_if_fail(file_path, false);
-    g_return_val_if_fail(store, false);
+    g_return_val_if_fail(snapshot, false);
+    g_return_val_if_fail(fsearch_database_file_compression_is_supported(compression), false);
 
     g_debug("[db_save] saving database to file...");
 
@@ -934,21 +1779,13 @@ fsearch_database_file_save(FsearchDatabaseIndexStore *store, const char *file_pa
     g_autoptr(GString) file_tmp_path = g_string_new(file_path);
     g_string_append(file_tmp_path, ".tmp");
 
-    g_autoptr(FsearchDatabaseChunkedArray) folder_chunks = NULL;
-    g_autoptr(FsearchDatabaseChunkedArray) file_chunks = NULL;
-
-    g_autoptr(DynamicArray) files = NULL;
-    g_autoptr(DynamicArray) folders = NULL;
-
-    g_auto(EncodedEntryIndices) encoded_folders = {0};
-    g_auto(EncodedEntryIndices) encoded_files = {0};
-
     g_debug("[db_save] trying to open temporary database file: %s", file_tmp_path->str);
 
     g_autoptr(FILE) fp = file_open_locked(file_tmp_path->str, "wb");
 
-    g_autoptr(GChecksum) checksum = g_checksum_new(G_CHECKSUM_MD5);
-    DatabaseFileWriteCursor cursor = {.fp = fp, .error = false, .bytes_written = 0, .checksum = checksum};
+    FsearchHash checksum;
+    fsearch_hash_init(&checksum, DATABASE_CHECKSUM_SEED);
+    DatabaseFileWriteCursor cursor = {.fp = fp, .error = false, .bytes_written = 0, .checksum = &checksum};
 
     if (!fp) {
         g_debug("[db_save] failed to open temporary database file: %s", file_tmp_path->str);
@@ -956,15 +1793,14 @@ fsearch_database_file_save(FsearchDatabaseIndexStore *store, const char *file_pa
     }
 
     g_debug("[db_save] saving database header...");
-    database_file_save_header(&cursor);
+    database_file_save_header(&cursor, DATABASE_MAGIC_NUMBER, DATABASE_MAJOR_VERSION, DATABASE_MINOR_VERSION);
     if (cursor.error == true) {
         g_debug("[db_save] failed saving header");
         goto save_fail;
     }
 
     g_debug("[db_save] saving database index flags...");
-    const uint64_t index_flags = fsearch_database_index_store_get_flags(store);
-    cursor_write(&cursor, &index_flags, sizeof(index_flags));
+    cursor_write(&cursor, &snapshot->index_flags, sizeof(snapshot->index_flags));
     if (cursor.error == true) {
         g_debug("[db_save] failed saving index flags");
         goto save_fail;
@@ -980,117 +1816,84 @@ fsearch_database_file_save(FsearchDatabaseIndexStore *store, const char *file_pa
         goto save_fail;
     }
 
-    g_debug("[db_save] saving indices...");
-    database_file_save_includes(&cursor, store);
-    if (cursor.error == true) {
-        goto save_fail;
-    }
-    g_debug("[db_save] saving excludes...");
-    database_file_save_excludes(&cursor, store);
+    const uint8_t compression_id = compression;
+    cursor_write(&cursor, &compression_id, sizeof(compression_id));
     if (cursor.error == true) {
+        g_debug("[db_save] failed saving compression");
         goto save_fail;
     }
 
-    folder_chunks = fsearch_database_index_store_get_folders(store, DATABASE_INDEX_PROPERTY_NAME);
-    folders = fsearch_database_chunked_array_get_joined(folder_chunks);
-    if (!folders) {
-        g_debug("[db_save] failed saving. DB has no folders.");
+    g_debug("[db_save] saving indices and excludes...");
+    cursor_write(&cursor, snapshot->config->data, snapshot->config->len);
+    if (cursor.error == true) {
         goto save_fail;
     }
 
-    const uint32_t num_folders = darray_get_num_items(folders);
+    const uint32_t num_folders = snapshot->num_folders;
     cursor_write(&cursor, &num_folders, sizeof(num_folders));
     if (cursor.error == true) {
         g_debug("[db_save] failed saving number of folders: %d", num_folders);
         goto save_fail;
     }
 
-    file_chunks = fsearch_database_index_store_get_files(store, DATABASE_INDEX_PROPERTY_NAME);
-    files = fsearch_database_chunked_array_get_joined(file_chunks);
-
-    const uint32_t num_files = darray_get_num_items(files);
+    const uint32_t num_files = snapshot->num_files;
     cursor_write(&cursor, &num_files, sizeof(num_files));
     if (cursor.error == true) {
         g_debug("[db_save] failed saving number of files: %d", num_files);
         goto save_fail;
     }
 
-    // Set checksum to NULL. For performance reasons we don't want to compute the checksum of the larger arrays.
-    // It also must be set to NULL before writing placeholder data for folder and file block sizes and checksum itself
+    // Set checksum to NULL before writing placeholder data for the section infos and the checksum itself. The sections
+    // get their own checksums.
     cursor.checksum = NULL;
 
-    uint64_t folder_block_size = 0;
-    const uint64_t folder_block_size_offset = cursor.bytes_written;
-    g_debug("[db_save] saving folder block size...");
-    cursor_write(&cursor, &folder_block_size, sizeof(folder_block_size));
-    if (cursor.error == true) {
-        g_debug("[db_save] failed saving folder block size");
-        goto save_fail;
-    }
-
-    uint64_t file_block_size = 0;
-    // const uint64_t file_block_size_offset = cursor.bytes_written;
-    g_debug("[db_save] saving file block size...");
-    cursor_write(&cursor, &file_block_size, sizeof(file_block_size));
-    if (cursor.error == true) {
-        g_debug("[db_save] failed saving file block size");
-        goto save_fail;
-    }
-
-    // Store placeholder for checksum
-    const uint64_t checksum_offset = cursor.bytes_written;
-    uint8_t checksum_placeholder[DATABASE_CHECKSUM_SIZE] = {};
-    cursor_write(&cursor, checksum_placeholder, sizeof(checksum_placeholder));
-
-    // From here on, every folder's/file's `parent` is repurposed as its canonical index (safe
-    // because database_save() holds the store's lock for this whole call); g_auto restores it
-    // regardless of how this function returns.
-    encoded_folders = database_file_encode_indices(folders);
-    encoded_files = database_file_encode_indices(files);
+    // Store placeholders for the section infos and the checksum
+    const uint64_t sections_offset = cursor.bytes_written;
+    DatabaseFileSectionInfo sections[NUM_DATABASE_FILE_SECTIONS] = {};
+    cursor_write(&cursor, sections, sizeof(sections));
+    uint64_t checksum_value = 0;
+    cursor_write(&cursor, &checksum_value, sizeof(checksum_value));
+    // The entry block starts at a page boundary, so it can be mapped by the loader
+    cursor_write_padding_to(&cursor, DATABASE_ENTRY_BLOCK_ALIGNMENT);
 
-    g_debug("[db_save] saving folders...");
-    uint64_t current_cursor_size = cursor.bytes_written;
-    database_file_save_folders(&cursor, index_flags, folders, num_folders, encoded_folders.real_parents);
-    folder_block_size = cursor.bytes_written - current_cursor_size;
+    g_debug("[db_save] saving entries...");
+    database_file_write_section(&cursor, snapshot->entry_block, compression, &sections[DATABASE_FILE_SECTION_ENTRIES]);
 
     if (!cursor.error) {
-        g_debug("[db_save] saving files...");
-        current_cursor_size = cursor.bytes_written;
-        database_file_save_files(&cursor, index_flags, files, num_files, encoded_files.real_parents);
-        file_block_size = cursor.bytes_written - current_cursor_size;
+        g_debug("[db_save] saving file types...");
+        database_file_write_section(&cursor,
+                                    snapshot->file_types,
+                                    compression,
+                                    &sections[DATABASE_FILE_SECTION_FILE_TYPES]);
     }
 
     if (!cursor.error) {
         g_debug("[db_save] saving sorted arrays...");
-        database_file_save_sorted_arrays(&cursor, store, num_files, num_folders);
+        database_file_write_section(&cursor,
+                                    snapshot->sorted_arrays,
+                                    compression,
+                                    &sections[DATABASE_FILE_SECTION_SORTED_ARRAYS]);
     }
 
     if (cursor.error) {
-        g_debug("[db_save] failed saving folders/files/sorted arrays");
+        g_debug("[db_save] failed saving entries/file types/sorted arrays");
         goto save_fail;
     }
 
-    // now that we know the size of the file/folder block we've written, store it in the file header
-    // Make also sure to set the cursor checksum again, so folder and file block size are hashed as well
-    cursor.checksum = checksum;
-    if (fseeko(fp, (off64_t)folder_block_size_offset, SEEK_SET) != 0) {
+    // now that we know the section infos, store them in the file header
+    // Make also sure to set the cursor checksum again, so they're hashed as well
+    cursor.checksum = &checksum;
+    if (fseeko(fp, (off64_t)sections_offset, SEEK_SET) != 0) {
         goto save_fail;
     }
-    g_debug("[db_save] updating file and folder block size: %" PRIu64 ", %" PRIu64, folder_block_size, file_block_size);
-    cursor_write(&cursor, &folder_block_size, sizeof(folder_block_size));
-    cursor_write(&cursor, &file_block_size, sizeof(file_block_size));
+    cursor_write(&cursor, sections, sizeof(sections));
 
-    // after writing the folder and file block size, we can
-    if (fseeko(fp, (off64_t)checksum_offset, SEEK_SET) != 0) {
-        goto save_fail;
-    }
-    gsize checksum_buffer_len = DATABASE_CHECKSUM_SIZE;
-    uint8_t checksum_bytes[DATABASE_CHECKSUM_SIZE] = {};
-    g_checksum_get_digest(checksum, checksum_bytes, &checksum_buffer_len);
+    // after writing everything up to the checksum, we can compute it. It directly follows the section infos.
+    checksum_value = fsearch_hash_digest(&checksum);
 
     // Before writing checksum, unset it again.
     cursor.checksum = NULL;
-    cursor_write(&cursor, checksum_bytes, sizeof(checksum_bytes));
+    cursor_write(&cursor, &checksum_value, sizeof(checksum_value));
 
     if (cursor.error == true) {
         goto save_fail;
@@ -1124,6 +1927,26 @@ save_fail:
     return false;
 }
 
+bool
+fsearch_database_file_save(FsearchDatabaseIndexStore *store, const char *file_path) {
+    return fsearch_database_file_save_with_compression(store, file_path, DATABASE_FILE_DEFAULT_COMPRESSION);
+}
+
+bool
+fsearch_database_file_save_with_compression(FsearchDatabaseIndexStore *store,
+                                            const char *file_path,
+                                            FsearchDatabaseFileCompression compression) {
+    g_return_val_if_fail(file_path, false);
+    g_return_val_if_fail(store, false);
+
+    g_autoptr(FsearchDatabaseFileSnapshot) snapshot = fsearch_database_file_snapshot_new(store);
+    if (!snapshot) {
+        g_warning("[db_save] saving failed");
+        return false;
+    }
+    return fsearch_database_file_snapshot_save(snapshot, file_path, compression);
+}
+
 bool
 fsearch_database_file_load_config(const char *file_path,
                                   FsearchDatabaseIncludeManager **include_manager_out,
@@ -1139,71 +1962,74 @@ fsearch_database_file_load_config(const char *file_path,
     g_autoptr(FsearchDatabaseIncludeManager) include_manager = fsearch_database_include_manager_new();
     g_autoptr(FsearchDatabaseExcludeManager) exclude_manager = fsearch_database_exclude_manager_new();
 
-    g_autoptr(GChecksum) checksum = g_checksum_new(G_CHECKSUM_MD5);
+    FsearchHash checksum;
+    fsearch_hash_init(&checksum, DATABASE_CHECKSUM_SEED);
 
-    if (!database_file_load_header(fp, checksum)) {
+    uint8_t minor_version = 0;
+    if (!database_file_load_header(fp,
+                                   &checksum,
+                                   DATABASE_MAGIC_NUMBER,
+                                   DATABASE_MAJOR_VERSION,
+                                   DATABASE_MINOR_VERSION,
+                                   &minor_version)) {
         goto load_fail;
     }
 
     uint64_t index_flags = 0;
-    if (!database_file_read_element(&index_flags, sizeof(index_flags), fp, checksum)) {
+    if (!database_file_read_element(&index_flags, sizeof(index_flags), fp, &checksum)) {
         g_debug("[db_load] failed to read index flags");
         goto load_fail;
     }
 
     uint64_t fast_sort_flags = 0;
-    if (!database_file_read_element(&fast_sort_flags, sizeof(fast_sort_flags), fp, checksum)) {
+    if (!database_file_read_element(&fast_sort_flags, sizeof(fast_sort_flags), fp, &checksum)) {
         g_debug("[db_load] failed to read fast sort flags");
         goto load_fail;
     }
 
-    if (!database_file_load_includes(fp, include_manager, checksum)) {
+    FsearchDatabaseFileCompression compression = DATABASE_FILE_COMPRESSION_NONE;
+    if (!database_file_load_compression(fp, &checksum, &compression)) {
+        g_debug("[db_load] failed to read compression");
+        goto load_fail;
+    }
+
+    if (!database_file_load_includes(fp, include_manager, &checksum)) {
         g_debug("[db_load] failed to load includes");
         goto load_fail;
     }
-    if (!database_file_load_excludes(fp, exclude_manager, checksum)) {
+    if (!database_file_load_excludes(fp, exclude_manager, &checksum)) {
         g_debug("[db_load] excludes not loaded");
         goto load_fail;
     }
 
     uint32_t num_folders = 0;
-    if (!database_file_read_element(&num_folders, sizeof(num_folders), fp, checksum)) {
+    if (!database_file_read_element(&num_folders, sizeof(num_folders), fp, &checksum)) {
         g_debug("[db_load] failed to read num_folders");
         goto load_fail;
     }
 
     uint32_t num_files = 0;
-    if (!database_file_read_element(&num_files, sizeof(num_files), fp, checksum)) {
+    if (!database_file_read_element(&num_files, sizeof(num_files), fp, &checksum)) {
         g_debug("[db_load] failed to read num_files");
         goto load_fail;
     }
     g_debug("[db_load] load %d folders, %d files", num_folders, num_files);
 
-    uint64_t folder_block_size = 0;
-    if (!database_file_read_element(&folder_block_size, sizeof(folder_block_size), fp, checksum)) {
-        g_debug("[db_load] failed to read folder block size");
-        goto load_fail;
-    }
-
-    uint64_t file_block_size = 0;
-    if (!database_file_read_element(&file_block_size, sizeof(file_block_size), fp, checksum)) {
-        g_debug("[db_load] loading file block size: %" PRIu64, file_block_size);
+    DatabaseFileSectionInfo sections[NUM_DATABASE_FILE_SECTIONS] = {};
+    if (!database_file_read_element(sections, sizeof(sections), fp, &checksum)) {
+        g_debug("[db_load] failed to read section infos");
         goto load_fail;
     }
-    g_debug("[db_load] folder size: %" PRIu64 ", file size: %" PRIu64, folder_block_size, file_block_size);
 
-    gsize checksum_computed_len = DATABASE_CHECKSUM_SIZE;
-    uint8_t checksum_computed[DATABASE_CHECKSUM_SIZE] = {};
-    g_checksum_get_digest(checksum, checksum_computed, &checksum_computed_len);
-
-    uint8_t checksum_stored[DATABASE_CHECKSUM_SIZE] = {};
-    if (!database_file_read_element(checksum_stored, sizeof(checksum_stored), fp, NULL)) {
+    const uint64_t checksum_computed = fsearch_hash_digest(&checksum);
+    uint64_t checksum_stored = 0;
+    if (!database_file_read_element(&checksum_stored, sizeof(checksum_stored), fp, NULL)) {
         g_debug("[db_load] loading checksum failed");
         goto load_fail;
     }
 
-    if (memcmp(checksum_stored, checksum_computed, DATABASE_CHECKSUM_SIZE) != 0) {
-        g_warning("[db_load] Database Metadata Corrupted! MD5 Checksum mismatch.");
+    if (checksum_stored != checksum_computed) {
+        g_warning("[db_load] Database Metadata Corrupted! Checksum mismatch.");
         goto load_fail;
     }
 
@@ -1221,207 +2047,1564 @@ load_fail:
     return false;
 }
 
-bool
-fsearch_database_file_load(const char *file_path,
+typedef struct {
+    // The sorted arrays of all shards for `property`, borrowed
+    GPtrArray *arrays;
+    FsearchDatabaseIndexProperty property;
+    DynamicArray *result;
+} DatabaseFileMergeContext;
+
+static DynamicArray *
+database_file_merge_two_sorted_arrays(DynamicArray *a, DynamicArray *b, FsearchDatabaseEntryCompareContext *ctx) {
+    const uint32_t num_a = darray_get_num_items(a);
+    const uint32_t num_b = darray_get_num_items(b);
+    DynamicArray *merged = darray_new(num_a + num_b);
+
+    uint32_t i = 0;
+    uint32_t j = 0;
+    while (i < num_a && j < num_b) {
+        FsearchDatabaseEntry *entry_a = darray_get_item(a, i);
+        FsearchDatabaseEntry *entry_b = darray_get_item(b, j);
+        if (db_entry_compare_entries_by_chain(&entry_b, &entry_a, ctx) < 0) {
+            darray_add_item(merged, entry_b);
+            j++;
+        }
+        else {
+            darray_add_item(merged, entry_a);
+            i++;
+        }
+    }
+    for (; i < num_a; i++) {
+        darray_add_item(merged, darray_get_item(a, i));
+    }
+    for (; j < num_b; j++) {
+        darray_add_item(merged, darray_get_item(b, j));
+    }
+    return merged;
+}
+
+// Merges the sorted arrays of all shards pairwise, until only one is left
+static void
+database_file_merge_sorted_arrays_thread(gpointer data, gpointer user_data) {
+    DatabaseFileMergeContext *ctx = data;
+    g_autoptr(FsearchDatabaseEntryCompareContext) compare_context = db_entry_compare_context_new(
+        fsearch_database_sort_order_chain_for_property(ctx->property));
+
+    g_autoptr(GPtrArray) runs = g_ptr_array_new_with_free_func((GDestroyNotify)darray_unref);
+    for (uint32_t i = 0; i < ctx->arrays->len; i++) {
+        g_ptr_array_add(runs, darray_ref(g_ptr_array_index(ctx->arrays, i)));
+    }
+    while (runs->len > 1) {
+        g_autoptr(GPtrArray) merged = g_ptr_array_new_with_free_func((GDestroyNotify)darray_unref);
+        for (uint32_t i = 0; i < runs->len; i += 2) {
+            if (i + 1 < runs->len) {
+                g_ptr_array_add(merged,
+                                database_file_merge_two_sorted_arrays(g_ptr_array_index(runs, i),
+                                                                      g_ptr_array_index(runs, i + 1),
+                                                                      compare_context));
+            }
+            else {
+                g_ptr_array_add(merged, darray_ref(g_ptr_array_index(runs, i)));
+            }
+        }
+        g_clear_pointer(&runs, g_ptr_array_unref);
+        runs = g_steal_pointer(&merged);
+    }
+    ctx->result = runs->len > 0 ? darray_ref(g_ptr_array_index(runs, 0)) : darray_new(0);
+}
+
+// The sort orders which are loaded before the database becomes usable: searches need the name index and the indices of
+// the includes are built from the path index
+#define DATABASE_FILE_EAGER_SORT_ORDERS (DATABASE_INDEX_PROPERTY_FLAG_NAME | DATABASE_INDEX_PROPERTY_FLAG_PATH)
+
+// Everything which is stored in a database file
+typedef struct {
+    FsearchDatabaseIncludeManager *include_manager;
+    FsearchDatabaseExcludeManager *exclude_manager;
+    FsearchDatabaseIndexPropertyFlags index_flags;
+    // All folders and files in the order they're stored in. They own the entries, until
+    // database_file_content_release_entries() hands them over to the indices.
+    DynamicArray *folders;
+    DynamicArray *files;
+    DynamicArray *sorted_folders[NUM_DATABASE_INDEX_PROPERTIES];
+    DynamicArray *sorted_files[NUM_DATABASE_INDEX_PROPERTIES];
+    // The indexes of the sorted arrays which weren't mapped to entries yet. They point into `mapped_file`, or into
+    // `sorted_arrays_data` if the file is compressed.
+    const uint32_t *deferred_folder_indexes[NUM_DATABASE_INDEX_PROPERTIES];
+    const uint32_t *deferred_file_indexes[NUM_DATABASE_INDEX_PROPERTIES];
+    GMappedFile *mapped_file;
+    uint8_t *sorted_arrays_data;
+} DatabaseFileContent;
+
+static void
+database_file_content_clear_deferred(DatabaseFileContent *content) {
+    memset(content->deferred_folder_indexes, 0, sizeof(content->deferred_folder_indexes));
+    memset(content->deferred_file_indexes, 0, sizeof(content->deferred_file_indexes));
+    g_clear_pointer(&content->mapped_file, g_mapped_file_unref);
+    g_clear_pointer(&content->sorted_arrays_data, g_free);
+}
+
+static void
+database_file_content_clear(DatabaseFileContent *content) {
+    database_file_content_clear_deferred(content);
+    database_file_clear_sorted_arrays(content->sorted_folders, content->sorted_files);
+    g_clear_pointer(&content->files, darray_unref);
+    g_clear_pointer(&content->folders, darray_unref);
+    g_clear_object(&content->include_manager);
+    g_clear_object(&content->exclude_manager);
+}
+
+G_DEFINE_AUTO_CLEANUP_CLEAR_FUNC(DatabaseFileContent, database_file_content_clear)
+
+static void
+database_file_content_free(DatabaseFileContent *content) {
+    database_file_content_clear(content);
+    g_clear_pointer(&content, g_free);
+}
+
+// Moves `content` to the heap, so it can outlive the loading function
+static DatabaseFileContent *
+database_file_content_steal(DatabaseFileContent *content) {
+    DatabaseFileContent *stolen = g_new0(DatabaseFileContent, 1);
+    *stolen = *content;
+    memset(content, 0, sizeof(*content));
+    return stolen;
+}
+
+static void
+database_file_content_release_entries(DatabaseFileContent *content) {
+    darray_set_free_func(content->folders, NULL);
+    darray_set_free_func(content->files, NULL);
+}
+
+// Maps the deferred indexes of `sort_order` to the entries. The entries are only read from `folders` and `files`, so
+// this also works after database_file_content_release_entries(), as long as the entries are still alive.
+static bool
+database_file_content_decode_sorted_array(DatabaseFileContent *content, FsearchDatabaseIndexProperty sort_order) {
+    if (content->sorted_folders[sort_order] && content->sorted_files[sort_order]) {
+        return true;
+    }
+    if (!content->deferred_folder_indexes[sort_order] || !content->deferred_file_indexes[sort_order]) {
+        return false;
+    }
+    DatabaseFileSortedArrayContext folder_ctx = {
+        .indexes = g_steal_pointer(&content->deferred_folder_indexes[sort_order]),
+        .src = content->folders,
+    };
+    DatabaseFileSortedArrayContext file_ctx = {
+        .indexes = g_steal_pointer(&content->deferred_file_indexes[sort_order]),
+        .src = content->files,
+    };
+    database_file_load_sorted_entries_thread(&folder_ctx, NULL);
+    database_file_load_sorted_entries_thread(&file_ctx, NULL);
+    if (folder_ctx.error || file_ctx.error) {
+        g_debug("[db_load] sorted arrays of the %s index are corrupted",
+                fsearch_database_index_property_to_string(sort_order));
+        g_clear_pointer(&folder_ctx.dest, darray_unref);
+        g_clear_pointer(&file_ctx.dest, darray_unref);
+        return false;
+    }
+    content->sorted_folders[sort_order] = folder_ctx.dest;
+    content->sorted_files[sort_order] = file_ctx.dest;
+    return true;
+}
+
+// Maps all deferred indexes to the entries and releases the file data they were read from
+static void
+database_file_content_decode_deferred(DatabaseFileContent *content) {
+    for (uint32_t id = DATABASE_INDEX_PROPERTY_NAME; id < NUM_DATABASE_INDEX_PROPERTIES; id++) {
+        database_file_content_decode_sorted_array(content, id);
+    }
+    database_file_content_clear_deferred(content);
+}
+
+// The sort orders which aren't mapped to entries for every content of `contents` yet. That includes the ones which are
+// missing in some of them, e.g. because the file was saved while they were still being loaded: the store builds those
+// once loading them fails.
+static FsearchDatabaseIndexPropertyFlags
+database_file_get_deferred_sort_orders(GPtrArray *contents) {
+    FsearchDatabaseIndexPropertyFlags deferred = DATABASE_INDEX_PROPERTY_FLAG_NONE;
+    for (uint32_t id = DATABASE_INDEX_PROPERTY_NAME; id < NUM_DATABASE_INDEX_PROPERTIES; id++) {
+        bool is_decoded = true;
+        for (uint32_t i = 0; i < contents->len; i++) {
+            DatabaseFileContent *content = g_ptr_array_index(contents, i);
+            is_decoded &= content->sorted_folders[id] && content->sorted_files[id];
+        }
+        if (!is_decoded) {
+            deferred |= fsearch_database_index_property_to_flag(id);
+        }
+    }
+    return deferred;
+}
+
+typedef struct {
+    FsearchDatabaseIndexStore *store;
+    // The content of the database file or of all shards the store was created from. Their entries are owned by the
+    // indices of the store.
+    GPtrArray *contents;
+} DatabaseFileDeferredLoadContext;
+
+static void
+database_file_deferred_load_context_free(DatabaseFileDeferredLoadContext *ctx) {
+    g_clear_pointer(&ctx->store, fsearch_database_index_store_unref);
+    g_clear_pointer(&ctx->contents, g_ptr_array_unref);
+    g_clear_pointer(&ctx, g_free);
+}
+
+static bool
+database_file_is_removed_entry(void *entry, void *data) {
+    GHashTable *removed_entries = data;
+    return g_hash_table_contains(removed_entries, entry);
+}
+
+// Decodes the sorted arrays of `sort_order` of all contents and merges them, if there's more than one. The entries of
+// `removed_entries` are dropped first, since they might have been freed already.
+static bool
+database_file_decode_deferred_sort_order(GPtrArray *contents,
+                                         FsearchDatabaseIndexProperty sort_order,
+                                         GHashTable *removed_entries,
+                                         DynamicArray **folders_out,
+                                         DynamicArray **files_out) {
+    DatabaseFileMergeContext folder_ctx = {.arrays = g_ptr_array_sized_new(contents->len), .property = sort_order};
+    DatabaseFileMergeContext file_ctx = {.arrays = g_ptr_array_sized_new(contents->len), .property = sort_order};
+    bool res = true;
+    for (uint32_t i = 0; i < contents->len && res; i++) {
+        DatabaseFileContent *content = g_ptr_array_index(contents, i);
+        res = database_file_content_decode_sorted_array(content, sort_order);
+        if (res && g_hash_table_size(removed_entries) > 0) {
+            darray_drop_items(content->sorted_folders[sort_order], database_file_is_removed_entry, removed_entries);
+            darray_drop_items(content->sorted_files[sort_order], database_file_is_removed_entry, removed_entries);
+        }
+        g_ptr_array_add(folder_ctx.arrays, content->sorted_folders[sort_order]);
+        g_ptr_array_add(file_ctx.arrays, content->sorted_files[sort_order]);
+    }
+    if (res) {
+        database_file_merge_sorted_arrays_thread(&folder_ctx, NULL);
+        database_file_merge_sorted_arrays_thread(&file_ctx, NULL);
+        *folders_out = g_steal_pointer(&folder_ctx.result);
+        *files_out = g_steal_pointer(&file_ctx.result);
+    }
+    g_clear_pointer(&folder_ctx.arrays, g_ptr_array_unref);
+    g_clear_pointer(&file_ctx.arrays, g_ptr_array_unref);
+
+    // They're copied by the store
+    for (uint32_t i = 0; i < contents->len; i++) {
+        DatabaseFileContent *content = g_ptr_array_index(contents, i);
+        g_clear_pointer(&content->sorted_folders[sort_order], darray_unref);
+        g_clear_pointer(&content->sorted_files[sort_order], darray_unref);
+    }
+    return res;
+}
+
+// Hands the deferred sort orders over to the store one after the other. The ones which are requested by a search view
+// in the meantime are decoded first, until then their views are sorted manually.
+static gpointer
+database_file_deferred_load_thread(gpointer data) {
+    DatabaseFileDeferredLoadContext *ctx = data;
+    g_autoptr(GTimer) timer = g_timer_new();
+
+    while (true) {
+        fsearch_database_index_store_lock(ctx->store);
+        const FsearchDatabaseIndexProperty sort_order = fsearch_database_index_store_get_next_deferred_sort_index(
+            ctx->store);
+        if (sort_order == DATABASE_INDEX_PROPERTY_NONE) {
+            fsearch_database_index_store_unlock(ctx->store);
+            break;
+        }
+
+        // The indices which own the entries are kept locked while they're being read, without blocking searches.
+        // Changes of the store are held back meanwhile, the ones which were made since it was created are applied to
+        // the loaded index when it's added.
+        g_autoptr(GPtrArray) indices = fsearch_database_index_store_begin_reading_entries(ctx->store);
+        g_autoptr(GHashTable) removed_entries = fsearch_database_index_store_get_removed_entries(ctx->store,
+                                                                                                sort_order);
+        fsearch_database_index_store_unlock(ctx->store);
+
+        g_timer_start(timer);
+        g_autoptr(DynamicArray) folders = NULL;
+        g_autoptr(DynamicArray) files = NULL;
+        database_file_decode_deferred_sort_order(ctx->contents, sort_order, removed_entries, &folders, &files);
+
+        // Never take the store lock while holding index locks
+        for (uint32_t i = 0; i < indices->len; i++) {
+            fsearch_database_index_unlock(g_ptr_array_index(indices, i));
+        }
+
+        fsearch_database_index_store_lock(ctx->store);
+        if (fsearch_database_index_store_add_sort_index(ctx->store, sort_order, files, folders)) {
+            g_debug("[db_load] loaded the %s index in %.3f ms",
+                    fsearch_database_index_property_to_string(sort_order),
+                    g_timer_elapsed(timer, NULL) * 1000.0);
+        }
+        fsearch_database_index_store_end_reading_entries(ctx->store);
+        fsearch_database_index_store_unlock(ctx->store);
+    }
+
+    database_file_deferred_load_context_free(ctx);
+    return NULL;
+}
+
+// Starts loading the sort orders `deferred` of `contents` into `store` in the background. Takes ownership of
+// `contents`.
+static void
+database_file_load_deferred_sort_orders(FsearchDatabaseIndexStore *store,
+                                        GPtrArray *contents,
+                                        FsearchDatabaseIndexPropertyFlags deferred) {
+    // The store has its own copies of the other sorted arrays
+    for (uint32_t i = 0; i < contents->len; i++) {
+        DatabaseFileContent *content = g_ptr_array_index(contents, i);
+        for (uint32_t id = DATABASE_INDEX_PROPERTY_NAME; id < NUM_DATABASE_INDEX_PROPERTIES; id++) {
+            if (!fsearch_database_index_property_is_set(deferred, id)) {
+                g_clear_pointer(&content->sorted_folders[id], darray_unref);
+                g_clear_pointer(&content->sorted_files[id], darray_unref);
+            }
+        }
+    }
+    if (deferred == DATABASE_INDEX_PROPERTY_FLAG_NONE) {
+        g_ptr_array_unref(contents);
+        return;
+    }
+
+    DatabaseFileDeferredLoadContext *ctx = g_new0(DatabaseFileDeferredLoadContext, 1);
+    ctx->store = fsearch_database_index_store_ref(store);
+    ctx->contents = contents;
+
+    g_thread_unref(g_thread_new("FsearchDatabaseFileDeferredLoad", database_file_deferred_load_thread, ctx));
+}
+
+// Loads the database file at `file_path` into `content`, which must be cleared by the caller. Fails if the includes or
+// excludes of the file don't match `config_include_manager` or `config_exclude_manager`, unless they're NULL.
+static bool
+database_file_load_content(const char *file_path,
                            void (*status_cb)(const char *),
-                           FsearchDatabaseIndexStore **store_out,
                            FsearchDatabaseIncludeManager *config_include_manager,
                            FsearchDatabaseExcludeManager *config_exclude_manager,
-                           FsearchDatabaseIndexStoreEventFunc event_func,
-                           void *event_func_user_data) {
-    g_return_val_if_fail(file_path, false);
-    g_return_val_if_fail(store_out, false);
-
+                           DatabaseFileContent *content) {
     g_autoptr(FILE) fp = file_open_locked(file_path, "rb");
     if (!fp) {
         return false;
     }
 
-    g_autoptr(DynamicArray) folders = NULL;
-    g_autoptr(DynamicArray) files = NULL;
-    DynamicArray *sorted_folders[NUM_DATABASE_INDEX_PROPERTIES] = {NULL};
-    DynamicArray *sorted_files[NUM_DATABASE_INDEX_PROPERTIES] = {NULL};
-    g_autoptr(FsearchDatabaseIncludeManager) include_manager = fsearch_database_include_manager_new();
-    g_autoptr(FsearchDatabaseExcludeManager) exclude_manager = fsearch_database_exclude_manager_new();
-    g_autoptr(GPtrArray) includes = fsearch_database_include_manager_get_includes(include_manager);
-    g_autoptr(GPtrArray) indices = g_ptr_array_new_with_free_func((GDestroyNotify)fsearch_database_index_unref);
-    g_autoptr(GHashTable) folder_index_arrays = g_hash_table_new_full(g_str_hash,
-                                                                      g_str_equal,
-                                                                      NULL,
-                                                                      (GDestroyNotify)darray_unref);
-    g_autoptr(GHashTable) file_index_arrays = g_hash_table_new_full(g_str_hash,
-                                                                    g_str_equal,
-                                                                    NULL,
-                                                                    (GDestroyNotify)darray_unref);
+    g_autoptr(GMappedFile) mapped_file = NULL;
+    g_autoptr(GError) map_error = NULL;
+    g_auto(DatabaseFileSectionReader) section = {0};
+    g_autofree uint16_t *file_type_ids = NULL;
+    content->include_manager = fsearch_database_include_manager_new();
+    content->exclude_manager = fsearch_database_exclude_manager_new();
 
-    g_autoptr(GChecksum) checksum = g_checksum_new(G_CHECKSUM_MD5);
+    FsearchHash checksum;
+    fsearch_hash_init(&checksum, DATABASE_CHECKSUM_SEED);
 
-    if (!database_file_load_header(fp, checksum)) {
+    uint8_t minor_version = 0;
+    if (!database_file_load_header(fp,
+                                   &checksum,
+                                   DATABASE_MAGIC_NUMBER,
+                                   DATABASE_MAJOR_VERSION,
+                                   DATABASE_MINOR_VERSION,
+                                   &minor_version)) {
         goto load_fail;
     }
 
     uint64_t index_flags = 0;
-    if (!database_file_read_element(&index_flags, sizeof(index_flags), fp, checksum)) {
+    if (!database_file_read_element(&index_flags, sizeof(index_flags), fp, &checksum)) {
         g_debug("[db_load] failed to read index flags");
         goto load_fail;
     }
+    content->index_flags = index_flags;
 
     uint64_t fast_sort_flags = 0;
-    if (!database_file_read_element(&fast_sort_flags, sizeof(fast_sort_flags), fp, checksum)) {
+    if (!database_file_read_element(&fast_sort_flags, sizeof(fast_sort_flags), fp, &checksum)) {
         g_debug("[db_load] failed to read fast sort flags");
         goto load_fail;
     }
 
-    if (!database_file_load_includes(fp, include_manager, checksum)) {
+    FsearchDatabaseFileCompression compression = DATABASE_FILE_COMPRESSION_NONE;
+    if (!database_file_load_compression(fp, &checksum, &compression)) {
+        g_debug("[db_load] failed to read compression");
+        goto load_fail;
+    }
+
+    if (!database_file_load_includes(fp, content->include_manager, &checksum)) {
         g_debug("[db_load] failed to load includes");
         goto load_fail;
     }
-    if (config_include_manager && !fsearch_database_include_manager_equal(include_manager, config_include_manager)) {
+    if (config_include_manager
+        && !fsearch_database_include_manager_equal(content->include_manager, config_include_manager)) {
         g_debug("[db_load] includes don't match config. Abort loading.");
         goto load_fail;
     }
-    if (!database_file_load_excludes(fp, exclude_manager, checksum)) {
+    if (!database_file_load_excludes(fp, content->exclude_manager, &checksum)) {
         g_debug("[db_load] excludes not loaded");
         goto load_fail;
     }
-    if (config_exclude_manager && !fsearch_database_exclude_manager_equal(exclude_manager, config_exclude_manager)) {
+    if (config_exclude_manager
+        && !fsearch_database_exclude_manager_equal(content->exclude_manager, config_exclude_manager)) {
         g_debug("[db_load] excludes don't match config. Abort loading.");
         goto load_fail;
     }
 
     uint32_t num_folders = 0;
-    if (!database_file_read_element(&num_folders, sizeof(num_folders), fp, checksum)) {
+    if (!database_file_read_element(&num_folders, sizeof(num_folders), fp, &checksum)) {
         g_debug("[db_load] failed to read num_folders");
         goto load_fail;
     }
 
     uint32_t num_files = 0;
-    if (!database_file_read_element(&num_files, sizeof(num_files), fp, checksum)) {
+    if (!database_file_read_element(&num_files, sizeof(num_files), fp, &checksum)) {
         g_debug("[db_load] failed to read num_files");
         goto load_fail;
     }
     g_debug("[db_load] load %d folders, %d files", num_folders, num_files);
 
-    uint64_t folder_block_size = 0;
-    if (!database_file_read_element(&folder_block_size, sizeof(folder_block_size), fp, checksum)) {
-        g_debug("[db_load] failed to read folder block size");
+    DatabaseFileSectionInfo sections[NUM_DATABASE_FILE_SECTIONS] = {};
+    if (!database_file_read_element(sections, sizeof(sections), fp, &checksum)) {
+        g_debug("[db_load] failed to read section infos");
         goto load_fail;
     }
 
-    uint64_t file_block_size = 0;
-    if (!database_file_read_element(&file_block_size, sizeof(file_block_size), fp, checksum)) {
-        g_debug("[db_load] loading file block size: %" PRIu64, file_block_size);
-        goto load_fail;
-    }
-    g_debug("[db_load] folder size: %" PRIu64 ", file size: %" PRIu64, folder_block_size, file_block_size);
-
-    gsize checksum_computed_len = DATABASE_CHECKSUM_SIZE;
-    uint8_t checksum_computed[DATABASE_CHECKSUM_SIZE] = {};
-    g_checksum_get_digest(checksum, checksum_computed, &checksum_computed_len);
-
-    uint8_t checksum_stored[DATABASE_CHECKSUM_SIZE] = {};
-    if (!database_file_read_element(checksum_stored, sizeof(checksum_stored), fp, NULL)) {
+    const uint64_t checksum_computed = fsearch_hash_digest(&checksum);
+    uint64_t checksum_stored = 0;
+    if (!database_file_read_element(&checksum_stored, sizeof(checksum_stored), fp, NULL)) {
         g_debug("[db_load] loading checksum failed");
         goto load_fail;
     }
 
-    if (memcmp(checksum_stored, checksum_computed, DATABASE_CHECKSUM_SIZE) != 0) {
-        g_warning("[db_load] Database Metadata Corrupted! MD5 Checksum mismatch.");
+    if (checksum_stored != checksum_computed) {
+        g_warning("[db_load] Database Metadata Corrupted! Checksum mismatch.");
         goto load_fail;
     }
 
-    // pre-allocate the folders array, so we can later map parent indices to the corresponding pointers
-    folders = darray_new_full(num_folders, (GDestroyNotify)db_entry_free_no_unparent);
-
-    if (status_cb) {
-        status_cb(_("Loading folders…"));
+    // The sections are read straight from the mapped file, instead of reading them into temporary buffers first
+    const off_t blocks_offset = ftello(fp);
+    mapped_file = g_mapped_file_new_from_fd(fileno(fp), FALSE, &map_error);
+    if (!mapped_file) {
+        g_debug("[db_load] failed to map database file: %s", map_error->message);
+        goto load_fail;
     }
-    // load folders
-    if (!database_file_load_folders(fp, index_flags, folders, num_folders, folder_block_size)) {
-        g_debug("[db_load] failed to load folders");
+    const uint8_t *map = (const uint8_t *)g_mapped_file_get_contents(mapped_file);
+    const size_t map_size = g_mapped_file_get_length(mapped_file);
+    if (!map || blocks_offset < 0 || (uint64_t)blocks_offset > map_size) {
+        g_debug("[db_load] database file is truncated");
         goto load_fail;
     }
-    for (uint32_t i = 0; i < num_folders; i++) {
-        FsearchDatabaseEntry *folder = darray_get_item(folders, i);
-        const uint32_t parent_idx = GPOINTER_TO_UINT(db_entry_get_parent(folder));
-        FsearchDatabaseEntry *parent = parent_idx == UINT32_MAX ? NULL : darray_get_item(folders, parent_idx);
-        db_entry_set_parent_no_update(folder, parent);
-        db_entry_increment_childcount(parent, DATABASE_ENTRY_TYPE_FOLDER);
+    // The sections are hashed and then read from front to back
+    madvise((void *)map, map_size, MADV_SEQUENTIAL);
+    DatabaseFileReadCursor cursor = {.base = map, .ptr = map + blocks_offset, .end = map + map_size, .error = false};
+    cursor_skip_padding_to(&cursor, DATABASE_ENTRY_BLOCK_ALIGNMENT);
+    if (cursor.error || !database_file_verify_sections(map, map_size, (size_t)(cursor.ptr - map), sections)) {
+        goto load_fail;
     }
 
     if (status_cb) {
         status_cb(_("Loading files…"));
     }
-    // load files
-    files = darray_new_full(num_files, (GDestroyNotify)db_entry_free_no_unparent);
-    if (!database_file_load_files(fp, index_flags, folders, files, num_files, file_block_size)) {
-        g_debug("[db_load] failed to load files");
+    uint64_t block_size = 0;
+    bool block_mapped = false;
+    uint8_t *block = database_file_load_entry_block_data(&cursor,
+                                                         fileno(fp),
+                                                         compression,
+                                                         sections[DATABASE_FILE_SECTION_ENTRIES].size,
+                                                         num_folders + num_files,
+                                                         &block_size,
+                                                         &block_mapped);
+    if (cursor.error || (!block && num_folders + num_files > 0)) {
+        g_debug("[db_load] failed to load entry block");
+        database_file_release_entry_block(block, block_size, block_mapped);
         goto load_fail;
     }
 
-    if (!database_file_load_sorted_arrays(fp, sorted_folders, sorted_files, folders, files)) {
-        g_debug("[db_load] failed to load sorted arrays");
+    uint32_t num_file_types = 0;
+    DatabaseFileReadCursor *file_types_cursor = database_file_section_open(&section, &cursor, compression);
+    if (!file_types_cursor || !database_file_load_file_types(file_types_cursor, &file_type_ids, &num_file_types)) {
+        g_debug("[db_load] failed to load file types");
+        database_file_release_entry_block(block, block_size, block_mapped);
         goto load_fail;
     }
-    darray_set_free_func(folders, NULL);
-    darray_set_free_func(files, NULL);
-
-    DynamicArray *folders_sorted_by_path = sorted_folders[DATABASE_INDEX_PROPERTY_PATH];
-    for (uint32_t i = 0; i < darray_get_num_items(folders_sorted_by_path); i++) {
-        FsearchDatabaseEntry *folder = darray_get_item(folders_sorted_by_path, i);
-        database_file_load_add_to_index_array(folder_index_arrays, folder);
+    database_file_section_reader_clear(&section);
+
+    // The entries are only owned by the arrays once they're known to be valid, until then they're part of the block
+    content->folders = darray_new(num_folders);
+    content->files = darray_new(num_files);
+    DynamicArray *folders = content->folders;
+    DynamicArray *files = content->files;
+    if (!database_file_load_entry_block(block,
+                                        block_size,
+                                        index_flags,
+                                        num_folders,
+                                        num_files,
+                                        file_type_ids,
+                                        num_file_types,
+                                        folders,
+                                        files)) {
+        g_debug("[db_load] failed to load entries");
+        database_file_release_entry_block(block, block_size, block_mapped);
+        goto load_fail;
     }
-    DynamicArray *files_sorted_by_path = sorted_files[DATABASE_INDEX_PROPERTY_PATH];
-    for (uint32_t i = 0; i < darray_get_num_items(files_sorted_by_path); i++) {
-        FsearchDatabaseEntry *file = darray_get_item(files_sorted_by_path, i);
-        database_file_load_add_to_index_array(file_index_arrays, file);
+    darray_set_free_func(folders, (GDestroyNotify)db_entry_free_no_unparent);
+    darray_set_free_func(files, (GDestroyNotify)db_entry_free_no_unparent);
+
+    DatabaseFileReadCursor *sorted_arrays_cursor = database_file_section_open(&section, &cursor, compression);
+    if (!sorted_arrays_cursor
+        || !database_file_load_sorted_arrays(sorted_arrays_cursor,
+                                             DATABASE_FILE_EAGER_SORT_ORDERS,
+                                             content->sorted_folders,
+                                             content->sorted_files,
+                                             content->deferred_folder_indexes,
+                                             content->deferred_file_indexes,
+                                             folders,
+                                             files)) {
+        g_debug("[db_load] failed to load sorted arrays");
+        goto load_fail;
     }
+    // The remaining sorted arrays are read from where they're stored, which has to be kept around until then
+    content->mapped_file = g_steal_pointer(&mapped_file);
+    content->sorted_arrays_data = g_steal_pointer(&section.data);
 
-    g_ptr_array_sort(includes, fsearch_database_include_compare);
+    return true;
 
-    for (uint32_t i = 0; i < includes->len; i++) {
-        FsearchDatabaseInclude *include = g_ptr_array_index(includes, i);
-        const char *root_path = fsearch_database_include_get_path(include);
-        DynamicArray *folder_array_index = g_hash_table_lookup(folder_index_arrays, root_path);
-        DynamicArray *file_array_index = g_hash_table_lookup(file_index_arrays, root_path);
-        if (!folder_array_index) {
-            folder_array_index = darray_new(0);
-            g_hash_table_insert(folder_index_arrays, (gpointer)root_path, folder_array_index);
+load_fail:
+    g_debug("[db_load] load failed");
+
+    return false;
+}
+
+bool
+fsearch_database_file_load(const char *file_path,
+                           void (*status_cb)(const char *),
+                           FsearchDatabaseIndexStore **store_out,
+                           FsearchDatabaseIncludeManager *config_include_manager,
+                           FsearchDatabaseExcludeManager *config_exclude_manager,
+                           FsearchDatabaseIndexStoreEventFunc event_func,
+                           void *event_func_user_data) {
+    g_return_val_if_fail(file_path, false);
+    g_return_val_if_fail(store_out, false);
+
+    g_auto(DatabaseFileContent) content = {0};
+    if (!database_file_load_content(file_path, status_cb, config_include_manager, config_exclude_manager, &content)) {
+        return false;
+    }
+
+    g_autoptr(GPtrArray) includes = fsearch_database_include_manager_get_includes(content.include_manager);
+    g_autoptr(GPtrArray) indices = g_ptr_array_new_with_free_func((GDestroyNotify)fsearch_database_index_unref);
+    g_autoptr(GHashTable) folder_index_arrays = g_hash_table_new_full(g_str_hash,
+                                                                      g_str_equal,
+                                                                      NULL,
+                                                                      (GDestroyNotify)darray_unref);
+    g_autoptr(GHashTable) file_index_arrays = g_hash_table_new_full(g_str_hash,
+                                                                    g_str_equal,
+                                                                    NULL,
+                                                                    (GDestroyNotify)darray_unref);
+    database_file_content_release_entries(&content);
+
+    database_file_load_add_to_index_arrays(folder_index_arrays, content.sorted_folders[DATABASE_INDEX_PROPERTY_PATH]);
+    database_file_load_add_to_index_arrays(file_index_arrays, content.sorted_files[DATABASE_INDEX_PROPERTY_PATH]);
+
+    g_ptr_array_sort(includes, fsearch_database_include_compare);
+
+    for (uint32_t i = 0; i < includes->len; i++) {
+        FsearchDatabaseInclude *include = g_ptr_array_index(includes, i);
+        const char *root_path = fsearch_database_include_get_path(include);
+        DynamicArray *folder_array_index = g_hash_table_lookup(folder_index_arrays, root_path);
+        DynamicArray *file_array_index = g_hash_table_lookup(file_index_arrays, root_path);
+        if (!folder_array_index) {
+            folder_array_index = darray_new(0);
+            g_hash_table_insert(folder_index_arrays, (gpointer)root_path, folder_array_index);
         }
         if (!file_array_index) {
             file_array_index = darray_new(0);
             g_hash_table_insert(file_index_arrays, (gpointer)root_path, file_array_index);
         }
         FsearchDatabaseIndex *index = fsearch_database_index_new_with_content(include,
-                                                                              exclude_manager,
+                                                                              content.exclude_manager,
                                                                               folder_array_index,
                                                                               file_array_index,
+                                                                              content.index_flags);
+        g_ptr_array_add(indices, index);
+    }
+    g_autoptr(GPtrArray) contents = g_ptr_array_new_with_free_func((GDestroyNotify)database_file_content_free);
+    g_ptr_array_add(contents, database_file_content_steal(&content));
+    DatabaseFileContent *loaded = g_ptr_array_index(contents, 0);
+    const FsearchDatabaseIndexPropertyFlags deferred = database_file_get_deferred_sort_orders(contents);
+
+    *store_out = fsearch_database_index_store_new_with_content(indices,
+                                                               loaded->sorted_files,
+                                                               loaded->sorted_folders,
+                                                               loaded->include_manager,
+                                                               loaded->exclude_manager,
+                                                               loaded->index_flags,
+                                                               deferred,
+                                                               event_func,
+                                                               event_func_user_data);
+    database_file_load_deferred_sort_orders(*store_out, g_steal_pointer(&contents), deferred);
+
+    return true;
+}
+
+// region Database-Shards
+
+// The manifest holds the configuration and the names of the shards, which are regular database files with the
+// content of one include each, in the directory next to it:
+//
+//   "FSDM", major version, minor version, endianness, uint64_t index_flags, includes, excludes,
+//   uint32_t num_shards, (include path, shard file name)[num_shards], uint64_t checksum
+
+typedef struct {
+    // NULL if the root of the include is offline and its last shard is kept
+    FsearchDatabaseIndex *index;
+    char *include_path;
+    char *file_name;
+    // Generation of `index` when the snapshot was taken
+    int32_t generation;
+    // NULL if the shard on disk is up to date
+    FsearchDatabaseFileSnapshot *snapshot;
+} DatabaseFileShard;
+
+static void
+database_file_shard_free(DatabaseFileShard *shard) {
+    g_clear_pointer(&shard->index, fsearch_database_index_unref);
+    g_clear_pointer(&shard->include_path, g_free);
+    g_clear_pointer(&shard->file_name, g_free);
+    g_clear_pointer(&shard->snapshot, fsearch_database_file_snapshot_free);
+    g_clear_pointer(&shard, g_free);
+}
+
+struct FsearchDatabaseFileShardsSnapshot {
+    uint64_t index_flags;
+    // The includes and excludes of the whole database
+    GByteArray *config;
+    GPtrArray *shards;
+};
+
+static char *
+database_file_get_shards_dir(const char *file_path) {
+    return g_strconcat(file_path, ".shards", NULL);
+}
+
+// Shards are named after a hash of the path of their include, so an include keeps using the same file
+static char *
+database_file_get_shard_name(const char *include_path) {
+    const uint64_t hash = fsearch_hash_compute(include_path, strlen(include_path), DATABASE_CHECKSUM_SEED);
+    return g_strdup_printf("%016" PRIx64 DATABASE_SHARD_SUFFIX, hash);
+}
+
+typedef struct {
+    // The entries of the index of the shard, in the order of their arena ids
+    DatabaseFileEntrySet folder_set;
+    DatabaseFileEntrySet file_set;
+    DynamicArray *sorted_folders[NUM_DATABASE_INDEX_PROPERTIES];
+    DynamicArray *sorted_files[NUM_DATABASE_INDEX_PROPERTIES];
+} DatabaseFileShardArrays;
+
+static void
+database_file_shard_arrays_clear(DatabaseFileShardArrays *arrays) {
+    database_file_entry_set_clear(&arrays->folder_set);
+    database_file_entry_set_clear(&arrays->file_set);
+    database_file_clear_sorted_arrays(arrays->sorted_folders, arrays->sorted_files);
+}
+
+// Appends every folder or file of `entries`, which are sorted by `sort_order`, to the sorted array of the shard it
+// belongs to, so they keep their order. Only the arena ids of the entries are looked at.
+static void
+database_file_split_sorted_entries(DynamicArray *entries,
+                                   DatabaseFileShardArrays *arrays,
+                                   uint32_t num_shards,
+                                   bool folders,
+                                   FsearchDatabaseIndexProperty sort_order) {
+    const uint32_t num_entries = darray_get_num_items(entries);
+    for (uint32_t i = 0; i < num_entries; i++) {
+        FsearchDatabaseEntry *entry = darray_get_item(entries, i);
+        for (uint32_t j = 0; j < num_shards; j++) {
+            uint32_t rank = 0;
+            if (database_file_entry_set_get_rank(folders ? &arrays[j].folder_set : &arrays[j].file_set, entry, &rank)) {
+                darray_add_item(folders ? arrays[j].sorted_folders[sort_order] : arrays[j].sorted_files[sort_order],
+                                entry);
+                break;
+            }
+        }
+    }
+}
+
+// Fills `arrays` with the entries of the index of every shard of `shards`, sorted by every property the store has a
+// fast sort index for. They're picked from the sort indices of the store with a single pass over each of them, instead
+// of sorting the entries of every shard while the store is locked. The indices keep their entries sorted by path.
+// Store and indices must be locked.
+static void
+database_file_shards_get_sorted_arrays(FsearchDatabaseIndexStore *store,
+                                       GPtrArray *shards,
+                                       DatabaseFileShardArrays *arrays) {
+    for (uint32_t i = 0; i < shards->len; i++) {
+        DatabaseFileShard *shard = g_ptr_array_index(shards, i);
+        g_autoptr(DynamicArray) folders = fsearch_database_index_get_folders(shard->index);
+        g_autoptr(DynamicArray) files = fsearch_database_index_get_files(shard->index);
+        if (!folders || !files) {
+            continue;
+        }
+        uint32_t first_id = 0;
+        uint32_t last_id = 0;
+        database_file_get_id_range(folders, files, &first_id, &last_id);
+        database_file_entry_set_init(&arrays[i].folder_set, folders, first_id, last_id);
+        database_file_entry_set_init(&arrays[i].file_set, files, first_id, last_id);
+        arrays[i].sorted_folders[DATABASE_INDEX_PROPERTY_PATH] = darray_ref(folders);
+        arrays[i].sorted_files[DATABASE_INDEX_PROPERTY_PATH] = darray_ref(files);
+    }
+
+    DynamicArray *store_folders[NUM_DATABASE_INDEX_PROPERTIES] = {NULL};
+    DynamicArray *store_files[NUM_DATABASE_INDEX_PROPERTIES] = {NULL};
+    database_file_get_sorted_arrays(store, store_folders, store_files);
+    for (uint32_t id = DATABASE_INDEX_PROPERTY_NAME; id < NUM_DATABASE_INDEX_PROPERTIES; id++) {
+        if (!store_folders[id] || !store_files[id]) {
+            if (id == DATABASE_INDEX_PROPERTY_PATH) {
+                for (uint32_t i = 0; i < shards->len; i++) {
+                    g_clear_pointer(&arrays[i].sorted_folders[id], darray_unref);
+                    g_clear_pointer(&arrays[i].sorted_files[id], darray_unref);
+                }
+            }
+            continue;
+        }
+        if (id == DATABASE_INDEX_PROPERTY_PATH) {
+            continue;
+        }
+        for (uint32_t i = 0; i < shards->len; i++) {
+            if (!arrays[i].sorted_folders[DATABASE_INDEX_PROPERTY_PATH]) {
+                continue;
+            }
+            arrays[i].sorted_folders[id] = darray_new(
+                darray_get_num_items(arrays[i].sorted_folders[DATABASE_INDEX_PROPERTY_PATH]));
+            arrays[i].sorted_files[id] = darray_new(
+                darray_get_num_items(arrays[i].sorted_files[DATABASE_INDEX_PROPERTY_PATH]));
+        }
+        database_file_split_sorted_entries(store_folders[id], arrays, shards->len, true, id);
+        database_file_split_sorted_entries(store_files[id], arrays, shards->len, false, id);
+    }
+    database_file_clear_sorted_arrays(store_folders, store_files);
+}
+
+// Takes a snapshot of each shard of `shards` with the entries of its index. Store must be locked.
+static bool
+database_file_shards_take_snapshots(FsearchDatabaseIndexStore *store,
+                                    GPtrArray *shards,
+                                    FsearchDatabaseExcludeManager *exclude_manager,
+                                    FsearchDatabaseIndexPropertyFlags index_flags) {
+    for (uint32_t i = 0; i < shards->len; i++) {
+        DatabaseFileShard *shard = g_ptr_array_index(shards, i);
+        fsearch_database_index_lock(shard->index);
+    }
+
+    g_autofree DatabaseFileShardArrays *arrays = g_new0(DatabaseFileShardArrays, shards->len);
+    database_file_shards_get_sorted_arrays(store, shards, arrays);
+
+    bool res = true;
+    for (uint32_t i = 0; i < shards->len; i++) {
+        DatabaseFileShard *shard = g_ptr_array_index(shards, i);
+        g_autoptr(GPtrArray) includes = g_ptr_array_new_with_free_func((GDestroyNotify)fsearch_database_include_unref);
+        g_ptr_array_add(includes, fsearch_database_index_get_include(shard->index));
+
+        if (res) {
+            shard->snapshot = database_file_snapshot_new_from_arrays(includes,
+                                                                     exclude_manager,
+                                                                     index_flags,
+                                                                     arrays[i].sorted_folders,
+                                                                     arrays[i].sorted_files);
+            res = shard->snapshot != NULL;
+        }
+        database_file_shard_arrays_clear(&arrays[i]);
+        fsearch_database_index_unlock(shard->index);
+    }
+    return res;
+}
+
+FsearchDatabaseFileShardsSnapshot *
+fsearch_database_file_shards_snapshot_new(FsearchDatabaseIndexStore *store, const char *file_path) {
+    g_return_val_if_fail(store, NULL);
+    g_return_val_if_fail(file_path, NULL);
+
+    g_autoptr(GTimer) timer = g_timer_new();
+
+    g_autoptr(FsearchDatabaseIncludeManager) include_manager = fsearch_database_index_store_get_include_manager(store);
+    g_autoptr(GPtrArray) includes = fsearch_database_include_manager_get_includes(include_manager);
+    g_autoptr(FsearchDatabaseExcludeManager) exclude_manager = fsearch_database_index_store_get_exclude_manager(store);
+    g_autoptr(GPtrArray) indices = fsearch_database_index_store_get_indices(store);
+    g_autofree char *shards_dir = database_file_get_shards_dir(file_path);
+
+    g_autoptr(FsearchDatabaseFileShardsSnapshot) snapshot = g_new0(FsearchDatabaseFileShardsSnapshot, 1);
+    snapshot->index_flags = fsearch_database_index_store_get_flags(store);
+    snapshot->shards = g_ptr_array_new_with_free_func((GDestroyNotify)database_file_shard_free);
+
+    DatabaseFileWriteCursor config_cursor = {.buffer = g_byte_array_new()};
+    database_file_save_includes(&config_cursor, includes);
+    database_file_save_excludes(&config_cursor, exclude_manager);
+    snapshot->config = config_cursor.buffer;
+    if (config_cursor.error) {
+        g_debug("[db_save] failed taking snapshot of includes/excludes");
+        return NULL;
+    }
+
+    // The shards which have to be written, borrowed from snapshot->shards
+    g_autoptr(GPtrArray) dirty_shards = g_ptr_array_new();
+    for (uint32_t i = 0; i < indices->len; i++) {
+        FsearchDatabaseIndex *index = g_ptr_array_index(indices, i);
+        const char *include_path = fsearch_database_index_get_path(index);
+        g_autofree char *file_name = database_file_get_shard_name(include_path);
+        g_autofree char *shard_path = g_build_filename(shards_dir, file_name, NULL);
+        const bool exists = g_file_test(shard_path, G_FILE_TEST_IS_REGULAR);
+        const bool offline = fsearch_database_index_wants_root_reappear_poll(index);
+        if (offline && !exists) {
+            continue;
+        }
+        if (!offline && fsearch_database_index_is_unscanned(index)) {
+            // Without a shard the include gets scanned after the next load, in case the pending scan doesn't finish
+            continue;
+        }
+
+        DatabaseFileShard *shard = g_new0(DatabaseFileShard, 1);
+        shard->include_path = g_strdup(include_path);
+        shard->file_name = g_steal_pointer(&file_name);
+        g_ptr_array_add(snapshot->shards, shard);
+        if (offline) {
+            // Keep the last shard until the root reappears and gets scanned again
+            continue;
+        }
+        shard->index = fsearch_database_index_ref(index);
+        shard->generation = fsearch_database_index_get_generation(index);
+        if (!exists || fsearch_database_index_is_dirty(index)) {
+            g_ptr_array_add(dirty_shards, shard);
+        }
+    }
+
+    if (dirty_shards->len > 0
+        && !database_file_shards_take_snapshots(store, dirty_shards, exclude_manager, snapshot->index_flags)) {
+        g_debug("[db_save] failed taking snapshot of shards");
+        return NULL;
+    }
+
+    g_debug("[db_save] snapshot of %u/%u shards taken in %f ms",
+            dirty_shards->len,
+            snapshot->shards->len,
+            g_timer_elapsed(timer, NULL) * 1000);
+
+    return g_steal_pointer(&snapshot);
+}
+
+void
+fsearch_database_file_shards_snapshot_free(FsearchDatabaseFileShardsSnapshot *snapshot) {
+    g_return_if_fail(snapshot);
+
+    g_clear_pointer(&snapshot->config, g_byte_array_unref);
+    g_clear_pointer(&snapshot->shards, g_ptr_array_unref);
+    g_clear_pointer(&snapshot, g_free);
+}
+
+static bool
+database_file_save_manifest(FsearchDatabaseFileShardsSnapshot *snapshot, const char *file_path) {
+    g_autofree char *file_tmp_path = g_strconcat(file_path, ".tmp", NULL);
+    g_autoptr(FILE) fp = file_open_locked(file_tmp_path, "wb");
+    if (!fp) {
+        return false;
+    }
+
+    FsearchHash checksum;
+    fsearch_hash_init(&checksum, DATABASE_CHECKSUM_SEED);
+    DatabaseFileWriteCursor cursor = {.fp = fp, .checksum = &checksum};
+
+    database_file_save_header(&cursor,
+                              DATABASE_MANIFEST_MAGIC_NUMBER,
+                              DATABASE_MANIFEST_MAJOR_VERSION,
+                              DATABASE_MANIFEST_MINOR_VERSION);
+    cursor_write(&cursor, &snapshot->index_flags, sizeof(snapshot->index_flags));
+    cursor_write(&cursor, snapshot->config->data, snapshot->config->len);
+
+    const uint32_t num_shards = snapshot->shards->len;
+    cursor_write(&cursor, &num_shards, sizeof(num_shards));
+    for (uint32_t i = 0; i < num_shards; i++) {
+        DatabaseFileShard *shard = g_ptr_array_index(snapshot->shards, i);
+        cursor_write_string(&cursor, shard->include_path, strlen(shard->include_path));
+        cursor_write_string(&cursor, shard->file_name, strlen(shard->file_name));
+    }
+
+    const uint64_t checksum_value = fsearch_hash_digest(&checksum);
+    cursor.checksum = NULL;
+    cursor_write(&cursor, &checksum_value, sizeof(checksum_value));
+
+    g_clear_pointer(&fp, fclose);
+    if (cursor.error || rename(file_tmp_path, file_path) != 0) {
+        unlink(file_tmp_path);
+        return false;
+    }
+    return true;
+}
+
+// Removes the shard files which aren't part of `snapshot`, e.g. because their include was removed
+static void
+database_file_remove_stale_shards(FsearchDatabaseFileShardsSnapshot *snapshot, const char *shards_dir) {
+    g_autoptr(GDir) dir = g_dir_open(shards_dir, 0, NULL);
+    if (!dir) {
+        return;
+    }
+
+    g_autoptr(GHashTable) names = g_hash_table_new(g_str_hash, g_str_equal);
+    for (uint32_t i = 0; i < snapshot->shards->len; i++) {
+        DatabaseFileShard *shard = g_ptr_array_index(snapshot->shards, i);
+        g_hash_table_add(names, shard->file_name);
+    }
+
+    const char *name = NULL;
+    while ((name = g_dir_read_name(dir))) {
+        if (!g_str_has_suffix(name, DATABASE_SHARD_SUFFIX) || g_hash_table_contains(names, name)) {
+            continue;
+        }
+        g_autofree char *path = g_build_filename(shards_dir, name, NULL);
+        g_debug("[db_save] removing stale shard: %s", path);
+        unlink(path);
+    }
+}
+
+bool
+fsearch_database_file_shards_snapshot_save(FsearchDatabaseFileShardsSnapshot *snapshot,
+                                           const char *file_path,
+                                           FsearchDatabaseFileCompression compression) {
+    g_return_val_if_fail(snapshot, false);
+    g_return_val_if_fail(file_path, false);
+    g_return_val_if_fail(fsearch_database_file_compression_is_supported(compression), false);
+
+    g_autoptr(GTimer) timer = g_timer_new();
+
+    g_autofree char *shards_dir = database_file_get_shards_dir(file_path);
+    if (g_mkdir_with_parents(shards_dir, 0700) != 0) {
+        g_warning("[db_save] failed to create the shard directory: %s", shards_dir);
+        return false;
+    }
+
+    uint32_t num_saved = 0;
+    for (uint32_t i = 0; i < snapshot->shards->len; i++) {
+        DatabaseFileShard *shard = g_ptr_array_index(snapshot->shards, i);
+        if (!shard->snapshot) {
+            continue;
+        }
+        g_autofree char *shard_path = g_build_filename(shards_dir, shard->file_name, NULL);
+        // The old manifest stays valid if this fails, each shard is replaced in one go
+        if (!fsearch_database_file_snapshot_save(shard->snapshot, shard_path, compression)) {
+            return false;
+        }
+        num_saved++;
+    }
+
+    if (!database_file_save_manifest(snapshot, file_path)) {
+        g_warning("[db_save] saving the manifest failed: %s", file_path);
+        return false;
+    }
+
+    for (uint32_t i = 0; i < snapshot->shards->len; i++) {
+        DatabaseFileShard *shard = g_ptr_array_index(snapshot->shards, i);
+        if (shard->snapshot) {
+            fsearch_database_index_mark_saved(shard->index, shard->generation);
+        }
+    }
+    database_file_remove_stale_shards(snapshot, shards_dir);
+
+    g_debug("[db_save] saved %u/%u shards in %f ms",
+            num_saved,
+            snapshot->shards->len,
+            g_timer_elapsed(timer, NULL) * 1000);
+
+    return true;
+}
+
+uint64_t
+fsearch_database_file_shards_get_size(const char *file_path) {
+    g_return_val_if_fail(file_path, 0);
+
+    struct stat st;
+    uint64_t size = stat(file_path, &st) == 0 ? (uint64_t)st.st_size : 0;
+
+    g_autofree char *shards_dir = database_file_get_shards_dir(file_path);
+    g_autoptr(GDir) dir = g_dir_open(shards_dir, 0, NULL);
+    const char *name = NULL;
+    while (dir && (name = g_dir_read_name(dir))) {
+        g_autofree char *path = g_build_filename(shards_dir, name, NULL);
+        if (g_str_has_suffix(name, DATABASE_SHARD_SUFFIX) && stat(path, &st) == 0) {
+            size += (uint64_t)st.st_size;
+        }
+    }
+    return size;
+}
+
+// Reads the manifest at `file_path` into `include_manager` and `exclude_manager`. The file names of the shards are
+// added to `shard_names` by the path of their include.
+static bool
+database_file_load_manifest(const char *file_path,
+                            FsearchDatabaseIncludeManager *include_manager,
+                            FsearchDatabaseExcludeManager *exclude_manager,
+                            uint64_t *index_flags_out,
+                            GHashTable *shard_names) {
+    g_autoptr(FILE) fp = file_open_locked(file_path, "rb");
+    if (!fp) {
+        return false;
+    }
+
+    FsearchHash checksum;
+    fsearch_hash_init(&checksum, DATABASE_CHECKSUM_SEED);
+
+    uint8_t minor_version = 0;
+    if (!database_file_load_header(fp,
+                                   &checksum,
+                                   DATABASE_MANIFEST_MAGIC_NUMBER,
+                                   DATABASE_MANIFEST_MAJOR_VERSION,
+                                   DATABASE_MANIFEST_MINOR_VERSION,
+                                   &minor_version)) {
+        return false;
+    }
+
+    if (!database_file_read_element(index_flags_out, sizeof(*index_flags_out), fp, &checksum)) {
+        g_debug("[db_load] failed to read index flags");
+        return false;
+    }
+    if (!database_file_load_includes(fp, include_manager, &checksum)) {
+        g_debug("[db_load] failed to load includes");
+        return false;
+    }
+    if (!database_file_load_excludes(fp, exclude_manager, &checksum)) {
+        g_debug("[db_load] excludes not loaded");
+        return false;
+    }
+
+    uint32_t num_shards = 0;
+    if (!database_file_read_element(&num_shards, sizeof(num_shards), fp, &checksum)) {
+        g_debug("[db_load] failed to read number of shards");
+        return false;
+    }
+    for (uint32_t i = 0; i < num_shards; i++) {
+        g_autofree char *include_path = database_file_read_string(fp, 4 * PATH_MAX, &checksum);
+        g_autofree char *file_name = database_file_read_string(fp, NAME_MAX, &checksum);
+        if (!include_path || !file_name || strchr(file_name, G_DIR_SEPARATOR)
+            || !g_str_has_suffix(file_name, DATABASE_SHARD_SUFFIX)) {
+            g_debug("[db_load] failed to read shard");
+            return false;
+        }
+        g_hash_table_insert(shard_names, g_steal_pointer(&include_path), g_steal_pointer(&file_name));
+    }
+
+    const uint64_t checksum_computed = fsearch_hash_digest(&checksum);
+    uint64_t checksum_stored = 0;
+    if (!database_file_read_element(&checksum_stored, sizeof(checksum_stored), fp, NULL)) {
+        g_debug("[db_load] loading checksum failed");
+        return false;
+    }
+    if (checksum_stored != checksum_computed) {
+        g_warning("[db_load] Database Manifest Corrupted! Checksum mismatch.");
+        return false;
+    }
+    return true;
+}
+
+// Returns the active excludes of `to` which aren't active in `from`, or NULL if there are none
+static FsearchDatabaseExcludeManager *
+database_file_get_added_excludes(FsearchDatabaseExcludeManager *from, FsearchDatabaseExcludeManager *to) {
+    g_autoptr(FsearchDatabaseExcludeManager) added = fsearch_database_exclude_manager_new();
+    bool has_added = false;
+    if (fsearch_database_exclude_manager_get_exclude_hidden(to)
+        && !fsearch_database_exclude_manager_get_exclude_hidden(from)) {
+        fsearch_database_exclude_manager_set_exclude_hidden(added, TRUE);
+        has_added = true;
+    }
+
+    g_autoptr(GPtrArray) from_excludes = fsearch_database_exclude_manager_get_excludes(from);
+    g_autoptr(GPtrArray) to_excludes = fsearch_database_exclude_manager_get_excludes(to);
+    for (uint32_t i = 0; i < to_excludes->len; i++) {
+        FsearchDatabaseExclude *exclude = g_ptr_array_index(to_excludes, i);
+        if (!fsearch_database_exclude_get_active(exclude)
+            || g_ptr_array_find_with_equal_func(from_excludes,
+                                                exclude,
+                                                (GEqualFunc)fsearch_database_exclude_equal,
+                                                NULL)) {
+            continue;
+        }
+        fsearch_database_exclude_manager_add(added, exclude);
+        has_added = true;
+    }
+    return has_added ? g_steal_pointer(&added) : NULL;
+}
+
+// Whether any of `excludes` could match an entry below `include_path`
+static bool
+database_file_excludes_affect_include(FsearchDatabaseExcludeManager *excludes, const char *include_path) {
+    if (fsearch_database_exclude_manager_get_exclude_hidden(excludes)) {
+        return true;
+    }
+    g_autoptr(GPtrArray) exclude_array = fsearch_database_exclude_manager_get_excludes(excludes);
+    for (uint32_t i = 0; i < exclude_array->len; i++) {
+        FsearchDatabaseExclude *exclude = g_ptr_array_index(exclude_array, i);
+        if (fsearch_database_exclude_get_exclude_type(exclude) != FSEARCH_DATABASE_EXCLUDE_TYPE_FIXED
+            || fsearch_database_exclude_get_match_scope(exclude) != FSEARCH_DATABASE_EXCLUDE_MATCH_SCOPE_FULL_PATH) {
+            // Patterns and names can match anywhere
+            return true;
+        }
+        const char *pattern = fsearch_database_exclude_get_pattern(exclude);
+        if (g_strcmp0(include_path, G_DIR_SEPARATOR_S) == 0) {
+            return true;
+        }
+        if (g_str_has_prefix(pattern, include_path) && pattern[strlen(include_path)] == G_DIR_SEPARATOR) {
+            return true;
+        }
+    }
+    return false;
+}
+
+enum {
+    DATABASE_FILE_PRUNE_KEEP = 1,
+    DATABASE_FILE_PRUNE_EXCLUDED = 2,
+};
+
+// Whether `entry` or one of its parents is excluded by `excludes`. The mark of an entry is a single bit, so the results
+// for folders are cached in `folder_results` instead.
+static bool
+database_file_entry_is_excluded(FsearchDatabaseEntry *entry,
+                                FsearchDatabaseExcludeManager *excludes,
+                                GHashTable *folder_results) {
+    const bool is_folder = db_entry_is_folder(entry);
+    if (is_folder) {
+        const int result = GPOINTER_TO_INT(g_hash_table_lookup(folder_results, entry));
+        if (result != 0) {
+            return result == DATABASE_FILE_PRUNE_EXCLUDED;
+        }
+    }
+
+    bool excluded = false;
+    FsearchDatabaseEntry *parent = db_entry_get_parent(entry);
+    // The root of an include is never excluded, just like when it's scanned
+    if (parent) {
+        excluded = database_file_entry_is_excluded(parent, excludes, folder_results);
+        if (!excluded) {
+            g_autoptr(GString) path = db_entry_get_path_full(entry);
+            excluded = fsearch_database_exclude_manager_excludes(excludes,
+                                                                 path->str,
+                                                                 db_entry_get_name_raw(entry),
+                                                                 is_folder);
+        }
+    }
+    if (is_folder) {
+        g_hash_table_insert(folder_results,
+                            entry,
+                            GINT_TO_POINTER(excluded ? DATABASE_FILE_PRUNE_EXCLUDED : DATABASE_FILE_PRUNE_KEEP));
+    }
+    return excluded;
+}
+
+static DynamicArray *
+database_file_filter_excluded(DynamicArray *entries, DynamicArray *excluded_out) {
+    const uint32_t num_entries = darray_get_num_items(entries);
+    DynamicArray *kept = darray_new(num_entries);
+    for (uint32_t i = 0; i < num_entries; i++) {
+        FsearchDatabaseEntry *entry = darray_get_item(entries, i);
+        if (!db_entry_get_mark(entry)) {
+            darray_add_item(kept, entry);
+        }
+        else if (excluded_out) {
+            darray_add_item(excluded_out, entry);
+        }
+    }
+    return kept;
+}
+
+// Removes the entries which are excluded by `excludes` from `content` and frees them, so a database file which was
+// written with fewer excludes doesn't have to be scanned again. Returns the number of removed entries.
+static uint32_t
+database_file_content_prune(DatabaseFileContent *content, FsearchDatabaseExcludeManager *excludes) {
+    // Excluded entries get marked
+    g_autoptr(GHashTable) folder_results = g_hash_table_new(NULL, NULL);
+    DynamicArray *owners[] = {content->folders, content->files};
+    uint32_t num_excluded = 0;
+    for (uint32_t i = 0; i < G_N_ELEMENTS(owners); i++) {
+        for (uint32_t j = 0; j < darray_get_num_items(owners[i]); j++) {
+            FsearchDatabaseEntry *entry = darray_get_item(owners[i], j);
+            const bool excluded = database_file_entry_is_excluded(entry, excludes, folder_results);
+            db_entry_set_mark(entry, excluded ? 1 : 0);
+            num_excluded += excluded ? 1 : 0;
+        }
+    }
+
+    if (num_excluded > 0) {
+        for (uint32_t i = 0; i < NUM_DATABASE_INDEX_PROPERTIES; i++) {
+            if (content->sorted_folders[i]) {
+                g_autoptr(DynamicArray) sorted = g_steal_pointer(&content->sorted_folders[i]);
+                content->sorted_folders[i] = database_file_filter_excluded(sorted, NULL);
+            }
+            if (content->sorted_files[i]) {
+                g_autoptr(DynamicArray) sorted = g_steal_pointer(&content->sorted_files[i]);
+                content->sorted_files[i] = database_file_filter_excluded(sorted, NULL);
+            }
+        }
+
+        g_autoptr(DynamicArray) excluded_folders = darray_new_full(num_excluded,
+                                                                   (GDestroyNotify)db_entry_free_no_unparent);
+        g_autoptr(DynamicArray) excluded_files = darray_new_full(num_excluded,
+                                                                 (GDestroyNotify)db_entry_free_no_unparent);
+        g_autoptr(DynamicArray) folders = g_steal_pointer(&content->folders);
+        g_autoptr(DynamicArray) files = g_steal_pointer(&content->files);
+        darray_set_free_func(folders, NULL);
+        darray_set_free_func(files, NULL);
+        content->folders = database_file_filter_excluded(folders, excluded_folders);
+        content->files = database_file_filter_excluded(files, excluded_files);
+        darray_set_free_func(content->folders, (GDestroyNotify)db_entry_free_no_unparent);
+        darray_set_free_func(content->files, (GDestroyNotify)db_entry_free_no_unparent);
+
+        // Detaching the topmost excluded entries updates the sizes and child counts of the folders which are kept. The
+        // entries below them are freed along with them.
+        DynamicArray *excluded[] = {excluded_folders, excluded_files};
+        for (uint32_t i = 0; i < G_N_ELEMENTS(excluded); i++) {
+            for (uint32_t j = 0; j < darray_get_num_items(excluded[i]); j++) {
+                FsearchDatabaseEntry *entry = darray_get_item(excluded[i], j);
+                FsearchDatabaseEntry *parent = db_entry_get_parent(entry);
+                if (!db_entry_get_mark(parent)) {
+                    db_entry_set_parent(entry, NULL);
+                }
+            }
+        }
+        // Which makes the folders sorted by size out of order
+        if (content->sorted_folders[DATABASE_INDEX_PROPERTY_SIZE]) {
+            g_autoptr(FsearchDatabaseEntryCompareContext) compare_context = db_entry_compare_context_new(
+                fsearch_database_sort_order_chain_for_property(DATABASE_INDEX_PROPERTY_SIZE));
+            darray_sort(content->sorted_folders[DATABASE_INDEX_PROPERTY_SIZE],
+                        (DynamicArrayCompareDataFunc)db_entry_compare_entries_by_chain,
+                        NULL,
+                        compare_context);
+        }
+    }
+    return num_excluded;
+}
+
+typedef struct {
+    char *file_path;
+    // The include and excludes of the current config
+    FsearchDatabaseInclude *include;
+    FsearchDatabaseExcludeManager *exclude_manager;
+    uint64_t index_flags;
+    DatabaseFileContent content;
+    // The shard was written with other excludes, so it has to be written again
+    bool excludes_changed;
+    bool res;
+} DatabaseFileShardLoadContext;
+
+static void
+database_file_shard_load_context_free(DatabaseFileShardLoadContext *ctx) {
+    database_file_content_clear(&ctx->content);
+    g_clear_pointer(&ctx->file_path, g_free);
+    g_clear_pointer(&ctx->include, fsearch_database_include_unref);
+    g_clear_object(&ctx->exclude_manager);
+    g_clear_pointer(&ctx, g_free);
+}
+
+static void
+database_file_load_shard_thread(gpointer data, gpointer user_data) {
+    DatabaseFileShardLoadContext *ctx = data;
+
+    if (!database_file_load_content(ctx->file_path, NULL, NULL, NULL, &ctx->content)) {
+        g_debug("[db_load] failed to load shard: %s", ctx->file_path);
+        return;
+    }
+
+    g_autoptr(GPtrArray) includes = fsearch_database_include_manager_get_includes(ctx->content.include_manager);
+    const char *include_path = fsearch_database_include_get_path(ctx->include);
+    if (includes->len != 1
+        || g_strcmp0(fsearch_database_include_get_path(g_ptr_array_index(includes, 0)), include_path) != 0) {
+        g_debug("[db_load] shard %s doesn't belong to %s", ctx->file_path, include_path);
+        return;
+    }
+    if (fsearch_database_include_get_one_file_system(g_ptr_array_index(includes, 0))
+        != fsearch_database_include_get_one_file_system(ctx->include)) {
+        g_debug("[db_load] one file system setting of %s changed", include_path);
+        return;
+    }
+    if (ctx->content.index_flags != ctx->index_flags) {
+        g_debug("[db_load] index flags of shard %s don't match", ctx->file_path);
+        return;
+    }
+    // The index of the include is built from the entries sorted by path
+    if (!ctx->content.sorted_folders[DATABASE_INDEX_PROPERTY_PATH]
+        || !ctx->content.sorted_files[DATABASE_INDEX_PROPERTY_PATH]) {
+        g_debug("[db_load] shard %s has no path index", ctx->file_path);
+        return;
+    }
+
+    if (!fsearch_database_exclude_manager_equal(ctx->content.exclude_manager, ctx->exclude_manager)) {
+        // Entries which were excluded when the shard was written are missing, only a scan can bring them back
+        g_autoptr(FsearchDatabaseExcludeManager) removed_excludes = database_file_get_added_excludes(
+            ctx->exclude_manager,
+            ctx->content.exclude_manager);
+        if (removed_excludes && database_file_excludes_affect_include(removed_excludes, include_path)) {
+            g_debug("[db_load] excludes of %s were removed", include_path);
+            return;
+        }
+        g_autoptr(FsearchDatabaseExcludeManager) added_excludes = database_file_get_added_excludes(
+            ctx->content.exclude_manager,
+            ctx->exclude_manager);
+        if (added_excludes) {
+            // The deferred sorted arrays refer to the entries by their position, which changes
+            database_file_content_decode_deferred(&ctx->content);
+            const uint32_t num_pruned = database_file_content_prune(&ctx->content, added_excludes);
+            g_debug("[db_load] removed %u newly excluded entries of %s", num_pruned, include_path);
+        }
+        ctx->excludes_changed = true;
+    }
+    ctx->res = true;
+}
+
+// Merges the sorted arrays of the shards in `shards` into `sorted_folders` and `sorted_files`. Sort orders which are
+// missing or deferred in any of the shards are left out, they're loaded in the background or built by the store.
+static bool
+database_file_merge_shards(GPtrArray *shards, DynamicArray **sorted_folders, DynamicArray **sorted_files) {
+    DatabaseFileMergeContext merge_ctx[2 * NUM_DATABASE_INDEX_PROPERTIES] = {0};
+    uint32_t num_merges = 0;
+    for (uint32_t id = DATABASE_INDEX_PROPERTY_NAME; id < NUM_DATABASE_INDEX_PROPERTIES; id++) {
+        bool available = true;
+        for (uint32_t i = 0; i < shards->len; i++) {
+            DatabaseFileShardLoadContext *shard = g_ptr_array_index(shards, i);
+            available &= shard->content.sorted_folders[id] && shard->content.sorted_files[id];
+        }
+        if (!available) {
+            if (id == DATABASE_INDEX_PROPERTY_NAME) {
+                g_debug("[db_load] name index is missing in a shard");
+                return false;
+            }
+            continue;
+        }
+
+        DatabaseFileMergeContext *folder_ctx = &merge_ctx[num_merges++];
+        DatabaseFileMergeContext *file_ctx = &merge_ctx[num_merges++];
+        folder_ctx->arrays = g_ptr_array_sized_new(shards->len);
+        folder_ctx->property = id;
+        file_ctx->arrays = g_ptr_array_sized_new(shards->len);
+        file_ctx->property = id;
+        for (uint32_t i = 0; i < shards->len; i++) {
+            DatabaseFileShardLoadContext *shard = g_ptr_array_index(shards, i);
+            g_ptr_array_add(folder_ctx->arrays, shard->content.sorted_folders[id]);
+            g_ptr_array_add(file_ctx->arrays, shard->content.sorted_files[id]);
+        }
+    }
+
+    if (shards->len > 1) {
+        GThreadPool *merge_pool = g_thread_pool_new(database_file_merge_sorted_arrays_thread,
+                                                    NULL,
+                                                    (gint)MIN(num_merges, g_get_num_processors()),
+                                                    FALSE,
+                                                    NULL);
+        for (uint32_t i = 0; i < num_merges; i++) {
+            g_thread_pool_push(merge_pool, &merge_ctx[i], NULL);
+        }
+        g_thread_pool_free(g_steal_pointer(&merge_pool), FALSE, TRUE);
+    }
+    else {
+        for (uint32_t i = 0; i < num_merges; i++) {
+            database_file_merge_sorted_arrays_thread(&merge_ctx[i], NULL);
+        }
+    }
+
+    for (uint32_t i = 0; i < num_merges; i += 2) {
+        sorted_folders[merge_ctx[i].property] = g_steal_pointer(&merge_ctx[i].result);
+        sorted_files[merge_ctx[i + 1].property] = g_steal_pointer(&merge_ctx[i + 1].result);
+        g_clear_pointer(&merge_ctx[i].arrays, g_ptr_array_unref);
+        g_clear_pointer(&merge_ctx[i + 1].arrays, g_ptr_array_unref);
+    }
+    return true;
+}
+
+// The settings of `include` from the config with the scan statistics of the same include in the database file
+static FsearchDatabaseInclude *
+database_file_include_copy_with_scan_info(FsearchDatabaseInclude *include, FsearchDatabaseInclude *saved_include) {
+    FsearchDatabaseInclude *copy = fsearch_database_include_copy(include);
+    fsearch_database_include_set_last_scan_time(copy, fsearch_database_include_get_last_scan_time(saved_include));
+    fsearch_database_include_set_last_scan_duration(copy,
+                                                    fsearch_database_include_get_last_scan_duration(saved_include));
+    fsearch_database_include_set_last_error_code(copy, fsearch_database_include_get_last_error_code(saved_include));
+    fsearch_database_include_set_last_scanned_file_count(
+        copy,
+        fsearch_database_include_get_last_scanned_file_count(saved_include));
+    fsearch_database_include_set_last_scanned_folder_count(
+        copy,
+        fsearch_database_include_get_last_scanned_folder_count(saved_include));
+    fsearch_database_include_set_last_scan_reason(copy, fsearch_database_include_get_last_scan_reason(saved_include));
+    return copy;
+}
+
+bool
+fsearch_database_file_shards_load(const char *file_path,
+                                  void (*status_cb)(const char *),
+                                  FsearchDatabaseIndexStore **store_out,
+                                  FsearchDatabaseIncludeManager *config_include_manager,
+                                  FsearchDatabaseExcludeManager *config_exclude_manager,
+                                  FsearchDatabaseIndexStoreEventFunc event_func,
+                                  void *event_func_user_data) {
+    g_return_val_if_fail(file_path, false);
+    g_return_val_if_fail(store_out, false);
+
+    g_autoptr(GTimer) timer = g_timer_new();
+
+    g_autoptr(FsearchDatabaseIncludeManager) saved_include_manager = fsearch_database_include_manager_new();
+    g_autoptr(FsearchDatabaseExcludeManager) saved_exclude_manager = fsearch_database_exclude_manager_new();
+    g_autoptr(GHashTable) shard_names = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    uint64_t index_flags = 0;
+    if (!database_file_load_manifest(file_path,
+                                     saved_include_manager,
+                                     saved_exclude_manager,
+                                     &index_flags,
+                                     shard_names)) {
+        g_debug("[db_load] failed to load manifest: %s", file_path);
+        return false;
+    }
+
+    // The config may differ from the one the database was saved with. The shards of includes which are still part of
+    // it are kept, the others are scanned, which is much faster than scanning all of them again.
+    FsearchDatabaseExcludeManager *exclude_manager = config_exclude_manager ? config_exclude_manager
+                                                                            : saved_exclude_manager;
+    g_autoptr(GPtrArray) saved_includes = fsearch_database_include_manager_get_includes(saved_include_manager);
+    g_autoptr(GPtrArray) config_includes = fsearch_database_include_manager_get_includes(
+        config_include_manager ? config_include_manager : saved_include_manager);
+    g_autoptr(FsearchDatabaseIncludeManager) include_manager = fsearch_database_include_manager_new();
+    for (uint32_t i = 0; i < config_includes->len; i++) {
+        FsearchDatabaseInclude *config_include = g_ptr_array_index(config_includes, i);
+        guint saved_idx = 0;
+        if (g_ptr_array_find_with_equal_func(saved_includes,
+                                             config_include,
+                                             (GEqualFunc)fsearch_database_include_equal_path,
+                                             &saved_idx)) {
+            g_autoptr(FsearchDatabaseInclude) include = database_file_include_copy_with_scan_info(
+                config_include,
+                g_ptr_array_index(saved_includes, saved_idx));
+            fsearch_database_include_manager_add(include_manager, include);
+        }
+        else {
+            fsearch_database_include_manager_add(include_manager, config_include);
+        }
+    }
+
+    g_autofree char *shards_dir = database_file_get_shards_dir(file_path);
+    g_autoptr(GPtrArray) includes = fsearch_database_include_manager_get_includes(include_manager);
+    g_ptr_array_sort(includes, fsearch_database_include_compare);
+
+    g_autoptr(GPtrArray) shards = g_ptr_array_new_with_free_func(
+        (GDestroyNotify)database_file_shard_load_context_free);
+    // The shard of every include, NULL for the ones which start out empty
+    g_autofree DatabaseFileShardLoadContext **include_shards = g_new0(DatabaseFileShardLoadContext *,
+                                                                      MAX(includes->len, 1));
+    for (uint32_t i = 0; i < includes->len; i++) {
+        FsearchDatabaseInclude *include = g_ptr_array_index(includes, i);
+        const char *include_path = fsearch_database_include_get_path(include);
+        if (!fsearch_database_include_get_active(include)) {
+            continue;
+        }
+        const char *shard_name = g_hash_table_lookup(shard_names, include_path);
+        if (!shard_name) {
+            g_debug("[db_load] no shard for %s", include_path);
+            continue;
+        }
+
+        DatabaseFileShardLoadContext *shard = g_new0(DatabaseFileShardLoadContext, 1);
+        shard->file_path = g_build_filename(shards_dir, shard_name, NULL);
+        shard->include = fsearch_database_include_ref(include);
+        shard->exclude_manager = g_object_ref(exclude_manager);
+        shard->index_flags = index_flags;
+        g_ptr_array_add(shards, shard);
+        include_shards[i] = shard;
+    }
+
+    if (status_cb) {
+        status_cb(_("Loading files…"));
+    }
+    // Every shard is decoded on multiple threads as well, see database_file_load_entries()
+    if (shards->len > 1) {
+        GThreadPool *load_pool = g_thread_pool_new(database_file_load_shard_thread,
+                                                   NULL,
+                                                   (gint)MIN(shards->len, g_get_num_processors()),
+                                                   FALSE,
+                                                   NULL);
+        for (uint32_t i = 0; i < shards->len; i++) {
+            g_thread_pool_push(load_pool, g_ptr_array_index(shards, i), NULL);
+        }
+        g_thread_pool_free(g_steal_pointer(&load_pool), FALSE, TRUE);
+    }
+    else if (shards->len == 1) {
+        database_file_load_shard_thread(g_ptr_array_index(shards, 0), NULL);
+    }
+    for (uint32_t i = 0; i < includes->len; i++) {
+        DatabaseFileShardLoadContext *shard = include_shards[i];
+        if (shard && !shard->res) {
+            // The include gets scanned instead
+            include_shards[i] = NULL;
+            g_ptr_array_remove(shards, shard);
+        }
+    }
+
+    DynamicArray *sorted_folders[NUM_DATABASE_INDEX_PROPERTIES] = {NULL};
+    DynamicArray *sorted_files[NUM_DATABASE_INDEX_PROPERTIES] = {NULL};
+    if (!database_file_merge_shards(shards, sorted_folders, sorted_files)) {
+        database_file_clear_sorted_arrays(sorted_folders, sorted_files);
+        return false;
+    }
+
+    uint32_t num_unscanned = 0;
+    g_autoptr(GPtrArray) indices = g_ptr_array_new_with_free_func((GDestroyNotify)fsearch_database_index_unref);
+    for (uint32_t i = 0; i < includes->len; i++) {
+        FsearchDatabaseInclude *include = g_ptr_array_index(includes, i);
+        DatabaseFileShardLoadContext *shard = include_shards[i];
+        g_autoptr(DynamicArray) folders = NULL;
+        g_autoptr(DynamicArray) files = NULL;
+        if (shard) {
+            folders = darray_ref(shard->content.sorted_folders[DATABASE_INDEX_PROPERTY_PATH]);
+            files = darray_ref(shard->content.sorted_files[DATABASE_INDEX_PROPERTY_PATH]);
+        }
+        else {
+            folders = darray_new(0);
+            files = darray_new(0);
+        }
+        FsearchDatabaseIndex *index = fsearch_database_index_new_with_content(include,
+                                                                              exclude_manager,
+                                                                              folders,
+                                                                              files,
                                                                               index_flags);
+        if (shard && !g_file_test(fsearch_database_include_get_path(include), G_FILE_TEST_IS_DIR)) {
+            // The entries of an offline include stay searchable with their last known state. The index gets scanned
+            // again once its root reappears, which replaces them.
+            fsearch_database_index_request_root_reappear_poll(index);
+        }
+        if (shard && shard->excludes_changed) {
+            fsearch_database_index_mark_dirty(index);
+        }
+        else if (!shard && fsearch_database_include_get_active(include)) {
+            fsearch_database_index_mark_unscanned(index);
+            if (!g_file_test(fsearch_database_include_get_path(include), G_FILE_TEST_IS_DIR)) {
+                fsearch_database_index_request_root_reappear_poll(index);
+            }
+            else {
+                num_unscanned++;
+            }
+        }
         g_ptr_array_add(indices, index);
     }
+    g_autoptr(GPtrArray) contents = g_ptr_array_new_with_free_func((GDestroyNotify)database_file_content_free);
+    for (uint32_t i = 0; i < shards->len; i++) {
+        DatabaseFileShardLoadContext *shard = g_ptr_array_index(shards, i);
+        database_file_content_release_entries(&shard->content);
+        g_ptr_array_add(contents, database_file_content_steal(&shard->content));
+    }
+    const FsearchDatabaseIndexPropertyFlags deferred = database_file_get_deferred_sort_orders(contents);
+
     *store_out = fsearch_database_index_store_new_with_content(indices,
                                                                sorted_files,
                                                                sorted_folders,
                                                                include_manager,
                                                                exclude_manager,
                                                                index_flags,
+                                                               deferred,
                                                                event_func,
                                                                event_func_user_data);
+    database_file_clear_sorted_arrays(sorted_folders, sorted_files);
+    database_file_load_deferred_sort_orders(*store_out, g_steal_pointer(&contents), deferred);
 
-    for (uint32_t i = 0; i < NUM_DATABASE_INDEX_PROPERTIES; i++) {
-        g_clear_pointer(&sorted_folders[i], darray_unref);
-        g_clear_pointer(&sorted_files[i], darray_unref);
-    }
-    g_clear_pointer(&fp, fclose);
+    g_debug("[db_load] loaded %u shards in %f ms, %u includes have to be scanned",
+            shards->len,
+            g_timer_elapsed(timer, NULL) * 1000,
+            num_unscanned);
 
     return true;
+}
 
-load_fail:
-    g_debug("[db_load] load failed");
-
-    for (uint32_t i = 0; i < NUM_DATABASE_INDEX_PROPERTIES; i++) {
-        g_clear_pointer(&sorted_folders[i], darray_unref);
-        g_clear_pointer(&sorted_files[i], darray_unref);
-    }
-    return false;
-}
\ No newline at end of file
+// endregion
@@ -5,8 +5,32 @@
 #include "fsearch_database_index_properties.h"
 #include "fsearch_database_index_store.h"
 
+#include <glib.h>
 #include <stdbool.h>
+#include <stdint.h>
 
+// Codec used for the entry blocks and sorted arrays of the database file. The values are stored in the file.
+typedef enum {
+    DATABASE_FILE_COMPRESSION_NONE = 0,
+    DATABASE_FILE_COMPRESSION_LZ4 = 1,
+    DATABASE_FILE_COMPRESSION_ZSTD = 2,
+    NUM_DATABASE_FILE_COMPRESSIONS,
+} FsearchDatabaseFileCompression;
+
+// Whether files compressed with `compression` can be written and loaded by this build
+bool
+fsearch_database_file_compression_is_supported(FsearchDatabaseFileCompression compression);
+
+// "none", "lz4" or "zstd". NULL or an unknown name give the compression selected at build time (the
+// `database_compression` option).
+FsearchDatabaseFileCompression
+fsearch_database_file_get_compression_from_string(const char *str);
+
+const char *
+fsearch_database_file_compression_to_string(FsearchDatabaseFileCompression compression);
+
+// The store is returned as soon as the entries and the name and path indices are loaded. The other sort indices are
+// added on a background thread afterwards, see fsearch_database_index_store_add_sort_index().
 bool
 fsearch_database_file_load(const char *file_path,
                            void (*status_cb)(const char *),
@@ -22,5 +46,68 @@ fsearch_database_file_load_config(const char *file_path,
                                   FsearchDatabaseExcludeManager **exclude_manager_out,
                                   FsearchDatabaseIndexPropertyFlags *flags_out);
 
+// Saves with the compression selected at build time (the `database_compression` option). Store must be locked.
 bool
 fsearch_database_file_save(FsearchDatabaseIndexStore *store, const char *file_path);
+
+bool
+fsearch_database_file_save_with_compression(FsearchDatabaseIndexStore *store,
+                                            const char *file_path,
+                                            FsearchDatabaseFileCompression compression);
+
+// Everything needed to write a store to a database file, without references to its entries. Taking it is much faster
+// than saving, so the store only needs to be locked for fsearch_database_file_snapshot_new() and the slow part,
+// fsearch_database_file_snapshot_save(), can run without blocking searches or file system event processing.
+typedef struct FsearchDatabaseFileSnapshot FsearchDatabaseFileSnapshot;
+
+// Store must be locked
+FsearchDatabaseFileSnapshot *
+fsearch_database_file_snapshot_new(FsearchDatabaseIndexStore *store);
+
+void
+fsearch_database_file_snapshot_free(FsearchDatabaseFileSnapshot *snapshot);
+
+bool
+fsearch_database_file_snapshot_save(FsearchDatabaseFileSnapshot *snapshot,
+                                    const char *file_path,
+                                    FsearchDatabaseFileCompression compression);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(FsearchDatabaseFileSnapshot, fsearch_database_file_snapshot_free)
+
+// A database can also be stored as one shard per index, which are database files of their own in the directory
+// "<file_path>.shards", and a manifest at `file_path` with the includes, excludes and the names of the shards. Only the
+// shards of indices which changed since they were last saved get written. Indices whose root is offline keep their
+// last shard: it's loaded, so their entries stay searchable, but not rewritten until the root reappears and the index
+// gets scanned again.
+typedef struct FsearchDatabaseFileShardsSnapshot FsearchDatabaseFileShardsSnapshot;
+
+// Store must be locked
+FsearchDatabaseFileShardsSnapshot *
+fsearch_database_file_shards_snapshot_new(FsearchDatabaseIndexStore *store, const char *file_path);
+
+void
+fsearch_database_file_shards_snapshot_free(FsearchDatabaseFileShardsSnapshot *snapshot);
+
+bool
+fsearch_database_file_shards_snapshot_save(FsearchDatabaseFileShardsSnapshot *snapshot,
+                                           const char *file_path,
+                                           FsearchDatabaseFileCompression compression);
+
+// Loads the shards in parallel and merges their sort indices. The store is built for the includes and excludes of the
+// config: entries of newly excluded paths are removed, includes whose shard can't be used (e.g. because they're new,
+// or an exclude which affects them was removed) start out empty and marked as unscanned, so they can be scanned on
+// their own. Like fsearch_database_file_load(), the sort indices other than name and path are added in the background.
+bool
+fsearch_database_file_shards_load(const char *file_path,
+                                  void (*status_cb)(const char *),
+                                  FsearchDatabaseIndexStore **store_out,
+                                  FsearchDatabaseIncludeManager *config_include_manager,
+                                  FsearchDatabaseExcludeManager *config_exclude_manager,
+                                  FsearchDatabaseIndexStoreEventFunc event_func,
+                                  void *event_func_user_data);
+
+// Size of the manifest and all shards
+uint64_t
+fsearch_database_file_shards_get_size(const char *file_path);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(FsearchDatabaseFileShardsSnapshot, fsearch_database_file_shards_snapshot_free)
@@ -0,0 +1,252 @@
+#define G_LOG_DOMAIN "fsearch-database-file-type"
+
+#include "fsearch_database_file_type.h"
+
+#include "fsearch_file_utils.h"
+
+#include <gio/gio.h>
+#include <string.h>
+
+// Every thread caches the ids of the suffixes it has seen, until it has seen this many
+#define FILE_TYPE_CACHE_MAX_SIZE 4096
+// No file name is longer than this
+#define FILE_TYPE_MAX_NAME_LEN 255
+
+static GMutex file_type_lock;
+// Only accessed with `file_type_lock` held
+static GHashTable *file_type_ids_by_description = NULL;
+// Descriptions are published atomically and never change or get freed once set, so they can be read without the lock
+static const char *file_type_descriptions[FSEARCH_DATABASE_FILE_TYPE_ID_MAX + 1] = {};
+static uint32_t file_type_num_ids = 0;
+// Set once on initialization, before any id is handed out
+static uint16_t file_type_folder_id = FSEARCH_DATABASE_FILE_TYPE_ID_NONE;
+static uint16_t file_type_unknown_id = FSEARCH_DATABASE_FILE_TYPE_ID_NONE;
+
+// Guessing a type takes GIO's global MIME lock and about 1.4 us. But the type of most names only depends on their
+// suffix, which starts at their first dot, since most globs of the shared MIME database are of the form "*.ext". So the
+// ids are cached per thread by that suffix, and only names which another glob might match (e.g. "Makefile.am" or
+// "README.md") are always guessed.
+typedef struct {
+    // The lower case names which are matched as a whole (e.g. "cmakelists.txt")
+    GHashTable *literals;
+    uint32_t max_literal_len;
+    // The lower case starts of names which are matched by a glob (e.g. "readme" for "README*"), indexed by first byte
+    GPtrArray *prefixes[256];
+    // The lower case ends of names which are matched by any other glob (e.g. ".vdr" for "[0-9][0-9][0-9].vdr")
+    GPtrArray *suffixes;
+    // Set if the globs couldn't be read or one of them could match any name
+    bool disabled;
+} FileTypeGlobs;
+
+static FileTypeGlobs file_type_globs = {};
+
+static void
+file_type_cache_free(GHashTable *cache) {
+    g_clear_pointer(&cache, g_hash_table_destroy);
+}
+
+// suffix -> id + 1, so unknown suffixes can be told apart from ones with an id of 0
+static GPrivate file_type_cache = G_PRIVATE_INIT((GDestroyNotify)file_type_cache_free);
+
+static inline bool
+file_type_is_wildcard(char c) {
+    return c == '*' || c == '?' || c == '[';
+}
+
+static void
+file_type_globs_add(FileTypeGlobs *globs, const char *pattern) {
+    g_autofree char *glob = g_ascii_strdown(pattern, -1);
+    const char *wildcard = glob;
+    while (*wildcard && !file_type_is_wildcard(*wildcard)) {
+        wildcard++;
+    }
+
+    if (*wildcard == '\0') {
+        if (strlen(glob) > FILE_TYPE_MAX_NAME_LEN) {
+            return;
+        }
+        globs->max_literal_len = MAX(globs->max_literal_len, strlen(glob));
+        g_hash_table_add(globs->literals, g_steal_pointer(&glob));
+        return;
+    }
+    if (wildcard != glob) {
+        const uint8_t first_byte = (uint8_t)glob[0];
+        if (!globs->prefixes[first_byte]) {
+            globs->prefixes[first_byte] = g_ptr_array_new_with_free_func(g_free);
+        }
+        g_ptr_array_add(globs->prefixes[first_byte], g_strndup(glob, wildcard - glob));
+        return;
+    }
+    if (glob[0] == '*') {
+        const char *rest = glob + 1;
+        // "*.ext" only matches text from a dot on, "*~" only text after the last dot
+        if (rest[0] == '.' || (!strchr(rest, '.') && !strpbrk(rest, "*?["))) {
+            return;
+        }
+    }
+    // Anything else has to end with the literal text after its last wildcard
+    const char *tail = glob + strlen(glob);
+    while (tail > glob && !file_type_is_wildcard(tail[-1]) && tail[-1] != ']') {
+        tail--;
+    }
+    if (*tail == '\0') {
+        globs->disabled = true;
+        return;
+    }
+    g_ptr_array_add(globs->suffixes, g_strdup(tail));
+}
+
+// Reads the globs of the shared MIME database, which GIO uses to guess types by name
+static void
+file_type_globs_init(FileTypeGlobs *globs) {
+    globs->literals = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    globs->suffixes = g_ptr_array_new_with_free_func(g_free);
+
+    bool found = false;
+    const char *const *mime_dirs = g_content_type_get_mime_dirs();
+    for (uint32_t i = 0; mime_dirs && mime_dirs[i]; i++) {
+        g_autofree char *globs_path = g_build_filename(mime_dirs[i], "globs2", NULL);
+        g_autofree char *contents = NULL;
+        if (!g_file_get_contents(globs_path, &contents, NULL, NULL)) {
+            continue;
+        }
+        found = true;
+        g_auto(GStrv) lines = g_strsplit(contents, "\n", -1);
+        for (uint32_t j = 0; lines[j]; j++) {
+            // weight:type:glob[:flags]
+            if (lines[j][0] == '#' || lines[j][0] == '\0') {
+                continue;
+            }
+            g_auto(GStrv) fields = g_strsplit(lines[j], ":", 4);
+            if (g_strv_length(fields) >= 3 && fields[2][0] != '\0') {
+                file_type_globs_add(globs, fields[2]);
+            }
+        }
+    }
+    if (!found) {
+        // Not using the shared MIME database (e.g. on macOS), so every name has to be guessed
+        globs->disabled = true;
+    }
+}
+
+// Returns whether a glob might match more of `name` than the suffix from its first dot on
+static bool
+file_type_globs_match_stem(const FileTypeGlobs *globs, const char *name) {
+    const size_t name_len = strlen(name);
+    if (name_len <= globs->max_literal_len) {
+        char lower_name[FILE_TYPE_MAX_NAME_LEN + 1];
+        for (size_t i = 0; i <= name_len; i++) {
+            lower_name[i] = g_ascii_tolower(name[i]);
+        }
+        if (g_hash_table_contains(globs->literals, lower_name)) {
+            return true;
+        }
+    }
+
+    GPtrArray *prefixes = globs->prefixes[(uint8_t)g_ascii_tolower(name[0])];
+    for (uint32_t i = 0; prefixes && i < prefixes->len; i++) {
+        const char *prefix = g_ptr_array_index(prefixes, i);
+        if (g_ascii_strncasecmp(name, prefix, strlen(prefix)) == 0) {
+            return true;
+        }
+    }
+
+    for (uint32_t i = 0; i < globs->suffixes->len; i++) {
+        const char *glob_suffix = g_ptr_array_index(globs->suffixes, i);
+        const size_t glob_suffix_len = strlen(glob_suffix);
+        if (name_len >= glob_suffix_len && g_ascii_strcasecmp(name + name_len - glob_suffix_len, glob_suffix) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static uint16_t
+file_type_get_id_for_description_locked(const char *description) {
+    gpointer id = NULL;
+    if (g_hash_table_lookup_extended(file_type_ids_by_description, description, NULL, &id)) {
+        return GPOINTER_TO_UINT(id);
+    }
+    if (file_type_num_ids >= FSEARCH_DATABASE_FILE_TYPE_ID_MAX) {
+        // Not going to happen with the shared MIME database, but don't hand out invalid ids if it does
+        g_warning("[file_type] too many file types, treating \"%s\" as unknown", description);
+        return file_type_unknown_id;
+    }
+
+    char *description_copy = g_strdup(description);
+    const uint16_t new_id = ++file_type_num_ids;
+    g_hash_table_insert(file_type_ids_by_description, description_copy, GUINT_TO_POINTER(new_id));
+    g_atomic_pointer_set(&file_type_descriptions[new_id], description_copy);
+    return new_id;
+}
+
+static void
+file_type_init(void) {
+    static gsize initialized = 0;
+    if (g_once_init_enter(&initialized)) {
+        g_mutex_lock(&file_type_lock);
+        // The descriptions are owned by `file_type_descriptions`, which lives as long as the process
+        file_type_ids_by_description = g_hash_table_new(g_str_hash, g_str_equal);
+        g_autofree char *folder_description = fsearch_file_utils_get_file_type_non_localized(NULL, TRUE);
+        file_type_folder_id = file_type_get_id_for_description_locked(folder_description);
+        // get_file_type_non_localized() falls back to this description when a type can't be guessed
+        file_type_unknown_id = file_type_get_id_for_description_locked("Unknown Type");
+        g_mutex_unlock(&file_type_lock);
+        file_type_globs_init(&file_type_globs);
+        g_once_init_leave(&initialized, 1);
+    }
+}
+
+uint16_t
+fsearch_database_file_type_get_id(const char *name, bool is_folder) {
+    file_type_init();
+    if (is_folder) {
+        return file_type_folder_id;
+    }
+
+    // Names without a dot after their first character are cached as a whole
+    const char *suffix = name[0] != '\0' ? strchr(name + 1, '.') : NULL;
+    if (!suffix) {
+        suffix = name;
+    }
+    GHashTable *cache = NULL;
+    if (!file_type_globs.disabled && (suffix == name || !file_type_globs_match_stem(&file_type_globs, name))) {
+        cache = g_private_get(&file_type_cache);
+        if (G_UNLIKELY(!cache)) {
+            cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+            g_private_set(&file_type_cache, cache);
+        }
+        const uint32_t cached_id = GPOINTER_TO_UINT(g_hash_table_lookup(cache, suffix));
+        if (cached_id != 0) {
+            return cached_id - 1;
+        }
+    }
+
+    // Guessing the type takes most of the time, so it's done before taking the lock
+    g_autofree char *description = fsearch_file_utils_get_file_type_non_localized(name, FALSE);
+    const uint16_t id = fsearch_database_file_type_get_id_for_description(description);
+    if (cache) {
+        if (g_hash_table_size(cache) >= FILE_TYPE_CACHE_MAX_SIZE) {
+            g_hash_table_remove_all(cache);
+        }
+        g_hash_table_insert(cache, g_strdup(suffix), GUINT_TO_POINTER((uint32_t)id + 1));
+    }
+    return id;
+}
+
+uint16_t
+fsearch_database_file_type_get_id_for_description(const char *description) {
+    g_return_val_if_fail(description, FSEARCH_DATABASE_FILE_TYPE_ID_NONE);
+    file_type_init();
+
+    g_mutex_lock(&file_type_lock);
+    const uint16_t id = file_type_get_id_for_description_locked(description);
+    g_mutex_unlock(&file_type_lock);
+    return id;
+}
+
+const char *
+fsearch_database_file_type_get_description(uint16_t id) {
+    const char *description = g_atomic_pointer_get(&file_type_descriptions[id]);
+    return description ? description : "";
+}
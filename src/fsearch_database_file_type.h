@@ -0,0 +1,27 @@
+#pragma once
+
+#include <glib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// File types are identified by small ids, so entries can store their type and sorts only have to compare the (much
+// fewer) type descriptions of distinct ids. The registry is shared by all databases and is safe to use from any thread.
+
+// 0 is never a valid id, it marks entries without a type
+#define FSEARCH_DATABASE_FILE_TYPE_ID_NONE 0
+#define FSEARCH_DATABASE_FILE_TYPE_ID_MAX UINT16_MAX
+
+// Returns the id of the type of a file called `name`, or of a folder if `is_folder` is set. The type is guessed from
+// the whole name, like fsearch_file_utils_get_file_type_non_localized() does, but only once per thread and suffix for
+// names whose type can't depend on more than their suffix. Entries with the same id have the same type description and
+// vice versa.
+uint16_t
+fsearch_database_file_type_get_id(const char *name, bool is_folder);
+
+// Returns the id of the type `description`, e.g. of a type which was stored in a database file
+uint16_t
+fsearch_database_file_type_get_id_for_description(const char *description);
+
+// Returns the non-localized description of the type `id`, e.g. "Folder" or "PNG image"
+const char *
+fsearch_database_file_type_get_description(uint16_t id);
@@ -21,6 +21,7 @@
 #include <glib-object.h>
 #include <glib-unix.h>
 #include <glib.h>
+#include <glib/gstdio.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -50,6 +51,15 @@ struct _FsearchDatabaseIndex {
     gpointer event_func_data;
 
     bool needs_root_reappear_poll;
+    // Where scans record their progress, so they can be resumed. NULL if they don't.
+    char *checkpoint_path;
+    // The content is only a placeholder, see fsearch_database_index_mark_unscanned()
+    volatile gint unscanned;
+
+    // Bumped with every change of the content, compared against the generation which was last saved to find out
+    // whether the index needs to be written again
+    volatile gint generation;
+    volatile gint saved_generation;
 
     volatile gint monitor;
     volatile gint initialized;
@@ -97,6 +107,7 @@ propagate_event(FsearchDatabaseIndex *self,
                 DynamicArray *files,
                 FsearchDatabaseIndexPropertyFlags affected_sort_orders,
                 bool marked) {
+    g_atomic_int_inc(&self->generation);
     if (!self->event_func) {
         return;
     }
@@ -109,6 +120,21 @@ propagate_event(FsearchDatabaseIndex *self,
     self->event_func(self, event, self->event_func_data);
 }
 
+static void
+propagate_path_changed(FsearchDatabaseIndex *self, const char *path) {
+    if (!self->event_func) {
+        return;
+    }
+    g_autoptr(FsearchDatabaseIndexEvent) event = fsearch_database_index_event_new(
+        FSEARCH_DATABASE_INDEX_EVENT_PATH_CHANGED,
+        NULL,
+        NULL,
+        path,
+        DATABASE_INDEX_PROPERTY_FLAG_NONE,
+        false);
+    self->event_func(self, event, self->event_func_data);
+}
+
 // region Index Store Worker Functions
 
 static void
@@ -160,8 +186,11 @@ get_skippable_events(GPtrArray *events, GPtrArray *folder_delete_events) {
 }
 
 static inline FsearchDatabaseEntry *
-create_dummy_entry(const char *name, FsearchDatabaseEntry *parent, FsearchDatabaseEntryType type) {
-    return db_entry_new_with_attributes(DATABASE_INDEX_PROPERTY_FLAG_DEFAULT,
+create_dummy_entry(FsearchDatabaseIndexPropertyFlags flags,
+                   const char *name,
+                   FsearchDatabaseEntry *parent,
+                   FsearchDatabaseEntryType type) {
+    return db_entry_new_with_attributes(flags,
                                         name,
                                         parent,
                                         type,
@@ -222,7 +251,11 @@ process_queued_events(FsearchDatabaseIndex *self) {
             fsearch_folder_monitor_event_free(event);
             continue;
         }
-        fsearch_folder_monitor_event_set_watched_entry(event, watched_entry);
+        if (!fsearch_folder_monitor_event_set_watched_entry(event, watched_entry)) {
+            g_warning("[index] out of memory, dropping event");
+            fsearch_folder_monitor_event_free(event);
+            continue;
+        }
         g_ptr_array_add(events, event);
         if (event->is_dir && (is_delete_event(event->event_kind) || is_special_delete_event(event->event_kind))) {
             g_ptr_array_add(folder_delete_events, event);
@@ -247,6 +280,7 @@ process_queued_events(FsearchDatabaseIndex *self) {
         processed_count++;
 
         process_event(self, event, &stats);
+        propagate_path_changed(self, event->path->str);
     }
 
     const double process_time = g_timer_elapsed(timer, NULL);
@@ -291,10 +325,15 @@ lookup_entry_for_event_locked(FsearchDatabaseIndex *self, FsearchFolderMonitorEv
     // It has the same name and parent (i.e. the watched directory)
     // and hence the same path. This means it will compare in the same way as the entry we're looking
     // for when it gets passed to the `db_entry_compare_entries_by_full_path` function.
-    FsearchDatabaseEntry *entry_tmp = create_dummy_entry(event->name ? event->name->str : event->path->str,
+    FsearchDatabaseEntry *entry_tmp = create_dummy_entry(self->flags,
+                                                         event->name ? event->name->str : event->path->str,
                                                          event->name ? event->watched_entry : NULL,
                                                          event->is_dir ? DATABASE_ENTRY_TYPE_FOLDER
                                                                        : DATABASE_ENTRY_TYPE_FILE);
+    if (!entry_tmp) {
+        g_warning("[index] out of memory, failed to look up %s", event->path->str);
+        return NULL;
+    }
 
     FsearchDatabaseChunkedArray *chunks = event->is_dir ? self->folder_chunks : self->file_chunks;
 
@@ -361,22 +400,25 @@ index_clear_locked(FsearchDatabaseIndex *self, FsearchDatabaseIndexEventStats *s
     g_autoptr(DynamicArray) files = fsearch_database_chunked_array_get_joined(self->file_chunks);
     propagate_event(self, FSEARCH_DATABASE_INDEX_EVENT_ENTRY_DELETED, folders, files, DATABASE_INDEX_PROPERTY_FLAG_ALL, false);
 
+    // Indices with content from the database file don't have monitors or an event queue
+    if (self->event_queue) {
 #ifdef HAVE_FANOTIFY
-    fsearch_folder_monitor_fanotify_free(self->fanotify_monitor);
-    self->fanotify_monitor = fsearch_folder_monitor_fanotify_new(self->monitor_ctx, self->event_queue);
+        fsearch_folder_monitor_fanotify_free(self->fanotify_monitor);
+        self->fanotify_monitor = fsearch_folder_monitor_fanotify_new(self->monitor_ctx, self->event_queue);
 #endif
 #ifdef HAVE_INOTIFY
-    fsearch_folder_monitor_inotify_free(self->inotify_monitor);
-    self->inotify_monitor = fsearch_folder_monitor_inotify_new(self->monitor_ctx, self->event_queue);
+        fsearch_folder_monitor_inotify_free(self->inotify_monitor);
+        self->inotify_monitor = fsearch_folder_monitor_inotify_new(self->monitor_ctx, self->event_queue);
 #endif
 
-    // Clear the event queue
-    while (true) {
-        FsearchFolderMonitorEvent *event = g_async_queue_try_pop(self->event_queue);
-        if (!event) {
-            break;
+        // Clear the event queue
+        while (true) {
+            FsearchFolderMonitorEvent *event = g_async_queue_try_pop(self->event_queue);
+            if (!event) {
+                break;
+            }
+            g_clear_pointer(&event, fsearch_folder_monitor_event_free);
         }
-        g_clear_pointer(&event, fsearch_folder_monitor_event_free);
     }
 
     fsearch_database_index_start_monitoring(self, true);
@@ -588,6 +630,7 @@ process_create_event(FsearchDatabaseIndex *self, FsearchFolderMonitorEvent *even
                            fsearch_database_include_get_one_file_system(self->include),
                            NULL,
                            NULL,
+                           NULL,
                            NULL)) {
             fsearch_database_chunked_array_insert_array(self->folder_chunks, folders);
             fsearch_database_chunked_array_insert_array(self->file_chunks, files);
@@ -603,10 +646,15 @@ process_create_event(FsearchDatabaseIndex *self, FsearchFolderMonitorEvent *even
                                                                    DATABASE_INDEX_PROPERTY_MODIFICATION_TIME,
                                                                    mtime,
                                                                    DATABASE_INDEX_PROPERTY_NONE);
-        fsearch_database_chunked_array_insert(self->file_chunks, entry);
+        if (entry) {
+            fsearch_database_chunked_array_insert(self->file_chunks, entry);
 
-        files = darray_new(1);
-        darray_add_item(files, entry);
+            files = darray_new(1);
+            darray_add_item(files, entry);
+        }
+        else {
+            g_warning("[index] out of memory, failed to add %s", event->path->str);
+        }
     }
 
     stats_add(stats ? &stats->folders_created : NULL, folders ? darray_get_num_items(folders) : 0);
@@ -803,12 +851,26 @@ fsearch_database_index_has_pending_events(FsearchDatabaseIndex *self) {
     return g_async_queue_length(self->event_queue) > 0;
 }
 
+uint32_t
+fsearch_database_index_get_num_pending_events(FsearchDatabaseIndex *self) {
+    g_return_val_if_fail(self, 0);
+
+    if (g_atomic_int_get(&self->monitor) == 0 || g_atomic_int_get(&self->initialized) == 0) {
+        return 0;
+    }
+
+    return (uint32_t)MAX(g_async_queue_length(self->event_queue), 0);
+}
+
 static FsearchDatabaseEntry *
-create_dummy_entry_chain(const char *root_path, const char *target_path, FsearchDatabaseEntryType target_type) {
+create_dummy_entry_chain(FsearchDatabaseIndexPropertyFlags flags,
+                         const char *root_path,
+                         const char *target_path,
+                         FsearchDatabaseEntryType target_type) {
     if (g_strcmp0(root_path, target_path) == 0) {
         // target is the root itself
         return target_type == DATABASE_ENTRY_TYPE_FOLDER
-                 ? create_dummy_entry(root_path, NULL, DATABASE_ENTRY_TYPE_FOLDER)
+                 ? create_dummy_entry(flags, root_path, NULL, DATABASE_ENTRY_TYPE_FOLDER)
                  : NULL;
     }
 
@@ -825,7 +887,10 @@ create_dummy_entry_chain(const char *root_path, const char *target_path, Fsearch
         return NULL; // target_path is not a child of root_path
     }
 
-    FsearchDatabaseEntry *current = create_dummy_entry(root_path, NULL, DATABASE_ENTRY_TYPE_FOLDER);
+    FsearchDatabaseEntry *current = create_dummy_entry(flags, root_path, NULL, DATABASE_ENTRY_TYPE_FOLDER);
+    if (!current) {
+        return NULL;
+    }
 
     g_auto(GStrv) parts = g_strsplit(rel_path, G_DIR_SEPARATOR_S, -1);
 
@@ -833,13 +898,49 @@ create_dummy_entry_chain(const char *root_path, const char *target_path, Fsearch
         // The last part takes the requested type (FILE or FOLDER), everything in between is a FOLDER
         FsearchDatabaseEntryType type = (parts[i + 1] == NULL) ? target_type : DATABASE_ENTRY_TYPE_FOLDER;
 
-        FsearchDatabaseEntry *child = create_dummy_entry(parts[i], current, type);
+        FsearchDatabaseEntry *child = create_dummy_entry(flags, parts[i], current, type);
+        if (!child) {
+            g_clear_pointer(&current, db_entry_free_full);
+            return NULL;
+        }
         current = child;
     }
 
     return current;
 }
 
+static bool
+index_remove_path_locked(FsearchDatabaseIndex *self, const char *root_path, const char *path) {
+    // Try finding it as a file first using a dummy entry
+    FsearchDatabaseEntry *dummy_file = create_dummy_entry_chain(self->flags, root_path, path, DATABASE_ENTRY_TYPE_FILE);
+    if (dummy_file) {
+        FsearchDatabaseEntry *entry = fsearch_database_chunked_array_steal(self->file_chunks, dummy_file);
+        g_clear_pointer(&dummy_file, db_entry_free_full);
+
+        if (entry) {
+            remove_and_free_file_entry_locked(self, g_steal_pointer(&entry), NULL);
+            return true;
+        }
+    }
+
+    // If not a file, try finding it as a folder
+    FsearchDatabaseEntry *dummy_folder = create_dummy_entry_chain(self->flags,
+                                                                  root_path,
+                                                                  path,
+                                                                  DATABASE_ENTRY_TYPE_FOLDER);
+    if (dummy_folder) {
+        FsearchDatabaseEntry *entry = fsearch_database_chunked_array_steal(self->folder_chunks, dummy_folder);
+        g_clear_pointer(&dummy_folder, db_entry_free_full);
+
+        if (entry) {
+            remove_and_free_folder_entry_locked(self, g_steal_pointer(&entry), NULL);
+            return true;
+        }
+    }
+
+    return false;
+}
+
 bool
 fsearch_database_index_remove_path(FsearchDatabaseIndex *self, const char *path, bool *root_removed) {
     g_return_val_if_fail(self, false);
@@ -858,31 +959,66 @@ fsearch_database_index_remove_path(FsearchDatabaseIndex *self, const char *path,
         return true;
     }
 
-    // Try finding it as a file first using a dummy entry
-    FsearchDatabaseEntry *dummy_file = create_dummy_entry_chain(root_path, path, DATABASE_ENTRY_TYPE_FILE);
-    if (dummy_file) {
-        FsearchDatabaseEntry *entry = fsearch_database_chunked_array_steal(self->file_chunks, dummy_file);
-        g_clear_pointer(&dummy_file, db_entry_free_full);
+    return index_remove_path_locked(self, root_path, path);
+}
 
-        if (entry) {
-            remove_and_free_file_entry_locked(self, g_steal_pointer(&entry), NULL);
-            return true;
+bool
+fsearch_database_index_refresh_path(FsearchDatabaseIndex *self, const char *path, bool *root_removed) {
+    g_return_val_if_fail(self, false);
+    g_return_val_if_fail(path, false);
+    g_return_val_if_fail(root_removed, false);
+
+    g_autoptr(GMutexLocker) locker = g_mutex_locker_new(&self->mutex);
+
+    if (!self->folder_chunks || !self->file_chunks) {
+        // Index was cleared, e.g. because its root is offline
+        return false;
+    }
+
+    const char *root_path = fsearch_database_include_get_path(self->include);
+    if (g_strcmp0(path, root_path) == 0) {
+        if (g_file_test(root_path, G_FILE_TEST_IS_DIR)) {
+            // Only the root's own attributes changed, its content is refreshed through the records of its children
+            return false;
         }
+        g_debug("[index-%s] refresh_path: root folder is gone: %s", fsearch_database_index_get_path(self), root_path);
+        index_clear_locked(self, NULL);
+        self->needs_root_reappear_poll = true;
+        *root_removed = true;
+        return true;
     }
 
-    // If not a file, try finding it as a folder
-    FsearchDatabaseEntry *dummy_folder = create_dummy_entry_chain(root_path, path, DATABASE_ENTRY_TYPE_FOLDER);
-    if (dummy_folder) {
-        FsearchDatabaseEntry *entry = fsearch_database_chunked_array_steal(self->folder_chunks, dummy_folder);
-        g_clear_pointer(&dummy_folder, db_entry_free_full);
+    bool changed = index_remove_path_locked(self, root_path, path);
 
-        if (entry) {
-            remove_and_free_folder_entry_locked(self, g_steal_pointer(&entry), NULL);
-            return true;
-        }
+    // Add it back with its current state, like a monitor create event for it would
+    g_autofree char *parent_path = g_path_get_dirname(path);
+    FsearchDatabaseEntry *dummy_parent = create_dummy_entry_chain(self->flags,
+                                                                  root_path,
+                                                                  parent_path,
+                                                                  DATABASE_ENTRY_TYPE_FOLDER);
+    if (!dummy_parent) {
+        return changed;
+    }
+    FsearchDatabaseEntry *parent = fsearch_database_chunked_array_find(self->folder_chunks, dummy_parent);
+    g_clear_pointer(&dummy_parent, db_entry_free_full);
+    if (!parent) {
+        // Its parent folder doesn't exist (anymore), the path will be refreshed as part of the parent's record
+        return changed;
     }
 
-    return false;
+    g_autofree char *name = g_path_get_basename(path);
+    g_autoptr(GString) event_name = g_string_new(name);
+    g_autoptr(GString) event_path = g_string_new(path);
+    FsearchFolderMonitorEvent event = {
+        .name = event_name,
+        .path = event_path,
+        .watched_entry = parent,
+        .event_kind = FSEARCH_FOLDER_MONITOR_EVENT_CREATE,
+    };
+    FsearchDatabaseIndexEventStats stats = {};
+    process_create_event(self, &event, &stats);
+
+    return changed || stats.files_created > 0 || stats.folders_created > 0;
 }
 
 // endregion
@@ -904,6 +1040,7 @@ index_free(FsearchDatabaseIndex *self) {
 
     g_clear_pointer(&self->include, fsearch_database_include_unref);
     g_clear_object(&self->exclude_manager);
+    g_clear_pointer(&self->checkpoint_path, g_free);
 
     g_clear_pointer(&self->event_queue, g_async_queue_unref);
 
@@ -933,6 +1070,10 @@ fsearch_database_index_new(FsearchDatabaseInclude *include,
 
     self->needs_root_reappear_poll = false;
 
+    // A new index was never saved
+    self->generation = 1;
+    self->saved_generation = 0;
+
     self->event_queue = g_async_queue_new_full((GDestroyNotify)fsearch_folder_monitor_event_free);
 
     self->event_func = event_func;
@@ -970,6 +1111,10 @@ fsearch_database_index_new_with_content(FsearchDatabaseInclude *include,
     self->flags = flags;
     self->needs_root_reappear_poll = false;
 
+    // The content was loaded from the database file, so it's already saved
+    self->generation = 1;
+    self->saved_generation = 1;
+
     self->folder_chunks = fsearch_database_chunked_array_new(folders,
                                                              TRUE,
                                                              fsearch_database_sort_order_chain_for_property(
@@ -1063,6 +1208,74 @@ fsearch_database_index_wants_root_reappear_poll(FsearchDatabaseIndex *self) {
     return self->needs_root_reappear_poll;
 }
 
+void
+fsearch_database_index_request_root_reappear_poll(FsearchDatabaseIndex *self) {
+    g_return_if_fail(self);
+
+    g_autoptr(GMutexLocker) locker = g_mutex_locker_new(&self->mutex);
+    g_assert_nonnull(locker);
+    self->needs_root_reappear_poll = true;
+}
+
+int32_t
+fsearch_database_index_get_generation(FsearchDatabaseIndex *self) {
+    g_return_val_if_fail(self, 0);
+    return g_atomic_int_get(&self->generation);
+}
+
+void
+fsearch_database_index_mark_saved(FsearchDatabaseIndex *self, int32_t generation) {
+    g_return_if_fail(self);
+    g_atomic_int_set(&self->saved_generation, generation);
+}
+
+bool
+fsearch_database_index_is_dirty(FsearchDatabaseIndex *self) {
+    g_return_val_if_fail(self, false);
+    return g_atomic_int_get(&self->generation) != g_atomic_int_get(&self->saved_generation);
+}
+
+void
+fsearch_database_index_mark_dirty(FsearchDatabaseIndex *self) {
+    g_return_if_fail(self);
+    g_atomic_int_inc(&self->generation);
+}
+
+void
+fsearch_database_index_mark_unscanned(FsearchDatabaseIndex *self) {
+    g_return_if_fail(self);
+    g_atomic_int_set(&self->unscanned, 1);
+}
+
+bool
+fsearch_database_index_is_unscanned(FsearchDatabaseIndex *self) {
+    g_return_val_if_fail(self, false);
+    return g_atomic_int_get(&self->unscanned) != 0;
+}
+
+void
+fsearch_database_index_set_checkpoint_path(FsearchDatabaseIndex *self, const char *checkpoint_path) {
+    g_return_if_fail(self);
+
+    g_autoptr(GMutexLocker) locker = g_mutex_locker_new(&self->mutex);
+    g_assert_nonnull(locker);
+
+    g_free(self->checkpoint_path);
+    self->checkpoint_path = g_strdup(checkpoint_path);
+}
+
+void
+fsearch_database_index_remove_checkpoint(FsearchDatabaseIndex *self) {
+    g_return_if_fail(self);
+
+    g_autoptr(GMutexLocker) locker = g_mutex_locker_new(&self->mutex);
+    g_assert_nonnull(locker);
+
+    if (self->checkpoint_path) {
+        g_remove(self->checkpoint_path);
+    }
+}
+
 bool
 fsearch_database_index_get_one_file_system(FsearchDatabaseIndex *self) {
     g_assert(self);
@@ -1112,17 +1325,31 @@ fsearch_database_index_scan(FsearchDatabaseIndex *self, GCancellable *cancellabl
     g_autoptr(DynamicArray) folders = darray_new(4096);
 
     self->needs_root_reappear_poll = false;
+    g_atomic_int_set(&self->unscanned, 0);
+    g_atomic_int_inc(&self->generation);
 
     g_autoptr(GTimer) scan_timer = g_timer_new();
 
-    if (!db_scan_folder(fsearch_database_include_get_path(self->include),
+    const char *include_path = fsearch_database_include_get_path(self->include);
+    const bool one_file_system = fsearch_database_include_get_one_file_system(self->include);
+
+    g_autoptr(FsearchDatabaseScanCheckpoint) checkpoint = NULL;
+    if (self->checkpoint_path) {
+        checkpoint = fsearch_database_scan_checkpoint_open(self->checkpoint_path,
+                                                           include_path,
+                                                           self->exclude_manager,
+                                                           one_file_system);
+    }
+
+    if (!db_scan_folder(include_path,
                         NULL,
                         folders,
                         files,
                         self->exclude_manager,
                         self->fanotify_monitor,
                         self->inotify_monitor,
-                        fsearch_database_include_get_one_file_system(self->include),
+                        one_file_system,
+                        checkpoint,
                         cancellable,
                         scan_status_cb,
                         self)) {
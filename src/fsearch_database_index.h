@@ -71,12 +71,49 @@ fsearch_database_index_get_path(FsearchDatabaseIndex *self);
 bool
 fsearch_database_index_wants_root_reappear_poll(FsearchDatabaseIndex *self);
 
+// Marks the root of the index as missing, so it gets scanned again once it reappears
+void
+fsearch_database_index_request_root_reappear_poll(FsearchDatabaseIndex *self);
+
+// Returns a counter which changes with every change of the content of the index
+int32_t
+fsearch_database_index_get_generation(FsearchDatabaseIndex *self);
+
+// Records that the content of `generation` was written to disk
+void
+fsearch_database_index_mark_saved(FsearchDatabaseIndex *self, int32_t generation);
+
+// Whether the index changed since it was last saved, or was never saved at all
+bool
+fsearch_database_index_is_dirty(FsearchDatabaseIndex *self);
+
+// Forces the index to be written again by the next save, e.g. because its saved copy is outdated
+void
+fsearch_database_index_mark_dirty(FsearchDatabaseIndex *self);
+
+// Marks the content of the index as a placeholder until it gets scanned. Such an index isn't saved, so it's scanned
+// again after the next load if the scan doesn't finish before.
+void
+fsearch_database_index_mark_unscanned(FsearchDatabaseIndex *self);
+
+bool
+fsearch_database_index_is_unscanned(FsearchDatabaseIndex *self);
+
 void
 fsearch_database_index_lock(FsearchDatabaseIndex *self);
 
 void
 fsearch_database_index_unlock(FsearchDatabaseIndex *self);
 
+// Sets where scans of the index record their progress. A scan which is cancelled or interrupted leaves it behind and
+// the next scan resumes from it.
+void
+fsearch_database_index_set_checkpoint_path(FsearchDatabaseIndex *self, const char *checkpoint_path);
+
+// Removes the checkpoint once the scanned content is in use, later scans start over
+void
+fsearch_database_index_remove_checkpoint(FsearchDatabaseIndex *self);
+
 bool
 fsearch_database_index_scan(FsearchDatabaseIndex *self, GCancellable *cancellable);
 
@@ -89,7 +126,15 @@ fsearch_database_index_process_events(FsearchDatabaseIndex *self);
 bool
 fsearch_database_index_has_pending_events(FsearchDatabaseIndex *self);
 
+// Returns the number of file system events which are queued for fsearch_database_index_process_events()
+uint32_t
+fsearch_database_index_get_num_pending_events(FsearchDatabaseIndex *self);
+
 bool
 fsearch_database_index_remove_path(FsearchDatabaseIndex *self, const char *path, bool *root_removed);
 
+// Replaces the entry for `path` (and its descendants) with what is on disk now. Used to replay the database journal.
+bool
+fsearch_database_index_refresh_path(FsearchDatabaseIndex *self, const char *path, bool *root_removed);
+
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(FsearchDatabaseIndex, fsearch_database_index_unref)
\ No newline at end of file
@@ -26,6 +26,7 @@ fsearch_database_index_event_new(FsearchDatabaseIndexEventKind kind,
         event->entries.marked = marked;
         break;
     case FSEARCH_DATABASE_INDEX_EVENT_SCANNING:
+    case FSEARCH_DATABASE_INDEX_EVENT_PATH_CHANGED:
         event->path = path ? g_strdup(path) : NULL;
         break;
     case NUM_FSEARCH_DATABASE_INDEX_EVENTS:
@@ -51,6 +52,7 @@ fsearch_database_index_event_free(FsearchDatabaseIndexEvent *event) {
 
         break;
     case FSEARCH_DATABASE_INDEX_EVENT_SCANNING:
+    case FSEARCH_DATABASE_INDEX_EVENT_PATH_CHANGED:
         g_clear_pointer(&event->path, free);
         break;
     case NUM_FSEARCH_DATABASE_INDEX_EVENTS:
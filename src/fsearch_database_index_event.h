@@ -11,6 +11,8 @@ typedef enum {
     FSEARCH_DATABASE_INDEX_EVENT_ENTRY_CREATED,
     FSEARCH_DATABASE_INDEX_EVENT_ENTRY_DELETED,
     FSEARCH_DATABASE_INDEX_EVENT_SCANNING,
+    // A file system event changed `path`, emitted once the index was updated
+    FSEARCH_DATABASE_INDEX_EVENT_PATH_CHANGED,
     NUM_FSEARCH_DATABASE_INDEX_EVENTS,
 } FsearchDatabaseIndexEventKind;
 
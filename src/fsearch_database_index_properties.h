@@ -104,8 +104,8 @@ fsearch_database_index_property_to_string(FsearchDatabaseIndexProperty property)
     return "unknown";
 }
 
-static inline bool
-fsearch_database_index_property_is_set(FsearchDatabaseIndexPropertyFlags flags, FsearchDatabaseIndexProperty property) {
+static inline FsearchDatabaseIndexPropertyFlags
+fsearch_database_index_property_to_flag(FsearchDatabaseIndexProperty property) {
     static const FsearchDatabaseIndexPropertyFlags prop_to_flag[NUM_DATABASE_INDEX_PROPERTIES] = {
         [DATABASE_INDEX_PROPERTY_NAME] = DATABASE_INDEX_PROPERTY_FLAG_NAME,
         [DATABASE_INDEX_PROPERTY_PATH] = DATABASE_INDEX_PROPERTY_FLAG_PATH,
@@ -121,10 +121,14 @@ fsearch_database_index_property_is_set(FsearchDatabaseIndexPropertyFlags flags,
     };
 
     if (G_UNLIKELY(property <= DATABASE_INDEX_PROPERTY_NONE || property >= NUM_DATABASE_INDEX_PROPERTIES)) {
-        return false;
+        return DATABASE_INDEX_PROPERTY_FLAG_NONE;
     }
+    return prop_to_flag[property];
+}
 
-    const FsearchDatabaseIndexPropertyFlags target_flag = prop_to_flag[property];
+static inline bool
+fsearch_database_index_property_is_set(FsearchDatabaseIndexPropertyFlags flags, FsearchDatabaseIndexProperty property) {
+    const FsearchDatabaseIndexPropertyFlags target_flag = fsearch_database_index_property_to_flag(property);
 
     return (target_flag != 0) && ((flags & target_flag) != 0);
 }
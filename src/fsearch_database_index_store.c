@@ -12,6 +12,7 @@
 #include "fsearch_database_index.h"
 #include "fsearch_database_index_event.h"
 #include "fsearch_database_index_properties.h"
+#include "fsearch_database_scan_checkpoint.h"
 #include "fsearch_database_search_info.h"
 #include "fsearch_database_search_view.h"
 #include "fsearch_database_sort.h"
@@ -27,8 +28,34 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
 #define THRESHOLD_FOR_PARALLEL_SEARCH 1000
+// Manual sorts of fewer results are fast enough that a preview of the first rows isn't worth it
+#define THRESHOLD_FOR_SORT_PREVIEW 100000
+// When at least this many file system events are processed at once, the updates of the sort indices and search
+// views are collected and applied as a single batch afterwards. A batch scans every sort index once (about 11 ns per
+// entry and sort index), while an event applied right away costs about 75 us (one round trip through the worker pool
+// and a binary search insert/removal per sort index). So batching only pays off once there's about one event per 512
+// entries: on an index with 4M entries, 64 events take 6 ms one by one, but 1.2 s as a batch.
+#define THRESHOLD_FOR_BATCH_UPDATES 64
+#define NUM_ENTRIES_PER_BATCHED_UPDATE 512
+
+// The fast sort indices, in the order they're built when they're built lazily
+static const FsearchDatabaseIndexProperty index_store_sort_orders[] = {
+    DATABASE_INDEX_PROPERTY_NAME,
+    DATABASE_INDEX_PROPERTY_PATH,
+    DATABASE_INDEX_PROPERTY_SIZE,
+    DATABASE_INDEX_PROPERTY_MODIFICATION_TIME,
+    DATABASE_INDEX_PROPERTY_EXTENSION,
+    DATABASE_INDEX_PROPERTY_FILETYPE,
+};
+
+// Search context of a worker_pool thread. It's created on the first search job a thread runs and reused by the
+// following ones, so searches don't have to set up the UTF and string buffers of a fresh FsearchQueryMatchData every
+// time. The destroy notify frees it when the thread exits. That isn't necessarily when the pool is freed: GLib may
+// keep idle pool threads around for other thread pools, and those keep their search context until they exit.
+static GPrivate index_store_worker_match_data = G_PRIVATE_INIT((GDestroyNotify)fsearch_query_match_data_free);
 
 typedef struct {
     GThread *thread;
@@ -37,6 +64,23 @@ typedef struct {
     GSource *event_source;
 } FsearchDatabaseThreadContext;
 
+// Updates of the sort indices and search views which were collected while a batch of file system events got
+// processed. The tables map entries to the FsearchDatabaseIndexPropertyFlags of the sort orders they have to be
+// removed from or added to. Removals are applied first and only use the address of the entries, since they may
+// have been freed or changed their sort keys since then.
+typedef struct {
+    GHashTable *removed_files;
+    GHashTable *removed_folders;
+    GHashTable *added_files;
+    GHashTable *added_folders;
+} IndexStorePendingUpdates;
+
+// A path which was removed or refreshed while the entries of the indices were read, see `num_entry_readers`
+typedef struct {
+    char *path;
+    bool remove;
+} IndexStoreQueuedPathChange;
+
 struct FsearchDatabaseIndexStore {
     // Array of FsearchDatabaseIndex's
     GPtrArray *indices;
@@ -52,6 +96,9 @@ struct FsearchDatabaseIndexStore {
     FsearchDatabaseIncludeManager *include_manager;
     FsearchDatabaseExcludeManager *exclude_manager;
 
+    // Where the scans of the indices record their progress, see fsearch_database_index_set_checkpoint_path()
+    char *checkpoint_dir;
+
     GThreadPool *worker_pool;
     GAsyncQueue *worker_pool_collect_queue;
 
@@ -68,9 +115,40 @@ struct FsearchDatabaseIndexStore {
     FsearchDatabaseThreadContext worker;
     GSource *worker_index_root_reappear_poll_source;
 
+    // Set while a large batch of file system events gets processed, see THRESHOLD_FOR_BATCH_UPDATES
+    IndexStorePendingUpdates *pending_updates;
+
     bool is_sorted;
     bool running;
 
+    // When set, only the name index is built up front. The other fast sort indices are built later on the worker
+    // thread, in the background or as soon as they're requested, and can be dropped again to save memory.
+    bool lazy_sort_indices;
+    // Bit masks (1 << sort order) of the sort indices which were requested while missing (built first) and which
+    // were dropped (not rebuilt in the background). Guarded by `mutex`, like the source which builds them.
+    uint32_t requested_sort_indices;
+    uint32_t dropped_sort_indices;
+    // Bit mask of the sort indices which are still being loaded from the database file, see
+    // fsearch_database_index_store_add_sort_index(). The worker thread doesn't build them.
+    uint32_t deferred_sort_indices;
+    GSource *lazy_sort_index_source;
+    GCancellable *lazy_sort_index_cancellable;
+    // The changes of the sort indices since the store was created, as long as some of them are still being loaded.
+    // They're applied to the loaded ones, see fsearch_database_index_store_add_sort_index().
+    IndexStorePendingUpdates *deferred_sort_index_updates;
+
+    // Number of threads which read the entries of the indices without holding `mutex`, e.g. to build or load a sort
+    // index. They take turns and keep the indices locked until they're done, see
+    // index_store_begin_reading_entries_locked(). Meanwhile nobody may wait for an index lock while holding `mutex`,
+    // or searches would be stuck as well: file system events are processed on a later tick, and removed or refreshed
+    // paths are queued in `queued_path_changes` and applied once the reader is done.
+    uint32_t num_entry_readers;
+    // Number of threads which wait for the readers to finish, with `mutex` released. No new readers start meanwhile.
+    uint32_t num_entry_writers_waiting;
+    GCond entry_readers_cond;
+    // Array of IndexStoreQueuedPathChange
+    GArray *queued_path_changes;
+
     GMutex mutex;
 
     volatile gint ref_count;
@@ -82,6 +160,9 @@ typedef enum {
     INDEX_STORE_WORKER_POOL_DATA_TYPE_REMOVE_ENTRIES,
     INDEX_STORE_WORKER_POOL_DATA_TYPE_ADD_TO_RESULTS,
     INDEX_STORE_WORKER_POOL_DATA_TYPE_REMOVE_FROM_RESULTS,
+    INDEX_STORE_WORKER_POOL_DATA_TYPE_APPLY_UPDATES,
+    INDEX_STORE_WORKER_POOL_DATA_TYPE_APPLY_UPDATES_TO_RESULTS,
+    INDEX_STORE_WORKER_POOL_DATA_TYPE_BUILD_SORT_INDEX,
     NUM_INDEX_STORE_WORKER_POOL_DATA_TYPES,
 } IndexStoreWorkerPoolDataType;
 
@@ -92,10 +173,13 @@ typedef struct {
         struct {
             FsearchQuery *query;
             GCancellable *cancellable;
+            // The job searches `in_num_entries` entries of the id chunks in `in`, starting at `in_start_idx` of chunk
+            // `in_chunk_idx`
             DynamicArray *in;
             DynamicArray *out;
+            uint32_t in_chunk_idx;
             uint32_t in_start_idx;
-            uint32_t in_end_idx;
+            uint32_t in_num_entries;
             int32_t thread_id;
         } search;
 
@@ -112,6 +196,27 @@ typedef struct {
             FsearchDatabaseIndexPropertyFlags affected_sort_orders;
             bool marked;
         } update_results;
+
+        struct {
+            // Shared by all jobs, must not be modified
+            IndexStorePendingUpdates *updates;
+            // Sort index the updates get applied to, or the view if it's NULL
+            FsearchDatabaseChunkedArray *chunks;
+            FsearchDatabaseIndexProperty sort_order;
+            FsearchDatabaseEntryType entry_type;
+            FsearchDatabaseSearchView *view;
+        } apply_updates;
+
+        struct {
+            // Shared by all jobs, must not be modified
+            DynamicArray *entries;
+            bool entries_in_name_order;
+            FsearchDatabaseIndexProperty sort_order;
+            FsearchDatabaseEntryType entry_type;
+            int max_sort_threads;
+            GCancellable *cancellable;
+            FsearchDatabaseChunkedArray *result;
+        } build_sort_index;
     };
 } IndexStoreWorkerPoolData;
 
@@ -203,6 +308,19 @@ index_store_flags_equal(const FsearchDatabaseIndexStore *store, FsearchDatabaseI
     return (store_flags & flags) == store_flags;
 }
 
+// Whether `path` is `root_path` or lies below it
+static bool
+index_store_path_is_in_root(const char *path, const char *root_path) {
+    if (!g_str_has_prefix(path, root_path)) {
+        return false;
+    }
+    const size_t root_len = strlen(root_path);
+    if (root_len > 0 && root_path[root_len - 1] == G_DIR_SEPARATOR) {
+        return true;
+    }
+    return path[root_len] == G_DIR_SEPARATOR || path[root_len] == '\0';
+}
+
 static bool
 index_store_has_index_with_same_path(const FsearchDatabaseIndexStore *store,
                                      FsearchDatabaseIndex *index,
@@ -224,33 +342,69 @@ index_store_has_index_with_same_path(const FsearchDatabaseIndexStore *store,
     return false;
 }
 
+static FsearchQueryMatchData *
+index_store_worker_get_match_data(void) {
+    FsearchQueryMatchData *match_data = g_private_get(&index_store_worker_match_data);
+    if (G_UNLIKELY(!match_data)) {
+        match_data = fsearch_query_match_data_new(NULL, NULL);
+        g_private_set(&index_store_worker_match_data, match_data);
+    }
+    return match_data;
+}
+
 static void
 index_store_search_worker(FsearchQuery *query,
-                          DynamicArray *entries,
+                          DynamicArray *chunks,
                           DynamicArray *results,
                           int32_t thread_id,
+                          uint32_t chunk_idx,
                           uint32_t start_idx,
-                          uint32_t end_idx,
+                          uint32_t num_entries,
                           GCancellable *cancellable) {
-    g_assert(entries);
-    g_assert(start_idx <= end_idx);
-    g_assert(end_idx < darray_get_num_items(entries));
+    g_assert(chunks);
 
-    FsearchQueryMatchData *match_data = fsearch_query_match_data_new(NULL, NULL);
+    FsearchQueryMatchData *match_data = index_store_worker_get_match_data();
 
     fsearch_query_match_data_set_thread_id(match_data, thread_id);
 
-    for (uint32_t i = start_idx; i <= end_idx; i++) {
+    FsearchQueryProfile *profile = fsearch_query_get_profile(query);
+    const int64_t start_time = profile ? g_get_monotonic_time() : 0;
+    if (profile) {
+        fsearch_query_match_data_start_profiling(match_data, fsearch_query_profile_get_num_nodes(profile));
+    }
+
+    uint32_t num_searched = 0;
+    const uint32_t num_chunks = darray_get_num_items(chunks);
+    for (; chunk_idx < num_chunks && num_searched < num_entries; ++chunk_idx, start_idx = 0) {
         if (G_UNLIKELY(g_cancellable_is_cancelled(cancellable))) {
             break;
         }
-        FsearchDatabaseEntry *entry = darray_get_item(entries, i);
-        fsearch_query_match_data_set_entry(match_data, entry);
-        if (fsearch_query_match(query, match_data)) {
-            darray_add_item(results, entry);
+        DynamicIdArray *chunk = darray_get_item(chunks, chunk_idx);
+        const uint32_t end_idx = MIN(idarray_get_num_items(chunk), start_idx + (num_entries - num_searched));
+        for (uint32_t i = start_idx; i < end_idx; i++) {
+            FsearchDatabaseEntry *entry = idarray_get_item(chunk, i);
+            fsearch_query_match_data_set_entry(match_data, entry);
+            if (fsearch_query_match(query, match_data)) {
+                darray_add_item(results, entry);
+            }
         }
+        num_searched += end_idx - start_idx;
     }
-    g_clear_pointer(&match_data, fsearch_query_match_data_free);
+
+    if (profile) {
+        uint32_t num_node_profiles = 0;
+        FsearchQueryNodeProfile *node_profiles = fsearch_query_match_data_get_node_profiles(match_data,
+                                                                                            &num_node_profiles);
+        if (node_profiles) {
+            fsearch_query_profile_add_node_profiles(profile, node_profiles, num_node_profiles);
+        }
+        fsearch_query_profile_add_thread_profile(profile,
+                                                 thread_id,
+                                                 num_searched,
+                                                 darray_get_num_items(results),
+                                                 g_get_monotonic_time() - start_time);
+    }
+    fsearch_query_match_data_reset(match_data);
 }
 
 static void
@@ -287,6 +441,108 @@ index_store_remove_from_store_worker(FsearchDatabaseChunkedArray *chunks, Dynami
     }
 }
 
+static IndexStorePendingUpdates *
+index_store_pending_updates_new(void) {
+    IndexStorePendingUpdates *updates = g_new0(IndexStorePendingUpdates, 1);
+    updates->removed_files = g_hash_table_new(g_direct_hash, g_direct_equal);
+    updates->removed_folders = g_hash_table_new(g_direct_hash, g_direct_equal);
+    updates->added_files = g_hash_table_new(g_direct_hash, g_direct_equal);
+    updates->added_folders = g_hash_table_new(g_direct_hash, g_direct_equal);
+    return updates;
+}
+
+static void
+index_store_pending_updates_free(IndexStorePendingUpdates *updates) {
+    if (!updates) {
+        return;
+    }
+    g_clear_pointer(&updates->removed_files, g_hash_table_unref);
+    g_clear_pointer(&updates->removed_folders, g_hash_table_unref);
+    g_clear_pointer(&updates->added_files, g_hash_table_unref);
+    g_clear_pointer(&updates->added_folders, g_hash_table_unref);
+    g_clear_pointer(&updates, g_free);
+}
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(IndexStorePendingUpdates, index_store_pending_updates_free)
+
+static inline FsearchDatabaseIndexPropertyFlags
+index_store_pending_get_flags(GHashTable *table, FsearchDatabaseEntry *entry) {
+    return GPOINTER_TO_UINT(g_hash_table_lookup(table, entry));
+}
+
+static inline void
+index_store_pending_set_flags(GHashTable *table, FsearchDatabaseEntry *entry, FsearchDatabaseIndexPropertyFlags flags) {
+    if (flags) {
+        g_hash_table_insert(table, entry, GUINT_TO_POINTER(flags));
+    }
+    else {
+        g_hash_table_remove(table, entry);
+    }
+}
+
+static void
+index_store_pending_remove_entry(GHashTable *removed,
+                                 GHashTable *added,
+                                 FsearchDatabaseEntry *entry,
+                                 FsearchDatabaseIndexPropertyFlags affected_sort_orders) {
+    const FsearchDatabaseIndexPropertyFlags added_flags = index_store_pending_get_flags(added, entry);
+    // Where the entry is still waiting to be added, it isn't in the sort index yet: cancel the addition instead
+    const FsearchDatabaseIndexPropertyFlags removed_flags = index_store_pending_get_flags(removed, entry);
+    index_store_pending_set_flags(removed, entry, removed_flags | (affected_sort_orders & ~added_flags));
+    index_store_pending_set_flags(added, entry, added_flags & ~affected_sort_orders);
+}
+
+static void
+index_store_pending_remove(GHashTable *removed,
+                           GHashTable *added,
+                           DynamicArray *entries,
+                           FsearchDatabaseIndexPropertyFlags affected_sort_orders) {
+    if (!entries) {
+        return;
+    }
+    for (uint32_t i = 0; i < darray_get_num_items(entries); ++i) {
+        index_store_pending_remove_entry(removed, added, darray_get_item(entries, i), affected_sort_orders);
+    }
+}
+
+// Adds the updates `src` to `dest`, as if they were collected after the ones of `dest`
+static void
+index_store_pending_merge(IndexStorePendingUpdates *dest, IndexStorePendingUpdates *src) {
+    GHashTable *src_tables[] = {src->removed_files, src->removed_folders, src->added_files, src->added_folders};
+    for (uint32_t i = 0; i < G_N_ELEMENTS(src_tables); ++i) {
+        const bool is_file = i % 2 == 0;
+        GHashTable *removed = is_file ? dest->removed_files : dest->removed_folders;
+        GHashTable *added = is_file ? dest->added_files : dest->added_folders;
+
+        GHashTableIter iter;
+        gpointer entry = NULL;
+        gpointer flags = NULL;
+        g_hash_table_iter_init(&iter, src_tables[i]);
+        while (g_hash_table_iter_next(&iter, &entry, &flags)) {
+            // The removals of `src` come first, like when it gets applied
+            if (i < 2) {
+                index_store_pending_remove_entry(removed, added, entry, GPOINTER_TO_UINT(flags));
+            }
+            else {
+                index_store_pending_set_flags(added,
+                                              entry,
+                                              index_store_pending_get_flags(added, entry) | GPOINTER_TO_UINT(flags));
+            }
+        }
+    }
+}
+
+static void
+index_store_pending_add(GHashTable *added, DynamicArray *entries, FsearchDatabaseIndexPropertyFlags affected_sort_orders) {
+    if (!entries) {
+        return;
+    }
+    for (uint32_t i = 0; i < darray_get_num_items(entries); ++i) {
+        FsearchDatabaseEntry *entry = darray_get_item(entries, i);
+        index_store_pending_set_flags(added, entry, index_store_pending_get_flags(added, entry) | affected_sort_orders);
+    }
+}
+
 static void
 index_store_enqueue_add_results_cb(gpointer key, gpointer value, gpointer user_data) {
     IndexStoreAddRemoveContext *ctx = user_data;
@@ -335,6 +591,10 @@ index_store_add_entries_locked(FsearchDatabaseIndexStore *store,
     g_return_if_fail(store);
 
     uint32_t num_workers = 0;
+    if (store->deferred_sort_index_updates) {
+        index_store_pending_add(store->deferred_sort_index_updates->added_files, files, affected_sort_orders);
+        index_store_pending_add(store->deferred_sort_index_updates->added_folders, folders, affected_sort_orders);
+    }
 
     IndexStoreAddRemoveContext ctx = {
         .store = store,
@@ -419,6 +679,11 @@ index_store_remove_entries_locked(FsearchDatabaseIndexStore *store,
     g_return_if_fail(store);
 
     uint32_t num_workers = 0;
+    if (store->deferred_sort_index_updates) {
+        IndexStorePendingUpdates *updates = store->deferred_sort_index_updates;
+        index_store_pending_remove(updates->removed_files, updates->added_files, files, affected_sort_orders);
+        index_store_pending_remove(updates->removed_folders, updates->added_folders, folders, affected_sort_orders);
+    }
 
     IndexStoreAddRemoveContext ctx = {
         .store = store,
@@ -452,6 +717,170 @@ index_store_remove_entries_locked(FsearchDatabaseIndexStore *store,
     }
 }
 
+typedef struct {
+    GHashTable *entries;
+    FsearchDatabaseIndexProperty sort_order;
+} IndexStorePendingLookup;
+
+static bool
+index_store_pending_is_removed(void *entry, void *data) {
+    IndexStorePendingLookup *lookup = data;
+    return fsearch_database_index_property_is_set(index_store_pending_get_flags(lookup->entries, entry),
+                                                  lookup->sort_order);
+}
+
+// Applies the pending updates of `entry_type` to the sort index `chunks`: a single pass removes the entries, then
+// the added ones are sorted and merged in
+static void
+index_store_apply_updates_worker(FsearchDatabaseChunkedArray *chunks,
+                                 IndexStorePendingUpdates *updates,
+                                 FsearchDatabaseIndexProperty sort_order,
+                                 FsearchDatabaseEntryType entry_type) {
+    const bool is_file = entry_type == DATABASE_ENTRY_TYPE_FILE;
+    GHashTable *removed = is_file ? updates->removed_files : updates->removed_folders;
+    GHashTable *added = is_file ? updates->added_files : updates->added_folders;
+
+    IndexStorePendingLookup lookup = {.entries = removed, .sort_order = sort_order};
+    if (g_hash_table_size(removed) > 0) {
+        fsearch_database_chunked_array_drop_func(chunks, index_store_pending_is_removed, &lookup);
+    }
+
+    g_autoptr(DynamicArray) entries_to_add = darray_new(MAX(g_hash_table_size(added), 1));
+    GHashTableIter iter;
+    gpointer entry = NULL;
+    gpointer flags = NULL;
+    g_hash_table_iter_init(&iter, added);
+    while (g_hash_table_iter_next(&iter, &entry, &flags)) {
+        if (fsearch_database_index_property_is_set(GPOINTER_TO_UINT(flags), sort_order)) {
+            darray_add_item(entries_to_add, entry);
+        }
+    }
+    fsearch_database_chunked_array_insert_array(chunks, entries_to_add);
+}
+
+static void
+index_store_enqueue_apply_updates(FsearchDatabaseIndexStore *store,
+                                  FsearchDatabaseChunkedArray *chunks,
+                                  FsearchDatabaseSearchView *view,
+                                  FsearchDatabaseIndexProperty sort_order,
+                                  FsearchDatabaseEntryType entry_type,
+                                  uint32_t *num_workers) {
+    IndexStoreWorkerPoolData *pool_data = g_new0(IndexStoreWorkerPoolData, 1);
+    pool_data->type = view ? INDEX_STORE_WORKER_POOL_DATA_TYPE_APPLY_UPDATES_TO_RESULTS
+                           : INDEX_STORE_WORKER_POOL_DATA_TYPE_APPLY_UPDATES;
+    pool_data->apply_updates.updates = store->pending_updates;
+    pool_data->apply_updates.chunks = chunks;
+    pool_data->apply_updates.view = view;
+    pool_data->apply_updates.sort_order = sort_order;
+    pool_data->apply_updates.entry_type = entry_type;
+
+    (*num_workers)++;
+
+    g_thread_pool_push(store->worker_pool, pool_data, NULL);
+}
+
+// Starts collecting the updates of the sort indices and search views instead of applying them right away, if
+// `num_updates` events or paths are about to be processed and that's cheaper as a batch, see
+// THRESHOLD_FOR_BATCH_UPDATES. Store must be locked.
+static void
+index_store_begin_pending_updates_locked(FsearchDatabaseIndexStore *store, uint32_t num_updates) {
+    if (store->pending_updates) {
+        return;
+    }
+    const uint32_t num_entries = fsearch_database_index_store_get_num_files(store)
+                               + fsearch_database_index_store_get_num_folders(store);
+    if (num_updates >= MAX(THRESHOLD_FOR_BATCH_UPDATES, num_entries / NUM_ENTRIES_PER_BATCHED_UPDATE)) {
+        store->pending_updates = index_store_pending_updates_new();
+    }
+}
+
+// Applies the updates which were collected in `pending_updates` to all sort indices and search views, one job each,
+// and stops collecting them
+static void
+index_store_apply_pending_updates_locked(FsearchDatabaseIndexStore *store) {
+    IndexStorePendingUpdates *updates = store->pending_updates;
+    if (!updates) {
+        return;
+    }
+
+    const uint32_t num_removed = g_hash_table_size(updates->removed_files) + g_hash_table_size(updates->removed_folders);
+    const uint32_t num_added = g_hash_table_size(updates->added_files) + g_hash_table_size(updates->added_folders);
+    if (num_removed > 0 || num_added > 0) {
+        g_autoptr(GTimer) timer = g_timer_new();
+        uint32_t num_workers = 0;
+        if (store->deferred_sort_index_updates) {
+            index_store_pending_merge(store->deferred_sort_index_updates, updates);
+        }
+
+        GHashTableIter iter;
+        gpointer view = NULL;
+        g_hash_table_iter_init(&iter, store->search_results);
+        while (g_hash_table_iter_next(&iter, NULL, &view)) {
+            index_store_enqueue_apply_updates(store, NULL, view, DATABASE_INDEX_PROPERTY_NONE, 0, &num_workers);
+        }
+
+        for (uint32_t i = 0; i < NUM_DATABASE_INDEX_PROPERTIES; ++i) {
+            if (store->file_chunks[i]) {
+                index_store_enqueue_apply_updates(store,
+                                                  store->file_chunks[i],
+                                                  NULL,
+                                                  i,
+                                                  DATABASE_ENTRY_TYPE_FILE,
+                                                  &num_workers);
+            }
+            if (store->folder_chunks[i]) {
+                index_store_enqueue_apply_updates(store,
+                                                  store->folder_chunks[i],
+                                                  NULL,
+                                                  i,
+                                                  DATABASE_ENTRY_TYPE_FOLDER,
+                                                  &num_workers);
+            }
+        }
+
+        uint32_t collected_workers = 0;
+        while (collected_workers < num_workers) {
+            g_autofree IndexStoreWorkerPoolData *pool_data = g_async_queue_pop(store->worker_pool_collect_queue);
+            g_assert_nonnull(pool_data);
+            collected_workers++;
+        }
+
+        g_debug("[store] applied batch of %u removed and %u added entr%s in %.3f ms",
+                num_removed,
+                num_added,
+                num_added == 1 ? "y" : "ies",
+                g_timer_elapsed(timer, NULL) * 1000.0);
+    }
+
+    g_clear_pointer(&store->pending_updates, index_store_pending_updates_free);
+}
+
+// `entries_in_name_order` tells whether `entries` is ordered like the name index, see
+// fsearch_database_sort_entries_by_property()
+static FsearchDatabaseChunkedArray *
+index_store_build_sort_index_worker(DynamicArray *entries,
+                                    bool entries_in_name_order,
+                                    FsearchDatabaseIndexProperty sort_order,
+                                    FsearchDatabaseEntryType entry_type,
+                                    int max_sort_threads,
+                                    GCancellable *cancellable) {
+    // The entries are shared with the jobs building the other sort orders, so we sort our own copy
+    g_autoptr(DynamicArray) sorted = darray_copy_borrowed(entries);
+    if (!fsearch_database_sort_entries_by_property(sorted,
+                                                   entries_in_name_order,
+                                                   sort_order,
+                                                   max_sort_threads,
+                                                   cancellable)) {
+        return NULL;
+    }
+    return fsearch_database_chunked_array_new(sorted,
+                                              TRUE,
+                                              fsearch_database_sort_order_chain_for_property(sort_order),
+                                              entry_type,
+                                              cancellable,
+                                              NULL);
+}
+
 static void
 index_store_worker_pool_func(gpointer pool_data, gpointer user_data) {
     FsearchDatabaseIndexStore *store = user_data;
@@ -466,8 +895,9 @@ index_store_worker_pool_func(gpointer pool_data, gpointer user_data) {
                                   data->search.in,
                                   data->search.out,
                                   data->search.thread_id,
+                                  data->search.in_chunk_idx,
                                   data->search.in_start_idx,
-                                  data->search.in_end_idx,
+                                  data->search.in_num_entries,
                                   data->search.cancellable);
         g_async_queue_push(store->worker_pool_collect_queue, data);
         break;
@@ -488,7 +918,8 @@ index_store_worker_pool_func(gpointer pool_data, gpointer user_data) {
         fsearch_database_search_view_add(data->update_results.view,
                                          data->update_results.files,
                                          data->update_results.folders,
-                                         data->update_results.affected_sort_orders);
+                                         data->update_results.affected_sort_orders,
+                                         index_store_worker_get_match_data());
         g_async_queue_push(store->worker_pool_collect_queue, data);
         break;
     }
@@ -501,12 +932,182 @@ index_store_worker_pool_func(gpointer pool_data, gpointer user_data) {
         g_async_queue_push(store->worker_pool_collect_queue, data);
         break;
     }
+    case INDEX_STORE_WORKER_POOL_DATA_TYPE_APPLY_UPDATES: {
+        index_store_apply_updates_worker(data->apply_updates.chunks,
+                                         data->apply_updates.updates,
+                                         data->apply_updates.sort_order,
+                                         data->apply_updates.entry_type);
+        g_async_queue_push(store->worker_pool_collect_queue, data);
+        break;
+    }
+    case INDEX_STORE_WORKER_POOL_DATA_TYPE_APPLY_UPDATES_TO_RESULTS: {
+        IndexStorePendingUpdates *updates = data->apply_updates.updates;
+        fsearch_database_search_view_apply_updates(data->apply_updates.view,
+                                                   updates->removed_files,
+                                                   updates->removed_folders,
+                                                   updates->added_files,
+                                                   updates->added_folders,
+                                                   index_store_worker_get_match_data());
+        g_async_queue_push(store->worker_pool_collect_queue, data);
+        break;
+    }
+    case INDEX_STORE_WORKER_POOL_DATA_TYPE_BUILD_SORT_INDEX: {
+        data->build_sort_index.result = index_store_build_sort_index_worker(data->build_sort_index.entries,
+                                                                            data->build_sort_index.entries_in_name_order,
+                                                                            data->build_sort_index.sort_order,
+                                                                            data->build_sort_index.entry_type,
+                                                                            data->build_sort_index.max_sort_threads,
+                                                                            data->build_sort_index.cancellable);
+        g_async_queue_push(store->worker_pool_collect_queue, data);
+        break;
+    }
     default:
         g_assert_not_reached();
         break;
     }
 }
 
+// Returns the next sort index the worker thread should build: the requested ones first, then, in lazy mode, the
+// missing ones which weren't dropped. Returns DATABASE_INDEX_PROPERTY_NONE if there's nothing left to build.
+// Store must be locked.
+static FsearchDatabaseIndexProperty
+index_store_get_next_lazy_sort_index(FsearchDatabaseIndexStore *store) {
+    for (uint32_t pass = 0; pass < 2; ++pass) {
+        for (uint32_t i = 0; i < G_N_ELEMENTS(index_store_sort_orders); ++i) {
+            const FsearchDatabaseIndexProperty sort_order = index_store_sort_orders[i];
+            if (store->file_chunks[sort_order] && store->folder_chunks[sort_order]) {
+                continue;
+            }
+            if (store->deferred_sort_indices & (1u << sort_order)) {
+                continue;
+            }
+            const uint32_t mask = pass == 0 ? store->requested_sort_indices : ~store->dropped_sort_indices;
+            if (mask & (1u << sort_order)) {
+                return sort_order;
+            }
+        }
+        if (!store->lazy_sort_indices) {
+            break;
+        }
+    }
+    return DATABASE_INDEX_PROPERTY_NONE;
+}
+
+static void
+index_store_wait_to_read_entries_locked(FsearchDatabaseIndexStore *store);
+
+static GPtrArray *
+index_store_begin_reading_entries_locked(FsearchDatabaseIndexStore *store);
+
+static void
+index_store_end_reading_entries_locked(FsearchDatabaseIndexStore *store);
+
+static gboolean
+index_store_build_lazy_sort_index_cb(gpointer user_data) {
+    FsearchDatabaseIndexStore *store = user_data;
+    g_return_val_if_fail(store, G_SOURCE_REMOVE);
+
+    g_autoptr(GMutexLocker) locker = g_mutex_locker_new(&store->mutex);
+    g_assert_nonnull(locker);
+    index_store_wait_to_read_entries_locked(store);
+
+    if (!store->lazy_sort_index_source) {
+        // The store is being freed and destroyed the source while we were waiting for the lock
+        return G_SOURCE_REMOVE;
+    }
+
+    const FsearchDatabaseIndexProperty sort_order = index_store_get_next_lazy_sort_index(store);
+    FsearchDatabaseChunkedArray *name_files = store->file_chunks[DATABASE_INDEX_PROPERTY_NAME];
+    FsearchDatabaseChunkedArray *name_folders = store->folder_chunks[DATABASE_INDEX_PROPERTY_NAME];
+    if (!store->running || sort_order == DATABASE_INDEX_PROPERTY_NONE || !name_files || !name_folders) {
+        g_clear_pointer(&store->lazy_sort_index_source, g_source_unref);
+        return G_SOURCE_REMOVE;
+    }
+    if (!(store->requested_sort_indices & ~(1u << sort_order))) {
+        // Nobody is waiting for the remaining indices, don't get in the way of processing file system events
+        g_source_set_priority(store->lazy_sort_index_source, G_PRIORITY_LOW);
+    }
+
+    // The entries are only borrowed, so the indices they belong to are kept alive and locked while they're being
+    // sorted. The store lock is released meanwhile: searches go on, file system events wait for a later tick and
+    // removed or refreshed paths are queued until the sort is done, so the store doesn't change before the new index
+    // is added.
+    g_autoptr(GPtrArray) indices = index_store_begin_reading_entries_locked(store);
+    g_autoptr(DynamicArray) files = fsearch_database_chunked_array_get_joined(name_files);
+    g_autoptr(DynamicArray) folders = fsearch_database_chunked_array_get_joined(name_folders);
+    g_autoptr(GCancellable) cancellable = g_object_ref(store->lazy_sort_index_cancellable);
+    g_clear_pointer(&locker, g_mutex_locker_free);
+
+    g_autoptr(GTimer) timer = g_timer_new();
+    const int max_sort_threads = (int)g_get_num_processors();
+    g_autoptr(FsearchDatabaseChunkedArray) file_chunks = index_store_build_sort_index_worker(files,
+                                                                                             true,
+                                                                                             sort_order,
+                                                                                             DATABASE_ENTRY_TYPE_FILE,
+                                                                                             max_sort_threads,
+                                                                                             cancellable);
+    g_autoptr(FsearchDatabaseChunkedArray) folder_chunks = index_store_build_sort_index_worker(
+        folders,
+        true,
+        sort_order,
+        DATABASE_ENTRY_TYPE_FOLDER,
+        max_sort_threads,
+        cancellable);
+
+    // Never take the store lock while holding index locks, everyone else takes them the other way around
+    for (uint32_t i = 0; i < indices->len; ++i) {
+        fsearch_database_index_unlock(g_ptr_array_index(indices, i));
+    }
+
+    locker = g_mutex_locker_new(&store->mutex);
+    g_assert_nonnull(locker);
+
+    if (!store->lazy_sort_index_source) {
+        // The store is being freed, the queued changes don't matter anymore
+        store->num_entry_readers--;
+        return G_SOURCE_REMOVE;
+    }
+
+    if (file_chunks && folder_chunks && !store->file_chunks[sort_order] && !store->folder_chunks[sort_order]
+        && !(store->dropped_sort_indices & (1u << sort_order))) {
+        store->file_chunks[sort_order] = g_steal_pointer(&file_chunks);
+        store->folder_chunks[sort_order] = g_steal_pointer(&folder_chunks);
+        store->requested_sort_indices &= ~(1u << sort_order);
+
+        g_debug("[index_store] built the %s index in %.3f ms",
+                fsearch_database_index_property_to_string(sort_order),
+                g_timer_elapsed(timer, NULL) * 1000.0);
+    }
+
+    // Applies the queued changes to the new index as well
+    index_store_end_reading_entries_locked(store);
+
+    return G_SOURCE_CONTINUE;
+}
+
+// Makes sure the worker thread builds the sort indices which are requested or, in lazy mode, still missing. Store
+// must be locked.
+static void
+index_store_schedule_lazy_sort_indices(FsearchDatabaseIndexStore *store, gint priority) {
+    if (!store->running) {
+        // Scheduled once the store is started
+        return;
+    }
+    if (store->lazy_sort_index_source) {
+        if (priority < g_source_get_priority(store->lazy_sort_index_source)) {
+            g_source_set_priority(store->lazy_sort_index_source, priority);
+        }
+        return;
+    }
+    if (index_store_get_next_lazy_sort_index(store) == DATABASE_INDEX_PROPERTY_NONE) {
+        return;
+    }
+    store->lazy_sort_index_source = g_idle_source_new();
+    g_source_set_priority(store->lazy_sort_index_source, priority);
+    g_source_set_callback(store->lazy_sort_index_source, index_store_build_lazy_sort_index_cb, store, NULL);
+    g_source_attach(store->lazy_sort_index_source, store->worker.ctx);
+}
+
 typedef struct {
     FsearchDatabaseIndexStoreEventFunc event_func;
     gpointer event_func_data;
@@ -542,19 +1143,46 @@ index_store_update_all_search_views_locked(FsearchDatabaseIndexStore *store) {
     g_hash_table_foreach(store->search_results, index_store_view_changed_cb, &ctx);
 }
 
+static void
+index_store_set_index_checkpoint_path(FsearchDatabaseIndexStore *store, FsearchDatabaseIndex *index) {
+    if (!store->checkpoint_dir) {
+        return;
+    }
+    const char *index_path = fsearch_database_index_get_path(index);
+    g_autofree char *checkpoint_path = fsearch_database_scan_checkpoint_get_path(store->checkpoint_dir, index_path);
+    fsearch_database_index_set_checkpoint_path(index, checkpoint_path);
+}
+
 static void
 index_store_index_event_cb(FsearchDatabaseIndex *index, FsearchDatabaseIndexEvent *event, gpointer user_data) {
     FsearchDatabaseIndexStore *store = user_data;
     g_return_if_fail(store);
 
+    IndexStorePendingUpdates *updates = store->pending_updates;
     switch (event->kind) {
     case FSEARCH_DATABASE_INDEX_EVENT_ENTRY_CREATED:
+        if (updates) {
+            index_store_pending_add(updates->added_files, event->entries.files, event->entries.affected_sort_orders);
+            index_store_pending_add(updates->added_folders, event->entries.folders, event->entries.affected_sort_orders);
+            break;
+        }
         index_store_add_entries_locked(store,
                                        event->entries.files,
                                        event->entries.folders,
                                        event->entries.affected_sort_orders);
         break;
     case FSEARCH_DATABASE_INDEX_EVENT_ENTRY_DELETED:
+        if (updates) {
+            index_store_pending_remove(updates->removed_files,
+                                       updates->added_files,
+                                       event->entries.files,
+                                       event->entries.affected_sort_orders);
+            index_store_pending_remove(updates->removed_folders,
+                                       updates->added_folders,
+                                       event->entries.folders,
+                                       event->entries.affected_sort_orders);
+            break;
+        }
         index_store_remove_entries_locked(store,
                                           event->entries.files,
                                           event->entries.folders,
@@ -569,18 +1197,207 @@ index_store_index_event_cb(FsearchDatabaseIndex *index, FsearchDatabaseIndexEven
                               store->event_func_data);
         }
         break;
+    case FSEARCH_DATABASE_INDEX_EVENT_PATH_CHANGED:
+        if (store->event_func) {
+            store->event_func(store,
+                              FSEARCH_DATABASE_INDEX_STORE_EVENT_PATH_CHANGED,
+                              event->path,
+                              store->event_func_data);
+        }
+        break;
     default:
         break;
     }
 }
 
 static void
-index_store_content_changed(FsearchDatabaseIndexStore *store) {
-    g_return_if_fail(store);
-    index_store_update_all_search_views_locked(store);
-    if (store->event_func) {
-        store->event_func(store, FSEARCH_DATABASE_INDEX_STORE_EVENT_CONTENT_CHANGED, NULL, store->event_func_data);
+index_store_content_changed(FsearchDatabaseIndexStore *store) {
+    g_return_if_fail(store);
+    index_store_update_all_search_views_locked(store);
+    if (store->event_func) {
+        store->event_func(store, FSEARCH_DATABASE_INDEX_STORE_EVENT_CONTENT_CHANGED, NULL, store->event_func_data);
+    }
+}
+
+static void
+index_store_remove_paths_locked(FsearchDatabaseIndexStore *store,
+                                GPtrArray *paths,
+                                FsearchDatabaseRescanManager *rescan_manager) {
+    bool content_changed = false;
+    index_store_begin_pending_updates_locked(store, paths->len);
+    for (uint32_t i = 0; i < paths->len; ++i) {
+        const char *path = g_ptr_array_index(paths, i);
+
+        for (uint32_t j = 0; j < store->indices->len; ++j) {
+            FsearchDatabaseIndex *index = g_ptr_array_index(store->indices, j);
+            g_autoptr(FsearchDatabaseInclude) include = fsearch_database_index_get_include(index);
+            const char *root_path = fsearch_database_include_get_path(include);
+
+            if (fsearch_database_include_get_monitored(include)) {
+                continue;
+            }
+
+            // Optimization: Only try to remove if the path falls under this index's root
+            if (index_store_path_is_in_root(path, root_path)) {
+                bool root_removed = false;
+                if (fsearch_database_index_remove_path(index, path, &root_removed)) {
+                    content_changed = true;
+                }
+
+                // Handle the offline edge case
+                if (root_removed && rescan_manager) {
+                    fsearch_database_rescan_manager_notify_index_offline(rescan_manager,
+                                                                         fsearch_database_index_get_path(index));
+                }
+            }
+        }
+    }
+    index_store_apply_pending_updates_locked(store);
+    if (content_changed) {
+        index_store_content_changed(store);
+    }
+}
+
+static void
+index_store_refresh_paths_locked(FsearchDatabaseIndexStore *store,
+                                 GPtrArray *paths,
+                                 FsearchDatabaseRescanManager *rescan_manager) {
+    bool content_changed = false;
+    index_store_begin_pending_updates_locked(store, paths->len);
+    for (uint32_t i = 0; i < paths->len; ++i) {
+        const char *path = g_ptr_array_index(paths, i);
+
+        for (uint32_t j = 0; j < store->indices->len; ++j) {
+            FsearchDatabaseIndex *index = g_ptr_array_index(store->indices, j);
+            const char *root_path = fsearch_database_index_get_path(index);
+            if (!index_store_path_is_in_root(path, root_path)) {
+                continue;
+            }
+
+            bool root_removed = false;
+            if (fsearch_database_index_refresh_path(index, path, &root_removed)) {
+                content_changed = true;
+            }
+
+            if (root_removed && rescan_manager) {
+                fsearch_database_rescan_manager_notify_index_offline(rescan_manager, root_path);
+            }
+        }
+    }
+    index_store_apply_pending_updates_locked(store);
+    if (content_changed) {
+        index_store_content_changed(store);
+    }
+}
+
+static void
+index_store_queued_path_change_clear(IndexStoreQueuedPathChange *change) {
+    g_clear_pointer(&change->path, g_free);
+}
+
+static void
+index_store_queue_path_changes_locked(FsearchDatabaseIndexStore *store,
+                                      GPtrArray *paths,
+                                      bool remove,
+                                      FsearchDatabaseRescanManager *rescan_manager) {
+    for (uint32_t i = 0; i < paths->len; ++i) {
+        const char *path = g_ptr_array_index(paths, i);
+        IndexStoreQueuedPathChange change = {.path = g_strdup(path), .remove = remove};
+        g_array_append_val(store->queued_path_changes, change);
+
+        if (!rescan_manager) {
+            continue;
+        }
+        // The rescan manager isn't around anymore once the queue is applied, so tell it right away about roots which
+        // go offline, like index_store_remove_paths_locked() and index_store_refresh_paths_locked() would
+        for (uint32_t j = 0; j < store->indices->len; ++j) {
+            FsearchDatabaseIndex *index = g_ptr_array_index(store->indices, j);
+            g_autoptr(FsearchDatabaseInclude) include = fsearch_database_index_get_include(index);
+            const char *root_path = fsearch_database_include_get_path(include);
+            if (g_strcmp0(path, root_path) != 0) {
+                continue;
+            }
+            const bool root_removed = remove ? !fsearch_database_include_get_monitored(include)
+                                             : !g_file_test(root_path, G_FILE_TEST_IS_DIR);
+            if (root_removed) {
+                fsearch_database_rescan_manager_notify_index_offline(rescan_manager,
+                                                                     fsearch_database_index_get_path(index));
+            }
+        }
+    }
+    g_debug("[index_store] queued %u path changes until the sort indices are built", paths->len);
+}
+
+static void
+index_store_apply_queued_path_changes_locked(FsearchDatabaseIndexStore *store) {
+    if (store->queued_path_changes->len == 0) {
+        return;
+    }
+    g_autoptr(GArray) changes = g_steal_pointer(&store->queued_path_changes);
+    store->queued_path_changes = g_array_new(FALSE, FALSE, sizeof(IndexStoreQueuedPathChange));
+    g_array_set_clear_func(store->queued_path_changes, (GDestroyNotify)index_store_queued_path_change_clear);
+
+    // Apply them in their original order, with one batch per run of removals or refreshes
+    g_autoptr(GPtrArray) paths = g_ptr_array_new();
+    for (uint32_t i = 0; i < changes->len; ++i) {
+        IndexStoreQueuedPathChange *change = &g_array_index(changes, IndexStoreQueuedPathChange, i);
+        g_ptr_array_add(paths, change->path);
+
+        const bool is_last_of_run = i + 1 == changes->len
+                                 || g_array_index(changes, IndexStoreQueuedPathChange, i + 1).remove != change->remove;
+        if (!is_last_of_run) {
+            continue;
+        }
+        if (change->remove) {
+            index_store_remove_paths_locked(store, paths, NULL);
+        }
+        else {
+            index_store_refresh_paths_locked(store, paths, NULL);
+        }
+        g_ptr_array_set_size(paths, 0);
+    }
+}
+
+// Waits until no other thread reads the entries and no writer waits for that anymore
+static void
+index_store_wait_to_read_entries_locked(FsearchDatabaseIndexStore *store) {
+    while (store->num_entry_writers_waiting > 0 || store->num_entry_readers > 0) {
+        g_cond_wait(&store->entry_readers_cond, &store->mutex);
+    }
+}
+
+static void
+index_store_wait_for_entry_readers_locked(FsearchDatabaseIndexStore *store) {
+    store->num_entry_writers_waiting++;
+    while (store->num_entry_readers > 0) {
+        g_cond_wait(&store->entry_readers_cond, &store->mutex);
+    }
+    store->num_entry_writers_waiting--;
+    g_cond_broadcast(&store->entry_readers_cond);
+}
+
+static GPtrArray *
+index_store_begin_reading_entries_locked(FsearchDatabaseIndexStore *store) {
+    store->num_entry_readers++;
+
+    GPtrArray *indices = g_ptr_array_new_with_free_func((GDestroyNotify)fsearch_database_index_unref);
+    for (uint32_t i = 0; i < store->indices->len; ++i) {
+        FsearchDatabaseIndex *index = g_ptr_array_index(store->indices, i);
+        g_ptr_array_add(indices, fsearch_database_index_ref(index));
+        fsearch_database_index_lock(index);
+    }
+    return indices;
+}
+
+static void
+index_store_end_reading_entries_locked(FsearchDatabaseIndexStore *store) {
+    g_return_if_fail(store->num_entry_readers > 0);
+
+    if (--store->num_entry_readers > 0) {
+        return;
     }
+    index_store_apply_queued_path_changes_locked(store);
+    g_cond_broadcast(&store->entry_readers_cond);
 }
 
 static gboolean
@@ -595,14 +1412,25 @@ index_store_proces_events_cb(gpointer data) {
         // store isn't fully started yet
         return G_SOURCE_CONTINUE;
     }
+    if (store->num_entry_readers > 0) {
+        // The indices are locked until the sort indices are built, try again on the next tick
+        return G_SOURCE_CONTINUE;
+    }
 
     gboolean has_pending = FALSE;
+    uint32_t num_pending = 0;
     for (uint32_t i = 0; i < store->indices->len; ++i) {
         FsearchDatabaseIndex *index = g_ptr_array_index(store->indices, i);
         g_return_val_if_fail(index, G_SOURCE_REMOVE);
         has_pending |= fsearch_database_index_has_pending_events(index);
+        num_pending += fsearch_database_index_get_num_pending_events(index);
     }
 
+    // During event storms (e.g. a build creating lots of files) updating the sort indices and search views for every
+    // single event would shift the same large arrays over and over again. Collect the updates instead and apply them
+    // with a single pass per sort index and view once all events were processed.
+    index_store_begin_pending_updates_locked(store, num_pending);
+
     // Notify the UI for a potential slow index update
     if (has_pending && store->event_func) {
         store->event_func(store, FSEARCH_DATABASE_INDEX_STORE_EVENT_APPLY_STARTED, NULL, store->event_func_data);
@@ -615,6 +1443,8 @@ index_store_proces_events_cb(gpointer data) {
         store_was_updated |= fsearch_database_index_process_events(index);
     }
 
+    index_store_apply_pending_updates_locked(store);
+
     if (store_was_updated) {
         index_store_content_changed(store);
     }
@@ -633,7 +1463,7 @@ index_store_root_reappear_poll_cb(gpointer user_data) {
     g_autoptr(GMutexLocker) locker = g_mutex_locker_new(&store->mutex);
     g_assert_nonnull(locker);
 
-    if (!store->running) {
+    if (!store->running || store->num_entry_readers > 0) {
         return G_SOURCE_CONTINUE;
     }
 
@@ -653,6 +1483,7 @@ index_store_root_reappear_poll_cb(gpointer user_data) {
         }
         g_debug("[index-%d] root folder reappeared, rescanning: %s", i, index_path);
         if (fsearch_database_index_scan(index, NULL)) {
+            fsearch_database_index_remove_checkpoint(index);
             fsearch_database_index_lock(index);
 
             g_autoptr(DynamicArray) folders = fsearch_database_index_get_folders(index);
@@ -684,6 +1515,15 @@ index_store_free(FsearchDatabaseIndexStore *store) {
         g_clear_pointer(&store->worker.event_source, g_source_unref);
     }
 
+    // Abort a sort index which is currently being built, so we don't have to wait for it when joining the worker
+    g_mutex_lock(&store->mutex);
+    g_cancellable_cancel(store->lazy_sort_index_cancellable);
+    if (store->lazy_sort_index_source) {
+        g_source_destroy(store->lazy_sort_index_source);
+        g_clear_pointer(&store->lazy_sort_index_source, g_source_unref);
+    }
+    g_mutex_unlock(&store->mutex);
+
     if (store->worker.loop) {
         g_main_context_invoke_full(store->worker.ctx,
                                    G_PRIORITY_HIGH,
@@ -695,6 +1535,9 @@ index_store_free(FsearchDatabaseIndexStore *store) {
         g_thread_join(store->worker.thread);
     }
     g_clear_pointer(&store->worker.ctx, g_main_context_unref);
+    g_clear_object(&store->lazy_sort_index_cancellable);
+    g_clear_pointer(&store->queued_path_changes, g_array_unref);
+    g_clear_pointer(&store->deferred_sort_index_updates, index_store_pending_updates_free);
 
     // 1. Make sure the indices are down
     g_clear_pointer(&store->indices, g_ptr_array_unref);
@@ -702,6 +1545,7 @@ index_store_free(FsearchDatabaseIndexStore *store) {
     index_store_sorted_entries_free(store);
     g_clear_object(&store->include_manager);
     g_clear_object(&store->exclude_manager);
+    g_clear_pointer(&store->checkpoint_dir, g_free);
 
     // Wait for tasks to finish must be TRUE since the worker threads might be using the worker_pool_collect_queue
     // Hence, make sure to unref the queue only after the pool has been terminated
@@ -721,6 +1565,7 @@ index_store_free(FsearchDatabaseIndexStore *store) {
     }
     g_clear_pointer(&store->monitor.ctx, g_main_context_unref);
 
+    g_cond_clear(&store->entry_readers_cond);
     g_mutex_clear(&store->mutex);
 
     g_free(store);
@@ -736,6 +1581,7 @@ fsearch_database_index_store_new(FsearchDatabaseIncludeManager *include_manager,
 
     // Must be initialized before any thread/source below can lock it.
     g_mutex_init(&store->mutex);
+    g_cond_init(&store->entry_readers_cond);
     store->ref_count = 1;
 
     store->indices = g_ptr_array_new_with_free_func((GDestroyNotify)fsearch_database_index_unref);
@@ -747,6 +1593,10 @@ fsearch_database_index_store_new(FsearchDatabaseIncludeManager *include_manager,
     store->flags = flags;
     store->is_sorted = false;
     store->running = false;
+    store->lazy_sort_indices = g_getenv("FSEARCH_LAZY_SORT_INDICES") != NULL;
+    store->lazy_sort_index_cancellable = g_cancellable_new();
+    store->queued_path_changes = g_array_new(FALSE, FALSE, sizeof(IndexStoreQueuedPathChange));
+    g_array_set_clear_func(store->queued_path_changes, (GDestroyNotify)index_store_queued_path_change_clear);
 
     store->include_manager = g_object_ref(include_manager);
     store->exclude_manager = g_object_ref(exclude_manager);
@@ -784,6 +1634,7 @@ fsearch_database_index_store_new_with_content(GPtrArray *indices,
                                               FsearchDatabaseIncludeManager *include_manager,
                                               FsearchDatabaseExcludeManager *exclude_manager,
                                               FsearchDatabaseIndexPropertyFlags flags,
+                                              FsearchDatabaseIndexPropertyFlags deferred_sort_indices,
                                               FsearchDatabaseIndexStoreEventFunc event_func,
                                               gpointer event_func_data) {
     FsearchDatabaseIndexStore *store = fsearch_database_index_store_new(include_manager,
@@ -819,10 +1670,24 @@ fsearch_database_index_store_new_with_content(GPtrArray *indices,
         }
     }
 
+    for (uint32_t i = 0; i < G_N_ELEMENTS(index_store_sort_orders); ++i) {
+        const FsearchDatabaseIndexProperty sort_order = index_store_sort_orders[i];
+        if (store->file_chunks[sort_order] && store->folder_chunks[sort_order]) {
+            continue;
+        }
+        if (fsearch_database_index_property_is_set(deferred_sort_indices, sort_order)) {
+            store->deferred_sort_indices |= 1u << sort_order;
+        }
+    }
+    if (store->deferred_sort_indices) {
+        store->deferred_sort_index_updates = index_store_pending_updates_new();
+    }
+
     store->is_sorted = true;
     g_autoptr(GMutexLocker) locker = g_mutex_locker_new(&store->mutex);
     g_assert_nonnull(locker);
     store->running = true;
+    index_store_schedule_lazy_sort_indices(store, G_PRIORITY_LOW);
 
     return store;
 }
@@ -848,6 +1713,103 @@ fsearch_database_index_store_unref(FsearchDatabaseIndexStore *store) {
 }
 
 /* Lifecycle */
+static void
+index_store_push_build_sort_index_job(FsearchDatabaseIndexStore *store,
+                                      DynamicArray *entries,
+                                      bool entries_in_name_order,
+                                      FsearchDatabaseIndexProperty sort_order,
+                                      FsearchDatabaseEntryType entry_type,
+                                      int max_sort_threads,
+                                      GCancellable *cancellable) {
+    IndexStoreWorkerPoolData *pool_data = g_new0(IndexStoreWorkerPoolData, 1);
+    pool_data->type = INDEX_STORE_WORKER_POOL_DATA_TYPE_BUILD_SORT_INDEX;
+    pool_data->build_sort_index.entries = entries;
+    pool_data->build_sort_index.entries_in_name_order = entries_in_name_order;
+    pool_data->build_sort_index.sort_order = sort_order;
+    pool_data->build_sort_index.entry_type = entry_type;
+    pool_data->build_sort_index.max_sort_threads = max_sort_threads;
+    pool_data->build_sort_index.cancellable = cancellable;
+    g_thread_pool_push(store->worker_pool, pool_data, NULL);
+}
+
+// Builds the fast sort indices for all sort orders concurrently on the worker pool. The processors are split between
+// the jobs, so sorting several properties at once doesn't oversubscribe the machine. Numeric sort orders are only
+// started once the name index for the same entry type is done, so they can be radix sorted from it. In lazy mode only
+// the name index is built here, the others are built by the worker thread once the store is running.
+static void
+index_store_build_sort_indices(FsearchDatabaseIndexStore *store,
+                               DynamicArray *files,
+                               DynamicArray *folders,
+                               GCancellable *cancellable) {
+    const FsearchDatabaseIndexProperty *sort_orders = index_store_sort_orders;
+    const uint32_t num_sort_orders = store->lazy_sort_indices ? 1 : G_N_ELEMENTS(index_store_sort_orders);
+    const uint32_t num_jobs = 2 * num_sort_orders;
+    const int max_sort_threads = (int)MAX(g_get_num_processors() / num_jobs, 1);
+
+    for (uint32_t i = 0; i < num_jobs; ++i) {
+        const bool is_folder = i % 2 == 0;
+        if (fsearch_database_sort_order_has_numeric_key(sort_orders[i / 2])) {
+            continue;
+        }
+        index_store_push_build_sort_index_job(store,
+                                              is_folder ? folders : files,
+                                              false,
+                                              sort_orders[i / 2],
+                                              is_folder ? DATABASE_ENTRY_TYPE_FOLDER : DATABASE_ENTRY_TYPE_FILE,
+                                              max_sort_threads,
+                                              cancellable);
+    }
+
+    // The name sorted entries the numeric jobs are working on
+    g_autoptr(DynamicArray) folders_by_name = NULL;
+    g_autoptr(DynamicArray) files_by_name = NULL;
+
+    for (uint32_t num_finished = 1; num_finished <= num_jobs; ++num_finished) {
+        g_autofree IndexStoreWorkerPoolData *pool_data = g_async_queue_pop(store->worker_pool_collect_queue);
+        g_assert_nonnull(pool_data);
+
+        const FsearchDatabaseIndexProperty sort_order = pool_data->build_sort_index.sort_order;
+        const FsearchDatabaseEntryType entry_type = pool_data->build_sort_index.entry_type;
+        FsearchDatabaseChunkedArray **chunks = entry_type == DATABASE_ENTRY_TYPE_FOLDER
+                                                 ? &store->folder_chunks[sort_order]
+                                                 : &store->file_chunks[sort_order];
+        g_clear_pointer(chunks, fsearch_database_chunked_array_unref);
+        *chunks = g_steal_pointer(&pool_data->build_sort_index.result);
+
+        if (sort_order == DATABASE_INDEX_PROPERTY_NAME) {
+            // If the name index couldn't be built (i.e. we got cancelled), the numeric jobs still have to run to
+            // keep the job count right, but they'll just return without sorting anything
+            DynamicArray *by_name = *chunks ? fsearch_database_chunked_array_get_joined(*chunks) : NULL;
+            DynamicArray *unsorted = entry_type == DATABASE_ENTRY_TYPE_FOLDER ? folders : files;
+            if (entry_type == DATABASE_ENTRY_TYPE_FOLDER) {
+                folders_by_name = by_name;
+            }
+            else {
+                files_by_name = by_name;
+            }
+            for (uint32_t i = 0; i < num_sort_orders; ++i) {
+                if (!fsearch_database_sort_order_has_numeric_key(sort_orders[i])) {
+                    continue;
+                }
+                index_store_push_build_sort_index_job(store,
+                                                      by_name ? by_name : unsorted,
+                                                      by_name != NULL,
+                                                      sort_orders[i],
+                                                      entry_type,
+                                                      max_sort_threads,
+                                                      cancellable);
+            }
+        }
+
+        if (store->event_func && !g_cancellable_is_cancelled(cancellable)) {
+            store->event_func(store,
+                              FSEARCH_DATABASE_INDEX_STORE_EVENT_PROGRESS,
+                              g_strdup_printf(_("Sorting… (%u/%u)"), num_finished, num_jobs),
+                              store->event_func_data);
+        }
+    }
+}
+
 void
 fsearch_database_index_store_start(FsearchDatabaseIndexStore *store, GCancellable *cancellable) {
     g_return_if_fail(store);
@@ -869,6 +1831,7 @@ fsearch_database_index_store_start(FsearchDatabaseIndexStore *store, GCancellabl
                                                                            store->monitor.ctx,
                                                                            index_store_index_event_cb,
                                                                            store);
+        index_store_set_index_checkpoint_path(store, index);
         fsearch_database_index_scan(index, cancellable);
         g_ptr_array_add(indices, g_steal_pointer(&index));
     }
@@ -922,76 +1885,7 @@ fsearch_database_index_store_start(FsearchDatabaseIndexStore *store, GCancellabl
     }
 
     index_store_lock_all_indices(store);
-    store->folder_chunks[DATABASE_INDEX_PROPERTY_NAME] = fsearch_database_chunked_array_new(
-        store_folders,
-        FALSE,
-        fsearch_database_sort_order_chain_for_property(DATABASE_INDEX_PROPERTY_NAME),
-        DATABASE_ENTRY_TYPE_FOLDER,
-        cancellable,
-        NULL);
-    store->file_chunks[DATABASE_INDEX_PROPERTY_NAME] = fsearch_database_chunked_array_new(
-        store_files,
-        FALSE,
-        fsearch_database_sort_order_chain_for_property(DATABASE_INDEX_PROPERTY_NAME),
-        DATABASE_ENTRY_TYPE_FILE,
-        cancellable,
-        NULL);
-    store->folder_chunks[DATABASE_INDEX_PROPERTY_PATH] = fsearch_database_chunked_array_new(
-        store_folders,
-        FALSE,
-        fsearch_database_sort_order_chain_for_property(DATABASE_INDEX_PROPERTY_PATH),
-        DATABASE_ENTRY_TYPE_FOLDER,
-        cancellable,
-        NULL);
-    store->file_chunks[DATABASE_INDEX_PROPERTY_PATH] = fsearch_database_chunked_array_new(
-        store_files,
-        FALSE,
-        fsearch_database_sort_order_chain_for_property(DATABASE_INDEX_PROPERTY_PATH),
-        DATABASE_ENTRY_TYPE_FILE,
-        cancellable,
-        NULL);
-    store->folder_chunks[DATABASE_INDEX_PROPERTY_SIZE] = fsearch_database_chunked_array_new(
-        store_folders,
-        FALSE,
-        fsearch_database_sort_order_chain_for_property(DATABASE_INDEX_PROPERTY_SIZE),
-        DATABASE_ENTRY_TYPE_FOLDER,
-        cancellable,
-        NULL);
-    store->file_chunks[DATABASE_INDEX_PROPERTY_SIZE] = fsearch_database_chunked_array_new(
-        store_files,
-        FALSE,
-        fsearch_database_sort_order_chain_for_property(DATABASE_INDEX_PROPERTY_SIZE),
-        DATABASE_ENTRY_TYPE_FILE,
-        cancellable,
-        NULL);
-    store->folder_chunks[DATABASE_INDEX_PROPERTY_MODIFICATION_TIME] = fsearch_database_chunked_array_new(
-        store_folders,
-        FALSE,
-        fsearch_database_sort_order_chain_for_property(DATABASE_INDEX_PROPERTY_MODIFICATION_TIME),
-        DATABASE_ENTRY_TYPE_FOLDER,
-        cancellable,
-        NULL);
-    store->file_chunks[DATABASE_INDEX_PROPERTY_MODIFICATION_TIME] = fsearch_database_chunked_array_new(
-        store_files,
-        FALSE,
-        fsearch_database_sort_order_chain_for_property(DATABASE_INDEX_PROPERTY_MODIFICATION_TIME),
-        DATABASE_ENTRY_TYPE_FILE,
-        cancellable,
-        NULL);
-    store->folder_chunks[DATABASE_INDEX_PROPERTY_EXTENSION] = fsearch_database_chunked_array_new(
-        store_folders,
-        FALSE,
-        fsearch_database_sort_order_chain_for_property(DATABASE_INDEX_PROPERTY_EXTENSION),
-        DATABASE_ENTRY_TYPE_FOLDER,
-        cancellable,
-        NULL);
-    store->file_chunks[DATABASE_INDEX_PROPERTY_EXTENSION] = fsearch_database_chunked_array_new(
-        store_files,
-        FALSE,
-        fsearch_database_sort_order_chain_for_property(DATABASE_INDEX_PROPERTY_EXTENSION),
-        DATABASE_ENTRY_TYPE_FILE,
-        cancellable,
-        NULL);
+    index_store_build_sort_indices(store, store_files, store_folders, cancellable);
     store->is_sorted = true;
     index_store_unlock_all_indices(store);
 
@@ -1004,6 +1898,7 @@ fsearch_database_index_store_start(FsearchDatabaseIndexStore *store, GCancellabl
     g_autoptr(GMutexLocker) locker = g_mutex_locker_new(&store->mutex);
     g_assert_nonnull(locker);
     store->running = true;
+    index_store_schedule_lazy_sort_indices(store, G_PRIORITY_LOW);
 
     return;
 }
@@ -1053,7 +1948,32 @@ fsearch_database_index_store_create_index_for_rescan(FsearchDatabaseIndexStore *
     g_autoptr(FsearchDatabaseExcludeManager) exclude_manager = fsearch_database_index_get_exclude_manager(old_index);
     const FsearchDatabaseIndexPropertyFlags flags = fsearch_database_index_get_flags(old_index);
 
-    return fsearch_database_index_new(include, exclude_manager, flags, store->monitor.ctx, index_store_index_event_cb, store);
+    FsearchDatabaseIndex *index = fsearch_database_index_new(include,
+                                                             exclude_manager,
+                                                             flags,
+                                                             store->monitor.ctx,
+                                                             index_store_index_event_cb,
+                                                             store);
+    index_store_set_index_checkpoint_path(store, index);
+    return index;
+}
+
+void
+fsearch_database_index_store_set_checkpoint_dir(FsearchDatabaseIndexStore *store, const char *checkpoint_dir) {
+    g_return_if_fail(store);
+
+    g_autoptr(GMutexLocker) locker = g_mutex_locker_new(&store->mutex);
+    g_assert_nonnull(locker);
+
+    // Setting the checkpoint paths locks the indices
+    index_store_wait_for_entry_readers_locked(store);
+
+    g_free(store->checkpoint_dir);
+    store->checkpoint_dir = g_strdup(checkpoint_dir);
+
+    for (uint32_t i = 0; i < store->indices->len; i++) {
+        index_store_set_index_checkpoint_path(store, g_ptr_array_index(store->indices, i));
+    }
 }
 
 bool
@@ -1064,6 +1984,15 @@ fsearch_database_index_store_replace_index(FsearchDatabaseIndexStore *store, Fse
     g_autoptr(GMutexLocker) locker = g_mutex_locker_new(&store->mutex);
     g_assert_nonnull(locker);
 
+    // The old index is about to be freed, so abort a sort index which is built from its entries right now instead of
+    // waiting for it. It's built again later on.
+    if (store->num_entry_readers > 0) {
+        g_cancellable_cancel(store->lazy_sort_index_cancellable);
+        g_clear_object(&store->lazy_sort_index_cancellable);
+        store->lazy_sort_index_cancellable = g_cancellable_new();
+    }
+    index_store_wait_for_entry_readers_locked(store);
+
     // Find the old index.
     uint32_t old_idx_pos = 0;
     if (!index_store_has_index_with_same_path(store, new_index, &old_idx_pos)) {
@@ -1128,38 +2057,36 @@ fsearch_database_index_store_remove_paths(FsearchDatabaseIndexStore *store,
     g_return_if_fail(store);
     g_return_if_fail(file_paths);
 
-    bool content_changed = false;
     const uint32_t num_file_paths = darray_get_num_items(file_paths);
+    g_autoptr(GPtrArray) paths = g_ptr_array_sized_new(num_file_paths);
     for (uint32_t i = 0; i < num_file_paths; ++i) {
-        const char *path = darray_get_item(file_paths, i);
-
-        for (uint32_t j = 0; j < store->indices->len; ++j) {
-            FsearchDatabaseIndex *index = g_ptr_array_index(store->indices, j);
-            g_autoptr(FsearchDatabaseInclude) include = fsearch_database_index_get_include(index);
-            const char *root_path = fsearch_database_include_get_path(include);
-
-            if (fsearch_database_include_get_monitored(include)) {
-                continue;
-            }
+        g_ptr_array_add(paths, darray_get_item(file_paths, i));
+    }
+    if (store->num_entry_readers > 0) {
+        index_store_queue_path_changes_locked(store, paths, true, rescan_manager);
+        return;
+    }
+    index_store_remove_paths_locked(store, paths, rescan_manager);
+}
 
-            // Optimization: Only try to remove if the path falls under this index's root
-            if (g_str_has_prefix(path, root_path)) {
-                bool root_removed = false;
-                if (fsearch_database_index_remove_path(index, path, &root_removed)) {
-                    content_changed = true;
-                }
+void
+fsearch_database_index_store_refresh_paths(FsearchDatabaseIndexStore *store,
+                                           GPtrArray *item_paths,
+                                           FsearchDatabaseRescanManager *rescan_manager) {
+    g_return_if_fail(store);
+    g_return_if_fail(item_paths);
 
-                // Handle the offline edge case
-                if (root_removed && rescan_manager) {
-                    fsearch_database_rescan_manager_notify_index_offline(rescan_manager,
-                                                                         fsearch_database_index_get_path(index));
-                }
-            }
-        }
-    }
-    if (content_changed) {
-        index_store_content_changed(store);
+    if (store->num_entry_readers > 0) {
+        index_store_queue_path_changes_locked(store, item_paths, false, rescan_manager);
+        return;
     }
+    index_store_refresh_paths_locked(store, item_paths, rescan_manager);
+}
+
+void
+fsearch_database_index_store_wait_for_entry_readers(FsearchDatabaseIndexStore *store) {
+    g_return_if_fail(store);
+    index_store_wait_for_entry_readers_locked(store);
 }
 
 GMutexLocker *
@@ -1187,6 +2114,21 @@ fsearch_database_index_store_unlock(FsearchDatabaseIndexStore *store) {
 }
 
 /* Data Accessors */
+static void
+index_store_request_sort_index(FsearchDatabaseIndexStore *store, FsearchDatabaseIndexProperty sort_order) {
+    if (!store->lazy_sort_indices && !(store->deferred_sort_indices & (1u << sort_order))) {
+        return;
+    }
+    for (uint32_t i = 0; i < G_N_ELEMENTS(index_store_sort_orders); ++i) {
+        if (index_store_sort_orders[i] == sort_order) {
+            store->requested_sort_indices |= 1u << sort_order;
+            store->dropped_sort_indices &= ~(1u << sort_order);
+            index_store_schedule_lazy_sort_indices(store, G_PRIORITY_DEFAULT);
+            return;
+        }
+    }
+}
+
 FsearchDatabaseChunkedArray *
 fsearch_database_index_store_get_files(FsearchDatabaseIndexStore *store, FsearchDatabaseIndexProperty sort_order) {
     g_return_val_if_fail(store, NULL);
@@ -1194,8 +2136,12 @@ fsearch_database_index_store_get_files(FsearchDatabaseIndexStore *store, Fsearch
     if (!store->is_sorted) {
         return NULL;
     }
+    if (!store->file_chunks[sort_order]) {
+        index_store_request_sort_index(store, sort_order);
+        return NULL;
+    }
 
-    return store->file_chunks[sort_order] ? fsearch_database_chunked_array_ref(store->file_chunks[sort_order]) : NULL;
+    return fsearch_database_chunked_array_ref(store->file_chunks[sort_order]);
 }
 
 FsearchDatabaseChunkedArray *
@@ -1204,8 +2150,12 @@ fsearch_database_index_store_get_folders(FsearchDatabaseIndexStore *store, Fsear
     if (!store->is_sorted) {
         return NULL;
     }
+    if (!store->folder_chunks[sort_order]) {
+        index_store_request_sort_index(store, sort_order);
+        return NULL;
+    }
 
-    return store->folder_chunks[sort_order] ? fsearch_database_chunked_array_ref(store->folder_chunks[sort_order]) : NULL;
+    return fsearch_database_chunked_array_ref(store->folder_chunks[sort_order]);
 }
 
 FsearchDatabaseIndexPropertyFlags
@@ -1244,6 +2194,17 @@ fsearch_database_index_store_get_exclude_manager(FsearchDatabaseIndexStore *stor
     return g_object_ref(store->exclude_manager);
 }
 
+GPtrArray *
+fsearch_database_index_store_get_indices(FsearchDatabaseIndexStore *store) {
+    g_return_val_if_fail(store, NULL);
+
+    GPtrArray *indices = g_ptr_array_new_with_free_func((GDestroyNotify)fsearch_database_index_unref);
+    for (uint32_t i = 0; store->indices && i < store->indices->len; ++i) {
+        g_ptr_array_add(indices, fsearch_database_index_ref(g_ptr_array_index(store->indices, i)));
+    }
+    return indices;
+}
+
 FsearchDatabaseSearchView *
 fsearch_database_index_store_get_search_view(FsearchDatabaseIndexStore *store, uint32_t view_id) {
     g_return_val_if_fail(store, NULL);
@@ -1287,6 +2248,149 @@ fsearch_database_index_store_get_num_fast_sort_indices(FsearchDatabaseIndexStore
     return num_fast_sort_indices;
 }
 
+void
+fsearch_database_index_store_set_lazy_sort_indices(FsearchDatabaseIndexStore *store, bool lazy_sort_indices) {
+    g_return_if_fail(store);
+    store->lazy_sort_indices = lazy_sort_indices;
+}
+
+// Stops waiting for the deferred sort index `sort_order`. The changes of the store aren't recorded anymore once none of
+// them is left.
+static void
+index_store_clear_deferred_sort_index(FsearchDatabaseIndexStore *store, FsearchDatabaseIndexProperty sort_order) {
+    store->deferred_sort_indices &= ~(1u << sort_order);
+    if (!store->deferred_sort_indices) {
+        g_clear_pointer(&store->deferred_sort_index_updates, index_store_pending_updates_free);
+    }
+}
+
+void
+fsearch_database_index_store_drop_sort_index(FsearchDatabaseIndexStore *store, FsearchDatabaseIndexProperty sort_order) {
+    g_return_if_fail(store);
+    g_return_if_fail(sort_order < NUM_DATABASE_INDEX_PROPERTIES);
+
+    if (sort_order == DATABASE_INDEX_PROPERTY_NAME) {
+        // Searches and the lazily built indices rely on it
+        return;
+    }
+
+    store->requested_sort_indices &= ~(1u << sort_order);
+    store->dropped_sort_indices |= 1u << sort_order;
+    index_store_clear_deferred_sort_index(store, sort_order);
+    g_clear_pointer(&store->file_chunks[sort_order], fsearch_database_chunked_array_unref);
+    g_clear_pointer(&store->folder_chunks[sort_order], fsearch_database_chunked_array_unref);
+}
+
+FsearchDatabaseIndexProperty
+fsearch_database_index_store_get_next_deferred_sort_index(FsearchDatabaseIndexStore *store) {
+    g_return_val_if_fail(store, DATABASE_INDEX_PROPERTY_NONE);
+
+    // The ones which were already requested are waited for
+    for (uint32_t pass = 0; pass < 2; ++pass) {
+        for (uint32_t i = 0; i < G_N_ELEMENTS(index_store_sort_orders); ++i) {
+            const FsearchDatabaseIndexProperty sort_order = index_store_sort_orders[i];
+            const uint32_t mask = pass == 0 ? store->requested_sort_indices : UINT32_MAX;
+            if (store->deferred_sort_indices & mask & (1u << sort_order)) {
+                return sort_order;
+            }
+        }
+    }
+    return DATABASE_INDEX_PROPERTY_NONE;
+}
+
+GHashTable *
+fsearch_database_index_store_get_removed_entries(FsearchDatabaseIndexStore *store,
+                                                 FsearchDatabaseIndexProperty sort_order) {
+    g_return_val_if_fail(store, NULL);
+    g_return_val_if_fail(sort_order < NUM_DATABASE_INDEX_PROPERTIES, NULL);
+
+    GHashTable *removed_entries = g_hash_table_new(g_direct_hash, g_direct_equal);
+    IndexStorePendingUpdates *updates = store->deferred_sort_index_updates;
+    if (!updates) {
+        return removed_entries;
+    }
+    GHashTable *removed[] = {updates->removed_files, updates->removed_folders};
+    for (uint32_t i = 0; i < G_N_ELEMENTS(removed); ++i) {
+        GHashTableIter iter;
+        gpointer entry = NULL;
+        gpointer flags = NULL;
+        g_hash_table_iter_init(&iter, removed[i]);
+        while (g_hash_table_iter_next(&iter, &entry, &flags)) {
+            if (fsearch_database_index_property_is_set(GPOINTER_TO_UINT(flags), sort_order)) {
+                g_hash_table_add(removed_entries, entry);
+            }
+        }
+    }
+    return removed_entries;
+}
+
+bool
+fsearch_database_index_store_add_sort_index(FsearchDatabaseIndexStore *store,
+                                            FsearchDatabaseIndexProperty sort_order,
+                                            DynamicArray *files,
+                                            DynamicArray *folders) {
+    g_return_val_if_fail(store, false);
+    g_return_val_if_fail(sort_order < NUM_DATABASE_INDEX_PROPERTIES, false);
+
+    const uint32_t mask = 1u << sort_order;
+    if (!(store->deferred_sort_indices & mask)) {
+        return false;
+    }
+    store->deferred_sort_indices &= ~mask;
+    // The changes are still needed by the other deferred indices, unless this was the last one
+    g_autoptr(IndexStorePendingUpdates) last_updates = !store->deferred_sort_indices
+                                                         ? g_steal_pointer(&store->deferred_sort_index_updates)
+                                                         : NULL;
+    IndexStorePendingUpdates *updates = last_updates ? last_updates : store->deferred_sort_index_updates;
+
+    if (!files || !folders || store->file_chunks[sort_order] || store->folder_chunks[sort_order]) {
+        if (!store->file_chunks[sort_order] || !store->folder_chunks[sort_order]) {
+            g_debug("[index_store] loading the %s index failed, building it instead",
+                    fsearch_database_index_property_to_string(sort_order));
+            store->requested_sort_indices |= mask;
+            index_store_schedule_lazy_sort_indices(store, G_PRIORITY_LOW);
+        }
+        return false;
+    }
+
+    g_autoptr(FsearchDatabaseChunkedArray) folder_chunks = fsearch_database_chunked_array_new(
+        folders,
+        TRUE,
+        fsearch_database_sort_order_chain_for_property(sort_order),
+        DATABASE_ENTRY_TYPE_FOLDER,
+        NULL,
+        NULL);
+    g_autoptr(FsearchDatabaseChunkedArray) file_chunks = fsearch_database_chunked_array_new(
+        files,
+        TRUE,
+        fsearch_database_sort_order_chain_for_property(sort_order),
+        DATABASE_ENTRY_TYPE_FILE,
+        NULL,
+        NULL);
+    if (updates) {
+        // The entries which were added or changed while it was loaded
+        index_store_apply_updates_worker(folder_chunks, updates, sort_order, DATABASE_ENTRY_TYPE_FOLDER);
+        index_store_apply_updates_worker(file_chunks, updates, sort_order, DATABASE_ENTRY_TYPE_FILE);
+    }
+    store->folder_chunks[sort_order] = g_steal_pointer(&folder_chunks);
+    store->file_chunks[sort_order] = g_steal_pointer(&file_chunks);
+    store->requested_sort_indices &= ~mask;
+    return true;
+}
+
+GPtrArray *
+fsearch_database_index_store_begin_reading_entries(FsearchDatabaseIndexStore *store) {
+    g_return_val_if_fail(store, NULL);
+    index_store_wait_to_read_entries_locked(store);
+    return index_store_begin_reading_entries_locked(store);
+}
+
+void
+fsearch_database_index_store_end_reading_entries(FsearchDatabaseIndexStore *store) {
+    g_return_if_fail(store);
+    index_store_end_reading_entries_locked(store);
+}
+
 FsearchDatabaseSearchInfo *
 fsearch_database_index_store_get_search_info(FsearchDatabaseIndexStore *store, uint32_t id) {
     g_return_val_if_fail(store, NULL);
@@ -1325,6 +2429,70 @@ fsearch_database_index_store_sort_results(FsearchDatabaseIndexStore *store,
     fsearch_database_search_view_sort(view, files_fast_sorted, folders_fast_sorted, sort_order, sort_type, cancellable);
 }
 
+GPtrArray *
+fsearch_database_index_store_get_sort_preview(FsearchDatabaseIndexStore *store,
+                                              uint32_t id,
+                                              FsearchDatabaseIndexProperty sort_order,
+                                              GtkSortType sort_type,
+                                              uint32_t num_rows,
+                                              FsearchDatabaseSearchInfo **info_out,
+                                              GCancellable *cancellable) {
+    g_return_val_if_fail(store, NULL);
+    g_return_val_if_fail(info_out, NULL);
+
+    FsearchDatabaseSearchView *view = fsearch_database_index_store_get_search_view(store, id);
+    if (!view) {
+        return NULL;
+    }
+
+    g_autoptr(FsearchDatabaseChunkedArray) files_fast_sort_index = fsearch_database_index_store_get_files(store,
+                                                                                                          sort_order);
+    g_autoptr(FsearchDatabaseChunkedArray) folders_fast_sort_index = fsearch_database_index_store_get_folders(store,
+                                                                                                              sort_order);
+    if (files_fast_sort_index && folders_fast_sort_index) {
+        // Sorting with the fast sort indices doesn't take long enough to need a preview
+        return NULL;
+    }
+
+    g_autoptr(FsearchDatabaseSearchInfo) info = fsearch_database_search_view_get_info(view);
+    if (fsearch_database_search_info_get_num_entries(info) < THRESHOLD_FOR_SORT_PREVIEW) {
+        return NULL;
+    }
+
+    g_autoptr(DynamicArray) entries = fsearch_database_search_view_get_sort_preview(view,
+                                                                                    sort_order,
+                                                                                    sort_type,
+                                                                                    num_rows,
+                                                                                    cancellable);
+    if (!entries) {
+        return NULL;
+    }
+
+    g_autoptr(FsearchQuery) query = fsearch_database_search_view_get_query(view);
+    GPtrArray *infos = g_ptr_array_new_full(darray_get_num_items(entries),
+                                            (GDestroyNotify)fsearch_database_entry_info_unref);
+    for (uint32_t i = 0; i < darray_get_num_items(entries); ++i) {
+        FsearchDatabaseEntry *entry = darray_get_item(entries, i);
+        g_ptr_array_add(infos,
+                        fsearch_database_entry_info_new(entry,
+                                                        query,
+                                                        i,
+                                                        fsearch_database_search_view_is_selected(view, entry),
+                                                        FSEARCH_DATABASE_ENTRY_INFO_FLAG_ALL));
+    }
+
+    *info_out = fsearch_database_search_info_new(id,
+                                                 query,
+                                                 fsearch_database_search_info_get_num_files(info),
+                                                 fsearch_database_search_info_get_num_folders(info),
+                                                 fsearch_database_search_info_get_num_files_selected(info),
+                                                 fsearch_database_search_info_get_num_folders_selected(info),
+                                                 sort_order,
+                                                 sort_type,
+                                                 fsearch_database_search_info_get_is_complete(info));
+    return infos;
+}
+
 static DynamicArray *
 collect_search_results(DynamicArray *pool_data_array) {
     uint32_t num_entries_found = 0;
@@ -1344,18 +2512,19 @@ collect_search_results(DynamicArray *pool_data_array) {
     return g_steal_pointer(&search_entries);
 }
 
-static inline uint32_t
-sub_or_zero_u32(uint32_t a, uint32_t b) {
-    return a > b ? a - b : 0;
-}
-
+// Searches the entries of all chunks in `chunks` in order. The threads get ranges of roughly the same number of
+// entries, which can start and end in the middle of a chunk, so the chunks don't have to be joined first.
 static DynamicArray *
 search_entries(FsearchQuery *query,
-               DynamicArray *in,
+               DynamicArray *chunks,
                GThreadPool *pool,
                GAsyncQueue *collect_queue,
                GCancellable *cancellable) {
-    const uint32_t num_entries = darray_get_num_items(in);
+    uint32_t num_entries = 0;
+    const uint32_t num_chunks = darray_get_num_items(chunks);
+    for (uint32_t i = 0; i < num_chunks; ++i) {
+        num_entries += idarray_get_num_items(darray_get_item(chunks, i));
+    }
     if (num_entries == 0) {
         return darray_new(0);
     }
@@ -1367,26 +2536,39 @@ search_entries(FsearchQuery *query,
     const uint32_t num_items_per_thread = num_entries / clamped_num_threads;
     g_autoptr(DynamicArray) pool_data_array = darray_new_full(clamped_num_threads, (GDestroyNotify)g_free);
 
-    uint32_t start_pos = 0;
-    uint32_t end_pos = sub_or_zero_u32(num_items_per_thread, 1);
-    const uint32_t last_end_pos = sub_or_zero_u32(num_entries, 1);
-
+    uint32_t chunk_idx = 0;
+    uint32_t start_idx = 0;
     for (uint32_t i = 0; i < clamped_num_threads; ++i) {
+        const uint32_t num_items = i == clamped_num_threads - 1
+                                     ? num_entries - i * num_items_per_thread
+                                     : num_items_per_thread;
+
         IndexStoreWorkerPoolData *pool_data = g_new0(IndexStoreWorkerPoolData, 1);
         pool_data->type = INDEX_STORE_WORKER_POOL_DATA_TYPE_SEARCH;
-        pool_data->search.in = in;
+        pool_data->search.in = chunks;
         pool_data->search.query = query;
         pool_data->search.cancellable = cancellable;
         pool_data->search.thread_id = (int32_t)i;
-        pool_data->search.in_start_idx = start_pos;
-        pool_data->search.in_end_idx = i == clamped_num_threads - 1 ? last_end_pos : end_pos;
-        pool_data->search.out = darray_new(end_pos - start_pos + 1);
+        pool_data->search.in_chunk_idx = chunk_idx;
+        pool_data->search.in_start_idx = start_idx;
+        pool_data->search.in_num_entries = num_items;
+        pool_data->search.out = darray_new(num_items);
 
         darray_add_item(pool_data_array, pool_data);
         g_thread_pool_push(pool, pool_data, NULL);
 
-        start_pos = end_pos + 1;
-        end_pos += num_items_per_thread;
+        // Advance to where the next thread has to start
+        uint32_t num_skipped = 0;
+        while (chunk_idx < num_chunks) {
+            const uint32_t num_left_in_chunk = idarray_get_num_items(darray_get_item(chunks, chunk_idx)) - start_idx;
+            if (num_skipped + num_left_in_chunk > num_items) {
+                start_idx += num_items - num_skipped;
+                break;
+            }
+            num_skipped += num_left_in_chunk;
+            chunk_idx++;
+            start_idx = 0;
+        }
     }
 
     uint32_t num_threads_collected = 0;
@@ -1398,6 +2580,74 @@ search_entries(FsearchQuery *query,
     return collect_search_results(pool_data_array);
 }
 
+// Searches a plain array of entries, e.g. the results of a previous search
+static DynamicArray *
+search_entries_in_array(FsearchQuery *query,
+                        DynamicArray *entries,
+                        GThreadPool *pool,
+                        GAsyncQueue *collect_queue,
+                        GCancellable *cancellable) {
+    DynamicIdArray *chunk = idarray_new(darray_get_num_items(entries));
+    idarray_add_darray(chunk, entries);
+
+    g_autoptr(DynamicArray) chunks = darray_new_full(1, (GDestroyNotify)idarray_unref);
+    darray_add_item(chunks, chunk);
+    return search_entries(query, chunks, pool, collect_queue, cancellable);
+}
+
+// Collects the entries which can match `node` with range lookups on the name sorted index. Returns false if that's not
+// possible, e.g. because the name index isn't available.
+static bool
+index_store_get_name_range_candidates(FsearchDatabaseIndexStore *store,
+                                      FsearchQueryNode *node,
+                                      DynamicArray **files_out,
+                                      DynamicArray **folders_out) {
+    if (!node->name_range_key) {
+        return false;
+    }
+    g_autoptr(FsearchDatabaseChunkedArray) file_chunks = fsearch_database_index_store_get_files(store,
+                                                                                                DATABASE_INDEX_PROPERTY_NAME);
+    g_autoptr(FsearchDatabaseChunkedArray) folder_chunks = fsearch_database_index_store_get_folders(
+        store,
+        DATABASE_INDEX_PROPERTY_NAME);
+    if (!file_chunks || !folder_chunks) {
+        return false;
+    }
+
+    DynamicArray *files = darray_new(128);
+    DynamicArray *folders = darray_new(128);
+    const bool ignore_case = !(node->flags & QUERY_FLAG_MATCH_CASE);
+    fsearch_database_chunked_array_get_name_range(file_chunks,
+                                                  node->name_range_key,
+                                                  node->name_range_key_is_exact,
+                                                  ignore_case,
+                                                  files);
+    fsearch_database_chunked_array_get_name_range(folder_chunks,
+                                                  node->name_range_key,
+                                                  node->name_range_key_is_exact,
+                                                  ignore_case,
+                                                  folders);
+    *files_out = files;
+    *folders_out = folders;
+    return true;
+}
+
+// Sorts results which were found in the name index by `sort_order`
+static void
+index_store_sort_name_ordered_results(DynamicArray *entries,
+                                      FsearchDatabaseIndexProperty sort_order,
+                                      GCancellable *cancellable) {
+    if (!entries || sort_order == DATABASE_INDEX_PROPERTY_NAME) {
+        return;
+    }
+    if (fsearch_database_sort_entries_by_numeric_key(entries, sort_order, cancellable)) {
+        return;
+    }
+    g_autoptr(FsearchDatabaseEntryCompareContext) ctx = db_entry_compare_context_new(
+        fsearch_database_sort_order_chain_for_property(sort_order));
+    darray_sort(entries, (DynamicArrayCompareDataFunc)db_entry_compare_entries_by_chain, cancellable, ctx);
+}
+
 bool
 fsearch_database_index_store_search(FsearchDatabaseIndexStore *store,
                                     uint32_t id,
@@ -1413,12 +2663,15 @@ fsearch_database_index_store_search(FsearchDatabaseIndexStore *store,
     g_autoptr(FsearchDatabaseChunkedArray) file_chunks = fsearch_database_index_store_get_files(store, sort_order);
     g_autoptr(FsearchDatabaseChunkedArray) folder_chunks = fsearch_database_index_store_get_folders(store, sort_order);
 
+    // The index for `sort_order` might not be built yet (or was dropped), in that case we search the name index and
+    // sort the results afterwards
+    bool needs_manual_sort = false;
     if (!file_chunks && !folder_chunks) {
         g_debug("[index_store] no fast sort index for sort order %s, falling back to name",
                 fsearch_database_index_property_to_string(sort_order));
-        sort_order = DATABASE_INDEX_PROPERTY_NAME;
-        file_chunks = fsearch_database_index_store_get_files(store, sort_order);
-        folder_chunks = fsearch_database_index_store_get_folders(store, sort_order);
+        needs_manual_sort = sort_order != DATABASE_INDEX_PROPERTY_NAME;
+        file_chunks = fsearch_database_index_store_get_files(store, DATABASE_INDEX_PROPERTY_NAME);
+        folder_chunks = fsearch_database_index_store_get_folders(store, DATABASE_INDEX_PROPERTY_NAME);
     }
 
     if (!file_chunks && !folder_chunks) {
@@ -1426,34 +2679,84 @@ fsearch_database_index_store_search(FsearchDatabaseIndexStore *store,
         return false;
     }
 
-    // TODO: Search performance increase
-    // Avoid joining chunks together for searching. It's most certainly more efficient to search in the chunks directly.
-    // We just need to make sure that the search threads get a roughly equally sized range to search in.
-    g_autoptr(DynamicArray) files = file_chunks ? fsearch_database_chunked_array_get_joined(file_chunks) : NULL;
-    g_autoptr(DynamicArray) folders = folder_chunks ? fsearch_database_chunked_array_get_joined(folder_chunks) : NULL;
-
-    const uint32_t num_searched = (files ? darray_get_num_items(files) : 0)
-                                + (folders ? darray_get_num_items(folders) : 0);
-
     const bool matches_everything = fsearch_query_matches_everything(query);
+
+    g_autoptr(DynamicArray) files = NULL;
+    g_autoptr(DynamicArray) folders = NULL;
+
+    // While typing, every query usually extends the previous one, so only the previous results can match it
+    FsearchDatabaseSearchView *previous_view = fsearch_database_index_store_get_search_view(store, id);
+    const bool uses_previous_results = !matches_everything && previous_view
+                                    && fsearch_database_search_view_get_refinable_results(previous_view,
+                                                                                          query,
+                                                                                          sort_order,
+                                                                                          &files,
+                                                                                          &folders);
+
+    // Queries like `exact:Makefile` or `^foo` can only match entries from a few ranges of the name index, so we
+    // only need to evaluate the query for those entries instead of all of them.
+    const bool uses_name_range = !matches_everything && !uses_previous_results && query->name_range_node
+                              && index_store_get_name_range_candidates(store, query->name_range_node, &files, &folders);
+    const bool searches_index = !uses_name_range && !uses_previous_results;
+    if (searches_index && matches_everything) {
+        // Every entry is a result, so the joined index is what we need anyway
+        files = file_chunks ? fsearch_database_chunked_array_get_joined(file_chunks) : NULL;
+        folders = folder_chunks ? fsearch_database_chunked_array_get_joined(folder_chunks) : NULL;
+    }
+
+    uint32_t num_searched = 0;
     g_autoptr(DynamicArray) found_files = NULL;
-    if (files) {
-        found_files = matches_everything
-                        ? g_steal_pointer(&files)
-                        : search_entries(query, files, store->worker_pool, store->worker_pool_collect_queue, cancellable);
-    }
     g_autoptr(DynamicArray) found_folders = NULL;
-    if (folders) {
-        found_folders = matches_everything
-                          ? g_steal_pointer(&folders)
-                          : search_entries(query, folders, store->worker_pool, store->worker_pool_collect_queue, cancellable);
+    if (searches_index && !matches_everything) {
+        // Search the chunks of the index directly, instead of copying all of its entries into a joined array first
+        if (file_chunks) {
+            g_autoptr(DynamicArray) chunks = fsearch_database_chunked_array_get_chunks(file_chunks);
+            num_searched += fsearch_database_chunked_array_get_num_entries(file_chunks);
+            found_files = search_entries(query, chunks, store->worker_pool, store->worker_pool_collect_queue, cancellable);
+        }
+        if (folder_chunks) {
+            g_autoptr(DynamicArray) chunks = fsearch_database_chunked_array_get_chunks(folder_chunks);
+            num_searched += fsearch_database_chunked_array_get_num_entries(folder_chunks);
+            found_folders = search_entries(query,
+                                           chunks,
+                                           store->worker_pool,
+                                           store->worker_pool_collect_queue,
+                                           cancellable);
+        }
+    }
+    else {
+        num_searched = (files ? darray_get_num_items(files) : 0) + (folders ? darray_get_num_items(folders) : 0);
+        if (files) {
+            found_files = matches_everything ? g_steal_pointer(&files)
+                                             : search_entries_in_array(query,
+                                                                       files,
+                                                                       store->worker_pool,
+                                                                       store->worker_pool_collect_queue,
+                                                                       cancellable);
+        }
+        if (folders) {
+            found_folders = matches_everything ? g_steal_pointer(&folders)
+                                               : search_entries_in_array(query,
+                                                                         folders,
+                                                                         store->worker_pool,
+                                                                         store->worker_pool_collect_queue,
+                                                                         cancellable);
+        }
+    }
+
+    // Previous results are already in `sort_order`
+    needs_manual_sort = needs_manual_sort && !uses_previous_results;
+    if (uses_name_range || needs_manual_sort) {
+        // The candidates are in name order, but the view expects them in `sort_order`
+        index_store_sort_name_ordered_results(found_files, sort_order, cancellable);
+        index_store_sort_name_ordered_results(found_folders, sort_order, cancellable);
     }
 
     const uint32_t num_found_files = found_files ? darray_get_num_items(found_files) : 0;
     const uint32_t num_found_folders = found_folders ? darray_get_num_items(found_folders) : 0;
     const double search_time = g_timer_elapsed(timer, NULL);
 
-    g_debug("[index_store] search \"%s\": %u of %u matched (%u folder%s, %u file%s) in %.3f ms%s%s",
+    g_debug("[index_store] search \"%s\": %u of %u matched (%u folder%s, %u file%s) in %.3f ms%s%s%s%s%s",
             query->search_term ? query->search_term : "",
             num_found_folders + num_found_files,
             num_searched,
@@ -1463,8 +2766,16 @@ fsearch_database_index_store_search(FsearchDatabaseIndexStore *store,
             num_found_files == 1 ? "" : "s",
             search_time * 1000.0,
             matches_everything ? ", match-all" : "",
+            uses_name_range ? ", name range" : "",
+            uses_previous_results ? ", refined previous results" : "",
+            needs_manual_sort ? ", sorted manually" : "",
             g_cancellable_is_cancelled(cancellable) ? ", cancelled" : "");
 
+    if (fsearch_query_get_profile(query)) {
+        g_autofree char *profile_string = fsearch_query_get_profile_string(query);
+        g_debug("[index_store] search profile:\n%s", profile_string);
+    }
+
     if (found_files || found_folders) {
         // If the search got cancelled partway through, found_files/found_folders only reflect
         // whatever was matched before that happened. We still install them (rather than
@@ -1472,8 +2783,8 @@ fsearch_database_index_store_search(FsearchDatabaseIndexStore *store,
         // result set apart from a genuinely finished search.
         const bool is_complete = !g_cancellable_is_cancelled(cancellable);
 
-        // We only ever search in pre-sorted (fast-indexed) arrays, so the canonical chain for
-        // `sort_order` alone already fully describes the result order.
+        // We only ever search in pre-sorted (fast-indexed) arrays or sort the results by the same chain
+        // afterwards, so the canonical chain for `sort_order` alone already fully describes the result order.
         FsearchDatabaseSearchView *view = fsearch_database_search_view_new(id,
                                                                            query,
                                                                            found_files,
@@ -31,6 +31,8 @@ typedef enum {
     FSEARCH_DATABASE_INDEX_STORE_EVENT_VIEW_CHANGED,
     FSEARCH_DATABASE_INDEX_STORE_EVENT_APPLY_STARTED,
     FSEARCH_DATABASE_INDEX_STORE_EVENT_APPLY_FINISHED,
+    // A file system event was applied to the path passed as `data` (a const char *, owned by the store)
+    FSEARCH_DATABASE_INDEX_STORE_EVENT_PATH_CHANGED,
     NUM_FSEARCH_DATABASE_STORE_EVENTS,
 } FsearchDatabaseIndexStoreEventKind;
 
@@ -47,6 +49,8 @@ fsearch_database_index_store_new(FsearchDatabaseIncludeManager *include_manager,
                                  FsearchDatabaseIndexStoreEventFunc event_func,
                                  gpointer event_func_data);
 
+// Creates a running store from already sorted content. The missing sort indices of `deferred_sort_indices` are
+// loaded by the caller in the background and handed over with fsearch_database_index_store_add_sort_index().
 FsearchDatabaseIndexStore *
 fsearch_database_index_store_new_with_content(GPtrArray *indices,
                                               DynamicArray **files,
@@ -54,6 +58,7 @@ fsearch_database_index_store_new_with_content(GPtrArray *indices,
                                               FsearchDatabaseIncludeManager *include_manager,
                                               FsearchDatabaseExcludeManager *exclude_manager,
                                               FsearchDatabaseIndexPropertyFlags flags,
+                                              FsearchDatabaseIndexPropertyFlags deferred_sort_indices,
                                               FsearchDatabaseIndexStoreEventFunc event_func,
                                               gpointer event_func_data);
 
@@ -80,12 +85,75 @@ fsearch_database_index_store_create_index_for_rescan(FsearchDatabaseIndexStore *
 bool
 fsearch_database_index_store_replace_index(FsearchDatabaseIndexStore *store, FsearchDatabaseIndex *new_index);
 
+// Lets the scans of the indices record their progress in `checkpoint_dir`, so they can be resumed
+void
+fsearch_database_index_store_set_checkpoint_dir(FsearchDatabaseIndexStore *store, const char *checkpoint_dir);
+
 void
 fsearch_database_index_store_remove_paths(FsearchDatabaseIndexStore *store,
                                           DynamicArray *item_paths,
                                           FsearchDatabaseRescanManager *rescan_manager);
 
+// Reads every path of `item_paths` from disk again and updates the indices which contain it accordingly. Store must be
+// locked. While a sort index is built from the entries, the paths are queued and only refreshed once it's done.
+void
+fsearch_database_index_store_refresh_paths(FsearchDatabaseIndexStore *store,
+                                           GPtrArray *item_paths,
+                                           FsearchDatabaseRescanManager *rescan_manager);
+
+// Waits until no sort index is built or loaded from the entries anymore, so the indices can be locked. Store must be locked, it's
+// released while waiting.
+void
+fsearch_database_index_store_wait_for_entry_readers(FsearchDatabaseIndexStore *store);
+
+// In lazy mode only the name index is built when the store is started. The other fast sort indices are built in the
+// background afterwards, or first when they're requested with get_files()/get_folders(), which return NULL until
+// they're available. Enabled by default when FSEARCH_LAZY_SORT_INDICES is set. Must be called before starting the
+// store.
+void
+fsearch_database_index_store_set_lazy_sort_indices(FsearchDatabaseIndexStore *store, bool lazy_sort_indices);
+
+// Frees the fast sort index for `sort_order`, it won't be rebuilt until it's requested again. The name index can't be
+// dropped. Store must be locked.
+void
+fsearch_database_index_store_drop_sort_index(FsearchDatabaseIndexStore *store, FsearchDatabaseIndexProperty sort_order);
+
+// Returns the deferred sort index which should be loaded next, the requested ones first, or
+// DATABASE_INDEX_PROPERTY_NONE if all of them were added. Store must be locked.
+FsearchDatabaseIndexProperty
+fsearch_database_index_store_get_next_deferred_sort_index(FsearchDatabaseIndexStore *store);
+
+// Returns the set of entries which were removed from the sort index `sort_order` since the store was created. They
+// might be freed already, so they must be dropped from a deferred sort index before its entries are read. Store must
+// be locked.
+GHashTable *
+fsearch_database_index_store_get_removed_entries(FsearchDatabaseIndexStore *store,
+                                                 FsearchDatabaseIndexProperty sort_order);
+
+// Adds the deferred sort index for `sort_order`, the arrays are copied. They must not contain the entries returned by
+// get_removed_entries(), the entries which were added or changed since the store was created are merged in. If `files`
+// or `folders` is NULL because loading failed, the index is built on the worker thread instead and false is returned.
+// Store must be locked.
+bool
+fsearch_database_index_store_add_sort_index(FsearchDatabaseIndexStore *store,
+                                            FsearchDatabaseIndexProperty sort_order,
+                                            DynamicArray *files,
+                                            DynamicArray *folders);
+
+// Locks the indices, so their entries can be read without holding the store lock, and returns them. Waits until
+// nobody else does that or waits for it, with the store lock released. Until end_reading_entries() is called, removed
+// or refreshed paths are queued and file system events are held back. Store must be locked.
+GPtrArray *
+fsearch_database_index_store_begin_reading_entries(FsearchDatabaseIndexStore *store);
+
+// Applies the changes which were queued since begin_reading_entries(). The indices it returned must be unlocked before
+// the store is locked again. Store must be locked.
+void
+fsearch_database_index_store_end_reading_entries(FsearchDatabaseIndexStore *store);
+
 // Getters
+// Returns NULL if there's no fast sort index for `sort_order` (yet). In lazy mode, or while it's still being loaded
+// from the database file, the missing index gets requested, so the store must be locked.
 FsearchDatabaseChunkedArray *
 fsearch_database_index_store_get_files(FsearchDatabaseIndexStore *store, FsearchDatabaseIndexProperty sort_order);
 
@@ -107,6 +175,10 @@ fsearch_database_index_store_get_include_manager(FsearchDatabaseIndexStore *stor
 FsearchDatabaseExcludeManager *
 fsearch_database_index_store_get_exclude_manager(FsearchDatabaseIndexStore *store);
 
+// Returns references to all indices of the store. Store must be locked.
+GPtrArray *
+fsearch_database_index_store_get_indices(FsearchDatabaseIndexStore *store);
+
 uint32_t
 fsearch_database_index_store_get_num_fast_sort_indices(FsearchDatabaseIndexStore *store);
 
@@ -144,6 +216,20 @@ fsearch_database_index_store_sort_results(FsearchDatabaseIndexStore *store,
                                           FsearchDatabaseIndexProperty sort_order,
                                           GtkSortType sort_type,
                                           GCancellable *cancellable);
+
+// Returns the entry infos of the first `num_rows` rows of view `id` after it got sorted by `sort_order` and
+// `sort_type`, and the view's search info in that order in `info_out`. They can be shown while
+// fsearch_database_index_store_sort_results() does the full sort. Returns NULL if the sort is fast enough without a
+// preview, e.g. because there's a fast sort index for `sort_order`.
+GPtrArray *
+fsearch_database_index_store_get_sort_preview(FsearchDatabaseIndexStore *store,
+                                              uint32_t id,
+                                              FsearchDatabaseIndexProperty sort_order,
+                                              GtkSortType sort_type,
+                                              uint32_t num_rows,
+                                              FsearchDatabaseSearchInfo **info_out,
+                                              GCancellable *cancellable);
+
 bool
 fsearch_database_index_store_search(FsearchDatabaseIndexStore *store,
                                     uint32_t id,
@@ -0,0 +1,239 @@
+#define G_LOG_DOMAIN "fsearch-database-journal"
+
+#include "fsearch_database_journal.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <linux/limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define DATABASE_JOURNAL_MAGIC_NUMBER "FSJL"
+#define DATABASE_JOURNAL_VERSION 1
+#define DATABASE_JOURNAL_HEADER_SIZE 8
+
+struct FsearchDatabaseJournal {
+    char *file_path;
+    int fd;
+
+    // Records which weren't written yet
+    GByteArray *pending;
+    // Paths of the pending records
+    GHashTable *pending_paths;
+
+    uint64_t size;
+};
+
+static void
+journal_append_header(GByteArray *buffer) {
+    const uint32_t version = DATABASE_JOURNAL_VERSION;
+    g_byte_array_append(buffer, (const guint8 *)DATABASE_JOURNAL_MAGIC_NUMBER, 4);
+    g_byte_array_append(buffer, (const guint8 *)&version, sizeof(version));
+}
+
+// Parses the journal in `data`, `valid_size_out` is set to the length of the header and all complete records
+static GPtrArray *
+journal_parse(const uint8_t *data, size_t size, size_t *valid_size_out) {
+    if (size < DATABASE_JOURNAL_HEADER_SIZE || memcmp(data, DATABASE_JOURNAL_MAGIC_NUMBER, 4) != 0) {
+        return NULL;
+    }
+    uint32_t version = 0;
+    memcpy(&version, data + 4, sizeof(version));
+    if (version != DATABASE_JOURNAL_VERSION) {
+        g_debug("[journal] unsupported version: %u", version);
+        return NULL;
+    }
+
+    g_autoptr(GPtrArray) paths = g_ptr_array_new_with_free_func(g_free);
+    size_t offset = DATABASE_JOURNAL_HEADER_SIZE;
+    while (offset + sizeof(uint32_t) <= size) {
+        uint32_t path_len = 0;
+        memcpy(&path_len, data + offset, sizeof(path_len));
+        const size_t record_size = sizeof(path_len) + path_len;
+        // A crash while appending can leave a cut off record, or zeros, at the end of the file
+        if (path_len == 0 || path_len >= PATH_MAX || record_size > size - offset
+            || data[offset + sizeof(path_len)] != '/') {
+            break;
+        }
+        g_ptr_array_add(paths, g_strndup((const char *)data + offset + sizeof(path_len), path_len));
+        offset += record_size;
+    }
+
+    if (valid_size_out) {
+        *valid_size_out = offset;
+    }
+    return g_steal_pointer(&paths);
+}
+
+static bool
+journal_write_all(int fd, const uint8_t *data, size_t size) {
+    while (size > 0) {
+        const ssize_t written = write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        size -= written;
+    }
+    return true;
+}
+
+char *
+fsearch_database_journal_get_path(const char *db_file_path) {
+    g_return_val_if_fail(db_file_path, NULL);
+    return g_strconcat(db_file_path, ".journal", NULL);
+}
+
+FsearchDatabaseJournal *
+fsearch_database_journal_open(const char *file_path, bool truncate) {
+    g_return_val_if_fail(file_path, NULL);
+
+    size_t valid_size = 0;
+    if (!truncate) {
+        g_autofree char *contents = NULL;
+        gsize length = 0;
+        if (g_file_get_contents(file_path, &contents, &length, NULL)) {
+            g_autoptr(GPtrArray) paths = journal_parse((const uint8_t *)contents, length, &valid_size);
+            if (!paths) {
+                valid_size = 0;
+            }
+        }
+    }
+
+    const int fd = g_open(file_path, O_WRONLY | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        g_debug("[journal] failed to open %s: %s", file_path, g_strerror(errno));
+        return NULL;
+    }
+
+    // Drop a cut off record, so new records don't end up behind it
+    if (ftruncate(fd, (off_t)valid_size) != 0 || lseek(fd, 0, SEEK_END) < 0) {
+        g_debug("[journal] failed to truncate %s: %s", file_path, g_strerror(errno));
+        close(fd);
+        return NULL;
+    }
+
+    FsearchDatabaseJournal *self = g_new0(FsearchDatabaseJournal, 1);
+    self->file_path = g_strdup(file_path);
+    self->fd = fd;
+    self->pending = g_byte_array_new();
+    self->pending_paths = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    self->size = valid_size;
+
+    if (valid_size == 0) {
+        journal_append_header(self->pending);
+        self->size = self->pending->len;
+    }
+
+    return self;
+}
+
+void
+fsearch_database_journal_free(FsearchDatabaseJournal *self) {
+    g_return_if_fail(self);
+
+    fsearch_database_journal_flush(self);
+
+    if (self->fd >= 0) {
+        close(self->fd);
+        self->fd = -1;
+    }
+    g_clear_pointer(&self->pending, g_byte_array_unref);
+    g_clear_pointer(&self->pending_paths, g_hash_table_unref);
+    g_clear_pointer(&self->file_path, g_free);
+    g_clear_pointer(&self, g_free);
+}
+
+void
+fsearch_database_journal_append(FsearchDatabaseJournal *self, const char *path) {
+    g_return_if_fail(self);
+    g_return_if_fail(path);
+
+    const size_t path_len = strlen(path);
+    if (path_len == 0 || path_len >= PATH_MAX || path[0] != '/') {
+        return;
+    }
+    if (!g_hash_table_add(self->pending_paths, g_strdup(path))) {
+        // Already part of this batch, e.g. a file which got written to several times
+        return;
+    }
+
+    const uint32_t len = (uint32_t)path_len;
+    g_byte_array_append(self->pending, (const guint8 *)&len, sizeof(len));
+    g_byte_array_append(self->pending, (const guint8 *)path, len);
+    self->size += sizeof(len) + len;
+}
+
+bool
+fsearch_database_journal_flush(FsearchDatabaseJournal *self) {
+    g_return_val_if_fail(self, false);
+
+    if (self->pending->len == 0) {
+        return true;
+    }
+
+    const uint64_t flushed_size = self->size - self->pending->len;
+    bool res = journal_write_all(self->fd, self->pending->data, self->pending->len);
+    if (res) {
+        res = fdatasync(self->fd) == 0;
+    }
+    if (!res) {
+        g_debug("[journal] failed to write %s: %s", self->file_path, g_strerror(errno));
+        // Don't leave a partial batch in front of the records of the next one
+        if (ftruncate(self->fd, (off_t)flushed_size) == 0) {
+            lseek(self->fd, 0, SEEK_END);
+        }
+        self->size = flushed_size;
+    }
+
+    g_byte_array_set_size(self->pending, 0);
+    g_hash_table_remove_all(self->pending_paths);
+
+    if (self->size == 0) {
+        // The header never made it to the disk
+        journal_append_header(self->pending);
+        self->size = self->pending->len;
+    }
+
+    return res;
+}
+
+bool
+fsearch_database_journal_replace(FsearchDatabaseJournal *self, const char *file_path) {
+    g_return_val_if_fail(self, false);
+    g_return_val_if_fail(file_path, false);
+
+    if (g_rename(self->file_path, file_path) != 0) {
+        g_debug("[journal] failed to rename %s to %s: %s", self->file_path, file_path, g_strerror(errno));
+        return false;
+    }
+    g_free(self->file_path);
+    self->file_path = g_strdup(file_path);
+    return true;
+}
+
+uint64_t
+fsearch_database_journal_get_size(FsearchDatabaseJournal *self) {
+    g_return_val_if_fail(self, 0);
+    return self->size;
+}
+
+GPtrArray *
+fsearch_database_journal_load(const char *file_path) {
+    g_return_val_if_fail(file_path, NULL);
+
+    g_autofree char *contents = NULL;
+    gsize length = 0;
+    if (!g_file_get_contents(file_path, &contents, &length, NULL)) {
+        return NULL;
+    }
+    return journal_parse((const uint8_t *)contents, length, NULL);
+}
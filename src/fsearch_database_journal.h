@@ -0,0 +1,51 @@
+#pragma once
+
+#include <glib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+G_BEGIN_DECLS
+
+// Append-only log of the paths which were changed by file system events since the database file was last saved.
+// Replaying it means reading those paths from disk again, which makes it idempotent: records can be replayed over a
+// database file which already contains them, or more than once.
+typedef struct FsearchDatabaseJournal FsearchDatabaseJournal;
+
+// Returns the path of the journal which belongs to the database file `db_file_path`
+char *
+fsearch_database_journal_get_path(const char *db_file_path);
+
+// Opens the journal at `file_path` for appending. If `truncate` is set, or the file isn't a valid journal, it gets
+// replaced with an empty one.
+FsearchDatabaseJournal *
+fsearch_database_journal_open(const char *file_path, bool truncate);
+
+// Writes the records which haven't been flushed yet and closes the journal
+void
+fsearch_database_journal_free(FsearchDatabaseJournal *self);
+
+// Adds a record for `path`. Records are kept in memory until the next call to fsearch_database_journal_flush(), paths
+// which are already part of those are skipped.
+void
+fsearch_database_journal_append(FsearchDatabaseJournal *self, const char *path);
+
+// Writes all pending records and waits for them to reach the disk
+bool
+fsearch_database_journal_flush(FsearchDatabaseJournal *self);
+
+// Renames the journal file to `file_path`, replacing the file which is there
+bool
+fsearch_database_journal_replace(FsearchDatabaseJournal *self, const char *file_path);
+
+// Size of the journal file, including the pending records
+uint64_t
+fsearch_database_journal_get_size(FsearchDatabaseJournal *self);
+
+// Returns the paths recorded in the journal at `file_path` in the order they were appended, or NULL if there's no
+// valid journal. A partially written last record, left behind by a crash, is ignored.
+GPtrArray *
+fsearch_database_journal_load(const char *file_path);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(FsearchDatabaseJournal, fsearch_database_journal_free)
+
+G_END_DECLS
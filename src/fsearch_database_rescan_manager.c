@@ -4,6 +4,7 @@
 
 #include "fsearch_database_include.h"
 #include "fsearch_database_include_manager.h"
+#include "fsearch_database_scan_checkpoint.h"
 
 #include <glib.h>
 
@@ -22,6 +23,9 @@ struct _FsearchDatabaseRescanManager {
     GHashTable *active_scans;
     GHashTable *offline_indices;
 
+    // Where interrupted scans left their checkpoints
+    char *checkpoint_dir;
+
     gboolean global_scan_active;
 };
 
@@ -64,6 +68,7 @@ fsearch_database_rescan_manager_free(FsearchDatabaseRescanManager *self) {
     g_clear_pointer(&self->offline_indices, g_hash_table_unref);
     g_clear_object(&self->include_manager);
     g_clear_pointer(&self->context, g_main_context_unref);
+    g_clear_pointer(&self->checkpoint_dir, g_free);
     g_free(self);
 }
 
@@ -86,11 +91,33 @@ get_num_active_includes(FsearchDatabaseRescanManager *self) {
     return active_count;
 }
 
+static gboolean
+include_has_checkpoint(FsearchDatabaseRescanManager *self, FsearchDatabaseInclude *include) {
+    if (!self->checkpoint_dir) {
+        return FALSE;
+    }
+    const char *include_path = fsearch_database_include_get_path(include);
+    g_autofree char *checkpoint_path = fsearch_database_scan_checkpoint_get_path(self->checkpoint_dir, include_path);
+    return fsearch_database_scan_checkpoint_exists(checkpoint_path);
+}
+
+static gboolean
+any_include_has_checkpoint(FsearchDatabaseRescanManager *self, GPtrArray *includes) {
+    for (uint32_t i = 0; i < includes->len; i++) {
+        if (include_has_checkpoint(self, g_ptr_array_index(includes, i))) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
 static void
 request_scans(FsearchDatabaseRescanManager *self, GPtrArray *due_includes) {
     if (due_includes && due_includes->len > 0) {
         const guint num_active_includes = get_num_active_includes(self);
-        if (due_includes->len == num_active_includes) {
+        // A full scan only applies its result once all includes are done. Scanning them one by one keeps each
+        // resumed include once it's finished, even if the scans get interrupted again.
+        if (due_includes->len == num_active_includes && !any_include_has_checkpoint(self, due_includes)) {
             g_debug("[rescan_manager] all active indices need to be scanned. Perform a full scan.");
             fsearch_database_rescan_manager_request_full_scan(self);
         }
@@ -221,6 +248,14 @@ offline_poll_fired_cb(gpointer user_data) {
     return G_SOURCE_CONTINUE;
 }
 
+void
+fsearch_database_rescan_manager_set_checkpoint_dir(FsearchDatabaseRescanManager *self, const char *checkpoint_dir) {
+    g_return_if_fail(self != NULL);
+
+    g_free(self->checkpoint_dir);
+    self->checkpoint_dir = g_strdup(checkpoint_dir);
+}
+
 void
 fsearch_database_rescan_manager_reschedule(FsearchDatabaseRescanManager *self) {
     g_return_if_fail(self != NULL);
@@ -308,7 +343,11 @@ fsearch_database_rescan_manager_trigger_startup_scans(FsearchDatabaseRescanManag
         else if (fsearch_database_include_get_scan_after_launch(include)) {
             needs_startup_scan = TRUE;
         }
-        // 3: Schedule is already due
+        // 3: An earlier scan was interrupted and can be resumed
+        else if (include_has_checkpoint(self, include)) {
+            needs_startup_scan = TRUE;
+        }
+        // 4: Schedule is already due
         else {
             const int64_t rescan_after = fsearch_database_include_get_rescan_after(include);
             if (rescan_after > 0) {
@@ -22,6 +22,10 @@ fsearch_database_rescan_manager_new(FsearchDatabaseIncludeManager *include_manag
 void
 fsearch_database_rescan_manager_free(FsearchDatabaseRescanManager *self);
 
+// Includes with a checkpoint in `checkpoint_dir` are scanned after launch and on their own, so their scans resume
+void
+fsearch_database_rescan_manager_set_checkpoint_dir(FsearchDatabaseRescanManager *self, const char *checkpoint_dir);
+
 void
 fsearch_database_rescan_manager_reschedule(FsearchDatabaseRescanManager *self);
 
@@ -9,11 +9,13 @@
 #include <fcntl.h>
 #include <glib/gi18n.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
 enum {
     WALK_OK = 0,
     WALK_BADIO,
     WALK_CANCEL,
+    WALK_NOMEM,
 };
 
 typedef struct DatabaseWalkContext {
@@ -31,8 +33,25 @@ typedef struct DatabaseWalkContext {
     gpointer status_cb_data;
     ssize_t file_handle_payload;
     dev_t root_device_id;
+    FsearchDatabaseScanCheckpoint *checkpoint;
+    // Folders of the checkpoint which the resumed scan didn't get to yet. The new checkpoint only replaces the one
+    // it resumes from once it has caught up with it.
+    uint32_t num_unvisited_checkpoint_folders;
+    // When the first scan of the checkpoint started
+    int64_t checkpoint_created;
+    // An entry couldn't be created, because the arena is out of space
+    bool out_of_memory;
 } DatabaseWalkContext;
 
+// A child of a folder which is read again when resuming a scan
+typedef struct {
+    char *name;
+    FsearchDatabaseScanCheckpointFolder *checkpoint_folder;
+    off_t size;
+    time_t mtime;
+    bool is_dir;
+} DatabaseResumeChild;
+
 static void
 watch_folder(DatabaseWalkContext *walk_context, FsearchDatabaseEntry *folder, const char *path) {
 #ifdef HAVE_FANOTIFY
@@ -68,6 +87,19 @@ unwatch_folder(DatabaseWalkContext *walk_context, FsearchDatabaseEntry *folder)
 #endif
 }
 
+// Returns WALK_CANCEL or WALK_NOMEM if the walk has to stop, WALK_OK otherwise
+static int
+walk_get_stop_reason(DatabaseWalkContext *walk_context) {
+    if (walk_context->out_of_memory) {
+        return WALK_NOMEM;
+    }
+    if (g_cancellable_is_cancelled(walk_context->cancellable)) {
+        g_debug("[db_scan] cancelled");
+        return WALK_CANCEL;
+    }
+    return WALK_OK;
+}
+
 static FsearchDatabaseEntry *
 add_folder(DatabaseWalkContext *walk_context, const char *name, const char *path, time_t mtime, FsearchDatabaseEntry *parent) {
     FsearchDatabaseEntry *folder_entry = db_entry_new_with_attributes(DATABASE_INDEX_PROPERTY_FLAG_DEFAULT,
@@ -78,6 +110,7 @@ add_folder(DatabaseWalkContext *walk_context, const char *name, const char *path
                                                                       mtime,
                                                                       DATABASE_INDEX_PROPERTY_NONE);
     if (!folder_entry) {
+        walk_context->out_of_memory = true;
         return NULL;
     }
     const char *n = NULL;
@@ -90,6 +123,9 @@ add_folder(DatabaseWalkContext *walk_context, const char *name, const char *path
     }
     watch_folder(walk_context, folder_entry, path);
     darray_add_item(walk_context->folders, folder_entry);
+    if (walk_context->checkpoint) {
+        fsearch_database_scan_checkpoint_add_folder(walk_context->checkpoint, folder_entry);
+    }
 
     return folder_entry;
 }
@@ -106,6 +142,7 @@ add_file(DatabaseWalkContext *walk_context, const char *name, off_t size, time_t
                                                                     mtime,
                                                                     DATABASE_INDEX_PROPERTY_NONE);
     if (!file_entry) {
+        walk_context->out_of_memory = true;
         return NULL;
     }
     const char *n = NULL;
@@ -121,15 +158,90 @@ add_file(DatabaseWalkContext *walk_context, const char *name, off_t size, time_t
         g_assert(t == mtime);
     }
     darray_add_item(walk_context->files, file_entry);
+    if (walk_context->checkpoint) {
+        fsearch_database_scan_checkpoint_add_file(walk_context->checkpoint, file_entry);
+    }
 
     return file_entry;
 }
 
+static void
+complete_folder(DatabaseWalkContext *walk_context, FsearchDatabaseEntry *folder) {
+    // Some of the children might be missing
+    if (walk_context->checkpoint && !walk_context->out_of_memory) {
+        fsearch_database_scan_checkpoint_complete_folder(walk_context->checkpoint, folder);
+    }
+}
+
+// Called once for every folder which gets read
+static void
+update_progress(DatabaseWalkContext *walk_context) {
+    const double elapsed_seconds = g_timer_elapsed(walk_context->timer, NULL);
+    if (elapsed_seconds > 0.1) {
+        if (walk_context->status_cb) {
+            walk_context->status_cb(walk_context->path->str, walk_context->status_cb_data);
+        }
+        g_timer_start(walk_context->timer);
+    }
+
+    if (walk_context->checkpoint && fsearch_database_scan_checkpoint_is_due(walk_context->checkpoint)) {
+        fsearch_database_scan_checkpoint_flush(walk_context->checkpoint,
+                                               walk_context->num_unvisited_checkpoint_folders == 0);
+    }
+}
+
+static int
+stat_at(int dir_fd, const char *name, struct stat *st) {
+    int stat_flags = AT_SYMLINK_NOFOLLOW;
+#ifdef AT_NO_AUTOMOUNT
+    stat_flags |= AT_NO_AUTOMOUNT;
+#endif
+    return fstatat(dir_fd, name, st, stat_flags);
+}
+
+// Returns whether `dent` belongs into the index. The path of the walk context is set to its path and `st` to its
+// attributes.
+static bool
+read_dir_entry(DatabaseWalkContext *walk_context, int dir_fd, struct dirent *dent, gsize path_len, struct stat *st) {
+    // TODO: we can test for hidden here to avoid stat call
+
+    if (!strcmp(dent->d_name, ".") || !strcmp(dent->d_name, "..")) {
+        return false;
+    }
+    const size_t d_name_len = strlen(dent->d_name);
+    if (d_name_len > UINT16_MAX) {
+        g_warning("[db_scan] file name too long, skipping: \"%s\" (len: %zd)", dent->d_name, d_name_len);
+        return false;
+    }
+
+    // create full path of file/folder
+    GString *path = walk_context->path;
+    g_string_truncate(path, path_len);
+    g_string_append(path, dent->d_name);
+
+    if (stat_at(dir_fd, dent->d_name, st)) {
+        g_debug("[db_scan] can't stat: %s", path->str);
+        return false;
+    }
+
+    if (walk_context->one_file_system && walk_context->root_device_id != st->st_dev) {
+        g_debug("[db_scan] different filesystem, skipping: %s", path->str);
+        return false;
+    }
+
+    const bool is_dir = S_ISDIR(st->st_mode);
+    if (fsearch_database_exclude_manager_excludes(walk_context->exclude_manager, path->str, dent->d_name, is_dir)) {
+        g_debug("[db_scan] excluded: %s", path->str);
+        return false;
+    }
+    return true;
+}
+
 static int
 db_folder_scan_recursive(DatabaseWalkContext *walk_context, FsearchDatabaseEntry *parent) {
-    if (g_cancellable_is_cancelled(walk_context->cancellable)) {
-        g_debug("[db_scan] cancelled");
-        return WALK_CANCEL;
+    const int stop_reason = walk_get_stop_reason(walk_context);
+    if (stop_reason != WALK_OK) {
+        return stop_reason;
     }
 
     GString *path = walk_context->path;
@@ -140,74 +252,301 @@ db_folder_scan_recursive(DatabaseWalkContext *walk_context, FsearchDatabaseEntry
 
     DIR *dir = opendir(path->str);
     if (!dir) {
+        // Not completed, so a scan which resumes from the checkpoint tries to read it again
         g_debug("[db_scan] failed to open directory: %s", path->str);
         return WALK_BADIO;
     }
 
     const int dir_fd = dirfd(dir);
 
-    const double elapsed_seconds = g_timer_elapsed(walk_context->timer, NULL);
-    if (elapsed_seconds > 0.1) {
-        if (walk_context->status_cb) {
-            walk_context->status_cb(path->str, walk_context->status_cb_data);
-        }
-        g_timer_start(walk_context->timer);
-    }
+    update_progress(walk_context);
 
     struct dirent *dent = NULL;
     while ((dent = readdir(dir))) {
-        if (g_cancellable_is_cancelled(walk_context->cancellable)) {
-            g_debug("[db_scan] cancelled");
+        const int stop_reason = walk_get_stop_reason(walk_context);
+        if (stop_reason != WALK_OK) {
             g_clear_pointer(&dir, closedir);
-            return WALK_CANCEL;
+            return stop_reason;
         }
 
-        // TODO: we can test for hidden here to avoid stat call
-
-        if (!strcmp(dent->d_name, ".") || !strcmp(dent->d_name, "..")) {
+        struct stat st;
+        if (!read_dir_entry(walk_context, dir_fd, dent, path_len, &st)) {
             continue;
         }
-        const size_t d_name_len = strlen(dent->d_name);
-        if (d_name_len > UINT16_MAX) {
-            g_warning("[db_scan] file name too long, skipping: \"%s\" (len: %zd)", dent->d_name, d_name_len);
+
+        if (S_ISDIR(st.st_mode)) {
+            FsearchDatabaseEntry *folder = add_folder(walk_context, dent->d_name, path->str, st.st_mtime, parent);
+            if (folder) {
+                db_folder_scan_recursive(walk_context, folder);
+            }
+        }
+        else {
+            add_file(walk_context, dent->d_name, st.st_size, st.st_mtime, parent);
+        }
+    }
+
+    g_clear_pointer(&dir, closedir);
+    complete_folder(walk_context, parent);
+    return WALK_OK;
+}
+
+// Takes over the entry of `checkpoint_folder` as a child of `parent`
+static FsearchDatabaseEntry *
+adopt_folder(DatabaseWalkContext *walk_context,
+             FsearchDatabaseScanCheckpointFolder *checkpoint_folder,
+             FsearchDatabaseEntry *parent,
+             const char *path,
+             time_t mtime) {
+    FsearchDatabaseEntry *folder_entry = g_steal_pointer(&checkpoint_folder->entry);
+    db_entry_set_mtime(folder_entry, mtime);
+    if (parent) {
+        db_entry_set_parent(folder_entry, parent);
+    }
+    watch_folder(walk_context, folder_entry, path);
+    darray_add_item(walk_context->folders, folder_entry);
+    if (walk_context->checkpoint) {
+        fsearch_database_scan_checkpoint_add_folder(walk_context->checkpoint, folder_entry);
+    }
+    walk_context->num_unvisited_checkpoint_folders--;
+    return folder_entry;
+}
+
+// Takes over `file_entry` as a child of `parent`, with the size and mtime the file has now. Files whose content
+// changed don't change the mtime of their folder.
+static void
+adopt_file(DatabaseWalkContext *walk_context,
+           FsearchDatabaseEntry *file_entry,
+           FsearchDatabaseEntry *parent,
+           int dir_fd) {
+    struct stat st;
+    if (stat_at(dir_fd, db_entry_get_name_raw(file_entry), &st) || S_ISDIR(st.st_mode)) {
+        g_debug("[db_scan] file is gone: %s%s", walk_context->path->str, db_entry_get_name_raw(file_entry));
+        db_entry_free_no_unparent(file_entry);
+        return;
+    }
+    db_entry_set_size(file_entry, st.st_size);
+    db_entry_set_mtime(file_entry, st.st_mtime);
+    db_entry_set_parent(file_entry, parent);
+    darray_add_item(walk_context->files, file_entry);
+    if (walk_context->checkpoint) {
+        fsearch_database_scan_checkpoint_add_file(walk_context->checkpoint, file_entry);
+    }
+}
+
+// The subtree of `checkpoint_folder` doesn't exist anymore
+static void
+drop_checkpoint_folder(DatabaseWalkContext *walk_context, FsearchDatabaseScanCheckpointFolder *checkpoint_folder) {
+    walk_context->num_unvisited_checkpoint_folders -= checkpoint_folder->num_subtree_folders;
+}
+
+static void
+resume_child_clear(DatabaseResumeChild *child) {
+    g_clear_pointer(&child->name, g_free);
+}
+
+static int
+db_folder_resume_recursive(DatabaseWalkContext *walk_context,
+                           FsearchDatabaseScanCheckpointFolder *checkpoint_folder,
+                           FsearchDatabaseEntry *folder,
+                           bool unchanged);
+
+static int
+resume_folder(DatabaseWalkContext *walk_context,
+              FsearchDatabaseScanCheckpointFolder *checkpoint_folder,
+              FsearchDatabaseEntry *parent,
+              const char *path,
+              time_t mtime) {
+    // A folder whose mtime didn't change still has the same children. mtimes only have a resolution of seconds, so
+    // that's only certain for folders which were last changed before the scan of the checkpoint started.
+    const bool unchanged = checkpoint_folder->completed && db_entry_get_mtime(checkpoint_folder->entry) == mtime
+                        && mtime < walk_context->checkpoint_created;
+    FsearchDatabaseEntry *folder = adopt_folder(walk_context, checkpoint_folder, parent, path, mtime);
+    return db_folder_resume_recursive(walk_context, checkpoint_folder, folder, unchanged);
+}
+
+// Reads a folder of the checkpoint again, because it wasn't completed or changed since. Its files are replaced with
+// what's on disk now. Child folders which are part of the checkpoint are resumed, completed ones first, so the
+// resumed scan catches up with the checkpoint as early as possible, new ones are scanned.
+static int
+db_folder_reread(DatabaseWalkContext *walk_context,
+                 FsearchDatabaseScanCheckpointFolder *checkpoint_folder,
+                 FsearchDatabaseEntry *folder) {
+    GString *path = walk_context->path;
+    const gsize path_len = path->len;
+
+    g_autoptr(GHashTable) checkpoint_children = g_hash_table_new(g_str_hash, g_str_equal);
+    for (uint32_t i = 0; i < checkpoint_folder->folders->len; i++) {
+        FsearchDatabaseScanCheckpointFolder *child = g_ptr_array_index(checkpoint_folder->folders, i);
+        const char *name = db_entry_get_name_raw(child->entry);
+        if (g_hash_table_contains(checkpoint_children, name)) {
+            // Can't tell which one is right
+            drop_checkpoint_folder(walk_context, child);
             continue;
         }
+        g_hash_table_insert(checkpoint_children, (gpointer)name, child);
+    }
 
-        // create full path of file/folder
-        g_string_truncate(path, path_len);
-        g_string_append(path, dent->d_name);
+    GHashTableIter iter;
+    gpointer value = NULL;
+
+    DIR *dir = opendir(path->str);
+    if (!dir) {
+        g_debug("[db_scan] failed to open directory: %s", path->str);
+        g_hash_table_iter_init(&iter, checkpoint_children);
+        while (g_hash_table_iter_next(&iter, NULL, &value)) {
+            drop_checkpoint_folder(walk_context, value);
+        }
+        return WALK_BADIO;
+    }
+    const int dir_fd = dirfd(dir);
+
+    g_autoptr(GArray) children = g_array_new(FALSE, FALSE, sizeof(DatabaseResumeChild));
+    g_array_set_clear_func(children, (GDestroyNotify)resume_child_clear);
+
+    struct dirent *dent = NULL;
+    while ((dent = readdir(dir))) {
+        const int stop_reason = walk_get_stop_reason(walk_context);
+        if (stop_reason != WALK_OK) {
+            g_clear_pointer(&dir, closedir);
+            return stop_reason;
+        }
 
         struct stat st;
-        int stat_flags = AT_SYMLINK_NOFOLLOW;
-#ifdef AT_NO_AUTOMOUNT
-        stat_flags |= AT_NO_AUTOMOUNT;
-#endif
-        if (fstatat(dir_fd, dent->d_name, &st, stat_flags)) {
-            g_debug("[db_scan] can't stat: %s", path->str);
+        if (!read_dir_entry(walk_context, dir_fd, dent, path_len, &st)) {
             continue;
         }
+        DatabaseResumeChild child = {
+            .name = g_strdup(dent->d_name),
+            .size = st.st_size,
+            .mtime = st.st_mtime,
+            .is_dir = S_ISDIR(st.st_mode),
+        };
+        if (child.is_dir) {
+            child.checkpoint_folder = g_hash_table_lookup(checkpoint_children, dent->d_name);
+            if (child.checkpoint_folder) {
+                g_hash_table_remove(checkpoint_children, dent->d_name);
+            }
+        }
+        g_array_append_val(children, child);
+    }
+    g_clear_pointer(&dir, closedir);
 
-        if (walk_context->one_file_system && walk_context->root_device_id != st.st_dev) {
-            g_debug("[db_scan] different filesystem, skipping: %s", path->str);
-            continue;
+    // Folders of the checkpoint which are gone
+    g_hash_table_iter_init(&iter, checkpoint_children);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        drop_checkpoint_folder(walk_context, value);
+    }
+
+    // The completed folders of the checkpoint first, then the interrupted ones, then the new children
+    for (uint32_t pass = 0; pass < 3; pass++) {
+        for (uint32_t i = 0; i < children->len; i++) {
+            const int stop_reason = walk_get_stop_reason(walk_context);
+            if (stop_reason != WALK_OK) {
+                return stop_reason;
+            }
+            DatabaseResumeChild *child = &g_array_index(children, DatabaseResumeChild, i);
+            FsearchDatabaseScanCheckpointFolder *checkpoint_child = child->checkpoint_folder;
+            if (pass == 0 && (!checkpoint_child || !checkpoint_child->completed)) {
+                continue;
+            }
+            if (pass == 1 && (!checkpoint_child || checkpoint_child->completed)) {
+                continue;
+            }
+            if (pass == 2 && checkpoint_child) {
+                continue;
+            }
+
+            g_string_truncate(path, path_len);
+            g_string_append(path, child->name);
+            if (checkpoint_child) {
+                resume_folder(walk_context, checkpoint_child, folder, path->str, child->mtime);
+            }
+            else if (child->is_dir) {
+                FsearchDatabaseEntry *child_folder = add_folder(walk_context,
+                                                                child->name,
+                                                                path->str,
+                                                                child->mtime,
+                                                                folder);
+                if (child_folder) {
+                    db_folder_scan_recursive(walk_context, child_folder);
+                }
+            }
+            else {
+                add_file(walk_context, child->name, child->size, child->mtime, folder);
+            }
         }
+    }
+
+    complete_folder(walk_context, folder);
+    return WALK_OK;
+}
+
+// Continues the scan of a folder of the checkpoint, which was already added as `folder`
+static int
+db_folder_resume_recursive(DatabaseWalkContext *walk_context,
+                           FsearchDatabaseScanCheckpointFolder *checkpoint_folder,
+                           FsearchDatabaseEntry *folder,
+                           bool unchanged) {
+    const int stop_reason = walk_get_stop_reason(walk_context);
+    if (stop_reason != WALK_OK) {
+        return stop_reason;
+    }
+
+    GString *path = walk_context->path;
+    g_string_append_c(path, G_DIR_SEPARATOR);
+    const gsize path_len = path->len;
+
+    update_progress(walk_context);
+
+    const int dir_fd = unchanged ? open(path->str, O_RDONLY | O_DIRECTORY | O_CLOEXEC) : -1;
+    if (dir_fd < 0) {
+        return db_folder_reread(walk_context, checkpoint_folder, folder);
+    }
 
-        const bool is_dir = S_ISDIR(st.st_mode);
-        if (fsearch_database_exclude_manager_excludes(walk_context->exclude_manager, path->str, dent->d_name, is_dir)) {
-            g_debug("[db_scan] excluded: %s", path->str);
+    // Only the attributes of the children have to be read again, not the folder itself
+    for (uint32_t i = 0; i < checkpoint_folder->files->len; i++) {
+        const int stop_reason = walk_get_stop_reason(walk_context);
+        if (stop_reason != WALK_OK) {
+            close(dir_fd);
+            return stop_reason;
+        }
+        adopt_file(walk_context, g_steal_pointer(&g_ptr_array_index(checkpoint_folder->files, i)), folder, dir_fd);
+    }
+
+    // The child folders are still there, unless the folder was replaced with a new one with the same mtime. They're
+    // all checked before descending, so only one folder is open at a time.
+    const uint32_t num_child_folders = checkpoint_folder->folders->len;
+    g_autofree time_t *child_mtimes = g_new0(time_t, MAX(num_child_folders, 1));
+    g_autofree bool *child_exists = g_new0(bool, MAX(num_child_folders, 1));
+    for (uint32_t i = 0; i < num_child_folders; i++) {
+        FsearchDatabaseScanCheckpointFolder *child = g_ptr_array_index(checkpoint_folder->folders, i);
+        struct stat st;
+        if (stat_at(dir_fd, db_entry_get_name_raw(child->entry), &st) || !S_ISDIR(st.st_mode)
+            || (walk_context->one_file_system && walk_context->root_device_id != st.st_dev)) {
             continue;
         }
+        child_mtimes[i] = st.st_mtime;
+        child_exists[i] = true;
+    }
+    close(dir_fd);
 
-        if (is_dir) {
-            db_folder_scan_recursive(walk_context,
-                                     add_folder(walk_context, dent->d_name, path->str, st.st_mtime, parent));
+    for (uint32_t i = 0; i < num_child_folders; i++) {
+        const int stop_reason = walk_get_stop_reason(walk_context);
+        if (stop_reason != WALK_OK) {
+            return stop_reason;
         }
-        else {
-            add_file(walk_context, dent->d_name, st.st_size, st.st_mtime, parent);
+        FsearchDatabaseScanCheckpointFolder *child = g_ptr_array_index(checkpoint_folder->folders, i);
+        g_string_truncate(path, path_len);
+        g_string_append(path, db_entry_get_name_raw(child->entry));
+        if (!child_exists[i]) {
+            g_debug("[db_scan] folder is gone: %s", path->str);
+            drop_checkpoint_folder(walk_context, child);
+            continue;
         }
+        resume_folder(walk_context, child, folder, path->str, child_mtimes[i]);
     }
 
-    g_clear_pointer(&dir, closedir);
+    complete_folder(walk_context, folder);
     return WALK_OK;
 }
 
@@ -223,7 +562,7 @@ discard_scanned_entries(DatabaseWalkContext *walk_context, FsearchDatabaseEntry
         unwatch_folder(walk_context, darray_get_item(walk_context->folders, i));
     }
 
-    if (top_has_external_parent) {
+    if (top && top_has_external_parent) {
         db_entry_set_parent(top, NULL);
     }
 
@@ -249,10 +588,12 @@ db_scan_folder(const char *path,
                FsearchFolderMonitorFanotify *fanotify_monitor,
                FsearchFolderMonitorInotify *inotify_monitor,
                bool one_file_system,
+               FsearchDatabaseScanCheckpoint *checkpoint,
                GCancellable *cancellable,
                void (*status_cb)(const char *, gpointer),
                gpointer status_cb_data) {
     g_assert(g_path_is_absolute(path));
+    g_assert(!checkpoint || !parent);
     g_debug("[db_scan] scan path: %s", path);
 
     if (!g_file_test(path, G_FILE_TEST_IS_DIR)) {
@@ -288,20 +629,44 @@ db_scan_folder(const char *path,
         .status_cb_data = status_cb_data,
         .root_device_id = root_st.st_dev,
         .file_handle_payload = 0,
+        .checkpoint = checkpoint,
+        .checkpoint_created = checkpoint ? fsearch_database_scan_checkpoint_get_created(checkpoint) : 0,
     };
 
     const bool top_has_external_parent = parent != NULL;
 
-    if (!parent) {
-        parent = add_folder(&walk_context, path, path, root_st.st_mtime, NULL);
+    FsearchDatabaseScanCheckpointFolder *resume_root = NULL;
+    if (checkpoint) {
+        resume_root = fsearch_database_scan_checkpoint_get_resume_root(checkpoint);
+    }
+
+    uint32_t res = WALK_OK;
+    if (resume_root) {
+        g_debug("[db_scan] resume scan from checkpoint: %s", path);
+        walk_context.num_unvisited_checkpoint_folders = resume_root->num_subtree_folders;
+        res = resume_folder(&walk_context, resume_root, NULL, path, root_st.st_mtime);
     }
     else {
-        g_autofree char *name = g_path_get_basename(path);
-        parent = add_folder(&walk_context, name, path, root_st.st_mtime, parent);
+        if (!parent) {
+            parent = add_folder(&walk_context, path, path, root_st.st_mtime, NULL);
+        }
+        else {
+            g_autofree char *name = g_path_get_basename(path);
+            parent = add_folder(&walk_context, name, path, root_st.st_mtime, parent);
+        }
+
+        res = parent ? db_folder_scan_recursive(&walk_context, parent) : WALK_NOMEM;
     }
 
-    const uint32_t res = db_folder_scan_recursive(&walk_context, parent);
+    if (checkpoint && res != WALK_BADIO) {
+        // Keep what was found so far, so the next scan can continue from there
+        fsearch_database_scan_checkpoint_flush(checkpoint, walk_context.num_unvisited_checkpoint_folders == 0);
+    }
 
+    if (res == WALK_OK && walk_context.out_of_memory) {
+        // Running out of space while reading the last folder doesn't stop the walk anymore
+        res = WALK_NOMEM;
+    }
     if (res == WALK_OK) {
         return true;
     }
@@ -309,6 +674,9 @@ db_scan_folder(const char *path,
     if (res == WALK_CANCEL) {
         g_debug("[db_scan] scan cancelled.");
     }
+    else if (res == WALK_NOMEM) {
+        g_warning("[db_scan] out of memory");
+    }
     else {
         g_warning("[db_scan] walk error: %d", res);
     }
@@ -1,9 +1,12 @@
 #pragma once
 
 #include "fsearch_database_exclude_manager.h"
+#include "fsearch_database_scan_checkpoint.h"
 #include "fsearch_folder_monitor_fanotify.h"
 #include "fsearch_folder_monitor_inotify.h"
 
+// Scans `path` into `folders` and `files`. With a `checkpoint`, which only scans of a whole include (without `parent`)
+// can have, the progress is recorded in it and the scan resumes from what it contains.
 bool
 db_scan_folder(const char *path,
                FsearchDatabaseEntry *parent,
@@ -13,6 +16,7 @@ db_scan_folder(const char *path,
                FsearchFolderMonitorFanotify *fanotify_monitor,
                FsearchFolderMonitorInotify *inotify_monitor,
                bool one_file_system,
+               FsearchDatabaseScanCheckpoint *checkpoint,
                GCancellable *cancellable,
                void (*status_cb)(const char *, gpointer),
                gpointer status_cb_data);
\ No newline at end of file
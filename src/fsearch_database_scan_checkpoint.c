@@ -0,0 +1,518 @@
+#define G_LOG_DOMAIN "fsearch-database-scan-checkpoint"
+
+#include "fsearch_database_scan_checkpoint.h"
+
+#include "fsearch_database_exclude.h"
+#include "fsearch_hash.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <glib/gstdio.h>
+#include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
+
+#define DATABASE_SCAN_CHECKPOINT_MAGIC_NUMBER "FSSC"
+#define DATABASE_SCAN_CHECKPOINT_VERSION 1
+// Magic number, version and the time the first scan of the checkpoint started
+#define DATABASE_SCAN_CHECKPOINT_CREATED_OFFSET 8
+#define DATABASE_SCAN_CHECKPOINT_CONFIG_OFFSET 16
+
+// How often the records are written to disk while scanning
+#define DATABASE_SCAN_CHECKPOINT_INTERVAL_SECONDS 30.0
+// Write the records earlier when this many bytes are pending, so fast scans don't keep them all in memory
+#define DATABASE_SCAN_CHECKPOINT_MAX_PENDING (4 * 1024 * 1024)
+// Entries of older checkpoints are too likely to be outdated, even when the folder which contains them isn't
+#define DATABASE_SCAN_CHECKPOINT_MAX_AGE_SECONDS (7 * 24 * 60 * 60)
+
+#define DATABASE_SCAN_CHECKPOINT_NO_PARENT UINT32_MAX
+
+// Records: a type byte followed by
+// folder: uint32 parent index, int64 mtime, uint16 name length, name
+// file: uint32 parent index, int64 size, int64 mtime, uint16 name length, name
+// completed folder: uint32 folder index
+// Folders are numbered in the order they were recorded, the root folder comes first and has the include path as name
+enum {
+    CHECKPOINT_RECORD_FOLDER = 'D',
+    CHECKPOINT_RECORD_FILE = 'F',
+    CHECKPOINT_RECORD_COMPLETED = 'C',
+};
+
+struct FsearchDatabaseScanCheckpoint {
+    char *file_path;
+    // The records are written here until the checkpoint gets published
+    char *tmp_file_path;
+    int fd;
+    bool published;
+    bool failed;
+
+    GByteArray *pending;
+    GTimer *timer;
+
+    // Index of every recorded folder, plus one
+    GHashTable *folder_indices;
+    uint32_t num_folders;
+
+    FsearchDatabaseScanCheckpointFolder *resume_root;
+    // When the first scan of the checkpoint started
+    int64_t created;
+};
+
+static void
+checkpoint_entry_free(FsearchDatabaseEntry *entry) {
+    if (entry) {
+        db_entry_free_no_unparent(entry);
+    }
+}
+
+static void
+checkpoint_folder_free(FsearchDatabaseScanCheckpointFolder *folder) {
+    g_clear_pointer(&folder->folders, g_ptr_array_unref);
+    g_clear_pointer(&folder->files, g_ptr_array_unref);
+    g_clear_pointer(&folder->entry, db_entry_free_no_unparent);
+    g_free(folder);
+}
+
+static FsearchDatabaseScanCheckpointFolder *
+checkpoint_folder_new(FsearchDatabaseEntry *entry) {
+    FsearchDatabaseScanCheckpointFolder *folder = g_new0(FsearchDatabaseScanCheckpointFolder, 1);
+    folder->entry = entry;
+    folder->folders = g_ptr_array_new_with_free_func((GDestroyNotify)checkpoint_folder_free);
+    folder->files = g_ptr_array_new_with_free_func((GDestroyNotify)checkpoint_entry_free);
+    folder->num_subtree_folders = 1;
+    return folder;
+}
+
+// A checkpoint can only be resumed by a scan which would find the same entries
+static uint64_t
+checkpoint_hash_excludes(FsearchDatabaseExcludeManager *exclude_manager) {
+    FsearchHash hash;
+    fsearch_hash_init(&hash, 0);
+
+    const uint8_t exclude_hidden = fsearch_database_exclude_manager_get_exclude_hidden(exclude_manager) ? 1 : 0;
+    fsearch_hash_update(&hash, &exclude_hidden, sizeof(exclude_hidden));
+
+    g_autoptr(GPtrArray) excludes = fsearch_database_exclude_manager_get_excludes(exclude_manager);
+    for (uint32_t i = 0; i < excludes->len; i++) {
+        FsearchDatabaseExclude *exclude = g_ptr_array_index(excludes, i);
+        const char *pattern = fsearch_database_exclude_get_pattern(exclude);
+        // Include the terminating zero, so the patterns can't run into each other
+        fsearch_hash_update(&hash, pattern, strlen(pattern) + 1);
+        const int32_t values[4] = {
+            fsearch_database_exclude_get_active(exclude),
+            fsearch_database_exclude_get_exclude_type(exclude),
+            fsearch_database_exclude_get_match_scope(exclude),
+            fsearch_database_exclude_get_target(exclude),
+        };
+        fsearch_hash_update(&hash, values, sizeof(values));
+    }
+    return fsearch_hash_digest(&hash);
+}
+
+static void
+checkpoint_append_header(GByteArray *buffer,
+                         int64_t created,
+                         uint64_t excludes_hash,
+                         bool one_file_system,
+                         const char *include_path) {
+    const uint32_t version = DATABASE_SCAN_CHECKPOINT_VERSION;
+    const uint8_t one_fs = one_file_system ? 1 : 0;
+    const uint32_t path_len = (uint32_t)strlen(include_path);
+    g_byte_array_append(buffer, (const guint8 *)DATABASE_SCAN_CHECKPOINT_MAGIC_NUMBER, 4);
+    g_byte_array_append(buffer, (const guint8 *)&version, sizeof(version));
+    g_byte_array_append(buffer, (const guint8 *)&created, sizeof(created));
+    g_byte_array_append(buffer, (const guint8 *)&excludes_hash, sizeof(excludes_hash));
+    g_byte_array_append(buffer, &one_fs, sizeof(one_fs));
+    g_byte_array_append(buffer, (const guint8 *)&path_len, sizeof(path_len));
+    g_byte_array_append(buffer, (const guint8 *)include_path, path_len);
+}
+
+static void
+checkpoint_append_entry(GByteArray *buffer, uint8_t type, uint32_t parent_idx, FsearchDatabaseEntry *entry) {
+    const char *name = db_entry_get_name_raw(entry);
+    const size_t name_len = MIN(strlen(name), UINT16_MAX);
+    const uint16_t len = (uint16_t)name_len;
+    const int64_t mtime = db_entry_get_mtime(entry);
+
+    g_byte_array_append(buffer, &type, sizeof(type));
+    g_byte_array_append(buffer, (const guint8 *)&parent_idx, sizeof(parent_idx));
+    if (type == CHECKPOINT_RECORD_FILE) {
+        const int64_t size = db_entry_get_size(entry);
+        g_byte_array_append(buffer, (const guint8 *)&size, sizeof(size));
+    }
+    g_byte_array_append(buffer, (const guint8 *)&mtime, sizeof(mtime));
+    g_byte_array_append(buffer, (const guint8 *)&len, sizeof(len));
+    g_byte_array_append(buffer, (const guint8 *)name, len);
+}
+
+// Parses the records behind the header. A prefix of a checkpoint is a valid checkpoint as well, it only has fewer
+// completed folders, so parsing stops at the first record which was cut off by a crash.
+static FsearchDatabaseScanCheckpointFolder *
+checkpoint_parse_records(const uint8_t *data, size_t size, size_t offset, const char *include_path) {
+    // The folders by their index and the index of their parent
+    g_autoptr(GPtrArray) folders = g_ptr_array_new();
+    g_autoptr(GArray) parents = g_array_new(FALSE, FALSE, sizeof(uint32_t));
+    g_autoptr(GString) name = g_string_new(NULL);
+
+    while (offset < size) {
+        const uint8_t type = data[offset];
+        if (type == CHECKPOINT_RECORD_COMPLETED) {
+            uint32_t idx = 0;
+            if (size - offset < 1 + sizeof(idx)) {
+                break;
+            }
+            memcpy(&idx, data + offset + 1, sizeof(idx));
+            if (idx >= folders->len) {
+                break;
+            }
+            ((FsearchDatabaseScanCheckpointFolder *)g_ptr_array_index(folders, idx))->completed = true;
+            offset += 1 + sizeof(idx);
+            continue;
+        }
+        if (type != CHECKPOINT_RECORD_FOLDER && type != CHECKPOINT_RECORD_FILE) {
+            break;
+        }
+
+        const bool is_file = type == CHECKPOINT_RECORD_FILE;
+        uint32_t parent_idx = 0;
+        int64_t entry_size = 0;
+        int64_t mtime = 0;
+        uint16_t name_len = 0;
+        const size_t fixed_size = 1 + sizeof(parent_idx) + (is_file ? sizeof(entry_size) : 0) + sizeof(mtime)
+                                + sizeof(name_len);
+        if (size - offset < fixed_size) {
+            break;
+        }
+        const uint8_t *p = data + offset + 1;
+        memcpy(&parent_idx, p, sizeof(parent_idx));
+        p += sizeof(parent_idx);
+        if (is_file) {
+            memcpy(&entry_size, p, sizeof(entry_size));
+            p += sizeof(entry_size);
+        }
+        memcpy(&mtime, p, sizeof(mtime));
+        p += sizeof(mtime);
+        memcpy(&name_len, p, sizeof(name_len));
+        p += sizeof(name_len);
+        if (name_len == 0 || size - offset - fixed_size < name_len) {
+            break;
+        }
+        g_string_truncate(name, 0);
+        g_string_append_len(name, (const char *)p, name_len);
+
+        if (folders->len == 0) {
+            // Only the root folder has no parent
+            if (is_file || parent_idx != DATABASE_SCAN_CHECKPOINT_NO_PARENT || strcmp(name->str, include_path) != 0) {
+                break;
+            }
+        }
+        else if (parent_idx >= folders->len || strchr(name->str, G_DIR_SEPARATOR)) {
+            break;
+        }
+
+        if (is_file) {
+            FsearchDatabaseEntry *entry = db_entry_new_with_attributes(DATABASE_INDEX_PROPERTY_FLAG_DEFAULT,
+                                                                       name->str,
+                                                                       NULL,
+                                                                       DATABASE_ENTRY_TYPE_FILE,
+                                                                       DATABASE_INDEX_PROPERTY_SIZE,
+                                                                       entry_size,
+                                                                       DATABASE_INDEX_PROPERTY_MODIFICATION_TIME,
+                                                                       mtime,
+                                                                       DATABASE_INDEX_PROPERTY_NONE);
+            if (!entry) {
+                // Out of space, resume from the records which were read so far
+                break;
+            }
+            FsearchDatabaseScanCheckpointFolder *parent = g_ptr_array_index(folders, parent_idx);
+            g_ptr_array_add(parent->files, entry);
+        }
+        else {
+            FsearchDatabaseEntry *entry = db_entry_new_with_attributes(DATABASE_INDEX_PROPERTY_FLAG_DEFAULT,
+                                                                       name->str,
+                                                                       NULL,
+                                                                       DATABASE_ENTRY_TYPE_FOLDER,
+                                                                       DATABASE_INDEX_PROPERTY_MODIFICATION_TIME,
+                                                                       mtime,
+                                                                       DATABASE_INDEX_PROPERTY_NONE);
+            if (!entry) {
+                break;
+            }
+            FsearchDatabaseScanCheckpointFolder *folder = checkpoint_folder_new(entry);
+            if (folders->len > 0) {
+                FsearchDatabaseScanCheckpointFolder *parent = g_ptr_array_index(folders, parent_idx);
+                g_ptr_array_add(parent->folders, folder);
+            }
+            g_ptr_array_add(folders, folder);
+            g_array_append_val(parents, parent_idx);
+        }
+        offset += fixed_size + name_len;
+    }
+
+    if (folders->len == 0) {
+        return NULL;
+    }
+
+    // Parents always come before their children
+    for (uint32_t i = folders->len - 1; i > 0; i--) {
+        FsearchDatabaseScanCheckpointFolder *folder = g_ptr_array_index(folders, i);
+        FsearchDatabaseScanCheckpointFolder *parent = g_ptr_array_index(folders,
+                                                                        g_array_index(parents, uint32_t, i));
+        parent->num_subtree_folders += folder->num_subtree_folders;
+    }
+    return g_ptr_array_index(folders, 0);
+}
+
+// Loads the checkpoint at `file_path` if it was written by a scan with the config in `expected_header`
+static FsearchDatabaseScanCheckpointFolder *
+checkpoint_load(const char *file_path, GByteArray *expected_header, const char *include_path, int64_t *created_out) {
+    g_autoptr(GMappedFile) mapped_file = g_mapped_file_new(file_path, FALSE, NULL);
+    if (!mapped_file) {
+        return NULL;
+    }
+    const uint8_t *data = (const uint8_t *)g_mapped_file_get_contents(mapped_file);
+    const size_t size = g_mapped_file_get_length(mapped_file);
+
+    const size_t header_size = expected_header->len;
+    if (size < header_size || memcmp(data, expected_header->data, DATABASE_SCAN_CHECKPOINT_CREATED_OFFSET) != 0) {
+        g_debug("[checkpoint] %s isn't a valid checkpoint", file_path);
+        return NULL;
+    }
+    if (memcmp(data + DATABASE_SCAN_CHECKPOINT_CONFIG_OFFSET,
+               expected_header->data + DATABASE_SCAN_CHECKPOINT_CONFIG_OFFSET,
+               header_size - DATABASE_SCAN_CHECKPOINT_CONFIG_OFFSET)
+        != 0) {
+        g_debug("[checkpoint] %s was written with a different config", file_path);
+        return NULL;
+    }
+
+    int64_t created = 0;
+    memcpy(&created, data + DATABASE_SCAN_CHECKPOINT_CREATED_OFFSET, sizeof(created));
+    const int64_t now = g_get_real_time() / G_USEC_PER_SEC;
+    if (now - created > DATABASE_SCAN_CHECKPOINT_MAX_AGE_SECONDS) {
+        g_debug("[checkpoint] %s is outdated", file_path);
+        return NULL;
+    }
+
+    FsearchDatabaseScanCheckpointFolder *root = checkpoint_parse_records(data, size, header_size, include_path);
+    if (root) {
+        *created_out = created;
+    }
+    return root;
+}
+
+static bool
+checkpoint_write_all(int fd, const uint8_t *data, size_t size) {
+    while (size > 0) {
+        const ssize_t written = write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        size -= written;
+    }
+    return true;
+}
+
+static bool
+checkpoint_get_folder_index(FsearchDatabaseScanCheckpoint *self, FsearchDatabaseEntry *folder, uint32_t *idx_out) {
+    const uint32_t idx = GPOINTER_TO_UINT(g_hash_table_lookup(self->folder_indices, folder));
+    if (idx == 0) {
+        return false;
+    }
+    *idx_out = idx - 1;
+    return true;
+}
+
+static bool
+checkpoint_get_parent_index(FsearchDatabaseScanCheckpoint *self, FsearchDatabaseEntry *entry, uint32_t *idx_out) {
+    FsearchDatabaseEntry *parent = db_entry_get_parent(entry);
+    if (!parent) {
+        *idx_out = DATABASE_SCAN_CHECKPOINT_NO_PARENT;
+        return true;
+    }
+    return checkpoint_get_folder_index(self, parent, idx_out);
+}
+
+char *
+fsearch_database_scan_checkpoint_get_dir(const char *db_file_path) {
+    g_return_val_if_fail(db_file_path, NULL);
+    return g_strconcat(db_file_path, ".checkpoints", NULL);
+}
+
+char *
+fsearch_database_scan_checkpoint_get_path(const char *dir, const char *include_path) {
+    g_return_val_if_fail(dir, NULL);
+    g_return_val_if_fail(include_path, NULL);
+
+    const uint64_t hash = fsearch_hash_compute(include_path, strlen(include_path), 0);
+    g_autofree char *name = g_strdup_printf("%016" PRIx64 ".scan", hash);
+    return g_build_filename(dir, name, NULL);
+}
+
+bool
+fsearch_database_scan_checkpoint_exists(const char *file_path) {
+    g_return_val_if_fail(file_path, false);
+    return g_file_test(file_path, G_FILE_TEST_IS_REGULAR);
+}
+
+FsearchDatabaseScanCheckpoint *
+fsearch_database_scan_checkpoint_open(const char *file_path,
+                                      const char *include_path,
+                                      FsearchDatabaseExcludeManager *exclude_manager,
+                                      bool one_file_system) {
+    g_return_val_if_fail(file_path, NULL);
+    g_return_val_if_fail(include_path, NULL);
+    g_return_val_if_fail(exclude_manager, NULL);
+
+    const uint64_t excludes_hash = checkpoint_hash_excludes(exclude_manager);
+
+    FsearchDatabaseScanCheckpoint *self = g_new0(FsearchDatabaseScanCheckpoint, 1);
+    self->file_path = g_strdup(file_path);
+    self->tmp_file_path = g_strconcat(file_path, ".tmp", NULL);
+    self->fd = -1;
+    self->pending = g_byte_array_new();
+    self->timer = g_timer_new();
+    self->folder_indices = g_hash_table_new(NULL, NULL);
+
+    g_autoptr(GByteArray) expected_header = g_byte_array_new();
+    checkpoint_append_header(expected_header, 0, excludes_hash, one_file_system, include_path);
+
+    // A resumed scan keeps the age of the entries it takes over
+    int64_t created = g_get_real_time() / G_USEC_PER_SEC;
+    self->resume_root = checkpoint_load(file_path, expected_header, include_path, &created);
+    if (self->resume_root) {
+        g_debug("[checkpoint] resume scan of %s with %u folders", include_path, self->resume_root->num_subtree_folders);
+    }
+
+    self->created = created;
+    checkpoint_append_header(self->pending, created, excludes_hash, one_file_system, include_path);
+
+    return self;
+}
+
+void
+fsearch_database_scan_checkpoint_free(FsearchDatabaseScanCheckpoint *self) {
+    g_return_if_fail(self);
+
+    if (self->fd >= 0) {
+        close(self->fd);
+        self->fd = -1;
+    }
+    if (!self->published) {
+        g_remove(self->tmp_file_path);
+    }
+
+    g_clear_pointer(&self->resume_root, checkpoint_folder_free);
+    g_clear_pointer(&self->folder_indices, g_hash_table_unref);
+    g_clear_pointer(&self->timer, g_timer_destroy);
+    g_clear_pointer(&self->pending, g_byte_array_unref);
+    g_clear_pointer(&self->tmp_file_path, g_free);
+    g_clear_pointer(&self->file_path, g_free);
+    g_clear_pointer(&self, g_free);
+}
+
+FsearchDatabaseScanCheckpointFolder *
+fsearch_database_scan_checkpoint_get_resume_root(FsearchDatabaseScanCheckpoint *self) {
+    g_return_val_if_fail(self, NULL);
+    return self->resume_root;
+}
+
+int64_t
+fsearch_database_scan_checkpoint_get_created(FsearchDatabaseScanCheckpoint *self) {
+    g_return_val_if_fail(self, 0);
+    return self->created;
+}
+
+void
+fsearch_database_scan_checkpoint_add_folder(FsearchDatabaseScanCheckpoint *self, FsearchDatabaseEntry *folder) {
+    g_return_if_fail(self);
+    g_return_if_fail(folder);
+
+    uint32_t parent_idx = 0;
+    if (!checkpoint_get_parent_index(self, folder, &parent_idx)) {
+        g_warning("[checkpoint] parent of folder wasn't added: %s", db_entry_get_name_raw(folder));
+        return;
+    }
+    g_hash_table_insert(self->folder_indices, folder, GUINT_TO_POINTER(++self->num_folders));
+    if (!self->failed) {
+        checkpoint_append_entry(self->pending, CHECKPOINT_RECORD_FOLDER, parent_idx, folder);
+    }
+}
+
+void
+fsearch_database_scan_checkpoint_add_file(FsearchDatabaseScanCheckpoint *self, FsearchDatabaseEntry *file) {
+    g_return_if_fail(self);
+    g_return_if_fail(file);
+
+    uint32_t parent_idx = 0;
+    if (!checkpoint_get_parent_index(self, file, &parent_idx) || parent_idx == DATABASE_SCAN_CHECKPOINT_NO_PARENT) {
+        g_warning("[checkpoint] parent of file wasn't added: %s", db_entry_get_name_raw(file));
+        return;
+    }
+    if (!self->failed) {
+        checkpoint_append_entry(self->pending, CHECKPOINT_RECORD_FILE, parent_idx, file);
+    }
+}
+
+void
+fsearch_database_scan_checkpoint_complete_folder(FsearchDatabaseScanCheckpoint *self, FsearchDatabaseEntry *folder) {
+    g_return_if_fail(self);
+    g_return_if_fail(folder);
+
+    uint32_t idx = 0;
+    if (self->failed || !checkpoint_get_folder_index(self, folder, &idx)) {
+        return;
+    }
+    const uint8_t type = CHECKPOINT_RECORD_COMPLETED;
+    g_byte_array_append(self->pending, &type, sizeof(type));
+    g_byte_array_append(self->pending, (const guint8 *)&idx, sizeof(idx));
+}
+
+bool
+fsearch_database_scan_checkpoint_is_due(FsearchDatabaseScanCheckpoint *self) {
+    g_return_val_if_fail(self, false);
+    if (self->failed) {
+        return false;
+    }
+    return self->pending->len >= DATABASE_SCAN_CHECKPOINT_MAX_PENDING
+        || g_timer_elapsed(self->timer, NULL) >= DATABASE_SCAN_CHECKPOINT_INTERVAL_SECONDS;
+}
+
+bool
+fsearch_database_scan_checkpoint_flush(FsearchDatabaseScanCheckpoint *self, bool publish) {
+    g_return_val_if_fail(self, false);
+
+    if (self->failed) {
+        return false;
+    }
+    g_timer_start(self->timer);
+
+    if (self->fd < 0) {
+        g_autofree char *dir = g_path_get_dirname(self->tmp_file_path);
+        if (g_mkdir_with_parents(dir, 0700) != 0) {
+            g_debug("[checkpoint] failed to create %s: %s", dir, g_strerror(errno));
+        }
+        self->fd = g_open(self->tmp_file_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    }
+
+    bool res = self->fd >= 0 && checkpoint_write_all(self->fd, self->pending->data, self->pending->len);
+    g_byte_array_set_size(self->pending, 0);
+    if (res && publish) {
+        res = fdatasync(self->fd) == 0;
+        if (res && !self->published) {
+            // From now on the records are appended to the published file
+            res = g_rename(self->tmp_file_path, self->file_path) == 0;
+            self->published = res;
+        }
+    }
+    if (!res) {
+        // Give up on this checkpoint, a partially written one would lose records in the middle
+        g_debug("[checkpoint] failed to write %s: %s", self->tmp_file_path, g_strerror(errno));
+        self->failed = true;
+    }
+    return res;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "fsearch_database_entry.h"
+#include "fsearch_database_exclude_manager.h"
+
+#include <glib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+G_BEGIN_DECLS
+
+// Progress of the scan of one include, which is written to disk while the scan is running. It lists the entries which
+// were found so far and the folders which were read completely, so an interrupted scan can continue from there
+// instead of starting over.
+typedef struct FsearchDatabaseScanCheckpoint FsearchDatabaseScanCheckpoint;
+
+// A folder of the interrupted scan and its children
+typedef struct FsearchDatabaseScanCheckpointFolder {
+    // The entries aren't linked to their parents, that's left to the scan which resumes. It takes them over by
+    // setting them to NULL here.
+    FsearchDatabaseEntry *entry;
+    GPtrArray *folders;
+    GPtrArray *files;
+    // Number of folders in this subtree, including this one
+    uint32_t num_subtree_folders;
+    // All children of the folder were found
+    bool completed;
+} FsearchDatabaseScanCheckpointFolder;
+
+// Returns the directory for the checkpoints of the database file `db_file_path`
+char *
+fsearch_database_scan_checkpoint_get_dir(const char *db_file_path);
+
+// Returns the path of the checkpoint of a scan of `include_path` in `dir`
+char *
+fsearch_database_scan_checkpoint_get_path(const char *dir, const char *include_path);
+
+// Whether there's a checkpoint at `file_path` a scan can resume from
+bool
+fsearch_database_scan_checkpoint_exists(const char *file_path);
+
+// Opens the checkpoint at `file_path` for a scan of `include_path`. If the file was written by a scan with the same
+// config, its content can be resumed from. The checkpoint of the new scan replaces it with the first call to
+// fsearch_database_scan_checkpoint_flush() which publishes it.
+FsearchDatabaseScanCheckpoint *
+fsearch_database_scan_checkpoint_open(const char *file_path,
+                                      const char *include_path,
+                                      FsearchDatabaseExcludeManager *exclude_manager,
+                                      bool one_file_system);
+
+// Closes the checkpoint. If it was never published, the previous checkpoint is kept.
+void
+fsearch_database_scan_checkpoint_free(FsearchDatabaseScanCheckpoint *self);
+
+// Returns the root folder of the interrupted scan, or NULL if there's nothing to resume from
+FsearchDatabaseScanCheckpointFolder *
+fsearch_database_scan_checkpoint_get_resume_root(FsearchDatabaseScanCheckpoint *self);
+
+// Returns when the first scan of the checkpoint started, in seconds since the epoch. Every entry of the checkpoint was
+// found after that.
+int64_t
+fsearch_database_scan_checkpoint_get_created(FsearchDatabaseScanCheckpoint *self);
+
+// Records that `folder` was found. Its parent must have been added before.
+void
+fsearch_database_scan_checkpoint_add_folder(FsearchDatabaseScanCheckpoint *self, FsearchDatabaseEntry *folder);
+
+// Records that `file` was found. Its parent must have been added before.
+void
+fsearch_database_scan_checkpoint_add_file(FsearchDatabaseScanCheckpoint *self, FsearchDatabaseEntry *file);
+
+// Records that all children of `folder` were found
+void
+fsearch_database_scan_checkpoint_complete_folder(FsearchDatabaseScanCheckpoint *self, FsearchDatabaseEntry *folder);
+
+// Whether enough time passed, or enough records were collected, since the last flush
+bool
+fsearch_database_scan_checkpoint_is_due(FsearchDatabaseScanCheckpoint *self);
+
+// Writes the pending records. If `publish` is set, they're synced to the disk and the checkpoint replaces the one the
+// scan was resumed from, otherwise they're only written to a temporary file.
+bool
+fsearch_database_scan_checkpoint_flush(FsearchDatabaseScanCheckpoint *self, bool publish);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(FsearchDatabaseScanCheckpoint, fsearch_database_scan_checkpoint_free)
+
+G_END_DECLS
@@ -18,6 +18,7 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 struct FsearchDatabaseSearchView {
     FsearchQuery *query;
@@ -171,29 +172,21 @@ fsearch_database_search_view_select_range(FsearchDatabaseSearchView *view, int32
 void
 fsearch_database_search_view_select_all(FsearchDatabaseSearchView *view) {
     g_return_if_fail(view);
-    g_autoptr(DynamicArray) file_chunks = fsearch_database_chunked_array_get_chunks(view->file_chunks);
-    g_autoptr(DynamicArray) folder_chunks = fsearch_database_chunked_array_get_chunks(view->folder_chunks);
+    g_autoptr(DynamicArray) files = fsearch_database_chunked_array_get_joined(view->file_chunks);
+    g_autoptr(DynamicArray) folders = fsearch_database_chunked_array_get_joined(view->folder_chunks);
 
-    for (uint32_t i = 0; i < darray_get_num_items(file_chunks); ++i) {
-        fsearch_selection_select_all(view->file_selection, darray_get_item(file_chunks, i));
-    }
-    for (uint32_t i = 0; i < darray_get_num_items(folder_chunks); ++i) {
-        fsearch_selection_select_all(view->folder_selection, darray_get_item(folder_chunks, i));
-    }
+    fsearch_selection_select_all(view->file_selection, files);
+    fsearch_selection_select_all(view->folder_selection, folders);
 }
 
 void
 fsearch_database_search_view_invert_selection(FsearchDatabaseSearchView *view) {
     g_return_if_fail(view);
-    g_autoptr(DynamicArray) file_chunks = fsearch_database_chunked_array_get_chunks(view->file_chunks);
-    g_autoptr(DynamicArray) folder_chunks = fsearch_database_chunked_array_get_chunks(view->folder_chunks);
+    g_autoptr(DynamicArray) files = fsearch_database_chunked_array_get_joined(view->file_chunks);
+    g_autoptr(DynamicArray) folders = fsearch_database_chunked_array_get_joined(view->folder_chunks);
 
-    for (uint32_t i = 0; i < darray_get_num_items(file_chunks); ++i) {
-        fsearch_selection_invert(view->file_selection, darray_get_item(file_chunks, i));
-    }
-    for (uint32_t i = 0; i < darray_get_num_items(folder_chunks); ++i) {
-        fsearch_selection_invert(view->folder_selection, darray_get_item(folder_chunks, i));
-    }
+    fsearch_selection_invert(view->file_selection, files);
+    fsearch_selection_invert(view->folder_selection, folders);
 }
 
 void
@@ -212,6 +205,31 @@ fsearch_database_search_view_selection_foreach(FsearchDatabaseSearchView *view,
     g_hash_table_foreach(view->file_selection, func, user_data);
 }
 
+DynamicArray *
+fsearch_database_search_view_get_sort_preview(FsearchDatabaseSearchView *view,
+                                              FsearchDatabaseIndexProperty sort_order,
+                                              GtkSortType sort_type,
+                                              uint32_t num_entries,
+                                              GCancellable *cancellable) {
+    g_return_val_if_fail(view, NULL);
+
+    if (view->chain.length > 0 && view->chain.properties[0] == sort_order) {
+        // Only the sort type changes, which doesn't require any sorting
+        return NULL;
+    }
+
+    g_autoptr(DynamicArray) files_in = fsearch_database_chunked_array_get_joined(view->file_chunks);
+    g_autoptr(DynamicArray) folders_in = fsearch_database_chunked_array_get_joined(view->folder_chunks);
+
+    return fsearch_database_sort_results_preview(view->chain,
+                                                 sort_order,
+                                                 sort_type,
+                                                 files_in,
+                                                 folders_in,
+                                                 num_entries,
+                                                 cancellable);
+}
+
 void
 fsearch_database_search_view_sort(FsearchDatabaseSearchView *view,
                                   DynamicArray *files_fast_sorted,
@@ -293,7 +311,8 @@ void
 fsearch_database_search_view_add(FsearchDatabaseSearchView *view,
                                  DynamicArray *files,
                                  DynamicArray *folders,
-                                 FsearchDatabaseIndexPropertyFlags affected_sort_orders) {
+                                 FsearchDatabaseIndexPropertyFlags affected_sort_orders,
+                                 FsearchQueryMatchData *match_data) {
     g_return_if_fail(view);
 
     // Skip adding when no level of the view's sort order chain is affected by this update
@@ -302,7 +321,11 @@ fsearch_database_search_view_add(FsearchDatabaseSearchView *view,
     }
 
     // Use the same match data for all comparisons
-    FsearchQueryMatchData *match_data = fsearch_query_match_data_new(NULL, NULL);
+    FsearchQueryMatchData *owned_match_data = NULL;
+    if (!match_data) {
+        owned_match_data = fsearch_query_match_data_new(NULL, NULL);
+        match_data = owned_match_data;
+    }
 
     g_autoptr(DynamicArray) matching_files = files ? darray_new(darray_get_num_items(files)) : NULL;
     g_autoptr(DynamicArray) matching_folders = folders ? darray_new(darray_get_num_items(folders)) : NULL;
@@ -335,7 +358,8 @@ fsearch_database_search_view_add(FsearchDatabaseSearchView *view,
         }
     }
 
-    g_clear_pointer(&match_data, fsearch_query_match_data_free);
+    fsearch_query_match_data_reset(match_data);
+    g_clear_pointer(&owned_match_data, fsearch_query_match_data_free);
 
     // Bulk insert the matches
     if (matching_files && darray_get_num_items(matching_files) > 0) {
@@ -362,6 +386,89 @@ fsearch_database_search_view_remove(FsearchDatabaseSearchView *view,
     remove_results(folders, view->folder_chunks, view->folder_selection, marked);
 }
 
+typedef struct {
+    GHashTable *entries;
+    const FsearchDatabaseSortOrderChain *chain;
+} SearchViewUpdateContext;
+
+static bool
+is_update_affecting_view(void *entry, void *data) {
+    SearchViewUpdateContext *ctx = data;
+    gpointer flags = NULL;
+    if (!g_hash_table_lookup_extended(ctx->entries, entry, NULL, &flags)) {
+        return false;
+    }
+    return fsearch_database_sort_order_chain_is_affected(ctx->chain, GPOINTER_TO_UINT(flags));
+}
+
+static void
+apply_updates(FsearchDatabaseSearchView *view,
+              GHashTable *removed,
+              GHashTable *added,
+              FsearchDatabaseChunkedArray *chunks,
+              GHashTable *selection,
+              FsearchQueryMatchData *match_data) {
+    if (removed && g_hash_table_size(removed) > 0) {
+        SearchViewUpdateContext ctx = {.entries = removed, .chain = &view->chain};
+        fsearch_database_chunked_array_drop_func(chunks, is_update_affecting_view, &ctx);
+
+        if (fsearch_selection_get_num_selected(selection) > 0) {
+            GHashTableIter iter;
+            gpointer entry = NULL;
+            g_hash_table_iter_init(&iter, removed);
+            while (g_hash_table_iter_next(&iter, &entry, NULL)) {
+                if (is_update_affecting_view(entry, &ctx)) {
+                    fsearch_selection_unselect(selection, entry);
+                }
+            }
+        }
+    }
+
+    if (added && g_hash_table_size(added) > 0) {
+        SearchViewUpdateContext ctx = {.entries = added, .chain = &view->chain};
+        g_autoptr(DynamicArray) matching = darray_new(g_hash_table_size(added));
+
+        GHashTableIter iter;
+        gpointer entry = NULL;
+        g_hash_table_iter_init(&iter, added);
+        while (g_hash_table_iter_next(&iter, &entry, NULL)) {
+            if (!is_update_affecting_view(entry, &ctx)) {
+                continue;
+            }
+            fsearch_query_match_data_set_entry(match_data, entry);
+            if (fsearch_query_match(view->query, match_data)) {
+                darray_add_item(matching, entry);
+            }
+        }
+        fsearch_query_match_data_reset(match_data);
+
+        if (darray_get_num_items(matching) > 0) {
+            fsearch_database_chunked_array_insert_array(chunks, matching);
+        }
+    }
+}
+
+void
+fsearch_database_search_view_apply_updates(FsearchDatabaseSearchView *view,
+                                           GHashTable *removed_files,
+                                           GHashTable *removed_folders,
+                                           GHashTable *added_files,
+                                           GHashTable *added_folders,
+                                           FsearchQueryMatchData *match_data) {
+    g_return_if_fail(view);
+
+    FsearchQueryMatchData *owned_match_data = NULL;
+    if (!match_data) {
+        owned_match_data = fsearch_query_match_data_new(NULL, NULL);
+        match_data = owned_match_data;
+    }
+
+    apply_updates(view, removed_files, added_files, view->file_chunks, view->file_selection, match_data);
+    apply_updates(view, removed_folders, added_folders, view->folder_chunks, view->folder_selection, match_data);
+
+    g_clear_pointer(&owned_match_data, fsearch_query_match_data_free);
+}
+
 // Getters
 
 FsearchDatabaseSearchInfo *
@@ -382,4 +489,32 @@ FsearchQuery *
 fsearch_database_search_view_get_query(FsearchDatabaseSearchView *view) {
     g_return_val_if_fail(view, NULL);
     return fsearch_query_ref(view->query);
+}
+
+bool
+fsearch_database_search_view_get_refinable_results(FsearchDatabaseSearchView *view,
+                                                   FsearchQuery *query,
+                                                   FsearchDatabaseIndexProperty sort_order,
+                                                   DynamicArray **files_out,
+                                                   DynamicArray **folders_out) {
+    g_return_val_if_fail(view, false);
+    g_return_val_if_fail(query, false);
+    g_return_val_if_fail(files_out, false);
+    g_return_val_if_fail(folders_out, false);
+
+    if (!view->is_complete || !view->query) {
+        return false;
+    }
+    const FsearchDatabaseSortOrderChain chain = fsearch_database_sort_order_chain_for_property(sort_order);
+    if (view->chain.length != chain.length
+        || memcmp(view->chain.properties, chain.properties, chain.length * sizeof(chain.properties[0])) != 0) {
+        return false;
+    }
+    if (!fsearch_query_is_refinement_of(query, view->query)) {
+        return false;
+    }
+
+    *files_out = fsearch_database_chunked_array_get_joined(view->file_chunks);
+    *folders_out = fsearch_database_chunked_array_get_joined(view->folder_chunks);
+    return true;
 }
\ No newline at end of file
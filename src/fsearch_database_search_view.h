@@ -30,11 +30,15 @@ void
 fsearch_database_search_view_free(FsearchDatabaseSearchView *view);
 
 // Manipulation
+
+// `match_data` is used to match the new entries against the view's query. Pass NULL to have a temporary one
+// allocated for this call.
 void
 fsearch_database_search_view_add(FsearchDatabaseSearchView *view,
                                  DynamicArray *files,
                                  DynamicArray *folders,
-                                 FsearchDatabaseIndexPropertyFlags affected_sort_orders);
+                                 FsearchDatabaseIndexPropertyFlags affected_sort_orders,
+                                 FsearchQueryMatchData *match_data);
 
 void
 fsearch_database_search_view_remove(FsearchDatabaseSearchView *view,
@@ -43,6 +47,19 @@ fsearch_database_search_view_remove(FsearchDatabaseSearchView *view,
                                     FsearchDatabaseIndexPropertyFlags affected_sort_orders,
                                     bool marked);
 
+// Applies a batch of updates at once: every entry of `removed_files` and `removed_folders` is removed with a single
+// pass over the results, then the entries of `added_files` and `added_folders` which match the query get merged in.
+// The tables map entries to the FsearchDatabaseIndexPropertyFlags affected by their update, updates which don't affect
+// the view's sort order chain are skipped, like with fsearch_database_search_view_add() and
+// fsearch_database_search_view_remove(). Removed entries are only looked at by address, so they may be freed already.
+void
+fsearch_database_search_view_apply_updates(FsearchDatabaseSearchView *view,
+                                           GHashTable *removed_files,
+                                           GHashTable *removed_folders,
+                                           GHashTable *added_files,
+                                           GHashTable *added_folders,
+                                           FsearchQueryMatchData *match_data);
+
 void
 fsearch_database_search_view_sort(FsearchDatabaseSearchView *view,
                                   DynamicArray *files_fast_sorted,
@@ -51,6 +68,15 @@ fsearch_database_search_view_sort(FsearchDatabaseSearchView *view,
                                   GtkSortType sort_type,
                                   GCancellable *cancellable);
 
+// Returns the first `num_entries` rows the view would show after fsearch_database_search_view_sort() without fast
+// sort indices, in display order. Returns NULL if the sort order doesn't change or it got cancelled.
+DynamicArray *
+fsearch_database_search_view_get_sort_preview(FsearchDatabaseSearchView *view,
+                                              FsearchDatabaseIndexProperty sort_order,
+                                              GtkSortType sort_type,
+                                              uint32_t num_entries,
+                                              GCancellable *cancellable);
+
 // Selection handling
 bool
 fsearch_database_search_view_is_selected(FsearchDatabaseSearchView *view, FsearchDatabaseEntry *entry);
@@ -77,4 +103,14 @@ fsearch_database_search_view_get_entry_for_idx(FsearchDatabaseSearchView *view,
 FsearchQuery *
 fsearch_database_search_view_get_query(FsearchDatabaseSearchView *view);
 
+// Returns the results of the view in `files_out` and `folders_out`, if they're complete and ordered by `sort_order`
+// alone and `query` is a refinement of the view's query. `query` can then be evaluated on them instead of the whole
+// index.
+bool
+fsearch_database_search_view_get_refinable_results(FsearchDatabaseSearchView *view,
+                                                   FsearchQuery *query,
+                                                   FsearchDatabaseIndexProperty sort_order,
+                                                   DynamicArray **files_out,
+                                                   DynamicArray **folders_out);
+
 G_END_DECLS
\ No newline at end of file
@@ -3,8 +3,11 @@
 #include "fsearch_database_sort.h"
 
 #include "fsearch_database_entry.h"
+#include "fsearch_database_file_type.h"
+#include "fsearch_file_utils.h"
 
 #include <glib.h>
+#include <string.h>
 
 static char *
 chain_to_string(FsearchDatabaseSortOrderChain chain) {
@@ -62,10 +65,9 @@ fsearch_database_sort_order_chain_for_property(FsearchDatabaseIndexProperty prop
         chain.properties[chain.length++] = DATABASE_INDEX_PROPERTY_PATH;
         break;
     case DATABASE_INDEX_PROPERTY_FILETYPE:
-        // No fast index exists for FILETYPE, so it has no natural continuation of its own;
-        // callers doing a manual sort must extend this with the array's previous chain via
-        // fsearch_database_sort_order_chain_prepend().
         chain.properties[chain.length++] = DATABASE_INDEX_PROPERTY_FILETYPE;
+        chain.properties[chain.length++] = DATABASE_INDEX_PROPERTY_NAME;
+        chain.properties[chain.length++] = DATABASE_INDEX_PROPERTY_PATH;
         break;
     default:
         break;
@@ -107,19 +109,199 @@ get_entries_sorted_from_reference_list(DynamicArray *old_list, DynamicArray *sor
     return new;
 }
 
+// Maps signed values to unsigned keys with the same order
+static inline uint64_t
+signed_to_key(int64_t value) {
+    return (uint64_t)value ^ (UINT64_C(1) << 63);
+}
+
+static uint64_t
+entry_size_key(void *entry, void *data) {
+    return signed_to_key(db_entry_get_size(entry));
+}
+
+static uint64_t
+entry_mtime_key(void *entry, void *data) {
+    return signed_to_key(db_entry_get_mtime(entry));
+}
+
+static uint64_t
+entry_name_key(void *entry, void *data) {
+    const char *name = db_entry_get_name_raw(entry);
+    return fsearch_file_utils_get_path_sort_key(name ? name : "");
+}
+
+static uint64_t
+entry_parent_ordinal_key(void *entry, void *data) {
+    GHashTable *parent_ordinals = data;
+    FsearchDatabaseEntry *parent = db_entry_get_parent(entry);
+    return parent ? GPOINTER_TO_UINT(g_hash_table_lookup(parent_ordinals, parent)) : 0;
+}
+
+static uint64_t
+entry_file_type_ordinal_key(void *entry, void *data) {
+    const uint32_t *file_type_ordinals = data;
+    return file_type_ordinals[db_entry_get_file_type_id(entry)];
+}
+
+static int32_t
+compare_file_type_ids(void **a, void **b, void *data) {
+    return strcmp(fsearch_database_file_type_get_description(GPOINTER_TO_UINT(*a)),
+                  fsearch_database_file_type_get_description(GPOINTER_TO_UINT(*b)));
+}
+
+// Maps the file type ids of `entries` to the rank of their description, starting at 1. Ids stand for distinct
+// descriptions, so there are no ties and only a handful of descriptions have to be compared.
+static uint32_t *
+get_file_type_ordinals(DynamicArray *entries, GCancellable *cancellable) {
+    uint32_t *file_type_ordinals = g_new0(uint32_t, FSEARCH_DATABASE_FILE_TYPE_ID_MAX + 1);
+    g_autoptr(DynamicArray) ids = darray_new(128);
+
+    const uint32_t num_entries = darray_get_num_items(entries);
+    for (uint32_t i = 0; i < num_entries; ++i) {
+        const uint16_t id = db_entry_get_file_type_id(darray_get_item(entries, i));
+        if (file_type_ordinals[id] == 0) {
+            file_type_ordinals[id] = 1;
+            darray_add_item(ids, GUINT_TO_POINTER(id));
+        }
+    }
+
+    darray_sort(ids, (DynamicArrayCompareDataFunc)compare_file_type_ids, cancellable, NULL);
+
+    const uint32_t num_ids = darray_get_num_items(ids);
+    for (uint32_t i = 0; i < num_ids; ++i) {
+        file_type_ordinals[GPOINTER_TO_UINT(darray_get_item(ids, i))] = i + 1;
+    }
+    return file_type_ordinals;
+}
+
+// Maps the parent folders of `entries` to the rank of their full path, starting at 1. Two entries are in PATH order
+// if and only if the ordinals of their parents are, so only the (much fewer) parents have to be compared by path.
+static GHashTable *
+get_parent_path_ordinals(DynamicArray *entries, GCancellable *cancellable) {
+    GHashTable *parent_ordinals = g_hash_table_new(NULL, NULL);
+    g_autoptr(DynamicArray) parents = darray_new(1024);
+
+    const uint32_t num_entries = darray_get_num_items(entries);
+    for (uint32_t i = 0; i < num_entries; ++i) {
+        FsearchDatabaseEntry *parent = db_entry_get_parent(darray_get_item(entries, i));
+        if (parent && !g_hash_table_contains(parent_ordinals, parent)) {
+            g_hash_table_add(parent_ordinals, parent);
+            darray_add_item(parents, parent);
+        }
+    }
+
+    // Folders have unique paths, so there are no ties and the ordinals are well defined
+    darray_sort_multi_threaded(parents,
+                               (DynamicArrayCompareDataFunc)db_entry_compare_entries_by_full_path,
+                               cancellable,
+                               NULL);
+
+    const uint32_t num_parents = darray_get_num_items(parents);
+    for (uint32_t i = 0; i < num_parents; ++i) {
+        g_hash_table_insert(parent_ordinals, darray_get_item(parents, i), GUINT_TO_POINTER(i + 1));
+    }
+    return parent_ordinals;
+}
+
+bool
+fsearch_database_sort_order_has_numeric_key(FsearchDatabaseIndexProperty property) {
+    switch (property) {
+    case DATABASE_INDEX_PROPERTY_PATH:
+    case DATABASE_INDEX_PROPERTY_SIZE:
+    case DATABASE_INDEX_PROPERTY_MODIFICATION_TIME:
+    case DATABASE_INDEX_PROPERTY_FILETYPE:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool
+fsearch_database_sort_entries_by_numeric_key(DynamicArray *entries,
+                                             FsearchDatabaseIndexProperty property,
+                                             GCancellable *cancellable) {
+    g_return_val_if_fail(entries, false);
+
+    switch (property) {
+    case DATABASE_INDEX_PROPERTY_PATH: {
+        g_autoptr(GHashTable) parent_ordinals = get_parent_path_ordinals(entries, cancellable);
+        if (!g_cancellable_is_cancelled(cancellable)) {
+            darray_sort_by_key(entries, entry_parent_ordinal_key, cancellable, parent_ordinals);
+        }
+        return true;
+    }
+    case DATABASE_INDEX_PROPERTY_SIZE:
+        darray_sort_by_key(entries, entry_size_key, cancellable, NULL);
+        return true;
+    case DATABASE_INDEX_PROPERTY_MODIFICATION_TIME:
+        darray_sort_by_key(entries, entry_mtime_key, cancellable, NULL);
+        return true;
+    case DATABASE_INDEX_PROPERTY_FILETYPE: {
+        g_autofree uint32_t *file_type_ordinals = get_file_type_ordinals(entries, cancellable);
+        if (!g_cancellable_is_cancelled(cancellable)) {
+            darray_sort_by_key(entries, entry_file_type_ordinal_key, cancellable, file_type_ordinals);
+        }
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+bool
+fsearch_database_sort_entries_by_name_key(DynamicArray *entries,
+                                          FsearchDatabaseSortOrderChain chain,
+                                          GCancellable *cancellable) {
+    g_return_val_if_fail(entries, false);
+
+    if (chain.length < 1 || chain.properties[0] != DATABASE_INDEX_PROPERTY_NAME) {
+        return false;
+    }
+    g_autoptr(FsearchDatabaseEntryCompareContext) ctx = db_entry_compare_context_new(chain);
+    darray_sort_by_key_with_ties(entries,
+                                 entry_name_key,
+                                 (DynamicArrayCompareDataFunc)db_entry_compare_entries_by_chain,
+                                 cancellable,
+                                 ctx);
+    return true;
+}
+
+bool
+fsearch_database_sort_entries_by_property(DynamicArray *entries,
+                                          bool entries_in_name_order,
+                                          FsearchDatabaseIndexProperty property,
+                                          int max_threads,
+                                          GCancellable *cancellable) {
+    g_return_val_if_fail(entries, false);
+
+    const FsearchDatabaseSortOrderChain chain = fsearch_database_sort_order_chain_for_property(property);
+    if (property == DATABASE_INDEX_PROPERTY_NAME) {
+        fsearch_database_sort_entries_by_name_key(entries, chain, cancellable);
+    }
+    else if (!entries_in_name_order || !fsearch_database_sort_entries_by_numeric_key(entries, property, cancellable)) {
+        g_autoptr(FsearchDatabaseEntryCompareContext) ctx = db_entry_compare_context_new(chain);
+        darray_sort_with_max_threads(entries,
+                                     (DynamicArrayCompareDataFunc)db_entry_compare_entries_by_chain,
+                                     max_threads,
+                                     cancellable,
+                                     ctx);
+    }
+    return !g_cancellable_is_cancelled(cancellable);
+}
+
 static DynamicArray *
-sort_entries(DynamicArray *entries_in, FsearchDatabaseSortOrderChain chain, GCancellable *cancellable, bool parallel_sort) {
+sort_entries(DynamicArray *entries_in, FsearchDatabaseSortOrderChain chain, GCancellable *cancellable) {
     DynamicArray *entries = darray_copy(entries_in);
-    g_autoptr(FsearchDatabaseEntryCompareContext) ctx = db_entry_compare_context_new(chain);
-    if (parallel_sort) {
-        darray_sort_multi_threaded(entries,
-                                   (DynamicArrayCompareDataFunc)db_entry_compare_entries_by_chain,
-                                   cancellable,
-                                   ctx);
+    // `entries_in` is ordered by the rest of the chain, so a stable sort by the first property is all it takes
+    if (fsearch_database_sort_entries_by_numeric_key(entries, chain.properties[0], cancellable)) {
+        return entries;
     }
-    else {
-        darray_sort(entries, (DynamicArrayCompareDataFunc)db_entry_compare_entries_by_chain, cancellable, ctx);
+    if (fsearch_database_sort_entries_by_name_key(entries, chain, cancellable)) {
+        return entries;
     }
+    g_autoptr(FsearchDatabaseEntryCompareContext) ctx = db_entry_compare_context_new(chain);
+    darray_sort_multi_threaded(entries, (DynamicArrayCompareDataFunc)db_entry_compare_entries_by_chain, cancellable, ctx);
     return entries;
 }
 
@@ -208,24 +390,17 @@ fsearch_database_sort_results(FsearchDatabaseSortOrderChain old_chain,
     // of each other.
     const FsearchDatabaseSortOrderChain new_chain = fsearch_database_sort_order_chain_prepend(old_chain, new_sort_order);
 
-    bool parallel_sort = true;
-    if (new_sort_order == DATABASE_INDEX_PROPERTY_FILETYPE) {
-        // Sorting by type can be really slow, because it accesses the filesystem to determine the type of files
-        // To mitigate that issue to a certain degree we cache the filetype for each file
-        // To avoid duplicating the filetype in memory for each file, we also store each filetype only once in
-        // a separate hash table.
-        // We also disable parallel sorting.
-        parallel_sort = false;
-    }
+    const bool radix_sort = fsearch_database_sort_order_has_numeric_key(new_sort_order)
+                         || new_sort_order == DATABASE_INDEX_PROPERTY_NAME;
 
     const bool folders_sorted = sort_order_affects_folders(new_sort_order);
     if (folders_sorted) {
-        *folders_out = sort_entries(folders_in, new_chain, cancellable, parallel_sort);
+        *folders_out = sort_entries(folders_in, new_chain, cancellable);
     }
     else {
         *folders_out = darray_copy(folders_in);
     }
-    *files_out = sort_entries(files_in, new_chain, cancellable, parallel_sort);
+    *files_out = sort_entries(files_in, new_chain, cancellable);
     *chain_out = new_chain;
 
     const double sort_time = g_timer_elapsed(timer, NULL) * 1000.0;
@@ -251,7 +426,99 @@ fsearch_database_sort_results(FsearchDatabaseSortOrderChain old_chain,
             num_folders,
             num_folders == 1 ? "" : "s",
             sort_time,
-            parallel_sort ? "parallel" : "single-threaded",
+            radix_sort ? "radix" : "parallel",
             folders_sorted ? "" : ", folders unsorted",
             chain_str);
 }
+
+static int32_t
+compare_entries_by_chain_reversed(FsearchDatabaseEntry **a, FsearchDatabaseEntry **b, gpointer data) {
+    return db_entry_compare_entries_by_chain(b, a, data);
+}
+
+// Appends up to `num_entries` entries of `entries`, which are already in the right order, to `preview`. They're taken
+// from the end in reverse order if `from_end` is set.
+static void
+add_preview_entries(DynamicArray *preview, DynamicArray *entries, uint32_t num_entries, bool from_end) {
+    const uint32_t num_available = darray_get_num_items(entries);
+    num_entries = MIN(num_entries, num_available);
+    for (uint32_t i = 0; i < num_entries; ++i) {
+        darray_add_item(preview, darray_get_item(entries, from_end ? num_available - i - 1 : i));
+    }
+}
+
+// Appends the first `num_entries` entries of `entries` sorted by `chain` to `preview`, or the last ones in reverse
+// order if `from_end` is set.
+static void
+add_sorted_preview_entries(DynamicArray *preview,
+                           DynamicArray *entries,
+                           uint32_t num_entries,
+                           FsearchDatabaseSortOrderChain chain,
+                           bool from_end,
+                           GCancellable *cancellable) {
+    if (num_entries == 0) {
+        return;
+    }
+    g_autoptr(FsearchDatabaseEntryCompareContext) ctx = db_entry_compare_context_new(chain);
+    g_autoptr(DynamicArray) first = darray_get_first_sorted(
+        entries,
+        num_entries,
+        (DynamicArrayCompareDataFunc)(from_end ? compare_entries_by_chain_reversed : db_entry_compare_entries_by_chain),
+        cancellable,
+        ctx);
+    darray_add_array(preview, first);
+}
+
+DynamicArray *
+fsearch_database_sort_results_preview(FsearchDatabaseSortOrderChain old_chain,
+                                      FsearchDatabaseIndexProperty new_sort_order,
+                                      GtkSortType sort_type,
+                                      DynamicArray *files_in,
+                                      DynamicArray *folders_in,
+                                      uint32_t num_entries,
+                                      GCancellable *cancellable) {
+    g_return_val_if_fail(files_in, NULL);
+    g_return_val_if_fail(folders_in, NULL);
+
+    g_autoptr(GTimer) timer = g_timer_new();
+
+    // Must match the chain fsearch_database_sort_results() sorts by, so the preview is the beginning of its result
+    const FsearchDatabaseSortOrderChain new_chain = fsearch_database_sort_order_chain_prepend(old_chain, new_sort_order);
+    const bool folders_sorted = sort_order_affects_folders(new_sort_order);
+
+    // Rows show folders before files, and for GTK_SORT_DESCENDING all of them in reverse order
+    const bool from_end = sort_type == GTK_SORT_DESCENDING;
+    DynamicArray *first_in = from_end ? files_in : folders_in;
+    DynamicArray *second_in = from_end ? folders_in : files_in;
+    const bool first_sorted = from_end || folders_sorted;
+    const bool second_sorted = !from_end || folders_sorted;
+
+    DynamicArray *preview = darray_new(MAX(num_entries, 1));
+    const uint32_t num_first = MIN(num_entries, darray_get_num_items(first_in));
+    if (first_sorted) {
+        add_sorted_preview_entries(preview, first_in, num_first, new_chain, from_end, cancellable);
+    }
+    else {
+        add_preview_entries(preview, first_in, num_first, from_end);
+    }
+    const uint32_t num_second = num_entries - num_first;
+    if (second_sorted) {
+        add_sorted_preview_entries(preview, second_in, num_second, new_chain, from_end, cancellable);
+    }
+    else {
+        add_preview_entries(preview, second_in, num_second, from_end);
+    }
+
+    if (g_cancellable_is_cancelled(cancellable)) {
+        g_clear_pointer(&preview, darray_unref);
+        return NULL;
+    }
+
+    g_debug("[db_sort] preview of %u entr%s by %s in %.3f ms",
+            darray_get_num_items(preview),
+            darray_get_num_items(preview) == 1 ? "y" : "ies",
+            fsearch_database_index_property_to_string(new_sort_order),
+            g_timer_elapsed(timer, NULL) * 1000.0);
+
+    return preview;
+}
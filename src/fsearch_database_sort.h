@@ -4,11 +4,11 @@
 #include "fsearch_database_index_properties.h"
 
 #include <gio/gio.h>
+#include <gtk/gtkenums.h>
 #include <stdbool.h>
 
 // Returns the canonical, fully deterministic comparator chain for a single sort property, e.g.
-// SIZE -> [SIZE, NAME, PATH]. FILETYPE has no natural continuation of its own ([FILETYPE]) since
-// there's no fast index to derive one from; see fsearch_database_sort_order_chain_prepend().
+// SIZE -> [SIZE, NAME, PATH].
 FsearchDatabaseSortOrderChain
 fsearch_database_sort_order_chain_for_property(FsearchDatabaseIndexProperty property);
 
@@ -19,6 +19,39 @@ fsearch_database_sort_order_chain_for_property(FsearchDatabaseIndexProperty prop
 FsearchDatabaseSortOrderChain
 fsearch_database_sort_order_chain_prepend(FsearchDatabaseSortOrderChain chain, FsearchDatabaseIndexProperty property);
 
+// Whether `property` can be sorted with fsearch_database_sort_entries_by_numeric_key()
+bool
+fsearch_database_sort_order_has_numeric_key(FsearchDatabaseIndexProperty property);
+
+// Sorts `entries` stably by SIZE, MODIFICATION_TIME, PATH or FILETYPE with a radix sort on a key extracted once per
+// entry. For PATH that's the rank of the entry's parent folder among all parents sorted by full path, so only the
+// parents are ever compared by path. For FILETYPE it's the rank of the entry's type description. When `entries` is ordered by some chain, it ends up ordered by
+// fsearch_database_sort_order_chain_prepend(chain, property), so ties are broken by the previous order (e.g. the name
+// index) instead of comparing names and paths again. Returns false and leaves `entries` untouched if `property` has
+// no numeric key.
+bool
+fsearch_database_sort_entries_by_numeric_key(DynamicArray *entries,
+                                             FsearchDatabaseIndexProperty property,
+                                             GCancellable *cancellable);
+
+// Sorts `entries` by `chain`, which has to start with NAME, with a radix sort on a prefix key of the names. Only
+// entries whose names share that prefix are compared with the chain. Returns false and leaves `entries` untouched if
+// `chain` doesn't start with NAME.
+bool
+fsearch_database_sort_entries_by_name_key(DynamicArray *entries,
+                                          FsearchDatabaseSortOrderChain chain,
+                                          GCancellable *cancellable);
+
+// Sorts `entries` like the fast sort index of `property`, i.e. by fsearch_database_sort_order_chain_for_property().
+// `entries_in_name_order` tells whether `entries` is ordered like the name index, then numeric properties are radix
+// sorted, which leaves ties in name order, just like their comparator chain would. Returns false if it got cancelled.
+bool
+fsearch_database_sort_entries_by_property(DynamicArray *entries,
+                                          bool entries_in_name_order,
+                                          FsearchDatabaseIndexProperty property,
+                                          int max_threads,
+                                          GCancellable *cancellable);
+
 void
 fsearch_database_sort_results(FsearchDatabaseSortOrderChain old_chain,
                               FsearchDatabaseIndexProperty new_sort_order,
@@ -30,3 +63,16 @@ fsearch_database_sort_results(FsearchDatabaseSortOrderChain old_chain,
                               DynamicArray **folders_out,
                               FsearchDatabaseSortOrderChain *chain_out,
                               GCancellable *cancellable);
+
+// Returns the first `num_entries` rows a manual sort of the results by `new_sort_order` with
+// fsearch_database_sort_results() would produce, in the order they're shown for `sort_type`: folders before files, and
+// everything in reverse order for GTK_SORT_DESCENDING. Only a partial selection of the results is done, so this is much
+// faster than the full sort for large result sets. Returns NULL if it got cancelled.
+DynamicArray *
+fsearch_database_sort_results_preview(FsearchDatabaseSortOrderChain old_chain,
+                                      FsearchDatabaseIndexProperty new_sort_order,
+                                      GtkSortType sort_type,
+                                      DynamicArray *files_in,
+                                      DynamicArray *folders_in,
+                                      uint32_t num_entries,
+                                      GCancellable *cancellable);
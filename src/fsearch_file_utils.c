@@ -861,4 +861,24 @@ fsearch_file_utils_cmp_paths(const char *s1, const char *s2) {
     default:
         return state;
     }
-}
\ No newline at end of file
+}
+
+uint64_t
+fsearch_file_utils_get_path_sort_key(const char *path) {
+    const unsigned char *p = (const unsigned char *)path;
+    uint64_t key = 0;
+    uint32_t i = 0;
+    for (; i < 8 && *p; ++i, ++p) {
+        const unsigned char c = *p;
+        if (isdigit(c)) {
+            // Numbers are compared by their value, so all digits share one weight and the key ends here
+            key = (key << 8) | '0';
+            ++i;
+            break;
+        }
+        // Same order as path_char_weight(), squeezed into a byte: '/' sorts before everything but the terminator
+        const unsigned char weight = c == '/' ? 1 : c < '/' ? c + 1 : c;
+        key = (key << 8) | weight;
+    }
+    return i < 8 ? key << ((8 - i) * 8) : key;
+}
@@ -20,6 +20,7 @@
 
 #include <gtk/gtk.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 typedef void
 (*FsearchFileUtilsOpenCallback)(gboolean result, const char *error_message, gpointer user_data);
@@ -80,4 +81,10 @@ bool
 fsearch_file_utils_get_info(const char *path, time_t *mtime, off_t *size, bool *is_dir);
 
 int
-fsearch_file_utils_cmp_paths(const char *a, const char *b);
\ No newline at end of file
+fsearch_file_utils_cmp_paths(const char *a, const char *b);
+
+// Returns a key made of the first bytes of `path`, such that if the key of a is smaller than the key of b,
+// fsearch_file_utils_cmp_paths() orders a before b. Paths with equal keys have to be compared with
+// fsearch_file_utils_cmp_paths().
+uint64_t
+fsearch_file_utils_get_path_sort_key(const char *path);
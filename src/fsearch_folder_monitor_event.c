@@ -35,18 +35,22 @@ fsearch_folder_monitor_event_new(const char *file_name,
     return ctx;
 }
 
-void
+bool
 fsearch_folder_monitor_event_set_watched_entry(FsearchFolderMonitorEvent *self, FsearchDatabaseEntry *watched_entry) {
-    g_return_if_fail(self);
-    g_return_if_fail(watched_entry);
+    g_return_val_if_fail(self, false);
+    g_return_val_if_fail(watched_entry, false);
 
     self->watched_entry_copy = (FsearchDatabaseEntry *)db_entry_get_deep_copy(watched_entry);
+    if (!self->watched_entry_copy) {
+        return false;
+    }
     self->path = db_entry_get_path_full(self->watched_entry_copy);
 
     if (self->name) {
         g_string_append_c(self->path, G_DIR_SEPARATOR);
         g_string_append(self->path, self->name->str);
     }
+    return true;
 }
 
 const char *
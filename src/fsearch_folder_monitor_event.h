@@ -47,7 +47,8 @@ fsearch_folder_monitor_event_new(const char *file_name,
                                  FsearchFolderMonitorKind monitor_kind,
                                  bool is_dir);
 
-void
+// Returns false if the copy of `watched_entry` couldn't be created
+bool
 fsearch_folder_monitor_event_set_watched_entry(FsearchFolderMonitorEvent *self, FsearchDatabaseEntry *watched_entry);
 
 void
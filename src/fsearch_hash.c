@@ -0,0 +1,157 @@
+#include "fsearch_hash.h"
+
+#include <string.h>
+
+#define HASH_PRIME_1 0x9E3779B185EBCA87ULL
+#define HASH_PRIME_2 0xC2B2AE3D27D4EB4FULL
+#define HASH_PRIME_3 0x165667B19E3779F9ULL
+#define HASH_PRIME_4 0x85EBCA77C2B2AE63ULL
+#define HASH_PRIME_5 0x27D4EB2F165667C5ULL
+
+// Size of the stripes which are consumed by the four accumulators at once
+#define HASH_STRIPE_SIZE 32
+
+static inline uint64_t
+hash_rotl(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+// The hash is defined on little endian values, so files hashed on different architectures compare equal
+static inline uint64_t
+hash_read64(const uint8_t *p) {
+    return (uint64_t)p[0] | (uint64_t)p[1] << 8 | (uint64_t)p[2] << 16 | (uint64_t)p[3] << 24 | (uint64_t)p[4] << 32
+         | (uint64_t)p[5] << 40 | (uint64_t)p[6] << 48 | (uint64_t)p[7] << 56;
+}
+
+static inline uint32_t
+hash_read32(const uint8_t *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static inline uint64_t
+hash_round(uint64_t acc, uint64_t input) {
+    acc += input * HASH_PRIME_2;
+    acc = hash_rotl(acc, 31);
+    return acc * HASH_PRIME_1;
+}
+
+static inline uint64_t
+hash_merge_round(uint64_t acc, uint64_t value) {
+    acc ^= hash_round(0, value);
+    return acc * HASH_PRIME_1 + HASH_PRIME_4;
+}
+
+// Consumes as many complete stripes of `data` as possible and returns the number of bytes consumed. The four lanes
+// don't depend on each other, which lets the compiler keep them in flight at the same time.
+static size_t
+hash_consume_stripes(uint64_t acc[4], const uint8_t *data, size_t size) {
+    const uint8_t *p = data;
+    const uint8_t *const end = data + size - size % HASH_STRIPE_SIZE;
+    uint64_t a0 = acc[0];
+    uint64_t a1 = acc[1];
+    uint64_t a2 = acc[2];
+    uint64_t a3 = acc[3];
+    while (p < end) {
+        a0 = hash_round(a0, hash_read64(p));
+        a1 = hash_round(a1, hash_read64(p + 8));
+        a2 = hash_round(a2, hash_read64(p + 16));
+        a3 = hash_round(a3, hash_read64(p + 24));
+        p += HASH_STRIPE_SIZE;
+    }
+    acc[0] = a0;
+    acc[1] = a1;
+    acc[2] = a2;
+    acc[3] = a3;
+    return p - data;
+}
+
+void
+fsearch_hash_init(FsearchHash *hash, uint64_t seed) {
+    memset(hash, 0, sizeof(*hash));
+    hash->seed = seed;
+    hash->acc[0] = seed + HASH_PRIME_1 + HASH_PRIME_2;
+    hash->acc[1] = seed + HASH_PRIME_2;
+    hash->acc[2] = seed;
+    hash->acc[3] = seed - HASH_PRIME_1;
+}
+
+void
+fsearch_hash_update(FsearchHash *hash, const void *data, size_t size) {
+    if (size == 0) {
+        return;
+    }
+    const uint8_t *p = data;
+    hash->total_size += size;
+
+    if (hash->buffer_size > 0) {
+        // Complete the stripe which was started by the previous call first
+        const size_t missing = HASH_STRIPE_SIZE - hash->buffer_size;
+        const size_t n = size < missing ? size : missing;
+        memcpy(hash->buffer + hash->buffer_size, p, n);
+        hash->buffer_size += n;
+        p += n;
+        size -= n;
+        if (hash->buffer_size < HASH_STRIPE_SIZE) {
+            return;
+        }
+        hash_consume_stripes(hash->acc, hash->buffer, HASH_STRIPE_SIZE);
+        hash->buffer_size = 0;
+    }
+
+    const size_t consumed = hash_consume_stripes(hash->acc, p, size);
+    p += consumed;
+    size -= consumed;
+
+    if (size > 0) {
+        memcpy(hash->buffer, p, size);
+        hash->buffer_size = size;
+    }
+}
+
+uint64_t
+fsearch_hash_digest(const FsearchHash *hash) {
+    uint64_t h = 0;
+    if (hash->total_size >= HASH_STRIPE_SIZE) {
+        const uint64_t *acc = hash->acc;
+        h = hash_rotl(acc[0], 1) + hash_rotl(acc[1], 7) + hash_rotl(acc[2], 12) + hash_rotl(acc[3], 18);
+        for (int i = 0; i < 4; i++) {
+            h = hash_merge_round(h, acc[i]);
+        }
+    }
+    else {
+        h = hash->seed + HASH_PRIME_5;
+    }
+    h += hash->total_size;
+
+    // The remaining bytes which don't fill a whole stripe
+    const uint8_t *p = hash->buffer;
+    const uint8_t *const end = hash->buffer + hash->buffer_size;
+    for (; p + 8 <= end; p += 8) {
+        h ^= hash_round(0, hash_read64(p));
+        h = hash_rotl(h, 27) * HASH_PRIME_1 + HASH_PRIME_4;
+    }
+    if (p + 4 <= end) {
+        h ^= (uint64_t)hash_read32(p) * HASH_PRIME_1;
+        h = hash_rotl(h, 23) * HASH_PRIME_2 + HASH_PRIME_3;
+        p += 4;
+    }
+    for (; p < end; p++) {
+        h ^= (uint64_t)*p * HASH_PRIME_5;
+        h = hash_rotl(h, 11) * HASH_PRIME_1;
+    }
+
+    h ^= h >> 33;
+    h *= HASH_PRIME_2;
+    h ^= h >> 29;
+    h *= HASH_PRIME_3;
+    h ^= h >> 32;
+    return h;
+}
+
+uint64_t
+fsearch_hash_compute(const void *data, size_t size, uint64_t seed) {
+    FsearchHash hash;
+    fsearch_hash_init(&hash, seed);
+    fsearch_hash_update(&hash, data, size);
+    return fsearch_hash_digest(&hash);
+}
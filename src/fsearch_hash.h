@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Fast non-cryptographic 64-bit hash (XXH64), used to detect corrupted database files. Hashing the same bytes in one
+// go or split over several calls of fsearch_hash_update() gives the same result.
+typedef struct {
+    uint64_t acc[4];
+    uint64_t seed;
+    uint64_t total_size;
+    uint8_t buffer[32];
+    uint32_t buffer_size;
+} FsearchHash;
+
+void
+fsearch_hash_init(FsearchHash *hash, uint64_t seed);
+
+void
+fsearch_hash_update(FsearchHash *hash, const void *data, size_t size);
+
+uint64_t
+fsearch_hash_digest(const FsearchHash *hash);
+
+// Hashes `size` bytes at `data` at once
+uint64_t
+fsearch_hash_compute(const void *data, size_t size, uint64_t seed);
@@ -41,7 +41,7 @@ fsearch_query_new(const char *search_term,
 
     q->search_term = strdup(search_term ? search_term : "");
 
-    q->query_tree = fsearch_query_node_tree_new(q->search_term, filters, flags);
+    q->query_tree = fsearch_query_node_tree_get_shared(q->search_term, filters, flags);
     if (q->query_tree) {
         q->triggers_auto_match_case = fsearch_query_node_tree_triggers_auto_match_case(q->query_tree);
         q->triggers_auto_match_path = fsearch_query_node_tree_triggers_auto_match_path(q->query_tree);
@@ -49,7 +49,18 @@ fsearch_query_new(const char *search_term,
     }
 
     if (filter && filter->query) {
-        q->filter_tree = fsearch_query_node_tree_new(filter->query, filters, filter->flags);
+        q->filter_tree = fsearch_query_node_tree_get_shared(filter->query, filters, filter->flags);
+    }
+
+    q->num_query_nodes = q->query_tree ? g_node_n_nodes(q->query_tree, G_TRAVERSE_ALL) : 0;
+    q->num_nodes = q->num_query_nodes + (q->filter_tree ? g_node_n_nodes(q->filter_tree, G_TRAVERSE_ALL) : 0);
+    if (g_getenv("FSEARCH_PROFILE_QUERIES")) {
+        fsearch_query_enable_profiling(q);
+    }
+
+    q->name_range_node = fsearch_query_node_tree_get_name_range_node(q->query_tree);
+    if (!q->name_range_node) {
+        q->name_range_node = fsearch_query_node_tree_get_name_range_node(q->filter_tree);
     }
 
     q->filter = fsearch_filter_ref(filter);
@@ -64,8 +75,9 @@ fsearch_query_free(FsearchQuery *query) {
     g_clear_pointer(&query->query_id, free);
     g_clear_pointer(&query->filter, fsearch_filter_unref);
     g_clear_pointer(&query->search_term, free);
-    g_clear_pointer(&query->query_tree, fsearch_query_node_tree_free);
-    g_clear_pointer(&query->filter_tree, fsearch_query_node_tree_free);
+    g_clear_pointer(&query->query_tree, fsearch_query_node_tree_release);
+    g_clear_pointer(&query->filter_tree, fsearch_query_node_tree_release);
+    g_clear_pointer(&query->profile, fsearch_query_profile_free);
     g_clear_pointer(&query, free);
 }
 
@@ -97,6 +109,43 @@ fsearch_query_matches_everything(FsearchQuery *query) {
     return false;
 }
 
+// Whether appending plain text to `term` can only make the query stricter. That's not the case if it contains
+// characters which have a meaning to the query parser (quotes, groups, operators, fields, comparisons, wildcards and
+// path separators) or operator keywords, since appending to those can change the structure of the query.
+static bool
+is_plain_search_term(const char *term) {
+    for (const char *c = term; *c != '\0'; c++) {
+        if (!g_ascii_isalnum(*c) && !strchr(" .-_,+#~@%'", *c)) {
+            return false;
+        }
+    }
+    g_auto(GStrv) words = g_strsplit(term, " ", -1);
+    for (uint32_t i = 0; words[i] != NULL; i++) {
+        if (!strcmp(words[i], "AND") || !strcmp(words[i], "OR") || !strcmp(words[i], "NOT")) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool
+fsearch_query_is_refinement_of(FsearchQuery *query, FsearchQuery *previous) {
+    g_return_val_if_fail(query, false);
+    g_return_val_if_fail(previous, false);
+
+    if (query->flags != previous->flags || query->flags & (QUERY_FLAG_REGEX | QUERY_FLAG_EXACT_MATCH)) {
+        return false;
+    }
+    // Filter trees are shared between queries, so identical filters result in the same tree
+    if (query->filter_tree != previous->filter_tree) {
+        return false;
+    }
+    // Appending to a search term only narrows down the results if every word of it still is a substring match, so
+    // the new characters must not change how the term gets parsed.
+    return g_str_has_prefix(query->search_term, previous->search_term) && is_plain_search_term(query->search_term)
+        && is_plain_search_term(previous->search_term);
+}
+
 static bool
 highlight(GNode *node, FsearchDatabaseEntry *entry, FsearchQueryMatchData *match_data, FsearchDatabaseEntryType type) {
     if (!node) {
@@ -171,6 +220,75 @@ matches(GNode *node, FsearchDatabaseEntry *entry, FsearchQueryMatchData *match_d
     }
 }
 
+static bool
+matches_profiled(GNode *node,
+                 FsearchDatabaseEntry *entry,
+                 FsearchQueryMatchData *match_data,
+                 FsearchDatabaseEntryType type,
+                 FsearchQueryNodeProfile *profiles) {
+    if (!node) {
+        return true;
+    }
+    FsearchQueryNode *n = node->data;
+    if (!n) {
+        return false;
+    }
+
+    FsearchQueryNodeProfile *profile = &profiles[n->profile_idx];
+    const bool sample = profile->num_evaluations % QUERY_PROFILE_SAMPLE_INTERVAL == 0;
+    const uint64_t start_ns = sample ? fsearch_query_profile_get_time_ns() : 0;
+    profile->num_evaluations++;
+
+    bool res = false;
+    if (n->type == FSEARCH_QUERY_NODE_TYPE_OPERATOR) {
+        GNode *left = node->children;
+        g_assert(left);
+        GNode *right = left->next;
+        if (n->operator == FSEARCH_QUERY_NODE_OPERATOR_AND) {
+            res = matches_profiled(left, entry, match_data, type, profiles)
+               && matches_profiled(right, entry, match_data, type, profiles);
+        }
+        else if (n->operator == FSEARCH_QUERY_NODE_OPERATOR_OR) {
+            res = matches_profiled(left, entry, match_data, type, profiles)
+               || matches_profiled(right, entry, match_data, type, profiles);
+        }
+        else {
+            res = !matches_profiled(left, entry, match_data, type, profiles);
+        }
+    }
+    else if (n->flags & QUERY_FLAG_FOLDERS_ONLY && type != DATABASE_ENTRY_TYPE_FOLDER) {
+        res = false;
+    }
+    else if (n->flags & QUERY_FLAG_FILES_ONLY && type != DATABASE_ENTRY_TYPE_FILE) {
+        res = false;
+    }
+    else {
+        res = n->search_func(n, match_data);
+    }
+
+    if (sample) {
+        profile->num_sampled_evaluations++;
+        profile->sampled_ns += fsearch_query_profile_get_time_ns() - start_ns;
+    }
+    if (res) {
+        profile->num_matches++;
+    }
+    return res;
+}
+
+static bool
+tree_matches(GNode *tree,
+             uint32_t profile_offset,
+             FsearchDatabaseEntry *entry,
+             FsearchQueryMatchData *match_data,
+             FsearchDatabaseEntryType type) {
+    FsearchQueryNodeProfile *profiles = fsearch_query_match_data_get_node_profiles(match_data, NULL);
+    if (G_UNLIKELY(profiles)) {
+        return matches_profiled(tree, entry, match_data, type, profiles + profile_offset);
+    }
+    return matches(tree, entry, match_data, type);
+}
+
 static bool
 filter_entry(FsearchDatabaseEntry *entry, FsearchQueryMatchData *match_data, FsearchQuery *query) {
     if (!query->filter) {
@@ -181,7 +299,7 @@ filter_entry(FsearchDatabaseEntry *entry, FsearchQueryMatchData *match_data, Fse
     }
     FsearchDatabaseEntryType type = db_entry_get_type(entry);
     if (query->filter_tree) {
-        return matches(query->filter_tree, entry, match_data, type);
+        return tree_matches(query->filter_tree, query->num_query_nodes, entry, match_data, type);
     }
     return true;
 }
@@ -217,5 +335,50 @@ fsearch_query_match(FsearchQuery *query, FsearchQueryMatchData *match_data) {
         return false;
     }
 
-    return matches(token, entry, match_data, type);
+    return tree_matches(token, 0, entry, match_data, type);
+}
+
+void
+fsearch_query_enable_profiling(FsearchQuery *query) {
+    g_return_if_fail(query);
+    if (!query->profile) {
+        query->profile = fsearch_query_profile_new(query->num_nodes);
+    }
+}
+
+FsearchQueryProfile *
+fsearch_query_get_profile(FsearchQuery *query) {
+    g_return_val_if_fail(query, NULL);
+    return query->profile;
+}
+
+char *
+fsearch_query_get_profile_string(FsearchQuery *query) {
+    g_return_val_if_fail(query, NULL);
+
+    GString *out = g_string_new(NULL);
+    g_string_append_printf(out, "query '%s':\n", query->search_term);
+    g_autofree char *query_tree_string = fsearch_query_node_tree_to_string(query->query_tree, query->profile, 0);
+    g_string_append(out, query_tree_string);
+    if (query->filter_tree) {
+        g_string_append_printf(out, "filter '%s':\n", query->filter && query->filter->name ? query->filter->name : "");
+        g_autofree char *filter_tree_string = fsearch_query_node_tree_to_string(query->filter_tree,
+                                                                                 query->profile,
+                                                                                 query->num_query_nodes);
+        g_string_append(out, filter_tree_string);
+    }
+
+    if (query->profile) {
+        g_autoptr(GArray) thread_profiles = fsearch_query_profile_get_thread_profiles(query->profile);
+        for (uint32_t i = 0; i < thread_profiles->len; ++i) {
+            FsearchQueryThreadProfile *thread_profile = &g_array_index(thread_profiles, FsearchQueryThreadProfile, i);
+            g_string_append_printf(out,
+                                   "thread %d: %u items, %u matches, %.3fms\n",
+                                   thread_profile->thread_id,
+                                   thread_profile->num_items,
+                                   thread_profile->num_matches,
+                                   (double)thread_profile->wall_time_us / 1000.0);
+        }
+    }
+    return g_string_free(out, FALSE);
 }
\ No newline at end of file
@@ -26,6 +26,8 @@
 #include "fsearch_filter_manager.h"
 #include "fsearch_query_flags.h"
 #include "fsearch_query_match_data.h"
+#include "fsearch_query_node.h"
+#include "fsearch_query_profile.h"
 
 typedef struct FsearchQuery {
     char *search_term;
@@ -33,9 +35,22 @@ typedef struct FsearchQuery {
     FsearchFilter *filter;
     FsearchFilterManager *filters;
 
+    // Both trees are shared with other queries (see fsearch_query_node_tree_get_shared()) and must not be modified
     GNode *query_tree;
     GNode *filter_tree;
 
+    // A node of `query_tree` or `filter_tree` every match has to satisfy, which can be resolved with a range lookup
+    // on the name sorted index. NULL if there's none.
+    FsearchQueryNode *name_range_node;
+
+    // Number of nodes in `query_tree` and in both trees. A profile stores the nodes of `query_tree` first, followed
+    // by the ones of `filter_tree` (see FsearchQueryNode::profile_idx).
+    uint32_t num_query_nodes;
+    uint32_t num_nodes;
+
+    // Per node and per thread statistics of the searches run with this query. NULL unless profiling is enabled.
+    FsearchQueryProfile *profile;
+
     char *query_id;
 
     FsearchQueryFlags flags;
@@ -63,10 +78,30 @@ fsearch_query_unref(FsearchQuery *query);
 bool
 fsearch_query_matches_everything(FsearchQuery *query);
 
+// Returns true if every entry which matches `query` is guaranteed to match `previous` as well, so `query` can be
+// evaluated on the results of `previous` instead of the whole index. That's the case when plain text was appended
+// to the search term of `previous`, e.g. while the user is typing.
+bool
+fsearch_query_is_refinement_of(FsearchQuery *query, FsearchQuery *previous);
+
 bool
 fsearch_query_match(FsearchQuery *queyr, FsearchQueryMatchData *match_data);
 
 bool
 fsearch_query_highlight(FsearchQuery *query, FsearchQueryMatchData *match_data);
 
+// Starts collecting statistics about every node of the query during the following searches. Has to be called before
+// the query is used for searching. Profiling is enabled for all queries when FSEARCH_PROFILE_QUERIES is set.
+void
+fsearch_query_enable_profiling(FsearchQuery *query);
+
+// Returns the statistics collected so far, or NULL if profiling isn't enabled. It's owned by the query.
+FsearchQueryProfile *
+fsearch_query_get_profile(FsearchQuery *query);
+
+// Returns the query and filter trees, annotated with the statistics of every node and the search threads if
+// profiling is enabled.
+char *
+fsearch_query_get_profile_string(FsearchQuery *query);
+
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(FsearchQuery, fsearch_query_unref)
\ No newline at end of file
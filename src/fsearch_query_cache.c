@@ -0,0 +1,208 @@
+#define G_LOG_DOMAIN "fsearch-query-cache"
+
+#include "fsearch_query_cache.h"
+
+#include <string.h>
+
+typedef struct {
+    char *key;
+    gpointer value;
+    // Approximate number of bytes the entry, its key and its value take up
+    size_t size;
+    uint32_t ref_count;
+    // Position in `unused` while ref_count is zero
+    GList *unused_link;
+} FsearchQueryCacheEntry;
+
+struct FsearchQueryCache {
+    // key -> FsearchQueryCacheEntry
+    GHashTable *entries_by_key;
+    // value -> FsearchQueryCacheEntry
+    GHashTable *entries_by_value;
+    // Entries which aren't in use, the least recently used one at the head
+    GQueue unused;
+    // Sum of the sizes of all entries, in use or not
+    size_t size;
+    size_t max_size;
+
+    FsearchQueryCacheSizeFunc value_size_func;
+    GDestroyNotify value_free_func;
+
+    GMutex mutex;
+};
+
+static void
+cache_entry_free(FsearchQueryCacheEntry *entry, GDestroyNotify value_free_func) {
+    g_clear_pointer(&entry->key, g_free);
+    if (value_free_func) {
+        g_clear_pointer(&entry->value, value_free_func);
+    }
+    g_clear_pointer(&entry, g_free);
+}
+
+static void
+cache_remove_entry(FsearchQueryCache *cache, FsearchQueryCacheEntry *entry) {
+    if (entry->unused_link) {
+        g_queue_delete_link(&cache->unused, g_steal_pointer(&entry->unused_link));
+    }
+    g_hash_table_remove(cache->entries_by_key, entry->key);
+    g_hash_table_remove(cache->entries_by_value, entry->value);
+    cache->size -= entry->size;
+    cache_entry_free(entry, cache->value_free_func);
+}
+
+// Frees unused entries, the least recently used first, until all entries take up at most `max_size` bytes or none
+// are unused anymore
+static void
+cache_evict(FsearchQueryCache *cache, size_t max_size) {
+    while (cache->size > max_size && !g_queue_is_empty(&cache->unused)) {
+        FsearchQueryCacheEntry *entry = g_queue_peek_head(&cache->unused);
+        cache_remove_entry(cache, entry);
+    }
+}
+
+static gpointer
+cache_ref_entry(FsearchQueryCache *cache, FsearchQueryCacheEntry *entry) {
+    if (entry->unused_link) {
+        g_queue_delete_link(&cache->unused, g_steal_pointer(&entry->unused_link));
+    }
+    entry->ref_count++;
+    return entry->value;
+}
+
+FsearchQueryCache *
+fsearch_query_cache_new(size_t max_size, FsearchQueryCacheSizeFunc value_size_func, GDestroyNotify value_free_func) {
+    FsearchQueryCache *cache = g_new0(FsearchQueryCache, 1);
+
+    cache->entries_by_key = g_hash_table_new(g_str_hash, g_str_equal);
+    cache->entries_by_value = g_hash_table_new(g_direct_hash, g_direct_equal);
+    g_queue_init(&cache->unused);
+    cache->max_size = max_size;
+    cache->value_size_func = value_size_func;
+    cache->value_free_func = value_free_func;
+    g_mutex_init(&cache->mutex);
+
+    return cache;
+}
+
+void
+fsearch_query_cache_free(FsearchQueryCache *cache) {
+    if (!cache) {
+        return;
+    }
+    GHashTableIter iter;
+    gpointer entry = NULL;
+    g_hash_table_iter_init(&iter, cache->entries_by_key);
+    while (g_hash_table_iter_next(&iter, NULL, &entry)) {
+        if (((FsearchQueryCacheEntry *)entry)->ref_count > 0) {
+            g_warning("[query_cache] freeing cache with values still in use");
+        }
+        cache_entry_free(entry, cache->value_free_func);
+    }
+    g_queue_clear(&cache->unused);
+    g_clear_pointer(&cache->entries_by_key, g_hash_table_destroy);
+    g_clear_pointer(&cache->entries_by_value, g_hash_table_destroy);
+    g_mutex_clear(&cache->mutex);
+    g_clear_pointer(&cache, g_free);
+}
+
+gpointer
+fsearch_query_cache_lookup(FsearchQueryCache *cache, const char *key) {
+    g_return_val_if_fail(cache, NULL);
+    g_return_val_if_fail(key, NULL);
+
+    g_mutex_lock(&cache->mutex);
+    FsearchQueryCacheEntry *entry = g_hash_table_lookup(cache->entries_by_key, key);
+    gpointer value = entry ? cache_ref_entry(cache, entry) : NULL;
+    g_mutex_unlock(&cache->mutex);
+
+    return value;
+}
+
+gpointer
+fsearch_query_cache_insert(FsearchQueryCache *cache, const char *key, gpointer value) {
+    g_return_val_if_fail(cache, NULL);
+    g_return_val_if_fail(key, NULL);
+    g_return_val_if_fail(value, NULL);
+
+    g_mutex_lock(&cache->mutex);
+    FsearchQueryCacheEntry *entry = g_hash_table_lookup(cache->entries_by_key, key);
+    if (entry) {
+        // Somebody else was faster
+        gpointer existing_value = cache_ref_entry(cache, entry);
+        g_mutex_unlock(&cache->mutex);
+        if (cache->value_free_func) {
+            cache->value_free_func(value);
+        }
+        return existing_value;
+    }
+
+    entry = g_new0(FsearchQueryCacheEntry, 1);
+    entry->key = g_strdup(key);
+    entry->value = value;
+    entry->size = sizeof(FsearchQueryCacheEntry) + strlen(key) + 1
+                + (cache->value_size_func ? cache->value_size_func(value) : 0);
+    entry->ref_count = 1;
+    cache->size += entry->size;
+    // Make room for the new value among the unused ones
+    cache_evict(cache, cache->max_size);
+    g_hash_table_insert(cache->entries_by_key, entry->key, entry);
+    g_hash_table_insert(cache->entries_by_value, entry->value, entry);
+    g_mutex_unlock(&cache->mutex);
+
+    return value;
+}
+
+void
+fsearch_query_cache_release(FsearchQueryCache *cache, gpointer value) {
+    g_return_if_fail(cache);
+    if (!value) {
+        return;
+    }
+
+    g_mutex_lock(&cache->mutex);
+    FsearchQueryCacheEntry *entry = g_hash_table_lookup(cache->entries_by_value, value);
+    if (!entry || entry->ref_count == 0) {
+        g_mutex_unlock(&cache->mutex);
+        g_critical("[query_cache] released value which isn't in use");
+        return;
+    }
+    entry->ref_count--;
+    if (entry->ref_count == 0) {
+        g_queue_push_tail(&cache->unused, entry);
+        entry->unused_link = g_queue_peek_tail_link(&cache->unused);
+        cache_evict(cache, cache->max_size);
+    }
+    g_mutex_unlock(&cache->mutex);
+}
+
+void
+fsearch_query_cache_clear_unused(FsearchQueryCache *cache) {
+    g_return_if_fail(cache);
+
+    g_mutex_lock(&cache->mutex);
+    cache_evict(cache, 0);
+    g_mutex_unlock(&cache->mutex);
+}
+
+uint32_t
+fsearch_query_cache_get_num_values(FsearchQueryCache *cache) {
+    g_return_val_if_fail(cache, 0);
+
+    g_mutex_lock(&cache->mutex);
+    const uint32_t num_values = g_hash_table_size(cache->entries_by_key);
+    g_mutex_unlock(&cache->mutex);
+
+    return num_values;
+}
+
+size_t
+fsearch_query_cache_get_size(FsearchQueryCache *cache) {
+    g_return_val_if_fail(cache, 0);
+
+    g_mutex_lock(&cache->mutex);
+    const size_t size = cache->size;
+    g_mutex_unlock(&cache->mutex);
+
+    return size;
+}
\ No newline at end of file
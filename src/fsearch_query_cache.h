@@ -0,0 +1,43 @@
+#pragma once
+
+#include <glib.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// A thread safe cache which interns expensive to build, immutable query objects (e.g. query trees or compiled regular
+// expressions) by a key. Values are reference counted: they stay alive while they are in use and afterwards are kept
+// around in least recently used order, until all values together take up more than `max_size` bytes.
+typedef struct FsearchQueryCache FsearchQueryCache;
+
+// Returns the approximate number of bytes `value` takes up
+typedef size_t (*FsearchQueryCacheSizeFunc)(gpointer value);
+
+FsearchQueryCache *
+fsearch_query_cache_new(size_t max_size, FsearchQueryCacheSizeFunc value_size_func, GDestroyNotify value_free_func);
+
+void
+fsearch_query_cache_free(FsearchQueryCache *cache);
+
+// Returns the value stored for `key` with an additional reference, or NULL if there's none.
+gpointer
+fsearch_query_cache_lookup(FsearchQueryCache *cache, const char *key);
+
+// Stores `value` for `key` and returns it with a reference held by the caller. If another thread inserted a value for
+// the same key in the meantime, `value` is freed and the existing value is returned instead.
+gpointer
+fsearch_query_cache_insert(FsearchQueryCache *cache, const char *key, gpointer value);
+
+// Drops a reference to a value returned by fsearch_query_cache_lookup() or fsearch_query_cache_insert().
+void
+fsearch_query_cache_release(FsearchQueryCache *cache, gpointer value);
+
+// Frees all values which aren't in use.
+void
+fsearch_query_cache_clear_unused(FsearchQueryCache *cache);
+
+uint32_t
+fsearch_query_cache_get_num_values(FsearchQueryCache *cache);
+
+// Returns the approximate number of bytes all values take up, including the ones in use.
+size_t
+fsearch_query_cache_get_size(FsearchQueryCache *cache);
\ No newline at end of file
@@ -1,10 +1,12 @@
 #include <glib.h>
 #include <locale.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "fsearch_database_entry.h"
 #include "fsearch_limits.h"
 #include "fsearch_query_match_data.h"
+#include "fsearch_query_profile.h"
 #include "fsearch_utf.h"
 
 struct FsearchQueryMatchData {
@@ -19,6 +21,13 @@ struct FsearchQueryMatchData {
 
     PangoAttrList **highlights;
 
+    pcre2_match_data *regex_match_data;
+    uint32_t regex_match_data_ovector_size;
+
+    FsearchQueryNodeProfile *node_profiles;
+    uint32_t node_profiles_capacity;
+    uint32_t num_node_profiles;
+
     size_t *file_attr_offsets;
     size_t *folder_attr_offsets;
 
@@ -184,6 +193,9 @@ fsearch_query_match_data_free(FsearchQueryMatchData *match_data) {
     g_string_free(g_steal_pointer(&match_data->parent_path_buffer), TRUE);
     g_string_free(g_steal_pointer(&match_data->content_type_buffer), TRUE);
 
+    g_clear_pointer(&match_data->regex_match_data, pcre2_match_data_free);
+    g_clear_pointer(&match_data->node_profiles, free);
+
     g_clear_pointer(&match_data, free);
 }
 
@@ -205,6 +217,41 @@ fsearch_query_match_data_set_entry(FsearchQueryMatchData *match_data, FsearchDat
     match_data->entry = entry;
 }
 
+void
+fsearch_query_match_data_reset(FsearchQueryMatchData *match_data) {
+    if (!match_data) {
+        return;
+    }
+    fsearch_query_match_data_set_entry(match_data, NULL);
+    match_data->matches = false;
+    match_data->thread_id = 0;
+    match_data->num_node_profiles = 0;
+}
+
+void
+fsearch_query_match_data_start_profiling(FsearchQueryMatchData *match_data, uint32_t num_nodes) {
+    g_return_if_fail(match_data);
+
+    if (num_nodes > match_data->node_profiles_capacity) {
+        g_clear_pointer(&match_data->node_profiles, free);
+        match_data->node_profiles = calloc(num_nodes, sizeof(FsearchQueryNodeProfile));
+        g_assert(match_data->node_profiles);
+        match_data->node_profiles_capacity = num_nodes;
+    }
+    else if (num_nodes > 0) {
+        memset(match_data->node_profiles, 0, num_nodes * sizeof(FsearchQueryNodeProfile));
+    }
+    match_data->num_node_profiles = num_nodes;
+}
+
+FsearchQueryNodeProfile *
+fsearch_query_match_data_get_node_profiles(FsearchQueryMatchData *match_data, uint32_t *num_node_profiles) {
+    if (num_node_profiles) {
+        *num_node_profiles = match_data->num_node_profiles;
+    }
+    return match_data->num_node_profiles > 0 ? match_data->node_profiles : NULL;
+}
+
 void
 fsearch_query_match_data_set_result(FsearchQueryMatchData *match_data, bool result) {
     match_data->matches = result;
@@ -259,4 +306,15 @@ fsearch_query_match_data_add_highlight(FsearchQueryMatchData *match_data,
     }
     pango_attr_list_change(match_data->highlights[idx], attribute);
     match_data->has_highlights = true;
+}
+
+pcre2_match_data *
+fsearch_query_match_data_get_regex_match_data(FsearchQueryMatchData *match_data, uint32_t ovector_size) {
+    g_assert(match_data);
+    if (G_UNLIKELY(!match_data->regex_match_data || match_data->regex_match_data_ovector_size < ovector_size)) {
+        g_clear_pointer(&match_data->regex_match_data, pcre2_match_data_free);
+        match_data->regex_match_data = pcre2_match_data_create(MAX(ovector_size, 1), NULL);
+        match_data->regex_match_data_ovector_size = match_data->regex_match_data ? MAX(ovector_size, 1) : 0;
+    }
+    return match_data->regex_match_data;
 }
\ No newline at end of file
@@ -1,9 +1,13 @@
 #pragma once
 
+#define PCRE2_CODE_UNIT_WIDTH 8
+
 #include "fsearch_database_entry.h"
+#include "fsearch_query_profile.h"
 #include "fsearch_utf.h"
 
 #include <pango/pango-attributes.h>
+#include <pcre2.h>
 #include <stdbool.h>
 #include <stdint.h>
 
@@ -15,6 +19,11 @@ fsearch_query_match_data_new(size_t *file_attr_offsets, size_t *folder_attr_offs
 void
 fsearch_query_match_data_free(FsearchQueryMatchData *match_data);
 
+// Drops the current entry and any highlights and stops profiling, so the match data can be reused for another search.
+// The allocated string and UTF buffers are kept.
+void
+fsearch_query_match_data_reset(FsearchQueryMatchData *match_data);
+
 void
 fsearch_query_match_data_set_entry(FsearchQueryMatchData *match_data, FsearchDatabaseEntry *entry);
 
@@ -63,4 +72,19 @@ FsearchUtfBuilder *
 fsearch_query_match_data_get_utf_name_builder(FsearchQueryMatchData *match_data);
 
 FsearchDatabaseEntry *
-fsearch_query_match_data_get_entry(FsearchQueryMatchData *match_data);
\ No newline at end of file
+fsearch_query_match_data_get_entry(FsearchQueryMatchData *match_data);
+
+// Returns PCRE2 match data with room for at least `ovector_size` pairs. It's owned by `match_data` and shared by
+// all regex nodes, which is fine since they are evaluated one after another.
+pcre2_match_data *
+fsearch_query_match_data_get_regex_match_data(FsearchQueryMatchData *match_data, uint32_t ovector_size);
+
+// Makes fsearch_query_match() count evaluations, matches and sampled timings of the `num_nodes` nodes of the query
+// in the match data, until it's reset.
+void
+fsearch_query_match_data_start_profiling(FsearchQueryMatchData *match_data, uint32_t num_nodes);
+
+// Returns the per node counters collected since profiling started, indexed by FsearchQueryNode::profile_idx, or NULL
+// if profiling isn't active.
+FsearchQueryNodeProfile *
+fsearch_query_match_data_get_node_profiles(FsearchQueryMatchData *match_data, uint32_t *num_node_profiles);
\ No newline at end of file
@@ -164,8 +164,8 @@ fsearch_query_matcher_regex(FsearchQueryNode *node, FsearchQueryMatchData *match
     if (G_UNLIKELY(!node->regex)) {
         return 0;
     }
-    const int32_t thread_id = fsearch_query_match_data_get_thread_id(match_data);
-    pcre2_match_data *regex_match_data = g_ptr_array_index(node->regex_match_data_for_threads, thread_id);
+    pcre2_match_data *regex_match_data = fsearch_query_match_data_get_regex_match_data(match_data,
+                                                                                       node->regex_ovector_size);
     if (G_UNLIKELY(!regex_match_data)) {
         return 0;
     }
@@ -278,9 +278,9 @@ uint32_t
 fsearch_query_matcher_highlight_regex(FsearchQueryNode *node, FsearchQueryMatchData *match_data) {
     const bool search_in_path = node->flags & QUERY_FLAG_SEARCH_IN_PATH;
     const char *haystack = node->haystack_func(match_data);
-    const int32_t thread_id = fsearch_query_match_data_get_thread_id(match_data);
     const size_t haystack_len = strlen(haystack);
-    pcre2_match_data *regex_match_data = g_ptr_array_index(node->regex_match_data_for_threads, thread_id);
+    pcre2_match_data *regex_match_data = fsearch_query_match_data_get_regex_match_data(match_data,
+                                                                                       node->regex_ovector_size);
     if (!regex_match_data) {
         return 0;
     }
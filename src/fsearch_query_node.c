@@ -2,6 +2,7 @@
 
 #include "fsearch_query_node.h"
 #include "fsearch_limits.h"
+#include "fsearch_query_cache.h"
 #include "fsearch_query_matchers.h"
 #include "fsearch_string_utils.h"
 #include "fsearch_utf.h"
@@ -11,6 +12,63 @@
 #include <stdbool.h>
 #include <string.h>
 
+// Compiled regular expressions which aren't used by any query anymore are kept around for a while, since the same
+// patterns tend to come up again, e.g. when a filter is selected again. The cache holds at most this many bytes of
+// compiled and JIT compiled code.
+#define REGEX_CACHE_MAX_SIZE ((size_t)4 << 20)
+
+static size_t
+regex_cache_get_regex_size(gpointer value) {
+    size_t size = 0;
+    size_t jit_size = 0;
+    pcre2_pattern_info(value, PCRE2_INFO_SIZE, &size);
+    pcre2_pattern_info(value, PCRE2_INFO_JITSIZE, &jit_size);
+    return size + jit_size;
+}
+
+static FsearchQueryCache *
+regex_cache_get(void) {
+    static FsearchQueryCache *regex_cache = NULL;
+    if (g_once_init_enter(&regex_cache)) {
+        g_once_init_leave(&regex_cache,
+                          fsearch_query_cache_new(REGEX_CACHE_MAX_SIZE,
+                                                  regex_cache_get_regex_size,
+                                                  (GDestroyNotify)pcre2_code_free));
+    }
+    return regex_cache;
+}
+
+static void
+regex_cache_release(pcre2_code *regex) {
+    fsearch_query_cache_release(regex_cache_get(), regex);
+}
+
+// Returns the compiled and JIT compiled `pattern`, which is shared with all other nodes using the same pattern and
+// options. It must be released with regex_cache_release().
+static pcre2_code *
+regex_cache_get_regex(const char *pattern, uint32_t options) {
+    FsearchQueryCache *regex_cache = regex_cache_get();
+    g_autofree char *key = g_strdup_printf("%x:%s", options, pattern);
+    pcre2_code *regex = fsearch_query_cache_lookup(regex_cache, key);
+    if (regex) {
+        return regex;
+    }
+
+    int error_code;
+    PCRE2_SIZE erroroffset;
+    regex = pcre2_compile((PCRE2_SPTR)pattern, (PCRE2_SIZE)strlen(pattern), options, &error_code, &erroroffset, NULL);
+    if (!regex) {
+        PCRE2_UCHAR buffer[256] = "";
+        pcre2_get_error_message(error_code, buffer, sizeof(buffer));
+        g_debug("[regex] PCRE2 compilation failed at offset %d. Error message: %s", (int)erroroffset, buffer);
+        return NULL;
+    }
+    if (pcre2_jit_compile(regex, PCRE2_JIT_COMPLETE) != 0) {
+        g_debug("[regex] JIT compilation failed.");
+    }
+    return fsearch_query_cache_insert(regex_cache, key, regex);
+}
+
 static void
 node_init_needle(FsearchQueryNode *node, const char *needle) {
     g_assert(node);
@@ -40,11 +98,9 @@ fsearch_query_node_free(FsearchQueryNode *node) {
     g_clear_pointer(&node->search_term_list, g_ptr_array_unref);
     g_clear_pointer(&node->needle_builder, free);
     g_clear_pointer(&node->needle, g_free);
+    g_clear_pointer(&node->name_range_key, g_free);
 
-    if (node->regex_match_data_for_threads) {
-        g_ptr_array_free(g_steal_pointer(&node->regex_match_data_for_threads), TRUE);
-    }
-    g_clear_pointer(&node->regex, pcre2_code_free);
+    g_clear_pointer(&node->regex, regex_cache_release);
 
     g_clear_pointer(&node, g_free);
 }
@@ -102,13 +158,16 @@ fsearch_query_node_new_date_modified(FsearchQueryFlags flags,
         // E.g. dm:=january doesn't mean 1 January 00:00 but the whole January
         comp_type = FSEARCH_QUERY_NODE_COMPARISON_RANGE;
     }
-    return new_numeric_node(dm_start,
-                            dm_end,
-                            comp_type,
-                            "date-modified",
-                            fsearch_query_matcher_date_modified,
-                            NULL,
-                            flags);
+    FsearchQueryNode *qnode = new_numeric_node(dm_start,
+                                               dm_end,
+                                               comp_type,
+                                               "date-modified",
+                                               fsearch_query_matcher_date_modified,
+                                               NULL,
+                                               flags);
+    // Relative dates like today or pastweek were already resolved with the current time
+    qnode->depends_on_current_time = true;
+    return qnode;
 }
 
 FsearchQueryNode *
@@ -223,22 +282,98 @@ fsearch_query_node_new_match_everything(FsearchQueryFlags flags) {
     return qnode;
 }
 
+static void
+node_set_name_range_key(FsearchQueryNode *node, const char *key, bool is_exact) {
+    g_assert(node);
+    g_clear_pointer(&node->name_range_key, g_free);
+    node->name_range_key_is_exact = false;
+
+    if (!key || node->flags & QUERY_FLAG_SEARCH_IN_PATH || strchr(key, G_DIR_SEPARATOR)) {
+        // The haystack isn't the name, or the key can only match the root folder, whose name is stored as ""
+        return;
+    }
+
+    g_autofree char *k = g_strdup(key);
+    if (!is_exact) {
+        // The name index sorts digit sequences numerically (e.g. "a2" < "a10"), so names which share a prefix ending
+        // in a digit aren't necessarily next to each other. Dropping the trailing digits gives a prefix whose
+        // matches are contiguous; the extra candidates get filtered out by the full query later.
+        size_t len = strlen(k);
+        while (len > 0 && g_ascii_isdigit(k[len - 1])) {
+            k[--len] = '\0';
+        }
+    }
+    if (k[0] == '\0') {
+        return;
+    }
+    if (!(node->flags & QUERY_FLAG_MATCH_CASE)) {
+        // All spellings are looked up at once
+        g_autofree char *k_folded = g_ascii_strdown(k, -1);
+        g_clear_pointer(&k, g_free);
+        k = g_steal_pointer(&k_folded);
+    }
+    node->name_range_key = g_steal_pointer(&k);
+    node->name_range_key_is_exact = is_exact;
+}
+
+// Extracts the literal text a regex anchored with `^` requires every match to start with, e.g. "foo" for `^foo.*$`
+// or `^foo\.c?`. `is_exact` is set when the pattern is nothing but that literal, e.g. `^Makefile$`.
+static char *
+regex_get_literal_prefix(const char *pattern, FsearchQueryFlags flags, bool *is_exact) {
+    *is_exact = false;
+    if (pattern[0] != '^' || strchr(pattern, '|')) {
+        // Not anchored or it might have alternatives with different prefixes
+        return NULL;
+    }
+    const bool caseless = !(flags & QUERY_FLAG_MATCH_CASE);
+
+    g_autoptr(GString) prefix = g_string_new(NULL);
+    const char *p = pattern + 1;
+    while (*p != '\0') {
+        const char *literal = p;
+        if (*p == '\\') {
+            if (p[1] == '\0' || g_ascii_isalnum(p[1]) || !g_ascii_isprint(p[1])) {
+                // Character classes, back references, \Q...\E etc.
+                break;
+            }
+            literal = p + 1;
+        }
+        else if (strchr(".[]()*+?{}^$", *p)) {
+            *is_exact = *p == '$' && p[1] == '\0';
+            break;
+        }
+        const char *next = g_utf8_next_char(literal);
+        if (*next == '*' || *next == '?' || *next == '{') {
+            // The literal is optional or its repetition count is unknown
+            break;
+        }
+        if (caseless && (!g_ascii_isprint(*literal) || strchr("kKsS", *literal))) {
+            // In UTF mode caseless matching also maps characters outside of ASCII onto each other, and even some
+            // ASCII letters have non-ASCII case variants (e.g. the Kelvin sign), so those can't be expanded
+            break;
+        }
+        g_string_append_len(prefix, literal, next - literal);
+        p = next;
+        if (*p == '+') {
+            // The literal is required, but might be repeated
+            break;
+        }
+    }
+    if (*is_exact && *p != '$') {
+        *is_exact = false;
+    }
+    if (prefix->len == 0) {
+        *is_exact = false;
+        return NULL;
+    }
+    return g_string_free(g_steal_pointer(&prefix), FALSE);
+}
+
 FsearchQueryNode *
 fsearch_query_node_new_regex(const char *search_term, FsearchQueryFlags flags) {
-    int error_code;
-
-    PCRE2_SIZE erroroffset;
     uint32_t regex_options = PCRE2_UTF | (flags & QUERY_FLAG_MATCH_CASE ? 0 : PCRE2_CASELESS);
-    pcre2_code *regex = pcre2_compile((PCRE2_SPTR)search_term,
-                                      (PCRE2_SIZE)strlen(search_term),
-                                      regex_options,
-                                      &error_code,
-                                      &erroroffset,
-                                      NULL);
+    pcre2_code *regex = regex_cache_get_regex(search_term, regex_options);
     if (!regex) {
-        PCRE2_UCHAR buffer[256] = "";
-        pcre2_get_error_message(error_code, buffer, sizeof(buffer));
-        g_debug("[regex] PCRE2 compilation failed at offset %d. Error message: %s", (int)erroroffset, buffer);
         return fsearch_query_node_new_match_nothing();
     }
 
@@ -251,24 +386,23 @@ fsearch_query_node_new_regex(const char *search_term, FsearchQueryFlags flags) {
     qnode->type = FSEARCH_QUERY_NODE_TYPE_QUERY;
     qnode->flags = flags;
 
-    if (pcre2_jit_compile(regex, PCRE2_JIT_COMPLETE) != 0) {
-        g_debug("[regex] JIT compilation failed.");
-        qnode->regex_jit_available = false;
-    }
-    else {
-        qnode->regex_jit_available = true;
-    }
-    qnode->regex_match_data_for_threads = g_ptr_array_sized_new(FSEARCH_THREAD_LIMIT);
-    g_ptr_array_set_free_func(qnode->regex_match_data_for_threads, (GDestroyNotify)pcre2_match_data_free);
-    for (int32_t i = 0; i < FSEARCH_THREAD_LIMIT; i++) {
-        g_ptr_array_add(qnode->regex_match_data_for_threads, pcre2_match_data_create_from_pattern(qnode->regex, NULL));
-    }
+    size_t jit_size = 0;
+    pcre2_pattern_info(regex, PCRE2_INFO_JITSIZE, &jit_size);
+    qnode->regex_jit_available = jit_size > 0;
+
+    uint32_t capture_count = 0;
+    pcre2_pattern_info(regex, PCRE2_INFO_CAPTURECOUNT, &capture_count);
+    qnode->regex_ovector_size = capture_count + 1;
 
     qnode->search_func = fsearch_query_matcher_regex;
     qnode->haystack_func = (FsearchQueryNodeHaystackFunc *)(flags & QUERY_FLAG_SEARCH_IN_PATH
                                                                 ? fsearch_query_match_data_get_path_str
                                                                 : fsearch_query_match_data_get_name_str);
     qnode->highlight_func = fsearch_query_matcher_highlight_regex;
+
+    bool prefix_is_exact = false;
+    g_autofree char *prefix = regex_get_literal_prefix(search_term, flags, &prefix_is_exact);
+    node_set_name_range_key(qnode, prefix, prefix_is_exact);
     return qnode;
 }
 
@@ -377,6 +511,9 @@ query_node_new_string_comparison(const char *search_term, FsearchQueryFlags flag
                                                                     : fsearch_query_match_data_get_name_str);
         qnode->highlight_func = fsearch_query_matcher_highlight_ascii;
         qnode->description = g_string_new("ascii_icase");
+        if (flags & QUERY_FLAG_EXACT_MATCH) {
+            node_set_name_range_key(qnode, search_term, true);
+        }
     }
     else {
         qnode->search_func = flags & QUERY_FLAG_EXACT_MATCH
@@ -407,6 +544,7 @@ fsearch_query_node_new_contenttype(const char *search_term, FsearchQueryFlags fl
     if (res) {
         g_string_prepend(res->description, "contenttype_");
         res->haystack_func = (FsearchQueryNodeHaystackFunc *)fsearch_query_match_data_get_content_type_str;
+        node_set_name_range_key(res, NULL, false);
         res->highlight_func = fsearch_query_matcher_highlight_none;
         res->wants_single_threaded_search = true;
     }
@@ -65,16 +65,29 @@ struct FsearchQueryNode {
 
     FsearchUtfBuilder *needle_builder;
 
-    // Using the pcre2_code with multiple threads is safe.
-    // However, pcre2_match_data can't be shared across threads.
-    // So to avoid frequent calls to pcre2_match_data_create_from_pattern during the matching process,
-    // we simply generate an array which holds a unique instance for each thread per regex node.
+    // Using the pcre2_code with multiple threads is safe. It's shared with all nodes compiled from the same pattern.
+    // However, pcre2_match_data can't be shared across threads, so the matchers use the one owned by the
+    // FsearchQueryMatchData of the calling thread, which has to hold at least `regex_ovector_size` pairs.
     pcre2_code *regex;
-    GPtrArray *regex_match_data_for_threads;
+    uint32_t regex_ovector_size;
     bool regex_jit_available;
 
     FsearchQueryFlags flags;
 
+    // Position of the node in its tree (in pre-order), used to look up its counters in a FsearchQueryProfile
+    uint32_t profile_idx;
+
+    // If set, every entry matched by this node has a name which starts with `name_range_key` (or is equal to it,
+    // when `name_range_key_is_exact` is set), up to the case folding implied by `flags`. Without
+    // QUERY_FLAG_MATCH_CASE the key is in ASCII lower case. This allows resolving the node with a range lookup on the
+    // name sorted index instead of evaluating it for every entry.
+    char *name_range_key;
+    bool name_range_key_is_exact;
+
+    // The bounds of the node were computed from the time it was parsed at (e.g. dm:today), so it's only valid for a
+    // short while
+    bool depends_on_current_time;
+
     bool triggers_auto_match_case;
     bool triggers_auto_match_path;
     bool wants_single_threaded_search;
@@ -144,4 +157,4 @@ FsearchQueryNode *
 fsearch_query_node_new_contenttype(const char *search_term, FsearchQueryFlags flags);
 
 FsearchQueryNode *
-fsearch_query_node_new(const char *search_term, FsearchQueryFlags flags);
\ No newline at end of file
+fsearch_query_node_new(const char *search_term, FsearchQueryFlags flags);
@@ -0,0 +1,130 @@
+#define G_LOG_DOMAIN "fsearch-query-profile"
+
+#include "fsearch_query_profile.h"
+
+#include <stdlib.h>
+#include <time.h>
+
+struct FsearchQueryProfile {
+    FsearchQueryNodeProfile *node_profiles;
+    uint32_t num_nodes;
+
+    GArray *thread_profiles;
+
+    GMutex mutex;
+};
+
+FsearchQueryProfile *
+fsearch_query_profile_new(uint32_t num_nodes) {
+    FsearchQueryProfile *profile = calloc(1, sizeof(FsearchQueryProfile));
+    g_assert(profile);
+
+    profile->num_nodes = num_nodes;
+    profile->node_profiles = calloc(MAX(num_nodes, 1), sizeof(FsearchQueryNodeProfile));
+    g_assert(profile->node_profiles);
+    profile->thread_profiles = g_array_new(FALSE, TRUE, sizeof(FsearchQueryThreadProfile));
+
+    g_mutex_init(&profile->mutex);
+    return profile;
+}
+
+void
+fsearch_query_profile_free(FsearchQueryProfile *profile) {
+    if (!profile) {
+        return;
+    }
+    g_clear_pointer(&profile->node_profiles, free);
+    g_clear_pointer(&profile->thread_profiles, g_array_unref);
+    g_mutex_clear(&profile->mutex);
+    g_clear_pointer(&profile, free);
+}
+
+uint32_t
+fsearch_query_profile_get_num_nodes(FsearchQueryProfile *profile) {
+    g_return_val_if_fail(profile, 0);
+    return profile->num_nodes;
+}
+
+void
+fsearch_query_profile_add_node_profiles(FsearchQueryProfile *profile,
+                                        const FsearchQueryNodeProfile *node_profiles,
+                                        uint32_t num_node_profiles) {
+    g_return_if_fail(profile);
+    g_return_if_fail(node_profiles);
+
+    g_mutex_lock(&profile->mutex);
+    for (uint32_t i = 0; i < MIN(num_node_profiles, profile->num_nodes); ++i) {
+        FsearchQueryNodeProfile *total = &profile->node_profiles[i];
+        total->num_evaluations += node_profiles[i].num_evaluations;
+        total->num_matches += node_profiles[i].num_matches;
+        total->num_sampled_evaluations += node_profiles[i].num_sampled_evaluations;
+        total->sampled_ns += node_profiles[i].sampled_ns;
+    }
+    g_mutex_unlock(&profile->mutex);
+}
+
+void
+fsearch_query_profile_add_thread_profile(FsearchQueryProfile *profile,
+                                         int32_t thread_id,
+                                         uint32_t num_items,
+                                         uint32_t num_matches,
+                                         int64_t wall_time_us) {
+    g_return_if_fail(profile);
+
+    FsearchQueryThreadProfile thread_profile = {
+        .thread_id = thread_id,
+        .num_items = num_items,
+        .num_matches = num_matches,
+        .wall_time_us = wall_time_us,
+    };
+
+    g_mutex_lock(&profile->mutex);
+    g_array_append_val(profile->thread_profiles, thread_profile);
+    g_mutex_unlock(&profile->mutex);
+}
+
+bool
+fsearch_query_profile_get_node_profile(FsearchQueryProfile *profile,
+                                       uint32_t profile_idx,
+                                       FsearchQueryNodeProfile *node_profile_out) {
+    g_return_val_if_fail(profile, false);
+    g_return_val_if_fail(node_profile_out, false);
+
+    if (profile_idx >= profile->num_nodes) {
+        return false;
+    }
+
+    g_mutex_lock(&profile->mutex);
+    *node_profile_out = profile->node_profiles[profile_idx];
+    g_mutex_unlock(&profile->mutex);
+    return true;
+}
+
+GArray *
+fsearch_query_profile_get_thread_profiles(FsearchQueryProfile *profile) {
+    g_return_val_if_fail(profile, NULL);
+
+    g_mutex_lock(&profile->mutex);
+    GArray *thread_profiles = g_array_sized_new(FALSE, TRUE, sizeof(FsearchQueryThreadProfile), profile->thread_profiles->len);
+    g_array_append_vals(thread_profiles, profile->thread_profiles->data, profile->thread_profiles->len);
+    g_mutex_unlock(&profile->mutex);
+
+    return thread_profiles;
+}
+
+uint64_t
+fsearch_query_node_profile_get_estimated_ns(const FsearchQueryNodeProfile *node_profile) {
+    g_return_val_if_fail(node_profile, 0);
+    if (node_profile->num_sampled_evaluations == 0) {
+        return 0;
+    }
+    return (uint64_t)((double)node_profile->sampled_ns * (double)node_profile->num_evaluations
+                      / (double)node_profile->num_sampled_evaluations);
+}
+
+uint64_t
+fsearch_query_profile_get_time_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * G_GUINT64_CONSTANT(1000000000) + (uint64_t)ts.tv_nsec;
+}
\ No newline at end of file
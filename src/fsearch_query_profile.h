@@ -0,0 +1,68 @@
+#pragma once
+
+#include <glib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Evaluating a query node is timed only for every n-th evaluation, to keep the overhead of profiling low
+#define QUERY_PROFILE_SAMPLE_INTERVAL 64
+
+typedef struct FsearchQueryNodeProfile {
+    uint64_t num_evaluations;
+    uint64_t num_matches;
+    // Time spent in the node (including its children) during the sampled evaluations
+    uint64_t num_sampled_evaluations;
+    uint64_t sampled_ns;
+} FsearchQueryNodeProfile;
+
+typedef struct FsearchQueryThreadProfile {
+    int32_t thread_id;
+    uint32_t num_items;
+    uint32_t num_matches;
+    int64_t wall_time_us;
+} FsearchQueryThreadProfile;
+
+typedef struct FsearchQueryProfile FsearchQueryProfile;
+
+FsearchQueryProfile *
+fsearch_query_profile_new(uint32_t num_nodes);
+
+void
+fsearch_query_profile_free(FsearchQueryProfile *profile);
+
+uint32_t
+fsearch_query_profile_get_num_nodes(FsearchQueryProfile *profile);
+
+// Adds the counters one thread collected for every node to the totals. Thread safe.
+void
+fsearch_query_profile_add_node_profiles(FsearchQueryProfile *profile,
+                                        const FsearchQueryNodeProfile *node_profiles,
+                                        uint32_t num_node_profiles);
+
+// Records how long one search thread took and how many entries it processed. Thread safe.
+void
+fsearch_query_profile_add_thread_profile(FsearchQueryProfile *profile,
+                                         int32_t thread_id,
+                                         uint32_t num_items,
+                                         uint32_t num_matches,
+                                         int64_t wall_time_us);
+
+// Returns a copy of the totals of the node with `profile_idx`. Returns false if there's no such node.
+bool
+fsearch_query_profile_get_node_profile(FsearchQueryProfile *profile,
+                                       uint32_t profile_idx,
+                                       FsearchQueryNodeProfile *node_profile_out);
+
+// Returns copies of all thread profiles recorded so far, in the order they were added.
+GArray *
+fsearch_query_profile_get_thread_profiles(FsearchQueryProfile *profile);
+
+// Extrapolates the total time spent in a node from its sampled evaluations.
+uint64_t
+fsearch_query_node_profile_get_estimated_ns(const FsearchQueryNodeProfile *node_profile);
+
+// Monotonic time in nanoseconds, used to time sampled evaluations.
+uint64_t
+fsearch_query_profile_get_time_ns(void);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(FsearchQueryProfile, fsearch_query_profile_free)
\ No newline at end of file
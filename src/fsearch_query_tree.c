@@ -1,10 +1,17 @@
 #define G_LOG_DOMAIN "fsearch-query-tree"
 
 #include "fsearch_query_tree.h"
+#include "fsearch_query_cache.h"
 #include "fsearch_query_node.h"
 #include "fsearch_query_parser.h"
 #include "fsearch_string_utils.h"
 
+#include <string.h>
+
+// Query trees which aren't used anymore are kept around for a while, since the same queries and filters tend to come up
+// again, e.g. when switching filters or when the database got updated. The cache holds trees of about this many bytes.
+#define QUERY_TREE_CACHE_MAX_SIZE ((size_t)1 << 20)
+
 static gboolean
 free_tree_node(GNode *node, gpointer data);
 
@@ -278,6 +285,123 @@ fsearch_query_node_tree_wants_single_threaded_search(GNode *tree) {
     return wants_single_threaded_search;
 }
 
+static bool
+name_range_node_is_better(FsearchQueryNode *candidate, FsearchQueryNode *current) {
+    if (!current) {
+        return true;
+    }
+    if (candidate->name_range_key_is_exact != current->name_range_key_is_exact) {
+        return candidate->name_range_key_is_exact;
+    }
+    if ((candidate->flags & QUERY_FLAG_MATCH_CASE) != (current->flags & QUERY_FLAG_MATCH_CASE)) {
+        // Fewer case variants to look up
+        return candidate->flags & QUERY_FLAG_MATCH_CASE;
+    }
+    // Longer keys result in smaller ranges
+    return strlen(candidate->name_range_key) > strlen(current->name_range_key);
+}
+
+FsearchQueryNode *
+fsearch_query_node_tree_get_name_range_node(GNode *tree) {
+    if (!tree) {
+        return NULL;
+    }
+    FsearchQueryNode *n = tree->data;
+    if (!n) {
+        return NULL;
+    }
+    if (n->type == FSEARCH_QUERY_NODE_TYPE_QUERY) {
+        return n->name_range_key ? n : NULL;
+    }
+    if (n->operator != FSEARCH_QUERY_NODE_OPERATOR_AND) {
+        // Matches of OR and NOT nodes aren't constrained by a single child
+        return NULL;
+    }
+
+    // Every match of an AND node matches both of its children, so we can pick the most selective one
+    FsearchQueryNode *best = NULL;
+    for (GNode *child = tree->children; child != NULL; child = child->next) {
+        FsearchQueryNode *child_best = fsearch_query_node_tree_get_name_range_node(child);
+        if (child_best && name_range_node_is_better(child_best, best)) {
+            best = child_best;
+        }
+    }
+    return best;
+}
+
+static gboolean
+node_assign_profile_idx(GNode *node, gpointer data) {
+    FsearchQueryNode *n = node->data;
+    uint32_t *next_idx = data;
+    if (n) {
+        n->profile_idx = (*next_idx)++;
+    }
+    return FALSE;
+}
+
+static void
+assign_profile_indices(GNode *tree) {
+    uint32_t next_idx = 0;
+    g_node_traverse(tree, G_PRE_ORDER, G_TRAVERSE_ALL, -1, node_assign_profile_idx, &next_idx);
+}
+
+static void
+append_node_profile(GString *out, FsearchQueryNode *n, FsearchQueryProfile *profile, uint32_t profile_offset) {
+    FsearchQueryNodeProfile node_profile = {};
+    if (!profile || !fsearch_query_profile_get_node_profile(profile, profile_offset + n->profile_idx, &node_profile)) {
+        return;
+    }
+    const double match_rate = node_profile.num_evaluations > 0
+                                ? 100.0 * (double)node_profile.num_matches / (double)node_profile.num_evaluations
+                                : 0.0;
+    g_string_append_printf(out,
+                           " (evaluations: %" G_GUINT64_FORMAT ", matches: %" G_GUINT64_FORMAT " [%.2f%%], time: ~%.3fms)",
+                           node_profile.num_evaluations,
+                           node_profile.num_matches,
+                           match_rate,
+                           (double)fsearch_query_node_profile_get_estimated_ns(&node_profile) / 1000000.0);
+}
+
+static void
+append_tree_string(GString *out, GNode *node, FsearchQueryProfile *profile, uint32_t profile_offset, uint32_t depth) {
+    FsearchQueryNode *n = node->data;
+    for (uint32_t i = 0; i < depth; ++i) {
+        g_string_append(out, "  ");
+    }
+    if (!n) {
+        g_string_append(out, "[invalid node]\n");
+        return;
+    }
+
+    if (n->type == FSEARCH_QUERY_NODE_TYPE_OPERATOR) {
+        g_string_append(out, n->description ? n->description->str : "unknown operator");
+    }
+    else {
+        g_autofree char *flag_string = query_flags_to_string_expressive(n->flags);
+        g_string_append_printf(out,
+                               "[%s:'%s'%s%s]",
+                               n->description ? n->description->str : "unknown query",
+                               n->needle ? n->needle : "",
+                               flag_string[0] != '\0' ? ": " : "",
+                               flag_string);
+    }
+    append_node_profile(out, n, profile, profile_offset);
+    g_string_append_c(out, '\n');
+
+    for (GNode *child = node->children; child != NULL; child = child->next) {
+        append_tree_string(out, child, profile, profile_offset, depth + 1);
+    }
+}
+
+char *
+fsearch_query_node_tree_to_string(GNode *tree, FsearchQueryProfile *profile, uint32_t profile_offset) {
+    GString *out = g_string_sized_new(256);
+    if (tree) {
+        append_tree_string(out, tree, profile, profile_offset, 0);
+    }
+    return g_string_free(out, FALSE);
+}
+
 GNode *
 fsearch_query_node_tree_new(const char *search_term, FsearchFilterManager *filters, FsearchQueryFlags flags) {
     g_autofree char *query = g_strdup(search_term);
@@ -291,6 +415,9 @@ fsearch_query_node_tree_new(const char *search_term, FsearchFilterManager *filte
     else {
         res = get_query_tree(query_stripped, filters, flags);
     }
+    if (res) {
+        assign_profile_indices(res);
+    }
     return res;
 }
 
@@ -300,4 +427,96 @@ fsearch_query_node_tree_free(GNode *node) {
         return;
     }
     g_clear_pointer(&node, free_tree);
+}
+
+// The regular expressions of the nodes are accounted for by their own cache
+static size_t
+query_tree_cache_get_tree_size(gpointer value) {
+    return g_node_n_nodes(value, G_TRAVERSE_ALL) * (sizeof(GNode) + sizeof(FsearchQueryNode));
+}
+
+static FsearchQueryCache *
+query_tree_cache_get(void) {
+    static FsearchQueryCache *query_tree_cache = NULL;
+    if (g_once_init_enter(&query_tree_cache)) {
+        g_once_init_leave(&query_tree_cache,
+                          fsearch_query_cache_new(QUERY_TREE_CACHE_MAX_SIZE,
+                                                  query_tree_cache_get_tree_size,
+                                                  (GDestroyNotify)fsearch_query_node_tree_free));
+    }
+    return query_tree_cache;
+}
+
+static char *
+query_tree_cache_key(const char *search_term, FsearchFilterManager *filters, FsearchQueryFlags flags) {
+    g_autofree char *query = g_strdup(search_term ? search_term : "");
+    GString *key = g_string_new(NULL);
+    g_string_append_printf(key, "%x\x1f%s", (unsigned)flags, g_strstrip(query));
+
+    if (!(flags & QUERY_FLAG_REGEX)) {
+        // The tree depends on the macros which get expanded while parsing
+        g_autoptr(GPtrArray) macros = get_filters_with_macros(filters);
+        for (uint32_t i = 0; i < macros->len; ++i) {
+            FsearchFilter *filter = g_ptr_array_index(macros, i);
+            g_string_append_printf(key,
+                                   "\x1f%s\x1e%x\x1e%s",
+                                   filter->macro,
+                                   (unsigned)filter->flags,
+                                   filter->query ? filter->query : "");
+        }
+    }
+    return g_string_free(key, FALSE);
+}
+
+static gboolean
+node_depends_on_current_time(GNode *node, gpointer data) {
+    FsearchQueryNode *n = node->data;
+    g_assert(data);
+    g_assert(n);
+
+    bool *depends_on_current_time = data;
+    if (n && *depends_on_current_time == false) {
+        *depends_on_current_time = n->depends_on_current_time;
+    }
+    return *depends_on_current_time;
+}
+
+static bool
+query_tree_depends_on_current_time(GNode *tree) {
+    bool depends_on_current_time = false;
+    g_node_traverse(tree, G_IN_ORDER, G_TRAVERSE_ALL, -1, node_depends_on_current_time, &depends_on_current_time);
+    return depends_on_current_time;
+}
+
+GNode *
+fsearch_query_node_tree_get_shared(const char *search_term, FsearchFilterManager *filters, FsearchQueryFlags flags) {
+    FsearchQueryCache *cache = query_tree_cache_get();
+    g_autofree char *key = query_tree_cache_key(search_term, filters, flags);
+
+    GNode *tree = fsearch_query_cache_lookup(cache, key);
+    if (tree) {
+        return tree;
+    }
+    tree = fsearch_query_node_tree_new(search_term, filters, flags);
+    if (!tree) {
+        return NULL;
+    }
+    if (query_tree_depends_on_current_time(tree)) {
+        // The tree would match the wrong range once the day (or hour, ...) it was parsed at is over, so it's not
+        // shared with later queries
+        return tree;
+    }
+    return fsearch_query_cache_insert(cache, key, tree);
+}
+
+void
+fsearch_query_node_tree_release(GNode *tree) {
+    if (!tree) {
+        return;
+    }
+    if (query_tree_depends_on_current_time(tree)) {
+        fsearch_query_node_tree_free(tree);
+        return;
+    }
+    fsearch_query_cache_release(query_tree_cache_get(), tree);
 }
\ No newline at end of file
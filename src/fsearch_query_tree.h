@@ -1,6 +1,8 @@
 #pragma once
 
 #include "fsearch_filter_manager.h"
+#include "fsearch_query_node.h"
+#include "fsearch_query_profile.h"
 
 #include <glib.h>
 
@@ -13,8 +15,29 @@ fsearch_query_node_tree_triggers_auto_match_case(GNode *tree);
 bool
 fsearch_query_node_tree_wants_single_threaded_search(GNode *tree);
 
+// Returns a query node which every match of `tree` has to satisfy and which can be resolved with a range lookup on
+// the name sorted index (see FsearchQueryNode::name_range_key), or NULL if there's no such node.
+FsearchQueryNode *
+fsearch_query_node_tree_get_name_range_node(GNode *tree);
+
+// Dumps `tree` with one node per line, indented by depth. If `profile` is set, every node is annotated with the
+// evaluations, matches and estimated time it recorded. The nodes of the tree are stored in the profile starting at
+// `profile_offset`.
+char *
+fsearch_query_node_tree_to_string(GNode *tree, FsearchQueryProfile *profile, uint32_t profile_offset);
+
 GNode *
 fsearch_query_node_tree_new(const char *search_term, FsearchFilterManager *filters, FsearchQueryFlags flags);
 
 void
-fsearch_query_node_tree_free(GNode *node);
\ No newline at end of file
+fsearch_query_node_tree_free(GNode *node);
+
+// Like fsearch_query_node_tree_new(), but the tree is shared with everybody else who asks for the same search term,
+// flags and filter macros, so it's only parsed and compiled once. The returned tree must not be modified and has to
+// be released with fsearch_query_node_tree_release(). Trees which depend on the current time (e.g. dm:today) aren't
+// shared, every call parses them again.
+GNode *
+fsearch_query_node_tree_get_shared(const char *search_term, FsearchFilterManager *filters, FsearchQueryFlags flags);
+
+void
+fsearch_query_node_tree_release(GNode *tree);
\ No newline at end of file
@@ -0,0 +1,158 @@
+#define G_LOG_DOMAIN "fsearch-search-scheduler"
+
+#include "fsearch_search_scheduler.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Number of recent search latencies the debounce window is derived from
+#define SEARCH_SCHEDULER_NUM_SAMPLES 32
+// Don't adapt before we've seen a few searches
+#define SEARCH_SCHEDULER_MIN_SAMPLES 4
+// Searches which usually finish within a frame are dispatched immediately
+#define SEARCH_SCHEDULER_INSTANT_LATENCY_US (16 * G_TIME_SPAN_MILLISECOND)
+// Never hold back requests for longer than that, or typing starts to feel laggy
+#define SEARCH_SCHEDULER_MAX_DEBOUNCE_MS 250
+
+struct FsearchSearchScheduler {
+    FsearchSearchSchedulerDispatchFunc dispatch_func;
+    gpointer user_data;
+
+    guint pending_timeout_id;
+
+    // Ring buffer of the most recent search latencies
+    int64_t latencies_us[SEARCH_SCHEDULER_NUM_SAMPLES];
+    uint32_t num_latencies;
+    uint32_t next_latency_idx;
+
+    uint32_t debounce_ms;
+
+    int64_t dispatch_time;
+    bool search_in_flight;
+};
+
+static int
+cmp_latencies(gconstpointer a, gconstpointer b) {
+    const int64_t l1 = *(const int64_t *)a;
+    const int64_t l2 = *(const int64_t *)b;
+    return l1 < l2 ? -1 : l1 > l2 ? 1 : 0;
+}
+
+uint32_t
+fsearch_search_scheduler_compute_debounce_ms(const int64_t *latencies_us, uint32_t num_latencies) {
+    if (num_latencies < SEARCH_SCHEDULER_MIN_SAMPLES) {
+        return 0;
+    }
+    g_return_val_if_fail(latencies_us, 0);
+
+    num_latencies = MIN(num_latencies, SEARCH_SCHEDULER_NUM_SAMPLES);
+    int64_t sorted[SEARCH_SCHEDULER_NUM_SAMPLES];
+    memcpy(sorted, latencies_us, num_latencies * sizeof(int64_t));
+    qsort(sorted, num_latencies, sizeof(int64_t), cmp_latencies);
+
+    const int64_t p50 = sorted[num_latencies / 2];
+    const int64_t p95 = sorted[MIN(num_latencies - 1, num_latencies * 95 / 100)];
+
+    uint32_t debounce_ms = 0;
+    if (p95 > SEARCH_SCHEDULER_INSTANT_LATENCY_US) {
+        // Wait roughly as long as a typical search takes: a search dispatched earlier would most likely be replaced
+        // by the next keystroke before it finished
+        const int64_t debounce_us = (p50 + p95) / 2;
+        debounce_ms = (uint32_t)MIN(debounce_us / G_TIME_SPAN_MILLISECOND, SEARCH_SCHEDULER_MAX_DEBOUNCE_MS);
+    }
+    g_debug("[search_scheduler] p50: %.1fms, p95: %.1fms -> debounce: %ums",
+            (double)p50 / G_TIME_SPAN_MILLISECOND,
+            (double)p95 / G_TIME_SPAN_MILLISECOND,
+            debounce_ms);
+    return debounce_ms;
+}
+
+static void
+search_scheduler_dispatch(FsearchSearchScheduler *self) {
+    fsearch_search_scheduler_cancel(self);
+
+    self->dispatch_time = g_get_monotonic_time();
+    self->search_in_flight = true;
+    self->dispatch_func(self->user_data);
+}
+
+static gboolean
+on_pending_timeout(gpointer user_data) {
+    FsearchSearchScheduler *self = user_data;
+    self->pending_timeout_id = 0;
+    search_scheduler_dispatch(self);
+    return G_SOURCE_REMOVE;
+}
+
+FsearchSearchScheduler *
+fsearch_search_scheduler_new(FsearchSearchSchedulerDispatchFunc dispatch_func, gpointer user_data) {
+    g_return_val_if_fail(dispatch_func, NULL);
+
+    FsearchSearchScheduler *self = calloc(1, sizeof(FsearchSearchScheduler));
+    g_assert(self);
+    self->dispatch_func = dispatch_func;
+    self->user_data = user_data;
+    return self;
+}
+
+void
+fsearch_search_scheduler_free(FsearchSearchScheduler *self) {
+    if (!self) {
+        return;
+    }
+    fsearch_search_scheduler_cancel(self);
+    g_clear_pointer(&self, free);
+}
+
+void
+fsearch_search_scheduler_request(FsearchSearchScheduler *self) {
+    g_return_if_fail(self);
+
+    if (self->debounce_ms == 0) {
+        search_scheduler_dispatch(self);
+        return;
+    }
+    // Restart the debounce window, so only the latest request gets dispatched
+    fsearch_search_scheduler_cancel(self);
+    self->pending_timeout_id = g_timeout_add(self->debounce_ms, on_pending_timeout, self);
+}
+
+void
+fsearch_search_scheduler_dispatch_now(FsearchSearchScheduler *self) {
+    g_return_if_fail(self);
+    search_scheduler_dispatch(self);
+}
+
+void
+fsearch_search_scheduler_cancel(FsearchSearchScheduler *self) {
+    g_return_if_fail(self);
+    if (self->pending_timeout_id) {
+        g_source_remove(self->pending_timeout_id);
+        self->pending_timeout_id = 0;
+    }
+}
+
+void
+fsearch_search_scheduler_search_finished(FsearchSearchScheduler *self, bool completed) {
+    g_return_if_fail(self);
+    if (!self->search_in_flight) {
+        return;
+    }
+    self->search_in_flight = false;
+    if (!completed) {
+        return;
+    }
+
+    self->latencies_us[self->next_latency_idx] = g_get_monotonic_time() - self->dispatch_time;
+    self->next_latency_idx = (self->next_latency_idx + 1) % SEARCH_SCHEDULER_NUM_SAMPLES;
+    self->num_latencies = MIN(self->num_latencies + 1, SEARCH_SCHEDULER_NUM_SAMPLES);
+
+    self->debounce_ms = fsearch_search_scheduler_compute_debounce_ms(self->latencies_us, self->num_latencies);
+}
+
+uint32_t
+fsearch_search_scheduler_get_debounce_ms(FsearchSearchScheduler *self) {
+    g_return_val_if_fail(self, 0);
+    return self->debounce_ms;
+}
\ No newline at end of file
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <glib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Sits between the search entry and the database worker while searching as you type. Search requests which arrive
+// in quick succession are coalesced into a single search for the latest input. How long requests are held back
+// adapts to how long recent searches took: with a fast index every request is dispatched right away, with a slow
+// one we wait a little for the user to finish typing instead of flooding the database with searches which get
+// cancelled anyway.
+//
+// Must only be used from the main thread.
+typedef struct FsearchSearchScheduler FsearchSearchScheduler;
+
+typedef void (*FsearchSearchSchedulerDispatchFunc)(gpointer user_data);
+
+FsearchSearchScheduler *
+fsearch_search_scheduler_new(FsearchSearchSchedulerDispatchFunc dispatch_func, gpointer user_data);
+
+void
+fsearch_search_scheduler_free(FsearchSearchScheduler *self);
+
+// Requests a search, which is dispatched once no further request arrived within the current debounce window.
+void
+fsearch_search_scheduler_request(FsearchSearchScheduler *self);
+
+// Dispatches a search right away, which replaces any pending request.
+void
+fsearch_search_scheduler_dispatch_now(FsearchSearchScheduler *self);
+
+// Drops any pending request.
+void
+fsearch_search_scheduler_cancel(FsearchSearchScheduler *self);
+
+// Has to be called when the most recently dispatched search finished. `completed` is only set when the search ran to
+// the end and its results were delivered: only those searches are used to keep track of the search latency, since
+// cancelled ones say little about how long a search takes.
+void
+fsearch_search_scheduler_search_finished(FsearchSearchScheduler *self, bool completed);
+
+// Returns the time requests are currently held back, in milliseconds.
+uint32_t
+fsearch_search_scheduler_get_debounce_ms(FsearchSearchScheduler *self);
+
+// Returns the time requests are held back after searches which took `latencies_us`: none as long as there are fewer
+// than 4 of them or 95% finish within 16 ms, otherwise the mean of their median and 95th percentile, capped at 250 ms.
+// Only the first 32 latencies are used.
+uint32_t
+fsearch_search_scheduler_compute_debounce_ms(const int64_t *latencies_us, uint32_t num_latencies);
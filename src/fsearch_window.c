@@ -29,6 +29,7 @@
 #include "fsearch_list_view.h"
 #include "fsearch_listview_popup.h"
 #include "fsearch_result_view.h"
+#include "fsearch_search_scheduler.h"
 #include "fsearch_statusbar.h"
 #include "fsearch_window.h"
 #include "fsearch_window_actions.h"
@@ -66,6 +67,10 @@ struct _FsearchApplicationWindow {
     FsearchDatabase *db;
     FsearchDatabaseWork *work_search;
     FsearchDatabaseWork *work_sort;
+    // Set when the first rows of `work_sort` are shown already, before it finished
+    bool sort_preview_shown;
+
+    FsearchSearchScheduler *search_scheduler;
 
     guint apply_overlay_timeout_id;
     int32_t apply_depth;
@@ -381,6 +386,7 @@ fsearch_application_window_finalize(GObject *object) {
         g_source_remove(self->apply_overlay_timeout_id);
         self->apply_overlay_timeout_id = 0;
     }
+    g_clear_pointer(&self->search_scheduler, fsearch_search_scheduler_free);
     g_clear_pointer(&self->active_filter_name, free);
     g_clear_pointer(&self->result_view, fsearch_result_view_free);
     g_clear_pointer(&self->work_search, fsearch_database_work_unref);
@@ -506,12 +512,27 @@ on_sort_finished(FsearchDatabase *db, guint id, FsearchDatabaseSearchInfo *info,
         if (!sort_info_matches_tracked_work(win, info)) {
             return;
         }
-        apply_search_info(win, info, true);
+        // Keep the scroll position if the preview is shown already, the user might have scrolled since then
+        apply_search_info(win, info, !win->sort_preview_shown);
 
         g_clear_pointer(&win->work_sort, fsearch_database_work_unref);
     }
 }
 
+static void
+on_sort_preview(FsearchDatabase *db, guint id, FsearchDatabaseSearchInfo *info, gpointer user_data) {
+    FsearchApplicationWindow *win = get_window_for_id(id);
+
+    if (win) {
+        if (!sort_info_matches_tracked_work(win, info)) {
+            return;
+        }
+        // The first rows of the new order get delivered with "item-info-ready" right after this
+        apply_search_info(win, info, true);
+        win->sort_preview_shown = true;
+    }
+}
+
 static void
 on_sort_started(FsearchDatabase *db, gpointer data, gpointer user_data) {
     const guint win_id = GPOINTER_TO_UINT(data);
@@ -549,8 +570,12 @@ on_search_finished(FsearchDatabase *db, guint id, FsearchDatabaseSearchInfo *inf
         if (!search_info_matches_tracked_work(win, info)) {
             return;
         }
+        g_autoptr(GCancellable) cancellable = fsearch_database_work_get_cancellable(win->work_search);
+        const bool completed = fsearch_database_search_info_get_is_complete(info)
+                            && !g_cancellable_is_cancelled(cancellable);
         apply_search_info(win, info, true);
         g_clear_pointer(&win->work_search, fsearch_database_work_unref);
+        fsearch_search_scheduler_search_finished(win->search_scheduler, completed);
     }
 }
 
@@ -566,10 +591,8 @@ on_search_started(FsearchDatabase *db, gpointer data, gpointer user_data) {
 }
 
 static void
-perform_search(FsearchApplicationWindow *win) {
-    if (!win) {
-        return;
-    }
+dispatch_search(gpointer user_data) {
+    FsearchApplicationWindow *win = user_data;
 
     const gchar *text = get_query_text(win);
     const guint win_id = gtk_application_window_get_id(GTK_APPLICATION_WINDOW(win));
@@ -577,7 +600,12 @@ perform_search(FsearchApplicationWindow *win) {
     FsearchConfig *config = fsearch_application_get_config(FSEARCH_APPLICATION_DEFAULT);
     g_autoptr(FsearchQuery) query = fsearch_query_new(text, filter, config->filters, get_query_flags(), "test");
     if (win->work_search) {
-        fsearch_database_work_cancel(win->work_search);
+        g_autoptr(FsearchQuery) running_query = fsearch_database_work_search_get_query(win->work_search);
+        // When the new query only narrows down the running one, we let it finish instead of cancelling it, so the new
+        // search only has to look at its results instead of the whole index
+        if (!running_query || !fsearch_query_is_refinement_of(query, running_query)) {
+            fsearch_database_work_cancel(win->work_search);
+        }
     }
     g_clear_pointer(&win->work_search, fsearch_database_work_unref);
     win->work_search = fsearch_database_work_new_search(win_id,
@@ -588,6 +616,14 @@ perform_search(FsearchApplicationWindow *win) {
     fsearch_database_queue_work(win->db, win->work_search);
 }
 
+static void
+perform_search(FsearchApplicationWindow *win) {
+    if (!win) {
+        return;
+    }
+    fsearch_search_scheduler_dispatch_now(win->search_scheduler);
+}
+
 static gboolean
 on_fsearch_list_view_popup(FsearchListView *view, gpointer user_data) {
     FsearchApplicationWindow *win = user_data;
@@ -684,7 +720,7 @@ on_search_entry_changed(GtkEntry *entry, gpointer user_data) {
     FsearchConfig *config = fsearch_application_get_config(FSEARCH_APPLICATION_DEFAULT);
 
     if (config->search_as_you_type) {
-        perform_search(win);
+        fsearch_search_scheduler_request(win->search_scheduler);
     }
 }
 
@@ -741,6 +777,7 @@ on_listview_sort(int sort_order, GtkSortType sort_type, gpointer user_data) {
     }
     g_clear_pointer(&win->work_sort, fsearch_database_work_unref);
     win->work_sort = fsearch_database_work_new_sort(win_id, sort_order, sort_type);
+    win->sort_preview_shown = false;
 
     fsearch_database_queue_work(win->db, win->work_sort);
 }
@@ -985,6 +1022,7 @@ fsearch_application_window_init(FsearchApplicationWindow *self) {
 
     guint id = gtk_application_window_get_id(GTK_APPLICATION_WINDOW(self));
     self->result_view = fsearch_result_view_new(id);
+    self->search_scheduler = fsearch_search_scheduler_new(dispatch_search, self);
 
     self->statusbar = GTK_WIDGET(fsearch_statusbar_new());
     gtk_box_pack_end(GTK_BOX(self->main_box), self->statusbar, FALSE, TRUE, 0);
@@ -998,6 +1036,7 @@ fsearch_application_window_init(FsearchApplicationWindow *self) {
     g_signal_connect_object(self->db, "search-started", G_CALLBACK(on_search_started), self, G_CONNECT_AFTER);
     g_signal_connect_object(self->db, "search-finished", G_CALLBACK(on_search_finished), self, G_CONNECT_AFTER);
     g_signal_connect_object(self->db, "sort-started", G_CALLBACK(on_sort_started), self, G_CONNECT_AFTER);
+    g_signal_connect_object(self->db, "sort-preview", G_CALLBACK(on_sort_preview), self, G_CONNECT_AFTER);
     g_signal_connect_object(self->db, "sort-finished", G_CALLBACK(on_sort_finished), self, G_CONNECT_AFTER);
     g_signal_connect_object(self->db, "scan-started", G_CALLBACK(on_database_scan_started), self, G_CONNECT_AFTER);
     g_signal_connect_object(self->db, "scan-finished", G_CALLBACK(on_database_update_finished), self, G_CONNECT_AFTER);
@@ -1211,6 +1250,8 @@ fsearch_application_window_prepare_shutdown(gpointer self) {
     FsearchApplication *app = FSEARCH_APPLICATION_DEFAULT;
     FsearchConfig *config = fsearch_application_get_config(app);
 
+    fsearch_search_scheduler_cancel(win->search_scheduler);
+
     gint width = 850;
     gint height = 800;
     gtk_window_get_size(GTK_WINDOW(self), &width, &height);
@@ -1263,11 +1304,6 @@ fsearch_application_window_added(FsearchApplicationWindow *win, FsearchApplicati
 
     FsearchDatabaseIndexProperty sort_order = config->restore_sort_order ? get_sort_order_for_name(config->sort_by)
                                                                          : DATABASE_INDEX_PROPERTY_NAME;
-    if (sort_order == DATABASE_INDEX_PROPERTY_FILETYPE) {
-        // file type order is not indexed, so it would make startup really slow
-        // -> fall back to sort by name instead
-        sort_order = DATABASE_INDEX_PROPERTY_NAME;
-    }
     const GtkSortType sort_type = config->restore_sort_order
                                     ? (config->sort_ascending ? GTK_SORT_ASCENDING : GTK_SORT_DESCENDING)
                                     : GTK_SORT_ASCENDING;
@@ -0,0 +1,209 @@
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <src/fsearch_arena.h>
+#include <src/fsearch_array.h>
+
+static int32_t *
+new_arena_int(int32_t val) {
+    int32_t *item = fsearch_arena_alloc(sizeof(int32_t));
+    *item = val;
+    return item;
+}
+
+static void
+free_arena_int(int32_t *item) {
+    fsearch_arena_free(item, sizeof(int32_t));
+}
+
+static void
+test_arena(void) {
+    g_assert_null(fsearch_arena_get_item(FSEARCH_ARENA_ID_NONE));
+    g_assert_cmpuint(fsearch_arena_get_id(NULL), ==, FSEARCH_ARENA_ID_NONE);
+
+    uint8_t *a = fsearch_arena_alloc(20);
+    uint8_t *b = fsearch_arena_alloc(20);
+    g_assert_true(a != b);
+    g_assert_cmpuint((uintptr_t)a % FSEARCH_ARENA_ALIGNMENT, ==, 0);
+    g_assert_cmpuint(fsearch_arena_get_id(a), !=, FSEARCH_ARENA_ID_NONE);
+    g_assert_true(fsearch_arena_get_item(fsearch_arena_get_id(a)) == a);
+    g_assert_true(fsearch_arena_get_item(fsearch_arena_get_id(b)) == b);
+
+    // Freed items get reused and are zeroed again
+    memset(a, 0xff, 20);
+    fsearch_arena_free(a, 20);
+    uint8_t *c = fsearch_arena_alloc(24);
+    g_assert_true(c == a);
+    for (uint32_t i = 0; i < 24; i++) {
+        g_assert_cmpuint(c[i], ==, 0);
+    }
+
+    // Items which don't fit into a size class
+    uint8_t *large = fsearch_arena_alloc(10000);
+    memset(large, 0xff, 10000);
+    g_assert_true(fsearch_arena_get_item(fsearch_arena_get_id(large)) == large);
+    fsearch_arena_free(large, 10000);
+    uint8_t *large_again = fsearch_arena_alloc(5000);
+    g_assert_true(large_again == large);
+    g_assert_cmpuint(large_again[4999], ==, 0);
+
+    fsearch_arena_free(large_again, 5000);
+    fsearch_arena_free(b, 20);
+    fsearch_arena_free(c, 24);
+}
+
+static void
+test_arena_out_of_space(void) {
+    // Items which don't fit into the arena fail instead of aborting, and it keeps working afterwards
+    g_assert_null(fsearch_arena_alloc(G_MAXSIZE / 2));
+    uint8_t *item = fsearch_arena_alloc(20);
+    g_assert_nonnull(item);
+    fsearch_arena_free(item, 20);
+}
+
+static void
+test_arena_map_file(void) {
+    g_autofree char *tmp_path = NULL;
+    const int fd = g_file_open_tmp("fsearch-test-arena-XXXXXX", &tmp_path, NULL);
+    g_assert_cmpint(fd, >=, 0);
+    const size_t page_size = sysconf(_SC_PAGESIZE);
+    g_autofree uint8_t *data = g_malloc(page_size * 2);
+    memset(data, 0, page_size);
+    memset(data + page_size, 0xab, page_size);
+    g_assert_cmpint(write(fd, data, page_size * 2), ==, (ssize_t)(page_size * 2));
+
+    // Only page aligned offsets can be mapped
+    g_assert_null(fsearch_arena_map_file(fd, 1, 16, 1));
+
+    // The items of the mapping are part of the arena and can be changed without changing the file
+    uint8_t *mapping = fsearch_arena_map_file(fd, (off_t)page_size, 32, 2);
+    g_assert_nonnull(mapping);
+    g_assert_true(fsearch_arena_get_item(fsearch_arena_get_id(mapping)) == mapping);
+    g_assert_cmpuint(mapping[31], ==, 0xab);
+    mapping[0] = 0;
+    g_assert_cmpint(pread(fd, data, 1, (off_t)page_size), ==, 1);
+    g_assert_cmpuint(data[0], ==, 0xab);
+
+    // Once all items were freed, the space of the mapping gets reused, merged with the free space before it
+    fsearch_arena_free(mapping, 16);
+    fsearch_arena_free(mapping + 16, 16);
+    uint8_t *large = fsearch_arena_alloc(page_size);
+    g_assert_true(large <= mapping);
+    g_assert_cmpuint(mapping[31], ==, 0);
+    fsearch_arena_free(large, page_size);
+
+    // Unmapping releases the mapping right away
+    mapping = fsearch_arena_map_file(fd, 0, page_size * 2, 10);
+    g_assert_nonnull(mapping);
+    fsearch_arena_unmap(mapping);
+
+    close(fd);
+    g_unlink(tmp_path);
+}
+
+static int32_t
+cmp_pointers(void **a, void **b, void *data) {
+    return *a < *b ? -1 : *a > *b;
+}
+
+static void
+test_arena_no_overlaps(void) {
+    // Mixed sizes leave rests at the end of the thread's chunks, which get reused for smaller items
+    const uint32_t num_items = 20000;
+    g_autoptr(DynamicArray) items = darray_new(num_items);
+    g_autoptr(GHashTable) sizes = g_hash_table_new(NULL, NULL);
+    for (uint32_t i = 0; i < num_items; i++) {
+        const size_t size = (i * 7919) % 1000 + 1;
+        uint8_t *item = fsearch_arena_alloc(size);
+        memset(item, 0xff, size);
+        darray_add_item(items, item);
+        g_hash_table_insert(sizes, item, GSIZE_TO_POINTER(size));
+    }
+    darray_sort(items, (DynamicArrayCompareDataFunc)cmp_pointers, NULL, NULL);
+    for (uint32_t i = 1; i < num_items; i++) {
+        uint8_t *prev = darray_get_item(items, i - 1);
+        uint8_t *next = darray_get_item(items, i);
+        g_assert_true(prev + GPOINTER_TO_SIZE(g_hash_table_lookup(sizes, prev)) <= next);
+    }
+    for (uint32_t i = 0; i < num_items; i++) {
+        void *item = darray_get_item(items, i);
+        fsearch_arena_free(item, GPOINTER_TO_SIZE(g_hash_table_lookup(sizes, item)));
+    }
+}
+
+static void
+test_arena_release(void) {
+    // 8 MiB of small items cover several whole chunks of the arena
+    const uint32_t num_items = 8 << 20 >> 6;
+    g_autofree uint8_t **items = g_new0(uint8_t *, num_items);
+    for (uint32_t i = 0; i < num_items; i++) {
+        items[i] = fsearch_arena_alloc(64);
+        memset(items[i], 0xff, 64);
+    }
+    uint8_t *middle = items[num_items / 2];
+    for (uint32_t i = 0; i < num_items; i++) {
+        fsearch_arena_free(items[i], 64);
+    }
+
+    // The memory of the empty chunks was returned to the system
+    const size_t page_size = sysconf(_SC_PAGESIZE);
+    uint8_t *page = (uint8_t *)((uintptr_t)middle & ~(uintptr_t)(page_size - 1));
+    unsigned char resident = 1;
+    g_assert_cmpint(mincore(page, page_size, &resident), ==, 0);
+    g_assert_cmpuint(resident & 1, ==, 0);
+
+    // ... and their space is reused for items of any size
+    uint8_t *large = fsearch_arena_alloc(2 << 20);
+    g_assert_true(large <= middle);
+    g_assert_cmpuint(middle[0], ==, 0);
+    fsearch_arena_free(large, 2 << 20);
+}
+
+static gpointer
+arena_alloc_thread(gpointer data) {
+    DynamicArray *items = data;
+    for (int32_t i = 0; i < 100000; i++) {
+        darray_add_item(items, new_arena_int(i));
+    }
+    return NULL;
+}
+
+static void
+test_arena_threads(void) {
+    DynamicArray *items[4] = {NULL};
+    GThread *threads[4] = {NULL};
+    for (uint32_t i = 0; i < G_N_ELEMENTS(threads); i++) {
+        items[i] = darray_new_full(100000, (GDestroyNotify)free_arena_int);
+        threads[i] = g_thread_new("arena", arena_alloc_thread, items[i]);
+    }
+    for (uint32_t i = 0; i < G_N_ELEMENTS(threads); i++) {
+        g_thread_join(threads[i]);
+    }
+
+    // Every thread got its own items
+    g_autoptr(GHashTable) seen = g_hash_table_new(NULL, NULL);
+    for (uint32_t i = 0; i < G_N_ELEMENTS(items); i++) {
+        for (uint32_t j = 0; j < darray_get_num_items(items[i]); j++) {
+            int32_t *item = darray_get_item(items[i], j);
+            g_assert_cmpint(*item, ==, j);
+            g_assert_true(g_hash_table_add(seen, item));
+        }
+        darray_unref(items[i]);
+    }
+}
+
+int
+main(int argc, char *argv[]) {
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/FSearch/arena/main", test_arena);
+    g_test_add_func("/FSearch/arena/out_of_space", test_arena_out_of_space);
+    g_test_add_func("/FSearch/arena/no_overlaps", test_arena_no_overlaps);
+    g_test_add_func("/FSearch/arena/map_file", test_arena_map_file);
+    g_test_add_func("/FSearch/arena/release", test_arena_release);
+    g_test_add_func("/FSearch/arena/threads", test_arena_threads);
+    return g_test_run();
+}
@@ -2,6 +2,7 @@
 #include <stdint.h>
 #include <stdlib.h>
 
+#include <src/fsearch_arena.h>
 #include <src/fsearch_array.h>
 
 typedef struct Version {
@@ -183,6 +184,147 @@ test_sort(void) {
     test_single_and_multi_threaded_sort(array, (DynamicArrayCompareDataFunc)sort_version);
 }
 
+static int32_t
+sort_version_major(void **a, void **b, void *data) {
+    Version *v1 = *a;
+    Version *v2 = *b;
+    return v1->major - v2->major;
+}
+
+static void
+test_sort_multi_threaded_is_stable(void) {
+    // Enough items with lots of ties that every merge round gets split into several parts
+    const uint32_t num_items = 10007;
+    g_autofree Version *versions = g_new0(Version, num_items);
+    g_autoptr(DynamicArray) array = darray_new(num_items);
+    for (uint32_t i = 0; i < num_items; i++) {
+        versions[i].major = g_random_int_range(0, 32);
+        versions[i].minor = (int)i;
+        darray_add_item(array, &versions[i]);
+    }
+
+    darray_sort_multi_threaded(array, (DynamicArrayCompareDataFunc)sort_version_major, NULL, NULL);
+
+    g_assert_cmpuint(darray_get_num_items(array), ==, num_items);
+    for (uint32_t i = 1; i < num_items; ++i) {
+        Version *v1 = darray_get_item(array, i - 1);
+        Version *v2 = darray_get_item(array, i);
+        g_assert_cmpint(v1->major, <=, v2->major);
+        if (v1->major == v2->major) {
+            g_assert_cmpint(v1->minor, <, v2->minor);
+        }
+    }
+}
+
+static void
+test_get_first_sorted(void) {
+    const uint32_t num_items = 1000;
+    g_autoptr(DynamicArray) array = darray_new(num_items);
+    for (uint32_t i = 0; i < num_items; i++) {
+        darray_add_item(array, GINT_TO_POINTER(g_random_int_range(0, 100000)));
+    }
+    g_autoptr(DynamicArray) sorted = darray_copy(array);
+    darray_sort(sorted, (DynamicArrayCompareDataFunc)sort_int_ascending, NULL, NULL);
+
+    const uint32_t counts[] = {0, 1, 7, 100, num_items, num_items + 10};
+    for (uint32_t c = 0; c < G_N_ELEMENTS(counts); c++) {
+        g_autoptr(DynamicArray) first = darray_get_first_sorted(array,
+                                                                counts[c],
+                                                                (DynamicArrayCompareDataFunc)sort_int_ascending,
+                                                                NULL,
+                                                                NULL);
+        g_assert_cmpuint(darray_get_num_items(first), ==, MIN(counts[c], num_items));
+        for (uint32_t i = 0; i < darray_get_num_items(first); ++i) {
+            g_assert_cmpint(GPOINTER_TO_INT(darray_get_item(first, i)),
+                            ==,
+                            GPOINTER_TO_INT(darray_get_item(sorted, i)));
+        }
+    }
+}
+
+static uint64_t
+version_major_key(void *item, void *data) {
+    Version *v = item;
+    return (uint64_t)v->major;
+}
+
+static void
+test_sort_by_key(void) {
+    // Keys which differ in several bytes, so more than one radix pass is needed
+    Version versions[] = {
+        {0x30000, 0},
+        {0x401, 1},
+        {0x401, 2},
+        {1, 3},
+        {0x30000, 4},
+        {0, 5},
+        {0x401, 6},
+        {1, 7},
+        {0, 8},
+    };
+
+    // The minor versions are in ascending order, so sorting by the major version alone must be the same as sorting
+    // by both, if the sort is stable
+    DynamicArray *expected = darray_new(10);
+    DynamicArray *array = darray_new(10);
+    for (uint32_t i = 0; i < G_N_ELEMENTS(versions); i++) {
+        darray_add_item(expected, &versions[i]);
+        darray_add_item(array, &versions[i]);
+    }
+    darray_sort(expected, (DynamicArrayCompareDataFunc)sort_version, NULL, NULL);
+    darray_sort_by_key(array, version_major_key, NULL, NULL);
+
+    for (uint32_t i = 0; i < darray_get_num_items(array); ++i) {
+        g_assert_true(darray_get_item(array, i) == darray_get_item(expected, i));
+    }
+
+    darray_unref(array);
+    darray_unref(expected);
+}
+
+static uint64_t
+version_major_high_key(void *item, void *data) {
+    Version *v = item;
+    return (uint64_t)(v->major >> 8);
+}
+
+static int32_t
+sort_version_major_descending_minor(void **a, void **b, void *data) {
+    Version *v1 = *a;
+    Version *v2 = *b;
+    if (v1->major != v2->major) {
+        return v1->major - v2->major;
+    }
+    return v2->minor - v1->minor;
+}
+
+static void
+test_sort_by_key_with_ties(void) {
+    // Most items share the same key, so the run of ties is big enough to be sorted with several threads
+    const uint32_t num_items = 100003;
+    g_autofree Version *versions = g_new0(Version, num_items);
+    g_autoptr(DynamicArray) expected = darray_new(num_items);
+    g_autoptr(DynamicArray) array = darray_new(num_items);
+    for (uint32_t i = 0; i < num_items; i++) {
+        versions[i].major = i % 10 ? g_random_int_range(0, 256) : g_random_int_range(0, 4096);
+        versions[i].minor = (int)i;
+        darray_add_item(expected, &versions[i]);
+        darray_add_item(array, &versions[i]);
+    }
+
+    darray_sort(expected, (DynamicArrayCompareDataFunc)sort_version_major_descending_minor, NULL, NULL);
+    darray_sort_by_key_with_ties(array,
+                                 version_major_high_key,
+                                 (DynamicArrayCompareDataFunc)sort_version_major_descending_minor,
+                                 NULL,
+                                 NULL);
+
+    g_assert_cmpuint(darray_get_num_items(array), ==, num_items);
+    for (uint32_t i = 0; i < num_items; ++i) {
+        g_assert_true(darray_get_item(array, i) == darray_get_item(expected, i));
+    }
+}
+
 static void
 test_search(void) {
     same_elements();
@@ -333,6 +475,25 @@ test_steal_items_func(void) {
     }
 }
 
+static void
+test_drop_items(void) {
+    const uint32_t count = 11;
+    g_autoptr(DynamicArray) source = darray_new(count);
+
+    for (uint32_t i = 0; i < count; i++) {
+        darray_add_item(source, GINT_TO_POINTER(i + 1));
+    }
+
+    g_assert_cmpuint(darray_drop_items(source, is_even, NULL), ==, count / 2);
+    g_assert_cmpuint(darray_get_num_items(source), ==, count - count / 2);
+
+    // The remaining items keep their order
+    for (uint32_t i = 0; i < darray_get_num_items(source); i++) {
+        g_assert_cmpint(GPOINTER_TO_INT(darray_get_item(source, i)), ==, 2 * i + 1);
+    }
+    g_assert_cmpuint(darray_drop_items(source, is_even, NULL), ==, 0);
+}
+
 static void
 test_range(void) {
     const uint32_t count = 10;
@@ -370,6 +531,95 @@ test_copy_ref(void) {
     darray_unref(a1);
 }
 
+static int32_t *
+new_arena_int(int32_t val) {
+    int32_t *item = fsearch_arena_alloc(sizeof(int32_t));
+    *item = val;
+    return item;
+}
+
+static void
+free_arena_int(int32_t *item) {
+    fsearch_arena_free(item, sizeof(int32_t));
+}
+
+static int32_t
+cmp_arena_int(int32_t **a, int32_t **b, void *data) {
+    return **a - **b;
+}
+
+static bool
+arena_int_is_even(void *item, void *data) {
+    return *(int32_t *)item % 2 == 0;
+}
+
+static void
+test_id_array(void) {
+    const int32_t count = 100;
+    g_autoptr(DynamicIdArray) array = idarray_new_full(1, (GDestroyNotify)free_arena_int);
+    for (int32_t i = 0; i < count; i++) {
+        idarray_insert_item_sorted(array,
+                                   new_arena_int(count - i - 1),
+                                   (DynamicArrayCompareDataFunc)cmp_arena_int,
+                                   NULL);
+    }
+    g_assert_cmpuint(idarray_get_num_items(array), ==, count);
+    for (int32_t i = 0; i < count; i++) {
+        g_assert_cmpint(*(int32_t *)idarray_get_item(array, i), ==, i);
+    }
+    g_assert_null(idarray_get_item(array, count));
+
+    int32_t *key = new_arena_int(42);
+    uint32_t idx = 0;
+    g_assert_true(idarray_binary_search_with_data(array, key, (DynamicArrayCompareDataFunc)cmp_arena_int, NULL, &idx));
+    g_assert_cmpuint(idx, ==, 42);
+    *key = count;
+    g_assert_false(idarray_binary_search_with_data(array, key, (DynamicArrayCompareDataFunc)cmp_arena_int, NULL, &idx));
+    g_assert_cmpuint(idx, ==, count);
+
+    // Insert at the front
+    *key = -1;
+    idarray_insert_item(array, key, 0);
+    g_assert_true(idarray_get_item(array, 0) == key);
+    g_assert_true(idarray_steal_item(array, 0) == key);
+    free_arena_int(key);
+
+    // Pointers survive the round trip through ids
+    g_autoptr(DynamicArray) items = darray_new(count);
+    darray_add_idarray(items, array);
+    g_autoptr(DynamicIdArray) ids = idarray_new(0);
+    idarray_add_darray(ids, items);
+    g_autoptr(DynamicIdArray) range = idarray_get_range(ids, 10, 5);
+    g_assert_cmpuint(idarray_get_num_items(range), ==, 5);
+    for (int32_t i = 0; i < count; i++) {
+        g_assert_true(idarray_get_item(ids, i) == darray_get_item(items, i));
+    }
+    for (int32_t i = 0; i < 5; i++) {
+        g_assert_cmpint(*(int32_t *)idarray_get_item(range, i), ==, i + 10);
+    }
+
+    // Steal 10..19 into a pointer array, remove (and free) 0..4
+    g_autoptr(DynamicArray) stolen = darray_new_full(10, (GDestroyNotify)free_arena_int);
+    g_assert_cmpuint(idarray_steal(array, 10, 10, stolen), ==, 10);
+    g_assert_cmpint(*(int32_t *)darray_get_item(stolen, 0), ==, 10);
+    g_assert_cmpint(*(int32_t *)idarray_get_item(array, 10), ==, 20);
+    g_assert_cmpuint(idarray_remove(array, 0, 5), ==, 5);
+    g_assert_cmpint(*(int32_t *)idarray_get_item(array, 0), ==, 5);
+    g_assert_cmpuint(idarray_get_num_items(array), ==, count - 15);
+
+    // Drop the even items (stealing them, the free func isn't called)
+    g_autoptr(DynamicArray) evens = darray_new_full(count, (GDestroyNotify)free_arena_int);
+    for (uint32_t i = 0; i < idarray_get_num_items(array); i++) {
+        if (arena_int_is_even(idarray_get_item(array, i), NULL)) {
+            darray_add_item(evens, idarray_get_item(array, i));
+        }
+    }
+    g_assert_cmpuint(idarray_drop_items(array, arena_int_is_even, NULL), ==, darray_get_num_items(evens));
+    for (uint32_t i = 0; i < idarray_get_num_items(array); i++) {
+        g_assert_false(arena_int_is_even(idarray_get_item(array, i), NULL));
+    }
+}
+
 int
 main(int argc, char *argv[]) {
     g_test_init(&argc, &argv, NULL);
@@ -379,9 +629,15 @@ main(int argc, char *argv[]) {
     g_test_add_func("/FSearch/array/remove", test_remove);
     g_test_add_func("/FSearch/array/steal", test_steal);
     g_test_add_func("/FSearch/array/steal_items_func", test_steal_items_func);
+    g_test_add_func("/FSearch/array/drop_items", test_drop_items);
     g_test_add_func("/FSearch/array/range", test_range);
     g_test_add_func("/FSearch/array/copy_ref", test_copy_ref);
     g_test_add_func("/FSearch/array/sort", test_sort);
+    g_test_add_func("/FSearch/array/sort_multi_threaded_is_stable", test_sort_multi_threaded_is_stable);
+    g_test_add_func("/FSearch/array/sort_by_key", test_sort_by_key);
+    g_test_add_func("/FSearch/array/sort_by_key_with_ties", test_sort_by_key_with_ties);
+    g_test_add_func("/FSearch/array/get_first_sorted", test_get_first_sorted);
     g_test_add_func("/FSearch/array/search", test_search);
+    g_test_add_func("/FSearch/array/id_array", test_id_array);
     return g_test_run();
 }
\ No newline at end of file
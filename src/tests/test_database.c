@@ -16,6 +16,7 @@
  * and clear their placeholder to allow a retry instead of getting stuck.
  */
 
+#include "fsearch_array.h"
 #include "fsearch_database.h"
 #include "fsearch_database_entry_info.h"
 #include "fsearch_database_exclude_manager.h"
@@ -28,6 +29,8 @@
 #include <gio/gio.h>
 #include <glib.h>
 #include <glib/gstdio.h>
+#include <signal.h>
+#include <sys/resource.h>
 
 #define TEST_TIMEOUT_SECONDS 10
 
@@ -68,6 +71,20 @@ on_item_info_ready(FsearchDatabase *db, guint id, guint idx, FsearchDatabaseEntr
     g_main_loop_quit(ctx->loop);
 }
 
+static void
+on_save_finished(FsearchDatabase *db, gpointer user_data) {
+    WaitCtx *ctx = user_data;
+    ctx->got_signal = TRUE;
+    g_main_loop_quit(ctx->loop);
+}
+
+static void
+on_load_finished(FsearchDatabase *db, FsearchDatabaseInfo *info, gpointer user_data) {
+    WaitCtx *ctx = user_data;
+    ctx->got_signal = TRUE;
+    g_main_loop_quit(ctx->loop);
+}
+
 static void
 wait_ctx_clear(WaitCtx *ctx) {
     g_clear_pointer(&ctx->search_info, fsearch_database_search_info_unref);
@@ -186,12 +203,125 @@ test_get_item_info_for_stale_index_still_signals(void) {
     g_rmdir(tmp_dir);
 }
 
+static void
+remove_dir_recursive(const char *path) {
+    g_autoptr(GDir) dir = g_dir_open(path, 0, NULL);
+    if (!dir) {
+        return;
+    }
+    const char *name = NULL;
+    while ((name = g_dir_read_name(dir))) {
+        g_autofree char *child = g_build_filename(path, name, NULL);
+        if (g_file_test(child, G_FILE_TEST_IS_DIR) && !g_file_test(child, G_FILE_TEST_IS_SYMLINK)) {
+            remove_dir_recursive(child);
+        }
+        else {
+            g_unlink(child);
+        }
+    }
+    g_rmdir(path);
+}
+
+// Runs a search for all files whose name starts with "file_" and returns how many were found
+static uint32_t
+search_num_files(FsearchDatabase *db, FsearchFilterManager *filters) {
+    WaitCtx ctx = {};
+    gulong handler = g_signal_connect(db, "search-finished", G_CALLBACK(on_search_finished), &ctx);
+    g_autoptr(FsearchQuery) query = fsearch_query_new("file_", NULL, filters, 0, "test");
+    g_autoptr(FsearchDatabaseWork) work = fsearch_database_work_new_search(1,
+                                                                           query,
+                                                                           DATABASE_INDEX_PROPERTY_NAME,
+                                                                           GTK_SORT_ASCENDING);
+    fsearch_database_queue_work(db, work);
+    wait_for_signal(&ctx);
+    g_signal_handler_disconnect(db, handler);
+
+    g_assert_nonnull(ctx.search_info);
+    const uint32_t num_files = fsearch_database_search_info_get_num_files(ctx.search_info);
+    wait_ctx_clear(&ctx);
+    return num_files;
+}
+
+static FsearchDatabase *
+database_new_for_dir(const char *tmp_dir, const char *db_path) {
+    g_autoptr(FsearchDatabaseIncludeManager) include_manager = fsearch_database_include_manager_new();
+    g_autoptr(FsearchDatabaseInclude) include = fsearch_database_include_new(tmp_dir, TRUE, FALSE, FALSE, FALSE, 0);
+    fsearch_database_include_manager_add(include_manager, include);
+    g_autoptr(FsearchDatabaseExcludeManager) exclude_manager = fsearch_database_exclude_manager_new();
+
+    return fsearch_database_new(g_file_new_for_path(db_path), include_manager, exclude_manager);
+}
+
+// A batch of changes which couldn't be written to the journal is lost, so the database file has to be rewritten
+// instead of relying on the journal when the database is closed
+static void
+test_failed_journal_flush_saves_database_file(void) {
+    g_autofree char *tmp_dir = g_dir_make_tmp("fsearch-test-database-XXXXXX", NULL);
+    g_assert_nonnull(tmp_dir);
+    for (int i = 0; i < 3; i++) {
+        g_autofree char *path = test_file_path(tmp_dir, i);
+        g_assert_true(g_file_set_contents(path, "", 0, NULL));
+    }
+    g_autofree char *db_path = g_build_filename(tmp_dir, "fsearch-test.db", NULL);
+    FsearchFilterManager *filters = fsearch_filter_manager_new_with_defaults();
+
+    FsearchDatabase *db = database_new_for_dir(tmp_dir, db_path);
+    g_assert_cmpint(fsearch_database_rescan_blocking(db), ==, FSEARCH_RESULT_SUCCESS);
+
+    // Changes are only journaled once the scanned store was saved
+    WaitCtx ctx = {};
+    gulong save_handler = g_signal_connect(db, "save-finished", G_CALLBACK(on_save_finished), &ctx);
+    g_autoptr(FsearchDatabaseWork) save_work = fsearch_database_work_new_save();
+    fsearch_database_queue_work(db, save_work);
+    wait_for_signal(&ctx);
+    g_signal_handler_disconnect(db, save_handler);
+    wait_ctx_clear(&ctx);
+
+    // Writing beyond the file size limit fails with EFBIG, so the journal can't be written. The file stays on disk:
+    // if it got scanned again, it would be part of the database either way.
+    struct rlimit old_limit = {};
+    g_assert_cmpint(getrlimit(RLIMIT_FSIZE, &old_limit), ==, 0);
+    signal(SIGXFSZ, SIG_IGN);
+    struct rlimit limit = {.rlim_cur = 0, .rlim_max = old_limit.rlim_max};
+    g_assert_cmpint(setrlimit(RLIMIT_FSIZE, &limit), ==, 0);
+
+    g_autofree char *removed_path = test_file_path(tmp_dir, 0);
+    g_autoptr(DynamicArray) removed_paths = darray_new_full(1, g_free);
+    darray_add_item(removed_paths, g_strdup(removed_path));
+    g_autoptr(FsearchDatabaseWork) remove_work = fsearch_database_work_new_notify_items_removed(removed_paths);
+    fsearch_database_queue_work(db, remove_work);
+    // Work is processed in order, so the removal was applied once the search finished
+    g_assert_cmpuint(search_num_files(db, filters), ==, 2);
+
+    g_assert_cmpint(setrlimit(RLIMIT_FSIZE, &old_limit), ==, 0);
+    signal(SIGXFSZ, SIG_DFL);
+
+    // Closing the database has to save the file, because the journal doesn't contain the removal
+    g_object_unref(db);
+
+    db = database_new_for_dir(tmp_dir, db_path);
+    gulong load_handler = g_signal_connect(db, "load-finished", G_CALLBACK(on_load_finished), &ctx);
+    g_autoptr(FsearchDatabaseWork) load_work = fsearch_database_work_new_load();
+    fsearch_database_queue_work(db, load_work);
+    wait_for_signal(&ctx);
+    g_signal_handler_disconnect(db, load_handler);
+    wait_ctx_clear(&ctx);
+
+    g_assert_cmpuint(search_num_files(db, filters), ==, 2);
+
+    g_object_unref(db);
+    fsearch_filter_manager_unref(filters);
+    remove_dir_recursive(tmp_dir);
+}
+
 int
 main(int argc, char **argv) {
     g_test_init(&argc, &argv, NULL);
 
     g_test_add_func("/FSearch/database/get_item_info_for_stale_index_still_signals",
                     test_get_item_info_for_stale_index_still_signals);
+    g_test_add_func("/FSearch/database/failed_journal_flush_saves_database_file",
+                    test_failed_journal_flush_saves_database_file);
 
     return g_test_run();
 }
@@ -15,6 +15,7 @@
  *   - fsearch_database_chunked_array_get_num_entries
  *   - fsearch_database_chunked_array_get_chunks
  *   - fsearch_database_chunked_array_get_joined
+ *   - fsearch_database_chunked_array_get_name_range
  *   - fsearch_database_chunked_array_get_type
  *
  * Not exercised: fsearch_database_chunked_array_balance is declared in the header but has
@@ -325,7 +326,7 @@ test_get_chunks_total_matches_num_entries(void) {
     g_autoptr(DynamicArray) chunks = fsearch_database_chunked_array_get_chunks(arr);
     uint32_t total = 0;
     for (uint32_t i = 0; i < darray_get_num_items(chunks); i++) {
-        total += darray_get_num_items(darray_get_item(chunks, i));
+        total += idarray_get_num_items(darray_get_item(chunks, i));
     }
     g_assert_cmpuint(total, ==, fsearch_database_chunked_array_get_num_entries(arr));
 }
@@ -748,13 +749,13 @@ test_steal_does_not_merge_shrunken_chunks(void) {
     // exactly one survivor and none of them become fully empty (which would remove them).
     g_autoptr(DynamicArray) chunks = fsearch_database_chunked_array_get_chunks(arr);
     for (uint32_t c = 0; c < darray_get_num_items(chunks); c++) {
-        DynamicArray *chunk = darray_get_item(chunks, c);
-        const uint32_t chunk_size = darray_get_num_items(chunk);
+        DynamicIdArray *chunk = darray_get_item(chunks, c);
+        const uint32_t chunk_size = idarray_get_num_items(chunk);
 
         // Snapshot the victims (everything but index 0) before mutating the chunk.
         g_autoptr(DynamicArray) victims = darray_new(chunk_size > 0 ? chunk_size - 1 : 0);
         for (uint32_t i = 1; i < chunk_size; i++) {
-            darray_add_item(victims, darray_get_item(chunk, i));
+            darray_add_item(victims, idarray_get_item(chunk, i));
         }
         for (uint32_t i = 0; i < darray_get_num_items(victims); i++) {
             FsearchDatabaseEntry *stolen = fsearch_database_chunked_array_steal(arr, darray_get_item(victims, i));
@@ -783,12 +784,12 @@ test_steal_removes_emptied_chunk(void) {
     g_assert_cmpuint(chunks_before, >, 1);
 
     g_autoptr(DynamicArray) chunks = fsearch_database_chunked_array_get_chunks(arr);
-    DynamicArray *last_chunk = darray_get_item(chunks, darray_get_num_items(chunks) - 1);
-    const uint32_t last_chunk_size = darray_get_num_items(last_chunk);
+    DynamicIdArray *last_chunk = darray_get_item(chunks, darray_get_num_items(chunks) - 1);
+    const uint32_t last_chunk_size = idarray_get_num_items(last_chunk);
 
     // Snapshot the entries of the last chunk before mutating anything.
     g_autoptr(DynamicArray) last_chunk_entries = darray_new(last_chunk_size);
-    darray_add_array(last_chunk_entries, last_chunk);
+    darray_add_idarray(last_chunk_entries, last_chunk);
 
     for (uint32_t i = 0; i < last_chunk_size; i++) {
         FsearchDatabaseEntry *entry = darray_get_item(last_chunk_entries, i);
@@ -1323,6 +1324,117 @@ test_remove_marked_zero_count_is_noop(void) {
     g_assert_cmpuint(fsearch_database_chunked_array_get_num_entries(arr), ==, 10);
 }
 
+/* ------------------------------------------------------------------------ *
+ * Name range lookups
+ * ------------------------------------------------------------------------ */
+
+static DynamicArray *
+make_name_range_input(void) {
+    DynamicArray *input = make_sorted_files("a", 100);
+    g_autoptr(DynamicArray) b = make_sorted_files("b", 3000);
+    g_autoptr(DynamicArray) c = make_sorted_files("c", 100);
+    for (uint32_t i = 0; i < darray_get_num_items(b); i++) {
+        darray_add_item(input, darray_get_item(b, i));
+    }
+    for (uint32_t i = 0; i < darray_get_num_items(c); i++) {
+        darray_add_item(input, darray_get_item(c, i));
+    }
+    return input;
+}
+
+static void
+test_get_name_range_prefix_spans_chunks(void) {
+    g_autoptr(DynamicArray) input = make_name_range_input();
+    g_autoptr(FsearchDatabaseChunkedArray) arr = make_chunked_array(input,
+                                                                    TRUE,
+                                                                    DATABASE_INDEX_PROPERTY_NAME,
+                                                                    DATABASE_ENTRY_TYPE_FILE,
+                                                                    (GDestroyNotify)db_entry_free_no_unparent);
+    g_assert_cmpuint(num_chunks(arr), >, 1);
+
+    g_autoptr(DynamicArray) dest = darray_new(128);
+    g_assert_cmpuint(fsearch_database_chunked_array_get_name_range(arr, "b_", FALSE, FALSE, dest), ==, 3000);
+    g_assert_cmpuint(darray_get_num_items(dest), ==, 3000);
+    g_assert_cmpstr(db_entry_get_name_raw_for_display(darray_get_item(dest, 0)), ==, "b_000000");
+    g_assert_cmpstr(db_entry_get_name_raw_for_display(darray_get_item(dest, 2999)), ==, "b_002999");
+
+    // Results are appended, so a second lookup keeps the first one's entries
+    g_assert_cmpuint(fsearch_database_chunked_array_get_name_range(arr, "c", FALSE, FALSE, dest), ==, 100);
+    g_assert_cmpuint(darray_get_num_items(dest), ==, 3100);
+
+    g_assert_cmpuint(fsearch_database_chunked_array_get_name_range(arr, "d", FALSE, FALSE, dest), ==, 0);
+    g_assert_cmpuint(fsearch_database_chunked_array_get_name_range(arr, "B", FALSE, FALSE, dest), ==, 0);
+    g_assert_cmpuint(fsearch_database_chunked_array_get_name_range(arr, "B_", FALSE, TRUE, dest), ==, 3000);
+}
+
+static void
+test_get_name_range_exact(void) {
+    g_autoptr(DynamicArray) input = make_name_range_input();
+    g_autoptr(FsearchDatabaseChunkedArray) arr = make_chunked_array(input,
+                                                                    TRUE,
+                                                                    DATABASE_INDEX_PROPERTY_NAME,
+                                                                    DATABASE_ENTRY_TYPE_FILE,
+                                                                    (GDestroyNotify)db_entry_free_no_unparent);
+    g_autoptr(DynamicArray) dest = darray_new(4);
+    g_assert_cmpuint(fsearch_database_chunked_array_get_name_range(arr, "b_002500", TRUE, FALSE, dest), ==, 1);
+    g_assert_cmpstr(db_entry_get_name_raw_for_display(darray_get_item(dest, 0)), ==, "b_002500");
+
+    // An exact key never matches longer names which merely start with it
+    g_assert_cmpuint(fsearch_database_chunked_array_get_name_range(arr, "b_", TRUE, FALSE, dest), ==, 0);
+}
+
+static void
+test_get_name_range_ignore_case(void) {
+    const char *names[] = {"makefile.in", "README", "Makefile", "makefiles", "MAKEFILE", "makefile", "Makefile.am"};
+    g_autoptr(DynamicArray) input = darray_new(G_N_ELEMENTS(names));
+    for (uint32_t i = 0; i < G_N_ELEMENTS(names); i++) {
+        darray_add_item(input, make_file(names[i]));
+    }
+    g_autoptr(FsearchDatabaseChunkedArray) arr = make_chunked_array(input,
+                                                                    FALSE,
+                                                                    DATABASE_INDEX_PROPERTY_NAME,
+                                                                    DATABASE_ENTRY_TYPE_FILE,
+                                                                    (GDestroyNotify)db_entry_free_no_unparent);
+    g_autoptr(DynamicArray) dest = darray_new(8);
+
+    // Keys with many letters have lots of spellings, but only the ones which occur are looked up
+    g_assert_cmpuint(fsearch_database_chunked_array_get_name_range(arr, "makefile", TRUE, TRUE, dest), ==, 3);
+    g_assert_cmpstr(db_entry_get_name_raw_for_display(darray_get_item(dest, 0)), ==, "MAKEFILE");
+    g_assert_cmpstr(db_entry_get_name_raw_for_display(darray_get_item(dest, 1)), ==, "Makefile");
+    g_assert_cmpstr(db_entry_get_name_raw_for_display(darray_get_item(dest, 2)), ==, "makefile");
+
+    g_autoptr(DynamicArray) prefixed = darray_new(8);
+    g_assert_cmpuint(fsearch_database_chunked_array_get_name_range(arr, "MakeFile", FALSE, TRUE, prefixed), ==, 6);
+    // The ranges of the different spellings are appended in array order
+    for (uint32_t i = 1; i < darray_get_num_items(prefixed); i++) {
+        g_assert_cmpint(strcmp(db_entry_get_name_raw_for_display(darray_get_item(prefixed, i - 1)),
+                               db_entry_get_name_raw_for_display(darray_get_item(prefixed, i))),
+                        <,
+                        0);
+    }
+
+    g_autoptr(DynamicArray) case_sensitive = darray_new(8);
+    g_assert_cmpuint(fsearch_database_chunked_array_get_name_range(arr, "Makefile", FALSE, FALSE, case_sensitive),
+                     ==,
+                     2);
+    g_assert_cmpuint(fsearch_database_chunked_array_get_name_range(arr, "makefile.a", FALSE, TRUE, case_sensitive),
+                     ==,
+                     1);
+}
+
+static void
+test_get_name_range_requires_name_order(void) {
+    g_autoptr(DynamicArray) input = make_sorted_files("f", 10);
+    g_autoptr(FsearchDatabaseChunkedArray) arr = make_chunked_array(input,
+                                                                    FALSE,
+                                                                    DATABASE_INDEX_PROPERTY_SIZE,
+                                                                    DATABASE_ENTRY_TYPE_FILE,
+                                                                    (GDestroyNotify)db_entry_free_no_unparent);
+    g_autoptr(DynamicArray) dest = darray_new(4);
+    g_assert_cmpuint(fsearch_database_chunked_array_get_name_range(arr, "f_", FALSE, FALSE, dest), ==, 0);
+    g_assert_cmpuint(darray_get_num_items(dest), ==, 0);
+}
+
 /* ------------------------------------------------------------------------ *
  * Main
  * ------------------------------------------------------------------------ */
@@ -1434,5 +1546,13 @@ main(int argc, char **argv) {
     g_test_add_func("/FSearch/database/chunked_array/remove_marked_zero_count_is_noop",
                     test_remove_marked_zero_count_is_noop);
 
+    // Name range lookups
+    g_test_add_func("/FSearch/database/chunked_array/get_name_range_prefix_spans_chunks",
+                    test_get_name_range_prefix_spans_chunks);
+    g_test_add_func("/FSearch/database/chunked_array/get_name_range_exact", test_get_name_range_exact);
+    g_test_add_func("/FSearch/database/chunked_array/get_name_range_ignore_case", test_get_name_range_ignore_case);
+    g_test_add_func("/FSearch/database/chunked_array/get_name_range_requires_name_order",
+                    test_get_name_range_requires_name_order);
+
     return g_test_run();
 }
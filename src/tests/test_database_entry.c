@@ -35,7 +35,10 @@
 
 #include "fsearch_database_entry.h"
 #include "fsearch_database_entry_flags.h"
+#include "fsearch_database_file_type.h"
 #include "fsearch_database_index_properties.h"
+#include "fsearch_database_sort.h"
+#include "fsearch_file_utils.h"
 
 #include <glib.h>
 #include <string.h>
@@ -961,10 +964,10 @@ test_compare_by_type_folders_always_equal(void) {
     g_assert_cmpint(db_entry_compare_entries_by_type(&dir_b, &dir_a, ctx), ==, 0);
     g_assert_cmpint(db_entry_compare_entries_by_type(&dir_a, &dir_a, ctx), ==, 0);
 
-    // Both folders share the "Folder" type string, so exactly one entry is added to the
-    // dedup table, but each entry gets its own cache slot.
-    g_assert_cmpuint(g_hash_table_size(ctx->file_type_table), ==, 1);
-    g_assert_cmpuint(g_hash_table_size(ctx->entry_to_file_type_table), ==, 2);
+    // Both folders share the "Folder" type, so they resolve to the same type id
+    g_assert_cmpuint(db_entry_get_file_type_id(dir_a), !=, FSEARCH_DATABASE_FILE_TYPE_ID_NONE);
+    g_assert_cmpuint(db_entry_get_file_type_id(dir_a), ==, db_entry_get_file_type_id(dir_b));
+    g_assert_cmpstr(fsearch_database_file_type_get_description(db_entry_get_file_type_id(dir_a)), ==, "Folder");
 
     db_entry_compare_context_free(ctx);
     db_entry_free(dir_a);
@@ -1054,6 +1057,173 @@ test_compare_by_full_path_orders_by_ancestor_names(void) {
     db_entry_free(root);
 }
 
+static void
+test_path_ordinal_sort_matches_path_comparator(void) {
+    // "root/a/z" sorts after "root/a/b/c" by full path, but before it by the path of its parent
+    FsearchDatabaseEntry *root = new_folder(DATABASE_INDEX_PROPERTY_FLAG_NONE, "root", NULL);
+    FsearchDatabaseEntry *a = new_folder(DATABASE_INDEX_PROPERTY_FLAG_NONE, "a", root);
+    FsearchDatabaseEntry *a_b = new_folder(DATABASE_INDEX_PROPERTY_FLAG_NONE, "b", a);
+    FsearchDatabaseEntry *a_z = new_folder(DATABASE_INDEX_PROPERTY_FLAG_NONE, "z", a);
+    FsearchDatabaseEntry *a_b_c = new_folder(DATABASE_INDEX_PROPERTY_FLAG_NONE, "c", a_b);
+    FsearchDatabaseEntry *a_10 = new_folder(DATABASE_INDEX_PROPERTY_FLAG_NONE, "10", a);
+    FsearchDatabaseEntry *a_9 = new_folder(DATABASE_INDEX_PROPERTY_FLAG_NONE, "9", a);
+    FsearchDatabaseEntry *parents[] = {root, a, a_b, a_z, a_b_c, a_10, a_9};
+
+    g_autoptr(DynamicArray) entries = darray_new(64);
+    for (uint32_t i = 0; i < G_N_ELEMENTS(parents); ++i) {
+        darray_add_item(entries, parents[i]);
+        for (uint32_t j = 0; j < 3; ++j) {
+            g_autofree char *name = g_strdup_printf("file_%u", (j * 7 + i) % 3);
+            darray_add_item(entries, new_file(DATABASE_INDEX_PROPERTY_FLAG_NONE, name, parents[i]));
+        }
+    }
+
+    FsearchDatabaseEntryCompareContext *name_ctx = db_entry_compare_context_new(
+        fsearch_database_sort_order_chain_for_property(DATABASE_INDEX_PROPERTY_NAME));
+    FsearchDatabaseEntryCompareContext *path_ctx = db_entry_compare_context_new(
+        fsearch_database_sort_order_chain_for_property(DATABASE_INDEX_PROPERTY_PATH));
+
+    // Starting from name order, sorting by the parent ordinals alone has to yield the full path chain order
+    g_autoptr(DynamicArray) expected = darray_copy(entries);
+    darray_sort(expected, (DynamicArrayCompareDataFunc)db_entry_compare_entries_by_chain, NULL, path_ctx);
+    darray_sort(entries, (DynamicArrayCompareDataFunc)db_entry_compare_entries_by_chain, NULL, name_ctx);
+    g_assert_true(fsearch_database_sort_entries_by_numeric_key(entries, DATABASE_INDEX_PROPERTY_PATH, NULL));
+
+    const uint32_t num_entries = darray_get_num_items(entries);
+    for (uint32_t i = 0; i < num_entries; ++i) {
+        g_assert_true(darray_get_item(entries, i) == darray_get_item(expected, i));
+    }
+
+    db_entry_compare_context_free(name_ctx);
+    db_entry_compare_context_free(path_ctx);
+    for (uint32_t i = 0; i < num_entries; ++i) {
+        FsearchDatabaseEntry *entry = darray_get_item(entries, i);
+        if (db_entry_is_file(entry)) {
+            db_entry_free(entry);
+        }
+    }
+    for (int32_t i = G_N_ELEMENTS(parents) - 1; i >= 0; --i) {
+        db_entry_free(parents[i]);
+    }
+}
+
+static void
+test_name_key_sort_matches_name_comparator(void) {
+    // Names sharing long prefixes, numbers (which are compared by value), separators and case differences
+    const char *names[] = {"file10",      "file9",       "file09",  "file",        "File",    "file.txt",
+                           "file-1",      "file 2",      "filez",   "abcdefghij2", "abcdefgh", "abcdefghij10",
+                           "abcdefghij1", "abcdefghijk", "_hidden", "~backup",     "10",       "9",
+                           "a",           "file10",      "z\xc3\xa4", "z\xc3\xa4" "b"};
+
+    // A smaller key has to mean a smaller name
+    for (uint32_t i = 0; i < G_N_ELEMENTS(names); ++i) {
+        for (uint32_t j = 0; j < G_N_ELEMENTS(names); ++j) {
+            if (fsearch_file_utils_get_path_sort_key(names[i]) < fsearch_file_utils_get_path_sort_key(names[j])) {
+                g_assert_cmpint(fsearch_file_utils_cmp_paths(names[i], names[j]), <, 0);
+            }
+        }
+    }
+
+    FsearchDatabaseEntry *root = new_folder(DATABASE_INDEX_PROPERTY_FLAG_NONE, "root", NULL);
+    FsearchDatabaseEntry *other = new_folder(DATABASE_INDEX_PROPERTY_FLAG_NONE, "other", root);
+    g_autoptr(DynamicArray) entries = darray_new(64);
+    for (uint32_t i = 0; i < G_N_ELEMENTS(names); ++i) {
+        darray_add_item(entries, new_file(DATABASE_INDEX_PROPERTY_FLAG_NONE, names[i], i % 2 ? root : other));
+    }
+
+    const FsearchDatabaseSortOrderChain chain = fsearch_database_sort_order_chain_for_property(
+        DATABASE_INDEX_PROPERTY_NAME);
+    FsearchDatabaseEntryCompareContext *ctx = db_entry_compare_context_new(chain);
+    g_autoptr(DynamicArray) expected = darray_copy(entries);
+    darray_sort(expected, (DynamicArrayCompareDataFunc)db_entry_compare_entries_by_chain, NULL, ctx);
+    g_assert_true(fsearch_database_sort_entries_by_name_key(entries, chain, NULL));
+
+    const uint32_t num_entries = darray_get_num_items(entries);
+    for (uint32_t i = 0; i < num_entries; ++i) {
+        g_assert_true(darray_get_item(entries, i) == darray_get_item(expected, i));
+    }
+
+    // Only chains starting with NAME can be sorted by the name key
+    g_assert_false(fsearch_database_sort_entries_by_name_key(
+        entries,
+        fsearch_database_sort_order_chain_for_property(DATABASE_INDEX_PROPERTY_PATH),
+        NULL));
+
+    db_entry_compare_context_free(ctx);
+    for (uint32_t i = 0; i < num_entries; ++i) {
+        db_entry_free(darray_get_item(entries, i));
+    }
+    db_entry_free(other);
+    db_entry_free(root);
+}
+
+static void
+test_file_type_sort_matches_type_comparator(void) {
+    const char *names[] = {"b.txt", "a.png", "c.TXT", "d", "e.tar.gz", "a.txt", "f.png", "g.c", "h.C", "i.gz"};
+
+    FsearchDatabaseEntry *root = new_folder(DATABASE_INDEX_PROPERTY_FLAG_NONE, "root", NULL);
+    g_autoptr(DynamicArray) entries = darray_new(64);
+    for (uint32_t i = 0; i < G_N_ELEMENTS(names); ++i) {
+        darray_add_item(entries, new_file(DATABASE_INDEX_PROPERTY_FLAG_NONE, names[i], root));
+    }
+
+    // Files of the same type share their type id
+    g_assert_cmpuint(db_entry_get_file_type_id(darray_get_item(entries, 0)),
+                     ==,
+                     db_entry_get_file_type_id(darray_get_item(entries, 5)));
+
+    FsearchDatabaseEntryCompareContext *name_ctx = db_entry_compare_context_new(
+        fsearch_database_sort_order_chain_for_property(DATABASE_INDEX_PROPERTY_NAME));
+    FsearchDatabaseEntryCompareContext *type_ctx = db_entry_compare_context_new(
+        fsearch_database_sort_order_chain_for_property(DATABASE_INDEX_PROPERTY_FILETYPE));
+
+    // Starting from name order, sorting by the type ordinals alone has to yield the full type chain order
+    g_autoptr(DynamicArray) expected = darray_copy(entries);
+    darray_sort(expected, (DynamicArrayCompareDataFunc)db_entry_compare_entries_by_chain, NULL, type_ctx);
+    darray_sort(entries, (DynamicArrayCompareDataFunc)db_entry_compare_entries_by_chain, NULL, name_ctx);
+    g_assert_true(fsearch_database_sort_entries_by_numeric_key(entries, DATABASE_INDEX_PROPERTY_FILETYPE, NULL));
+
+    const uint32_t num_entries = darray_get_num_items(entries);
+    for (uint32_t i = 0; i < num_entries; ++i) {
+        g_assert_true(darray_get_item(entries, i) == darray_get_item(expected, i));
+    }
+
+    db_entry_compare_context_free(name_ctx);
+    db_entry_compare_context_free(type_ctx);
+    for (uint32_t i = 0; i < num_entries; ++i) {
+        db_entry_free(darray_get_item(entries, i));
+    }
+    db_entry_free(root);
+}
+
+static void
+test_file_type_is_guessed_from_whole_name(void) {
+    // Types can depend on more than the last extension, e.g. for names like "Makefile" or patterns like "*.tar.gz".
+    // Types are cached by suffix, so every name with a special type follows one with the same suffix.
+    const char *names[] = {"Makefile",
+                           "README",
+                           "e.tar.gz",
+                           "i.gz",
+                           "j.tar.gz",
+                           "a.txt",
+                           "CMakeLists.txt",
+                           "cmakelists.txt",
+                           "b.txt",
+                           "x.am",
+                           "Makefile.am",
+                           "y.foo",
+                           "README.foo",
+                           "noext",
+                           "makefile",
+                           "Makefile"};
+    for (uint32_t i = 0; i < G_N_ELEMENTS(names); ++i) {
+        FsearchDatabaseEntry *file = new_file(DATABASE_INDEX_PROPERTY_FLAG_NONE, names[i], NULL);
+        g_autofree char *expected = fsearch_file_utils_get_file_type_non_localized(names[i], FALSE);
+        g_assert_cmpstr(fsearch_database_file_type_get_description(db_entry_get_file_type_id(file)), ==, expected);
+        db_entry_free(file);
+    }
+}
+
 /* ------------------------------------------------------------------------ *
  * Subtree contiguity
  * ------------------------------------------------------------------------ */
@@ -1569,6 +1739,14 @@ main(int argc, char **argv) {
     g_test_add_func("/FSearch/database/entry/compare_by_path_different_depth", test_compare_by_path_different_depth);
     g_test_add_func("/FSearch/database/entry/compare_by_full_path_ancestor_order",
                     test_compare_by_full_path_orders_by_ancestor_names);
+    g_test_add_func("/FSearch/database/entry/path_ordinal_sort_matches_path_comparator",
+                    test_path_ordinal_sort_matches_path_comparator);
+    g_test_add_func("/FSearch/database/entry/file_type_sort_matches_type_comparator",
+                    test_file_type_sort_matches_type_comparator);
+    g_test_add_func("/FSearch/database/entry/file_type_is_guessed_from_whole_name",
+                    test_file_type_is_guessed_from_whole_name);
+    g_test_add_func("/FSearch/database/entry/name_key_sort_matches_name_comparator",
+                    test_name_key_sort_matches_name_comparator);
     g_test_add_func("/FSearch/database/entry/path_sort_keeps_descendant_files_contiguous",
                     test_path_sort_keeps_descendant_files_contiguous);
     g_test_add_func("/FSearch/database/entry/path_compare_has_no_name_collisions",
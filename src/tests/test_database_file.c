@@ -3,20 +3,18 @@
  * relationships and non-NAME sort orders now that FsearchDatabaseEntry no longer carries a
  * dedicated `index` field.
  *
- * That field used to record each entry's position in the canonical (NAME-order) folders/files
- * array purely as save-time bookkeeping: database_file_save_folders()/_files() use it to write
- * each entry's parent as a stable on-disk array index, and database_file_save_sorted_arrays()
- * uses it to write, for every other fast-sort order (PATH/SIZE/MTIME/EXTENSION), a permutation
- * back into that canonical order. It was never read anywhere outside of saving.
+ * That field used to record each entry's position in the folders/files arrays purely as
+ * save-time bookkeeping: database_file_save_sorted_arrays() uses it to write, for every fast-sort
+ * order (PATH/SIZE/MTIME/EXTENSION), a permutation into the order the entries are stored in. It
+ * was never read anywhere outside of saving.
  *
- * Since it cost every entry 8 bytes (4 for the field, 4 more from the alignment padding it forced
- * on FsearchDatabaseEntry) for the entire lifetime of the app just to support this one save-time
- * lookup, it's replaced by build_entry_index_map(): a flat array of (entry pointer, index) pairs,
- * built fresh for each save, sorted once by pointer value, and binary-searched -- no permanent
- * per-entry storage, and no GHashTable (which would be real overhead to populate with millions of
- * pointer keys).
+ * Since it cost every entry 8 bytes for the entire lifetime of the app just to support this one
+ * save-time lookup, it's replaced by DatabaseFileEntrySet: a bitmap over the arena ids of the
+ * entries, built fresh for each save, whose ranks are the positions (folders get moved after their
+ * parents). Parents are stored as the distance to them within the entry block instead, so the block
+ * can be mapped when it's loaded.
  *
- * This test exercises both lookup call sites that map replaced: saving/loading a small file tree
+ * This test exercises both: saving/loading a small file tree
  * with a subdirectory (so files have two different parents) and multiple sizes (so the SIZE-order
  * permutation differs from NAME-order), then checking that both survive a save+load roundtrip.
  */
@@ -26,17 +24,36 @@
 #include "fsearch_database_file.h"
 #include "fsearch_database_include.h"
 #include "fsearch_database_include_manager.h"
+#include "fsearch_database_index.h"
 #include "fsearch_database_index_properties.h"
 #include "fsearch_database_index_store.h"
+#include "fsearch_database_journal.h"
+#include "fsearch_hash.h"
 
 #include <glib.h>
 #include <glib/gstdio.h>
+#include <string.h>
 
 static void
 write_file(const char *path, const char *content) {
     g_assert_true(g_file_set_contents(path, content, -1, NULL));
 }
 
+// Only the name and path indices are available right after loading, the others are added in the background
+static FsearchDatabaseChunkedArray *
+wait_for_files(FsearchDatabaseIndexStore *store, FsearchDatabaseIndexProperty sort_order) {
+    for (uint32_t i = 0; i < 500; i++) {
+        g_autoptr(GMutexLocker) locker = fsearch_database_index_store_get_locker(store);
+        FsearchDatabaseChunkedArray *files = fsearch_database_index_store_get_files(store, sort_order);
+        if (files) {
+            return files;
+        }
+        g_clear_pointer(&locker, g_mutex_locker_free);
+        g_usleep(10000);
+    }
+    return NULL;
+}
+
 static void
 test_save_load_roundtrip_preserves_hierarchy_and_sort_orders(void) {
     g_autofree char *tmp_dir = g_dir_make_tmp("fsearch-test-database-file-XXXXXX", NULL);
@@ -71,12 +88,9 @@ test_save_load_roundtrip_preserves_hierarchy_and_sort_orders(void) {
     // The include root itself and "subdir" -- 2 folders.
     g_assert_cmpuint(fsearch_database_index_store_get_num_folders(store), ==, 2);
 
-    // Capture every live entry's real parent pointer before saving, so we can confirm below that
-    // save() put them back afterward. fsearch_database_file_save() temporarily repurposes each
-    // entry's `parent` field as scratch storage for its own canonical (NAME-order) index (see
-    // database_file_encode_indices() in fsearch_database_file.c); if it failed to restore the real
-    // pointers on every exit path, `store` -- which is still live and gets searched/sorted/saved
-    // again after this, not thrown away -- would be left corrupted.
+    // Capture every live entry's parent before saving, so we can confirm below that saving doesn't
+    // change the entries of `store` -- which is still live and gets searched/sorted/saved again
+    // after this, not thrown away. Only copies of the entries are written to the file.
     g_autoptr(FsearchDatabaseChunkedArray) name_sorted_files_before_save =
         fsearch_database_index_store_get_files(store, DATABASE_INDEX_PROPERTY_NAME);
     g_autoptr(FsearchDatabaseChunkedArray) name_sorted_folders_before_save =
@@ -88,11 +102,13 @@ test_save_load_roundtrip_preserves_hierarchy_and_sort_orders(void) {
     FsearchDatabaseEntry *file_parents_before_save[3];
     off_t file_sizes_before_save[3];
     time_t file_mtimes_before_save[3];
+    uint16_t file_types_before_save[3];
     for (uint32_t i = 0; i < 3; i++) {
         files_before_save[i] = fsearch_database_chunked_array_get_entry(name_sorted_files_before_save, i);
         file_parents_before_save[i] = db_entry_get_parent(files_before_save[i]);
         file_sizes_before_save[i] = db_entry_get_size(files_before_save[i]);
         file_mtimes_before_save[i] = db_entry_get_mtime(files_before_save[i]);
+        file_types_before_save[i] = db_entry_get_file_type_id(files_before_save[i]);
         // Sanity: the live store must actually have real values to round-trip.
         g_assert_cmpint(file_sizes_before_save[i], >, 0);
         g_assert_cmpint(file_mtimes_before_save[i], >, 0);
@@ -131,7 +147,7 @@ test_save_load_roundtrip_preserves_hierarchy_and_sort_orders(void) {
     g_assert_cmpuint(fsearch_database_index_store_get_num_files(loaded_store), ==, 3);
     g_assert_cmpuint(fsearch_database_index_store_get_num_folders(loaded_store), ==, 2);
 
-    // Parent/child relationships: exercises the parent-index lookups used when saving each entry.
+    // Parent/child relationships: exercises the parent offsets of the mapped entry block.
     g_autoptr(FsearchDatabaseChunkedArray) name_sorted_files =
         fsearch_database_index_store_get_files(loaded_store, DATABASE_INDEX_PROPERTY_NAME);
     g_assert_nonnull(name_sorted_files);
@@ -150,12 +166,14 @@ test_save_load_roundtrip_preserves_hierarchy_and_sort_orders(void) {
         // Exact size + mtime must survive the roundtrip (files are in NAME order both times).
         g_assert_cmpint(db_entry_get_size(entry), ==, file_sizes_before_save[i]);
         g_assert_cmpint(db_entry_get_mtime(entry), ==, file_mtimes_before_save[i]);
+        // The type is stored as well, instead of being guessed again
+        g_assert_cmpuint(db_entry_get_file_type_id(entry), ==, file_types_before_save[i]);
     }
 
-    // Non-NAME sort order: exercises the self-index lookups used to write each fast-sort order's
-    // permutation back into canonical (NAME-order) positions.
-    g_autoptr(FsearchDatabaseChunkedArray) size_sorted_files =
-        fsearch_database_index_store_get_files(loaded_store, DATABASE_INDEX_PROPERTY_SIZE);
+    // Non-NAME sort order: exercises the ranks used to write each fast-sort order's permutation
+    // into the positions of the entry block.
+    g_autoptr(FsearchDatabaseChunkedArray) size_sorted_files = wait_for_files(loaded_store,
+                                                                              DATABASE_INDEX_PROPERTY_SIZE);
     g_assert_nonnull(size_sorted_files);
     g_assert_cmpstr(db_entry_get_name_raw(fsearch_database_chunked_array_get_entry(size_sorted_files, 0)), ==, "c.txt");
     g_assert_cmpstr(db_entry_get_name_raw(fsearch_database_chunked_array_get_entry(size_sorted_files, 1)), ==, "b.txt");
@@ -169,12 +187,819 @@ test_save_load_roundtrip_preserves_hierarchy_and_sort_orders(void) {
     g_rmdir(tmp_dir);
 }
 
+static void
+test_load_rejects_truncated_file(void) {
+    g_autofree char *tmp_dir = g_dir_make_tmp("fsearch-test-database-file-XXXXXX", NULL);
+    g_assert_nonnull(tmp_dir);
+
+    g_autofree char *file_a = g_build_filename(tmp_dir, "a.txt", NULL);
+    write_file(file_a, "aaaa");
+
+    g_autoptr(FsearchDatabaseIncludeManager) include_manager = fsearch_database_include_manager_new();
+    g_autoptr(FsearchDatabaseInclude) include = fsearch_database_include_new(tmp_dir, TRUE, FALSE, FALSE, FALSE, 0);
+    fsearch_database_include_manager_add(include_manager, include);
+    g_autoptr(FsearchDatabaseExcludeManager) exclude_manager = fsearch_database_exclude_manager_new();
+
+    FsearchDatabaseIndexStore *store = fsearch_database_index_store_new(include_manager,
+                                                                        exclude_manager,
+                                                                        DATABASE_INDEX_PROPERTY_FLAG_NAME
+                                                                            | DATABASE_INDEX_PROPERTY_FLAG_SIZE,
+                                                                        NULL,
+                                                                        NULL);
+    fsearch_database_index_store_start(store, NULL);
+
+    g_autofree char *db_path = g_build_filename(tmp_dir, "test.db", NULL);
+    g_assert_true(fsearch_database_file_save(store, db_path));
+    fsearch_database_index_store_unref(store);
+
+    // The entry block and sorted arrays are read from the mapped file, cutting off their end must fail the load
+    // instead of reading past the mapping
+    g_autofree char *contents = NULL;
+    gsize length = 0;
+    g_assert_true(g_file_get_contents(db_path, &contents, &length, NULL));
+    g_assert_cmpuint(length, >, 4);
+    g_assert_true(g_file_set_contents(db_path, contents, (gssize)length - 4, NULL));
+
+    g_autoptr(FsearchDatabaseIndexStore) loaded_store = NULL;
+    g_test_expect_message("fsearch-database-file", G_LOG_LEVEL_WARNING, "*sorted arrays is truncated*");
+    g_assert_false(fsearch_database_file_load(db_path,
+                                              NULL,
+                                              &loaded_store,
+                                              include_manager,
+                                              exclude_manager,
+                                              NULL,
+                                              NULL));
+    g_test_assert_expected_messages();
+    g_assert_null(loaded_store);
+
+    g_unlink(file_a);
+    g_unlink(db_path);
+    g_rmdir(tmp_dir);
+}
+
+static void
+test_load_reports_corrupted_section(void) {
+    g_autofree char *tmp_dir = g_dir_make_tmp("fsearch-test-database-file-XXXXXX", NULL);
+    g_assert_nonnull(tmp_dir);
+
+    g_autofree char *file_a = g_build_filename(tmp_dir, "a.txt", NULL);
+    write_file(file_a, "aaaa");
+
+    g_autoptr(FsearchDatabaseIncludeManager) include_manager = fsearch_database_include_manager_new();
+    g_autoptr(FsearchDatabaseInclude) include = fsearch_database_include_new(tmp_dir, TRUE, FALSE, FALSE, FALSE, 0);
+    fsearch_database_include_manager_add(include_manager, include);
+    g_autoptr(FsearchDatabaseExcludeManager) exclude_manager = fsearch_database_exclude_manager_new();
+
+    g_autoptr(FsearchDatabaseIndexStore) store = fsearch_database_index_store_new(include_manager,
+                                                                                  exclude_manager,
+                                                                                  DATABASE_INDEX_PROPERTY_FLAG_DEFAULT,
+                                                                                  NULL,
+                                                                                  NULL);
+    fsearch_database_index_store_start(store, NULL);
+
+    g_autofree char *db_path = g_build_filename(tmp_dir, "test.db", NULL);
+    g_assert_true(fsearch_database_file_save_with_compression(store, db_path, DATABASE_FILE_COMPRESSION_NONE));
+
+    // The entry block holds the name "a.txt", flip a byte of it. Only that section must be reported.
+    g_autofree char *contents = NULL;
+    gsize length = 0;
+    g_assert_true(g_file_get_contents(db_path, &contents, &length, NULL));
+    char *name = memmem(contents, length, "a.txt", strlen("a.txt"));
+    g_assert_nonnull(name);
+    name[0] = 'b';
+    g_assert_true(g_file_set_contents(db_path, contents, (gssize)length, NULL));
+
+    g_autoptr(FsearchDatabaseIndexStore) loaded_store = NULL;
+    g_test_expect_message("fsearch-database-file", G_LOG_LEVEL_WARNING, "*entry block corrupted*");
+    g_assert_false(fsearch_database_file_load(db_path,
+                                              NULL,
+                                              &loaded_store,
+                                              include_manager,
+                                              exclude_manager,
+                                              NULL,
+                                              NULL));
+    g_test_assert_expected_messages();
+    g_assert_null(loaded_store);
+
+    g_unlink(file_a);
+    g_unlink(db_path);
+    g_rmdir(tmp_dir);
+}
+
+// The entry block of an uncompressed database file starts at this offset, right after the header
+#define TEST_ENTRY_BLOCK_OFFSET (1 << 16)
+
+// Updates the checksums of the entry block and the header of the uncompressed database file `contents` after the
+// entry block was changed
+static void
+update_entry_block_checksums(char *contents, gsize length) {
+    // The header ends with the size and checksum of every section, followed by the checksum of the header itself
+    gsize header_size = 0;
+    for (gsize offset = 0; offset + sizeof(uint64_t) <= TEST_ENTRY_BLOCK_OFFSET && !header_size; offset++) {
+        uint64_t checksum = 0;
+        memcpy(&checksum, contents + offset, sizeof(checksum));
+        if (checksum != 0 && fsearch_hash_compute(contents, offset, 0) == checksum) {
+            header_size = offset;
+        }
+    }
+    g_assert_cmpuint(header_size, >, 0);
+
+    // The entry block is the first of the three sections
+    char *section_info = contents + header_size - 3 * 2 * sizeof(uint64_t);
+    uint64_t section_size = 0;
+    memcpy(&section_size, section_info, sizeof(section_size));
+    g_assert_cmpuint(TEST_ENTRY_BLOCK_OFFSET + section_size, <=, length);
+    const uint64_t section_checksum = fsearch_hash_compute(contents + TEST_ENTRY_BLOCK_OFFSET, section_size, 0);
+    memcpy(section_info + sizeof(uint64_t), &section_checksum, sizeof(section_checksum));
+
+    const uint64_t header_checksum = fsearch_hash_compute(contents, header_size, 0);
+    memcpy(contents + header_size, &header_checksum, sizeof(header_checksum));
+}
+
+static void
+test_load_rejects_parent_cycle(void) {
+    g_autofree char *tmp_dir = g_dir_make_tmp("fsearch-test-database-file-XXXXXX", NULL);
+    g_assert_nonnull(tmp_dir);
+
+    g_autofree char *subdir = g_build_filename(tmp_dir, "subdir", NULL);
+    g_assert_cmpint(g_mkdir(subdir, 0755), ==, 0);
+
+    g_autoptr(FsearchDatabaseIncludeManager) include_manager = fsearch_database_include_manager_new();
+    g_autoptr(FsearchDatabaseInclude) include = fsearch_database_include_new(tmp_dir, TRUE, FALSE, FALSE, FALSE, 0);
+    fsearch_database_include_manager_add(include_manager, include);
+    g_autoptr(FsearchDatabaseExcludeManager) exclude_manager = fsearch_database_exclude_manager_new();
+
+    g_autoptr(FsearchDatabaseIndexStore) store = fsearch_database_index_store_new(include_manager,
+                                                                                  exclude_manager,
+                                                                                  DATABASE_INDEX_PROPERTY_FLAG_DEFAULT,
+                                                                                  NULL,
+                                                                                  NULL);
+    fsearch_database_index_store_start(store, NULL);
+    g_assert_cmpuint(fsearch_database_index_store_get_num_folders(store), ==, 2);
+
+    g_autofree char *db_path = g_build_filename(tmp_dir, "test.db", NULL);
+    g_assert_true(fsearch_database_file_save_with_compression(store, db_path, DATABASE_FILE_COMPRESSION_NONE));
+
+    // Every entry is stored after its parent, so the include root comes first, followed by "subdir"
+    g_autofree char *contents = NULL;
+    gsize length = 0;
+    g_assert_true(g_file_get_contents(db_path, &contents, &length, NULL));
+    g_assert_cmpuint(length, >, TEST_ENTRY_BLOCK_OFFSET);
+    char *root = contents + TEST_ENTRY_BLOCK_OFFSET;
+    const size_t root_size = db_entry_check_image(root,
+                                                  length - TEST_ENTRY_BLOCK_OFFSET,
+                                                  DATABASE_INDEX_PROPERTY_FLAG_DEFAULT);
+    g_assert_cmpuint(root_size, >, 0);
+    int64_t parent_offset = 0;
+    memcpy(&parent_offset, root, sizeof(parent_offset));
+    g_assert_cmpint(parent_offset, ==, 0);
+    memcpy(&parent_offset, root + root_size, sizeof(parent_offset));
+    g_assert_cmpint(parent_offset, ==, -(int64_t)root_size);
+
+    // A distance of 0 means "no parent", so the shortest cycle makes the root the child of its own subfolder
+    parent_offset = (int64_t)root_size;
+    memcpy(root, &parent_offset, sizeof(parent_offset));
+    update_entry_block_checksums(contents, length);
+    g_assert_true(g_file_set_contents(db_path, contents, (gssize)length, NULL));
+
+    g_autoptr(FsearchDatabaseIndexStore) loaded_store = NULL;
+    g_assert_false(fsearch_database_file_load(db_path,
+                                              NULL,
+                                              &loaded_store,
+                                              include_manager,
+                                              exclude_manager,
+                                              NULL,
+                                              NULL));
+    g_assert_null(loaded_store);
+
+    g_unlink(db_path);
+    g_rmdir(subdir);
+    g_rmdir(tmp_dir);
+}
+
+static void
+test_save_load_roundtrip_with_compression(void) {
+    g_autofree char *tmp_dir = g_dir_make_tmp("fsearch-test-database-file-XXXXXX", NULL);
+    g_assert_nonnull(tmp_dir);
+
+    const uint32_t num_test_files = 100;
+    for (uint32_t i = 0; i < num_test_files; i++) {
+        g_autofree char *name = g_strdup_printf("file_%03u.txt", i);
+        g_autofree char *path = g_build_filename(tmp_dir, name, NULL);
+        write_file(path, name);
+    }
+
+    g_autoptr(FsearchDatabaseIncludeManager) include_manager = fsearch_database_include_manager_new();
+    g_autoptr(FsearchDatabaseInclude) include = fsearch_database_include_new(tmp_dir, TRUE, FALSE, FALSE, FALSE, 0);
+    fsearch_database_include_manager_add(include_manager, include);
+    g_autoptr(FsearchDatabaseExcludeManager) exclude_manager = fsearch_database_exclude_manager_new();
+
+    g_autoptr(FsearchDatabaseIndexStore) store = fsearch_database_index_store_new(include_manager,
+                                                                                  exclude_manager,
+                                                                                  DATABASE_INDEX_PROPERTY_FLAG_DEFAULT,
+                                                                                  NULL,
+                                                                                  NULL);
+    fsearch_database_index_store_start(store, NULL);
+    g_assert_cmpuint(fsearch_database_index_store_get_num_files(store), ==, num_test_files);
+
+    g_autofree char *db_path = g_build_filename(tmp_dir, "test.db", NULL);
+    for (uint32_t c = 0; c < NUM_DATABASE_FILE_COMPRESSIONS; c++) {
+        // That's how the compression is named in the config
+        const char *name = fsearch_database_file_compression_to_string(c);
+        g_assert_cmpint(fsearch_database_file_get_compression_from_string(name), ==, c);
+        if (!fsearch_database_file_compression_is_supported(c)) {
+            continue;
+        }
+        g_assert_true(fsearch_database_file_save_with_compression(store, db_path, c));
+
+        g_autoptr(FsearchDatabaseIndexStore) loaded_store = NULL;
+        g_assert_true(fsearch_database_file_load(db_path,
+                                                 NULL,
+                                                 &loaded_store,
+                                                 include_manager,
+                                                 exclude_manager,
+                                                 NULL,
+                                                 NULL));
+        g_assert_cmpuint(fsearch_database_index_store_get_num_files(loaded_store), ==, num_test_files);
+        g_assert_cmpuint(fsearch_database_index_store_get_num_folders(loaded_store), ==, 1);
+
+        g_autoptr(FsearchDatabaseChunkedArray) files =
+            fsearch_database_index_store_get_files(loaded_store, DATABASE_INDEX_PROPERTY_NAME);
+        for (uint32_t i = 0; i < num_test_files; i++) {
+            g_autofree char *name = g_strdup_printf("file_%03u.txt", i);
+            FsearchDatabaseEntry *entry = fsearch_database_chunked_array_get_entry(files, i);
+            g_assert_cmpstr(db_entry_get_name_raw(entry), ==, name);
+            g_assert_cmpint(db_entry_get_size(entry), ==, strlen(name));
+        }
+        // The deferred indexes are read from the decompressed data
+        g_autoptr(FsearchDatabaseChunkedArray) files_by_path = fsearch_database_index_store_get_files(
+            loaded_store,
+            DATABASE_INDEX_PROPERTY_PATH);
+        g_autoptr(FsearchDatabaseChunkedArray) files_by_mtime = wait_for_files(
+            loaded_store,
+            DATABASE_INDEX_PROPERTY_MODIFICATION_TIME);
+        g_assert_nonnull(files_by_path);
+        g_assert_nonnull(files_by_mtime);
+        g_assert_cmpuint(fsearch_database_chunked_array_get_num_entries(files_by_mtime), ==, num_test_files);
+        g_unlink(db_path);
+    }
+
+    for (uint32_t i = 0; i < num_test_files; i++) {
+        g_autofree char *name = g_strdup_printf("file_%03u.txt", i);
+        g_autofree char *path = g_build_filename(tmp_dir, name, NULL);
+        g_unlink(path);
+    }
+    g_rmdir(tmp_dir);
+}
+
+static void
+test_journal_replay_over_saved_file(void) {
+    g_autofree char *tmp_dir = g_dir_make_tmp("fsearch-test-database-file-XXXXXX", NULL);
+    g_assert_nonnull(tmp_dir);
+
+    g_autofree char *file_a = g_build_filename(tmp_dir, "a.txt", NULL);
+    g_autofree char *file_b = g_build_filename(tmp_dir, "b.txt", NULL);
+    write_file(file_a, "aaaa");
+
+    g_autoptr(FsearchDatabaseIncludeManager) include_manager = fsearch_database_include_manager_new();
+    g_autoptr(FsearchDatabaseInclude) include = fsearch_database_include_new(tmp_dir, TRUE, FALSE, FALSE, FALSE, 0);
+    fsearch_database_include_manager_add(include_manager, include);
+    g_autoptr(FsearchDatabaseExcludeManager) exclude_manager = fsearch_database_exclude_manager_new();
+
+    FsearchDatabaseIndexStore *store = fsearch_database_index_store_new(include_manager,
+                                                                        exclude_manager,
+                                                                        DATABASE_INDEX_PROPERTY_FLAG_NAME
+                                                                            | DATABASE_INDEX_PROPERTY_FLAG_SIZE,
+                                                                        NULL,
+                                                                        NULL);
+    fsearch_database_index_store_start(store, NULL);
+
+    g_autofree char *db_path = g_build_filename(tmp_dir, "test.db", NULL);
+    g_assert_true(fsearch_database_file_save(store, db_path));
+    fsearch_database_index_store_unref(store);
+
+    // Changes after the save: a.txt is deleted, b.txt is created. Records for the same path within one batch are
+    // only written once.
+    g_unlink(file_a);
+    write_file(file_b, "bbbbbbbb");
+
+    g_autofree char *journal_path = fsearch_database_journal_get_path(db_path);
+    FsearchDatabaseJournal *journal = fsearch_database_journal_open(journal_path, true);
+    g_assert_nonnull(journal);
+    fsearch_database_journal_append(journal, file_a);
+    fsearch_database_journal_append(journal, file_a);
+    g_assert_true(fsearch_database_journal_flush(journal));
+    fsearch_database_journal_append(journal, file_b);
+    g_clear_pointer(&journal, fsearch_database_journal_free);
+
+    // A crash while appending leaves a cut off record behind, it must be ignored
+    g_autofree char *contents = NULL;
+    gsize length = 0;
+    g_assert_true(g_file_get_contents(journal_path, &contents, &length, NULL));
+    g_autoptr(GString) torn = g_string_new_len(contents, (gssize)length);
+    const uint32_t torn_len = 64;
+    g_string_append_len(torn, (const char *)&torn_len, sizeof(torn_len));
+    g_string_append(torn, "/tmp/cut");
+    g_assert_true(g_file_set_contents(journal_path, torn->str, (gssize)torn->len, NULL));
+
+    g_autoptr(GPtrArray) paths = fsearch_database_journal_load(journal_path);
+    g_assert_nonnull(paths);
+    g_assert_cmpuint(paths->len, ==, 2);
+    g_assert_cmpstr(g_ptr_array_index(paths, 0), ==, file_a);
+    g_assert_cmpstr(g_ptr_array_index(paths, 1), ==, file_b);
+
+    // Reopening drops the cut off record, so new records stay readable
+    journal = fsearch_database_journal_open(journal_path, false);
+    g_assert_nonnull(journal);
+    fsearch_database_journal_append(journal, file_b);
+    g_clear_pointer(&journal, fsearch_database_journal_free);
+    g_clear_pointer(&paths, g_ptr_array_unref);
+    paths = fsearch_database_journal_load(journal_path);
+    g_assert_nonnull(paths);
+    g_assert_cmpuint(paths->len, ==, 3);
+
+    g_autoptr(FsearchDatabaseIndexStore) loaded_store = NULL;
+    g_assert_true(fsearch_database_file_load(db_path,
+                                             NULL,
+                                             &loaded_store,
+                                             include_manager,
+                                             exclude_manager,
+                                             NULL,
+                                             NULL));
+    g_assert_cmpuint(fsearch_database_index_store_get_num_files(loaded_store), ==, 1);
+
+    {
+        g_autoptr(GMutexLocker) locker = fsearch_database_index_store_get_locker(loaded_store);
+        fsearch_database_index_store_refresh_paths(loaded_store, paths, NULL);
+    }
+
+    g_assert_cmpuint(fsearch_database_index_store_get_num_files(loaded_store), ==, 1);
+    g_autoptr(FsearchDatabaseChunkedArray) files = fsearch_database_index_store_get_files(loaded_store,
+                                                                                         DATABASE_INDEX_PROPERTY_NAME);
+    g_assert_nonnull(files);
+    FsearchDatabaseEntry *entry = fsearch_database_chunked_array_get_entry(files, 0);
+    g_assert_cmpstr(db_entry_get_name_raw(entry), ==, "b.txt");
+    g_assert_cmpint(db_entry_get_size(entry), ==, 8);
+
+    // The entries of the loaded store live in the mapped entry block, which was changed by the refresh. Saving it
+    // again has to write the changed copies.
+    g_assert_true(fsearch_database_file_save(loaded_store, db_path));
+    g_autoptr(FsearchDatabaseIndexStore) reloaded_store = NULL;
+    g_assert_true(fsearch_database_file_load(db_path,
+                                             NULL,
+                                             &reloaded_store,
+                                             include_manager,
+                                             exclude_manager,
+                                             NULL,
+                                             NULL));
+    g_assert_cmpuint(fsearch_database_index_store_get_num_files(reloaded_store), ==, 1);
+    g_autoptr(FsearchDatabaseChunkedArray) reloaded_files =
+        fsearch_database_index_store_get_files(reloaded_store, DATABASE_INDEX_PROPERTY_NAME);
+    g_assert_nonnull(reloaded_files);
+    FsearchDatabaseEntry *reloaded_entry = fsearch_database_chunked_array_get_entry(reloaded_files, 0);
+    g_assert_cmpstr(db_entry_get_name_raw(reloaded_entry), ==, "b.txt");
+    g_assert_cmpint(db_entry_get_size(reloaded_entry), ==, 8);
+    FsearchDatabaseEntry *root = db_entry_get_parent(reloaded_entry);
+    g_assert_nonnull(root);
+    g_assert_cmpuint(db_entry_folder_get_num_files(root), ==, 1);
+
+    g_unlink(file_b);
+    g_unlink(journal_path);
+    g_unlink(db_path);
+    g_rmdir(tmp_dir);
+}
+
+static void
+test_snapshot_save_after_store_changed(void) {
+    g_autofree char *tmp_dir = g_dir_make_tmp("fsearch-test-database-file-XXXXXX", NULL);
+    g_assert_nonnull(tmp_dir);
+
+    g_autofree char *file_a = g_build_filename(tmp_dir, "a.txt", NULL);
+    write_file(file_a, "aaaa");
+
+    g_autoptr(FsearchDatabaseIncludeManager) include_manager = fsearch_database_include_manager_new();
+    g_autoptr(FsearchDatabaseInclude) include = fsearch_database_include_new(tmp_dir, TRUE, FALSE, FALSE, FALSE, 0);
+    fsearch_database_include_manager_add(include_manager, include);
+    g_autoptr(FsearchDatabaseExcludeManager) exclude_manager = fsearch_database_exclude_manager_new();
+
+    g_autoptr(FsearchDatabaseIndexStore) store = fsearch_database_index_store_new(include_manager,
+                                                                                  exclude_manager,
+                                                                                  DATABASE_INDEX_PROPERTY_FLAG_DEFAULT,
+                                                                                  NULL,
+                                                                                  NULL);
+    fsearch_database_index_store_start(store, NULL);
+
+    g_autoptr(FsearchDatabaseFileSnapshot) snapshot = NULL;
+    {
+        g_autoptr(GMutexLocker) locker = fsearch_database_index_store_get_locker(store);
+        snapshot = fsearch_database_file_snapshot_new(store);
+    }
+    g_assert_nonnull(snapshot);
+
+    // The entry of a.txt is freed before the snapshot gets written, which must not affect it
+    g_unlink(file_a);
+    {
+        g_autoptr(GMutexLocker) locker = fsearch_database_index_store_get_locker(store);
+        g_autoptr(GPtrArray) paths = g_ptr_array_new_with_free_func(g_free);
+        g_ptr_array_add(paths, g_strdup(file_a));
+        fsearch_database_index_store_refresh_paths(store, paths, NULL);
+    }
+    g_assert_cmpuint(fsearch_database_index_store_get_num_files(store), ==, 0);
+
+    g_autofree char *db_path = g_build_filename(tmp_dir, "test.db", NULL);
+    g_assert_true(fsearch_database_file_snapshot_save(snapshot, db_path, DATABASE_FILE_COMPRESSION_NONE));
+
+    g_autoptr(FsearchDatabaseIndexStore) loaded_store = NULL;
+    g_assert_true(fsearch_database_file_load(db_path,
+                                             NULL,
+                                             &loaded_store,
+                                             include_manager,
+                                             exclude_manager,
+                                             NULL,
+                                             NULL));
+    g_assert_cmpuint(fsearch_database_index_store_get_num_files(loaded_store), ==, 1);
+    g_autoptr(FsearchDatabaseChunkedArray) files = fsearch_database_index_store_get_files(loaded_store,
+                                                                                         DATABASE_INDEX_PROPERTY_NAME);
+    g_assert_nonnull(files);
+    FsearchDatabaseEntry *entry = fsearch_database_chunked_array_get_entry(files, 0);
+    g_assert_cmpstr(db_entry_get_name_raw(entry), ==, "a.txt");
+    g_assert_cmpint(db_entry_get_size(entry), ==, 4);
+
+    g_unlink(db_path);
+    g_rmdir(tmp_dir);
+}
+
+static FsearchDatabaseIndex *
+get_index(FsearchDatabaseIndexStore *store, const char *path) {
+    g_autoptr(GMutexLocker) locker = fsearch_database_index_store_get_locker(store);
+    g_autoptr(GPtrArray) indices = fsearch_database_index_store_get_indices(store);
+    for (uint32_t i = 0; i < indices->len; i++) {
+        FsearchDatabaseIndex *index = g_ptr_array_index(indices, i);
+        if (g_strcmp0(fsearch_database_index_get_path(index), path) == 0) {
+            return fsearch_database_index_ref(index);
+        }
+    }
+    g_assert_not_reached();
+    return NULL;
+}
+
+static bool
+index_is_unscanned(FsearchDatabaseIndexStore *store, const char *path) {
+    g_autoptr(FsearchDatabaseIndex) index = get_index(store, path);
+    return fsearch_database_index_is_unscanned(index);
+}
+
+static bool
+index_wants_root_reappear_poll(FsearchDatabaseIndexStore *store, const char *path) {
+    g_autoptr(FsearchDatabaseIndex) index = get_index(store, path);
+    return fsearch_database_index_wants_root_reappear_poll(index);
+}
+
+static bool
+index_is_dirty(FsearchDatabaseIndexStore *store, const char *path) {
+    g_autoptr(FsearchDatabaseIndex) index = get_index(store, path);
+    return fsearch_database_index_is_dirty(index);
+}
+
+static void
+save_shards(FsearchDatabaseIndexStore *store, const char *db_path) {
+    g_autoptr(FsearchDatabaseFileShardsSnapshot) snapshot = NULL;
+    {
+        g_autoptr(GMutexLocker) locker = fsearch_database_index_store_get_locker(store);
+        snapshot = fsearch_database_file_shards_snapshot_new(store, db_path);
+    }
+    g_assert_nonnull(snapshot);
+    g_assert_true(fsearch_database_file_shards_snapshot_save(snapshot, db_path, DATABASE_FILE_COMPRESSION_NONE));
+}
+
+// Returns the inode of every shard file by name, a shard which got written again has a new one
+static GHashTable *
+get_shard_inodes(const char *shards_dir) {
+    GHashTable *inodes = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    g_autoptr(GDir) dir = g_dir_open(shards_dir, 0, NULL);
+    g_assert_nonnull(dir);
+    const char *name = NULL;
+    while ((name = g_dir_read_name(dir))) {
+        g_autofree char *path = g_build_filename(shards_dir, name, NULL);
+        GStatBuf st = {};
+        g_assert_cmpint(g_stat(path, &st), ==, 0);
+        g_hash_table_insert(inodes, g_strdup(name), GSIZE_TO_POINTER(st.st_ino));
+    }
+    return inodes;
+}
+
+static uint32_t
+count_changed_shards(GHashTable *before, GHashTable *after) {
+    g_assert_cmpuint(g_hash_table_size(before), ==, g_hash_table_size(after));
+    uint32_t num_changed = 0;
+    GHashTableIter iter;
+    gpointer name = NULL;
+    gpointer inode = NULL;
+    g_hash_table_iter_init(&iter, before);
+    while (g_hash_table_iter_next(&iter, &name, &inode)) {
+        g_assert_true(g_hash_table_contains(after, name));
+        if (g_hash_table_lookup(after, name) != inode) {
+            num_changed++;
+        }
+    }
+    return num_changed;
+}
+
+static void
+test_shards_save_changed_indices_and_keep_offline_ones(void) {
+    g_autofree char *tmp_dir = g_dir_make_tmp("fsearch-test-database-file-XXXXXX", NULL);
+    g_assert_nonnull(tmp_dir);
+
+    g_autofree char *dir_a = g_build_filename(tmp_dir, "a", NULL);
+    g_autofree char *dir_b = g_build_filename(tmp_dir, "b", NULL);
+    g_autofree char *dir_a_moved = g_build_filename(tmp_dir, "a-moved", NULL);
+    g_assert_cmpint(g_mkdir(dir_a, 0755), ==, 0);
+    g_assert_cmpint(g_mkdir(dir_b, 0755), ==, 0);
+    g_autofree char *file_a = g_build_filename(dir_a, "a.txt", NULL);
+    g_autofree char *file_b = g_build_filename(dir_b, "b.txt", NULL);
+    g_autofree char *file_c = g_build_filename(dir_b, "c.txt", NULL);
+    write_file(file_a, "aaaa");
+    write_file(file_b, "bb");
+    write_file(file_c, "c");
+
+    g_autoptr(FsearchDatabaseIncludeManager) include_manager = fsearch_database_include_manager_new();
+    g_autoptr(FsearchDatabaseInclude) include_a = fsearch_database_include_new(dir_a, TRUE, FALSE, FALSE, FALSE, 0);
+    g_autoptr(FsearchDatabaseInclude) include_b = fsearch_database_include_new(dir_b, TRUE, FALSE, FALSE, FALSE, 0);
+    fsearch_database_include_manager_add(include_manager, include_a);
+    fsearch_database_include_manager_add(include_manager, include_b);
+    g_autoptr(FsearchDatabaseExcludeManager) exclude_manager = fsearch_database_exclude_manager_new();
+
+    g_autoptr(FsearchDatabaseIndexStore) store = fsearch_database_index_store_new(include_manager,
+                                                                                  exclude_manager,
+                                                                                  DATABASE_INDEX_PROPERTY_FLAG_DEFAULT,
+                                                                                  NULL,
+                                                                                  NULL);
+    fsearch_database_index_store_start(store, NULL);
+    g_assert_cmpuint(fsearch_database_index_store_get_num_files(store), ==, 3);
+
+    g_autofree char *db_path = g_build_filename(tmp_dir, "test.db", NULL);
+    g_autofree char *shards_dir = g_strconcat(db_path, ".shards", NULL);
+    save_shards(store, db_path);
+    g_autoptr(GHashTable) inodes_first_save = get_shard_inodes(shards_dir);
+    g_assert_cmpuint(g_hash_table_size(inodes_first_save), ==, 2);
+
+    // Only the shard of the include which changed is written again
+    write_file(file_b, "bbbbbbbb");
+    {
+        g_autoptr(GMutexLocker) locker = fsearch_database_index_store_get_locker(store);
+        g_autoptr(GPtrArray) paths = g_ptr_array_new_with_free_func(g_free);
+        g_ptr_array_add(paths, g_strdup(file_b));
+        fsearch_database_index_store_refresh_paths(store, paths, NULL);
+    }
+    save_shards(store, db_path);
+    g_autoptr(GHashTable) inodes_second_save = get_shard_inodes(shards_dir);
+    g_assert_cmpuint(count_changed_shards(inodes_first_save, inodes_second_save), ==, 1);
+
+    // Both shards are merged into one store, sorted like a scanned one
+    g_autoptr(FsearchDatabaseIndexStore) loaded_store = NULL;
+    g_assert_true(fsearch_database_file_shards_load(db_path,
+                                                    NULL,
+                                                    &loaded_store,
+                                                    include_manager,
+                                                    exclude_manager,
+                                                    NULL,
+                                                    NULL));
+    g_assert_cmpuint(fsearch_database_index_store_get_num_files(loaded_store), ==, 3);
+    g_assert_cmpuint(fsearch_database_index_store_get_num_folders(loaded_store), ==, 2);
+    g_autoptr(FsearchDatabaseChunkedArray) files = fsearch_database_index_store_get_files(loaded_store,
+                                                                                         DATABASE_INDEX_PROPERTY_NAME);
+    g_assert_nonnull(files);
+    const char *expected_names[] = {"a.txt", "b.txt", "c.txt"};
+    for (uint32_t i = 0; i < G_N_ELEMENTS(expected_names); i++) {
+        FsearchDatabaseEntry *entry = fsearch_database_chunked_array_get_entry(files, i);
+        g_assert_cmpstr(db_entry_get_name_raw(entry), ==, expected_names[i]);
+    }
+    g_autoptr(FsearchDatabaseChunkedArray) files_by_size = wait_for_files(loaded_store, DATABASE_INDEX_PROPERTY_SIZE);
+    g_assert_nonnull(files_by_size);
+    g_assert_cmpint(db_entry_get_size(fsearch_database_chunked_array_get_entry(files_by_size, 0)), ==, 1);
+    g_assert_cmpint(db_entry_get_size(fsearch_database_chunked_array_get_entry(files_by_size, 2)), ==, 8);
+
+    // Saving the loaded store doesn't write any shard, since none of them changed
+    save_shards(loaded_store, db_path);
+    g_autoptr(GHashTable) inodes_third_save = get_shard_inodes(shards_dir);
+    g_assert_cmpuint(count_changed_shards(inodes_second_save, inodes_third_save), ==, 0);
+    g_clear_pointer(&loaded_store, fsearch_database_index_store_unref);
+
+    // The shard of an include whose root is gone is loaded, so its entries stay searchable, and kept as it is until
+    // the root reappears
+    g_assert_cmpint(g_rename(dir_a, dir_a_moved), ==, 0);
+    g_assert_true(fsearch_database_file_shards_load(db_path,
+                                                    NULL,
+                                                    &loaded_store,
+                                                    include_manager,
+                                                    exclude_manager,
+                                                    NULL,
+                                                    NULL));
+    g_assert_cmpuint(fsearch_database_index_store_get_num_files(loaded_store), ==, 3);
+    g_assert_true(index_wants_root_reappear_poll(loaded_store, dir_a));
+    save_shards(loaded_store, db_path);
+    g_autoptr(GHashTable) inodes_offline_save = get_shard_inodes(shards_dir);
+    g_assert_cmpuint(count_changed_shards(inodes_second_save, inodes_offline_save), ==, 0);
+
+    // Once the root is back, its index is scanned again and the loaded entries are replaced
+    g_autofree char *file_d_moved = g_build_filename(dir_a_moved, "d.txt", NULL);
+    g_autofree char *file_d = g_build_filename(dir_a, "d.txt", NULL);
+    write_file(file_d_moved, "dd");
+    g_assert_cmpint(g_rename(dir_a_moved, dir_a), ==, 0);
+    const gint64 poll_end_time = g_get_monotonic_time() + 20 * G_USEC_PER_SEC;
+    while (index_wants_root_reappear_poll(loaded_store, dir_a) && g_get_monotonic_time() < poll_end_time) {
+        g_usleep(G_USEC_PER_SEC / 10);
+    }
+    g_assert_false(index_wants_root_reappear_poll(loaded_store, dir_a));
+    {
+        g_autoptr(GMutexLocker) locker = fsearch_database_index_store_get_locker(loaded_store);
+        g_assert_cmpuint(fsearch_database_index_store_get_num_files(loaded_store), ==, 4);
+        g_assert_cmpuint(fsearch_database_index_store_get_num_folders(loaded_store), ==, 2);
+    }
+    g_clear_pointer(&loaded_store, fsearch_database_index_store_unref);
+    g_unlink(file_d);
+
+    // Without their shards the includes start out empty, so they can be scanned on their own
+    GHashTableIter iter;
+    gpointer name = NULL;
+    g_hash_table_iter_init(&iter, inodes_offline_save);
+    while (g_hash_table_iter_next(&iter, &name, NULL)) {
+        g_autofree char *path = g_build_filename(shards_dir, name, NULL);
+        g_unlink(path);
+    }
+    g_assert_true(fsearch_database_file_shards_load(db_path,
+                                                    NULL,
+                                                    &loaded_store,
+                                                    include_manager,
+                                                    exclude_manager,
+                                                    NULL,
+                                                    NULL));
+    g_assert_cmpuint(fsearch_database_index_store_get_num_files(loaded_store), ==, 0);
+    g_assert_true(index_is_unscanned(loaded_store, dir_a));
+    g_assert_true(index_is_unscanned(loaded_store, dir_b));
+    g_clear_pointer(&loaded_store, fsearch_database_index_store_unref);
+
+    g_unlink(file_a);
+    g_unlink(file_b);
+    g_unlink(file_c);
+    g_rmdir(dir_a);
+    g_rmdir(dir_b);
+    g_rmdir(shards_dir);
+    g_unlink(db_path);
+    g_rmdir(tmp_dir);
+}
+
+static void
+test_shards_load_with_changed_config(void) {
+    g_autofree char *tmp_dir = g_dir_make_tmp("fsearch-test-database-file-XXXXXX", NULL);
+    g_assert_nonnull(tmp_dir);
+
+    g_autofree char *dir_a = g_build_filename(tmp_dir, "a", NULL);
+    g_autofree char *dir_sub = g_build_filename(dir_a, "sub", NULL);
+    g_autofree char *dir_b = g_build_filename(tmp_dir, "b", NULL);
+    g_assert_cmpint(g_mkdir(dir_a, 0755), ==, 0);
+    g_assert_cmpint(g_mkdir(dir_sub, 0755), ==, 0);
+    g_assert_cmpint(g_mkdir(dir_b, 0755), ==, 0);
+    g_autofree char *file_txt = g_build_filename(dir_a, "a.txt", NULL);
+    g_autofree char *file_log = g_build_filename(dir_a, "a.log", NULL);
+    g_autofree char *file_sub = g_build_filename(dir_sub, "s.txt", NULL);
+    g_autofree char *file_b = g_build_filename(dir_b, "b.txt", NULL);
+    write_file(file_txt, "aaaa");
+    write_file(file_log, "log");
+    write_file(file_sub, "ss");
+    write_file(file_b, "b");
+
+    g_autoptr(FsearchDatabaseIncludeManager) include_manager = fsearch_database_include_manager_new();
+    g_autoptr(FsearchDatabaseInclude) include_a = fsearch_database_include_new(dir_a, TRUE, FALSE, FALSE, FALSE, 0);
+    fsearch_database_include_manager_add(include_manager, include_a);
+    g_autoptr(FsearchDatabaseExcludeManager) exclude_manager = fsearch_database_exclude_manager_new();
+
+    g_autoptr(FsearchDatabaseIndexStore) store = fsearch_database_index_store_new(include_manager,
+                                                                                  exclude_manager,
+                                                                                  DATABASE_INDEX_PROPERTY_FLAG_DEFAULT,
+                                                                                  NULL,
+                                                                                  NULL);
+    fsearch_database_index_store_start(store, NULL);
+    g_assert_cmpuint(fsearch_database_index_store_get_num_files(store), ==, 3);
+
+    g_autofree char *db_path = g_build_filename(tmp_dir, "test.db", NULL);
+    g_autofree char *shards_dir = g_strconcat(db_path, ".shards", NULL);
+    save_shards(store, db_path);
+
+    // One include and two excludes are added to the config
+    g_autoptr(FsearchDatabaseIncludeManager) new_include_manager = fsearch_database_include_manager_copy(
+        include_manager);
+    g_autoptr(FsearchDatabaseInclude) include_b = fsearch_database_include_new(dir_b, TRUE, FALSE, FALSE, FALSE, 0);
+    fsearch_database_include_manager_add(new_include_manager, include_b);
+    g_autoptr(FsearchDatabaseExcludeManager) new_exclude_manager = fsearch_database_exclude_manager_new();
+    g_autoptr(FsearchDatabaseExclude) exclude_log = fsearch_database_exclude_new(
+        "*.log",
+        TRUE,
+        FSEARCH_DATABASE_EXCLUDE_TYPE_WILDCARD,
+        FSEARCH_DATABASE_EXCLUDE_MATCH_SCOPE_BASENAME,
+        FSEARCH_DATABASE_EXCLUDE_TARGET_FILES);
+    g_autoptr(FsearchDatabaseExclude) exclude_sub = fsearch_database_exclude_new(
+        dir_sub,
+        TRUE,
+        FSEARCH_DATABASE_EXCLUDE_TYPE_FIXED,
+        FSEARCH_DATABASE_EXCLUDE_MATCH_SCOPE_FULL_PATH,
+        FSEARCH_DATABASE_EXCLUDE_TARGET_FOLDERS);
+    fsearch_database_exclude_manager_add(new_exclude_manager, exclude_log);
+    fsearch_database_exclude_manager_add(new_exclude_manager, exclude_sub);
+
+    // The index of the existing include is kept without the newly excluded entries, the new include is left for a scan
+    g_autoptr(FsearchDatabaseIndexStore) loaded_store = NULL;
+    g_assert_true(fsearch_database_file_shards_load(db_path,
+                                                    NULL,
+                                                    &loaded_store,
+                                                    new_include_manager,
+                                                    new_exclude_manager,
+                                                    NULL,
+                                                    NULL));
+    g_assert_cmpuint(fsearch_database_index_store_get_num_files(loaded_store), ==, 1);
+    g_assert_cmpuint(fsearch_database_index_store_get_num_folders(loaded_store), ==, 1);
+    g_autoptr(FsearchDatabaseChunkedArray) folders = fsearch_database_index_store_get_folders(
+        loaded_store,
+        DATABASE_INDEX_PROPERTY_NAME);
+    g_assert_nonnull(folders);
+    FsearchDatabaseEntry *root = fsearch_database_chunked_array_get_entry(folders, 0);
+    g_assert_cmpuint(db_entry_folder_get_num_files(root), ==, 1);
+    g_assert_cmpuint(db_entry_folder_get_num_folders(root), ==, 0);
+    g_assert_cmpint(db_entry_get_size(root), ==, 4);
+    g_assert_false(index_is_unscanned(loaded_store, dir_a));
+    g_assert_true(index_is_dirty(loaded_store, dir_a));
+    g_assert_true(index_is_unscanned(loaded_store, dir_b));
+
+    // The pruned shard is written with the new excludes, the unscanned include doesn't get one
+    save_shards(loaded_store, db_path);
+    g_autoptr(GHashTable) inodes = get_shard_inodes(shards_dir);
+    g_assert_cmpuint(g_hash_table_size(inodes), ==, 1);
+    g_clear_pointer(&folders, fsearch_database_chunked_array_unref);
+    g_clear_pointer(&loaded_store, fsearch_database_index_store_unref);
+
+    g_assert_true(fsearch_database_file_shards_load(db_path,
+                                                    NULL,
+                                                    &loaded_store,
+                                                    new_include_manager,
+                                                    new_exclude_manager,
+                                                    NULL,
+                                                    NULL));
+    g_assert_cmpuint(fsearch_database_index_store_get_num_files(loaded_store), ==, 1);
+    g_assert_false(index_is_dirty(loaded_store, dir_a));
+    g_assert_true(index_is_unscanned(loaded_store, dir_b));
+    g_clear_pointer(&loaded_store, fsearch_database_index_store_unref);
+
+    // Entries of an exclude which was removed again are missing in the shard, so the include has to be scanned
+    fsearch_database_exclude_manager_remove(new_exclude_manager, exclude_log);
+    g_assert_true(fsearch_database_file_shards_load(db_path,
+                                                    NULL,
+                                                    &loaded_store,
+                                                    new_include_manager,
+                                                    new_exclude_manager,
+                                                    NULL,
+                                                    NULL));
+    g_assert_cmpuint(fsearch_database_index_store_get_num_files(loaded_store), ==, 0);
+    g_assert_true(index_is_unscanned(loaded_store, dir_a));
+    g_clear_pointer(&loaded_store, fsearch_database_index_store_unref);
+
+    g_clear_pointer(&inodes, g_hash_table_unref);
+    inodes = get_shard_inodes(shards_dir);
+    GHashTableIter iter;
+    gpointer name = NULL;
+    g_hash_table_iter_init(&iter, inodes);
+    while (g_hash_table_iter_next(&iter, &name, NULL)) {
+        g_autofree char *path = g_build_filename(shards_dir, name, NULL);
+        g_unlink(path);
+    }
+    g_unlink(file_txt);
+    g_unlink(file_log);
+    g_unlink(file_sub);
+    g_unlink(file_b);
+    g_rmdir(dir_sub);
+    g_rmdir(dir_a);
+    g_rmdir(dir_b);
+    g_rmdir(shards_dir);
+    g_unlink(db_path);
+    g_rmdir(tmp_dir);
+}
+
 int
 main(int argc, char **argv) {
     g_test_init(&argc, &argv, NULL);
 
     g_test_add_func("/FSearch/database/file/save_load_roundtrip_preserves_hierarchy_and_sort_orders",
                     test_save_load_roundtrip_preserves_hierarchy_and_sort_orders);
+    g_test_add_func("/FSearch/database/file/load_rejects_truncated_file", test_load_rejects_truncated_file);
+    g_test_add_func("/FSearch/database/file/load_reports_corrupted_section", test_load_reports_corrupted_section);
+    g_test_add_func("/FSearch/database/file/load_rejects_parent_cycle", test_load_rejects_parent_cycle);
+    g_test_add_func("/FSearch/database/file/save_load_roundtrip_with_compression",
+                    test_save_load_roundtrip_with_compression);
+    g_test_add_func("/FSearch/database/file/journal_replay_over_saved_file", test_journal_replay_over_saved_file);
+    g_test_add_func("/FSearch/database/file/snapshot_save_after_store_changed",
+                    test_snapshot_save_after_store_changed);
+    g_test_add_func("/FSearch/database/file/shards_save_changed_indices_and_keep_offline_ones",
+                    test_shards_save_changed_indices_and_keep_offline_ones);
+    g_test_add_func("/FSearch/database/file/shards_load_with_changed_config", test_shards_load_with_changed_config);
 
     return g_test_run();
 }
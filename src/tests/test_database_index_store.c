@@ -32,6 +32,7 @@
 
 #include <gio/gio.h>
 #include <glib.h>
+#include <glib/gstdio.h>
 
 static DynamicArray *
 make_named_files(const char *prefix, uint32_t count) {
@@ -79,6 +80,7 @@ test_cancelled_search_keeps_partial_results_marked_incomplete(void) {
         include_manager,
         exclude_manager,
         DATABASE_INDEX_PROPERTY_FLAG_NAME,
+        DATABASE_INDEX_PROPERTY_FLAG_NONE,
         NULL,
         NULL);
 
@@ -131,12 +133,566 @@ test_cancelled_search_keeps_partial_results_marked_incomplete(void) {
     fsearch_filter_manager_unref(filters);
 }
 
+static void
+test_search_without_sort_index_sorts_manually(void) {
+    g_autoptr(FsearchDatabaseIncludeManager) include_manager = fsearch_database_include_manager_new();
+    g_autoptr(FsearchDatabaseExcludeManager) exclude_manager = fsearch_database_exclude_manager_new();
+    FsearchFilterManager *filters = fsearch_filter_manager_new_with_defaults();
+
+    // Sizes are in reverse name order, so the results are only in size order if they got sorted after the search
+    const uint32_t num_files = 100;
+    DynamicArray *files = darray_new(num_files);
+    for (uint32_t i = 0; i < num_files; i++) {
+        g_autofree char *name = g_strdup_printf("apple_%06u", i);
+        FsearchDatabaseEntry *entry = db_entry_new(DATABASE_INDEX_PROPERTY_FLAG_SIZE,
+                                                   name,
+                                                   NULL,
+                                                   DATABASE_ENTRY_TYPE_FILE);
+        db_entry_set_size(entry, num_files - i);
+        darray_add_item(files, entry);
+    }
+    g_autoptr(DynamicArray) folders = darray_new(0);
+
+    // Only the name index is available, as in lazy mode before the size index got built
+    DynamicArray *files_by_property[NUM_DATABASE_INDEX_PROPERTIES] = {0};
+    DynamicArray *folders_by_property[NUM_DATABASE_INDEX_PROPERTIES] = {0};
+    files_by_property[DATABASE_INDEX_PROPERTY_NAME] = files;
+    folders_by_property[DATABASE_INDEX_PROPERTY_NAME] = folders;
+
+    g_autoptr(GPtrArray) indices = g_ptr_array_new();
+    g_autoptr(FsearchDatabaseIndexStore) store = fsearch_database_index_store_new_with_content(
+        indices,
+        files_by_property,
+        folders_by_property,
+        include_manager,
+        exclude_manager,
+        DATABASE_INDEX_PROPERTY_FLAG_NAME | DATABASE_INDEX_PROPERTY_FLAG_SIZE,
+        DATABASE_INDEX_PROPERTY_FLAG_NONE,
+        NULL,
+        NULL);
+
+    const uint32_t view_id = 1;
+    g_autoptr(FsearchQuery) query = make_query(filters, "apple");
+    g_assert_true(fsearch_database_index_store_search(store,
+                                                      view_id,
+                                                      query,
+                                                      DATABASE_INDEX_PROPERTY_SIZE,
+                                                      GTK_SORT_ASCENDING,
+                                                      NULL));
+
+    FsearchDatabaseSearchView *view = fsearch_database_index_store_get_search_view(store, view_id);
+    g_assert_nonnull(view);
+    for (uint32_t i = 0; i < num_files; i++) {
+        FsearchDatabaseEntry *entry = fsearch_database_search_view_get_entry_for_idx(view, i);
+        g_assert_nonnull(entry);
+        g_assert_cmpint(db_entry_get_size(entry), ==, i + 1);
+    }
+
+    free_entries(files);
+    fsearch_filter_manager_unref(filters);
+}
+
+static void
+test_drop_sort_index(void) {
+    g_autoptr(FsearchDatabaseIncludeManager) include_manager = fsearch_database_include_manager_new();
+    g_autoptr(FsearchDatabaseExcludeManager) exclude_manager = fsearch_database_exclude_manager_new();
+
+    DynamicArray *files = make_named_files("apple", 10);
+    g_autoptr(DynamicArray) folders = darray_new(0);
+
+    DynamicArray *files_by_property[NUM_DATABASE_INDEX_PROPERTIES] = {0};
+    DynamicArray *folders_by_property[NUM_DATABASE_INDEX_PROPERTIES] = {0};
+    files_by_property[DATABASE_INDEX_PROPERTY_NAME] = files;
+    folders_by_property[DATABASE_INDEX_PROPERTY_NAME] = folders;
+    // All entries have the same (unset) size, so the name order is a valid size order as well
+    files_by_property[DATABASE_INDEX_PROPERTY_SIZE] = files;
+    folders_by_property[DATABASE_INDEX_PROPERTY_SIZE] = folders;
+
+    g_autoptr(GPtrArray) indices = g_ptr_array_new();
+    g_autoptr(FsearchDatabaseIndexStore) store = fsearch_database_index_store_new_with_content(
+        indices,
+        files_by_property,
+        folders_by_property,
+        include_manager,
+        exclude_manager,
+        DATABASE_INDEX_PROPERTY_FLAG_NAME,
+        DATABASE_INDEX_PROPERTY_FLAG_NONE,
+        NULL,
+        NULL);
+
+    g_autoptr(GMutexLocker) locker = fsearch_database_index_store_get_locker(store);
+    g_assert_cmpuint(fsearch_database_index_store_get_num_fast_sort_indices(store), ==, 2);
+
+    fsearch_database_index_store_drop_sort_index(store, DATABASE_INDEX_PROPERTY_SIZE);
+    g_assert_cmpuint(fsearch_database_index_store_get_num_fast_sort_indices(store), ==, 1);
+    g_assert_null(fsearch_database_index_store_get_files(store, DATABASE_INDEX_PROPERTY_SIZE));
+
+    // The name index can't be dropped
+    fsearch_database_index_store_drop_sort_index(store, DATABASE_INDEX_PROPERTY_NAME);
+    g_autoptr(FsearchDatabaseChunkedArray) name_files = fsearch_database_index_store_get_files(
+        store,
+        DATABASE_INDEX_PROPERTY_NAME);
+    g_assert_nonnull(name_files);
+
+    g_clear_pointer(&locker, g_mutex_locker_free);
+    free_entries(files);
+}
+
+static void
+test_add_deferred_sort_index(void) {
+    g_autoptr(FsearchDatabaseIncludeManager) include_manager = fsearch_database_include_manager_new();
+    g_autoptr(FsearchDatabaseExcludeManager) exclude_manager = fsearch_database_exclude_manager_new();
+
+    DynamicArray *files = make_named_files("apple", 10);
+    g_autoptr(DynamicArray) folders = darray_new(0);
+
+    DynamicArray *files_by_property[NUM_DATABASE_INDEX_PROPERTIES] = {0};
+    DynamicArray *folders_by_property[NUM_DATABASE_INDEX_PROPERTIES] = {0};
+    files_by_property[DATABASE_INDEX_PROPERTY_NAME] = files;
+    folders_by_property[DATABASE_INDEX_PROPERTY_NAME] = folders;
+
+    // The size and modification time indices are still being loaded, as after opening a database file
+    g_autoptr(GPtrArray) indices = g_ptr_array_new();
+    g_autoptr(FsearchDatabaseIndexStore) store = fsearch_database_index_store_new_with_content(
+        indices,
+        files_by_property,
+        folders_by_property,
+        include_manager,
+        exclude_manager,
+        DATABASE_INDEX_PROPERTY_FLAG_NAME,
+        DATABASE_INDEX_PROPERTY_FLAG_SIZE | DATABASE_INDEX_PROPERTY_FLAG_MODIFICATION_TIME,
+        NULL,
+        NULL);
+
+    g_autoptr(GMutexLocker) locker = fsearch_database_index_store_get_locker(store);
+    g_assert_cmpint(fsearch_database_index_store_get_next_deferred_sort_index(store),
+                    ==,
+                    DATABASE_INDEX_PROPERTY_SIZE);
+
+    // Requesting an index which isn't loaded yet moves it to the front
+    g_assert_null(fsearch_database_index_store_get_files(store, DATABASE_INDEX_PROPERTY_MODIFICATION_TIME));
+    g_assert_cmpint(fsearch_database_index_store_get_next_deferred_sort_index(store),
+                    ==,
+                    DATABASE_INDEX_PROPERTY_MODIFICATION_TIME);
+
+    // All entries have the same (unset) modification time, so the name order is valid for it as well
+    g_assert_true(fsearch_database_index_store_add_sort_index(store,
+                                                              DATABASE_INDEX_PROPERTY_MODIFICATION_TIME,
+                                                              files,
+                                                              folders));
+    g_autoptr(FsearchDatabaseChunkedArray) mtime_files = fsearch_database_index_store_get_files(
+        store,
+        DATABASE_INDEX_PROPERTY_MODIFICATION_TIME);
+    g_assert_nonnull(mtime_files);
+    g_assert_cmpuint(fsearch_database_chunked_array_get_num_entries(mtime_files), ==, 10);
+
+    // When loading an index failed, the store builds it itself instead
+    g_assert_cmpint(fsearch_database_index_store_get_next_deferred_sort_index(store),
+                    ==,
+                    DATABASE_INDEX_PROPERTY_SIZE);
+    g_assert_false(fsearch_database_index_store_add_sort_index(store, DATABASE_INDEX_PROPERTY_SIZE, NULL, NULL));
+    g_assert_cmpint(fsearch_database_index_store_get_next_deferred_sort_index(store),
+                    ==,
+                    DATABASE_INDEX_PROPERTY_NONE);
+
+    g_clear_pointer(&locker, g_mutex_locker_free);
+    g_clear_pointer(&store, fsearch_database_index_store_unref);
+    free_entries(files);
+}
+
+static bool
+is_removed_entry(void *entry, void *data) {
+    return g_hash_table_contains(data, entry);
+}
+
+static void
+test_deferred_sort_index_gets_changes_made_while_loading(void) {
+    g_autofree char *tmp_dir = g_dir_make_tmp("fsearch-test-index-store-XXXXXX", NULL);
+    g_assert_nonnull(tmp_dir);
+
+    const uint32_t num_files = 20;
+    g_autoptr(GPtrArray) paths = g_ptr_array_new_with_free_func(g_free);
+    for (uint32_t i = 0; i < num_files; i++) {
+        g_autofree char *name = g_strdup_printf("file_%02u.txt", i);
+        char *path = g_build_filename(tmp_dir, name, NULL);
+        g_autofree char *content = g_strnfill(i + 1, 'x');
+        g_assert_true(g_file_set_contents(path, content, -1, NULL));
+        g_ptr_array_add(paths, path);
+    }
+
+    g_autoptr(FsearchDatabaseIncludeManager) include_manager = fsearch_database_include_manager_new();
+    g_autoptr(FsearchDatabaseInclude) include = fsearch_database_include_new(tmp_dir, TRUE, FALSE, FALSE, FALSE, 0);
+    fsearch_database_include_manager_add(include_manager, include);
+    g_autoptr(FsearchDatabaseExcludeManager) exclude_manager = fsearch_database_exclude_manager_new();
+
+    // Scan the folder and take the sorted arrays from it, like they're loaded from a database file
+    g_autoptr(FsearchDatabaseIndexStore) scanned_store = fsearch_database_index_store_new(
+        include_manager,
+        exclude_manager,
+        DATABASE_INDEX_PROPERTY_FLAG_DEFAULT,
+        NULL,
+        NULL);
+    fsearch_database_index_store_start(scanned_store, NULL);
+    g_autoptr(GPtrArray) indices = NULL;
+    DynamicArray *files_by_property[NUM_DATABASE_INDEX_PROPERTIES] = {0};
+    DynamicArray *folders_by_property[NUM_DATABASE_INDEX_PROPERTIES] = {0};
+    {
+        g_autoptr(GMutexLocker) locker = fsearch_database_index_store_get_locker(scanned_store);
+        indices = fsearch_database_index_store_get_indices(scanned_store);
+        for (uint32_t i = DATABASE_INDEX_PROPERTY_NAME; i < NUM_DATABASE_INDEX_PROPERTIES; i++) {
+            g_autoptr(FsearchDatabaseChunkedArray) files = fsearch_database_index_store_get_files(scanned_store, i);
+            g_autoptr(FsearchDatabaseChunkedArray) folders = fsearch_database_index_store_get_folders(scanned_store, i);
+            if (files && folders) {
+                files_by_property[i] = fsearch_database_chunked_array_get_joined(files);
+                folders_by_property[i] = fsearch_database_chunked_array_get_joined(folders);
+            }
+        }
+    }
+    g_clear_pointer(&scanned_store, fsearch_database_index_store_unref);
+    g_assert_nonnull(files_by_property[DATABASE_INDEX_PROPERTY_SIZE]);
+
+    g_autoptr(FsearchDatabaseIndexStore) store = fsearch_database_index_store_new_with_content(
+        indices,
+        files_by_property,
+        folders_by_property,
+        include_manager,
+        exclude_manager,
+        DATABASE_INDEX_PROPERTY_FLAG_DEFAULT,
+        DATABASE_INDEX_PROPERTY_FLAG_SIZE,
+        NULL,
+        NULL);
+    g_autoptr(DynamicArray) loaded_size_files = g_steal_pointer(&files_by_property[DATABASE_INDEX_PROPERTY_SIZE]);
+    g_autoptr(DynamicArray) loaded_size_folders = g_steal_pointer(&folders_by_property[DATABASE_INDEX_PROPERTY_SIZE]);
+
+    // While the size index is still being loaded, a file is removed, a new one is added and another one grows
+    g_assert_cmpint(g_remove(g_ptr_array_index(paths, 3)), ==, 0);
+    g_autofree char *new_path = g_build_filename(tmp_dir, "new.txt", NULL);
+    g_autofree char *new_content = g_strnfill(1000, 'x');
+    g_assert_true(g_file_set_contents(new_path, new_content, -1, NULL));
+    g_autofree char *grown_content = g_strnfill(500, 'x');
+    g_assert_true(g_file_set_contents(g_ptr_array_index(paths, 5), grown_content, -1, NULL));
+
+    g_autoptr(GMutexLocker) locker = fsearch_database_index_store_get_locker(store);
+    g_autoptr(DynamicArray) removed_paths = darray_new(1);
+    darray_add_item(removed_paths, g_ptr_array_index(paths, 3));
+    fsearch_database_index_store_remove_paths(store, removed_paths, NULL);
+    g_autoptr(GPtrArray) refreshed_paths = g_ptr_array_new();
+    g_ptr_array_add(refreshed_paths, new_path);
+    g_ptr_array_add(refreshed_paths, g_ptr_array_index(paths, 5));
+    fsearch_database_index_store_refresh_paths(store, refreshed_paths, NULL);
+
+    // The entries of the removed file and of the old version of the grown one are gone
+    g_autoptr(GHashTable) removed_entries = fsearch_database_index_store_get_removed_entries(
+        store,
+        DATABASE_INDEX_PROPERTY_SIZE);
+    g_assert_cmpuint(darray_drop_items(loaded_size_files, is_removed_entry, removed_entries), ==, 2);
+    darray_drop_items(loaded_size_folders, is_removed_entry, removed_entries);
+    g_assert_true(fsearch_database_index_store_add_sort_index(store,
+                                                              DATABASE_INDEX_PROPERTY_SIZE,
+                                                              loaded_size_files,
+                                                              loaded_size_folders));
+
+    // The new and the grown file were merged in
+    g_autoptr(FsearchDatabaseChunkedArray) size_files = fsearch_database_index_store_get_files(
+        store,
+        DATABASE_INDEX_PROPERTY_SIZE);
+    g_assert_nonnull(size_files);
+    g_assert_cmpuint(fsearch_database_chunked_array_get_num_entries(size_files), ==, num_files);
+    for (uint32_t i = 1; i < num_files; i++) {
+        g_assert_cmpint(db_entry_get_size(fsearch_database_chunked_array_get_entry(size_files, i - 1)),
+                        <=,
+                        db_entry_get_size(fsearch_database_chunked_array_get_entry(size_files, i)));
+    }
+    g_assert_cmpstr(db_entry_get_name_raw(fsearch_database_chunked_array_get_entry(size_files, num_files - 2)),
+                    ==,
+                    "file_05.txt");
+    g_assert_cmpstr(db_entry_get_name_raw(fsearch_database_chunked_array_get_entry(size_files, num_files - 1)),
+                    ==,
+                    "new.txt");
+
+    g_clear_pointer(&locker, g_mutex_locker_free);
+    g_clear_pointer(&store, fsearch_database_index_store_unref);
+    for (uint32_t i = DATABASE_INDEX_PROPERTY_NAME; i < NUM_DATABASE_INDEX_PROPERTIES; i++) {
+        g_clear_pointer(&files_by_property[i], darray_unref);
+        g_clear_pointer(&folders_by_property[i], darray_unref);
+    }
+    g_remove(new_path);
+    for (uint32_t i = 0; i < paths->len; i++) {
+        g_remove(g_ptr_array_index(paths, i));
+    }
+    g_remove(tmp_dir);
+}
+
+static void
+test_refresh_paths_of_sibling_roots(void) {
+    g_autofree char *tmp_dir = g_dir_make_tmp("fsearch-test-index-store-XXXXXX", NULL);
+    g_assert_nonnull(tmp_dir);
+
+    // The root of one include is a prefix of the other one's
+    g_autofree char *dir_a = g_build_filename(tmp_dir, "a", NULL);
+    g_autofree char *dir_ab = g_build_filename(tmp_dir, "ab", NULL);
+    g_assert_cmpint(g_mkdir(dir_a, 0755), ==, 0);
+    g_assert_cmpint(g_mkdir(dir_ab, 0755), ==, 0);
+    g_autofree char *file_a = g_build_filename(dir_a, "x.txt", NULL);
+    g_autofree char *file_ab = g_build_filename(dir_ab, "x.txt", NULL);
+    g_assert_true(g_file_set_contents(file_a, "a", -1, NULL));
+    g_assert_true(g_file_set_contents(file_ab, "ab", -1, NULL));
+
+    g_autoptr(FsearchDatabaseIncludeManager) include_manager = fsearch_database_include_manager_new();
+    g_autoptr(FsearchDatabaseInclude) include_a = fsearch_database_include_new(dir_a, TRUE, FALSE, FALSE, FALSE, 0);
+    g_autoptr(FsearchDatabaseInclude) include_ab = fsearch_database_include_new(dir_ab, TRUE, FALSE, FALSE, FALSE, 0);
+    fsearch_database_include_manager_add(include_manager, include_a);
+    fsearch_database_include_manager_add(include_manager, include_ab);
+    g_autoptr(FsearchDatabaseExcludeManager) exclude_manager = fsearch_database_exclude_manager_new();
+
+    g_autoptr(FsearchDatabaseIndexStore) store = fsearch_database_index_store_new(include_manager,
+                                                                                  exclude_manager,
+                                                                                  DATABASE_INDEX_PROPERTY_FLAG_DEFAULT,
+                                                                                  NULL,
+                                                                                  NULL);
+    fsearch_database_index_store_start(store, NULL);
+    g_assert_cmpuint(fsearch_database_index_store_get_num_files(store), ==, 2);
+
+    g_autofree char *file_ab_new = g_build_filename(dir_ab, "new.txt", NULL);
+    g_assert_true(g_file_set_contents(file_ab_new, "new", -1, NULL));
+    {
+        g_autoptr(GMutexLocker) locker = fsearch_database_index_store_get_locker(store);
+        g_autoptr(GPtrArray) paths = g_ptr_array_new_with_free_func(g_free);
+        g_ptr_array_add(paths, g_strdup(file_ab_new));
+        fsearch_database_index_store_refresh_paths(store, paths, NULL);
+    }
+    g_assert_cmpuint(fsearch_database_index_store_get_num_files(store), ==, 3);
+
+    g_assert_cmpint(g_remove(file_ab), ==, 0);
+    {
+        g_autoptr(GMutexLocker) locker = fsearch_database_index_store_get_locker(store);
+        g_autoptr(DynamicArray) paths = darray_new(1);
+        darray_add_item(paths, file_ab);
+        fsearch_database_index_store_remove_paths(store, paths, NULL);
+    }
+    g_assert_cmpuint(fsearch_database_index_store_get_num_files(store), ==, 2);
+
+    g_remove(file_a);
+    g_remove(file_ab_new);
+    g_remove(dir_a);
+    g_remove(dir_ab);
+    g_remove(tmp_dir);
+}
+
+static uint32_t
+search_num_files(FsearchDatabaseIndexStore *store,
+                 uint32_t view_id,
+                 FsearchFilterManager *filters,
+                 const char *search_term,
+                 FsearchDatabaseIndexProperty sort_order) {
+    g_autoptr(FsearchQuery) query = make_query(filters, search_term);
+    g_assert_true(fsearch_database_index_store_search(store, view_id, query, sort_order, GTK_SORT_ASCENDING, NULL));
+    g_autoptr(FsearchDatabaseSearchInfo) info = fsearch_database_index_store_get_search_info(store, view_id);
+    g_assert_nonnull(info);
+    return fsearch_database_search_info_get_num_files(info);
+}
+
+static void
+test_batched_add_and_remove_cancel_out(void) {
+    g_autofree char *tmp_dir = g_dir_make_tmp("fsearch-test-index-store-XXXXXX", NULL);
+    g_assert_nonnull(tmp_dir);
+
+    const uint32_t num_files = 80;
+    g_autoptr(GPtrArray) paths = g_ptr_array_new_with_free_func(g_free);
+    for (uint32_t i = 0; i < num_files; i++) {
+        g_autofree char *name = g_strdup_printf("file_%03u.txt", i);
+        char *path = g_build_filename(tmp_dir, name, NULL);
+        g_assert_true(g_file_set_contents(path, "content", -1, NULL));
+        g_ptr_array_add(paths, path);
+    }
+
+    g_autoptr(FsearchDatabaseIncludeManager) include_manager = fsearch_database_include_manager_new();
+    g_autoptr(FsearchDatabaseInclude) include = fsearch_database_include_new(tmp_dir, TRUE, FALSE, FALSE, FALSE, 0);
+    fsearch_database_include_manager_add(include_manager, include);
+    g_autoptr(FsearchDatabaseExcludeManager) exclude_manager = fsearch_database_exclude_manager_new();
+    FsearchFilterManager *filters = fsearch_filter_manager_new_with_defaults();
+
+    g_autoptr(FsearchDatabaseIndexStore) store = fsearch_database_index_store_new(include_manager,
+                                                                                  exclude_manager,
+                                                                                  DATABASE_INDEX_PROPERTY_FLAG_DEFAULT,
+                                                                                  NULL,
+                                                                                  NULL);
+    fsearch_database_index_store_start(store, NULL);
+    g_assert_cmpuint(fsearch_database_index_store_get_num_files(store), ==, num_files);
+
+    // A view which has to pick up the new file through the batch as well
+    const uint32_t view_id = 1;
+    g_assert_cmpuint(search_num_files(store, view_id, filters, "new", DATABASE_INDEX_PROPERTY_NAME), ==, 0);
+
+    // Enough paths to be refreshed as a batch. The new file is refreshed twice: the entry which gets added for the
+    // first path is removed again by the second one, before the batch is applied, and replaced with a new entry.
+    g_autofree char *new_path = g_build_filename(tmp_dir, "new.txt", NULL);
+    g_assert_true(g_file_set_contents(new_path, "new", -1, NULL));
+    g_autoptr(GPtrArray) refresh_paths = g_ptr_array_new();
+    g_ptr_array_add(refresh_paths, new_path);
+    for (uint32_t i = 0; i < paths->len; i++) {
+        g_ptr_array_add(refresh_paths, g_ptr_array_index(paths, i));
+    }
+    g_ptr_array_add(refresh_paths, new_path);
+    {
+        g_autoptr(GMutexLocker) locker = fsearch_database_index_store_get_locker(store);
+        fsearch_database_index_store_refresh_paths(store, refresh_paths, NULL);
+    }
+    g_assert_cmpuint(fsearch_database_index_store_get_num_files(store), ==, num_files + 1);
+
+    FsearchDatabaseSearchView *view = fsearch_database_index_store_get_search_view(store, view_id);
+    g_assert_nonnull(view);
+    g_autoptr(FsearchDatabaseSearchInfo) info = fsearch_database_search_view_get_info(view);
+    g_assert_cmpuint(fsearch_database_search_info_get_num_files(info), ==, 1);
+
+    // Every sort index has the new file exactly once, not the entry which was removed again
+    const FsearchDatabaseIndexProperty sort_orders[] = {
+        DATABASE_INDEX_PROPERTY_NAME,
+        DATABASE_INDEX_PROPERTY_PATH,
+        DATABASE_INDEX_PROPERTY_SIZE,
+        DATABASE_INDEX_PROPERTY_MODIFICATION_TIME,
+        DATABASE_INDEX_PROPERTY_EXTENSION,
+        DATABASE_INDEX_PROPERTY_FILETYPE,
+    };
+    for (uint32_t i = 0; i < G_N_ELEMENTS(sort_orders); i++) {
+        g_assert_cmpuint(search_num_files(store, view_id, filters, "new", sort_orders[i]), ==, 1);
+        g_assert_cmpuint(search_num_files(store, view_id, filters, "file_", sort_orders[i]), ==, num_files);
+    }
+
+    g_clear_pointer(&store, fsearch_database_index_store_unref);
+    fsearch_filter_manager_unref(filters);
+    g_remove(new_path);
+    for (uint32_t i = 0; i < paths->len; i++) {
+        g_remove(g_ptr_array_index(paths, i));
+    }
+    g_remove(tmp_dir);
+}
+
+typedef struct {
+    FsearchDatabaseIndexStore *store;
+    const char *path;
+    volatile gint stop;
+    uint32_t num_refreshes;
+} ChurnContext;
+
+// Creates and deletes a file over and over again and refreshes its path each time, like a busy folder
+static gpointer
+churn_thread_func(gpointer user_data) {
+    ChurnContext *ctx = user_data;
+    while (!g_atomic_int_get(&ctx->stop)) {
+        if (ctx->num_refreshes % 2 == 0) {
+            g_assert_true(g_file_set_contents(ctx->path, "churn", -1, NULL));
+        }
+        else {
+            g_remove(ctx->path);
+        }
+        g_autoptr(GMutexLocker) locker = fsearch_database_index_store_get_locker(ctx->store);
+        g_autoptr(GPtrArray) paths = g_ptr_array_new();
+        g_ptr_array_add(paths, (gpointer)ctx->path);
+        fsearch_database_index_store_refresh_paths(ctx->store, paths, NULL);
+        ctx->num_refreshes++;
+    }
+    return NULL;
+}
+
+static void
+test_lazy_sort_index_lands_while_store_changes(void) {
+    g_autofree char *tmp_dir = g_dir_make_tmp("fsearch-test-index-store-XXXXXX", NULL);
+    g_assert_nonnull(tmp_dir);
+
+    const uint32_t num_files = 2000;
+    g_autoptr(GPtrArray) paths = g_ptr_array_new_with_free_func(g_free);
+    for (uint32_t i = 0; i < num_files; i++) {
+        g_autofree char *name = g_strdup_printf("file_%04u.txt", i);
+        char *path = g_build_filename(tmp_dir, name, NULL);
+        g_assert_true(g_file_set_contents(path, name, (gssize)(i % 97), NULL));
+        g_ptr_array_add(paths, path);
+    }
+
+    g_autoptr(FsearchDatabaseIncludeManager) include_manager = fsearch_database_include_manager_new();
+    g_autoptr(FsearchDatabaseInclude) include = fsearch_database_include_new(tmp_dir, TRUE, FALSE, FALSE, FALSE, 0);
+    fsearch_database_include_manager_add(include_manager, include);
+    g_autoptr(FsearchDatabaseExcludeManager) exclude_manager = fsearch_database_exclude_manager_new();
+    FsearchFilterManager *filters = fsearch_filter_manager_new_with_defaults();
+
+    g_autoptr(FsearchDatabaseIndexStore) store = fsearch_database_index_store_new(include_manager,
+                                                                                  exclude_manager,
+                                                                                  DATABASE_INDEX_PROPERTY_FLAG_DEFAULT,
+                                                                                  NULL,
+                                                                                  NULL);
+    fsearch_database_index_store_set_lazy_sort_indices(store, true);
+    fsearch_database_index_store_start(store, NULL);
+
+    {
+        // Make sure the size index isn't built in the background before the store starts changing
+        g_autoptr(GMutexLocker) locker = fsearch_database_index_store_get_locker(store);
+        fsearch_database_index_store_drop_sort_index(store, DATABASE_INDEX_PROPERTY_SIZE);
+    }
+
+    // The store keeps changing while the size index is built. Those changes are queued until it's done and applied to
+    // it afterwards, they must neither keep it from landing nor get lost.
+    g_autofree char *churn_path = g_build_filename(tmp_dir, "churn.txt", NULL);
+    ChurnContext ctx = {.store = store, .path = churn_path};
+    GThread *churn_thread = g_thread_new("churn", churn_thread_func, &ctx);
+    {
+        g_autoptr(GMutexLocker) locker = fsearch_database_index_store_get_locker(store);
+        g_assert_null(fsearch_database_index_store_get_files(store, DATABASE_INDEX_PROPERTY_SIZE));
+    }
+
+    g_autoptr(FsearchDatabaseChunkedArray) size_files = NULL;
+    const gint64 deadline = g_get_monotonic_time() + 30 * G_TIME_SPAN_SECOND;
+    while (!size_files && g_get_monotonic_time() < deadline) {
+        g_usleep(10 * 1000);
+        g_autoptr(GMutexLocker) locker = fsearch_database_index_store_get_locker(store);
+        size_files = fsearch_database_index_store_get_files(store, DATABASE_INDEX_PROPERTY_SIZE);
+    }
+    g_atomic_int_set(&ctx.stop, 1);
+    g_thread_join(churn_thread);
+    g_assert_nonnull(size_files);
+    g_assert_cmpuint(ctx.num_refreshes, >, 0);
+    {
+        // Refreshes which were queued while another sort index was built are applied once it's done
+        g_autoptr(GMutexLocker) locker = fsearch_database_index_store_get_locker(store);
+        fsearch_database_index_store_wait_for_entry_readers(store);
+    }
+
+    // The index has the entries the store ended up with, in order
+    const uint32_t num_expected = num_files + (ctx.num_refreshes % 2 == 1 ? 1 : 0);
+    g_assert_cmpuint(fsearch_database_index_store_get_num_files(store), ==, num_expected);
+    g_assert_cmpuint(fsearch_database_chunked_array_get_num_entries(size_files), ==, num_expected);
+    const uint32_t view_id = 1;
+    g_assert_cmpuint(search_num_files(store, view_id, filters, "file_", DATABASE_INDEX_PROPERTY_SIZE), ==, num_files);
+    g_assert_cmpuint(search_num_files(store, view_id, filters, "churn", DATABASE_INDEX_PROPERTY_SIZE),
+                     ==,
+                     num_expected - num_files);
+
+    g_clear_pointer(&store, fsearch_database_index_store_unref);
+    fsearch_filter_manager_unref(filters);
+    g_remove(churn_path);
+    for (uint32_t i = 0; i < paths->len; i++) {
+        g_remove(g_ptr_array_index(paths, i));
+    }
+    g_remove(tmp_dir);
+}
+
 int
 main(int argc, char **argv) {
     g_test_init(&argc, &argv, NULL);
 
     g_test_add_func("/FSearch/database/index_store/cancelled_search_keeps_partial_results_marked_incomplete",
                     test_cancelled_search_keeps_partial_results_marked_incomplete);
+    g_test_add_func("/FSearch/database/index_store/search_without_sort_index_sorts_manually",
+                    test_search_without_sort_index_sorts_manually);
+    g_test_add_func("/FSearch/database/index_store/drop_sort_index", test_drop_sort_index);
+    g_test_add_func("/FSearch/database/index_store/add_deferred_sort_index", test_add_deferred_sort_index);
+    g_test_add_func("/FSearch/database/index_store/deferred_sort_index_gets_changes_made_while_loading",
+                    test_deferred_sort_index_gets_changes_made_while_loading);
+    g_test_add_func("/FSearch/database/index_store/refresh_paths_of_sibling_roots",
+                    test_refresh_paths_of_sibling_roots);
+    g_test_add_func("/FSearch/database/index_store/batched_add_and_remove_cancel_out",
+                    test_batched_add_and_remove_cancel_out);
+    g_test_add_func("/FSearch/database/index_store/lazy_sort_index_lands_while_store_changes",
+                    test_lazy_sort_index_lands_while_store_changes);
 
     return g_test_run();
 }
@@ -0,0 +1,316 @@
+/*
+ * Tests for resuming scans from the checkpoint an interrupted scan left behind: the resumed scan has to end up with
+ * the same entries, sizes included, as a full scan of the same folder.
+ */
+
+#include "fsearch_database_entry.h"
+#include "fsearch_database_exclude_manager.h"
+#include "fsearch_database_include.h"
+#include "fsearch_database_index.h"
+#include "fsearch_database_index_properties.h"
+#include "fsearch_database_scan_checkpoint.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <string.h>
+#include <time.h>
+#include <utime.h>
+
+static void
+write_file(const char *path, const char *content) {
+    g_assert_true(g_file_set_contents(path, content, -1, NULL));
+}
+
+static int
+compare_strings(gconstpointer a, gconstpointer b) {
+    return strcmp(*(const char **)a, *(const char **)b);
+}
+
+// The full paths and sizes of all entries of `index`, sorted
+static GPtrArray *
+index_get_sorted_paths_and_sizes(FsearchDatabaseIndex *index) {
+    GPtrArray *paths = g_ptr_array_new_with_free_func(g_free);
+    fsearch_database_index_lock(index);
+    g_autoptr(DynamicArray) folders = fsearch_database_index_get_folders(index);
+    g_autoptr(DynamicArray) files = fsearch_database_index_get_files(index);
+    DynamicArray *arrays[] = {folders, files};
+    for (uint32_t i = 0; i < G_N_ELEMENTS(arrays); i++) {
+        for (uint32_t j = 0; j < darray_get_num_items(arrays[i]); j++) {
+            FsearchDatabaseEntry *entry = darray_get_item(arrays[i], j);
+            g_autoptr(GString) path = db_entry_get_path_full(entry);
+            const gint64 size = db_entry_get_size(entry);
+            g_ptr_array_add(paths, g_strdup_printf("%s: %" G_GINT64_FORMAT, path->str, size));
+        }
+    }
+    fsearch_database_index_unlock(index);
+    g_ptr_array_sort(paths, compare_strings);
+    return paths;
+}
+
+static time_t
+get_mtime(const char *path) {
+    GStatBuf st;
+    g_assert_cmpint(g_lstat(path, &st), ==, 0);
+    return st.st_mtime;
+}
+
+static void
+set_mtime_to_past(const char *path) {
+    const time_t past = time(NULL) - 60;
+    struct utimbuf times = {.actime = past, .modtime = past};
+    g_assert_cmpint(g_utime(path, &times), ==, 0);
+}
+
+static void
+test_scan_resumes_from_checkpoint(void) {
+    g_autofree char *tmp_dir = g_dir_make_tmp("fsearch-test-database-scan-XXXXXX", NULL);
+    g_assert_nonnull(tmp_dir);
+
+    // The checkpoint is kept outside of the scanned folder
+    g_autofree char *root_dir = g_build_filename(tmp_dir, "root", NULL);
+    g_autofree char *checkpoint_dir = g_build_filename(tmp_dir, "checkpoints", NULL);
+    g_autofree char *dir_a = g_build_filename(root_dir, "a", NULL);
+    g_autofree char *dir_b = g_build_filename(root_dir, "b", NULL);
+    g_autofree char *dir_c = g_build_filename(root_dir, "c", NULL);
+    g_autofree char *dir_d = g_build_filename(dir_c, "d", NULL);
+    g_autofree char *file_a1 = g_build_filename(dir_a, "a1", NULL);
+    g_autofree char *file_b1 = g_build_filename(dir_b, "b1", NULL);
+    g_autofree char *file_c1 = g_build_filename(dir_c, "c1", NULL);
+    g_autofree char *file_c2 = g_build_filename(dir_c, "c2", NULL);
+    g_autofree char *file_d1 = g_build_filename(dir_d, "d1", NULL);
+    g_autofree char *file_r1 = g_build_filename(root_dir, "r1", NULL);
+    g_assert_cmpint(g_mkdir(root_dir, 0755), ==, 0);
+    g_assert_cmpint(g_mkdir(dir_a, 0755), ==, 0);
+    g_assert_cmpint(g_mkdir(dir_b, 0755), ==, 0);
+    g_assert_cmpint(g_mkdir(dir_c, 0755), ==, 0);
+    g_assert_cmpint(g_mkdir(dir_d, 0755), ==, 0);
+    write_file(file_a1, "a1");
+    write_file(file_b1, "b1");
+    write_file(file_c1, "c1");
+    write_file(file_d1, "d1");
+    write_file(file_r1, "r1");
+    // Folders which were changed in the second the checkpoint was created are read again, since their mtime can't
+    // tell whether they changed afterwards
+    set_mtime_to_past(dir_a);
+    set_mtime_to_past(dir_b);
+    set_mtime_to_past(dir_c);
+    set_mtime_to_past(dir_d);
+    set_mtime_to_past(root_dir);
+
+    g_autoptr(FsearchDatabaseExcludeManager) exclude_manager = fsearch_database_exclude_manager_new();
+    g_autoptr(FsearchDatabaseInclude) include = fsearch_database_include_new(root_dir, TRUE, FALSE, FALSE, FALSE, 0);
+    g_autofree char *checkpoint_path = fsearch_database_scan_checkpoint_get_path(checkpoint_dir, root_dir);
+
+    // A scan which got interrupted while reading `c`: `a` and `b` are complete, of `c` only c1 was found. The recorded
+    // sizes differ from the ones on disk, which the resumed scan has to pick up, since changing the content of a file
+    // doesn't change the mtime of its folder.
+    FsearchDatabaseScanCheckpoint *checkpoint = fsearch_database_scan_checkpoint_open(checkpoint_path,
+                                                                                      root_dir,
+                                                                                      exclude_manager,
+                                                                                      false);
+    g_assert_null(fsearch_database_scan_checkpoint_get_resume_root(checkpoint));
+    g_autoptr(GPtrArray) entries = g_ptr_array_new_with_free_func((GDestroyNotify)db_entry_free_no_unparent);
+    FsearchDatabaseEntry *root = NULL;
+    const char *folder_names[] = {root_dir, "a", "b", "c"};
+    const char *folder_paths[] = {root_dir, dir_a, dir_b, dir_c};
+    for (uint32_t i = 0; i < G_N_ELEMENTS(folder_names); i++) {
+        FsearchDatabaseEntry *folder = db_entry_new_with_attributes(DATABASE_INDEX_PROPERTY_FLAG_DEFAULT,
+                                                                    folder_names[i],
+                                                                    root,
+                                                                    DATABASE_ENTRY_TYPE_FOLDER,
+                                                                    DATABASE_INDEX_PROPERTY_MODIFICATION_TIME,
+                                                                    (int64_t)get_mtime(folder_paths[i]),
+                                                                    DATABASE_INDEX_PROPERTY_NONE);
+        g_ptr_array_add(entries, folder);
+        fsearch_database_scan_checkpoint_add_folder(checkpoint, folder);
+        if (!root) {
+            root = folder;
+        }
+    }
+    const char *file_names[] = {"a1", "b1", "c1"};
+    for (uint32_t i = 0; i < G_N_ELEMENTS(file_names); i++) {
+        FsearchDatabaseEntry *file = db_entry_new_with_attributes(DATABASE_INDEX_PROPERTY_FLAG_DEFAULT,
+                                                                  file_names[i],
+                                                                  g_ptr_array_index(entries, i + 1),
+                                                                  DATABASE_ENTRY_TYPE_FILE,
+                                                                  DATABASE_INDEX_PROPERTY_SIZE,
+                                                                  (int64_t)12345,
+                                                                  DATABASE_INDEX_PROPERTY_MODIFICATION_TIME,
+                                                                  (int64_t)0,
+                                                                  DATABASE_INDEX_PROPERTY_NONE);
+        g_ptr_array_add(entries, file);
+        fsearch_database_scan_checkpoint_add_file(checkpoint, file);
+    }
+    fsearch_database_scan_checkpoint_complete_folder(checkpoint, g_ptr_array_index(entries, 1));
+    fsearch_database_scan_checkpoint_complete_folder(checkpoint, g_ptr_array_index(entries, 2));
+    g_assert_true(fsearch_database_scan_checkpoint_flush(checkpoint, true));
+    g_clear_pointer(&checkpoint, fsearch_database_scan_checkpoint_free);
+    g_assert_true(g_file_test(checkpoint_path, G_FILE_TEST_IS_REGULAR));
+
+    // Changes while the application wasn't running
+    g_unlink(file_b1);
+    g_rmdir(dir_b);
+    write_file(file_c2, "c2");
+
+    g_autoptr(GMainContext) monitor_ctx = g_main_context_new();
+    g_autoptr(FsearchDatabaseIndex) resumed_index = fsearch_database_index_new(include,
+                                                                               exclude_manager,
+                                                                               DATABASE_INDEX_PROPERTY_FLAG_DEFAULT,
+                                                                               monitor_ctx,
+                                                                               NULL,
+                                                                               NULL);
+    fsearch_database_index_set_checkpoint_path(resumed_index, checkpoint_path);
+    g_assert_true(fsearch_database_index_scan(resumed_index, NULL));
+
+    g_autoptr(FsearchDatabaseIndex) scanned_index = fsearch_database_index_new(include,
+                                                                               exclude_manager,
+                                                                               DATABASE_INDEX_PROPERTY_FLAG_DEFAULT,
+                                                                               monitor_ctx,
+                                                                               NULL,
+                                                                               NULL);
+    g_assert_true(fsearch_database_index_scan(scanned_index, NULL));
+
+    // The resumed scan finds the same entries as a full one, with the same sizes, including the ones of the folders
+    g_autoptr(GPtrArray) resumed_paths = index_get_sorted_paths_and_sizes(resumed_index);
+    g_autoptr(GPtrArray) scanned_paths = index_get_sorted_paths_and_sizes(scanned_index);
+    g_assert_cmpuint(resumed_paths->len, ==, scanned_paths->len);
+    for (uint32_t i = 0; i < resumed_paths->len; i++) {
+        g_assert_cmpstr(g_ptr_array_index(resumed_paths, i), ==, g_ptr_array_index(scanned_paths, i));
+    }
+
+    // a1 was taken over from the checkpoint with its size on disk, c1 was read again
+    fsearch_database_index_lock(resumed_index);
+    g_autoptr(DynamicArray) files = fsearch_database_index_get_files(resumed_index);
+    for (uint32_t i = 0; i < darray_get_num_items(files); i++) {
+        FsearchDatabaseEntry *file = darray_get_item(files, i);
+        const char *name = db_entry_get_name_raw(file);
+        if (!strcmp(name, "a1") || !strcmp(name, "c1")) {
+            g_assert_cmpint(db_entry_get_size(file), ==, 2);
+        }
+    }
+    fsearch_database_index_unlock(resumed_index);
+
+    // The finished scan leaves a complete checkpoint behind until its result is in use
+    g_assert_true(g_file_test(checkpoint_path, G_FILE_TEST_IS_REGULAR));
+    fsearch_database_index_remove_checkpoint(resumed_index);
+    g_assert_false(g_file_test(checkpoint_path, G_FILE_TEST_EXISTS));
+
+    g_unlink(file_a1);
+    g_unlink(file_c1);
+    g_unlink(file_c2);
+    g_unlink(file_d1);
+    g_unlink(file_r1);
+    g_rmdir(dir_d);
+    g_rmdir(dir_c);
+    g_rmdir(dir_a);
+    g_rmdir(root_dir);
+    g_rmdir(checkpoint_dir);
+    g_rmdir(tmp_dir);
+}
+
+static void
+test_scan_rereads_folders_which_failed_to_open(void) {
+    g_autofree char *tmp_dir = g_dir_make_tmp("fsearch-test-database-scan-XXXXXX", NULL);
+    g_assert_nonnull(tmp_dir);
+
+    g_autofree char *root_dir = g_build_filename(tmp_dir, "root", NULL);
+    g_autofree char *checkpoint_dir = g_build_filename(tmp_dir, "checkpoints", NULL);
+    g_autofree char *dir_locked = g_build_filename(root_dir, "locked", NULL);
+    g_autofree char *file_l1 = g_build_filename(dir_locked, "l1", NULL);
+    g_autofree char *file_r1 = g_build_filename(root_dir, "r1", NULL);
+    g_assert_cmpint(g_mkdir(root_dir, 0755), ==, 0);
+    g_assert_cmpint(g_mkdir(dir_locked, 0755), ==, 0);
+    write_file(file_l1, "l1");
+    write_file(file_r1, "r1");
+    set_mtime_to_past(dir_locked);
+    set_mtime_to_past(root_dir);
+
+    // Changing the permissions doesn't change the mtime, so the folder would pass as unchanged when resuming
+    g_assert_cmpint(g_chmod(dir_locked, 0), ==, 0);
+    GDir *dir = g_dir_open(dir_locked, 0, NULL);
+    if (dir) {
+        // Permissions don't apply, e.g. when running as root
+        g_dir_close(dir);
+        g_assert_cmpint(g_chmod(dir_locked, 0755), ==, 0);
+        g_unlink(file_l1);
+        g_unlink(file_r1);
+        g_rmdir(dir_locked);
+        g_rmdir(root_dir);
+        g_rmdir(tmp_dir);
+        g_test_skip("folder can be read without permissions");
+        return;
+    }
+
+    g_autoptr(FsearchDatabaseExcludeManager) exclude_manager = fsearch_database_exclude_manager_new();
+    g_autoptr(FsearchDatabaseInclude) include = fsearch_database_include_new(root_dir, TRUE, FALSE, FALSE, FALSE, 0);
+    g_autofree char *checkpoint_path = fsearch_database_scan_checkpoint_get_path(checkpoint_dir, root_dir);
+    g_autoptr(GMainContext) monitor_ctx = g_main_context_new();
+
+    // The scan doesn't fail because of a single folder it can't read, and leaves its checkpoint behind
+    g_autoptr(FsearchDatabaseIndex) failed_index = fsearch_database_index_new(include,
+                                                                              exclude_manager,
+                                                                              DATABASE_INDEX_PROPERTY_FLAG_DEFAULT,
+                                                                              monitor_ctx,
+                                                                              NULL,
+                                                                              NULL);
+    fsearch_database_index_set_checkpoint_path(failed_index, checkpoint_path);
+    g_assert_true(fsearch_database_index_scan(failed_index, NULL));
+    g_assert_true(g_file_test(checkpoint_path, G_FILE_TEST_IS_REGULAR));
+
+    g_assert_cmpint(g_chmod(dir_locked, 0755), ==, 0);
+
+    // Resuming reads the folder again instead of taking over the empty one from the checkpoint
+    g_autoptr(FsearchDatabaseIndex) resumed_index = fsearch_database_index_new(include,
+                                                                               exclude_manager,
+                                                                               DATABASE_INDEX_PROPERTY_FLAG_DEFAULT,
+                                                                               monitor_ctx,
+                                                                               NULL,
+                                                                               NULL);
+    fsearch_database_index_set_checkpoint_path(resumed_index, checkpoint_path);
+    g_assert_true(fsearch_database_index_scan(resumed_index, NULL));
+
+    g_autoptr(FsearchDatabaseIndex) scanned_index = fsearch_database_index_new(include,
+                                                                               exclude_manager,
+                                                                               DATABASE_INDEX_PROPERTY_FLAG_DEFAULT,
+                                                                               monitor_ctx,
+                                                                               NULL,
+                                                                               NULL);
+    g_assert_true(fsearch_database_index_scan(scanned_index, NULL));
+
+    g_autoptr(GPtrArray) resumed_paths = index_get_sorted_paths_and_sizes(resumed_index);
+    g_autoptr(GPtrArray) scanned_paths = index_get_sorted_paths_and_sizes(scanned_index);
+    g_assert_cmpuint(resumed_paths->len, ==, scanned_paths->len);
+    for (uint32_t i = 0; i < resumed_paths->len; i++) {
+        g_assert_cmpstr(g_ptr_array_index(resumed_paths, i), ==, g_ptr_array_index(scanned_paths, i));
+    }
+
+    fsearch_database_index_lock(resumed_index);
+    g_autoptr(DynamicArray) files = fsearch_database_index_get_files(resumed_index);
+    bool found_l1 = false;
+    for (uint32_t i = 0; i < darray_get_num_items(files); i++) {
+        if (!strcmp(db_entry_get_name_raw(darray_get_item(files, i)), "l1")) {
+            found_l1 = true;
+        }
+    }
+    fsearch_database_index_unlock(resumed_index);
+    g_assert_true(found_l1);
+
+    fsearch_database_index_remove_checkpoint(resumed_index);
+    g_unlink(file_l1);
+    g_unlink(file_r1);
+    g_rmdir(dir_locked);
+    g_rmdir(root_dir);
+    g_rmdir(checkpoint_dir);
+    g_rmdir(tmp_dir);
+}
+
+int
+main(int argc, char **argv) {
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/FSearch/database/scan/resumes_from_checkpoint", test_scan_resumes_from_checkpoint);
+    g_test_add_func("/FSearch/database/scan/rereads_folders_which_failed_to_open",
+                    test_scan_rereads_folders_which_failed_to_open);
+
+    return g_test_run();
+}
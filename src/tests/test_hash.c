@@ -0,0 +1,49 @@
+#include <glib.h>
+#include <string.h>
+
+#include <src/fsearch_hash.h>
+
+static void
+test_hash_known_values(void) {
+    g_assert_cmphex(fsearch_hash_compute("", 0, 0), ==, 0xef46db3751d8e999);
+    g_assert_cmphex(fsearch_hash_compute("abc", 3, 0), ==, 0x44bc2cf5ad770999);
+
+    // Long enough for the stripe loop, followed by a tail which takes the 8, 4 and 1 byte steps
+    uint8_t data[1024 + 7];
+    for (uint32_t i = 0; i < 1024; i++) {
+        data[i] = (uint8_t)(i % 256);
+    }
+    memcpy(data + 1024, "xxxxxxx", 7);
+    g_assert_cmphex(fsearch_hash_compute(data, sizeof(data), 0), ==, 0xb714a8e9fc74160e);
+    g_assert_cmphex(fsearch_hash_compute(data, sizeof(data), 0x9e3779b97f4a7c15), ==, 0x30c318a55f9c8c76);
+    g_assert_cmphex(fsearch_hash_compute(data, 45, 2654435761), ==, 0x24d78f5c6ac00307);
+}
+
+static void
+test_hash_incremental(void) {
+    uint8_t data[1000];
+    for (uint32_t i = 0; i < G_N_ELEMENTS(data); i++) {
+        data[i] = (uint8_t)(i * 31 + 7);
+    }
+
+    // Feeding the data in pieces which don't line up with the stripes must give the same hash
+    for (uint32_t size = 0; size <= G_N_ELEMENTS(data); size += 97) {
+        FsearchHash hash;
+        fsearch_hash_init(&hash, 42);
+        for (uint32_t offset = 0; offset < size;) {
+            const uint32_t n = MIN(offset % 13 + 1, size - offset);
+            fsearch_hash_update(&hash, data + offset, n);
+            offset += n;
+        }
+        g_assert_cmphex(fsearch_hash_digest(&hash), ==, fsearch_hash_compute(data, size, 42));
+    }
+    g_assert_cmphex(fsearch_hash_compute(data, G_N_ELEMENTS(data), 0), !=, fsearch_hash_compute(data, 999, 0));
+}
+
+int
+main(int argc, char *argv[]) {
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/FSearch/hash/known_values", test_hash_known_values);
+    g_test_add_func("/FSearch/hash/incremental", test_hash_incremental);
+    return g_test_run();
+}
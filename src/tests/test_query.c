@@ -2,9 +2,11 @@
 #include <glib.h>
 #include <locale.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <src/fsearch_limits.h>
 #include <src/fsearch_query.h>
+#include <src/fsearch_query_cache.h>
 
 typedef struct QueryTest {
     const char *needle;
@@ -349,11 +351,204 @@ test_german_case_mapping(void) {
     }
 }
 
+static void
+test_profile(void) {
+    FsearchQuery *q = fsearch_query_new("foo bar", NULL, NULL, 0, "debug_query");
+    fsearch_query_enable_profiling(q);
+    FsearchQueryProfile *profile = fsearch_query_get_profile(q);
+    g_assert_nonnull(profile);
+    g_assert_cmpuint(fsearch_query_profile_get_num_nodes(profile), ==, 3);
+
+    FsearchDatabaseEntry *match = db_entry_new(DATABASE_INDEX_PROPERTY_FLAG_NONE, "foobar", NULL, DATABASE_ENTRY_TYPE_FILE);
+    FsearchDatabaseEntry *mismatch = db_entry_new(DATABASE_INDEX_PROPERTY_FLAG_NONE, "foo", NULL, DATABASE_ENTRY_TYPE_FILE);
+
+    FsearchQueryMatchData *match_data = fsearch_query_match_data_new(NULL, NULL);
+    fsearch_query_match_data_start_profiling(match_data, fsearch_query_profile_get_num_nodes(profile));
+    fsearch_query_match_data_set_entry(match_data, match);
+    g_assert_true(fsearch_query_match(q, match_data));
+    fsearch_query_match_data_set_entry(match_data, mismatch);
+    g_assert_false(fsearch_query_match(q, match_data));
+
+    uint32_t num_node_profiles = 0;
+    FsearchQueryNodeProfile *node_profiles = fsearch_query_match_data_get_node_profiles(match_data, &num_node_profiles);
+    g_assert_nonnull(node_profiles);
+    fsearch_query_profile_add_node_profiles(profile, node_profiles, num_node_profiles);
+    fsearch_query_profile_add_thread_profile(profile, 0, 2, 1, 10);
+
+    // Resetting the match data stops profiling
+    fsearch_query_match_data_reset(match_data);
+    g_assert_null(fsearch_query_match_data_get_node_profiles(match_data, NULL));
+
+    // Nodes are numbered in pre-order: the AND operator first, then "foo" and "bar"
+    const uint64_t expected_matches[] = {1, 2, 1};
+    for (uint32_t i = 0; i < G_N_ELEMENTS(expected_matches); i++) {
+        FsearchQueryNodeProfile node_profile = {};
+        g_assert_true(fsearch_query_profile_get_node_profile(profile, i, &node_profile));
+        g_assert_cmpuint(node_profile.num_evaluations, ==, 2);
+        g_assert_cmpuint(node_profile.num_matches, ==, expected_matches[i]);
+        g_assert_cmpuint(node_profile.num_sampled_evaluations, ==, 1);
+    }
+
+    g_autofree char *profile_string = fsearch_query_get_profile_string(q);
+    g_assert_nonnull(strstr(profile_string, "evaluations: 2, matches: 1"));
+    g_assert_nonnull(strstr(profile_string, "thread 0: 2 items, 1 matches"));
+
+    g_clear_pointer(&match_data, fsearch_query_match_data_free);
+    g_clear_pointer(&match, db_entry_free_no_unparent);
+    g_clear_pointer(&mismatch, db_entry_free_no_unparent);
+    g_clear_pointer(&q, fsearch_query_unref);
+}
+
+static void
+test_shared_query_trees(void) {
+    FsearchQuery *q1 = fsearch_query_new("foo bar", NULL, NULL, 0, "debug_query");
+    FsearchQuery *q2 = fsearch_query_new(" foo bar ", NULL, NULL, 0, "debug_query");
+    FsearchQuery *q3 = fsearch_query_new("foo bar", NULL, NULL, QUERY_FLAG_MATCH_CASE, "debug_query");
+
+    // Same search term after normalization and same flags: the compiled tree is shared
+    g_assert_true(q1->query_tree == q2->query_tree);
+    g_assert_true(q1->query_tree != q3->query_tree);
+
+    g_clear_pointer(&q1, fsearch_query_unref);
+    g_clear_pointer(&q2, fsearch_query_unref);
+    g_clear_pointer(&q3, fsearch_query_unref);
+
+    // Relative dates are resolved while parsing, so such trees must not be reused on another day
+    FsearchQuery *q4 = fsearch_query_new("foo dm:today", NULL, NULL, 0, "debug_query");
+    FsearchQuery *q5 = fsearch_query_new("foo dm:today", NULL, NULL, 0, "debug_query");
+    g_assert_true(q4->query_tree != q5->query_tree);
+
+    g_clear_pointer(&q4, fsearch_query_unref);
+    g_clear_pointer(&q5, fsearch_query_unref);
+}
+
+// Every character of a value takes up 1 KiB
+static size_t
+query_cache_test_get_size(gpointer value) {
+    return strlen(value) << 10;
+}
+
+static void
+test_query_cache_eviction(void) {
+    FsearchQueryCache *cache = fsearch_query_cache_new(4 << 10, query_cache_test_get_size, g_free);
+
+    char *a = fsearch_query_cache_insert(cache, "a", g_strdup("a"));
+    g_assert_true(fsearch_query_cache_lookup(cache, "a") == a);
+    g_assert_null(fsearch_query_cache_lookup(cache, "b"));
+
+    // Inserting a value for a key which is already present returns the existing one
+    g_assert_true(fsearch_query_cache_insert(cache, "a", g_strdup("a")) == a);
+
+    char *b = fsearch_query_cache_insert(cache, "b", g_strdup("b"));
+    g_assert_cmpuint(fsearch_query_cache_get_num_values(cache), ==, 2);
+    g_assert_cmpuint(fsearch_query_cache_get_size(cache), >, 2 << 10);
+    g_assert_cmpuint(fsearch_query_cache_get_size(cache), <, 3 << 10);
+
+    // Both small values fit into the budget, so they're kept when they're not used anymore
+    fsearch_query_cache_release(cache, a);
+    fsearch_query_cache_release(cache, a);
+    fsearch_query_cache_release(cache, a);
+    fsearch_query_cache_release(cache, b);
+    g_assert_cmpuint(fsearch_query_cache_get_num_values(cache), ==, 2);
+
+    // A large value evicts as many unused values as it takes to fit, the least recently used first
+    char *c = fsearch_query_cache_insert(cache, "c", g_strdup("cc"));
+    g_assert_cmpuint(fsearch_query_cache_get_num_values(cache), ==, 2);
+    g_assert_null(fsearch_query_cache_lookup(cache, "a"));
+    char *d = fsearch_query_cache_insert(cache, "d", g_strdup("dddd"));
+    g_assert_cmpuint(fsearch_query_cache_get_num_values(cache), ==, 2);
+    g_assert_null(fsearch_query_cache_lookup(cache, "b"));
+
+    // Values in use are never evicted, even if they exceed the budget
+    g_assert_true(fsearch_query_cache_lookup(cache, "c") == c);
+    fsearch_query_cache_release(cache, c);
+    g_assert_cmpuint(fsearch_query_cache_get_num_values(cache), ==, 2);
+
+    // Once they're not used anymore, they're evicted until the budget holds. d alone exceeds it, so it isn't kept.
+    fsearch_query_cache_release(cache, c);
+    g_assert_cmpuint(fsearch_query_cache_get_num_values(cache), ==, 1);
+    fsearch_query_cache_release(cache, d);
+    g_assert_cmpuint(fsearch_query_cache_get_num_values(cache), ==, 0);
+    g_assert_cmpuint(fsearch_query_cache_get_size(cache), ==, 0);
+
+    char *e = fsearch_query_cache_insert(cache, "e", g_strdup("e"));
+    fsearch_query_cache_release(cache, e);
+    g_assert_cmpuint(fsearch_query_cache_get_num_values(cache), ==, 1);
+    fsearch_query_cache_clear_unused(cache);
+    g_assert_cmpuint(fsearch_query_cache_get_num_values(cache), ==, 0);
+
+    g_clear_pointer(&cache, fsearch_query_cache_free);
+}
+
+static bool
+is_refinement(const char *term, const char *previous_term, FsearchQueryFlags flags) {
+    FsearchQuery *q = fsearch_query_new(term, NULL, NULL, flags, "debug_query");
+    FsearchQuery *previous = fsearch_query_new(previous_term, NULL, NULL, flags, "debug_query");
+    const bool res = fsearch_query_is_refinement_of(q, previous);
+    g_clear_pointer(&q, fsearch_query_unref);
+    g_clear_pointer(&previous, fsearch_query_unref);
+    return res;
+}
+
+static void
+test_query_refinement(void) {
+    g_assert_true(is_refinement("foo", "fo", 0));
+    g_assert_true(is_refinement("foo bar", "foo", 0));
+    g_assert_true(is_refinement("foo", "", 0));
+    g_assert_true(is_refinement("fooB", "foo", 0));
+
+    g_assert_false(is_refinement("fo", "foo", 0));
+    g_assert_false(is_refinement("bar foo", "foo", 0));
+    // Appending can turn words into operators, wildcards, fields or path searches
+    g_assert_false(is_refinement("foo OR", "foo O", 0));
+    g_assert_false(is_refinement("foo ORx", "foo OR", 0));
+    g_assert_false(is_refinement("foo*", "foo", 0));
+    g_assert_false(is_refinement("ext:mp3", "ext", 0));
+    g_assert_false(is_refinement("foo/", "foo", 0));
+    g_assert_false(is_refinement("\"foo bar\"", "\"foo", 0));
+    g_assert_false(is_refinement("foo AND bar", "foo AND", 0));
+    g_assert_false(is_refinement("foo NOT bar", "foo NOT", 0));
+    g_assert_false(is_refinement("foo OR bar", "foo OR", 0));
+    g_assert_false(is_refinement("NOTE", "NOT", 0));
+    g_assert_false(is_refinement("!foo", "!fo", 0));
+    // Longer needles aren't stricter for exact matches and regular expressions
+    g_assert_false(is_refinement("foo", "fo", QUERY_FLAG_EXACT_MATCH));
+    g_assert_false(is_refinement("foo", "fo", QUERY_FLAG_REGEX));
+    g_assert_false(is_refinement("foo", "fo", QUERY_FLAG_EXACT_MATCH | QUERY_FLAG_MATCH_CASE));
+    // The flags of both queries must be the same
+    FsearchQuery *q = fsearch_query_new("foo", NULL, NULL, QUERY_FLAG_MATCH_CASE, "debug_query");
+    FsearchQuery *previous = fsearch_query_new("fo", NULL, NULL, 0, "debug_query");
+    g_assert_false(fsearch_query_is_refinement_of(q, previous));
+    g_clear_pointer(&q, fsearch_query_unref);
+    g_clear_pointer(&previous, fsearch_query_unref);
+
+    // So must the filters
+    FsearchFilter *music = fsearch_filter_new("Music", NULL, "ext:mp3;flac", 0);
+    FsearchFilter *text = fsearch_filter_new("Text", NULL, "ext:txt", 0);
+    FsearchQuery *music_query = fsearch_query_new("foo", music, NULL, 0, "debug_query");
+    FsearchQuery *music_previous = fsearch_query_new("fo", music, NULL, 0, "debug_query");
+    FsearchQuery *text_previous = fsearch_query_new("fo", text, NULL, 0, "debug_query");
+    FsearchQuery *unfiltered_previous = fsearch_query_new("fo", NULL, NULL, 0, "debug_query");
+    g_assert_true(fsearch_query_is_refinement_of(music_query, music_previous));
+    g_assert_false(fsearch_query_is_refinement_of(music_query, text_previous));
+    g_assert_false(fsearch_query_is_refinement_of(music_query, unfiltered_previous));
+    g_clear_pointer(&music_query, fsearch_query_unref);
+    g_clear_pointer(&music_previous, fsearch_query_unref);
+    g_clear_pointer(&text_previous, fsearch_query_unref);
+    g_clear_pointer(&unfiltered_previous, fsearch_query_unref);
+    g_clear_pointer(&music, fsearch_filter_unref);
+    g_clear_pointer(&text, fsearch_filter_unref);
+}
+
 int
 main(int argc, char *argv[]) {
     g_test_init(&argc, &argv, NULL);
     g_test_add_func("/FSearch/query/main", test_main);
     g_test_add_func("/FSearch/query/mappings_turkic", test_turkic_case_mapping);
     g_test_add_func("/FSearch/query/mappings_german", test_german_case_mapping);
+    g_test_add_func("/FSearch/query/profile", test_profile);
+    g_test_add_func("/FSearch/query/shared_query_trees", test_shared_query_trees);
+    g_test_add_func("/FSearch/query/cache_eviction", test_query_cache_eviction);
+    g_test_add_func("/FSearch/query/refinement", test_query_refinement);
     return g_test_run();
 }
\ No newline at end of file
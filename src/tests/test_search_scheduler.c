@@ -0,0 +1,105 @@
+#include <glib.h>
+#include <stdint.h>
+
+#include <src/fsearch_search_scheduler.h>
+
+#define MS(ms) ((int64_t)(ms) * G_TIME_SPAN_MILLISECOND)
+
+static void
+test_search_scheduler_debounce(void) {
+    // Too few searches to adapt to
+    const int64_t slow[] = {MS(100), MS(100), MS(100), MS(100)};
+    g_assert_cmpuint(fsearch_search_scheduler_compute_debounce_ms(slow, 3), ==, 0);
+    g_assert_cmpuint(fsearch_search_scheduler_compute_debounce_ms(NULL, 0), ==, 0);
+
+    // Searches which finish within a frame are dispatched right away
+    const int64_t fast[] = {MS(1), MS(2), MS(16), MS(16)};
+    g_assert_cmpuint(fsearch_search_scheduler_compute_debounce_ms(fast, G_N_ELEMENTS(fast)), ==, 0);
+
+    // Otherwise the mean of the median and the 95th percentile, which is the slowest search for few samples
+    g_assert_cmpuint(fsearch_search_scheduler_compute_debounce_ms(slow, G_N_ELEMENTS(slow)), ==, 100);
+    const int64_t mixed[] = {MS(40), MS(10), MS(17), MS(10)};
+    g_assert_cmpuint(fsearch_search_scheduler_compute_debounce_ms(mixed, G_N_ELEMENTS(mixed)), ==, (17 + 40) / 2);
+
+    // A single slow search among 32 is above the 95th percentile, so it doesn't count
+    int64_t outlier[32];
+    for (uint32_t i = 0; i < G_N_ELEMENTS(outlier); i++) {
+        outlier[i] = MS(20 + i);
+    }
+    outlier[7] = MS(5000);
+    g_assert_cmpuint(fsearch_search_scheduler_compute_debounce_ms(outlier, G_N_ELEMENTS(outlier)),
+                     ==,
+                     (37 + 51) / 2);
+
+    // Never longer than 250 ms
+    const int64_t very_slow[] = {MS(1000), MS(2000), MS(3000), MS(4000)};
+    g_assert_cmpuint(fsearch_search_scheduler_compute_debounce_ms(very_slow, G_N_ELEMENTS(very_slow)), ==, 250);
+}
+
+static void
+on_dispatch(gpointer user_data) {
+    uint32_t *num_dispatched = user_data;
+    (*num_dispatched)++;
+}
+
+static void
+run_search(FsearchSearchScheduler *scheduler, bool completed) {
+    fsearch_search_scheduler_dispatch_now(scheduler);
+    g_usleep(20 * G_TIME_SPAN_MILLISECOND);
+    fsearch_search_scheduler_search_finished(scheduler, completed);
+}
+
+static void
+test_search_scheduler_latency(void) {
+    uint32_t num_dispatched = 0;
+    FsearchSearchScheduler *scheduler = fsearch_search_scheduler_new(on_dispatch, &num_dispatched);
+
+    // Cancelled searches aren't counted, no matter how long they took
+    for (uint32_t i = 0; i < 4; i++) {
+        run_search(scheduler, false);
+    }
+    g_assert_cmpuint(num_dispatched, ==, 4);
+    g_assert_cmpuint(fsearch_search_scheduler_get_debounce_ms(scheduler), ==, 0);
+
+    for (uint32_t i = 0; i < 3; i++) {
+        run_search(scheduler, true);
+    }
+    // Only the search in flight finishes, so these aren't counted either
+    fsearch_search_scheduler_search_finished(scheduler, true);
+    fsearch_search_scheduler_search_finished(scheduler, true);
+    g_assert_cmpuint(fsearch_search_scheduler_get_debounce_ms(scheduler), ==, 0);
+
+    run_search(scheduler, true);
+    const uint32_t debounce_ms = fsearch_search_scheduler_get_debounce_ms(scheduler);
+    g_assert_cmpuint(debounce_ms, >=, 20);
+    g_assert_cmpuint(debounce_ms, <=, 250);
+    g_assert_cmpuint(num_dispatched, ==, 8);
+
+    // Requests are held back now, until no further request arrived within the debounce window
+    fsearch_search_scheduler_request(scheduler);
+    fsearch_search_scheduler_request(scheduler);
+    g_assert_cmpuint(num_dispatched, ==, 8);
+    const int64_t deadline = g_get_monotonic_time() + MS(5000);
+    while (num_dispatched == 8 && g_get_monotonic_time() < deadline) {
+        g_main_context_iteration(NULL, TRUE);
+    }
+    g_assert_cmpuint(num_dispatched, ==, 9);
+
+    // Cancelling drops the pending request
+    fsearch_search_scheduler_request(scheduler);
+    fsearch_search_scheduler_cancel(scheduler);
+    g_usleep(debounce_ms * G_TIME_SPAN_MILLISECOND + MS(20));
+    while (g_main_context_iteration(NULL, FALSE)) {
+    }
+    g_assert_cmpuint(num_dispatched, ==, 9);
+
+    g_clear_pointer(&scheduler, fsearch_search_scheduler_free);
+}
+
+int
+main(int argc, char *argv[]) {
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/FSearch/search_scheduler/debounce", test_search_scheduler_debounce);
+    g_test_add_func("/FSearch/search_scheduler/latency", test_search_scheduler_latency);
+    return g_test_run();
+}